@@ -125,3 +125,9 @@ function(add_sfctest_directory test_directory)
         add_subdirectory(${test_directory})
     endif()
 endfunction()
+
+function(add_perftest_directory test_directory)
+    if (${run_perf_tests})
+        add_subdirectory(${test_directory})
+    endif()
+endfunction()
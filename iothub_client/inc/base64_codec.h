@@ -0,0 +1,46 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	base64_codec.h
+*	@brief	Base64 encoding into caller supplied buffers, vectorized where the CPU allows it.
+*/
+
+#ifndef BASE64_CODEC_H
+#define BASE64_CODEC_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+* @brief	Returns the number of characters base64_codec_encode writes for @c size bytes, padding included.
+*/
+#define BASE64_CODEC_ENCODED_SIZE(size)     (4 * (((size) + 2) / 3))
+
+/**
+* @brief	Encodes bytes in base64 (RFC 4648, standard alphabet, padded with '=').
+*
+*			On x86 the blocks of the input are encoded with AVX2 or SSSE3 when the CPU has them, which is checked
+*			once with CPUID; on ARM64 they are encoded with NEON. The rest is encoded one group of 3 bytes at a time.
+*
+* @param	source			The bytes to encode. Can be NULL if @c size is 0.
+*
+* @param	size			The number of bytes to encode.
+*
+* @param	destination		Where the BASE64_CODEC_ENCODED_SIZE(size) characters are written, not null terminated.
+*
+* @param	capacity		The number of characters @c destination has room for.
+*
+* @returns	0 on success, or a non-zero value if an argument is invalid or @c capacity is too small.
+*/
+MOCKABLE_FUNCTION(, int, base64_codec_encode, const unsigned char*, source, size_t, size, char*, destination, size_t, capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*BASE64_CODEC_H*/
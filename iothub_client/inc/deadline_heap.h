@@ -0,0 +1,102 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	deadline_heap.h
+*	@brief	A min-heap of items ordered by the tick count at which they expire.
+*/
+
+#ifndef DEADLINE_HEAP_H
+#define DEADLINE_HEAP_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct DEADLINE_HEAP_TAG* DEADLINE_HEAP_HANDLE;
+typedef struct DEADLINE_HEAP_ENTRY_TAG* DEADLINE_HEAP_ENTRY_HANDLE;
+
+/**
+* @brief	Creates a new, empty instance of DEADLINE_HEAP.
+*
+* @returns	A non-NULL @c DEADLINE_HEAP_HANDLE value that is used when invoking other API functions.
+*/
+MOCKABLE_FUNCTION(, DEADLINE_HEAP_HANDLE, deadline_heap_create);
+
+/**
+* @brief	Destroys an instance of DEADLINE_HEAP, releasing all entries still in it.
+*
+* @remarks	The values stored in the heap are not owned by it and are not released.
+*
+* @param	heap	A @c DEADLINE_HEAP_HANDLE obtained using deadline_heap_create.
+*/
+MOCKABLE_FUNCTION(, void, deadline_heap_destroy, DEADLINE_HEAP_HANDLE, heap);
+
+/**
+* @brief	Schedules @c value to expire at @c deadline.
+*
+* @remarks	Entries released by deadline_heap_remove and deadline_heap_pop_expired are reused, so adding
+*			only allocates while the heap holds more entries than it ever did.
+*
+* @param	heap	A @c DEADLINE_HEAP_HANDLE obtained using deadline_heap_create.
+*
+* @param	deadline	The tick count (in milliseconds) at which @c value expires.
+*
+* @param	value	A non-NULL pointer returned by deadline_heap_pop_expired once @c deadline is reached.
+*
+* @returns	A non-NULL @c DEADLINE_HEAP_ENTRY_HANDLE that can be passed to deadline_heap_remove, or NULL on failure.
+*/
+MOCKABLE_FUNCTION(, DEADLINE_HEAP_ENTRY_HANDLE, deadline_heap_add, DEADLINE_HEAP_HANDLE, heap, tickcounter_ms_t, deadline, void*, value);
+
+/**
+* @brief	Removes an entry before it expires and releases it.
+*
+* @param	heap	A @c DEADLINE_HEAP_HANDLE obtained using deadline_heap_create.
+*
+* @param	entry	A @c DEADLINE_HEAP_ENTRY_HANDLE obtained using deadline_heap_add. NULL is ignored.
+*/
+MOCKABLE_FUNCTION(, void, deadline_heap_remove, DEADLINE_HEAP_HANDLE, heap, DEADLINE_HEAP_ENTRY_HANDLE, entry);
+
+/**
+* @brief	Removes the entry with the earliest deadline if that deadline has been reached.
+*
+* @remarks	The entry is released, so its @c DEADLINE_HEAP_ENTRY_HANDLE must not be used afterwards.
+*
+* @param	heap	A @c DEADLINE_HEAP_HANDLE obtained using deadline_heap_create.
+*
+* @param	current_ms	The current tick count (in milliseconds).
+*
+* @returns	The value of the expired entry, or NULL if no entry has expired.
+*/
+MOCKABLE_FUNCTION(, void*, deadline_heap_pop_expired, DEADLINE_HEAP_HANDLE, heap, tickcounter_ms_t, current_ms);
+
+/**
+* @brief	Gets the earliest deadline in the heap without removing its entry.
+*
+* @param	heap	A @c DEADLINE_HEAP_HANDLE obtained using deadline_heap_create.
+*
+* @param	deadline	Receives the earliest deadline, as a tick count in milliseconds.
+*
+* @returns	true if the heap has an entry, false if it is empty or an argument is NULL.
+*/
+MOCKABLE_FUNCTION(, bool, deadline_heap_peek_deadline, DEADLINE_HEAP_HANDLE, heap, tickcounter_ms_t*, deadline);
+
+/**
+* @brief	Gets the number of entries currently in the heap.
+*
+* @param	heap	A @c DEADLINE_HEAP_HANDLE obtained using deadline_heap_create.
+*
+* @returns	The number of entries in the heap, or zero if @c heap is NULL.
+*/
+MOCKABLE_FUNCTION(, size_t, deadline_heap_get_count, DEADLINE_HEAP_HANDLE, heap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*DEADLINE_HEAP_H*/
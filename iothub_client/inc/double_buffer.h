@@ -0,0 +1,89 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	double_buffer.h
+*	@brief	Two pre-sized arrays of fixed-size elements: one being filled while the other is read.
+*
+*	@details	Elements are copied into the write side. A swap hands the write side to the reader
+*				and recycles the side that was read before as the new, empty write side, so once both
+*				sides have grown to the usual batch size filling and reading never allocate.
+*				The double buffer does not lock: the caller serializes the writers and the swap, and
+*				only one reader may use the read side between two swaps.
+*/
+
+#ifndef DOUBLE_BUFFER_H
+#define DOUBLE_BUFFER_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct DOUBLE_BUFFER_TAG* DOUBLE_BUFFER_HANDLE;
+
+/**
+* @brief	Creates a double buffer with room for @c initialCapacity elements on each side.
+*
+* @param	elementSize		The size in bytes of one element. Must be greater than 0.
+*
+* @param	initialCapacity	The number of elements each side can hold before it grows. Must be greater than 0.
+*
+* @returns	A non-NULL @c DOUBLE_BUFFER_HANDLE value that is used when invoking other API functions.
+*/
+MOCKABLE_FUNCTION(, DOUBLE_BUFFER_HANDLE, double_buffer_create, size_t, elementSize, size_t, initialCapacity);
+
+/**
+* @brief	Frees both sides of the double buffer.
+*
+* @param	handle	A @c DOUBLE_BUFFER_HANDLE obtained using double_buffer_create.
+*/
+MOCKABLE_FUNCTION(, void, double_buffer_destroy, DOUBLE_BUFFER_HANDLE, handle);
+
+/**
+* @brief	Copies an element at the end of the write side, doubling its capacity if it is full.
+*
+* @param	handle	A @c DOUBLE_BUFFER_HANDLE obtained using double_buffer_create.
+*
+* @param	element	The element to copy.
+*
+* @returns	0 on success, a non-zero value if the write side could not grow.
+*/
+MOCKABLE_FUNCTION(, int, double_buffer_push, DOUBLE_BUFFER_HANDLE, handle, const void*, element);
+
+/**
+* @brief	Gets the number of elements in the write side.
+*
+* @param	handle	A @c DOUBLE_BUFFER_HANDLE obtained using double_buffer_create.
+*/
+MOCKABLE_FUNCTION(, size_t, double_buffer_get_count, DOUBLE_BUFFER_HANDLE, handle);
+
+/**
+* @brief	Makes the write side readable and empties the previous read side to receive the next elements.
+*
+* @remarks	The elements of the previous read side are dropped, the reader must be done with them.
+*
+* @param	handle	A @c DOUBLE_BUFFER_HANDLE obtained using double_buffer_create.
+*
+* @returns	The number of elements that can now be read with double_buffer_get_element.
+*/
+MOCKABLE_FUNCTION(, size_t, double_buffer_swap, DOUBLE_BUFFER_HANDLE, handle);
+
+/**
+* @brief	Gets an element of the read side.
+*
+* @param	handle	A @c DOUBLE_BUFFER_HANDLE obtained using double_buffer_create.
+*
+* @param	index	The index of the element, lower than the value returned by the last double_buffer_swap.
+*
+* @returns	A pointer to the element, valid until the next double_buffer_swap, or NULL if @c index is out of range.
+*/
+MOCKABLE_FUNCTION(, void*, double_buffer_get_element, DOUBLE_BUFFER_HANDLE, handle, size_t, index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DOUBLE_BUFFER_H */
@@ -0,0 +1,53 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	http_batch_payload.h
+*	@brief	Serializes telemetry messages as the items of the JSON array the HTTP transport sends in a batch.
+*/
+
+#ifndef HTTP_BATCH_PAYLOAD_H
+#define HTTP_BATCH_PAYLOAD_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_message.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+* @brief	Measures the item of a message in a batch, {"body":...[,"properties":{...}]} followed by a comma.
+*
+* @param	message			The message to measure.
+*
+* @param	item_size		Receives the exact number of bytes http_batch_payload_write_item writes for the message.
+*
+* @param	message_size	Receives the size the message counts for in the limit of a batch: the size of its
+*							payload and of its properties, with their overheads.
+*
+* @returns	0 on success, or a non-zero value if the message cannot be serialized.
+*/
+MOCKABLE_FUNCTION(, int, http_batch_payload_measure_item, IOTHUB_MESSAGE_HANDLE, message, size_t*, item_size, size_t*, message_size);
+
+/**
+* @brief	Writes the item of a message in a batch, encoding its payload directly into @c destination.
+*
+* @param	message			The message to write.
+*
+* @param	destination		Where the item is written, not null terminated.
+*
+* @param	capacity		The number of bytes @c destination has room for.
+*
+* @param	item_size		Receives the number of bytes written, as measured by http_batch_payload_measure_item.
+*
+* @returns	0 on success, or a non-zero value if the message cannot be serialized or its item does not fit in @c capacity bytes.
+*/
+MOCKABLE_FUNCTION(, int, http_batch_payload_write_item, IOTHUB_MESSAGE_HANDLE, message, unsigned char*, destination, size_t, capacity, size_t*, item_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*HTTP_BATCH_PAYLOAD_H*/
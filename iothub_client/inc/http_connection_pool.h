@@ -0,0 +1,81 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	http_connection_pool.h
+*	@brief	Worker threads that each own a keep-alive HTTPAPIEX connection, used to run the HTTP requests of
+*			several devices at the same time.
+*/
+
+#ifndef HTTP_CONNECTION_POOL_H
+#define HTTP_CONNECTION_POOL_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "azure_c_shared_utility/httpapiex.h"
+#include "azure_c_shared_utility/optionhandler.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct HTTP_CONNECTION_POOL_TAG* HTTP_CONNECTION_POOL_HANDLE;
+
+/**
+* @brief	Does the work of one item, sending its requests through @c connection. The items of a run are done
+*			at the same time on different threads, each with a connection no other thread is using.
+*/
+typedef void(*HTTP_CONNECTION_POOL_WORK)(void* context, size_t item, HTTPAPIEX_HANDLE connection);
+
+/**
+* @brief	Creates @c connectionCount connections to @c hostName, each with its own worker thread.
+*
+* @param	hostName		The host the connections go to.
+*
+* @param	connectionCount	The number of connections and of worker threads, at least 1.
+*
+* @param	options			The options every connection is given when it is created, can be NULL.
+*
+* @returns	A handle to the pool, or NULL on failure.
+*/
+MOCKABLE_FUNCTION(, HTTP_CONNECTION_POOL_HANDLE, http_connection_pool_create, const char*, hostName, size_t, connectionCount, OPTIONHANDLER_HANDLE, options);
+
+/**
+* @brief	Stops the worker threads and closes their connections.
+*/
+MOCKABLE_FUNCTION(, void, http_connection_pool_destroy, HTTP_CONNECTION_POOL_HANDLE, pool);
+
+/**
+* @brief	Sets an option on every connection of the pool by calling HTTPAPIEX_SetOption. Must not be called
+*			while http_connection_pool_run runs.
+*
+* @returns	0 on success, or a non-zero value if the option could not be set on one of the connections.
+*/
+MOCKABLE_FUNCTION(, int, http_connection_pool_set_option, HTTP_CONNECTION_POOL_HANDLE, pool, const char*, optionName, const void*, value);
+
+/**
+* @brief	Does @c itemCount items, handing them out in the order @c firstItem, @c firstItem + 1, ... (modulo
+*			@c itemCount) to the calling thread and to the worker threads as soon as each one is free, so that
+*			a slow item only holds up its own connection. Returns once every item is done.
+*
+* @param	pool				The pool, which runs one set of items at a time.
+*
+* @param	callerConnection	The connection the items done on the calling thread use.
+*
+* @param	itemCount			The number of items.
+*
+* @param	firstItem			The item handed out first.
+*
+* @param	work				Called once for each item.
+*
+* @param	context				Passed to @c work.
+*
+* @returns	0 on success, or a non-zero value if an argument is invalid, in which case no item was done.
+*/
+MOCKABLE_FUNCTION(, int, http_connection_pool_run, HTTP_CONNECTION_POOL_HANDLE, pool, HTTPAPIEX_HANDLE, callerConnection, size_t, itemCount, size_t, firstItem, HTTP_CONNECTION_POOL_WORK, work, void*, context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*HTTP_CONNECTION_POOL_H*/
@@ -21,6 +21,7 @@ typedef struct IOTHUB_CLIENT_INSTANCE_TAG* IOTHUB_CLIENT_HANDLE;
 #endif // IOTHUB_CLIENT_INSTANCE
 
 #include "iothubtransport.h"
+#include "iothub_client_pool.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -118,6 +119,12 @@ extern "C"
     *			@b NOTE: The application behavior is undefined if the user calls
     *			the ::IoTHubClient_Destroy function from within any callback.
     *
+    *			@b NOTE: Unless the send queue is limited with ::OPTION_MAX_QUEUED_MESSAGES
+    *			or ::OPTION_MAX_QUEUED_BYTES, the message is only queued here and handed to
+    *			the lower layer by the worker thread. Failures of the lower layer are then
+    *			reported by calling @p eventConfirmationCallback with
+    *			IOTHUB_CLIENT_CONFIRMATION_ERROR instead of by the return value.
+    *
     * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SendEventAsync, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
@@ -136,6 +143,20 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_GetSendStatus, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATUS*, iotHubClientStatus);
 
+    /**
+    * @brief	This function returns how many events IoTHubClient holds and how many bytes
+    * 			of payload they add up to, so producers can slow down before the limits set
+    * 			with "max_queued_messages" and "max_queued_bytes" are reached.
+    *
+    * @param	iotHubClientHandle		The handle created by a call to the create function.
+    * @param	messageCount			Receives the number of events accepted and not yet
+    * 									confirmed.
+    * @param	byteCount				Receives the total payload size of these events.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_GetSendQueueStatus, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, size_t*, messageCount, size_t*, byteCount);
+
     /**
     * @brief	Sets up the message callback to be invoked when IoT Hub issues a
     * 			message to the device. This is a blocking call.
@@ -268,6 +289,22 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SetOption, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, const char*, optionName, const void*, value);
 
+    /**
+    * @brief	Makes the client use the threads of a worker pool instead of creating its own
+    *			worker thread.
+    *
+    * @param	iotHubClientHandle		The handle created by a call to the create function.
+    * @param	poolHandle				The handle created by a call to IoTHubClientPool_Create.
+    *
+    * @remarks	Must be called before any function that starts the worker thread, and
+    *			cannot be used with a client that shares its transport. The pool must
+    *			outlive the client. IoTHubClient_Destroy may be called from a callback of
+    *			the client, the client is then destroyed once that callback returns.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SetWorkerPool, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_POOL_HANDLE, poolHandle);
+
     /**
     * @brief	This API specifies a call back to be used when the device receives a state update.
     *
@@ -38,7 +38,8 @@
     IOTHUB_CLIENT_INVALID_ARG,            \
     IOTHUB_CLIENT_ERROR,                  \
     IOTHUB_CLIENT_INVALID_SIZE,           \
-    IOTHUB_CLIENT_INDEFINITE_TIME
+    IOTHUB_CLIENT_INDEFINITE_TIME,        \
+    IOTHUB_CLIENT_QUEUE_FULL
 
 /** @brief Enumeration specifying the status of calls to various APIs in this module.
 */
@@ -60,6 +61,21 @@ DEFINE_ENUM(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_RESULT_VALUES);
 */
 DEFINE_ENUM(IOTHUB_CLIENT_RETRY_POLICY, IOTHUB_CLIENT_RETRY_POLICY_VALUES);
 
+#define IOTHUB_CLIENT_QUEUE_OVERFLOW_POLICY_VALUES \
+    IOTHUB_CLIENT_QUEUE_OVERFLOW_REJECT,           \
+    IOTHUB_CLIENT_QUEUE_OVERFLOW_DROP_OLDEST,      \
+    IOTHUB_CLIENT_QUEUE_OVERFLOW_BLOCK
+
+/** @brief Enumeration passed with the "queue_overflow_policy" option to choose what
+*		   happens to a new event when the send queue is at one of its limits:
+*		   @c IOTHUB_CLIENT_QUEUE_OVERFLOW_REJECT fails the send with IOTHUB_CLIENT_QUEUE_FULL,
+*		   @c IOTHUB_CLIENT_QUEUE_OVERFLOW_DROP_OLDEST completes the oldest events not yet taken
+*		   by the transport with IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT to make room and
+*		   @c IOTHUB_CLIENT_QUEUE_OVERFLOW_BLOCK makes IoTHubClient_SendEventAsync wait for room
+*		   (IoTHubClient_LL, which cannot wait, rejects the event instead).
+*/
+DEFINE_ENUM(IOTHUB_CLIENT_QUEUE_OVERFLOW_POLICY, IOTHUB_CLIENT_QUEUE_OVERFLOW_POLICY_VALUES);
+
 struct IOTHUBTRANSPORT_CONFIG_TAG;
 typedef struct IOTHUBTRANSPORT_CONFIG_TAG IOTHUBTRANSPORT_CONFIG;
 
@@ -357,6 +373,20 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetSendStatus, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATUS*, iotHubClientStatus);
 
+    /**
+    * @brief	This function returns how many events IoTHubClient holds and how many bytes
+    * 			of payload they add up to, counted against the "max_queued_messages" and
+    * 			"max_queued_bytes" options.
+    *
+    * @param	iotHubClientHandle		The handle created by a call to the create function.
+    * @param	messageCount			Receives the number of events accepted and not yet
+    * 									confirmed, including those the transport is sending.
+    * @param	byteCount				Receives the total payload size of these events.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetSendQueueStatus, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, size_t*, messageCount, size_t*, byteCount);
+
     /**
     * @brief	Sets up the message callback to be invoked when IoT Hub issues a
     * 			message to the device. This is a blocking call.
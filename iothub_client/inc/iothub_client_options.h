@@ -31,9 +31,17 @@ extern "C"
     static const char* OPTION_CBS_REQUEST_TIMEOUT = "cbs_request_timeout";
 
     static const char* OPTION_MIN_POLLING_TIME = "MinimumPollingTime";
+    static const char* OPTION_MAX_POLLING_TIME = "MaximumPollingTime";
+    static const char* OPTION_HTTP_CONNECTION_COUNT = "HttpConnectionCount";
     static const char* OPTION_BATCHING = "Batching";
 
     static const char* OPTION_MESSAGE_TIMEOUT = "messageTimeout";
+    /*
+    * @brief Longest time, in seconds, a reported state sent over MQTT waits for the response of the service. Once it is reached the reported
+    *        state callback is called with status code 408 (timeout). The value is a size_t, the default 0 means the reported state waits for
+    *        its response until the client is destroyed.
+    */
+    static const char* OPTION_REPORTED_STATE_TIMEOUT_SECS = "reported_state_timeout_secs";
     static const char* OPTION_PRODUCT_INFO = "product_info";
     /*
     * @brief Informs the service of what is the maximum period the client will wait for a keep-alive message from the service.
@@ -52,9 +60,62 @@ extern "C"
 	*/
 	static const char* OPTION_REMOTE_IDLE_TIMEOUT_RATIO = "cl2svc_keep_alive_send_ratio"; 
 
+    /*
+    * @brief Batching of the events sent over AMQP. With "amqp_batch_linger_ms" above 0, events are held for up to that many milliseconds so more of
+    *        them go in one AMQP transfer, as long as new events keep coming; they are sent right away once no event came since the previous DoWork,
+    *        or once "amqp_batch_max_messages" events or "amqp_batch_max_bytes" bytes of payload are waiting. The two limits also cap the size of each
+    *        batch, which is never above what the service accepts. The values are size_t, the default 0 means no lingering and no limit of its own.
+    */
+    static const char* OPTION_AMQP_BATCH_LINGER_MS = "amqp_batch_linger_ms";
+    static const char* OPTION_AMQP_BATCH_MAX_BYTES = "amqp_batch_max_bytes";
+    static const char* OPTION_AMQP_BATCH_MAX_MESSAGES = "amqp_batch_max_messages";
+
     //diagnostic sampling percentage value, [0-100]
     static const char* OPTION_DIAGNOSTIC_SAMPLING_PERCENTAGE = "diag_sampling_percentage";
 
+    /*
+    * @brief Longest time, in milliseconds, the IoTHubClient worker thread waits between two DoWork calls while it has nothing to do.
+    *        The worker is woken right away when a message, a reported state or a method response is queued, and the thread of an IoTHubClient
+    *        never waits past the next message timeout. It is not woken by data arriving on the socket, nor by the SAS token renewal and
+    *        keep-alive deadlines of the transport, which are only handled by the next DoWork: raising the option adds up to its value in
+    *        milliseconds to the latency of cloud-to-device messages, method calls and twin updates, and to token renewal and keep-alive pings.
+    *        For a client driven by a worker pool it bounds the wait of the pool I/O thread driving it.
+    *        The value is an unsigned int, the maximum is 1000. The default is 1, which keeps the threads polling every millisecond as they always did;
+    *        a larger value lets an idle thread back off up to that wait.
+    */
+    static const char* OPTION_WORKER_MAX_IDLE_WAIT = "worker_max_idle_wait";
+
+    /*
+    * @brief Limits of the send queue: the number of events and the total payload size, in bytes, IoTHubClient holds from the time they are sent
+    *        until they are confirmed. The values are size_t, the default 0 means no limit. Lowering a limit does not drop events already queued.
+    */
+    static const char* OPTION_MAX_QUEUED_MESSAGES = "max_queued_messages";
+    static const char* OPTION_MAX_QUEUED_BYTES = "max_queued_bytes";
+
+    /*
+    * @brief What happens to an event that does not fit in the send queue, the value is an IOTHUB_CLIENT_QUEUE_OVERFLOW_POLICY and the default is
+    *        IOTHUB_CLIENT_QUEUE_OVERFLOW_REJECT. An event bigger than "max_queued_bytes" on its own is always rejected with IOTHUB_CLIENT_INVALID_SIZE.
+    */
+    static const char* OPTION_QUEUE_OVERFLOW_POLICY = "queue_overflow_policy";
+
+    /*
+    * @brief Longest time, in milliseconds, IoTHubClient_SendEventAsync waits for room in the send queue with IOTHUB_CLIENT_QUEUE_OVERFLOW_BLOCK
+    *        before returning IOTHUB_CLIENT_QUEUE_FULL. The value is an unsigned int, the default is 0 (do not wait). Not used by IoTHubClient_LL.
+    */
+    static const char* OPTION_QUEUE_BLOCK_TIMEOUT = "queue_block_timeout";
+
+    /*
+    * @brief Directory where IoTHubClient_LL keeps the events sent, until they are confirmed, so they survive a restart. The value is a const char*
+    *        and can be set only once; the events a previous run left there are sent first. With a store, "max_queued_messages" and "max_queued_bytes"
+    *        bound the events read back from disk at a time and the overflow policy is not used. Not available when built with dont_use_message_store.
+    */
+    static const char* OPTION_MESSAGE_STORE_PATH = "message_store_path";
+
+    /*
+    * @brief Size, in bytes, after which the message store continues in a new file. The value is a size_t, set before "message_store_path", the default is 1 MiB.
+    */
+    static const char* OPTION_MESSAGE_STORE_SEGMENT_SIZE = "message_store_segment_size";
+
 #ifdef __cplusplus
 }
 #endif
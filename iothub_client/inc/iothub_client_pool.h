@@ -0,0 +1,102 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	iothub_client_pool.h
+*	@brief	A fixed set of worker threads shared by many IoTHubClient instances.
+*
+*	@details	By default every IoTHubClient that does not share a transport creates its own
+*				worker thread. An IoTHubClient pool instead drives all the clients attached to it
+*				from a fixed number of I/O threads, which steal clients from each other when they
+*				run out of work. A client is only ever driven by one I/O thread at a time.
+*				User callbacks can be dispatched on a separate set of threads so that a slow
+*				callback does not delay the I/O of other clients.
+*/
+
+#ifndef IOTHUB_CLIENT_POOL_H
+#define IOTHUB_CLIENT_POOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct IOTHUB_CLIENT_POOL_TAG* IOTHUB_CLIENT_POOL_HANDLE;
+typedef struct IOTHUB_CLIENT_POOL_CLIENT_TAG* IOTHUB_CLIENT_POOL_CLIENT_HANDLE;
+
+/* Performs the I/O of one client; returns true if the client has user callbacks waiting to be dispatched.
+   Lowers *maxWaitMs when the client needs to be driven again sooner than that. */
+typedef bool(*IOTHUB_CLIENT_POOL_DO_WORK)(void* client, unsigned int* maxWaitMs);
+/* Dispatches the user callbacks of one client. */
+typedef void(*IOTHUB_CLIENT_POOL_DISPATCH)(void* client);
+
+    /**
+    * @brief	Creates a pool of worker threads that can drive many IoTHubClient instances.
+    *
+    * @param	ioThreadCount		The number of threads calling IoTHubClient_LL_DoWork on the attached clients. Must be greater than 0.
+    * @param	callbackThreadCount	The number of threads dispatching user callbacks. If 0, the callbacks are
+    *								dispatched by the I/O thread that collected them.
+    *
+    * @return	A non-NULL @c IOTHUB_CLIENT_POOL_HANDLE on success, @c NULL on failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_POOL_HANDLE, IoTHubClientPool_Create, size_t, ioThreadCount, size_t, callbackThreadCount);
+
+    /**
+    * @brief	Stops and joins the threads of the pool and frees it.
+    *
+    * @remarks	All the IoTHubClient instances using the pool must have been destroyed before.
+    *
+    * @param	poolHandle	The handle created by a call to IoTHubClientPool_Create.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClientPool_Destroy, IOTHUB_CLIENT_POOL_HANDLE, poolHandle);
+
+    /**
+    * @brief	Attaches a client to the pool. Used by IoTHubClient, applications use IoTHubClient_SetWorkerPool.
+    *
+    * @param	poolHandle	The handle created by a call to IoTHubClientPool_Create.
+    * @param	client		The context passed to @p doWork and @p dispatch.
+    * @param	doWork		Called repeatedly by one I/O thread at a time.
+    * @param	dispatch	Called when @p doWork reported user callbacks, never concurrently for the same client.
+    *
+    * @return	A handle used to signal and detach the client, @c NULL on failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_POOL_CLIENT_HANDLE, IoTHubClientPool_AddClient, IOTHUB_CLIENT_POOL_HANDLE, poolHandle, void*, client, IOTHUB_CLIENT_POOL_DO_WORK, doWork, IOTHUB_CLIENT_POOL_DISPATCH, dispatch);
+
+    /**
+    * @brief	Wakes the I/O thread driving the client so that queued work is sent without waiting.
+    *
+    * @param	poolClientHandle	The handle returned by IoTHubClientPool_AddClient.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClientPool_SignalClient, IOTHUB_CLIENT_POOL_CLIENT_HANDLE, poolClientHandle);
+
+    /**
+    * @brief	Detaches a client from the pool, waiting for any thread of the pool still using it.
+    *
+    * @remarks	When called from @p doWork or @p dispatch of the same client, the call does not wait for
+    *			the calling thread, which frees the handle once @p doWork or @p dispatch returns. Recognizing
+    *			that calling thread needs thread local storage, without it use IoTHubClientPool_RemoveClientFromDispatch.
+    *
+    * @param	poolClientHandle	The handle returned by IoTHubClientPool_AddClient. It is freed by this call
+    *								or, as described above, by the thread of the pool running the client.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClientPool_RemoveClient, IOTHUB_CLIENT_POOL_CLIENT_HANDLE, poolClientHandle);
+
+    /**
+    * @brief	Detaches a client from the pool from @p dispatch of the same client, waiting for any other thread of the pool still using it.
+    *
+    * @remarks	Unlike IoTHubClientPool_RemoveClient, it does not need thread local storage to know that
+    *			the calling thread is dispatching the client.
+    *
+    * @param	poolClientHandle	The handle returned by IoTHubClientPool_AddClient. It is freed by the calling thread
+    *								once @p dispatch returns.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClientPool_RemoveClientFromDispatch, IOTHUB_CLIENT_POOL_CLIENT_HANDLE, poolClientHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_POOL_H */
@@ -32,6 +32,23 @@ extern "C"
 #define API_VERSION "?api-version=2016-11-14"
 #define REJECT_QUERY_PARAMETER "&reject"
 
+/*the message store keeps its events in files it syncs with fsync, which mbed does not provide*/
+#if defined(MBED_BUILD_TIMESTAMP) && !defined(DONT_USE_MESSAGE_STORE)
+#define DONT_USE_MESSAGE_STORE
+#endif
+
+/*storage class of the per thread state the worker threads use to recognize calls made from the user callbacks they run,
+left undefined for the compilers and runtimes without thread local storage (ARMCC, IAR, TI), where the worker threads keep that state in the client instead*/
+#if defined(__ARMCC_VERSION) || defined(__IAR_SYSTEMS_ICC__) || defined(__TI_COMPILER_VERSION__)
+/*these accept __thread or _Thread_local in some modes but their embedded runtimes do not back it*/
+#elif defined(_MSC_VER)
+#define IOTHUB_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+#define IOTHUB_THREAD_LOCAL __thread
+#elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_THREADS__)
+#define IOTHUB_THREAD_LOCAL _Thread_local
+#endif
+
 typedef bool(*IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC_EX)(MESSAGE_CALLBACK_INFO* messageData, void* userContextCallback);
 
 MOCKABLE_FUNCTION(, void, IoTHubClient_LL_SendComplete, IOTHUB_CLIENT_LL_HANDLE, handle, PDLIST_ENTRY, completed, IOTHUB_CLIENT_CONFIRMATION_RESULT, result);
@@ -51,8 +68,26 @@ typedef struct IOTHUB_MESSAGE_LIST_TAG
     void* context; 
     DLIST_ENTRY entry;
     tickcounter_ms_t ms_timesOutAfter; /* a value of "0" means "no timeout", if the IOTHUBCLIENT_LL's handle tickcounter > msTimesOutAfer then the message shall timeout*/
+    /*set by IoTHubClient_LL when it accepts the message: callback and context are then replaced by its own to keep the send queue accounting*/
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK userCallback;
+    void* userContext;
+    size_t queuedBytes;
+    IOTHUB_CLIENT_LL_HANDLE owner;
+    uint64_t queueSequenceNumber; /*order in which the message entered waitingToSend*/
+    struct DEADLINE_HEAP_ENTRY_TAG* deadlineEntry; /*the entry of the message in the index of deadlines of IoTHubClient_LL, NULL once it is out of it*/
+#ifndef DONT_USE_MESSAGE_STORE
+    /*set when the message was read back from the message store, its record is completed once the message is confirmed*/
+    bool isStored;
+    uint64_t storeRecordId;
+#endif
 }IOTHUB_MESSAGE_LIST;
 
+/* Queues an event whose message was already cloned by the caller; takes ownership of newEntry on success. */
+MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventEntry, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_LIST*, newEntry);
+
+/* Gets how long the caller can wait before IoTHubClient_LL_DoWork has a message to time out; false when no queued message has a timeout. */
+MOCKABLE_FUNCTION(, bool, IoTHubClient_LL_GetTimeToNextDeadline, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, tickcounter_ms_t*, timeToDeadlineMs);
+
 typedef struct IOTHUB_DEVICE_TWIN_TAG
 {
     uint32_t item_id;
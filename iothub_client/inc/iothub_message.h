@@ -65,6 +65,31 @@ static const char DIAG_CREATION_TIME_UTC_PROPERTY_NAME[] = "diag_creation_time_u
 */
 MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromByteArray, const unsigned char*, byteArray, size_t, size);
 
+/** @brief  Gives back to the application a buffer adopted by IoTHubMessage_CreateFromBufferNoCopy. */
+typedef void(*IOTHUB_MESSAGE_BUFFER_RELEASE_CALLBACK)(unsigned char* buffer, void* context);
+
+/**
+* @brief   Creates a new IoT hub message whose payload is @p buffer itself,
+*          without copying it. The type of the message will be set to
+*          @c IOTHUBMESSAGE_BYTEARRAY. The transports may still copy
+*          the payload when they send the message: MQTT and single-event
+*          HTTP do.
+*
+* @param   buffer          The payload of the message. It must not change
+*                          until it is released.
+* @param   size            The size of the buffer.
+* @param   releaseCallback Called with @p buffer and @p context once the
+*                          message and all its clones are destroyed, for
+*                          instance to free it. May be @c NULL if the
+*                          buffer outlives every message using it.
+* @param   context         Passed to @p releaseCallback.
+*
+* @return  A valid @c IOTHUB_MESSAGE_HANDLE if the message was successfully
+*          created or @c NULL in case an error occurs, in which case the
+*          buffer stays with the caller and @p releaseCallback is not called.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromBufferNoCopy, unsigned char*, buffer, size_t, size, IOTHUB_MESSAGE_BUFFER_RELEASE_CALLBACK, releaseCallback, void*, context);
+
 /**
 * @brief   Creates a new IoT hub message from a null terminated string.  The
 *          type of the message will be set to @c IOTHUBMESSAGE_STRING.
@@ -174,10 +199,65 @@ MOCKABLE_FUNCTION(, const char*, IoTHubMessage_GetContentEncodingSystemProperty,
 *
 * @param   iotHubMessageHandle Handle to the message.
 *
+* @remarks The map is read when the message is cloned or read with
+*          IoTHubMessage_GetPropertyTable. Call IoTHubMessage_Properties
+*          again before changing the properties afterwards.
+*
 * @return  A @c MAP_HANDLE pointing to the properties map for this message.
 */
 MOCKABLE_FUNCTION(, MAP_HANDLE, IoTHubMessage_Properties, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
 
+/** @brief  An application property of a message. The key and the value are null terminated. */
+typedef struct IOTHUB_MESSAGE_PROPERTY_TAG
+{
+    const char* key;
+    size_t keyLength;
+    const char* value;
+    size_t valueLength;
+} IOTHUB_MESSAGE_PROPERTY;
+
+/**
+* @brief   Gets the application properties of the message, in the order
+*          they were added, without copying them.
+*
+* @param   iotHubMessageHandle Handle to the message.
+* @param   properties          Receives the properties, valid until the
+*                              message is destroyed or
+*                              IoTHubMessage_Properties or
+*                              IoTHubMessage_SetProperties is called on it.
+* @param   count               Receives the number of properties.
+*
+* @return  Returns IOTHUB_MESSAGE_OK if the properties were retrieved
+*          successfully or an error code otherwise.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_GetPropertyTable, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, const IOTHUB_MESSAGE_PROPERTY**, properties, size_t*, count);
+
+/**
+* @brief   Gets the value of an application property of the message.
+*
+* @param   iotHubMessageHandle Handle to the message.
+* @param   key                 The key of the property.
+*
+* @return  The value of the property, or NULL if the message does not have it.
+*/
+MOCKABLE_FUNCTION(, const char*, IoTHubMessage_GetProperty, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, const char*, key);
+
+/**
+* @brief   Replaces all the application properties of the message with
+*          copies of @p properties, in a single allocation.
+*
+* @param   iotHubMessageHandle Handle to the message.
+* @param   properties          The properties. Their keys and values do not
+*                              need to be null terminated.
+* @param   count               The number of properties. When a key is
+*                              repeated, its last value is kept.
+*
+* @return  Returns IOTHUB_MESSAGE_OK if the properties were set successfully,
+*          IOTHUB_MESSAGE_INVALID_ARG if a key or a value is not printable
+*          US-ASCII, or an error code otherwise.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_SetProperties, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, const IOTHUB_MESSAGE_PROPERTY*, properties, size_t, count);
+
 /**
 * @brief   Gets the MessageId from the IOTHUB_MESSAGE_HANDLE.
 *
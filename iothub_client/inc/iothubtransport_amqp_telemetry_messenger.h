@@ -17,6 +17,9 @@ extern "C"
 
 static const char* MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS = "telemetry_event_send_timeout_secs";
 static const char* MESSENGER_OPTION_SAVED_OPTIONS = "saved_telemetry_messenger_options";
+static const char* MESSENGER_OPTION_BATCH_LINGER_MS = "telemetry_batch_linger_ms";
+static const char* MESSENGER_OPTION_BATCH_MAX_BYTES = "telemetry_batch_max_bytes";
+static const char* MESSENGER_OPTION_BATCH_MAX_MESSAGES = "telemetry_batch_max_messages";
 
 typedef struct TELEMETRY_MESSENGER_INSTANCE* TELEMETRY_MESSENGER_HANDLE;
 
@@ -0,0 +1,110 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	message_store.h
+*	@brief	An append-only log of events kept on disk until they are completed.
+*
+*	@details	The log is a sequence of segment files in a directory, next to a checkpoint
+*				file recording where the first event not yet completed starts. Opening a store
+*				replays the events found after the checkpoint, which are read back before the
+*				ones appended afterwards. Appends and completions are made durable together by
+*				message_store_sync.
+*/
+
+#ifndef MESSAGE_STORE_H
+#define MESSAGE_STORE_H
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_message.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct MESSAGE_STORE_TAG* MESSAGE_STORE_HANDLE;
+
+#define MESSAGE_STORE_DEFAULT_SEGMENT_SIZE  (1024 * 1024)
+
+/**
+* @brief	Opens the store kept in @c directory, replaying the events it holds.
+*
+* @param	directory	An existing directory, used only by this store.
+*
+* @param	segmentSize	The size, in bytes, after which appends continue in a new segment file.
+*
+* @returns	A non-NULL @c MESSAGE_STORE_HANDLE value that is used when invoking other API functions.
+*/
+MOCKABLE_FUNCTION(, MESSAGE_STORE_HANDLE, message_store_open, const char*, directory, size_t, segmentSize);
+
+/**
+* @brief	Syncs the store and closes it. The events not completed stay on disk.
+*
+* @param	store	A @c MESSAGE_STORE_HANDLE obtained using message_store_open.
+*/
+MOCKABLE_FUNCTION(, void, message_store_close, MESSAGE_STORE_HANDLE, store);
+
+/**
+* @brief	Appends a copy of @c message at the end of the log.
+*
+* @remarks	The event is durable only once message_store_sync returned.
+*
+* @param	store	A @c MESSAGE_STORE_HANDLE obtained using message_store_open.
+*
+* @param	message	The message to store. Its payload, message id, correlation id, content type,
+*					content encoding and properties are kept.
+*
+* @param	recordId	Receives the id message_store_read will return along with the copy of @c message.
+*
+* @returns	0 on success, a non-zero value otherwise.
+*/
+MOCKABLE_FUNCTION(, int, message_store_append, MESSAGE_STORE_HANDLE, store, IOTHUB_MESSAGE_HANDLE, message, uint64_t*, recordId);
+
+/**
+* @brief	Reads back the next event of the log, replayed events first.
+*
+* @param	store	A @c MESSAGE_STORE_HANDLE obtained using message_store_open.
+*
+* @param	recordId	Receives the id to pass to message_store_complete. Ids follow the order of the log.
+*
+* @returns	A new message owned by the caller, or NULL if every event has been read or on failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, message_store_read, MESSAGE_STORE_HANDLE, store, uint64_t*, recordId);
+
+/**
+* @brief	Marks an event read with message_store_read as done, so it is not replayed anymore.
+*
+* @remarks	Events can be completed in any order, the checkpoint moves past an event once it
+*			and all the events before it are completed.
+*
+* @param	store	A @c MESSAGE_STORE_HANDLE obtained using message_store_open.
+*
+* @param	recordId	The id returned by message_store_read.
+*
+* @returns	0 on success, a non-zero value otherwise.
+*/
+MOCKABLE_FUNCTION(, int, message_store_complete, MESSAGE_STORE_HANDLE, store, uint64_t, recordId);
+
+/**
+* @brief	Makes the events appended and the checkpoint moved since the last call durable,
+*			with one flush of each file, and deletes the segment files left behind by the checkpoint.
+*
+* @param	store	A @c MESSAGE_STORE_HANDLE obtained using message_store_open.
+*
+* @returns	0 on success, a non-zero value otherwise.
+*/
+MOCKABLE_FUNCTION(, int, message_store_sync, MESSAGE_STORE_HANDLE, store);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*MESSAGE_STORE_H*/
@@ -0,0 +1,73 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	mpsc_queue.h
+*	@brief	An intrusive queue that many threads can push onto without taking a lock and
+*			that a single thread empties in one step.
+*
+*	@details	Items are linked through the @c Flink of a @c DLIST_ENTRY embedded in them, so
+*				pushing never allocates. Pushes use an atomic compare and swap where the
+*				compiler provides one (MSVC, gcc and clang) and fall back to a lock otherwise.
+*/
+
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <stdbool.h>
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct MPSC_QUEUE_TAG* MPSC_QUEUE_HANDLE;
+
+/**
+* @brief	Creates a new, empty instance of MPSC_QUEUE.
+*
+* @returns	A non-NULL @c MPSC_QUEUE_HANDLE value that is used when invoking other API functions.
+*/
+MOCKABLE_FUNCTION(, MPSC_QUEUE_HANDLE, mpsc_queue_create);
+
+/**
+* @brief	Destroys an instance of MPSC_QUEUE.
+*
+* @remarks	The items still in the queue are not owned by it and must be taken out with mpsc_queue_pop_all first.
+*
+* @param	queue	A @c MPSC_QUEUE_HANDLE obtained using mpsc_queue_create.
+*/
+MOCKABLE_FUNCTION(, void, mpsc_queue_destroy, MPSC_QUEUE_HANDLE, queue);
+
+/**
+* @brief	Adds an item to the queue. Safe to call from any number of threads at the same time.
+*
+* @param	queue	A @c MPSC_QUEUE_HANDLE obtained using mpsc_queue_create.
+*
+* @param	entry	The list entry embedded in the item. It must not be in any list until it is popped.
+*
+* @param	wasEmpty	Set to true if the queue was empty before the push, which is when the consumer needs to be woken up.
+*
+* @returns	0 if the item was added, or a non-zero value if it was not (only possible when the queue falls back to a lock).
+*/
+MOCKABLE_FUNCTION(, int, mpsc_queue_push, MPSC_QUEUE_HANDLE, queue, PDLIST_ENTRY, entry, bool*, wasEmpty);
+
+/**
+* @brief	Takes every item out of the queue and appends them, oldest first, to @c listHead.
+*
+* @remarks	Only one thread at a time may call this function on a given queue.
+*
+* @param	queue	A @c MPSC_QUEUE_HANDLE obtained using mpsc_queue_create.
+*
+* @param	listHead	An initialized list head the items are appended to.
+*
+* @returns	The number of items appended to @c listHead.
+*/
+MOCKABLE_FUNCTION(, size_t, mpsc_queue_pop_all, MPSC_QUEUE_HANDLE, queue, PDLIST_ENTRY, listHead);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MPSC_QUEUE_H */
@@ -0,0 +1,88 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	mqtt_inflight_table.h
+*	@brief	A table of in-flight MQTT publishes indexed by packet identifier.
+*/
+
+#ifndef MQTT_INFLIGHT_TABLE_H
+#define MQTT_INFLIGHT_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct MQTT_INFLIGHT_TABLE_TAG* MQTT_INFLIGHT_TABLE_HANDLE;
+
+/**
+* @brief	Creates a new instance of MQTT_INFLIGHT_TABLE.
+*
+* @param	initial_capacity	Number of entries the table can hold before it needs to grow. Zero selects a default value.
+*
+* @returns	A non-NULL @c MQTT_INFLIGHT_TABLE_HANDLE value that is used when invoking other API functions.
+*/
+MOCKABLE_FUNCTION(, MQTT_INFLIGHT_TABLE_HANDLE, mqtt_inflight_table_create, size_t, initial_capacity);
+
+/**
+* @brief	Destroys an instance of MQTT_INFLIGHT_TABLE, releasing all memory it allocated.
+*
+* @remarks	The values stored in the table are not owned by it and are not released.
+*
+* @param	table	A @c MQTT_INFLIGHT_TABLE_HANDLE obtained using mqtt_inflight_table_create.
+*/
+MOCKABLE_FUNCTION(, void, mqtt_inflight_table_destroy, MQTT_INFLIGHT_TABLE_HANDLE, table);
+
+/**
+* @brief	Associates @c value with the MQTT packet identifier @c packet_id.
+*
+* @param	table	A @c MQTT_INFLIGHT_TABLE_HANDLE obtained using mqtt_inflight_table_create.
+*
+* @param	packet_id	The MQTT packet identifier. Zero is not a valid packet identifier.
+*
+* @param	value	A non-NULL pointer to be returned on lookup.
+*
+* @returns	Zero if the no errors occur, non-zero otherwise (including if @c packet_id is already in the table).
+*/
+MOCKABLE_FUNCTION(, int, mqtt_inflight_table_add, MQTT_INFLIGHT_TABLE_HANDLE, table, uint16_t, packet_id, void*, value);
+
+/**
+* @brief	Looks up the value associated with @c packet_id.
+*
+* @param	table	A @c MQTT_INFLIGHT_TABLE_HANDLE obtained using mqtt_inflight_table_create.
+*
+* @param	packet_id	The MQTT packet identifier.
+*
+* @returns	The value associated with @c packet_id, or NULL if there is none.
+*/
+MOCKABLE_FUNCTION(, void*, mqtt_inflight_table_find, MQTT_INFLIGHT_TABLE_HANDLE, table, uint16_t, packet_id);
+
+/**
+* @brief	Removes @c packet_id from the table.
+*
+* @param	table	A @c MQTT_INFLIGHT_TABLE_HANDLE obtained using mqtt_inflight_table_create.
+*
+* @param	packet_id	The MQTT packet identifier.
+*
+* @returns	The value that was associated with @c packet_id, or NULL if there was none.
+*/
+MOCKABLE_FUNCTION(, void*, mqtt_inflight_table_remove, MQTT_INFLIGHT_TABLE_HANDLE, table, uint16_t, packet_id);
+
+/**
+* @brief	Gets the number of packet identifiers currently stored in the table.
+*
+* @param	table	A @c MQTT_INFLIGHT_TABLE_HANDLE obtained using mqtt_inflight_table_create.
+*
+* @returns	The number of entries in the table, or zero if @c table is NULL.
+*/
+MOCKABLE_FUNCTION(, size_t, mqtt_inflight_table_get_count, MQTT_INFLIGHT_TABLE_HANDLE, table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*MQTT_INFLIGHT_TABLE_H*/
@@ -0,0 +1,59 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	mqtt_telemetry_topic.h
+*	@brief	Builds the MQTT topic a telemetry message is published to, including its properties.
+*/
+
+#ifndef MQTT_TELEMETRY_TOPIC_H
+#define MQTT_TELEMETRY_TOPIC_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_message.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct MQTT_TELEMETRY_TOPIC_TAG* MQTT_TELEMETRY_TOPIC_HANDLE;
+
+/**
+* @brief	Creates a new instance of MQTT_TELEMETRY_TOPIC for a device.
+*
+* @param	device_id	The id of the device whose events topic ("devices/<device_id>/messages/events/") is built.
+*
+* @returns	A non-NULL @c MQTT_TELEMETRY_TOPIC_HANDLE value that is used when invoking other API functions.
+*/
+MOCKABLE_FUNCTION(, MQTT_TELEMETRY_TOPIC_HANDLE, mqtt_telemetry_topic_create, const char*, device_id);
+
+/**
+* @brief	Destroys an instance of MQTT_TELEMETRY_TOPIC, releasing the topic buffer it owns.
+*
+* @param	handle	A @c MQTT_TELEMETRY_TOPIC_HANDLE obtained using mqtt_telemetry_topic_create.
+*/
+MOCKABLE_FUNCTION(, void, mqtt_telemetry_topic_destroy, MQTT_TELEMETRY_TOPIC_HANDLE, handle);
+
+/**
+* @brief	Builds the topic for a telemetry message, appending its application and system properties.
+*
+* @remarks	The topic is written into a buffer owned by @c handle, which is reused by the next call.
+*			The returned string is only valid until mqtt_telemetry_topic_build or mqtt_telemetry_topic_destroy
+*			is called again on the same handle.
+*
+* @param	handle	A @c MQTT_TELEMETRY_TOPIC_HANDLE obtained using mqtt_telemetry_topic_create.
+*
+* @param	message	The message whose properties are encoded in the topic.
+*
+* @param	topic_length	Optional, receives the length of the topic without its terminating null.
+*
+* @returns	The null terminated topic, or NULL on failure.
+*/
+MOCKABLE_FUNCTION(, const char*, mqtt_telemetry_topic_build, MQTT_TELEMETRY_TOPIC_HANDLE, handle, IOTHUB_MESSAGE_HANDLE, message, size_t*, topic_length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*MQTT_TELEMETRY_TOPIC_H*/
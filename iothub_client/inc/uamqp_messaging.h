@@ -13,8 +13,15 @@ extern "C"
 {
 #endif
 
+	/* Keeps the AMQP encoding of the properties and application-properties sections of recent messages, so that messages
+	   sharing the same properties only have their changed values encoded again. Not thread safe. */
+	typedef struct MESSAGE_SECTIONS_CACHE_TAG* MESSAGE_SECTIONS_CACHE_HANDLE;
+
 	MOCKABLE_FUNCTION(, int, message_create_IoTHubMessage_from_uamqp_message, MESSAGE_HANDLE, uamqp_message, IOTHUB_MESSAGE_HANDLE*, iothubclient_message);
 	MOCKABLE_FUNCTION(, int, message_create_uamqp_encoding_from_iothub_message, MESSAGE_HANDLE, message_batch_container, IOTHUB_MESSAGE_HANDLE, message_handle, BINARY_DATA*, body_binary_data);
+	MOCKABLE_FUNCTION(, int, message_encode_uamqp_from_iothub_message, MESSAGE_HANDLE, message_batch_container, IOTHUB_MESSAGE_HANDLE, message_handle, MESSAGE_SECTIONS_CACHE_HANDLE, sections_cache, unsigned char*, destination, size_t, capacity, size_t*, encoded_length);
+	MOCKABLE_FUNCTION(, MESSAGE_SECTIONS_CACHE_HANDLE, message_sections_cache_create, size_t, max_entries);
+	MOCKABLE_FUNCTION(, void, message_sections_cache_destroy, MESSAGE_SECTIONS_CACHE_HANDLE, sections_cache);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,313 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "base64_codec.h"
+
+/*the x86 encoders are compiled for SSSE3 and AVX2 whatever the target of the build, and only called when CPUID reports them*/
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || (__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <cpuid.h>
+#include <immintrin.h>
+#define USE_X86_BASE64_ENCODING
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define USE_X86_BASE64_ENCODING
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+/*NEON is part of every ARM64 CPU*/
+#include <arm_neon.h>
+#define USE_NEON_BASE64_ENCODING
+#endif
+
+static const char BASE64_CHARACTERS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*encodes every group of 3 bytes, then the last 1 or 2 bytes with their padding*/
+static void encode_scalar(const unsigned char* source, size_t size, char* destination)
+{
+    size_t index;
+
+    for (index = 0; index + 3 <= size; index += 3)
+    {
+        uint32_t bits = ((uint32_t)source[index] << 16) | ((uint32_t)source[index + 1] << 8) | source[index + 2];
+        destination[0] = BASE64_CHARACTERS[bits >> 18];
+        destination[1] = BASE64_CHARACTERS[(bits >> 12) & 0x3F];
+        destination[2] = BASE64_CHARACTERS[(bits >> 6) & 0x3F];
+        destination[3] = BASE64_CHARACTERS[bits & 0x3F];
+        destination += 4;
+    }
+
+    if (index < size)
+    {
+        uint32_t bits = (uint32_t)source[index] << 16;
+        if (index + 1 < size)
+        {
+            bits |= (uint32_t)source[index + 1] << 8;
+        }
+        destination[0] = BASE64_CHARACTERS[bits >> 18];
+        destination[1] = BASE64_CHARACTERS[(bits >> 12) & 0x3F];
+        destination[2] = (index + 1 < size) ? BASE64_CHARACTERS[(bits >> 6) & 0x3F] : '=';
+        destination[3] = '=';
+    }
+}
+
+#if defined(USE_X86_BASE64_ENCODING)
+
+#define CPU_FEATURES_UNKNOWN    -1
+#define CPU_FEATURES_NONE       0
+#define CPU_FEATURES_SSSE3      1
+#define CPU_FEATURES_AVX2       2
+
+/*computed on first use; threads racing to compute it all store the same value*/
+static int g_cpu_features = CPU_FEATURES_UNKNOWN;
+
+static void read_cpuid(unsigned int leaf, unsigned int registers[4])
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, (int)leaf, 0);
+    registers[0] = (unsigned int)info[0];
+    registers[1] = (unsigned int)info[1];
+    registers[2] = (unsigned int)info[2];
+    registers[3] = (unsigned int)info[3];
+#else
+    __cpuid_count(leaf, 0, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+/*the register states the OS saves on a context switch, AVX2 needs the XMM and YMM ones*/
+static uint64_t read_xcr0(void)
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t low;
+    uint32_t high;
+    __asm__ __volatile__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+    return ((uint64_t)high << 32) | low;
+#endif
+}
+
+static int get_cpu_features(void)
+{
+    if (g_cpu_features == CPU_FEATURES_UNKNOWN)
+    {
+        unsigned int registers[4];
+        unsigned int max_leaf;
+        int features = CPU_FEATURES_NONE;
+
+        read_cpuid(0, registers);
+        max_leaf = registers[0];
+        if (max_leaf >= 1)
+        {
+            read_cpuid(1, registers);
+            /*ECX bit 9: SSSE3*/
+            if ((registers[2] & (1u << 9)) != 0)
+            {
+                features = CPU_FEATURES_SSSE3;
+
+                /*ECX bit 27: OSXSAVE, bit 28: AVX; leaf 7 EBX bit 5: AVX2*/
+                if (max_leaf >= 7 &&
+                    (registers[2] & (1u << 27)) != 0 &&
+                    (registers[2] & (1u << 28)) != 0 &&
+                    (read_xcr0() & 0x6) == 0x6)
+                {
+                    read_cpuid(7, registers);
+                    if ((registers[1] & (1u << 5)) != 0)
+                    {
+                        features = CPU_FEATURES_AVX2;
+                    }
+                }
+            }
+        }
+
+        g_cpu_features = features;
+    }
+
+    return g_cpu_features;
+}
+
+/*moves the 6 bit groups of 12 bytes in the 16 bytes of a block, one group per byte*/
+static TARGET_SSSE3 __m128i split_ssse3(__m128i input)
+{
+    /*every 32 bit lane gets the bytes b, a, c, b of its 3 bytes a, b, c*/
+    __m128i shuffled = _mm_shuffle_epi8(input, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    /*the 1st and 3rd groups are shifted right to the bottom of their 16 bit word, the 2nd and 4th shifted left to the top*/
+    __m128i first_third = _mm_mulhi_epu16(_mm_and_si128(shuffled, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+    __m128i second_fourth = _mm_mullo_epi16(_mm_and_si128(shuffled, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(first_third, second_fourth);
+}
+
+/*turns 16 values of 0 to 63 in their characters, adding the offset of their range to each one*/
+static TARGET_SSSE3 __m128i translate_ssse3(__m128i values)
+{
+    /*'A' - 0, 'a' - 26, '0' - 52 ten times, '+' - 62, '/' - 63*/
+    const __m128i offsets = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+    /*0 for A-Z, 1 for a-z, 2 to 11 for 0-9, 12 for '+' and 13 for '/' */
+    __m128i ranges = _mm_sub_epi8(_mm_subs_epu8(values, _mm_set1_epi8(51)), _mm_cmpgt_epi8(values, _mm_set1_epi8(25)));
+    return _mm_add_epi8(values, _mm_shuffle_epi8(offsets, ranges));
+}
+
+/*the same as split_ssse3, on each 128 bit lane*/
+static TARGET_AVX2 __m256i split_avx2(__m256i input)
+{
+    __m256i shuffled = _mm256_shuffle_epi8(input, _mm256_set_epi8(
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m256i first_third = _mm256_mulhi_epu16(_mm256_and_si256(shuffled, _mm256_set1_epi32(0x0FC0FC00)), _mm256_set1_epi32(0x04000040));
+    __m256i second_fourth = _mm256_mullo_epi16(_mm256_and_si256(shuffled, _mm256_set1_epi32(0x003F03F0)), _mm256_set1_epi32(0x01000010));
+    return _mm256_or_si256(first_third, second_fourth);
+}
+
+/*the same as translate_ssse3, on each 128 bit lane*/
+static TARGET_AVX2 __m256i translate_avx2(__m256i values)
+{
+    const __m256i offsets = _mm256_setr_epi8(
+        65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,
+        65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+    __m256i ranges = _mm256_sub_epi8(_mm256_subs_epu8(values, _mm256_set1_epi8(51)), _mm256_cmpgt_epi8(values, _mm256_set1_epi8(25)));
+    return _mm256_add_epi8(values, _mm256_shuffle_epi8(offsets, ranges));
+}
+
+/*every block reads 16 bytes and encodes the first 12, so it stops while 16 bytes are left to read*/
+static TARGET_SSSE3 size_t encode_blocks_ssse3(const unsigned char* source, size_t size, char* destination)
+{
+    size_t index;
+
+    for (index = 0; size - index >= 16; index += 12)
+    {
+        __m128i input = _mm_loadu_si128((const __m128i*)(source + index));
+        _mm_storeu_si128((__m128i*)destination, translate_ssse3(split_ssse3(input)));
+        destination += 16;
+    }
+
+    return index;
+}
+
+/*every block reads 12 bytes at the start of each lane, 28 bytes in all, and encodes 24 of them*/
+static TARGET_AVX2 size_t encode_blocks_avx2(const unsigned char* source, size_t size, char* destination)
+{
+    size_t index;
+
+    for (index = 0; size - index >= 28; index += 24)
+    {
+        __m256i input = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(source + index))),
+            _mm_loadu_si128((const __m128i*)(source + index + 12)), 1);
+        _mm256_storeu_si256((__m256i*)destination, translate_avx2(split_avx2(input)));
+        destination += 32;
+    }
+
+    /*the SSSE3 code has no VEX encoding, running it with the upper halves of the YMM registers dirty stalls every instruction*/
+    _mm256_zeroupper();
+
+    return index + encode_blocks_ssse3(source + index, size - index, destination);
+}
+
+/*returns how many bytes, a multiple of 3, were encoded*/
+static size_t encode_blocks(const unsigned char* source, size_t size, char* destination)
+{
+    size_t result;
+
+    if (size < 16)
+    {
+        result = 0;
+    }
+    else
+    {
+        switch (get_cpu_features())
+        {
+        case CPU_FEATURES_AVX2:
+            result = encode_blocks_avx2(source, size, destination);
+            break;
+        case CPU_FEATURES_SSSE3:
+            result = encode_blocks_ssse3(source, size, destination);
+            break;
+        default:
+            result = 0;
+            break;
+        }
+    }
+
+    return result;
+}
+
+#elif defined(USE_NEON_BASE64_ENCODING)
+
+/*every block deinterleaves 48 bytes in 3 vectors, computes the 4 vectors of 6 bit groups and looks their characters up*/
+static size_t encode_blocks(const unsigned char* source, size_t size, char* destination)
+{
+    const uint8x16_t mask = vdupq_n_u8(0x3F);
+    uint8x16x4_t alphabet;
+    size_t index;
+
+    alphabet.val[0] = vld1q_u8((const uint8_t*)BASE64_CHARACTERS);
+    alphabet.val[1] = vld1q_u8((const uint8_t*)BASE64_CHARACTERS + 16);
+    alphabet.val[2] = vld1q_u8((const uint8_t*)BASE64_CHARACTERS + 32);
+    alphabet.val[3] = vld1q_u8((const uint8_t*)BASE64_CHARACTERS + 48);
+
+    for (index = 0; size - index >= 48; index += 48)
+    {
+        uint8x16x3_t input = vld3q_u8(source + index);
+        uint8x16x4_t output;
+        output.val[0] = vqtbl4q_u8(alphabet, vshrq_n_u8(input.val[0], 2));
+        output.val[1] = vqtbl4q_u8(alphabet, vandq_u8(vorrq_u8(vshlq_n_u8(input.val[0], 4), vshrq_n_u8(input.val[1], 4)), mask));
+        output.val[2] = vqtbl4q_u8(alphabet, vandq_u8(vorrq_u8(vshlq_n_u8(input.val[1], 2), vshrq_n_u8(input.val[2], 6)), mask));
+        output.val[3] = vqtbl4q_u8(alphabet, vandq_u8(input.val[2], mask));
+        vst4q_u8((uint8_t*)destination, output);
+        destination += 64;
+    }
+
+    return index;
+}
+
+#else
+
+static size_t encode_blocks(const unsigned char* source, size_t size, char* destination)
+{
+    (void)source;
+    (void)size;
+    (void)destination;
+    return 0;
+}
+
+#endif
+
+int base64_codec_encode(const unsigned char* source, size_t size, char* destination, size_t capacity)
+{
+    int result;
+
+    if ((source == NULL && size > 0) || destination == NULL)
+    {
+        /*Codes_SRS_BASE64_CODEC_11_001: [ If source is NULL while size is not 0, or destination is NULL, base64_codec_encode shall fail and return a non-zero value. ]*/
+        LogError("Invalid argument (source=%p, size=%lu, destination=%p)", source, (unsigned long)size, destination);
+        result = __FAILURE__;
+    }
+    else if (size / 3 >= SIZE_MAX / 4 || capacity < BASE64_CODEC_ENCODED_SIZE(size))
+    {
+        /*Codes_SRS_BASE64_CODEC_11_002: [ If capacity is less than BASE64_CODEC_ENCODED_SIZE(size), base64_codec_encode shall fail and return a non-zero value without writing anything. ]*/
+        LogError("%lu bytes cannot be encoded in %lu characters", (unsigned long)size, (unsigned long)capacity);
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*Codes_SRS_BASE64_CODEC_11_004: [ base64_codec_encode shall write the BASE64_CODEC_ENCODED_SIZE(size) characters of the base64 encoding of source, padded with '=', without a null terminator, and return 0. ]*/
+        if (size > 0)
+        {
+            /*Codes_SRS_BASE64_CODEC_11_003: [ base64_codec_encode shall encode the blocks of source with the widest of AVX2, SSSE3 or NEON the CPU supports, and the rest of it one group of 3 bytes at a time. ]*/
+            size_t encoded = encode_blocks(source, size, destination);
+            encode_scalar(source + encoded, size - encoded, destination + encoded / 3 * 4);
+        }
+        result = 0;
+    }
+
+    return result;
+}
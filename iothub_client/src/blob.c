@@ -5,10 +5,10 @@
 #include <stdint.h>
 #include "azure_c_shared_utility/gballoc.h"
 #include "blob.h"
+#include "base64_codec.h"
 
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/xlogging.h"
-#include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/shared_util_options.h"
 
 BLOB_RESULT Blob_UploadBlock(
@@ -43,19 +43,21 @@ BLOB_RESULT Blob_UploadBlock(
         }
         else
         {
-            STRING_HANDLE blockIdString = Base64_Encode_Bytes((const unsigned char*)temp, 6);
-            if (blockIdString == NULL)
+            char blockIdString[BASE64_CODEC_ENCODED_SIZE(6) + 1];
+            if (base64_codec_encode((const unsigned char*)temp, 6, blockIdString, sizeof(blockIdString) - 1) != 0)
             {
                 /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
-                LogError("unable to Base64_Encode_Bytes");
+                LogError("unable to base64_codec_encode");
                 result = BLOB_ERROR;
             }
             else
             {
+                blockIdString[sizeof(blockIdString) - 1] = '\0';
+
                 /*add the blockId base64 encoded to the XML*/
                 if (!(
                     (STRING_concat(blockIDList, "<Latest>") == 0) &&
-                    (STRING_concat_with_STRING(blockIDList, blockIdString) == 0) &&
+                    (STRING_concat(blockIDList, blockIdString) == 0) &&
                     (STRING_concat(blockIDList, "</Latest>") == 0)
                     ))
                 {
@@ -77,7 +79,7 @@ BLOB_RESULT Blob_UploadBlock(
                     {
                         if (!(
                             (STRING_concat(newRelativePath, "&comp=block&blockid=") == 0) &&
-                            (STRING_concat_with_STRING(newRelativePath, blockIdString) == 0)
+                            (STRING_concat(newRelativePath, blockIdString) == 0)
                             ))
                         {
                             /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
@@ -117,7 +119,6 @@ BLOB_RESULT Blob_UploadBlock(
                         STRING_delete(newRelativePath);
                     }
                 }
-                STRING_delete(blockIdString);
             }
         }
     }
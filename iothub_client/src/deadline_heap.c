@@ -0,0 +1,286 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "deadline_heap.h"
+
+#define INITIAL_HEAP_CAPACITY   16
+
+typedef struct DEADLINE_HEAP_ENTRY_TAG
+{
+    tickcounter_ms_t deadline;
+    void* value;
+    size_t index;
+    struct DEADLINE_HEAP_ENTRY_TAG* next_free;
+} DEADLINE_HEAP_ENTRY;
+
+typedef struct DEADLINE_HEAP_TAG
+{
+    DEADLINE_HEAP_ENTRY** entries;
+    size_t capacity;
+    size_t count;
+    DEADLINE_HEAP_ENTRY* free_entries; /*released entries kept for the next adds, never more than the most entries ever in the heap*/
+} DEADLINE_HEAP;
+
+static void place_entry(DEADLINE_HEAP* heap, DEADLINE_HEAP_ENTRY* entry, size_t index)
+{
+    heap->entries[index] = entry;
+    entry->index = index;
+}
+
+static void sift_up(DEADLINE_HEAP* heap, size_t index)
+{
+    DEADLINE_HEAP_ENTRY* entry = heap->entries[index];
+
+    while (index > 0)
+    {
+        size_t parent = (index - 1) / 2;
+        if (heap->entries[parent]->deadline <= entry->deadline)
+        {
+            break;
+        }
+        place_entry(heap, heap->entries[parent], index);
+        index = parent;
+    }
+
+    place_entry(heap, entry, index);
+}
+
+static void sift_down(DEADLINE_HEAP* heap, size_t index)
+{
+    DEADLINE_HEAP_ENTRY* entry = heap->entries[index];
+
+    while (1)
+    {
+        size_t child = (2 * index) + 1;
+        if (child >= heap->count)
+        {
+            break;
+        }
+        if ((child + 1 < heap->count) && (heap->entries[child + 1]->deadline < heap->entries[child]->deadline))
+        {
+            child++;
+        }
+        if (entry->deadline <= heap->entries[child]->deadline)
+        {
+            break;
+        }
+        place_entry(heap, heap->entries[child], index);
+        index = child;
+    }
+
+    place_entry(heap, entry, index);
+}
+
+static void remove_entry(DEADLINE_HEAP* heap, DEADLINE_HEAP_ENTRY* entry)
+{
+    size_t index = entry->index;
+
+    heap->count--;
+    if (index != heap->count)
+    {
+        // Move the last entry into the hole and restore the heap order around it.
+        DEADLINE_HEAP_ENTRY* moved_entry = heap->entries[heap->count];
+        place_entry(heap, moved_entry, index);
+        sift_down(heap, index);
+        sift_up(heap, moved_entry->index);
+    }
+
+    entry->next_free = heap->free_entries;
+    heap->free_entries = entry;
+}
+
+static int ensure_capacity(DEADLINE_HEAP* heap)
+{
+    int result;
+
+    if (heap->count < heap->capacity)
+    {
+        result = 0;
+    }
+    else
+    {
+        size_t new_capacity = (heap->capacity == 0) ? INITIAL_HEAP_CAPACITY : heap->capacity * 2;
+        DEADLINE_HEAP_ENTRY** new_entries;
+
+        if (new_capacity > ((size_t)-1) / sizeof(DEADLINE_HEAP_ENTRY*))
+        {
+            LogError("Failure: deadline heap cannot grow beyond %lu entries", (unsigned long)heap->capacity);
+            result = __FAILURE__;
+        }
+        else if ((new_entries = (DEADLINE_HEAP_ENTRY**)realloc(heap->entries, new_capacity * sizeof(DEADLINE_HEAP_ENTRY*))) == NULL)
+        {
+            LogError("Failure growing the deadline heap");
+            result = __FAILURE__;
+        }
+        else
+        {
+            heap->entries = new_entries;
+            heap->capacity = new_capacity;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static DEADLINE_HEAP_ENTRY* take_free_entry(DEADLINE_HEAP* heap)
+{
+    DEADLINE_HEAP_ENTRY* result;
+
+    if ((result = heap->free_entries) != NULL)
+    {
+        heap->free_entries = result->next_free;
+    }
+    else
+    {
+        result = (DEADLINE_HEAP_ENTRY*)malloc(sizeof(DEADLINE_HEAP_ENTRY));
+    }
+
+    return result;
+}
+
+DEADLINE_HEAP_HANDLE deadline_heap_create(void)
+{
+    DEADLINE_HEAP* result;
+
+    // Codes_SRS_DEADLINE_HEAP_11_001: [ deadline_heap_create shall allocate memory for the DEADLINE_HEAP data structure and return it empty. ]
+    if ((result = (DEADLINE_HEAP*)malloc(sizeof(DEADLINE_HEAP))) == NULL)
+    {
+        // Codes_SRS_DEADLINE_HEAP_11_002: [ If the allocation fails, deadline_heap_create shall fail and return NULL. ]
+        LogError("Failure allocating DEADLINE_HEAP");
+    }
+    else
+    {
+        result->entries = NULL;
+        result->capacity = 0;
+        result->count = 0;
+        result->free_entries = NULL;
+    }
+
+    return result;
+}
+
+void deadline_heap_destroy(DEADLINE_HEAP_HANDLE heap)
+{
+    // Codes_SRS_DEADLINE_HEAP_11_003: [ If `heap` is NULL, deadline_heap_destroy shall return. ]
+    if (heap != NULL)
+    {
+        size_t index;
+
+        // Codes_SRS_DEADLINE_HEAP_11_004: [ deadline_heap_destroy shall free all entries still in the heap, the entries kept for reuse and the heap itself, but not the stored values. ]
+        for (index = 0; index < heap->count; index++)
+        {
+            free(heap->entries[index]);
+        }
+
+        while (heap->free_entries != NULL)
+        {
+            DEADLINE_HEAP_ENTRY* entry = heap->free_entries;
+            heap->free_entries = entry->next_free;
+            free(entry);
+        }
+
+        free(heap->entries);
+        free(heap);
+    }
+}
+
+DEADLINE_HEAP_ENTRY_HANDLE deadline_heap_add(DEADLINE_HEAP_HANDLE heap, tickcounter_ms_t deadline, void* value)
+{
+    DEADLINE_HEAP_ENTRY* result;
+
+    // Codes_SRS_DEADLINE_HEAP_11_005: [ If `heap` or `value` is NULL, deadline_heap_add shall fail and return NULL. ]
+    if (heap == NULL || value == NULL)
+    {
+        LogError("Invalid argument (heap=%p, value=%p)", heap, value);
+        result = NULL;
+    }
+    // Codes_SRS_DEADLINE_HEAP_11_006: [ If the heap is full, deadline_heap_add shall double its capacity. ]
+    else if (ensure_capacity(heap) != 0)
+    {
+        // Codes_SRS_DEADLINE_HEAP_11_007: [ If any allocation fails, deadline_heap_add shall fail and return NULL. ]
+        LogError("Failure making room in the deadline heap");
+        result = NULL;
+    }
+    // Codes_SRS_DEADLINE_HEAP_11_017: [ deadline_heap_add shall reuse an entry released by deadline_heap_remove or deadline_heap_pop_expired if there is one, and only allocate a new entry otherwise. ]
+    else if ((result = take_free_entry(heap)) == NULL)
+    {
+        // Codes_SRS_DEADLINE_HEAP_11_007: [ If any allocation fails, deadline_heap_add shall fail and return NULL. ]
+        LogError("Failure allocating DEADLINE_HEAP_ENTRY");
+    }
+    else
+    {
+        // Codes_SRS_DEADLINE_HEAP_11_008: [ On success deadline_heap_add shall insert `value` ordered by `deadline` and return a handle to the new entry. ]
+        result->deadline = deadline;
+        result->value = value;
+        place_entry(heap, result, heap->count);
+        heap->count++;
+        sift_up(heap, result->index);
+    }
+
+    return result;
+}
+
+void deadline_heap_remove(DEADLINE_HEAP_HANDLE heap, DEADLINE_HEAP_ENTRY_HANDLE entry)
+{
+    // Codes_SRS_DEADLINE_HEAP_11_009: [ If `heap` or `entry` is NULL, deadline_heap_remove shall return. ]
+    if (heap != NULL && entry != NULL)
+    {
+        // Codes_SRS_DEADLINE_HEAP_11_010: [ deadline_heap_remove shall remove `entry` from the heap and keep it for reuse by deadline_heap_add. ]
+        remove_entry(heap, entry);
+    }
+}
+
+void* deadline_heap_pop_expired(DEADLINE_HEAP_HANDLE heap, tickcounter_ms_t current_ms)
+{
+    void* result;
+
+    // Codes_SRS_DEADLINE_HEAP_11_011: [ If `heap` is NULL or empty, deadline_heap_pop_expired shall return NULL. ]
+    if (heap == NULL || heap->count == 0)
+    {
+        result = NULL;
+    }
+    // Codes_SRS_DEADLINE_HEAP_11_012: [ If the earliest deadline in the heap is later than `current_ms`, deadline_heap_pop_expired shall return NULL. ]
+    else if (heap->entries[0]->deadline > current_ms)
+    {
+        result = NULL;
+    }
+    else
+    {
+        // Codes_SRS_DEADLINE_HEAP_11_013: [ Otherwise deadline_heap_pop_expired shall remove the entry with the earliest deadline, keep it for reuse by deadline_heap_add and return its value. ]
+        result = heap->entries[0]->value;
+        remove_entry(heap, heap->entries[0]);
+    }
+
+    return result;
+}
+
+bool deadline_heap_peek_deadline(DEADLINE_HEAP_HANDLE heap, tickcounter_ms_t* deadline)
+{
+    bool result;
+
+    // Codes_SRS_DEADLINE_HEAP_11_015: [ If `heap` or `deadline` is NULL, or the heap is empty, deadline_heap_peek_deadline shall return false. ]
+    if (heap == NULL || deadline == NULL || heap->count == 0)
+    {
+        result = false;
+    }
+    else
+    {
+        // Codes_SRS_DEADLINE_HEAP_11_016: [ Otherwise deadline_heap_peek_deadline shall store the earliest deadline of the heap in `deadline`, leave its entry in the heap and return true. ]
+        *deadline = heap->entries[0]->deadline;
+        result = true;
+    }
+
+    return result;
+}
+
+size_t deadline_heap_get_count(DEADLINE_HEAP_HANDLE heap)
+{
+    // Codes_SRS_DEADLINE_HEAP_11_014: [ deadline_heap_get_count shall return the number of entries in the heap, or zero if `heap` is NULL. ]
+    return (heap == NULL) ? 0 : heap->count;
+}
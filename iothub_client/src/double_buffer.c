@@ -0,0 +1,203 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "double_buffer.h"
+
+typedef struct DOUBLE_BUFFER_SIDE_TAG
+{
+    unsigned char* elements;
+    size_t capacity;
+    size_t count;
+} DOUBLE_BUFFER_SIDE;
+
+typedef struct DOUBLE_BUFFER_TAG
+{
+    size_t elementSize;
+    DOUBLE_BUFFER_SIDE sides[2];
+    size_t writeSide;
+} DOUBLE_BUFFER;
+
+DOUBLE_BUFFER_HANDLE double_buffer_create(size_t elementSize, size_t initialCapacity)
+{
+    DOUBLE_BUFFER* result;
+
+    if (elementSize == 0 || initialCapacity == 0 || initialCapacity > ((size_t)-1) / elementSize)
+    {
+        /*Codes_SRS_DOUBLE_BUFFER_11_001: [ If `elementSize` or `initialCapacity` is 0, or their product overflows, double_buffer_create shall fail and return NULL. ]*/
+        LogError("Invalid argument, elementSize [%lu], initialCapacity [%lu]", (unsigned long)elementSize, (unsigned long)initialCapacity);
+        result = NULL;
+    }
+    /*Codes_SRS_DOUBLE_BUFFER_11_002: [ double_buffer_create shall allocate the DOUBLE_BUFFER data structure and `initialCapacity` elements for each of its two sides. ]*/
+    else if ((result = (DOUBLE_BUFFER*)malloc(sizeof(DOUBLE_BUFFER))) == NULL)
+    {
+        /*Codes_SRS_DOUBLE_BUFFER_11_003: [ If any allocation fails, double_buffer_create shall free what it allocated and return NULL. ]*/
+        LogError("Failed allocating the double buffer");
+    }
+    else if ((result->sides[0].elements = (unsigned char*)malloc(elementSize * initialCapacity)) == NULL)
+    {
+        LogError("Failed allocating the first side of the double buffer");
+        free(result);
+        result = NULL;
+    }
+    else if ((result->sides[1].elements = (unsigned char*)malloc(elementSize * initialCapacity)) == NULL)
+    {
+        LogError("Failed allocating the second side of the double buffer");
+        free(result->sides[0].elements);
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        result->elementSize = elementSize;
+        result->sides[0].capacity = initialCapacity;
+        result->sides[0].count = 0;
+        result->sides[1].capacity = initialCapacity;
+        result->sides[1].count = 0;
+        result->writeSide = 0;
+    }
+
+    return result;
+}
+
+void double_buffer_destroy(DOUBLE_BUFFER_HANDLE handle)
+{
+    /*Codes_SRS_DOUBLE_BUFFER_11_004: [ If `handle` is NULL, double_buffer_destroy shall return. ]*/
+    if (handle != NULL)
+    {
+        /*Codes_SRS_DOUBLE_BUFFER_11_005: [ double_buffer_destroy shall free both sides and the double buffer itself. ]*/
+        free(handle->sides[0].elements);
+        free(handle->sides[1].elements);
+        free(handle);
+    }
+}
+
+int double_buffer_push(DOUBLE_BUFFER_HANDLE handle, const void* element)
+{
+    int result;
+
+    if (handle == NULL || element == NULL)
+    {
+        /*Codes_SRS_DOUBLE_BUFFER_11_006: [ If `handle` or `element` is NULL, double_buffer_push shall fail and return a non-zero value. ]*/
+        LogError("Invalid argument, handle [%p], element [%p]", handle, element);
+        result = __FAILURE__;
+    }
+    else
+    {
+        DOUBLE_BUFFER_SIDE* side = &handle->sides[handle->writeSide];
+
+        if (side->count == side->capacity)
+        {
+            /*Codes_SRS_DOUBLE_BUFFER_11_007: [ If the write side is full, double_buffer_push shall double its capacity. ]*/
+            unsigned char* elements;
+            size_t newCapacity = side->capacity * 2;
+
+            if (newCapacity < side->capacity || newCapacity > ((size_t)-1) / handle->elementSize)
+            {
+                /*Codes_SRS_DOUBLE_BUFFER_11_008: [ If growing the write side fails, double_buffer_push shall fail and return a non-zero value, leaving the elements already pushed untouched. ]*/
+                LogError("Double buffer capacity overflow");
+                result = __FAILURE__;
+            }
+            else if ((elements = (unsigned char*)realloc(side->elements, newCapacity * handle->elementSize)) == NULL)
+            {
+                LogError("Failed growing the double buffer");
+                result = __FAILURE__;
+            }
+            else
+            {
+                side->elements = elements;
+                side->capacity = newCapacity;
+                result = 0;
+            }
+        }
+        else
+        {
+            result = 0;
+        }
+
+        if (result == 0)
+        {
+            /*Codes_SRS_DOUBLE_BUFFER_11_009: [ double_buffer_push shall copy `element` at the end of the write side and return 0. ]*/
+            (void)memcpy(side->elements + (side->count * handle->elementSize), element, handle->elementSize);
+            side->count++;
+        }
+    }
+
+    return result;
+}
+
+size_t double_buffer_get_count(DOUBLE_BUFFER_HANDLE handle)
+{
+    size_t result;
+
+    if (handle == NULL)
+    {
+        /*Codes_SRS_DOUBLE_BUFFER_11_010: [ If `handle` is NULL, double_buffer_get_count shall return 0. ]*/
+        LogError("Invalid argument, handle is NULL");
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_DOUBLE_BUFFER_11_011: [ double_buffer_get_count shall return the number of elements in the write side. ]*/
+        result = handle->sides[handle->writeSide].count;
+    }
+
+    return result;
+}
+
+size_t double_buffer_swap(DOUBLE_BUFFER_HANDLE handle)
+{
+    size_t result;
+
+    if (handle == NULL)
+    {
+        /*Codes_SRS_DOUBLE_BUFFER_11_012: [ If `handle` is NULL, double_buffer_swap shall return 0. ]*/
+        LogError("Invalid argument, handle is NULL");
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_DOUBLE_BUFFER_11_013: [ double_buffer_swap shall empty the read side, keeping its capacity, and make it the write side. ]*/
+        /*Codes_SRS_DOUBLE_BUFFER_11_014: [ double_buffer_swap shall make the write side the read side and return its number of elements. ]*/
+        result = handle->sides[handle->writeSide].count;
+        handle->writeSide ^= 1;
+        handle->sides[handle->writeSide].count = 0;
+    }
+
+    return result;
+}
+
+void* double_buffer_get_element(DOUBLE_BUFFER_HANDLE handle, size_t index)
+{
+    void* result;
+
+    if (handle == NULL)
+    {
+        /*Codes_SRS_DOUBLE_BUFFER_11_015: [ If `handle` is NULL, double_buffer_get_element shall return NULL. ]*/
+        LogError("Invalid argument, handle is NULL");
+        result = NULL;
+    }
+    else
+    {
+        DOUBLE_BUFFER_SIDE* side = &handle->sides[handle->writeSide ^ 1];
+
+        if (index >= side->count)
+        {
+            /*Codes_SRS_DOUBLE_BUFFER_11_016: [ If `index` is not lower than the number of elements of the read side, double_buffer_get_element shall return NULL. ]*/
+            LogError("Index %lu out of range, the read side has %lu elements", (unsigned long)index, (unsigned long)side->count);
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_DOUBLE_BUFFER_11_017: [ double_buffer_get_element shall return a pointer to the element at `index` in the read side. ]*/
+            result = side->elements + (index * handle->elementSize);
+        }
+    }
+
+    return result;
+}
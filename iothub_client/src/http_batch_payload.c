@@ -0,0 +1,335 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "http_batch_payload.h"
+#include "base64_codec.h"
+
+#define IOTHUB_APP_PREFIX                   "iothub-app-"
+#define BODY_START                          "{\"body\":\""
+#define BODY_END_BASE64                     "\""
+#define BODY_END_STRING                     "\",\"base64Encoded\":false"
+#define PROPERTIES_START                    ",\"properties\":{"
+#define FIRST_PROPERTY_START                "\"" IOTHUB_APP_PREFIX
+#define NEXT_PROPERTY_START                 ",\"" IOTHUB_APP_PREFIX
+#define PROPERTY_KEY_VALUE_SEPARATOR        "\":\""
+#define PROPERTY_END                        "\""
+#define PROPERTIES_END                      "}"
+#define ITEM_END                            "},"
+
+#define CONST_STRLEN(s)                     (sizeof(s) - 1)
+
+#define MAXIMUM_PAYLOAD_OVERHEAD 384
+#define MAXIMUM_PROPERTY_OVERHEAD 16
+
+static const char HEX_CHARACTERS[] = "0123456789ABCDEF";
+
+// The same code measures an item, with a NULL position, and writes it, so that both always agree.
+typedef struct ITEM_WRITER_TAG
+{
+    char* position;
+    size_t size;
+    size_t capacity;
+} ITEM_WRITER;
+
+static void write_text(ITEM_WRITER* writer, const char* text, size_t length)
+{
+    // Once an item goes over its capacity nothing more is written, and its size tells the caller.
+    if (writer->position != NULL && writer->size + length <= writer->capacity)
+    {
+        (void)memcpy(writer->position, text, length);
+        writer->position += length;
+    }
+    writer->size += length;
+}
+
+// Writes text escaped as the content of a JSON string, the way STRING_new_JSON does.
+static int write_json_string_content(ITEM_WRITER* writer, const char* text, size_t length)
+{
+    int result = 0;
+    size_t index;
+    size_t unescaped_start = 0;
+
+    for (index = 0; index < length; index++)
+    {
+        unsigned char character = (unsigned char)text[index];
+        if (character >= 128)
+        {
+            LogError("the character at %lu is not US-ASCII", (unsigned long)index);
+            result = __FAILURE__;
+            break;
+        }
+        else if (character < 0x20 || character == '"' || character == '\\' || character == '/')
+        {
+            char escaped[6];
+            write_text(writer, text + unescaped_start, index - unescaped_start);
+            escaped[0] = '\\';
+            if (character < 0x20)
+            {
+                escaped[1] = 'u';
+                escaped[2] = '0';
+                escaped[3] = '0';
+                escaped[4] = HEX_CHARACTERS[character >> 4];
+                escaped[5] = HEX_CHARACTERS[character & 0x0F];
+                write_text(writer, escaped, 6);
+            }
+            else
+            {
+                escaped[1] = (char)character;
+                write_text(writer, escaped, 2);
+            }
+            unescaped_start = index + 1;
+        }
+    }
+
+    if (result == 0)
+    {
+        write_text(writer, text + unescaped_start, length - unescaped_start);
+    }
+    return result;
+}
+
+static int write_base64(ITEM_WRITER* writer, const unsigned char* source, size_t size)
+{
+    int result;
+    size_t encoded_size = BASE64_CODEC_ENCODED_SIZE(size);
+
+    if (writer->position != NULL && writer->size + encoded_size <= writer->capacity)
+    {
+        if (base64_codec_encode(source, size, writer->position, encoded_size) != 0)
+        {
+            LogError("unable to base64 encode the message");
+            result = __FAILURE__;
+        }
+        else
+        {
+            writer->position += encoded_size;
+            writer->size += encoded_size;
+            result = 0;
+        }
+    }
+    else
+    {
+        writer->size += encoded_size;
+        result = 0;
+    }
+
+    return result;
+}
+
+static int write_properties(ITEM_WRITER* writer, IOTHUB_MESSAGE_HANDLE message, size_t* message_size)
+{
+    int result;
+    const IOTHUB_MESSAGE_PROPERTY* properties;
+    size_t property_count;
+
+    if (IoTHubMessage_GetPropertyTable(message, &properties, &property_count) != IOTHUB_MESSAGE_OK)
+    {
+        LogError("unable to get the properties of the message");
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t index;
+        result = 0;
+
+        /* Codes_SRS_HTTP_BATCH_PAYLOAD_11_004: [ If the message has properties, they shall follow the body as ,"properties":{"iothub-app-<key>":"<value>",...}, their keys and values escaped for JSON, and be missing otherwise. ] */
+        if (property_count > 0)
+        {
+            write_text(writer, PROPERTIES_START, CONST_STRLEN(PROPERTIES_START));
+            for (index = 0; index < property_count && result == 0; index++)
+            {
+                if (index == 0)
+                {
+                    write_text(writer, FIRST_PROPERTY_START, CONST_STRLEN(FIRST_PROPERTY_START));
+                }
+                else
+                {
+                    write_text(writer, NEXT_PROPERTY_START, CONST_STRLEN(NEXT_PROPERTY_START));
+                }
+
+                if (write_json_string_content(writer, properties[index].key, properties[index].keyLength) != 0)
+                {
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    write_text(writer, PROPERTY_KEY_VALUE_SEPARATOR, CONST_STRLEN(PROPERTY_KEY_VALUE_SEPARATOR));
+                    if (write_json_string_content(writer, properties[index].value, properties[index].valueLength) != 0)
+                    {
+                        result = __FAILURE__;
+                    }
+                    else
+                    {
+                        write_text(writer, PROPERTY_END, CONST_STRLEN(PROPERTY_END));
+                        /* Codes_SRS_HTTP_BATCH_PAYLOAD_11_006: [ message_size shall be the size of the payload + 384, plus the length of the key + the length of the value + 16 for every property. ] */
+                        *message_size += properties[index].keyLength + properties[index].valueLength + MAXIMUM_PROPERTY_OVERHEAD;
+                    }
+                }
+            }
+            write_text(writer, PROPERTIES_END, CONST_STRLEN(PROPERTIES_END));
+        }
+    }
+
+    return result;
+}
+
+static int write_item(ITEM_WRITER* writer, IOTHUB_MESSAGE_HANDLE message, size_t* message_size)
+{
+    int result;
+    IOTHUBMESSAGE_CONTENT_TYPE content_type = IoTHubMessage_GetContentType(message);
+
+    if (content_type == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        const unsigned char* source;
+        size_t size;
+
+        if (IoTHubMessage_GetByteArray(message, &source, &size) != IOTHUB_MESSAGE_OK)
+        {
+            /* Codes_SRS_HTTP_BATCH_PAYLOAD_11_007: [ If the message has an unknown content type or reading it fails, http_batch_payload_measure_item shall fail and return a non-zero value. ] */
+            LogError("unable to get the data for the message.");
+            result = __FAILURE__;
+        }
+        else
+        {
+            /* Codes_SRS_HTTP_BATCH_PAYLOAD_11_002: [ The body of a byte array message shall be {"body":"<base64 encoding of the payload>". ] */
+            write_text(writer, BODY_START, CONST_STRLEN(BODY_START));
+            if (write_base64(writer, source, size) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                write_text(writer, BODY_END_BASE64, CONST_STRLEN(BODY_END_BASE64));
+                *message_size = size + MAXIMUM_PAYLOAD_OVERHEAD;
+                result = 0;
+            }
+        }
+    }
+    else if (content_type == IOTHUBMESSAGE_STRING)
+    {
+        const char* source;
+
+        if ((source = IoTHubMessage_GetString(message)) == NULL)
+        {
+            /* Codes_SRS_HTTP_BATCH_PAYLOAD_11_007: [ If the message has an unknown content type or reading it fails, http_batch_payload_measure_item shall fail and return a non-zero value. ] */
+            LogError("unable to IoTHubMessage_GetString");
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t length = strlen(source);
+
+            /* Codes_SRS_HTTP_BATCH_PAYLOAD_11_003: [ The body of a string message shall be {"body":"<the string escaped for JSON>","base64Encoded":false, and a string with a character that is not US-ASCII shall fail. ] */
+            write_text(writer, BODY_START, CONST_STRLEN(BODY_START));
+            if (write_json_string_content(writer, source, length) != 0)
+            {
+                LogError("unable to encode the message as a JSON string");
+                result = __FAILURE__;
+            }
+            else
+            {
+                write_text(writer, BODY_END_STRING, CONST_STRLEN(BODY_END_STRING));
+                *message_size = length + MAXIMUM_PAYLOAD_OVERHEAD;
+                result = 0;
+            }
+        }
+    }
+    else
+    {
+        /* Codes_SRS_HTTP_BATCH_PAYLOAD_11_007: [ If the message has an unknown content type or reading it fails, http_batch_payload_measure_item shall fail and return a non-zero value. ] */
+        LogError("an unknown message type was encountered (%d)", content_type);
+        result = __FAILURE__;
+    }
+
+    if (result == 0)
+    {
+        if (write_properties(writer, message, message_size) != 0)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            /* Codes_SRS_HTTP_BATCH_PAYLOAD_11_005: [ The item shall end with "}," so that items can follow each other, the last comma being replaced by the caller. ] */
+            write_text(writer, ITEM_END, CONST_STRLEN(ITEM_END));
+        }
+    }
+
+    return result;
+}
+
+int http_batch_payload_measure_item(IOTHUB_MESSAGE_HANDLE message, size_t* item_size, size_t* message_size)
+{
+    int result;
+
+    if (message == NULL || item_size == NULL || message_size == NULL)
+    {
+        /* Codes_SRS_HTTP_BATCH_PAYLOAD_11_001: [ If message, item_size or message_size is NULL, http_batch_payload_measure_item shall fail and return a non-zero value. ] */
+        LogError("Invalid argument (message=%p, item_size=%p, message_size=%p)", message, item_size, message_size);
+        result = __FAILURE__;
+    }
+    else
+    {
+        /* Codes_SRS_HTTP_BATCH_PAYLOAD_11_008: [ http_batch_payload_measure_item shall compute the exact size of the item without allocating or writing anything, and return 0. ] */
+        ITEM_WRITER writer;
+        writer.position = NULL;
+        writer.size = 0;
+        writer.capacity = 0;
+
+        if (write_item(&writer, message, message_size) != 0)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            *item_size = writer.size;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+int http_batch_payload_write_item(IOTHUB_MESSAGE_HANDLE message, unsigned char* destination, size_t capacity, size_t* item_size)
+{
+    int result;
+
+    if (message == NULL || destination == NULL || item_size == NULL)
+    {
+        /* Codes_SRS_HTTP_BATCH_PAYLOAD_11_009: [ If message, destination or item_size is NULL, http_batch_payload_write_item shall fail and return a non-zero value. ] */
+        LogError("Invalid argument (message=%p, destination=%p, item_size=%p)", message, destination, item_size);
+        result = __FAILURE__;
+    }
+    else
+    {
+        /* Codes_SRS_HTTP_BATCH_PAYLOAD_11_010: [ http_batch_payload_write_item shall write the item at destination, encoding the payload directly into it without allocating, return its size in item_size and return 0. ] */
+        ITEM_WRITER writer;
+        size_t message_size;
+        writer.position = (char*)destination;
+        writer.size = 0;
+        writer.capacity = capacity;
+
+        if (write_item(&writer, message, &message_size) != 0)
+        {
+            result = __FAILURE__;
+        }
+        else if (writer.size > capacity)
+        {
+            /* Codes_SRS_HTTP_BATCH_PAYLOAD_11_011: [ If the item does not fit in capacity bytes, http_batch_payload_write_item shall fail and return a non-zero value, without writing past capacity bytes. ] */
+            LogError("the item takes %lu bytes, more than the %lu available", (unsigned long)writer.size, (unsigned long)capacity);
+            result = __FAILURE__;
+        }
+        else
+        {
+            *item_size = writer.size;
+            result = 0;
+        }
+    }
+
+    return result;
+}
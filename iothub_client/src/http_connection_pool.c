@@ -0,0 +1,335 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "http_connection_pool.h"
+
+#define LOCK_RETRY_WAIT_MS              1
+#define WAIT_INFINITE                   0
+
+struct HTTP_CONNECTION_POOL_TAG;
+
+typedef struct HTTP_CONNECTION_WORKER_TAG
+{
+    struct HTTP_CONNECTION_POOL_TAG* pool;
+    HTTPAPIEX_HANDLE connection;
+    THREAD_HANDLE threadHandle;
+} HTTP_CONNECTION_WORKER;
+
+typedef struct HTTP_CONNECTION_POOL_TAG
+{
+    LOCK_HANDLE lockHandle;             /*protects the state of the current run and stopThreads*/
+    COND_HANDLE workCondition;          /*signaled when a run starts and when the threads have to stop*/
+    COND_HANDLE doneCondition;          /*signaled when the last item of a run is done*/
+    bool stopThreads;
+    HTTP_CONNECTION_WORKER* workers;
+    size_t connectionCount;
+    HTTP_CONNECTION_POOL_WORK work;
+    void* context;
+    size_t itemCount;
+    size_t firstItem;
+    size_t takenCount;                  /*items of the current run handed out so far*/
+    size_t pendingCount;                /*items of the current run not done yet*/
+} HTTP_CONNECTION_POOL;
+
+/* Used for Unit test */
+const size_t http_connection_pool_thread_termination_offset = offsetof(HTTP_CONNECTION_POOL, stopThreads);
+
+/*the counts of a run have to be updated no matter what, otherwise http_connection_pool_run would never return*/
+static void lock_pool(HTTP_CONNECTION_POOL* pool)
+{
+    while (Lock(pool->lockHandle) != LOCK_OK)
+    {
+        LogError("Unable to lock, trying again");
+        (void)ThreadAPI_Sleep(LOCK_RETRY_WAIT_MS);
+    }
+}
+
+/*must be called with the pool lock held, which is released while each item is done*/
+static void do_items(HTTP_CONNECTION_POOL* pool, HTTPAPIEX_HANDLE connection)
+{
+    while (pool->takenCount < pool->itemCount)
+    {
+        /*Codes_SRS_HTTP_CONNECTION_POOL_11_012: [ The items shall be handed out in the order firstItem, firstItem + 1, ... modulo itemCount, each one to the first thread that is free. ]*/
+        size_t item = (pool->firstItem + pool->takenCount) % pool->itemCount;
+        pool->takenCount++;
+        (void)Unlock(pool->lockHandle);
+
+        /*Codes_SRS_HTTP_CONNECTION_POOL_11_013: [ Each item shall be done by calling work with context, the item and the connection of the thread doing it. ]*/
+        pool->work(pool->context, item, connection);
+
+        lock_pool(pool);
+        pool->pendingCount--;
+        if (pool->pendingCount == 0 && Condition_Post(pool->doneCondition) != COND_OK)
+        {
+            LogError("Condition_Post failed, http_connection_pool_run will notice the run is done after its wait");
+        }
+    }
+}
+
+static int connection_worker_thread(void* arg)
+{
+    HTTP_CONNECTION_WORKER* worker = (HTTP_CONNECTION_WORKER*)arg;
+    HTTP_CONNECTION_POOL* pool = worker->pool;
+
+    lock_pool(pool);
+    while (!pool->stopThreads)
+    {
+        if (pool->takenCount < pool->itemCount)
+        {
+            do_items(pool, worker->connection);
+        }
+        else
+        {
+            (void)Condition_Wait(pool->workCondition, pool->lockHandle, WAIT_INFINITE);
+        }
+    }
+    (void)Unlock(pool->lockHandle);
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+/*must be called with the pool lock held*/
+static void wake_workers(HTTP_CONNECTION_POOL* pool)
+{
+    size_t index;
+
+    for (index = 0; index < pool->connectionCount; index++)
+    {
+        if (Condition_Post(pool->workCondition) != COND_OK)
+        {
+            LogError("Condition_Post failed, the items will be done by the threads that are awake");
+        }
+    }
+}
+
+/*stops the threads that were started and frees everything that was allocated, also used when http_connection_pool_create fails halfway*/
+static void destroy_pool(HTTP_CONNECTION_POOL* pool)
+{
+    size_t index;
+
+    if (pool->workers != NULL)
+    {
+        lock_pool(pool);
+        pool->stopThreads = true;
+        wake_workers(pool);
+        (void)Unlock(pool->lockHandle);
+
+        for (index = 0; index < pool->connectionCount; index++)
+        {
+            HTTP_CONNECTION_WORKER* worker = &pool->workers[index];
+
+            if (worker->threadHandle != NULL)
+            {
+                int res;
+                if (ThreadAPI_Join(worker->threadHandle, &res) != THREADAPI_OK)
+                {
+                    LogError("ThreadAPI_Join failed");
+                }
+            }
+            if (worker->connection != NULL)
+            {
+                HTTPAPIEX_Destroy(worker->connection);
+            }
+        }
+
+        free(pool->workers);
+    }
+
+    if (pool->doneCondition != NULL)
+    {
+        Condition_Deinit(pool->doneCondition);
+    }
+    if (pool->workCondition != NULL)
+    {
+        Condition_Deinit(pool->workCondition);
+    }
+    Lock_Deinit(pool->lockHandle);
+    free(pool);
+}
+
+static int start_workers(HTTP_CONNECTION_POOL* pool, const char* hostName, OPTIONHANDLER_HANDLE options)
+{
+    int result = 0;
+    size_t index;
+
+    for (index = 0; index < pool->connectionCount && result == 0; index++)
+    {
+        HTTP_CONNECTION_WORKER* worker = &pool->workers[index];
+        worker->pool = pool;
+
+        /*Codes_SRS_HTTP_CONNECTION_POOL_11_004: [ http_connection_pool_create shall create connectionCount connections by calling HTTPAPIEX_Create with hostName. ]*/
+        if ((worker->connection = HTTPAPIEX_Create(hostName)) == NULL)
+        {
+            LogError("HTTPAPIEX_Create failed for connection %lu", (unsigned long)index);
+            result = __FAILURE__;
+        }
+        /*Codes_SRS_HTTP_CONNECTION_POOL_11_005: [ If options is not NULL, http_connection_pool_create shall give them to every connection by calling OptionHandler_FeedOptions. ]*/
+        else if (options != NULL && OptionHandler_FeedOptions(options, worker->connection) != OPTIONHANDLER_OK)
+        {
+            LogError("OptionHandler_FeedOptions failed for connection %lu", (unsigned long)index);
+            result = __FAILURE__;
+        }
+        /*Codes_SRS_HTTP_CONNECTION_POOL_11_006: [ http_connection_pool_create shall start a worker thread for every connection by calling ThreadAPI_Create. ]*/
+        else if (ThreadAPI_Create(&worker->threadHandle, connection_worker_thread, worker) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Create failed for connection %lu", (unsigned long)index);
+            worker->threadHandle = NULL;
+            result = __FAILURE__;
+        }
+    }
+
+    return result;
+}
+
+HTTP_CONNECTION_POOL_HANDLE http_connection_pool_create(const char* hostName, size_t connectionCount, OPTIONHANDLER_HANDLE options)
+{
+    HTTP_CONNECTION_POOL* result;
+
+    if (hostName == NULL || connectionCount == 0)
+    {
+        /*Codes_SRS_HTTP_CONNECTION_POOL_11_001: [ If hostName is NULL or connectionCount is 0, http_connection_pool_create shall fail and return NULL. ]*/
+        LogError("Invalid argument, hostName=%p, connectionCount=%lu", hostName, (unsigned long)connectionCount);
+        result = NULL;
+    }
+    /*Codes_SRS_HTTP_CONNECTION_POOL_11_002: [ http_connection_pool_create shall allocate memory for the pool. ]*/
+    else if ((result = (HTTP_CONNECTION_POOL*)malloc(sizeof(HTTP_CONNECTION_POOL))) == NULL)
+    {
+        /*Codes_SRS_HTTP_CONNECTION_POOL_11_007: [ If any of the above fails, http_connection_pool_create shall stop the threads it started, destroy the connections it created, free all resources and return NULL. ]*/
+        LogError("Failed allocating the pool");
+    }
+    else
+    {
+        memset(result, 0, sizeof(HTTP_CONNECTION_POOL));
+        result->connectionCount = connectionCount;
+
+        /*Codes_SRS_HTTP_CONNECTION_POOL_11_003: [ http_connection_pool_create shall create the pool lock and the work and done conditions by calling Lock_Init and Condition_Init. ]*/
+        if ((result->lockHandle = Lock_Init()) == NULL)
+        {
+            LogError("Lock_Init failed");
+            free(result);
+            result = NULL;
+        }
+        else if ((result->workCondition = Condition_Init()) == NULL ||
+            (result->doneCondition = Condition_Init()) == NULL)
+        {
+            LogError("Condition_Init failed");
+            destroy_pool(result);
+            result = NULL;
+        }
+        else if ((result->workers = (HTTP_CONNECTION_WORKER*)malloc(connectionCount * sizeof(HTTP_CONNECTION_WORKER))) == NULL)
+        {
+            LogError("Failed allocating the workers");
+            destroy_pool(result);
+            result = NULL;
+        }
+        else
+        {
+            memset(result->workers, 0, connectionCount * sizeof(HTTP_CONNECTION_WORKER));
+
+            if (start_workers(result, hostName, options) != 0)
+            {
+                destroy_pool(result);
+                result = NULL;
+            }
+        }
+    }
+
+    return result;
+}
+
+void http_connection_pool_destroy(HTTP_CONNECTION_POOL_HANDLE pool)
+{
+    if (pool == NULL)
+    {
+        /*Codes_SRS_HTTP_CONNECTION_POOL_11_008: [ If pool is NULL, http_connection_pool_destroy shall do nothing. ]*/
+        LogError("Invalid argument, pool is NULL");
+    }
+    else
+    {
+        /*Codes_SRS_HTTP_CONNECTION_POOL_11_009: [ http_connection_pool_destroy shall stop and join the worker threads, destroy the connections and free all resources. ]*/
+        destroy_pool(pool);
+    }
+}
+
+int http_connection_pool_set_option(HTTP_CONNECTION_POOL_HANDLE pool, const char* optionName, const void* value)
+{
+    int result;
+
+    if (pool == NULL || optionName == NULL)
+    {
+        /*Codes_SRS_HTTP_CONNECTION_POOL_11_010: [ If pool or optionName is NULL, http_connection_pool_set_option shall fail and return a non-zero value. ]*/
+        LogError("Invalid argument, pool=%p, optionName=%p", pool, optionName);
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t index;
+
+        result = 0;
+        for (index = 0; index < pool->connectionCount; index++)
+        {
+            /*Codes_SRS_HTTP_CONNECTION_POOL_11_011: [ http_connection_pool_set_option shall set the option on every connection by calling HTTPAPIEX_SetOption, and fail if any of them fails. ]*/
+            if (HTTPAPIEX_SetOption(pool->workers[index].connection, optionName, value) != HTTPAPIEX_OK)
+            {
+                LogError("HTTPAPIEX_SetOption failed for option %s on connection %lu", optionName, (unsigned long)index);
+                result = __FAILURE__;
+            }
+        }
+    }
+
+    return result;
+}
+
+int http_connection_pool_run(HTTP_CONNECTION_POOL_HANDLE pool, HTTPAPIEX_HANDLE callerConnection, size_t itemCount, size_t firstItem, HTTP_CONNECTION_POOL_WORK work, void* context)
+{
+    int result;
+
+    if (pool == NULL || callerConnection == NULL || work == NULL)
+    {
+        /*Codes_SRS_HTTP_CONNECTION_POOL_11_014: [ If pool, callerConnection or work is NULL, http_connection_pool_run shall fail and return a non-zero value. ]*/
+        LogError("Invalid argument, pool=%p, callerConnection=%p, work=%p", pool, callerConnection, work);
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (itemCount > 0)
+        {
+            lock_pool(pool);
+            pool->work = work;
+            pool->context = context;
+            pool->itemCount = itemCount;
+            pool->firstItem = firstItem % itemCount;
+            pool->takenCount = 0;
+            pool->pendingCount = itemCount;
+            wake_workers(pool);
+
+            /*Codes_SRS_HTTP_CONNECTION_POOL_11_015: [ The calling thread shall do items too, with callerConnection. ]*/
+            do_items(pool, callerConnection);
+
+            /*Codes_SRS_HTTP_CONNECTION_POOL_11_016: [ http_connection_pool_run shall return 0 once every item is done. ]*/
+            while (pool->pendingCount > 0)
+            {
+                (void)Condition_Wait(pool->doneCondition, pool->lockHandle, WAIT_INFINITE);
+            }
+            pool->itemCount = 0;
+            pool->takenCount = 0;
+            (void)Unlock(pool->lockHandle);
+        }
+
+        result = 0;
+    }
+
+    return result;
+}
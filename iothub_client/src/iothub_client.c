@@ -7,21 +7,33 @@
 
 #include <signal.h>
 #include <stddef.h>
+#include <string.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "iothub_client.h"
 #include "iothub_client_ll.h"
 #include "iothub_client_private.h"
+#include "iothub_client_options.h"
 #include "iothubtransport.h"
+#include "iothub_client_pool.h"
+#include "mpsc_queue.h"
+#include "double_buffer.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
-#include "azure_c_shared_utility/vector.h"
+#include "azure_c_shared_utility/constbuffer.h"
 #ifdef USE_PROV_MODULE
 #include "iothub_client_hsm_ll.h"
 #endif
 
+#define WORKER_THREAD_MIN_IDLE_WAIT_MS      1
+#define WORKER_THREAD_MAX_IDLE_WAIT_LIMIT_MS 1000
+#define WORKER_THREAD_DEFAULT_MAX_IDLE_WAIT_MS 1  /*the idle wait only backs off once OPTION_WORKER_MAX_IDLE_WAIT raises it*/
+#define USER_CALLBACK_INITIAL_SLOTS         16
+
 struct IOTHUB_QUEUE_CONTEXT_TAG;
 
 typedef struct IOTHUB_CLIENT_INSTANCE_TAG
@@ -31,11 +43,31 @@ typedef struct IOTHUB_CLIENT_INSTANCE_TAG
     THREAD_HANDLE ThreadHandle;
     LOCK_HANDLE LockHandle;
     sig_atomic_t StopThread;
+    COND_HANDLE WorkCondition;          /*signaled when new work is queued for the worker thread*/
+    LOCK_HANDLE WakeLockHandle;         /*the worker waits on WorkCondition with it, never held during IoTHubClient_LL_DoWork so waking the worker never waits for I/O*/
+    sig_atomic_t WorkPending;
+    unsigned int IdleWaitMs;
+    unsigned int MaxIdleWaitMs;
+    IOTHUB_CLIENT_POOL_HANDLE PoolHandle;
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE PoolClientHandle;   /*set once the client is driven by the threads of PoolHandle*/
+    sig_atomic_t DestroyPending;        /*IoTHubClient_Destroy was called from a callback dispatched by the pool, the pool thread destroys the client*/
+#ifndef IOTHUB_THREAD_LOCAL
+    sig_atomic_t IsDispatching;         /*guarded by LockHandle, stands in for g_dispatching_client where there is no thread local storage*/
+#endif
+    MPSC_QUEUE_HANDLE PendingEvents;    /*PENDING_EVENT items pushed by IoTHubClient_SendEventAsync without taking LockHandle*/
+    sig_atomic_t SendQueueBounded;      /*set when IoTHubClient_LL limits its send queue, events are then handed to it synchronously*/
+    size_t MaxQueuedMessages;
+    size_t MaxQueuedBytes;
+    IOTHUB_CLIENT_QUEUE_OVERFLOW_POLICY QueueOverflowPolicy;
+    unsigned int QueueBlockTimeoutMs;
+    COND_HANDLE QueueSpaceCondition;    /*signaled after IoTHubClient_LL_DoWork while senders wait for room, created with the IOTHUB_CLIENT_QUEUE_OVERFLOW_BLOCK policy*/
+    TICK_COUNTER_HANDLE QueueTickCounter;
+    size_t BlockedSenders;
 #ifndef DONT_USE_UPLOADTOBLOB
     SINGLYLINKEDLIST_HANDLE savedDataToBeCleaned; /*list containing UPLOADTOBLOB_SAVED_DATA*/
 #endif
     int created_with_transport_handle;
-    VECTOR_HANDLE saved_user_callback_list;
+    DOUBLE_BUFFER_HANDLE saved_user_callback_list; /*USER_CALLBACK_INFO items, filled under LockHandle and read by the dispatching thread after a swap*/
     IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK desired_state_callback;
     IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK event_confirm_callback;
     IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reported_state_callback;
@@ -92,8 +124,7 @@ DEFINE_ENUM_STRINGS(USER_CALLBACK_TYPE, USER_CALLBACK_TYPE_VALUES)
 typedef struct DEVICE_TWIN_CALLBACK_INFO_TAG
 {
     DEVICE_TWIN_UPDATE_STATE update_state;
-    unsigned char* payLoad;
-    size_t size;
+    CONSTBUFFER_HANDLE payLoad;
 } DEVICE_TWIN_CALLBACK_INFO;
 
 typedef struct EVENT_CONFIRM_CALLBACK_INFO_TAG
@@ -114,8 +145,8 @@ typedef struct CONNECTION_STATUS_CALLBACK_INFO_TAG
 
 typedef struct METHOD_CALLBACK_INFO_TAG
 {
-    STRING_HANDLE method_name;
-    BUFFER_HANDLE payload;
+    char* method_name;
+    CONSTBUFFER_HANDLE payload;
     METHOD_HANDLE method_id;
 } METHOD_CALLBACK_INFO;
 
@@ -140,6 +171,12 @@ typedef struct IOTHUB_QUEUE_CONTEXT_TAG
     void* userContextCallback;
 } IOTHUB_QUEUE_CONTEXT;
 
+typedef struct PENDING_EVENT_TAG
+{
+    IOTHUB_MESSAGE_LIST event;  /*must stay first, IoTHubClient_LL frees the whole item once the event is confirmed*/
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback;
+} PENDING_EVENT;
+
 /*used by unittests only*/
 const size_t IoTHubClient_ThreadTerminationOffset = offsetof(IOTHUB_CLIENT_INSTANCE, StopThread);
 
@@ -212,13 +249,13 @@ static bool iothub_ll_message_callback(MESSAGE_CALLBACK_INFO* messageData, void*
         queue_cb_info.type = CALLBACK_TYPE_MESSAGE;
         queue_cb_info.userContextCallback = queue_context->userContextCallback;
         queue_cb_info.iothub_callback.message_cb_info = messageData;
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) == 0)
+        if (double_buffer_push(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info) == 0)
         {
             result = true;
         }
         else
         {
-            LogError("message callback vector push failed.");
+            LogError("message callback push failed.");
             result = false;
         }
     }
@@ -231,33 +268,34 @@ static int make_method_calback_queue_context(USER_CALLBACK_INFO* queue_cb_info,
     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_002: [ IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK shall copy the method_name and payload. ] */
     queue_cb_info->userContextCallback = queue_context->userContextCallback;
     queue_cb_info->iothub_callback.method_cb_info.method_id = method_id;
-    if ((queue_cb_info->iothub_callback.method_cb_info.method_name = STRING_construct(method_name)) == NULL)
+    if (mallocAndStrcpy_s(&queue_cb_info->iothub_callback.method_cb_info.method_name, method_name) != 0)
     {
         /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_003: [ If a failure is encountered IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK shall return a non-NULL value. ]*/
-        LogError("STRING_construct failed");
+        LogError("mallocAndStrcpy_s failed");
         result = __FAILURE__;
     }
     else
     {
-        if ((queue_cb_info->iothub_callback.method_cb_info.payload = BUFFER_create(payload, size)) == NULL)
+        /*Codes_SRS_IOTHUBCLIENT_11_026: [ The payload of a method request shall be copied once into a CONSTBUFFER and handed to the user callback without copying it again. ]*/
+        if ((queue_cb_info->iothub_callback.method_cb_info.payload = CONSTBUFFER_Create(payload, size)) == NULL)
         {
-            STRING_delete(queue_cb_info->iothub_callback.method_cb_info.method_name);
+            free(queue_cb_info->iothub_callback.method_cb_info.method_name);
             /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_003: [ If a failure is encountered IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK shall return a non-NULL value. ]*/
-            LogError("BUFFER_create failed");
+            LogError("CONSTBUFFER_Create failed");
             result = __FAILURE__;
         }
         else
         {
-            if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, queue_cb_info, 1) == 0)
+            if (double_buffer_push(queue_context->iotHubClientHandle->saved_user_callback_list, queue_cb_info) == 0)
             {
                 result = 0;
             }
             else
             {
-                STRING_delete(queue_cb_info->iothub_callback.method_cb_info.method_name);
-                BUFFER_delete(queue_cb_info->iothub_callback.method_cb_info.payload);
+                free(queue_cb_info->iothub_callback.method_cb_info.method_name);
+                CONSTBUFFER_Destroy(queue_cb_info->iothub_callback.method_cb_info.payload);
                 /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_003: [ If a failure is encountered IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK shall return a non-NULL value. ]*/
-                LogError("VECTOR_push_back failed");
+                LogError("double_buffer_push failed");
                 result = __FAILURE__;
             }
         }
@@ -327,9 +365,9 @@ static void iothub_ll_connection_status_callback(IOTHUB_CLIENT_CONNECTION_STATUS
         queue_cb_info.userContextCallback = queue_context->userContextCallback;
         queue_cb_info.iothub_callback.connection_status_cb_info.status_reason = reason;
         queue_cb_info.iothub_callback.connection_status_cb_info.connection_status = result;
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+        if (double_buffer_push(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info) != 0)
         {
-            LogError("connection status callback vector push failed.");
+            LogError("connection status callback push failed.");
         }
     }
 }
@@ -343,9 +381,9 @@ static void iothub_ll_event_confirm_callback(IOTHUB_CLIENT_CONFIRMATION_RESULT r
         queue_cb_info.type = CALLBACK_TYPE_EVENT_CONFIRM;
         queue_cb_info.userContextCallback = queue_context->userContextCallback;
         queue_cb_info.iothub_callback.event_confirm_cb_info.confirm_result = result;
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+        if (double_buffer_push(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info) != 0)
         {
-            LogError("event confirm callback vector push failed.");
+            LogError("event confirm callback push failed.");
         }
         free(queue_context);
     }
@@ -360,9 +398,9 @@ static void iothub_ll_reported_state_callback(int status_code, void* userContext
         queue_cb_info.type = CALLBACK_TYPE_REPORTED_STATE;
         queue_cb_info.userContextCallback = queue_context->userContextCallback;
         queue_cb_info.iothub_callback.reported_state_cb_info.status_code = status_code;
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+        if (double_buffer_push(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info) != 0)
         {
-            LogError("reported state callback vector push failed.");
+            LogError("reported state callback push failed.");
         }
         free(queue_context);
     }
@@ -382,34 +420,27 @@ static void iothub_ll_device_twin_callback(DEVICE_TWIN_UPDATE_STATE update_state
         if (payLoad == NULL)
         {
             queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad = NULL;
-            queue_cb_info.iothub_callback.dev_twin_cb_info.size = 0;
             push_to_vector = 0;
         }
+        /*Codes_SRS_IOTHUBCLIENT_11_025: [ The desired properties payload shall be copied once into a CONSTBUFFER and handed to the user callback without copying it again. ]*/
+        else if ((queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad = CONSTBUFFER_Create(payLoad, size)) == NULL)
+        {
+            LogError("failure allocating payload in device twin callback.");
+            push_to_vector = __FAILURE__;
+        }
         else
         {
-            queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad = (unsigned char*)malloc(size);
-            if (queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad == NULL)
-            {
-                LogError("failure allocating payload in device twin callback.");
-                queue_cb_info.iothub_callback.dev_twin_cb_info.size = 0;
-                push_to_vector = __FAILURE__;
-            }
-            else
-            {
-                (void)memcpy(queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad, payLoad, size);
-                queue_cb_info.iothub_callback.dev_twin_cb_info.size = size;
-                push_to_vector = 0;
-            }
+            push_to_vector = 0;
         }
         if (push_to_vector == 0)
         {
-            if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+            if (double_buffer_push(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info) != 0)
             {
                 if (queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad != NULL)
                 {
-                    free(queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad);
+                    CONSTBUFFER_Destroy(queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad);
                 }
-                LogError("device twin callback userContextCallback vector push failed.");
+                LogError("device twin callback userContextCallback push failed.");
             }
         }
     }
@@ -419,10 +450,20 @@ static void iothub_ll_device_twin_callback(DEVICE_TWIN_UPDATE_STATE update_state
     }
 }
 
-static void dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, VECTOR_HANDLE call_backs)
+#ifdef IOTHUB_THREAD_LOCAL
+/*the IoTHubClient whose user callbacks the calling thread is dispatching, NULL outside of dispatch_user_callbacks*/
+static IOTHUB_THREAD_LOCAL IOTHUB_CLIENT_INSTANCE* g_dispatching_client = NULL;
+#endif
+
+static void destroy_client(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, bool isPoolDispatching);
+
+/*dispatches the callbacks_length items made readable by the last double_buffer_swap of saved_user_callback_list*/
+static size_t dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, size_t callbacks_length)
 {
-    size_t callbacks_length = VECTOR_size(call_backs);
     size_t index;
+#ifdef IOTHUB_THREAD_LOCAL
+    IOTHUB_CLIENT_INSTANCE* previous_dispatching_client = g_dispatching_client;
+#endif
 
     IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK desired_state_callback = NULL;
     IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK event_confirm_callback = NULL;
@@ -435,7 +476,11 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance
     IOTHUB_CLIENT_HANDLE method_user_context_handle = NULL;
 
     // Make a local copy of these callbacks, as we don't run with a lock held and iotHubClientInstance may change mid-run.
-    if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    if (callbacks_length == 0)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_11_028: [ If no user callbacks were queued, the lock shall not be taken to dispatch them. ]*/
+    }
+    else if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
     {
         LogError("failed locking for dispatch_user_callbacks");
     }
@@ -456,17 +501,22 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance
         {
             message_user_context_handle = iotHubClientInstance->message_user_context->iotHubClientHandle;
         }
+#ifndef IOTHUB_THREAD_LOCAL
+        iotHubClientInstance->IsDispatching = 1;
+#endif
         
         (void)Unlock(iotHubClientInstance->LockHandle);
     }
 
-    
+#ifdef IOTHUB_THREAD_LOCAL
+    g_dispatching_client = iotHubClientInstance;
+#endif
     for (index = 0; index < callbacks_length; index++)
     {
-        USER_CALLBACK_INFO* queued_cb = (USER_CALLBACK_INFO*)VECTOR_element(call_backs, index);
+        USER_CALLBACK_INFO* queued_cb = (USER_CALLBACK_INFO*)double_buffer_get_element(iotHubClientInstance->saved_user_callback_list, index);
         if (queued_cb == NULL)
         {
-            LogError("VECTOR_element at index %zd is NULL.", index);
+            LogError("double_buffer_get_element at index %lu is NULL.", (unsigned long)index);
         }
         else
         {
@@ -474,14 +524,18 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance
             {
                 case CALLBACK_TYPE_DEVICE_TWIN:
                 {
-                    if (desired_state_callback)
+                    if (queued_cb->iothub_callback.dev_twin_cb_info.payLoad)
                     {
-                        desired_state_callback(queued_cb->iothub_callback.dev_twin_cb_info.update_state, queued_cb->iothub_callback.dev_twin_cb_info.payLoad, queued_cb->iothub_callback.dev_twin_cb_info.size, queued_cb->userContextCallback);
+                        if (desired_state_callback)
+                        {
+                            const CONSTBUFFER* payLoad = CONSTBUFFER_GetContent(queued_cb->iothub_callback.dev_twin_cb_info.payLoad);
+                            desired_state_callback(queued_cb->iothub_callback.dev_twin_cb_info.update_state, payLoad->buffer, payLoad->size, queued_cb->userContextCallback);
+                        }
+                        CONSTBUFFER_Destroy(queued_cb->iothub_callback.dev_twin_cb_info.payLoad);
                     }
-
-                    if (queued_cb->iothub_callback.dev_twin_cb_info.payLoad)
+                    else if (desired_state_callback)
                     {
-                        free(queued_cb->iothub_callback.dev_twin_cb_info.payLoad);
+                        desired_state_callback(queued_cb->iothub_callback.dev_twin_cb_info.update_state, NULL, 0, queued_cb->userContextCallback);
                     }
                     break;
                 }
@@ -506,13 +560,11 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance
                 case CALLBACK_TYPE_DEVICE_METHOD:
                     if (device_method_callback)
                     {
-                        const char* method_name = STRING_c_str(queued_cb->iothub_callback.method_cb_info.method_name);
-                        const unsigned char* payload = BUFFER_u_char(queued_cb->iothub_callback.method_cb_info.payload);
-                        size_t payload_len = BUFFER_length(queued_cb->iothub_callback.method_cb_info.payload);
+                        const CONSTBUFFER* payload = CONSTBUFFER_GetContent(queued_cb->iothub_callback.method_cb_info.payload);
 
                         unsigned char* payload_resp = NULL;
                         size_t response_size = 0;
-                        int status = device_method_callback(method_name, payload, payload_len, &payload_resp, &response_size, queued_cb->userContextCallback);
+                        int status = device_method_callback(queued_cb->iothub_callback.method_cb_info.method_name, payload->buffer, payload->size, &payload_resp, &response_size, queued_cb->userContextCallback);
 
                         if (payload_resp && (response_size > 0))
                         {
@@ -523,27 +575,23 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance
                             }
                         }
 
-                        BUFFER_delete(queued_cb->iothub_callback.method_cb_info.payload);
-                        STRING_delete(queued_cb->iothub_callback.method_cb_info.method_name);
-                        
                         if (payload_resp)
                         {
                             free(payload_resp);
                         }
                     }
+                    CONSTBUFFER_Destroy(queued_cb->iothub_callback.method_cb_info.payload);
+                    free(queued_cb->iothub_callback.method_cb_info.method_name);
                     break;
                 case CALLBACK_TYPE_INBOUD_DEVICE_METHOD:
                     if (inbound_device_method_callback)
                     {
-                        const char* method_name = STRING_c_str(queued_cb->iothub_callback.method_cb_info.method_name);
-                        const unsigned char* payload = BUFFER_u_char(queued_cb->iothub_callback.method_cb_info.payload);
-                        size_t payload_len = BUFFER_length(queued_cb->iothub_callback.method_cb_info.payload);
+                        const CONSTBUFFER* payload = CONSTBUFFER_GetContent(queued_cb->iothub_callback.method_cb_info.payload);
 
-                        inbound_device_method_callback(method_name, payload, payload_len, queued_cb->iothub_callback.method_cb_info.method_id, queued_cb->userContextCallback);
-
-                        BUFFER_delete(queued_cb->iothub_callback.method_cb_info.payload);
-                        STRING_delete(queued_cb->iothub_callback.method_cb_info.method_name);
+                        inbound_device_method_callback(queued_cb->iothub_callback.method_cb_info.method_name, payload->buffer, payload->size, queued_cb->iothub_callback.method_cb_info.method_id, queued_cb->userContextCallback);
                     }
+                    CONSTBUFFER_Destroy(queued_cb->iothub_callback.method_cb_info.payload);
+                    free(queued_cb->iothub_callback.method_cb_info.method_name);
                     break;
                 case CALLBACK_TYPE_MESSAGE:
                     if (message_callback)
@@ -571,7 +619,72 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance
             }
         }
     }
-    VECTOR_destroy(call_backs);
+#ifdef IOTHUB_THREAD_LOCAL
+    g_dispatching_client = previous_dispatching_client;
+#else
+    if (iotHubClientInstance->IsDispatching)
+    {
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            LogError("failed locking to end dispatch_user_callbacks");
+        }
+        else
+        {
+            iotHubClientInstance->IsDispatching = 0;
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+#endif
+
+    return callbacks_length;
+}
+
+/*must be called with LockHandle held*/
+static size_t send_pending_events(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    DLIST_ENTRY pendingEvents;
+    size_t result;
+
+    /*Codes_SRS_IOTHUBCLIENT_11_019: [ Before calling IoTHubClient_LL_DoWork, the worker shall take all the pending events out of the submission queue by calling mpsc_queue_pop_all and hand them, in the order they were submitted, to IoTHubClient_LL_SendEventEntry. ]*/
+    DList_InitializeListHead(&pendingEvents);
+    result = mpsc_queue_pop_all(iotHubClientInstance->PendingEvents, &pendingEvents);
+    while (!DList_IsListEmpty(&pendingEvents))
+    {
+        PDLIST_ENTRY entry = DList_RemoveHeadList(&pendingEvents);
+        PENDING_EVENT* pendingEvent = containingRecord(entry, PENDING_EVENT, event.entry);
+
+        if (iotHubClientInstance->created_with_transport_handle == 0)
+        {
+            iotHubClientInstance->event_confirm_callback = pendingEvent->eventConfirmationCallback;
+        }
+
+        if (IoTHubClient_LL_SendEventEntry(iotHubClientInstance->IoTHubClientLLHandle, &pendingEvent->event) != IOTHUB_CLIENT_OK)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_11_020: [ If IoTHubClient_LL_SendEventEntry fails, the event confirmation callback of the event shall be called with IOTHUB_CLIENT_CONFIRMATION_ERROR and the event shall be freed. ]*/
+            LogError("IoTHubClient_LL_SendEventEntry failed");
+            if (pendingEvent->event.callback != NULL)
+            {
+                pendingEvent->event.callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, pendingEvent->event.context);
+            }
+            IoTHubMessage_Destroy(pendingEvent->event.messageHandle);
+            free(pendingEvent);
+        }
+    }
+
+    return result;
+}
+
+/*must be called with LockHandle held, once IoTHubClient_LL_DoWork had a chance to confirm events*/
+static void signal_send_queue_room(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    if (iotHubClientInstance->BlockedSenders != 0)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_11_032: [ After each IoTHubClient_LL_DoWork, if senders are waiting for room in the send queue, the worker shall signal them by calling Condition_Post. ]*/
+        if (Condition_Post(iotHubClientInstance->QueueSpaceCondition) != COND_OK)
+        {
+            LogError("Condition_Post failed, the waiting senders will retry after their timeout");
+        }
+    }
 }
 
 static void ScheduleWork_Thread_ForMultiplexing(void* iotHubClientHandle)
@@ -583,21 +696,128 @@ static void ScheduleWork_Thread_ForMultiplexing(void* iotHubClientHandle)
 #endif
     if (Lock(iotHubClientInstance->LockHandle) == LOCK_OK)
     {
-        VECTOR_HANDLE call_backs = VECTOR_move(iotHubClientInstance->saved_user_callback_list);
+        /*the shared transport already ran IoTHubClient_LL_DoWork for this client, the events are sent on its next pass*/
+        size_t submitted = send_pending_events(iotHubClientInstance);
+        signal_send_queue_room(iotHubClientInstance);
+        /*Codes_SRS_IOTHUBCLIENT_11_027: [ The thread dispatching the user callbacks shall take them by calling double_buffer_swap under the lock and read them after releasing it, without allocating a new container. ]*/
+        size_t call_backs = double_buffer_swap(iotHubClientInstance->saved_user_callback_list);
         (void)Unlock(iotHubClientInstance->LockHandle);
 
-        if (call_backs == NULL)
+        if (dispatch_user_callbacks(iotHubClientInstance, call_backs) != 0 || submitted != 0)
         {
-            LogError("Failed moving user callbacks");
+            /*Codes_SRS_IOTHUBCLIENT_11_004: [ If user callbacks were dispatched or pending events were submitted on a shared transport, ScheduleWork_Thread_ForMultiplexing shall call IoTHubTransport_SignalWorkerThread so the transport worker runs again without waiting. ]*/
+            /*this runs on the transport worker thread itself, so the transport lock is not needed*/
+            IoTHubTransport_SignalWorkerThread(iotHubClientInstance->TransportHandle);
         }
-        else
+    }
+    else
+    {
+        LogError("failed locking for ScheduleWork_Thread_ForMultiplexing");
+    }
+}
+
+static unsigned int get_next_idle_wait(unsigned int currentWaitMs, unsigned int maxWaitMs, bool hadWork)
+{
+    unsigned int result;
+
+    if (hadWork)
+    {
+        result = WORKER_THREAD_MIN_IDLE_WAIT_MS;
+    }
+    else if (currentWaitMs >= maxWaitMs / 2)
+    {
+        result = maxWaitMs;
+    }
+    else
+    {
+        result = currentWaitMs * 2;
+    }
+
+    return result;
+}
+
+static void wait_for_work(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, bool hadWork)
+{
+    if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    {
+        LogError("failed locking for wait_for_work");
+        (void)ThreadAPI_Sleep(WORKER_THREAD_MIN_IDLE_WAIT_MS);
+    }
+    else
+    {
+        unsigned int waitMs = 0;
+
+        /*Codes_SRS_IOTHUBCLIENT_11_001: [ Between two calls to IoTHubClient_LL_DoWork the thread shall wait on its condition for at most the current idle wait, which starts at 1 ms, doubles each time an iteration dispatched no callbacks and never exceeds the value set with OPTION_WORKER_MAX_IDLE_WAIT. ]*/
+        iotHubClientInstance->IdleWaitMs = get_next_idle_wait(iotHubClientInstance->IdleWaitMs, iotHubClientInstance->MaxIdleWaitMs, hadWork);
+
+        /*Codes_SRS_IOTHUBCLIENT_11_002: [ If work was signaled or the thread was asked to stop since the last call to IoTHubClient_LL_DoWork, the thread shall not wait. ]*/
+        if (!iotHubClientInstance->StopThread && !iotHubClientInstance->WorkPending)
         {
-            dispatch_user_callbacks(iotHubClientInstance, call_backs);
+            tickcounter_ms_t timeToDeadlineMs;
+
+            waitMs = iotHubClientInstance->IdleWaitMs;
+            /*Codes_SRS_IOTHUBCLIENT_11_040: [ The thread shall not wait past the earliest message deadline obtained with IoTHubClient_LL_GetTimeToNextDeadline, and shall not wait at all once that deadline is reached. ]*/
+            if (IoTHubClient_LL_GetTimeToNextDeadline(iotHubClientInstance->IoTHubClientLLHandle, &timeToDeadlineMs) && (timeToDeadlineMs < waitMs))
+            {
+                waitMs = (unsigned int)timeToDeadlineMs;
+            }
+        }
+        (void)Unlock(iotHubClientInstance->LockHandle);
+
+        /*Codes_SRS_IOTHUBCLIENT_11_046: [ The thread shall wait on its condition with a lock of its own, created together with the condition, and shall not hold the lock of the IoTHubClient while it waits. ]*/
+        if (waitMs > 0)
+        {
+            if (Lock(iotHubClientInstance->WakeLockHandle) != LOCK_OK)
+            {
+                LogError("failed locking the wake lock for wait_for_work");
+                (void)ThreadAPI_Sleep(WORKER_THREAD_MIN_IDLE_WAIT_MS);
+            }
+            else
+            {
+                /*work signaled since the check above was posted under WakeLockHandle, so it is either seen here or wakes the wait*/
+                if (!iotHubClientInstance->StopThread && !iotHubClientInstance->WorkPending)
+                {
+                    (void)Condition_Wait(iotHubClientInstance->WorkCondition, iotHubClientInstance->WakeLockHandle, (int)waitMs);
+                }
+                (void)Unlock(iotHubClientInstance->WakeLockHandle);
+            }
         }
     }
+}
+
+/*the worker checks WorkPending and StopThread under WakeLockHandle before waiting, so setting them before posting under it cannot lose the wake up*/
+static void post_work_condition(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    if (Lock(iotHubClientInstance->WakeLockHandle) != LOCK_OK)
+    {
+        LogError("failed locking to wake the worker thread, it will pick the work up after its idle wait");
+    }
     else
     {
-        LogError("failed locking for ScheduleWork_Thread_ForMultiplexing");
+        if (Condition_Post(iotHubClientInstance->WorkCondition) != COND_OK)
+        {
+            LogError("Condition_Post failed, the worker thread will pick the work up after its idle wait");
+        }
+        (void)Unlock(iotHubClientInstance->WakeLockHandle);
+    }
+}
+
+/*may be called with or without LockHandle held, neither path takes it*/
+static void wake_worker_thread(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    if (iotHubClientInstance->TransportHandle != NULL)
+    {
+        IoTHubTransport_SignalWorkerThread(iotHubClientInstance->TransportHandle);
+    }
+    else if (iotHubClientInstance->PoolClientHandle != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_11_016: [ When work is queued for a client driven by a worker pool, the IoTHubClient shall call IoTHubClientPool_SignalClient. ]*/
+        IoTHubClientPool_SignalClient(iotHubClientInstance->PoolClientHandle);
+    }
+    else if (iotHubClientInstance->WorkCondition != NULL && iotHubClientInstance->WakeLockHandle != NULL)
+    {
+        iotHubClientInstance->WorkPending = 1;
+        post_work_condition(iotHubClientInstance);
     }
 }
 
@@ -607,6 +827,8 @@ static int ScheduleWork_Thread(void* threadArgument)
 
     while (1)
     {
+        size_t dispatched = 0;
+
         if (Lock(iotHubClientInstance->LockHandle) == LOCK_OK)
         {
             /*Codes_SRS_IOTHUBCLIENT_01_038: [ The thread shall exit when IoTHubClient_Destroy is called. ]*/
@@ -617,23 +839,19 @@ static int ScheduleWork_Thread(void* threadArgument)
             }
             else
             {
-                /* Codes_SRS_IOTHUBCLIENT_01_037: [The thread created by IoTHubClient_SendEvent or IoTHubClient_SetMessageCallback shall call IoTHubClient_LL_DoWork every 1 ms.] */
+                /* Codes_SRS_IOTHUBCLIENT_01_037: [The thread created by IoTHubClient_SendEvent or IoTHubClient_SetMessageCallback shall call IoTHubClient_LL_DoWork repeatedly, waiting between calls as described by SRS_IOTHUBCLIENT_11_001.] */
                 /* Codes_SRS_IOTHUBCLIENT_01_039: [All calls to IoTHubClient_LL_DoWork shall be protected by the lock created in IotHubClient_Create.] */
+                iotHubClientInstance->WorkPending = 0;
+                (void)send_pending_events(iotHubClientInstance);
                 IoTHubClient_LL_DoWork(iotHubClientInstance->IoTHubClientLLHandle);
+                signal_send_queue_room(iotHubClientInstance);
 
 #ifndef DONT_USE_UPLOADTOBLOB
                 garbageCollectorImpl(iotHubClientInstance);
 #endif
-                VECTOR_HANDLE call_backs = VECTOR_move(iotHubClientInstance->saved_user_callback_list);
+                size_t call_backs = double_buffer_swap(iotHubClientInstance->saved_user_callback_list);
                 (void)Unlock(iotHubClientInstance->LockHandle);
-                if (call_backs == NULL)
-                {
-                    LogError("VECTOR_move failed");
-                }
-                else
-                {
-                    dispatch_user_callbacks(iotHubClientInstance, call_backs);
-                }
+                dispatched = dispatch_user_callbacks(iotHubClientInstance, call_backs);
             }
         }
         else
@@ -641,22 +859,113 @@ static int ScheduleWork_Thread(void* threadArgument)
             /*Codes_SRS_IOTHUBCLIENT_01_040: [If acquiring the lock fails, IoTHubClient_LL_DoWork shall not be called.]*/
             /*no code, shall retry*/
         }
-        (void)ThreadAPI_Sleep(1);
+        wait_for_work(iotHubClientInstance, dispatched != 0);
     }
 
     ThreadAPI_Exit(0);
     return 0;
 }
 
+static bool ScheduleWork_Pool_DoWork(void* client, unsigned int* maxWaitMs)
+{
+    IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)client;
+    bool result;
+    tickcounter_ms_t timeToDeadlineMs;
+
+    if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    {
+        LogError("failed locking for ScheduleWork_Pool_DoWork");
+        result = false;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_11_014: [ A pool I/O thread shall call IoTHubClient_LL_DoWork under the lock of the IoTHubClient and report whether user callbacks were queued. ]*/
+        (void)send_pending_events(iotHubClientInstance);
+        IoTHubClient_LL_DoWork(iotHubClientInstance->IoTHubClientLLHandle);
+        signal_send_queue_room(iotHubClientInstance);
+
+#ifndef DONT_USE_UPLOADTOBLOB
+        garbageCollectorImpl(iotHubClientInstance);
+#endif
+        /*Codes_SRS_IOTHUBCLIENT_11_043: [ A pool I/O thread shall lower maxWaitMs to the OPTION_WORKER_MAX_IDLE_WAIT of the client and to the time left before its earliest message deadline obtained with IoTHubClient_LL_GetTimeToNextDeadline. ]*/
+        if (iotHubClientInstance->MaxIdleWaitMs < *maxWaitMs)
+        {
+            *maxWaitMs = iotHubClientInstance->MaxIdleWaitMs;
+        }
+        if (IoTHubClient_LL_GetTimeToNextDeadline(iotHubClientInstance->IoTHubClientLLHandle, &timeToDeadlineMs) && (timeToDeadlineMs < *maxWaitMs))
+        {
+            *maxWaitMs = (unsigned int)timeToDeadlineMs;
+        }
+
+        result = double_buffer_get_count(iotHubClientInstance->saved_user_callback_list) != 0;
+        (void)Unlock(iotHubClientInstance->LockHandle);
+    }
+
+    return result;
+}
+
+static void ScheduleWork_Pool_Dispatch(void* client)
+{
+    IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)client;
+
+    if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    {
+        LogError("failed locking for ScheduleWork_Pool_Dispatch");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_11_015: [ The pool shall dispatch the user callbacks of a client the same way the worker thread of the IoTHubClient does. ]*/
+        size_t call_backs = double_buffer_swap(iotHubClientInstance->saved_user_callback_list);
+        (void)Unlock(iotHubClientInstance->LockHandle);
+
+        (void)dispatch_user_callbacks(iotHubClientInstance, call_backs);
+
+        if (iotHubClientInstance->DestroyPending)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_11_042: [ Once the callbacks are dispatched, the pool thread shall destroy an IoTHubClient that IoTHubClient_Destroy was called for from one of them, detaching it from the pool with IoTHubClientPool_RemoveClientFromDispatch. ]*/
+            destroy_client(iotHubClientInstance, true);
+        }
+    }
+}
+
 static IOTHUB_CLIENT_RESULT StartWorkerThreadIfNeeded(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
 {
     IOTHUB_CLIENT_RESULT result;
-    if (iotHubClientInstance->TransportHandle == NULL)
+    if (iotHubClientInstance->PoolHandle != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_11_013: [ If a worker pool was set, the IoTHubClient shall not start its own thread and shall instead attach itself to the pool by calling IoTHubClientPool_AddClient. ]*/
+        if (iotHubClientInstance->PoolClientHandle == NULL &&
+            (iotHubClientInstance->PoolClientHandle = IoTHubClientPool_AddClient(iotHubClientInstance->PoolHandle, iotHubClientInstance, ScheduleWork_Pool_DoWork, ScheduleWork_Pool_Dispatch)) == NULL)
+        {
+            LogError("IoTHubClientPool_AddClient failed");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+    else if (iotHubClientInstance->TransportHandle == NULL)
     {
         if (iotHubClientInstance->ThreadHandle == NULL)
         {
             iotHubClientInstance->StopThread = 0;
-            if (ThreadAPI_Create(&iotHubClientInstance->ThreadHandle, ScheduleWork_Thread, iotHubClientInstance) != THREADAPI_OK)
+            iotHubClientInstance->WorkPending = 0;
+            /*Codes_SRS_IOTHUBCLIENT_11_003: [ Before starting its own worker thread, the IoTHubClient shall create the condition the thread waits on by calling Condition_Init. ]*/
+            if (iotHubClientInstance->WorkCondition == NULL &&
+                (iotHubClientInstance->WorkCondition = Condition_Init()) == NULL)
+            {
+                LogError("Condition_Init failed");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            /*Codes_SRS_IOTHUBCLIENT_11_047: [ Before starting its own worker thread, the IoTHubClient shall also create the lock the thread waits with by calling Lock_Init. ]*/
+            else if (iotHubClientInstance->WakeLockHandle == NULL &&
+                (iotHubClientInstance->WakeLockHandle = Lock_Init()) == NULL)
+            {
+                LogError("Lock_Init failed");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (ThreadAPI_Create(&iotHubClientInstance->ThreadHandle, ScheduleWork_Thread, iotHubClientInstance) != THREADAPI_OK)
             {
                 LogError("ThreadAPI_Create failed");
                 iotHubClientInstance->ThreadHandle = NULL;
@@ -691,9 +1000,17 @@ static IOTHUB_CLIENT_INSTANCE* create_iothub_instance(const IOTHUB_CLIENT_CONFIG
     if (result != NULL)
     {
         /* Codes_SRS_IOTHUBCLIENT_01_029: [IoTHubClient_Create shall create a lock object to be used later for serializing IoTHubClient calls.] */
-        if ( (result->saved_user_callback_list = VECTOR_create(sizeof(USER_CALLBACK_INFO)) ) == NULL)
+        if ( (result->saved_user_callback_list = double_buffer_create(sizeof(USER_CALLBACK_INFO), USER_CALLBACK_INITIAL_SLOTS) ) == NULL)
         {
-            LogError("Failed creating VECTOR");
+            LogError("Failed creating the user callback buffer");
+            free(result);
+            result = NULL;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_11_021: [ IoTHubClient_Create shall create the submission queue of the events by calling mpsc_queue_create; if that fails it shall free all the resources allocated so far and return NULL. ]*/
+        else if ((result->PendingEvents = mpsc_queue_create()) == NULL)
+        {
+            LogError("Failed creating the queue of pending events");
+            double_buffer_destroy(result->saved_user_callback_list);
             free(result);
             result = NULL;
         }
@@ -705,7 +1022,8 @@ static IOTHUB_CLIENT_INSTANCE* create_iothub_instance(const IOTHUB_CLIENT_CONFIG
             {
                 /*Codes_SRS_IOTHUBCLIENT_02_061: [ If creating the SINGLYLINKEDLIST_HANDLE fails then IoTHubClient_Create shall fail and return NULL. ]*/
                 LogError("unable to singlylinkedlist_create");
-                VECTOR_destroy(result->saved_user_callback_list);
+                mpsc_queue_destroy(result->PendingEvents);
+                double_buffer_destroy(result->saved_user_callback_list);
                 free(result);
                 result = NULL;
             }
@@ -830,13 +1148,33 @@ static IOTHUB_CLIENT_INSTANCE* create_iothub_instance(const IOTHUB_CLIENT_CONFIG
                     singlylinkedlist_destroy(result->savedDataToBeCleaned);
 #endif
                     LogError("Failure creating iothub handle");
-                    VECTOR_destroy(result->saved_user_callback_list);
+                    mpsc_queue_destroy(result->PendingEvents);
+                    double_buffer_destroy(result->saved_user_callback_list);
                     free(result);
                     result = NULL;
                 }
                 else
                 {
                     result->ThreadHandle = NULL;
+                    result->WorkCondition = NULL;
+                    result->WakeLockHandle = NULL;
+                    result->WorkPending = 0;
+                    result->PoolHandle = NULL;
+                    result->PoolClientHandle = NULL;
+                    result->DestroyPending = 0;
+#ifndef IOTHUB_THREAD_LOCAL
+                    result->IsDispatching = 0;
+#endif
+                    result->IdleWaitMs = WORKER_THREAD_MIN_IDLE_WAIT_MS;
+                    result->MaxIdleWaitMs = WORKER_THREAD_DEFAULT_MAX_IDLE_WAIT_MS;
+                    result->SendQueueBounded = 0;
+                    result->MaxQueuedMessages = 0;
+                    result->MaxQueuedBytes = 0;
+                    result->QueueOverflowPolicy = IOTHUB_CLIENT_QUEUE_OVERFLOW_REJECT;
+                    result->QueueBlockTimeoutMs = 0;
+                    result->QueueSpaceCondition = NULL;
+                    result->QueueTickCounter = NULL;
+                    result->BlockedSenders = 0;
                     result->desired_state_callback = NULL;
                     result->event_confirm_callback = NULL;
                     result->reported_state_callback = NULL;
@@ -940,147 +1278,333 @@ IOTHUB_CLIENT_HANDLE IoTHubClient_CreateFromDeviceAuth(const char* iothub_uri, c
     return result;
 }
 
-/* Codes_SRS_IOTHUBCLIENT_01_005: [IoTHubClient_Destroy shall free all resources associated with the iotHubClientHandle instance.] */
-void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
+static void destroy_client(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, bool isPoolDispatching)
 {
-    /* Codes_SRS_IOTHUBCLIENT_01_008: [IoTHubClient_Destroy shall do nothing if parameter iotHubClientHandle is NULL.] */
-    if (iotHubClientHandle != NULL)
-    {
-        bool joinClientThread;
-        bool joinTransportThread;
-        size_t vector_size;
+    bool joinClientThread;
+    bool joinTransportThread;
+    size_t vector_size;
 
-        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+    if (iotHubClientInstance->TransportHandle != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_01_007: [ The thread created as part of executing IoTHubClient_SendEventAsync or IoTHubClient_SetNotificationMessageCallback shall be joined. ]*/
+        joinTransportThread = IoTHubTransport_SignalEndWorkerThread(iotHubClientInstance->TransportHandle, iotHubClientInstance);
+    }
+    else
+    {
+        joinTransportThread = false;
+    }
 
-        if (iotHubClientInstance->TransportHandle != NULL)
+    if (iotHubClientInstance->PoolClientHandle != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_11_017: [ If the IoTHubClient is driven by a worker pool, IoTHubClient_Destroy shall detach it from the pool by calling IoTHubClientPool_RemoveClient before taking its lock. ]*/
+        if (isPoolDispatching)
         {
-            /*Codes_SRS_IOTHUBCLIENT_01_007: [ The thread created as part of executing IoTHubClient_SendEventAsync or IoTHubClient_SetNotificationMessageCallback shall be joined. ]*/
-            joinTransportThread = IoTHubTransport_SignalEndWorkerThread(iotHubClientInstance->TransportHandle, iotHubClientHandle);
+            IoTHubClientPool_RemoveClientFromDispatch(iotHubClientInstance->PoolClientHandle);
         }
         else
         {
-            joinTransportThread = false;
+            IoTHubClientPool_RemoveClient(iotHubClientInstance->PoolClientHandle);
         }
+    }
 
-        /*Codes_SRS_IOTHUBCLIENT_02_043: [ IoTHubClient_Destroy shall lock the serializing lock and signal the worker thread (if any) to end ]*/
-        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
-        {
-            LogError("unable to Lock - - will still proceed to try to end the thread without locking");
-        }
+    /*Codes_SRS_IOTHUBCLIENT_02_043: [ IoTHubClient_Destroy shall lock the serializing lock and signal the worker thread (if any) to end ]*/
+    if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    {
+        LogError("unable to Lock - - will still proceed to try to end the thread without locking");
+    }
 
-        if (iotHubClientInstance->ThreadHandle != NULL)
-        {
-            iotHubClientInstance->StopThread = 1;
-            joinClientThread = true;
-        }
-        else
-        {
-            joinClientThread = false;
-        }
+    if (iotHubClientInstance->ThreadHandle != NULL)
+    {
+        iotHubClientInstance->StopThread = 1;
+        post_work_condition(iotHubClientInstance);
+        joinClientThread = true;
+    }
+    else
+    {
+        joinClientThread = false;
+    }
+
+    /*Codes_SRS_IOTHUBCLIENT_02_045: [ IoTHubClient_Destroy shall unlock the serializing lock. ]*/
+    if (Unlock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    {
+        LogError("unable to Unlock");
+    }
 
-        /*Codes_SRS_IOTHUBCLIENT_02_045: [ IoTHubClient_Destroy shall unlock the serializing lock. ]*/
-        if (Unlock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    if (joinClientThread == true)
+    {
+        int res;
+        /*Codes_SRS_IOTHUBCLIENT_01_007: [ The thread created as part of executing IoTHubClient_SendEventAsync or IoTHubClient_SetNotificationMessageCallback shall be joined. ]*/
+        if (ThreadAPI_Join(iotHubClientInstance->ThreadHandle, &res) != THREADAPI_OK)
         {
-            LogError("unable to Unlock");
+            LogError("ThreadAPI_Join failed");
         }
+    }
+
+    if (joinTransportThread == true)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_01_007: [ The thread created as part of executing IoTHubClient_SendEventAsync or IoTHubClient_SetNotificationMessageCallback shall be joined. ]*/
+        IoTHubTransport_JoinWorkerThread(iotHubClientInstance->TransportHandle, iotHubClientInstance);
+    }
+
+    if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    {
+        LogError("unable to Lock - - will still proceed to try to end the thread without locking");
+    }
+
+#ifndef DONT_USE_UPLOADTOBLOB
+    /*Codes_SRS_IOTHUBCLIENT_02_069: [ IoTHubClient_Destroy shall free all data created by IoTHubClient_UploadToBlobAsync ]*/
+    /*wait for all uploading threads to finish*/
+    while (singlylinkedlist_get_head_item(iotHubClientInstance->savedDataToBeCleaned) != NULL)
+    {
+        garbageCollectorImpl(iotHubClientInstance);
+    }
+
+    if (iotHubClientInstance->savedDataToBeCleaned != NULL)
+    {
+        singlylinkedlist_destroy(iotHubClientInstance->savedDataToBeCleaned);
+    }
+#endif
+
+    /*Codes_SRS_IOTHUBCLIENT_11_022: [ IoTHubClient_Destroy shall hand the events still in the submission queue to IoTHubClient_LL before destroying it, so that their callbacks are called with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY. ]*/
+    (void)send_pending_events(iotHubClientInstance);
+
+    /* Codes_SRS_IOTHUBCLIENT_01_006: [That includes destroying the IoTHubClient_LL instance by calling IoTHubClient_LL_Destroy.] */
+    IoTHubClient_LL_Destroy(iotHubClientInstance->IoTHubClientLLHandle);
 
-        if (joinClientThread == true)
+    if (Unlock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    {
+        LogError("unable to Unlock");
+    }
+
+
+    vector_size = double_buffer_swap(iotHubClientInstance->saved_user_callback_list);
+    size_t index = 0;
+    for (index = 0; index < vector_size; index++)
+    {
+        USER_CALLBACK_INFO* queue_cb_info = (USER_CALLBACK_INFO*)double_buffer_get_element(iotHubClientInstance->saved_user_callback_list, index);
+        if (queue_cb_info != NULL)
         {
-            int res;
-            /*Codes_SRS_IOTHUBCLIENT_01_007: [ The thread created as part of executing IoTHubClient_SendEventAsync or IoTHubClient_SetNotificationMessageCallback shall be joined. ]*/
-            if (ThreadAPI_Join(iotHubClientInstance->ThreadHandle, &res) != THREADAPI_OK)
+            if ((queue_cb_info->type == CALLBACK_TYPE_DEVICE_METHOD) || (queue_cb_info->type == CALLBACK_TYPE_INBOUD_DEVICE_METHOD))
             {
-                LogError("ThreadAPI_Join failed");
+                free(queue_cb_info->iothub_callback.method_cb_info.method_name);
+                CONSTBUFFER_Destroy(queue_cb_info->iothub_callback.method_cb_info.payload);
+            }
+            else if (queue_cb_info->type == CALLBACK_TYPE_DEVICE_TWIN)
+            {
+                if (queue_cb_info->iothub_callback.dev_twin_cb_info.payLoad != NULL)
+                {
+                    CONSTBUFFER_Destroy(queue_cb_info->iothub_callback.dev_twin_cb_info.payLoad);
+                }
+            }
+            else if (queue_cb_info->type == CALLBACK_TYPE_EVENT_CONFIRM)
+            {
+                if (iotHubClientInstance->event_confirm_callback)
+                {
+                    iotHubClientInstance->event_confirm_callback(queue_cb_info->iothub_callback.event_confirm_cb_info.confirm_result, queue_cb_info->userContextCallback);
+                }
             }
         }
+    }
+    double_buffer_destroy(iotHubClientInstance->saved_user_callback_list);
+    mpsc_queue_destroy(iotHubClientInstance->PendingEvents);
 
-        if (joinTransportThread == true)
-        {
-            /*Codes_SRS_IOTHUBCLIENT_01_007: [ The thread created as part of executing IoTHubClient_SendEventAsync or IoTHubClient_SetNotificationMessageCallback shall be joined. ]*/
-            IoTHubTransport_JoinWorkerThread(iotHubClientInstance->TransportHandle, iotHubClientHandle);
-        }
+    if (iotHubClientInstance->TransportHandle == NULL)
+    {
+        /* Codes_SRS_IOTHUBCLIENT_01_032: [If the lock was allocated in IoTHubClient_Create, it shall be also freed..] */
+        Lock_Deinit(iotHubClientInstance->LockHandle);
+    }
+    if (iotHubClientInstance->WorkCondition != NULL)
+    {
+        Condition_Deinit(iotHubClientInstance->WorkCondition);
+    }
+    if (iotHubClientInstance->WakeLockHandle != NULL)
+    {
+        Lock_Deinit(iotHubClientInstance->WakeLockHandle);
+    }
+    if (iotHubClientInstance->QueueSpaceCondition != NULL)
+    {
+        Condition_Deinit(iotHubClientInstance->QueueSpaceCondition);
+    }
+    if (iotHubClientInstance->QueueTickCounter != NULL)
+    {
+        tickcounter_destroy(iotHubClientInstance->QueueTickCounter);
+    }
+    if (iotHubClientInstance->devicetwin_user_context != NULL)
+    {
+        free(iotHubClientInstance->devicetwin_user_context);
+    }
+    if (iotHubClientInstance->connection_status_user_context != NULL)
+    {
+        free(iotHubClientInstance->connection_status_user_context);
+    }
+    if (iotHubClientInstance->message_user_context != NULL)
+    {
+        free(iotHubClientInstance->message_user_context);
+    }
+    if (iotHubClientInstance->method_user_context != NULL)
+    {
+        free(iotHubClientInstance->method_user_context);
+    }
+    free(iotHubClientInstance);
+}
 
-        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
-        {
-            LogError("unable to Lock - - will still proceed to try to end the thread without locking");
-        }
+/*returns true when IoTHubClient_Destroy is called from a user callback of the client a worker pool is dispatching and shall be left to the pool thread*/
+static bool mark_destroy_pending(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    bool result;
 
-#ifndef DONT_USE_UPLOADTOBLOB
-        /*Codes_SRS_IOTHUBCLIENT_02_069: [ IoTHubClient_Destroy shall free all data created by IoTHubClient_UploadToBlobAsync ]*/
-        /*wait for all uploading threads to finish*/
-        while (singlylinkedlist_get_head_item(iotHubClientInstance->savedDataToBeCleaned) != NULL)
+    if (iotHubClientInstance->PoolClientHandle == NULL)
+    {
+        result = false;
+    }
+#ifdef IOTHUB_THREAD_LOCAL
+    else if (g_dispatching_client == iotHubClientInstance)
+    {
+        iotHubClientInstance->DestroyPending = 1;
+        result = true;
+    }
+    else
+    {
+        result = false;
+    }
+#else
+    else if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    {
+        LogError("failed locking to find out whether the callbacks of the client are being dispatched");
+        result = false;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_11_045: [ Without thread local storage, IoTHubClient_Destroy shall also only mark the IoTHubClient as destroyed when it is called from another thread while a worker pool dispatches the callbacks of the IoTHubClient. ]*/
+        if (iotHubClientInstance->IsDispatching)
         {
-            garbageCollectorImpl(iotHubClientInstance);
+            iotHubClientInstance->DestroyPending = 1;
+            result = true;
         }
-
-        if (iotHubClientInstance->savedDataToBeCleaned != NULL)
+        else
         {
-            singlylinkedlist_destroy(iotHubClientInstance->savedDataToBeCleaned);
+            result = false;
         }
+        (void)Unlock(iotHubClientInstance->LockHandle);
+    }
 #endif
 
-        /* Codes_SRS_IOTHUBCLIENT_01_006: [That includes destroying the IoTHubClient_LL instance by calling IoTHubClient_LL_Destroy.] */
-        IoTHubClient_LL_Destroy(iotHubClientInstance->IoTHubClientLLHandle);
+    return result;
+}
 
-        if (Unlock(iotHubClientInstance->LockHandle) != LOCK_OK)
+/* Codes_SRS_IOTHUBCLIENT_01_005: [IoTHubClient_Destroy shall free all resources associated with the iotHubClientHandle instance.] */
+void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
+{
+    /* Codes_SRS_IOTHUBCLIENT_01_008: [IoTHubClient_Destroy shall do nothing if parameter iotHubClientHandle is NULL.] */
+    if (iotHubClientHandle != NULL)
+    {
+        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+        /*Codes_SRS_IOTHUBCLIENT_11_041: [ If IoTHubClient_Destroy is called from a user callback that a worker pool is dispatching for the same IoTHubClient, it shall only mark the IoTHubClient as destroyed and return. ]*/
+        if (!mark_destroy_pending(iotHubClientInstance))
         {
-            LogError("unable to Unlock");
+            destroy_client(iotHubClientInstance, false);
         }
+    }
+}
 
+/*must be called with LockHandle held, returns false when the sender shall not wait (anymore) for room in the send queue*/
+static bool get_send_queue_wait(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, bool* isWaiting, tickcounter_ms_t* waitStartMs, unsigned int* waitMs)
+{
+    bool result;
+    tickcounter_ms_t nowMs;
 
-        vector_size = VECTOR_size(iotHubClientInstance->saved_user_callback_list);
-        size_t index = 0;
-        for (index = 0; index < vector_size; index++)
+    if ((iotHubClientInstance->QueueOverflowPolicy != IOTHUB_CLIENT_QUEUE_OVERFLOW_BLOCK) ||
+        (iotHubClientInstance->QueueBlockTimeoutMs == 0))
+    {
+        result = false;
+    }
+#ifdef IOTHUB_THREAD_LOCAL
+    else if (g_dispatching_client != NULL)
+#else
+    /*without thread local storage only the callbacks of this client are known, an event sent from a callback of another client waits at most QueueBlockTimeoutMs*/
+    else if (iotHubClientInstance->IsDispatching)
+#endif
+    {
+        /*Codes_SRS_IOTHUBCLIENT_11_044: [ If IoTHubClient_SendEventAsync is called from a user callback, it shall not wait for room in the send queue and shall return IOTHUB_CLIENT_QUEUE_FULL as with the IOTHUB_CLIENT_QUEUE_OVERFLOW_REJECT policy. ]*/
+        LogError("the send queue is full and the event was sent from a user callback, waiting could block the thread that makes room");
+        result = false;
+    }
+    else if (tickcounter_get_current_ms(iotHubClientInstance->QueueTickCounter, &nowMs) != 0)
+    {
+        LogError("tickcounter_get_current_ms failed, not waiting for room in the send queue");
+        result = false;
+    }
+    else
+    {
+        if (!*isWaiting)
         {
-            USER_CALLBACK_INFO* queue_cb_info = (USER_CALLBACK_INFO*)VECTOR_element(iotHubClientInstance->saved_user_callback_list, index);
-            if (queue_cb_info != NULL)
-            {
-                if ((queue_cb_info->type == CALLBACK_TYPE_DEVICE_METHOD) || (queue_cb_info->type == CALLBACK_TYPE_INBOUD_DEVICE_METHOD))
-                {
-                    STRING_delete(queue_cb_info->iothub_callback.method_cb_info.method_name);
-                    BUFFER_delete(queue_cb_info->iothub_callback.method_cb_info.payload);
-                }
-                else if (queue_cb_info->type == CALLBACK_TYPE_DEVICE_TWIN)
-                {
-                    if (queue_cb_info->iothub_callback.dev_twin_cb_info.payLoad != NULL)
-                    {
-                        free(queue_cb_info->iothub_callback.dev_twin_cb_info.payLoad);
-                    }
-                }
-                else if (queue_cb_info->type == CALLBACK_TYPE_EVENT_CONFIRM)
-                {
-                    if (iotHubClientInstance->event_confirm_callback)
-                    {
-                        iotHubClientInstance->event_confirm_callback(queue_cb_info->iothub_callback.event_confirm_cb_info.confirm_result, queue_cb_info->userContextCallback);
-                    }
-                }
-            }
+            *isWaiting = true;
+            *waitStartMs = nowMs;
         }
-        VECTOR_destroy(iotHubClientInstance->saved_user_callback_list);
 
-        if (iotHubClientInstance->TransportHandle == NULL)
+        if (nowMs - *waitStartMs >= iotHubClientInstance->QueueBlockTimeoutMs)
+        {
+            result = false;
+        }
+        else
         {
-            /* Codes_SRS_IOTHUBCLIENT_01_032: [If the lock was allocated in IoTHubClient_Create, it shall be also freed..] */
-            Lock_Deinit(iotHubClientInstance->LockHandle);
+            *waitMs = (unsigned int)(iotHubClientInstance->QueueBlockTimeoutMs - (nowMs - *waitStartMs));
+            result = true;
         }
-        if (iotHubClientInstance->devicetwin_user_context != NULL)
+    }
+
+    return result;
+}
+
+/*once in the submission queue an event can no longer be refused, so a bounded send queue is fed synchronously*/
+static IOTHUB_CLIENT_RESULT send_event_to_bounded_queue(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, PENDING_EVENT* pendingEvent)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LogError("Could not acquire lock");
+    }
+    else
+    {
+        bool isWaiting = false;
+        tickcounter_ms_t waitStartMs = 0;
+        unsigned int waitMs = 0;
+
+        /*the events submitted before the limits were set go first*/
+        (void)send_pending_events(iotHubClientInstance);
+
+        if (iotHubClientInstance->created_with_transport_handle == 0)
         {
-            free(iotHubClientInstance->devicetwin_user_context);
+            iotHubClientInstance->event_confirm_callback = pendingEvent->eventConfirmationCallback;
         }
-        if (iotHubClientInstance->connection_status_user_context != NULL)
+
+        /*Codes_SRS_IOTHUBCLIENT_11_030: [ With the IOTHUB_CLIENT_QUEUE_OVERFLOW_BLOCK policy, while IoTHubClient_LL_SendEventEntry returns IOTHUB_CLIENT_QUEUE_FULL, IoTHubClient_SendEventAsync shall wait on a condition for room in the send queue, at most for the time set with OPTION_QUEUE_BLOCK_TIMEOUT in total. ]*/
+        while (((result = IoTHubClient_LL_SendEventEntry(iotHubClientInstance->IoTHubClientLLHandle, &pendingEvent->event)) == IOTHUB_CLIENT_QUEUE_FULL) &&
+            get_send_queue_wait(iotHubClientInstance, &isWaiting, &waitStartMs, &waitMs))
         {
-            free(iotHubClientInstance->connection_status_user_context);
+            iotHubClientInstance->BlockedSenders++;
+            (void)Condition_Wait(iotHubClientInstance->QueueSpaceCondition, iotHubClientInstance->LockHandle, (int)waitMs);
+            iotHubClientInstance->BlockedSenders--;
         }
-        if (iotHubClientInstance->message_user_context != NULL)
+
+        /*the event is already in IoTHubClient_LL, the worker sends it without waiting for its idle wait*/
+        if (result == IOTHUB_CLIENT_OK)
         {
-            free(iotHubClientInstance->message_user_context);
+            wake_worker_thread(iotHubClientInstance);
         }
-        if (iotHubClientInstance->method_user_context != NULL)
+
+        (void)Unlock(iotHubClientInstance->LockHandle);
+
+        if (result != IOTHUB_CLIENT_OK)
         {
-            free(iotHubClientInstance->method_user_context);
+            LogError("IoTHubClient_LL_SendEventEntry failed, result = %s", ENUM_TO_STRING(IOTHUB_CLIENT_RESULT, result));
         }
-        free(iotHubClientInstance);
     }
+
+    return result;
 }
 
 IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
@@ -1093,6 +1617,12 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClie
         result = IOTHUB_CLIENT_INVALID_ARG;
         LogError("NULL iothubClientHandle");
     }
+    else if (eventMessageHandle == NULL || (eventConfirmationCallback == NULL && userContextCallback != NULL))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_11_023: [ If eventMessageHandle is NULL, or eventConfirmationCallback is NULL and userContextCallback is not, IoTHubClient_SendEventAsync shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("Invalid argument, eventMessageHandle [%p], userContextCallback [%p] without a callback", eventMessageHandle, userContextCallback);
+    }
     else
     {
         IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
@@ -1106,23 +1636,28 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClie
         }
         else
         {
-            /* Codes_SRS_IOTHUBCLIENT_01_025: [IoTHubClient_SendEventAsync shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
-            if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+            /* Codes_SRS_IOTHUBCLIENT_11_018: [ IoTHubClient_SendEventAsync shall not take the lock of the IoTHubClient; it shall clone eventMessageHandle into a new pending event and push it on the submission queue by calling mpsc_queue_push. ]*/
+            PENDING_EVENT* pendingEvent = (PENDING_EVENT*)malloc(sizeof(PENDING_EVENT));
+            if (pendingEvent == NULL)
             {
-                /* Codes_SRS_IOTHUBCLIENT_01_026: [If acquiring the lock fails, IoTHubClient_SendEventAsync shall return IOTHUB_CLIENT_ERROR.] */
                 result = IOTHUB_CLIENT_ERROR;
-                LogError("Could not acquire lock");
+                LogError("Failed allocating PENDING_EVENT");
+            }
+            else if ((pendingEvent->event.messageHandle = IoTHubMessage_Clone(eventMessageHandle)) == NULL)
+            {
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("IoTHubMessage_Clone failed");
+                free(pendingEvent);
             }
             else
             {
-                if (iotHubClientInstance->created_with_transport_handle == 0)
-                {
-                    iotHubClientInstance->event_confirm_callback = eventConfirmationCallback;
-                }
+                pendingEvent->eventConfirmationCallback = eventConfirmationCallback;
 
                 if (iotHubClientInstance->created_with_transport_handle != 0 || eventConfirmationCallback == NULL)
                 {
-                    result = IoTHubClient_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+                    pendingEvent->event.callback = eventConfirmationCallback;
+                    pendingEvent->event.context = userContextCallback;
+                    result = IOTHUB_CLIENT_OK;
                 }
                 else
                 {
@@ -1132,24 +1667,51 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClie
                     {
                         result = IOTHUB_CLIENT_ERROR;
                         LogError("Failed allocating QUEUE_CONTEXT");
+                        IoTHubMessage_Destroy(pendingEvent->event.messageHandle);
+                        free(pendingEvent);
                     }
                     else
                     {
                         queue_context->iotHubClientHandle = iotHubClientInstance;
                         queue_context->userContextCallback = userContextCallback;
-                        /* Codes_SRS_IOTHUBCLIENT_01_012: [IoTHubClient_SendEventAsync shall call IoTHubClient_LL_SendEventAsync, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameters eventMessageHandle, eventConfirmationCallback and userContextCallback.] */
-                        /* Codes_SRS_IOTHUBCLIENT_01_013: [When IoTHubClient_LL_SendEventAsync is called, IoTHubClient_SendEventAsync shall return the result of IoTHubClient_LL_SendEventAsync.] */
-                        result = IoTHubClient_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, iothub_ll_event_confirm_callback, queue_context);
-                        if (result != IOTHUB_CLIENT_OK)
+                        pendingEvent->event.callback = iothub_ll_event_confirm_callback;
+                        pendingEvent->event.context = queue_context;
+                        result = IOTHUB_CLIENT_OK;
+                    }
+                }
+
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    bool wakeWorker = false;
+
+                    if (iotHubClientInstance->SendQueueBounded)
+                    {
+                        /*Codes_SRS_IOTHUBCLIENT_11_029: [ If the send queue of IoTHubClient_LL is limited, IoTHubClient_SendEventAsync shall take the lock, hand the pending events and then the new event to IoTHubClient_LL_SendEventEntry and return its result. ]*/
+                        result = send_event_to_bounded_queue(iotHubClientInstance, pendingEvent);
+                    }
+                    else if (mpsc_queue_push(iotHubClientInstance->PendingEvents, &pendingEvent->event.entry, &wakeWorker) != 0)
+                    {
+                        /*Codes_SRS_IOTHUBCLIENT_11_039: [ If mpsc_queue_push fails, IoTHubClient_SendEventAsync shall return IOTHUB_CLIENT_ERROR. ]*/
+                        LogError("mpsc_queue_push failed");
+                        result = IOTHUB_CLIENT_ERROR;
+                    }
+
+                    if (result != IOTHUB_CLIENT_OK)
+                    {
+                        /*Codes_SRS_IOTHUBCLIENT_11_031: [ If the event is not accepted, IoTHubClient_SendEventAsync shall free it without calling its confirmation callback. ]*/
+                        if (pendingEvent->event.callback == iothub_ll_event_confirm_callback)
                         {
-                            LogError("IoTHubClient_LL_SendEventAsync failed");
-                            free(queue_context);
+                            free(pendingEvent->event.context);
                         }
+                        IoTHubMessage_Destroy(pendingEvent->event.messageHandle);
+                        free(pendingEvent);
+                    }
+                    /*Codes_SRS_IOTHUBCLIENT_11_005: [ If the event was queued into an empty submission queue, IoTHubClient_SendEventAsync shall wake the worker thread so the event is sent without waiting for the idle wait to expire. ]*/
+                    else if (wakeWorker)
+                    {
+                        wake_worker_thread(iotHubClientInstance);
                     }
                 }
-
-                /* Codes_SRS_IOTHUBCLIENT_01_025: [IoTHubClient_SendEventAsync shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
-                (void)Unlock(iotHubClientInstance->LockHandle);
             }
         }
     }
@@ -1180,6 +1742,9 @@ IOTHUB_CLIENT_RESULT IoTHubClient_GetSendStatus(IOTHUB_CLIENT_HANDLE iotHubClien
         }
         else
         {
+            /*Codes_SRS_IOTHUBCLIENT_11_024: [ IoTHubClient_GetSendStatus shall hand the events still in the submission queue to IoTHubClient_LL first, so that they are reported as pending. ]*/
+            (void)send_pending_events(iotHubClientInstance);
+
             /* Codes_SRS_IOTHUBCLIENT_01_022: [IoTHubClient_GetSendStatus shall call IoTHubClient_LL_GetSendStatus, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameter iotHubClientStatus.] */
             /* Codes_SRS_IOTHUBCLIENT_01_024: [Otherwise, IoTHubClient_GetSendStatus shall return the result of IoTHubClient_LL_GetSendStatus.] */
             result = IoTHubClient_LL_GetSendStatus(iotHubClientInstance->IoTHubClientLLHandle, iotHubClientStatus);
@@ -1192,6 +1757,39 @@ IOTHUB_CLIENT_RESULT IoTHubClient_GetSendStatus(IOTHUB_CLIENT_HANDLE iotHubClien
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_GetSendQueueStatus(IOTHUB_CLIENT_HANDLE iotHubClientHandle, size_t* messageCount, size_t* byteCount)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL || messageCount == NULL || byteCount == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_11_033: [ If iotHubClientHandle, messageCount or byteCount is NULL, IoTHubClient_GetSendQueueStatus shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("invalid arg iotHubClientHandle [%p], messageCount [%p], byteCount [%p]", iotHubClientHandle, messageCount, byteCount);
+    }
+    else
+    {
+        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_11_034: [ If acquiring the lock fails, IoTHubClient_GetSendQueueStatus shall return IOTHUB_CLIENT_ERROR. ]*/
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_11_035: [ IoTHubClient_GetSendQueueStatus shall hand the events still in the submission queue to IoTHubClient_LL and return the result of IoTHubClient_LL_GetSendQueueStatus. ]*/
+            (void)send_pending_events(iotHubClientInstance);
+            result = IoTHubClient_LL_GetSendQueueStatus(iotHubClientInstance->IoTHubClientLLHandle, messageCount, byteCount);
+
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_SetMessageCallback(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC messageCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1499,11 +2097,70 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SetOption(IOTHUB_CLIENT_HANDLE iotHubClientHan
         }
         else
         {
-            /*Codes_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.] */
-            result = IoTHubClient_LL_SetOption(iotHubClientInstance->IoTHubClientLLHandle, optionName, value);
-            if (result != IOTHUB_CLIENT_OK)
+            if (strcmp(optionName, OPTION_WORKER_MAX_IDLE_WAIT) == 0)
             {
-                LogError("IoTHubClient_LL_SetOption failed");
+                unsigned int maxIdleWaitMs = *(const unsigned int*)value;
+
+                /*Codes_SRS_IOTHUBCLIENT_11_008: [ If optionName is OPTION_WORKER_MAX_IDLE_WAIT and the value is 0 or greater than 1000, IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+                if (maxIdleWaitMs < WORKER_THREAD_MIN_IDLE_WAIT_MS || maxIdleWaitMs > WORKER_THREAD_MAX_IDLE_WAIT_LIMIT_MS)
+                {
+                    LogError("invalid %s value %u", OPTION_WORKER_MAX_IDLE_WAIT, maxIdleWaitMs);
+                    result = IOTHUB_CLIENT_INVALID_ARG;
+                }
+                /*Codes_SRS_IOTHUBCLIENT_11_009: [ If the transport connection is shared, IoTHubClient_SetOption shall pass OPTION_WORKER_MAX_IDLE_WAIT to IoTHubTransport_SetWorkerMaxIdleWait and return its result. ]*/
+                else if (iotHubClientInstance->TransportHandle != NULL)
+                {
+                    result = IoTHubTransport_SetWorkerMaxIdleWait(iotHubClientInstance->TransportHandle, maxIdleWaitMs);
+                }
+                else
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_11_010: [ Otherwise IoTHubClient_SetOption shall store the maximum idle wait of the worker thread and return IOTHUB_CLIENT_OK. ]*/
+                    iotHubClientInstance->MaxIdleWaitMs = maxIdleWaitMs;
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+            else if (strcmp(optionName, OPTION_QUEUE_BLOCK_TIMEOUT) == 0)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_11_036: [ If optionName is OPTION_QUEUE_BLOCK_TIMEOUT, IoTHubClient_SetOption shall store the longest time, in milliseconds, IoTHubClient_SendEventAsync waits for room in the send queue and return IOTHUB_CLIENT_OK. ]*/
+                iotHubClientInstance->QueueBlockTimeoutMs = *(const unsigned int*)value;
+                result = IOTHUB_CLIENT_OK;
+            }
+            /*Codes_SRS_IOTHUBCLIENT_11_037: [ Before passing OPTION_QUEUE_OVERFLOW_POLICY set to IOTHUB_CLIENT_QUEUE_OVERFLOW_BLOCK to IoTHubClient_LL, IoTHubClient_SetOption shall create the condition and the tickcounter used to wait for room, and return IOTHUB_CLIENT_ERROR if that fails. ]*/
+            else if ((strcmp(optionName, OPTION_QUEUE_OVERFLOW_POLICY) == 0) &&
+                (*(const IOTHUB_CLIENT_QUEUE_OVERFLOW_POLICY*)value == IOTHUB_CLIENT_QUEUE_OVERFLOW_BLOCK) &&
+                (((iotHubClientInstance->QueueSpaceCondition == NULL) && ((iotHubClientInstance->QueueSpaceCondition = Condition_Init()) == NULL)) ||
+                 ((iotHubClientInstance->QueueTickCounter == NULL) && ((iotHubClientInstance->QueueTickCounter = tickcounter_create()) == NULL))))
+            {
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("unable to create the resources to wait for room in the send queue");
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.] */
+                result = IoTHubClient_LL_SetOption(iotHubClientInstance->IoTHubClientLLHandle, optionName, value);
+                if (result != IOTHUB_CLIENT_OK)
+                {
+                    LogError("IoTHubClient_LL_SetOption failed");
+                }
+                /*Codes_SRS_IOTHUBCLIENT_11_038: [ Once IoTHubClient_LL accepted OPTION_MAX_QUEUED_MESSAGES, OPTION_MAX_QUEUED_BYTES or OPTION_QUEUE_OVERFLOW_POLICY, IoTHubClient_SetOption shall keep their values to decide how IoTHubClient_SendEventAsync hands the events over. ]*/
+                else if (strcmp(optionName, OPTION_MAX_QUEUED_MESSAGES) == 0)
+                {
+                    iotHubClientInstance->MaxQueuedMessages = *(const size_t*)value;
+                }
+                else if (strcmp(optionName, OPTION_MAX_QUEUED_BYTES) == 0)
+                {
+                    iotHubClientInstance->MaxQueuedBytes = *(const size_t*)value;
+                }
+                else if (strcmp(optionName, OPTION_QUEUE_OVERFLOW_POLICY) == 0)
+                {
+                    iotHubClientInstance->QueueOverflowPolicy = *(const IOTHUB_CLIENT_QUEUE_OVERFLOW_POLICY*)value;
+                }
+                else
+                {
+                    /*not an option of the send queue*/
+                }
+
+                iotHubClientInstance->SendQueueBounded = (iotHubClientInstance->MaxQueuedMessages != 0) || (iotHubClientInstance->MaxQueuedBytes != 0);
             }
 
             (void)Unlock(iotHubClientInstance->LockHandle);
@@ -1512,6 +2169,48 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SetOption(IOTHUB_CLIENT_HANDLE iotHubClientHan
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_SetWorkerPool(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_POOL_HANDLE poolHandle)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL || poolHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_11_011: [ If iotHubClientHandle or poolHandle is NULL, IoTHubClient_SetWorkerPool shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("invalid arg iotHubClientHandle [%p], poolHandle [%p]", iotHubClientHandle, poolHandle);
+    }
+    else
+    {
+        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_11_012: [ If the transport connection is shared, a worker thread was already started or a worker pool was already set, IoTHubClient_SetWorkerPool shall return IOTHUB_CLIENT_ERROR. ]*/
+            if (iotHubClientInstance->TransportHandle != NULL ||
+                iotHubClientInstance->ThreadHandle != NULL ||
+                iotHubClientInstance->PoolHandle != NULL)
+            {
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("the worker pool must be set once, before the client starts working, on a client that does not share its transport");
+            }
+            else
+            {
+                iotHubClientInstance->PoolHandle = poolHandle;
+                result = IOTHUB_CLIENT_OK;
+            }
+
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_SetDeviceTwinCallback(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK deviceTwinCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1657,6 +2356,12 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendReportedState(IOTHUB_CLIENT_HANDLE iotHubC
                     }
                 }
 
+                /*Codes_SRS_IOTHUBCLIENT_11_006: [ If the reported state was queued successfully, IoTHubClient_SendReportedState shall wake the worker thread. ]*/
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    wake_worker_thread(iotHubClientInstance);
+                }
+
                 (void)Unlock(iotHubClientInstance->LockHandle);
             }
         }
@@ -1858,6 +2563,11 @@ IOTHUB_CLIENT_RESULT IoTHubClient_DeviceMethodResponse(IOTHUB_CLIENT_HANDLE iotH
             {
                 LogError("IoTHubClient_LL_DeviceMethodResponse failed");
             }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_11_007: [ If IoTHubClient_LL_DeviceMethodResponse succeeds, IoTHubClient_DeviceMethodResponse shall wake the worker thread. ]*/
+                wake_worker_thread(iotHubClientInstance);
+            }
             (void)Unlock(iotHubClientInstance->LockHandle);
         }
     }
@@ -19,6 +19,7 @@
 #include "iothub_client_options.h"
 #include "iothub_client_version.h"
 #include "iothub_client_diagnostic.h"
+#include "deadline_heap.h"
 #include <stdint.h>
 
 #ifdef USE_PROV_MODULE
@@ -29,6 +30,10 @@
 #include "iothub_client_ll_uploadtoblob.h"
 #endif
 
+#ifndef DONT_USE_MESSAGE_STORE
+#include "message_store.h"
+#endif
+
 #define LOG_ERROR_RESULT LogError("result = %s", ENUM_TO_STRING(IOTHUB_CLIENT_RESULT, result));
 #define INDEFINITE_TIME ((time_t)(-1))
 
@@ -59,6 +64,17 @@ typedef struct IOTHUB_MESSAGE_CALLBACK_DATA_TAG
     void* userContextCallback;
 }IOTHUB_MESSAGE_CALLBACK_DATA;
 
+#ifndef DONT_USE_MESSAGE_STORE
+/*confirmation callback of an event appended to the message store, kept until the event is read back*/
+typedef struct STORED_EVENT_TAG
+{
+    uint64_t recordId;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;
+    void* context;
+    DLIST_ENTRY entry;
+}STORED_EVENT;
+#endif
+
 typedef struct IOTHUB_CLIENT_LL_HANDLE_DATA_TAG
 {
     DLIST_ENTRY waitingToSend;
@@ -75,6 +91,13 @@ typedef struct IOTHUB_CLIENT_LL_HANDLE_DATA_TAG
     time_t lastMessageReceiveTime;
     TICK_COUNTER_HANDLE tickCounter; /*shared tickcounter used to track message timeouts in waitingToSend list*/
     tickcounter_ms_t currentMessageTimeout;
+    DEADLINE_HEAP_HANDLE messageTimeouts; /*deadlines of the messages sent with a timeout, created the first time "messageTimeout" is set*/
+    size_t maxQueuedMessages; /*0 means no limit*/
+    size_t maxQueuedBytes; /*0 means no limit*/
+    IOTHUB_CLIENT_QUEUE_OVERFLOW_POLICY queueOverflowPolicy;
+    size_t queuedMessageCount; /*messages accepted and not yet confirmed, whether they are still in waitingToSend or taken by the transport*/
+    size_t queuedByteCount;
+    uint64_t nextQueueSequenceNumber;
     uint64_t current_device_twin_timeout;
     IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK deviceTwinCallback;
     void* deviceTwinContextCallback;
@@ -82,6 +105,12 @@ typedef struct IOTHUB_CLIENT_LL_HANDLE_DATA_TAG
     size_t retryTimeoutLimitInSeconds;
 #ifndef DONT_USE_UPLOADTOBLOB
     IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE uploadToBlobHandle;
+#endif
+#ifndef DONT_USE_MESSAGE_STORE
+    MESSAGE_STORE_HANDLE messageStore; /*NULL until "message_store_path" is set*/
+    size_t messageStoreSegmentSize;
+    DLIST_ENTRY storedEvents; /*STORED_EVENT of the events appended with a callback and not yet read back, in the order of the store*/
+    IOTHUB_MESSAGE_LIST* storeReadAhead; /*event read back from the store that did not fit in waitingToSend yet*/
 #endif
     uint32_t data_msg_id;
     bool complete_twin_update_encountered;
@@ -427,6 +456,20 @@ static IOTHUB_CLIENT_LL_HANDLE_DATA* initialize_iothub_client(const IOTHUB_CLIEN
                             result->currentMessageTimeout = 0;
                             result->current_device_twin_timeout = 0;
 
+                            /*Codes_SRS_IOTHUBCLIENT_LL_11_013: [ By default, the send queue shall have no limit and the overflow policy shall be IOTHUB_CLIENT_QUEUE_OVERFLOW_REJECT. ]*/
+                            result->maxQueuedMessages = 0;
+                            result->maxQueuedBytes = 0;
+                            result->queueOverflowPolicy = IOTHUB_CLIENT_QUEUE_OVERFLOW_REJECT;
+                            result->queuedMessageCount = 0;
+                            result->queuedByteCount = 0;
+                            result->nextQueueSequenceNumber = 0;
+#ifndef DONT_USE_MESSAGE_STORE
+                            /*Codes_SRS_IOTHUBCLIENT_LL_11_025: [ By default, IoTHubClient_LL shall not use a message store and its segments shall be MESSAGE_STORE_DEFAULT_SEGMENT_SIZE bytes. ]*/
+                            result->messageStore = NULL;
+                            result->messageStoreSegmentSize = MESSAGE_STORE_DEFAULT_SEGMENT_SIZE;
+                            result->storeReadAhead = NULL;
+#endif
+
                             result->diagnostic_setting.currentMessageNumber = 0;
                             result->diagnostic_setting.diagSamplingPercentage = 0;
                             /*Codes_SRS_IOTHUBCLIENT_LL_25_124: [ `IoTHubClient_LL_Create` shall set the default retry policy as Exponential backoff with jitter and if succeed and return a `non-NULL` handle. ]*/
@@ -943,6 +986,35 @@ IOTHUB_CLIENT_LL_HANDLE IoTHubClient_LL_CreateWithTransport(const IOTHUB_CLIENT_
     return result;
 }
 
+#ifndef DONT_USE_MESSAGE_STORE
+static void close_message_store(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    PDLIST_ENTRY stored;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_11_036: [ IoTHubClient_LL_Destroy shall complete with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY the events still in the message store, call message_store_close and leave the events on disk. ]*/
+    if (handleData->storeReadAhead != NULL)
+    {
+        if (handleData->storeReadAhead->callback != NULL)
+        {
+            handleData->storeReadAhead->callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, handleData->storeReadAhead->context);
+        }
+        IoTHubMessage_Destroy(handleData->storeReadAhead->messageHandle);
+        free(handleData->storeReadAhead);
+        handleData->storeReadAhead = NULL;
+    }
+
+    while ((stored = DList_RemoveHeadList(&(handleData->storedEvents))) != &(handleData->storedEvents))
+    {
+        STORED_EVENT* storedEvent = containingRecord(stored, STORED_EVENT, entry);
+        storedEvent->callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, storedEvent->context);
+        free(storedEvent);
+    }
+
+    message_store_close(handleData->messageStore);
+    handleData->messageStore = NULL;
+}
+#endif
+
 void IoTHubClient_LL_Destroy(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
 {
     /*Codes_SRS_IOTHUBCLIENT_LL_02_009: [IoTHubClient_LL_Destroy shall do nothing if parameter iotHubClientHandle is NULL.]*/
@@ -970,6 +1042,13 @@ void IoTHubClient_LL_Destroy(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
             free(temp);
         }
 
+#ifndef DONT_USE_MESSAGE_STORE
+        if (handleData->messageStore != NULL)
+        {
+            close_message_store(handleData);
+        }
+#endif
+
         /* Codes_SRS_IOTHUBCLIENT_LL_07_007: [ IoTHubClient_LL_Destroy shall iterate the device twin queues and destroy any remaining items. ] */
         while ((unsend = DList_RemoveHeadList(&(handleData->iot_msg_queue))) != &(handleData->iot_msg_queue))
         {
@@ -985,6 +1064,10 @@ void IoTHubClient_LL_Destroy(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
         /*Codes_SRS_IOTHUBCLIENT_LL_17_011: [IoTHubClient_LL_Destroy  shall free the resources allocated by IoTHubClient (if any).] */
         IoTHubClient_Auth_Destroy(handleData->authorization_module);
         tickcounter_destroy(handleData->tickCounter);
+        if (handleData->messageTimeouts != NULL)
+        {
+            deadline_heap_destroy(handleData->messageTimeouts);
+        }
 #ifndef DONT_USE_UPLOADTOBLOB
         IoTHubClient_LL_UploadToBlob_Destroy(handleData->uploadToBlobHandle);
 #endif
@@ -1021,6 +1104,341 @@ static int attach_ms_timesOutAfter(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOT
     return result;
 }
 
+static int get_message_size(IOTHUB_MESSAGE_HANDLE messageHandle, size_t* size)
+{
+    int result;
+    IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(messageHandle);
+
+    if (contentType == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        const unsigned char* buffer;
+        if (IoTHubMessage_GetByteArray(messageHandle, &buffer, size) != IOTHUB_MESSAGE_OK)
+        {
+            result = __FAILURE__;
+            LogError("unable to get the payload of the message");
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    else if (contentType == IOTHUBMESSAGE_STRING)
+    {
+        const char* text = IoTHubMessage_GetString(messageHandle);
+        if (text == NULL)
+        {
+            result = __FAILURE__;
+            LogError("unable to get the payload of the message");
+        }
+        else
+        {
+            *size = strlen(text);
+            result = 0;
+        }
+    }
+    else
+    {
+        result = __FAILURE__;
+        LogError("unknown content type of the message");
+    }
+
+    return result;
+}
+
+static bool send_queue_has_room(const IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, size_t messageSize)
+{
+    /*the counts can be above the limits when the limits were lowered after the messages were queued*/
+    return
+        ((handleData->maxQueuedMessages == 0) || (handleData->queuedMessageCount < handleData->maxQueuedMessages)) &&
+        ((handleData->maxQueuedBytes == 0) || ((handleData->queuedByteCount <= handleData->maxQueuedBytes) && (messageSize <= handleData->maxQueuedBytes - handleData->queuedByteCount)));
+}
+
+static IOTHUB_CLIENT_RESULT reserve_send_queue_room(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, size_t messageSize)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if ((handleData->maxQueuedBytes != 0) && (messageSize > handleData->maxQueuedBytes))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_11_016: [ A message whose payload alone is bigger than "max_queued_bytes" shall be rejected with IOTHUB_CLIENT_INVALID_SIZE, whatever the overflow policy. ]*/
+        result = IOTHUB_CLIENT_INVALID_SIZE;
+        LogError("message of %lu bytes can never fit in a send queue of %lu bytes", (unsigned long)messageSize, (unsigned long)handleData->maxQueuedBytes);
+    }
+    else
+    {
+        if (handleData->queueOverflowPolicy == IOTHUB_CLIENT_QUEUE_OVERFLOW_DROP_OLDEST)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_11_017: [ With IOTHUB_CLIENT_QUEUE_OVERFLOW_DROP_OLDEST, the oldest messages of waitingToSend shall be removed, completed with IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT and destroyed until the new message fits. ]*/
+            /*messages already taken by the transport cannot be recalled, they only make room once they are confirmed*/
+            while (!send_queue_has_room(handleData, messageSize) && !DList_IsListEmpty(&(handleData->waitingToSend)))
+            {
+                IOTHUB_MESSAGE_LIST* oldest = containingRecord(DList_RemoveHeadList(&(handleData->waitingToSend)), IOTHUB_MESSAGE_LIST, entry);
+                oldest->callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, oldest->context);
+                IoTHubMessage_Destroy(oldest->messageHandle);
+                free(oldest);
+            }
+        }
+
+        if (!send_queue_has_room(handleData, messageSize))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_11_018: [ If the message still does not fit within "max_queued_messages" and "max_queued_bytes", the send shall fail with IOTHUB_CLIENT_QUEUE_FULL and no message shall be added to waitingToSend. ]*/
+            result = IOTHUB_CLIENT_QUEUE_FULL;
+            LogError("send queue full, %lu messages and %lu bytes queued", (unsigned long)handleData->queuedMessageCount, (unsigned long)handleData->queuedByteCount);
+        }
+        else
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+
+    return result;
+}
+
+/*every queued message is confirmed through here, by the transport, a timeout, IoTHubClient_LL_Destroy or the overflow policy*/
+static void on_queued_event_confirmed(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* context)
+{
+    IOTHUB_MESSAGE_LIST* queuedEntry = (IOTHUB_MESSAGE_LIST*)context;
+    IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)queuedEntry->owner;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_11_019: [ Once a queued message is confirmed, for any reason, it shall stop counting against the limits of the send queue before its event confirmation callback is called. ]*/
+    handleData->queuedMessageCount--;
+    handleData->queuedByteCount -= queuedEntry->queuedBytes;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_11_012: [ Once a queued message is confirmed, for any reason, its deadline shall be removed from the index by calling deadline_heap_remove. ]*/
+    if (queuedEntry->deadlineEntry != NULL)
+    {
+        deadline_heap_remove(handleData->messageTimeouts, queuedEntry->deadlineEntry);
+        queuedEntry->deadlineEntry = NULL;
+    }
+
+#ifndef DONT_USE_MESSAGE_STORE
+    /*Codes_SRS_IOTHUBCLIENT_LL_11_034: [ Once an event read back from the message store is confirmed, it shall be completed with message_store_complete, unless the result is IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY: the event is then sent again the next time the store is opened. ]*/
+    if (queuedEntry->isStored && (result != IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY))
+    {
+        (void)message_store_complete(handleData->messageStore, queuedEntry->storeRecordId);
+    }
+#endif
+
+    if (queuedEntry->userCallback != NULL)
+    {
+        queuedEntry->userCallback(result, queuedEntry->userContext);
+    }
+}
+
+/*adds to waitingToSend an event that fits in the send queue*/
+static IOTHUB_CLIENT_RESULT enqueue_event_entry(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* newEntry, size_t messageSize)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    newEntry->deadlineEntry = NULL;
+    if (IoTHubClient_Diagnostic_AddIfNecessary(&handleData->diagnostic_setting, newEntry->messageHandle) != 0)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_11_007: [ A message that has a timeout shall be indexed by its deadline before being added to waitingToSend. ]*/
+    /*the entry stays valid as long as it is in the index: the message is removed from it when it is confirmed, before it is freed*/
+    /*the message times out once the time is past ms_timesOutAfter, which is when the heap reports ms_timesOutAfter + 1 as expired*/
+    else if ((newEntry->ms_timesOutAfter != 0) && ((newEntry->deadlineEntry = deadline_heap_add(handleData->messageTimeouts, newEntry->ms_timesOutAfter + 1, newEntry)) == NULL))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_11_008: [ If indexing the message fails, the message shall not be added to waitingToSend and the send shall fail with IOTHUB_CLIENT_ERROR. ]*/
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_11_020: [ The confirmation callback and context of an accepted message shall be kept aside and replaced by the ones of IoTHubClient_LL, so the message is accounted for whoever completes it; a message that is not accepted is left unchanged. ]*/
+        newEntry->userCallback = newEntry->callback;
+        newEntry->userContext = newEntry->context;
+        newEntry->queuedBytes = messageSize;
+        newEntry->owner = handleData;
+        newEntry->callback = on_queued_event_confirmed;
+        newEntry->context = newEntry;
+        newEntry->queueSequenceNumber = handleData->nextQueueSequenceNumber++;
+        handleData->queuedMessageCount++;
+        handleData->queuedByteCount += messageSize;
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClient_LL_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
+        DList_InsertTailList(&(handleData->waitingToSend), &(newEntry->entry));
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT add_event_entry(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* newEntry)
+{
+    IOTHUB_CLIENT_RESULT result;
+    size_t messageSize = 0;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_11_015: [ The size of a message in the send queue shall be the size of its payload, obtained with IoTHubMessage_GetByteArray or IoTHubMessage_GetString depending on IoTHubMessage_GetContentType. ]*/
+    if (get_message_size(newEntry->messageHandle, &messageSize) != 0)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else if ((result = reserve_send_queue_room(handleData, messageSize)) != IOTHUB_CLIENT_OK)
+    {
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+#ifndef DONT_USE_MESSAGE_STORE
+        newEntry->isStored = false;
+#endif
+        result = enqueue_event_entry(handleData, newEntry, messageSize);
+    }
+
+    return result;
+}
+
+#ifndef DONT_USE_MESSAGE_STORE
+static IOTHUB_CLIENT_RESULT store_event(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE messageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback, void* context)
+{
+    IOTHUB_CLIENT_RESULT result;
+    STORED_EVENT* storedEvent = NULL;
+    uint64_t recordId;
+
+    /*events without a callback are not tracked, they are read back like the events of a previous run*/
+    if ((callback != NULL) && ((storedEvent = (STORED_EVENT*)malloc(sizeof(STORED_EVENT))) == NULL))
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_11_029: [ With a message store, the event shall be appended to it with message_store_append, without cloning its message, and its callback shall be kept until it is read back. ]*/
+    else if (message_store_append(handleData->messageStore, messageHandle, &recordId) != 0)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_11_030: [ If appending the event fails, the send shall fail with IOTHUB_CLIENT_ERROR. ]*/
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+        free(storedEvent);
+    }
+    else
+    {
+        if (storedEvent != NULL)
+        {
+            storedEvent->recordId = recordId;
+            storedEvent->callback = callback;
+            storedEvent->context = context;
+            DList_InsertTailList(&(handleData->storedEvents), &(storedEvent->entry));
+        }
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
+/*gives the callback of the event the record recordId was appended for, events whose record was skipped by the store fail*/
+static void take_stored_event_callback(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, uint64_t recordId, IOTHUB_MESSAGE_LIST* storedEntry)
+{
+    PDLIST_ENTRY head;
+
+    storedEntry->callback = NULL;
+    storedEntry->context = NULL;
+
+    while (((head = handleData->storedEvents.Flink) != &(handleData->storedEvents)) && (containingRecord(head, STORED_EVENT, entry)->recordId <= recordId))
+    {
+        STORED_EVENT* storedEvent = containingRecord(head, STORED_EVENT, entry);
+        DList_RemoveEntryList(head);
+        if (storedEvent->recordId == recordId)
+        {
+            storedEntry->callback = storedEvent->callback;
+            storedEntry->context = storedEvent->context;
+        }
+        else
+        {
+            storedEvent->callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, storedEvent->context);
+        }
+        free(storedEvent);
+    }
+}
+
+static IOTHUB_MESSAGE_LIST* read_stored_event(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    IOTHUB_MESSAGE_LIST* result;
+    IOTHUB_MESSAGE_HANDLE messageHandle;
+    uint64_t recordId;
+
+    if ((messageHandle = message_store_read(handleData->messageStore, &recordId)) == NULL)
+    {
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST))) == NULL)
+    {
+        IOTHUB_MESSAGE_LIST failedEntry;
+        LogError("unable to allocate the entry of a stored event");
+        /*the record is not completed, the event is sent again the next time the store is opened*/
+        take_stored_event_callback(handleData, recordId, &failedEntry);
+        if (failedEntry.callback != NULL)
+        {
+            failedEntry.callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, failedEntry.context);
+        }
+        IoTHubMessage_Destroy(messageHandle);
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_11_032: [ An event read back shall get the callback it was sent with in this run, or no callback if it was sent by a previous run. ]*/
+        take_stored_event_callback(handleData, recordId, result);
+        result->messageHandle = messageHandle;
+        result->isStored = true;
+        result->storeRecordId = recordId;
+    }
+
+    return result;
+}
+
+static void fail_stored_event(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* storedEntry)
+{
+    if (storedEntry->callback != NULL)
+    {
+        storedEntry->callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, storedEntry->context);
+    }
+    (void)message_store_complete(handleData->messageStore, storedEntry->storeRecordId);
+    IoTHubMessage_Destroy(storedEntry->messageHandle);
+    free(storedEntry);
+}
+
+static void refill_from_message_store(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    bool hasRoom = true;
+
+    while (hasRoom)
+    {
+        IOTHUB_MESSAGE_LIST* storedEntry;
+        size_t messageSize = 0;
+
+        if (handleData->storeReadAhead != NULL)
+        {
+            storedEntry = handleData->storeReadAhead;
+            handleData->storeReadAhead = NULL;
+        }
+        else
+        {
+            storedEntry = read_stored_event(handleData);
+        }
+
+        if (storedEntry == NULL)
+        {
+            hasRoom = false;
+        }
+        else if (get_message_size(storedEntry->messageHandle, &messageSize) != 0)
+        {
+            fail_stored_event(handleData, storedEntry);
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_11_031: [ IoTHubClient_LL_DoWork shall read events back from the message store into waitingToSend while they fit within "max_queued_messages" and "max_queued_bytes", and always when no event is queued. ]*/
+        else if ((handleData->queuedMessageCount != 0) && !send_queue_has_room(handleData, messageSize))
+        {
+            handleData->storeReadAhead = storedEntry;
+            hasRoom = false;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_11_033: [ The timeout of an event read back from the message store shall start when it is added to waitingToSend; if adding it fails, its callback shall be called with IOTHUB_CLIENT_CONFIRMATION_ERROR and it shall be completed. ]*/
+        else if ((attach_ms_timesOutAfter(handleData, storedEntry) != 0) || (enqueue_event_entry(handleData, storedEntry, messageSize) != IOTHUB_CLIENT_OK))
+        {
+            fail_stored_event(handleData, storedEntry);
+        }
+    }
+}
+#endif
+
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1035,6 +1453,12 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotH
         result = IOTHUB_CLIENT_INVALID_ARG;
         LOG_ERROR_RESULT;
     }
+#ifndef DONT_USE_MESSAGE_STORE
+    else if (((IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle)->messageStore != NULL)
+    {
+        result = store_event((IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+    }
+#endif
     else
     {
         IOTHUB_MESSAGE_LIST *newEntry = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST));
@@ -1062,22 +1486,18 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotH
                     free(newEntry);
                     LOG_ERROR_RESULT;
                 }
-                else if (IoTHubClient_Diagnostic_AddIfNecessary(&handleData->diagnostic_setting, newEntry->messageHandle) != 0)
-                {
-                    /*Codes_SRS_IOTHUBCLIENT_LL_02_014: [If cloning and/or adding the information/diagnostic fails for any reason, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR.] */
-                    result = IOTHUB_CLIENT_ERROR;
-                    IoTHubMessage_Destroy(newEntry->messageHandle);
-                    free(newEntry);
-                    LOG_ERROR_RESULT;
-                }
                 else
                 {
-                    /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClient_LL_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
                     newEntry->callback = eventConfirmationCallback;
                     newEntry->context = userContextCallback;
-                    DList_InsertTailList(&(iotHubClientHandle->waitingToSend), &(newEntry->entry));
+                    if ((result = add_event_entry(handleData, newEntry)) != IOTHUB_CLIENT_OK)
+                    {
+                        /*Codes_SRS_IOTHUBCLIENT_LL_02_014: [If cloning and/or adding the information/diagnostic fails for any reason, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR.] */
+                        /*Codes_SRS_IOTHUBCLIENT_LL_11_018: [ If the message still does not fit within "max_queued_messages" and "max_queued_bytes", the send shall fail with IOTHUB_CLIENT_QUEUE_FULL and no message shall be added to waitingToSend. ]*/
+                        IoTHubMessage_Destroy(newEntry->messageHandle);
+                        free(newEntry);
+                    }
                     /*Codes_SRS_IOTHUBCLIENT_LL_02_015: [Otherwise IoTHubClient_LL_SendEventAsync shall succeed and return IOTHUB_CLIENT_OK.] */
-                    result = IOTHUB_CLIENT_OK;
                 }
             }
         }
@@ -1085,6 +1505,47 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotH
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventEntry(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_LIST* newEntry)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL || newEntry == NULL || newEntry->messageHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_11_001: [ If iotHubClientHandle, newEntry or the message of newEntry is NULL, IoTHubClient_LL_SendEventEntry shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+#ifndef DONT_USE_MESSAGE_STORE
+    else if (((IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle)->messageStore != NULL)
+    {
+        if ((result = store_event((IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle, newEntry->messageHandle, newEntry->callback, newEntry->context)) == IOTHUB_CLIENT_OK)
+        {
+            /*the store keeps its own copy of the message*/
+            IoTHubMessage_Destroy(newEntry->messageHandle);
+            free(newEntry);
+        }
+    }
+#endif
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_11_002: [ IoTHubClient_LL_SendEventEntry shall compute the timeout of the message the same way IoTHubClient_LL_SendEventAsync does. ]*/
+        if (attach_ms_timesOutAfter(handleData, newEntry) != 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_11_004: [ If IoTHubClient_LL_SendEventEntry fails, the caller keeps the ownership of newEntry. ]*/
+            result = IOTHUB_CLIENT_ERROR;
+            LOG_ERROR_RESULT;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_11_003: [ IoTHubClient_LL_SendEventEntry shall add newEntry, without cloning its message, to the DLIST waitingToSend and take ownership of it. ]*/
+            result = add_event_entry(handleData, newEntry);
+        }
+    }
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetMessageCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC messageCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1245,35 +1706,63 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendMessageDisposition(IOTHUB_CLIENT_LL_HAN
     return result;
 }
 
-static void DoTimeouts(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+/*waitingToSend stays ordered by queueSequenceNumber: messages are only added at its tail, and the transports only take them out or put them back where they were*/
+/*so only the messages older than the one looked for are walked over, which are few since older messages usually time out first*/
+static bool is_waiting_to_send(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* message)
 {
-    tickcounter_ms_t nowTick;
-    if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+    PDLIST_ENTRY current = handleData->waitingToSend.Flink;
+    while ((current != &(handleData->waitingToSend)) && (containingRecord(current, IOTHUB_MESSAGE_LIST, entry)->queueSequenceNumber < message->queueSequenceNumber))
     {
-        LogError("unable to get the current ms, timeouts will not be processed");
+        current = current->Flink;
     }
-    else
+    return (current == &(message->entry));
+}
+
+static void time_out_message(IOTHUB_MESSAGE_LIST* message)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+    DList_RemoveEntryList(&(message->entry));
+    if (message->callback != NULL)
     {
-        DLIST_ENTRY* currentItemInWaitingToSend = handleData->waitingToSend.Flink;
-        while (currentItemInWaitingToSend != &(handleData->waitingToSend)) /*while we are not at the end of the list*/
+        message->callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, message->context);
+    }
+    IoTHubMessage_Destroy(message->messageHandle); /*because it has been cloned*/
+    free(message);
+}
+
+static void DoTimeouts(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_11_009: [ If "messageTimeout" was never set to a non-zero value, IoTHubClient_LL_DoWork shall not process timeouts. ]*/
+    if (handleData->messageTimeouts != NULL)
+    {
+        tickcounter_ms_t nowTick;
+        if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+        {
+            LogError("unable to get the current ms, timeouts will not be processed");
+        }
+        else
         {
-            IOTHUB_MESSAGE_LIST* fullEntry = containingRecord(currentItemInWaitingToSend, IOTHUB_MESSAGE_LIST, entry);
-            /*Codes_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
-            if ((fullEntry->ms_timesOutAfter != 0) && (fullEntry->ms_timesOutAfter < nowTick))
+            IOTHUB_MESSAGE_LIST* expired;
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_11_010: [ IoTHubClient_LL_DoWork shall take the expired deadlines out of the index by calling deadline_heap_pop_expired until it returns NULL. ]*/
+            while ((expired = (IOTHUB_MESSAGE_LIST*)deadline_heap_pop_expired(handleData->messageTimeouts, nowTick)) != NULL)
             {
-                PDLIST_ENTRY theNext = currentItemInWaitingToSend->Flink; /*need to save the next item, because the below operations are destructive*/
-                DList_RemoveEntryList(currentItemInWaitingToSend);
-                if (fullEntry->callback != NULL)
+                expired->deadlineEntry = NULL; /*released by deadline_heap_pop_expired*/
+
+                /*Codes_SRS_IOTHUBCLIENT_LL_11_011: [ A message whose deadline expired shall be timed out if it is still in waitingToSend; a message taken by the transport is left to it, out of the index. ]*/
+                if (is_waiting_to_send(handleData, expired))
                 {
-                    fullEntry->callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, fullEntry->context);
+                    time_out_message(expired);
                 }
-                IoTHubMessage_Destroy(fullEntry->messageHandle); /*because it has been cloned*/
-                free(fullEntry);
-                currentItemInWaitingToSend = theNext;
             }
-            else
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_11_041: [ A message at the head of waitingToSend that has a timeout but is out of the index was put back by the transport after its deadline expired, and shall be timed out. ]*/
+            /*the transports put the messages they take back at the head of waitingToSend, so nothing else is walked and this costs nothing while none is put back*/
+            while ((handleData->waitingToSend.Flink != &(handleData->waitingToSend)) &&
+                ((expired = containingRecord(handleData->waitingToSend.Flink, IOTHUB_MESSAGE_LIST, entry))->ms_timesOutAfter != 0) &&
+                (expired->deadlineEntry == NULL))
             {
-                currentItemInWaitingToSend = currentItemInWaitingToSend->Flink;
+                time_out_message(expired);
             }
         }
     }
@@ -1287,6 +1776,13 @@ void IoTHubClient_LL_DoWork(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
         IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
         DoTimeouts(handleData);
 
+#ifndef DONT_USE_MESSAGE_STORE
+        if (handleData->messageStore != NULL)
+        {
+            refill_from_message_store(handleData);
+        }
+#endif
+
         /*Codes_SRS_IOTHUBCLIENT_LL_07_008: [ IoTHubClient_LL_DoWork shall iterate the message queue and execute the underlying transports IoTHubTransport_ProcessItem function for each item. ] */
         DLIST_ENTRY* client_item = handleData->iot_msg_queue.Flink;
         while (client_item != &(handleData->iot_msg_queue)) /*while we are not at the end of the list*/
@@ -1323,7 +1819,50 @@ void IoTHubClient_LL_DoWork(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
 
         /*Codes_SRS_IOTHUBCLIENT_LL_02_021: [Otherwise, IoTHubClient_LL_DoWork shall invoke the underlaying layer's _DoWork function.]*/
         handleData->IoTHubTransport_DoWork(handleData->transportHandle, iotHubClientHandle);
+
+#ifndef DONT_USE_MESSAGE_STORE
+        /*Codes_SRS_IOTHUBCLIENT_LL_11_035: [ After the underlaying layer's _DoWork, IoTHubClient_LL_DoWork shall call message_store_sync, so the events sent and confirmed since the previous call are made durable together. ]*/
+        if ((handleData->messageStore != NULL) && (message_store_sync(handleData->messageStore) != 0))
+        {
+            LogError("unable to sync the message store");
+        }
+#endif
+    }
+}
+
+bool IoTHubClient_LL_GetTimeToNextDeadline(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, tickcounter_ms_t* timeToDeadlineMs)
+{
+    bool result;
+    IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+    tickcounter_ms_t deadline;
+    tickcounter_ms_t nowTick;
+
+    if (iotHubClientHandle == NULL || timeToDeadlineMs == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_11_037: [ If iotHubClientHandle or timeToDeadlineMs is NULL, IoTHubClient_LL_GetTimeToNextDeadline shall return false. ]*/
+        LogError("Invalid argument, iotHubClientHandle [%p], timeToDeadlineMs [%p]", iotHubClientHandle, timeToDeadlineMs);
+        result = false;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_11_038: [ If no queued message has a deadline, IoTHubClient_LL_GetTimeToNextDeadline shall return false. ]*/
+    else if (!deadline_heap_peek_deadline(handleData->messageTimeouts, &deadline))
+    {
+        result = false;
+    }
+    else if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_11_040: [ If the current time cannot be read, IoTHubClient_LL_GetTimeToNextDeadline shall report the deadline as reached. ]*/
+        LogError("unable to get the current ms");
+        *timeToDeadlineMs = 0;
+        result = true;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_11_039: [ Otherwise IoTHubClient_LL_GetTimeToNextDeadline shall store in timeToDeadlineMs the time left until the earliest deadline is reached, 0 if it already is, and return true. ]*/
+        *timeToDeadlineMs = (deadline > nowTick) ? (deadline - nowTick) : 0;
+        result = true;
     }
+
+    return result;
 }
 
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetSendStatus(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
@@ -1348,6 +1887,29 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetSendStatus(IOTHUB_CLIENT_LL_HANDLE iotHu
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetSendQueueStatus(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, size_t* messageCount, size_t* byteCount)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL || messageCount == NULL || byteCount == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_11_021: [ If iotHubClientHandle, messageCount or byteCount is NULL, IoTHubClient_LL_GetSendQueueStatus shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_11_022: [ IoTHubClient_LL_GetSendQueueStatus shall return in messageCount and byteCount the number and the total size of the messages accepted and not yet confirmed, and return IOTHUB_CLIENT_OK. ]*/
+        *messageCount = handleData->queuedMessageCount;
+        *byteCount = handleData->queuedByteCount;
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
 void IoTHubClient_LL_SendComplete(IOTHUB_CLIENT_LL_HANDLE handle, PDLIST_ENTRY completed, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
 {
     /*Codes_SRS_IOTHUBCLIENT_LL_02_022: [If parameter completed is NULL, or parameter handle is NULL then IoTHubClient_LL_SendBatch shall return.]*/
@@ -1707,10 +2269,88 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetOption(IOTHUB_CLIENT_LL_HANDLE iotHubCli
         if (strcmp(optionName, OPTION_MESSAGE_TIMEOUT) == 0)
         {
             /*this is an option handled by IoTHubClient_LL*/
-            /*Codes_SRS_IOTHUBCLIENT_LL_02_043: [ Calling IoTHubClient_LL_SetOption with value set to "0" shall disable the timeout mechanism for all new messages. ]*/
-            handleData->currentMessageTimeout = *(const tickcounter_ms_t*)value;
+            tickcounter_ms_t messageTimeout = *(const tickcounter_ms_t*)value;
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_11_005: [ The first time "messageTimeout" is set to a non-zero value, IoTHubClient_LL_SetOption shall create the index of message deadlines by calling deadline_heap_create. ]*/
+            if ((messageTimeout != 0) && (handleData->messageTimeouts == NULL) && ((handleData->messageTimeouts = deadline_heap_create()) == NULL))
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_11_006: [ If creating the index fails, IoTHubClient_LL_SetOption shall leave the current timeout unchanged and return IOTHUB_CLIENT_ERROR. ]*/
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("unable to create the message timeout index");
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_02_043: [ Calling IoTHubClient_LL_SetOption with value set to "0" shall disable the timeout mechanism for all new messages. ]*/
+                handleData->currentMessageTimeout = messageTimeout;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_11_014: [ "max_queued_messages" and "max_queued_bytes" shall set the limits, as size_t, of the number and the total size of the messages held until they are confirmed; 0 removes the limit. ]*/
+        else if (strcmp(optionName, OPTION_MAX_QUEUED_MESSAGES) == 0)
+        {
+            handleData->maxQueuedMessages = *(const size_t*)value;
             result = IOTHUB_CLIENT_OK;
         }
+        else if (strcmp(optionName, OPTION_MAX_QUEUED_BYTES) == 0)
+        {
+            handleData->maxQueuedBytes = *(const size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, OPTION_QUEUE_OVERFLOW_POLICY) == 0)
+        {
+            IOTHUB_CLIENT_QUEUE_OVERFLOW_POLICY policy = *(const IOTHUB_CLIENT_QUEUE_OVERFLOW_POLICY*)value;
+            if ((policy != IOTHUB_CLIENT_QUEUE_OVERFLOW_REJECT) &&
+                (policy != IOTHUB_CLIENT_QUEUE_OVERFLOW_DROP_OLDEST) &&
+                (policy != IOTHUB_CLIENT_QUEUE_OVERFLOW_BLOCK))
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_11_023: [ If "queue_overflow_policy" is not a IOTHUB_CLIENT_QUEUE_OVERFLOW_POLICY value, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+                result = IOTHUB_CLIENT_INVALID_ARG;
+                LogError("invalid queue overflow policy %d", (int)policy);
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_11_024: [ IoTHubClient_LL shall reject with IOTHUB_CLIENT_QUEUE_FULL the messages that do not fit when the policy is IOTHUB_CLIENT_QUEUE_OVERFLOW_BLOCK, waiting is left to the caller. ]*/
+                handleData->queueOverflowPolicy = policy;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+#ifndef DONT_USE_MESSAGE_STORE
+        else if (strcmp(optionName, OPTION_MESSAGE_STORE_SEGMENT_SIZE) == 0)
+        {
+            size_t segmentSize = *(const size_t*)value;
+            if (segmentSize == 0)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_11_026: [ If "message_store_segment_size" is 0, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+                result = IOTHUB_CLIENT_INVALID_ARG;
+                LogError("invalid message store segment size 0");
+            }
+            else
+            {
+                handleData->messageStoreSegmentSize = segmentSize;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(optionName, OPTION_MESSAGE_STORE_PATH) == 0)
+        {
+            if (handleData->messageStore != NULL)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_11_027: [ If a message store is already open, setting "message_store_path" shall fail with IOTHUB_CLIENT_ERROR. ]*/
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("the message store is already open");
+            }
+            /*Codes_SRS_IOTHUBCLIENT_LL_11_028: [ "message_store_path" shall open the message store kept in the directory value with message_store_open and "message_store_segment_size"; if it fails, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_ERROR. ]*/
+            else if ((handleData->messageStore = message_store_open((const char*)value, handleData->messageStoreSegmentSize)) == NULL)
+            {
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("unable to open the message store in %s", (const char*)value);
+            }
+            else
+            {
+                DList_InitializeListHead(&(handleData->storedEvents));
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+#endif
         else if (strcmp(optionName, OPTION_PRODUCT_INFO) == 0)
         {
             /*Codes_SRS_IOTHUBCLIENT_LL_10_033: [repeat calls with "product_info" will erase the previously set product information if applicatble. ]*/
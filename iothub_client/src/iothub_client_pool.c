@@ -0,0 +1,760 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <stddef.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "iothub_client_pool.h"
+#include "iothub_client_private.h"
+
+#define IO_THREAD_MIN_IDLE_WAIT_MS      1
+#define IO_THREAD_MAX_IDLE_WAIT_MS      1000
+#define CLIENT_RELEASE_WAIT_MS          100     /*the release condition is signaled, the timeout only matters if Condition_Post failed*/
+#define LOCK_RETRY_WAIT_MS              100     /*only used when the pool lock cannot be taken, there is no condition to wait on then*/
+#define DISPATCH_WAIT_INFINITE          0
+
+struct IOTHUB_CLIENT_POOL_TAG;
+
+typedef struct IO_WORKER_TAG
+{
+    struct IOTHUB_CLIENT_POOL_TAG* pool;
+    THREAD_HANDLE threadHandle;
+    COND_HANDLE workCondition;          /*signaled when one of the clients of this thread queues work*/
+    sig_atomic_t workPending;
+    DLIST_ENTRY runQueue;               /*clients driven by this thread, in the order they are driven*/
+    size_t queuedCount;
+    unsigned int idleWaitMs;
+} IO_WORKER;
+
+typedef struct IOTHUB_CLIENT_POOL_CLIENT_TAG
+{
+    struct IOTHUB_CLIENT_POOL_TAG* pool;
+    void* client;
+    IOTHUB_CLIENT_POOL_DO_WORK doWork;
+    IOTHUB_CLIENT_POOL_DISPATCH dispatch;
+    IO_WORKER* worker;                  /*the thread whose run queue the client goes back to*/
+    DLIST_ENTRY runEntry;
+    DLIST_ENTRY dispatchEntry;
+    bool isQueued;
+    bool isRunning;
+    bool isDispatchQueued;
+    bool isDispatching;
+    bool isDispatchRequested;
+    bool isRemoved;
+    bool isReleaseDeferred;             /*removed from its own doWork or dispatch, the thread running them frees it when they return*/
+} IOTHUB_CLIENT_POOL_CLIENT;
+
+typedef struct IOTHUB_CLIENT_POOL_TAG
+{
+    LOCK_HANDLE lockHandle;             /*protects the run queues, the dispatch queue and the state of every client*/
+    sig_atomic_t stopThreads;
+    IO_WORKER* ioWorkers;
+    size_t ioThreadCount;
+    size_t nextIoWorker;
+    THREAD_HANDLE* callbackThreadHandles;
+    size_t callbackThreadCount;
+    COND_HANDLE dispatchCondition;      /*signaled when a client is added to the dispatch queue*/
+    DLIST_ENTRY dispatchQueue;
+    COND_HANDLE releaseCondition;       /*signaled when a thread stops using a removed client*/
+    size_t releaseWaiters;              /*IoTHubClientPool_RemoveClient calls waiting on releaseCondition*/
+} IOTHUB_CLIENT_POOL;
+
+/* Used for Unit test */
+const size_t IoTHubClientPool_ThreadTerminationOffset = offsetof(IOTHUB_CLIENT_POOL, stopThreads);
+
+#ifdef IOTHUB_THREAD_LOCAL
+/*the client whose doWork (or inline dispatch) the calling I/O thread is running, NULL on any other thread*/
+static IOTHUB_THREAD_LOCAL IOTHUB_CLIENT_POOL_CLIENT* g_io_thread_client = NULL;
+/*the client whose dispatch the calling callback thread is running, NULL on any other thread*/
+static IOTHUB_THREAD_LOCAL IOTHUB_CLIENT_POOL_CLIENT* g_callback_thread_client = NULL;
+#define SET_IO_THREAD_CLIENT(poolClient) (g_io_thread_client = (poolClient))
+#define SET_CALLBACK_THREAD_CLIENT(poolClient) (g_callback_thread_client = (poolClient))
+#define IS_IO_THREAD_CLIENT(poolClient) (g_io_thread_client == (poolClient))
+#define IS_CALLBACK_THREAD_CLIENT(poolClient) (g_callback_thread_client == (poolClient))
+#else
+/*without thread local storage a call from doWork or dispatch of the same client is not recognized, dispatch calls IoTHubClientPool_RemoveClientFromDispatch instead*/
+#define SET_IO_THREAD_CLIENT(poolClient) ((void)(poolClient))
+#define SET_CALLBACK_THREAD_CLIENT(poolClient) ((void)(poolClient))
+#define IS_IO_THREAD_CLIENT(poolClient) false
+#define IS_CALLBACK_THREAD_CLIENT(poolClient) false
+#endif
+
+/*must be called with the pool lock held*/
+static void queue_client(IO_WORKER* worker, IOTHUB_CLIENT_POOL_CLIENT* poolClient)
+{
+    DList_InsertTailList(&worker->runQueue, &poolClient->runEntry);
+    worker->queuedCount++;
+    poolClient->worker = worker;
+    poolClient->isQueued = true;
+}
+
+/*must be called with the pool lock held*/
+static void unqueue_client(IOTHUB_CLIENT_POOL_CLIENT* poolClient)
+{
+    (void)DList_RemoveEntryList(&poolClient->runEntry);
+    poolClient->worker->queuedCount--;
+    poolClient->isQueued = false;
+}
+
+/*must be called with the pool lock held*/
+static IOTHUB_CLIENT_POOL_CLIENT* take_next_client(IO_WORKER* worker)
+{
+    IOTHUB_CLIENT_POOL_CLIENT* result;
+
+    if (worker->queuedCount == 0)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = containingRecord(worker->runQueue.Flink, IOTHUB_CLIENT_POOL_CLIENT, runEntry);
+        unqueue_client(result);
+        result->isRunning = true;
+    }
+
+    return result;
+}
+
+/*must be called with the pool lock held*/
+static size_t steal_client(IO_WORKER* thief)
+{
+    IOTHUB_CLIENT_POOL* pool = thief->pool;
+    size_t thiefIndex = (size_t)(thief - pool->ioWorkers);
+    size_t stolen = 0;
+    size_t offset;
+
+    for (offset = 1; offset < pool->ioThreadCount && stolen == 0; offset++)
+    {
+        IO_WORKER* victim = &pool->ioWorkers[(thiefIndex + offset) % pool->ioThreadCount];
+
+        /*a thread keeps its last client, otherwise a single client would bounce between idle threads*/
+        if (victim->queuedCount > 1)
+        {
+            IOTHUB_CLIENT_POOL_CLIENT* poolClient = containingRecord(victim->runQueue.Blink, IOTHUB_CLIENT_POOL_CLIENT, runEntry);
+            unqueue_client(poolClient);
+            queue_client(thief, poolClient);
+            stolen = 1;
+        }
+    }
+
+    return stolen;
+}
+
+/*must be called with the pool lock held*/
+static void request_dispatch(IOTHUB_CLIENT_POOL_CLIENT* poolClient)
+{
+    IOTHUB_CLIENT_POOL* pool = poolClient->pool;
+
+    poolClient->isDispatchRequested = true;
+    /*Codes_SRS_IOTHUBCLIENT_POOL_11_022: [ A client shall be in the dispatch queue at most once and shall not be queued while its callbacks are being dispatched. ]*/
+    if (!poolClient->isDispatchQueued && !poolClient->isDispatching)
+    {
+        DList_InsertTailList(&pool->dispatchQueue, &poolClient->dispatchEntry);
+        poolClient->isDispatchQueued = true;
+        if (Condition_Post(pool->dispatchCondition) != COND_OK)
+        {
+            LogError("Condition_Post failed, the callbacks will be dispatched by the next callback thread looking for work");
+        }
+    }
+}
+
+/*must be called with the pool lock held*/
+static void release_client(IOTHUB_CLIENT_POOL_CLIENT* poolClient)
+{
+    if (poolClient->isRemoved)
+    {
+        size_t index;
+
+        /*Condition_Post wakes a single waiter and the waiters might be removing other clients, so wake all of them*/
+        for (index = 0; index < poolClient->pool->releaseWaiters; index++)
+        {
+            if (Condition_Post(poolClient->pool->releaseCondition) != COND_OK)
+            {
+                LogError("Condition_Post failed, IoTHubClientPool_RemoveClient will notice the client was released after its wait");
+            }
+        }
+    }
+    else if (!poolClient->isRunning && !poolClient->isQueued)
+    {
+        queue_client(poolClient->worker, poolClient);
+    }
+}
+
+static bool run_client(IO_WORKER* worker, IOTHUB_CLIENT_POOL_CLIENT* poolClient, unsigned int* maxWaitMs)
+{
+    IOTHUB_CLIENT_POOL* pool = worker->pool;
+    bool hasCallbacks;
+    bool freeClient = false;
+
+    /*Codes_SRS_IOTHUBCLIENT_POOL_11_017: [ The I/O thread shall call the doWork function of the client without holding the pool lock. ]*/
+    SET_IO_THREAD_CLIENT(poolClient);
+    hasCallbacks = poolClient->doWork(poolClient->client, maxWaitMs);
+
+    /*Codes_SRS_IOTHUBCLIENT_POOL_11_018: [ If doWork returns true and the pool has no callback threads, the I/O thread shall call the dispatch function of the client before driving another client. ]*/
+    if (hasCallbacks && pool->callbackThreadCount == 0)
+    {
+        poolClient->dispatch(poolClient->client);
+    }
+    SET_IO_THREAD_CLIENT(NULL);
+
+    if (Lock(pool->lockHandle) != LOCK_OK)
+    {
+        LogError("failed locking the pool, the client will not be driven anymore");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_POOL_11_019: [ If doWork returns true and the pool has callback threads, the client shall be added to the dispatch queue and a callback thread shall be signaled. ]*/
+        if (hasCallbacks && pool->callbackThreadCount > 0 && !poolClient->isRemoved)
+        {
+            request_dispatch(poolClient);
+        }
+
+        /*Codes_SRS_IOTHUBCLIENT_POOL_11_020: [ After running a client the I/O thread shall put it back at the end of its run queue. ]*/
+        poolClient->isRunning = false;
+        release_client(poolClient);
+        freeClient = poolClient->isReleaseDeferred;
+        (void)Unlock(pool->lockHandle);
+    }
+
+    if (freeClient)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_POOL_11_034: [ A thread of the pool that returns from doWork or dispatch of a client removed by that call shall free the client. ]*/
+        free(poolClient);
+    }
+
+    return hasCallbacks;
+}
+
+static void wait_for_work(IO_WORKER* worker, bool hadCallbacks, unsigned int maxWaitMs)
+{
+    IOTHUB_CLIENT_POOL* pool = worker->pool;
+
+    if (Lock(pool->lockHandle) != LOCK_OK)
+    {
+        LogError("failed locking for wait_for_work");
+        (void)ThreadAPI_Sleep(LOCK_RETRY_WAIT_MS);
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_POOL_11_021: [ After a round the I/O thread shall wait on its condition for at most its idle wait, which starts at 1 ms, doubles after each round in which no client reported callbacks and never exceeds 1000 ms, unless one of its clients signaled work or the pool is being destroyed. ]*/
+        if (hadCallbacks)
+        {
+            worker->idleWaitMs = IO_THREAD_MIN_IDLE_WAIT_MS;
+        }
+        else if (worker->idleWaitMs >= IO_THREAD_MAX_IDLE_WAIT_MS / 2)
+        {
+            worker->idleWaitMs = IO_THREAD_MAX_IDLE_WAIT_MS;
+        }
+        else
+        {
+            worker->idleWaitMs *= 2;
+        }
+
+        if (!pool->stopThreads && !worker->workPending)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_POOL_11_032: [ The I/O thread shall not wait longer than the smallest wait a client of the round left in the maxWaitMs argument of doWork, and shall not wait at all if that wait is 0. ]*/
+            unsigned int waitMs = (maxWaitMs < worker->idleWaitMs) ? maxWaitMs : worker->idleWaitMs;
+            if (waitMs > 0)
+            {
+                (void)Condition_Wait(worker->workCondition, pool->lockHandle, (int)waitMs);
+            }
+        }
+        (void)Unlock(pool->lockHandle);
+    }
+}
+
+static int io_worker_thread(void* threadArgument)
+{
+    IO_WORKER* worker = (IO_WORKER*)threadArgument;
+    IOTHUB_CLIENT_POOL* pool = worker->pool;
+
+    while (1)
+    {
+        if (Lock(pool->lockHandle) != LOCK_OK)
+        {
+            LogError("failed locking for io_worker_thread");
+            (void)ThreadAPI_Sleep(LOCK_RETRY_WAIT_MS);
+        }
+        else if (pool->stopThreads)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_POOL_11_014: [ The I/O threads shall exit when IoTHubClientPool_Destroy is called. ]*/
+            (void)Unlock(pool->lockHandle);
+            break;
+        }
+        else
+        {
+            size_t roundSize;
+            size_t index;
+            unsigned int maxWaitMs = IO_THREAD_MAX_IDLE_WAIT_MS;
+            bool hadCallbacks = false;
+
+            worker->workPending = 0;
+            /*Codes_SRS_IOTHUBCLIENT_POOL_11_015: [ Each round, an I/O thread shall drive every client in its run queue once, in order. ]*/
+            /*Codes_SRS_IOTHUBCLIENT_POOL_11_016: [ If its run queue is empty, an I/O thread shall steal the last client of the first other I/O thread that has more than one client queued. ]*/
+            roundSize = (worker->queuedCount > 0) ? worker->queuedCount : steal_client(worker);
+            (void)Unlock(pool->lockHandle);
+
+            for (index = 0; index < roundSize; index++)
+            {
+                IOTHUB_CLIENT_POOL_CLIENT* poolClient;
+
+                if (Lock(pool->lockHandle) != LOCK_OK)
+                {
+                    LogError("failed locking for io_worker_thread");
+                    poolClient = NULL;
+                }
+                else
+                {
+                    poolClient = take_next_client(worker);
+                    (void)Unlock(pool->lockHandle);
+                }
+
+                if (poolClient == NULL)
+                {
+                    /*clients were removed or stolen during the round*/
+                    break;
+                }
+                else if (run_client(worker, poolClient, &maxWaitMs))
+                {
+                    hadCallbacks = true;
+                }
+            }
+
+            wait_for_work(worker, hadCallbacks, maxWaitMs);
+        }
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+static int callback_worker_thread(void* threadArgument)
+{
+    IOTHUB_CLIENT_POOL* pool = (IOTHUB_CLIENT_POOL*)threadArgument;
+
+    while (1)
+    {
+        if (Lock(pool->lockHandle) != LOCK_OK)
+        {
+            LogError("failed locking for callback_worker_thread");
+            (void)ThreadAPI_Sleep(LOCK_RETRY_WAIT_MS);
+        }
+        else if (pool->stopThreads)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_POOL_11_023: [ The callback threads shall exit when IoTHubClientPool_Destroy is called. ]*/
+            (void)Unlock(pool->lockHandle);
+            break;
+        }
+        else if (DList_IsListEmpty(&pool->dispatchQueue))
+        {
+            (void)Condition_Wait(pool->dispatchCondition, pool->lockHandle, DISPATCH_WAIT_INFINITE);
+            (void)Unlock(pool->lockHandle);
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_POOL_11_024: [ A callback thread shall take the first client of the dispatch queue and call its dispatch function without holding the pool lock. ]*/
+            IOTHUB_CLIENT_POOL_CLIENT* poolClient = containingRecord(DList_RemoveHeadList(&pool->dispatchQueue), IOTHUB_CLIENT_POOL_CLIENT, dispatchEntry);
+            bool freeClient = false;
+            poolClient->isDispatchQueued = false;
+            poolClient->isDispatchRequested = false;
+            poolClient->isDispatching = true;
+            (void)Unlock(pool->lockHandle);
+
+            SET_CALLBACK_THREAD_CLIENT(poolClient);
+            poolClient->dispatch(poolClient->client);
+            SET_CALLBACK_THREAD_CLIENT(NULL);
+
+            if (Lock(pool->lockHandle) != LOCK_OK)
+            {
+                LogError("failed locking the pool, the callbacks of the client will not be dispatched anymore");
+            }
+            else
+            {
+                poolClient->isDispatching = false;
+                if (poolClient->isRemoved)
+                {
+                    release_client(poolClient);
+                    freeClient = poolClient->isReleaseDeferred;
+                }
+                /*Codes_SRS_IOTHUBCLIENT_POOL_11_025: [ If more callbacks were reported for the client while they were being dispatched, the client shall be added to the dispatch queue again. ]*/
+                else if (poolClient->isDispatchRequested)
+                {
+                    request_dispatch(poolClient);
+                }
+                (void)Unlock(pool->lockHandle);
+            }
+
+            if (freeClient)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_POOL_11_034: [ A thread of the pool that returns from doWork or dispatch of a client removed by that call shall free the client. ]*/
+                free(poolClient);
+            }
+        }
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+static void stop_threads(IOTHUB_CLIENT_POOL* pool)
+{
+    size_t index;
+
+    pool->stopThreads = 1;
+    for (index = 0; index < pool->ioThreadCount; index++)
+    {
+        if (pool->ioWorkers[index].workCondition != NULL && Condition_Post(pool->ioWorkers[index].workCondition) != COND_OK)
+        {
+            LogError("Condition_Post failed, the I/O thread will stop after its idle wait");
+        }
+    }
+    for (index = 0; index < pool->callbackThreadCount; index++)
+    {
+        if (Condition_Post(pool->dispatchCondition) != COND_OK)
+        {
+            LogError("Condition_Post failed, a callback thread might not stop");
+        }
+    }
+}
+
+static void join_thread(THREAD_HANDLE threadHandle)
+{
+    if (threadHandle != NULL)
+    {
+        int res;
+        if (ThreadAPI_Join(threadHandle, &res) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join failed");
+        }
+    }
+}
+
+/*stops the threads that were started and frees everything that was allocated, also used when IoTHubClientPool_Create fails halfway*/
+static void destroy_pool(IOTHUB_CLIENT_POOL* pool)
+{
+    size_t index;
+
+    if (Lock(pool->lockHandle) != LOCK_OK)
+    {
+        LogError("Unable to lock - will still attempt to end the threads without thread safety");
+        stop_threads(pool);
+    }
+    else
+    {
+        stop_threads(pool);
+        (void)Unlock(pool->lockHandle);
+    }
+
+    for (index = 0; index < pool->ioThreadCount; index++)
+    {
+        join_thread(pool->ioWorkers[index].threadHandle);
+        if (pool->ioWorkers[index].workCondition != NULL)
+        {
+            Condition_Deinit(pool->ioWorkers[index].workCondition);
+        }
+    }
+    for (index = 0; index < pool->callbackThreadCount; index++)
+    {
+        join_thread(pool->callbackThreadHandles[index]);
+    }
+
+    free(pool->callbackThreadHandles);
+    free(pool->ioWorkers);
+    Condition_Deinit(pool->releaseCondition);
+    Condition_Deinit(pool->dispatchCondition);
+    Lock_Deinit(pool->lockHandle);
+    free(pool);
+}
+
+static int start_threads(IOTHUB_CLIENT_POOL* pool)
+{
+    int result = 0;
+    size_t index;
+
+    for (index = 0; index < pool->ioThreadCount && result == 0; index++)
+    {
+        IO_WORKER* worker = &pool->ioWorkers[index];
+
+        /*Codes_SRS_IOTHUBCLIENT_POOL_11_006: [ IoTHubClientPool_Create shall create a condition for each I/O thread by calling Condition_Init. ]*/
+        if ((worker->workCondition = Condition_Init()) == NULL)
+        {
+            LogError("Condition_Init failed for I/O thread %lu", (unsigned long)index);
+            result = __FAILURE__;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_POOL_11_007: [ IoTHubClientPool_Create shall start ioThreadCount I/O threads and callbackThreadCount callback threads by calling ThreadAPI_Create. ]*/
+        else if (ThreadAPI_Create(&worker->threadHandle, io_worker_thread, worker) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Create failed for I/O thread %lu", (unsigned long)index);
+            worker->threadHandle = NULL;
+            result = __FAILURE__;
+        }
+    }
+
+    for (index = 0; index < pool->callbackThreadCount && result == 0; index++)
+    {
+        if (ThreadAPI_Create(&pool->callbackThreadHandles[index], callback_worker_thread, pool) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Create failed for callback thread %lu", (unsigned long)index);
+            pool->callbackThreadHandles[index] = NULL;
+            result = __FAILURE__;
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_POOL_HANDLE IoTHubClientPool_Create(size_t ioThreadCount, size_t callbackThreadCount)
+{
+    IOTHUB_CLIENT_POOL* result;
+
+    if (ioThreadCount == 0)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_POOL_11_001: [ If ioThreadCount is 0, IoTHubClientPool_Create shall fail and return NULL. ]*/
+        LogError("Invalid argument, ioThreadCount must be greater than 0");
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_POOL_11_002: [ IoTHubClientPool_Create shall allocate memory for the pool. ]*/
+    else if ((result = (IOTHUB_CLIENT_POOL*)malloc(sizeof(IOTHUB_CLIENT_POOL))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_POOL_11_008: [ If any of the above fails, IoTHubClientPool_Create shall stop the threads it started, free all resources and return NULL. ]*/
+        LogError("Failed allocating the pool");
+    }
+    else
+    {
+        memset(result, 0, sizeof(IOTHUB_CLIENT_POOL));
+        result->ioThreadCount = ioThreadCount;
+        result->callbackThreadCount = callbackThreadCount;
+        DList_InitializeListHead(&result->dispatchQueue);
+
+        /*Codes_SRS_IOTHUBCLIENT_POOL_11_003: [ IoTHubClientPool_Create shall create the pool lock by calling Lock_Init. ]*/
+        if ((result->lockHandle = Lock_Init()) == NULL)
+        {
+            LogError("Lock_Init failed");
+            free(result);
+            result = NULL;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_POOL_11_004: [ IoTHubClientPool_Create shall create the dispatch and release conditions by calling Condition_Init. ]*/
+        else if ((result->dispatchCondition = Condition_Init()) == NULL)
+        {
+            LogError("Condition_Init failed");
+            Lock_Deinit(result->lockHandle);
+            free(result);
+            result = NULL;
+        }
+        else if ((result->releaseCondition = Condition_Init()) == NULL)
+        {
+            LogError("Condition_Init failed");
+            Condition_Deinit(result->dispatchCondition);
+            Lock_Deinit(result->lockHandle);
+            free(result);
+            result = NULL;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_POOL_11_005: [ IoTHubClientPool_Create shall allocate the I/O thread and callback thread tables. ]*/
+        else if ((result->ioWorkers = (IO_WORKER*)malloc(ioThreadCount * sizeof(IO_WORKER))) == NULL)
+        {
+            LogError("Failed allocating the I/O threads");
+            Condition_Deinit(result->releaseCondition);
+            Condition_Deinit(result->dispatchCondition);
+            Lock_Deinit(result->lockHandle);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            size_t index;
+
+            for (index = 0; index < ioThreadCount; index++)
+            {
+                memset(&result->ioWorkers[index], 0, sizeof(IO_WORKER));
+                result->ioWorkers[index].pool = result;
+                result->ioWorkers[index].idleWaitMs = IO_THREAD_MIN_IDLE_WAIT_MS;
+                DList_InitializeListHead(&result->ioWorkers[index].runQueue);
+            }
+
+            if (callbackThreadCount > 0 &&
+                (result->callbackThreadHandles = (THREAD_HANDLE*)malloc(callbackThreadCount * sizeof(THREAD_HANDLE))) == NULL)
+            {
+                LogError("Failed allocating the callback threads");
+                result->callbackThreadCount = 0;
+                destroy_pool(result);
+                result = NULL;
+            }
+            else
+            {
+                for (index = 0; index < callbackThreadCount; index++)
+                {
+                    result->callbackThreadHandles[index] = NULL;
+                }
+
+                if (start_threads(result) != 0)
+                {
+                    destroy_pool(result);
+                    result = NULL;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+void IoTHubClientPool_Destroy(IOTHUB_CLIENT_POOL_HANDLE poolHandle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_POOL_11_009: [ If poolHandle is NULL, IoTHubClientPool_Destroy shall do nothing. ]*/
+    if (poolHandle != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_POOL_11_010: [ IoTHubClientPool_Destroy shall signal all the threads of the pool to stop, join them and free all resources. ]*/
+        destroy_pool(poolHandle);
+    }
+}
+
+IOTHUB_CLIENT_POOL_CLIENT_HANDLE IoTHubClientPool_AddClient(IOTHUB_CLIENT_POOL_HANDLE poolHandle, void* client, IOTHUB_CLIENT_POOL_DO_WORK doWork, IOTHUB_CLIENT_POOL_DISPATCH dispatch)
+{
+    IOTHUB_CLIENT_POOL_CLIENT* result;
+
+    if (poolHandle == NULL || client == NULL || doWork == NULL || dispatch == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_POOL_11_011: [ If poolHandle, client, doWork or dispatch is NULL, IoTHubClientPool_AddClient shall fail and return NULL. ]*/
+        LogError("Invalid argument, poolHandle [%p], client [%p], doWork [%p], dispatch [%p]", poolHandle, client, doWork, dispatch);
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_CLIENT_POOL_CLIENT*)malloc(sizeof(IOTHUB_CLIENT_POOL_CLIENT))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_POOL_11_013: [ If allocating or locking fails, IoTHubClientPool_AddClient shall fail and return NULL. ]*/
+        LogError("Failed allocating the pool client");
+    }
+    else
+    {
+        memset(result, 0, sizeof(IOTHUB_CLIENT_POOL_CLIENT));
+        result->pool = poolHandle;
+        result->client = client;
+        result->doWork = doWork;
+        result->dispatch = dispatch;
+
+        if (Lock(poolHandle->lockHandle) != LOCK_OK)
+        {
+            LogError("failed locking for IoTHubClientPool_AddClient");
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_POOL_11_012: [ IoTHubClientPool_AddClient shall add the client to the run queue of the next I/O thread, in round robin order, and wake that thread. ]*/
+            IO_WORKER* worker = &poolHandle->ioWorkers[poolHandle->nextIoWorker];
+            poolHandle->nextIoWorker = (poolHandle->nextIoWorker + 1) % poolHandle->ioThreadCount;
+
+            queue_client(worker, result);
+            worker->workPending = 1;
+            if (Condition_Post(worker->workCondition) != COND_OK)
+            {
+                LogError("Condition_Post failed, the client will be driven after the idle wait of its thread");
+            }
+            (void)Unlock(poolHandle->lockHandle);
+        }
+    }
+
+    return result;
+}
+
+void IoTHubClientPool_SignalClient(IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClientHandle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_POOL_11_026: [ If poolClientHandle is NULL, IoTHubClientPool_SignalClient shall do nothing. ]*/
+    if (poolClientHandle != NULL)
+    {
+        IOTHUB_CLIENT_POOL* pool = poolClientHandle->pool;
+
+        if (Lock(pool->lockHandle) != LOCK_OK)
+        {
+            LogError("failed locking for IoTHubClientPool_SignalClient");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_POOL_11_027: [ IoTHubClientPool_SignalClient shall mark work as pending for the I/O thread driving the client and call Condition_Post to wake it. ]*/
+            IO_WORKER* worker = poolClientHandle->worker;
+            worker->workPending = 1;
+            if (Condition_Post(worker->workCondition) != COND_OK)
+            {
+                LogError("Condition_Post failed, the client will be driven after the idle wait of its thread");
+            }
+            (void)Unlock(pool->lockHandle);
+        }
+    }
+}
+
+/*isIoThread and isCallbackThread tell whether the calling thread is the one running doWork or dispatch of the client*/
+static void remove_client(IOTHUB_CLIENT_POOL_CLIENT* poolClientHandle, bool isIoThread, bool isCallbackThread)
+{
+    IOTHUB_CLIENT_POOL* pool = poolClientHandle->pool;
+
+    if (Lock(pool->lockHandle) != LOCK_OK)
+    {
+        /*the client cannot be released safely, leak it rather than free memory a thread might still use*/
+        LogError("failed locking for IoTHubClientPool_RemoveClient");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_POOL_11_029: [ IoTHubClientPool_RemoveClient shall remove the client from its run queue and from the dispatch queue. ]*/
+        poolClientHandle->isRemoved = true;
+        if (poolClientHandle->isQueued)
+        {
+            unqueue_client(poolClientHandle);
+        }
+        if (poolClientHandle->isDispatchQueued)
+        {
+            (void)DList_RemoveEntryList(&poolClientHandle->dispatchEntry);
+            poolClientHandle->isDispatchQueued = false;
+        }
+
+        /*Codes_SRS_IOTHUBCLIENT_POOL_11_030: [ If another thread of the pool is running doWork or dispatch for the client, IoTHubClientPool_RemoveClient shall wait on the release condition until it is done. ]*/
+        pool->releaseWaiters++;
+        while ((poolClientHandle->isRunning && !isIoThread) ||
+            (poolClientHandle->isDispatching && !isCallbackThread))
+        {
+            (void)Condition_Wait(pool->releaseCondition, pool->lockHandle, CLIENT_RELEASE_WAIT_MS);
+        }
+        pool->releaseWaiters--;
+
+        if (isIoThread || isCallbackThread)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_POOL_11_033: [ If IoTHubClientPool_RemoveClient is called from doWork or dispatch of the same client, it shall not wait for the calling thread and shall leave freeing poolClientHandle to that thread. ]*/
+            poolClientHandle->isReleaseDeferred = true;
+            (void)Unlock(pool->lockHandle);
+        }
+        else
+        {
+            (void)Unlock(pool->lockHandle);
+
+            /*Codes_SRS_IOTHUBCLIENT_POOL_11_031: [ IoTHubClientPool_RemoveClient shall free poolClientHandle. ]*/
+            free(poolClientHandle);
+        }
+    }
+}
+
+void IoTHubClientPool_RemoveClient(IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClientHandle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_POOL_11_028: [ If poolClientHandle is NULL, IoTHubClientPool_RemoveClient shall do nothing. ]*/
+    if (poolClientHandle != NULL)
+    {
+        remove_client(poolClientHandle, IS_IO_THREAD_CLIENT(poolClientHandle), IS_CALLBACK_THREAD_CLIENT(poolClientHandle));
+    }
+}
+
+void IoTHubClientPool_RemoveClientFromDispatch(IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClientHandle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_POOL_11_035: [ If poolClientHandle is NULL, IoTHubClientPool_RemoveClientFromDispatch shall do nothing. ]*/
+    if (poolClientHandle != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_POOL_11_036: [ IoTHubClientPool_RemoveClientFromDispatch shall remove the client as IoTHubClientPool_RemoveClient does when called from dispatch of the same client, whether or not thread local storage is available. ]*/
+        bool isInlineDispatch = (poolClientHandle->pool->callbackThreadCount == 0);
+        remove_client(poolClientHandle, isInlineDispatch, !isInlineDispatch);
+    }
+}
@@ -2,52 +2,170 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
-#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
 
 #include "iothub_message.h"
 
+/*the US-ASCII validation uses AVX2 when the build targets it and SSE2, always there on x64, otherwise 8 bytes at a time*/
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define USE_AVX2_ASCII_VALIDATION
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define USE_SSE2_ASCII_VALIDATION
+#else
+#define SWAR_REPEAT(byte) (UINT64_C(0x0101010101010101) * (byte))
+#endif
+
 DEFINE_ENUM_STRINGS(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_RESULT_VALUES);
 DEFINE_ENUM_STRINGS(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_CONTENT_TYPE_VALUES);
 
 #define LOG_IOTHUB_MESSAGE_ERROR() \
     LogError("(result = %s)", ENUM_TO_STRING(IOTHUB_MESSAGE_RESULT, result));
 
+/*the payload and the properties of a message are shared with its clones, which can be destroyed on other threads*/
+#if defined(_MSC_VER)
+#include <windows.h>
+#define MESSAGE_INCREMENT_REFCOUNT(count) InterlockedIncrement(count)
+#define MESSAGE_DECREMENT_REFCOUNT(count) InterlockedDecrement(count)
+#elif defined(__GNUC__)
+#define MESSAGE_INCREMENT_REFCOUNT(count) __sync_add_and_fetch((count), 1)
+#define MESSAGE_DECREMENT_REFCOUNT(count) __sync_sub_and_fetch((count), 1)
+#else
+#define MESSAGE_INCREMENT_REFCOUNT(count) (++(*(count)))
+#define MESSAGE_DECREMENT_REFCOUNT(count) (--(*(count)))
+#endif
+
+/*room reserved inside each message for its system properties and diagnostic data, enough for the usual GUID ids, content type and encoding*/
+#define MESSAGE_INLINE_STRINGS_SIZE 128
+
+/*a copy of the application properties of a message with the lengths of their keys and values, in a single allocation
+holding the entries in the order they were added, an open addressing index of the hashes of the keys and the strings*/
+typedef struct PROPERTY_TABLE_TAG
+{
+    size_t count;
+    size_t indexMask; /*the index has indexMask + 1 slots, a power of 2 at least twice the number of entries*/
+    IOTHUB_MESSAGE_PROPERTY* entries;
+    size_t* index; /*for each slot, 0 when it is empty or 1 + the position of its entry*/
+    uint32_t* hashes; /*the hash of the key of each entry*/
+    char* strings; /*where the next copied key or value goes*/
+}PROPERTY_TABLE;
+
+/*the properties of a message, shared with its clones as long as nobody holds their map*/
+typedef struct MESSAGE_PROPERTIES_TAG
+{
+    volatile long refCount;
+    MAP_HANDLE map; /*NULL until IoTHubMessage_Properties hands it out, never shared since the caller can change it*/
+    PROPERTY_TABLE* table; /*NULL until the properties are read or shared, and again once the map is handed out; never NULL when shared*/
+    struct IOTHUB_MESSAGE_HANDLE_DATA_TAG* block; /*the message whose block holds these properties, NULL when they have their own allocation*/
+}MESSAGE_PROPERTIES;
+
+/*a message is a single allocation: this header, followed by its payload when it is not a clone and does not borrow it*/
 typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG
 {
+    volatile long refCount; /*1 for the message itself, 1 for each clone sharing its payload and 1 while embeddedProperties are used*/
+    struct IOTHUB_MESSAGE_HANDLE_DATA_TAG* payloadOwner; /*the message holding the payload, this one for a message that is not a clone*/
     IOTHUBMESSAGE_CONTENT_TYPE contentType;
-    union
-    {
-        BUFFER_HANDLE byteArray;
-        STRING_HANDLE string;
-    } value;
-    MAP_HANDLE properties;
+    const unsigned char* payload; /*a STRING payload is null terminated*/
+    size_t payloadSize;
+    IOTHUB_MESSAGE_BUFFER_RELEASE_CALLBACK releaseBuffer; /*gives back a borrowed payload once the block is freed, NULL for a clone*/
+    void* releaseContext;
+    MESSAGE_PROPERTIES* properties; /*NULL until IoTHubMessage_Properties is first called*/
+    MESSAGE_PROPERTIES embeddedProperties;
+    bool embeddedPropertiesUsed;
     char* messageId;
     char* correlationId;
     char* userDefinedContentType;
     char* contentEncoding;
-    IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA_HANDLE diagnosticData;
+    IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA_HANDLE diagnosticData; /*NULL or diagnosticStorage*/
+    IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA diagnosticStorage;
+    size_t inlineStringsUsed;
+    char inlineStrings[MESSAGE_INLINE_STRINGS_SIZE];
 }IOTHUB_MESSAGE_HANDLE_DATA;
 
-static bool ContainsOnlyUsAscii(const char* asciiValue)
+/*checks that the bytes of value are all printable US-ASCII (32 to 126), a block of bytes at a time: property keys and values
+are checked each time they are set, and gateways set tens of them on every message*/
+static bool ContainsOnlyUsAsciiWithLength(const char* value, size_t length)
 {
     bool result = true;
-    const char* iterator = asciiValue;
-    while (iterator != NULL && *iterator != '\0')
+    size_t index = 0;
+
+#if defined(USE_AVX2_ASCII_VALIDATION)
+    /*as signed bytes, the bytes that are not printable are the ones lower than ' ' (which include 128 to 255) and 127*/
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i del = _mm256_set1_epi8(0x7F);
+    for (; index + 32 <= length; index += 32)
     {
-        // Allow only printable ascii char 
-        if (*iterator < ' ' || *iterator > '~')
+        __m256i block = _mm256_loadu_si256((const __m256i*)(value + index));
+        if (_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpgt_epi8(space, block), _mm256_cmpeq_epi8(block, del))) != 0)
         {
             result = false;
             break;
         }
-        iterator++;
+    }
+#endif
+
+#if defined(USE_SSE2_ASCII_VALIDATION)
+    if (result)
+    {
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i del = _mm_set1_epi8(0x7F);
+        for (; index + 16 <= length; index += 16)
+        {
+            __m128i block = _mm_loadu_si128((const __m128i*)(value + index));
+            if (_mm_movemask_epi8(_mm_or_si128(_mm_cmplt_epi8(block, space), _mm_cmpeq_epi8(block, del))) != 0)
+            {
+                result = false;
+                break;
+            }
+        }
+    }
+#else
+    if (result)
+    {
+        /*8 bytes at a time: a high bit is set in the result for a block holding a byte of 128 or more, lower than ' ' or
+        equal to 127; the bits for the bytes after the first one found may be wrong, which does not change the outcome*/
+        for (; index + sizeof(uint64_t) <= length; index += sizeof(uint64_t))
+        {
+            uint64_t block;
+            (void)memcpy(&block, value + index, sizeof(block));
+            if (((block |
+                ((block - SWAR_REPEAT(0x20)) & ~block) |
+                (((block ^ SWAR_REPEAT(0x7F)) - SWAR_REPEAT(0x01)) & ~(block ^ SWAR_REPEAT(0x7F)))) & SWAR_REPEAT(0x80)) != 0)
+            {
+                result = false;
+                break;
+            }
+        }
+    }
+#endif
+
+    if (result)
+    {
+        for (; index < length; index++)
+        {
+            if (value[index] < ' ' || value[index] > '~')
+            {
+                result = false;
+                break;
+            }
+        }
     }
     return result;
 }
 
+static bool ContainsOnlyUsAscii(const char* asciiValue)
+{
+    // Allow only printable ascii char
+    return (asciiValue == NULL) || ContainsOnlyUsAsciiWithLength(asciiValue, strlen(asciiValue));
+}
+
 /* Codes_SRS_IOTHUBMESSAGE_07_008: [ValidateAsciiCharactersFilter shall loop through the mapKey and mapValue strings to ensure that they only contain valid US-Ascii characters Ascii value 32 - 126.] */
 static int ValidateAsciiCharactersFilter(const char* mapKey, const char* mapValue)
 {
@@ -63,141 +181,484 @@ static int ValidateAsciiCharactersFilter(const char* mapKey, const char* mapValu
     return result;
 }
 
-static void DestroyDiagnosticPropertyData(IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA_HANDLE diagnosticHandle)
+/*FNV-1a*/
+static uint32_t HashPropertyKey(const char* key, size_t keyLength)
 {
-    if (diagnosticHandle != NULL)
+    uint32_t result = 2166136261u;
+    size_t index;
+    for (index = 0; index < keyLength; index++)
     {
-        free(diagnosticHandle->diagnosticId);
-        free(diagnosticHandle->diagnosticCreationTimeUtc);
+        result ^= (unsigned char)key[index];
+        result *= 16777619u;
     }
-    free(diagnosticHandle);
+    return result;
 }
 
-static void DestroyMessageData(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
+static PROPERTY_TABLE* CreatePropertyTable(size_t capacity, size_t stringsSize)
 {
-    if (handleData->contentType == IOTHUBMESSAGE_BYTEARRAY)
+    PROPERTY_TABLE* result;
+
+    /*the index has at most 4 slots per entry, or 4 slots*/
+    if ((stringsSize > ((size_t)-1) / 2) ||
+        (capacity > (((size_t)-1) / 2 - sizeof(PROPERTY_TABLE) - 4 * sizeof(size_t)) / (sizeof(IOTHUB_MESSAGE_PROPERTY) + 4 * sizeof(size_t) + sizeof(uint32_t))))
     {
-        BUFFER_delete(handleData->value.byteArray);
+        LogError("too many properties (%lu)", (unsigned long)capacity);
+        result = NULL;
     }
-    else if (handleData->contentType == IOTHUBMESSAGE_STRING)
+    else
     {
-        STRING_delete(handleData->value.string);
+        size_t indexSize = 4;
+        while (indexSize < capacity * 2)
+        {
+            indexSize <<= 1;
+        }
+
+        if ((result = (PROPERTY_TABLE*)malloc(sizeof(PROPERTY_TABLE) + capacity * sizeof(IOTHUB_MESSAGE_PROPERTY) + indexSize * sizeof(size_t) + capacity * sizeof(uint32_t) + stringsSize)) == NULL)
+        {
+            LogError("unable to malloc");
+        }
+        else
+        {
+            result->count = 0;
+            result->indexMask = indexSize - 1;
+            result->entries = (IOTHUB_MESSAGE_PROPERTY*)(result + 1);
+            result->index = (size_t*)(result->entries + capacity);
+            result->hashes = (uint32_t*)(result->index + indexSize);
+            result->strings = (char*)(result->hashes + capacity);
+            (void)memset(result->index, 0, indexSize * sizeof(size_t));
+        }
     }
+    return result;
+}
 
-    Map_Destroy(handleData->properties);
-    free(handleData->messageId);
-    handleData->messageId = NULL;
-    free(handleData->correlationId);
-    handleData->correlationId = NULL;
-    free(handleData->userDefinedContentType);
-    free(handleData->contentEncoding);
-    DestroyDiagnosticPropertyData(handleData->diagnosticData);
-    free(handleData);
+static const char* CopyPropertyString(PROPERTY_TABLE* table, const char* source, size_t length)
+{
+    char* result = table->strings;
+    (void)memcpy(result, source, length);
+    result[length] = '\0';
+    table->strings += length + 1;
+    return result;
 }
 
-static IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA_HANDLE CloneDiagnosticPropertyData(const IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA* source)
+/*the position of the entry of key, or the number of entries when the table does not have it; slot receives where key is or would be indexed*/
+static size_t FindPropertyEntry(const PROPERTY_TABLE* table, const char* key, size_t keyLength, uint32_t hash, size_t* slot)
 {
-    IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA_HANDLE result = NULL;
-    if (source == NULL)
+    size_t result = table->count;
+    size_t current = hash & table->indexMask;
+    while (table->index[current] != 0)
     {
-        LogError("Invalid argument - source is NULL");
+        size_t position = table->index[current] - 1;
+        if ((table->hashes[position] == hash) &&
+            (table->entries[position].keyLength == keyLength) &&
+            (memcmp(table->entries[position].key, key, keyLength) == 0))
+        {
+            result = position;
+            break;
+        }
+        current = (current + 1) & table->indexMask;
+    }
+    *slot = current;
+    return result;
+}
+
+/*the table must have room for the entry and its strings, a key already in it gets the new value*/
+static void AddPropertyEntry(PROPERTY_TABLE* table, const char* key, size_t keyLength, const char* value, size_t valueLength)
+{
+    uint32_t hash = HashPropertyKey(key, keyLength);
+    size_t slot;
+    size_t position = FindPropertyEntry(table, key, keyLength, hash, &slot);
+    if (position == table->count)
+    {
+        table->entries[position].key = CopyPropertyString(table, key, keyLength);
+        table->entries[position].keyLength = keyLength;
+        table->hashes[position] = hash;
+        table->count++;
+        table->index[slot] = table->count;
+    }
+    table->entries[position].value = CopyPropertyString(table, value, valueLength);
+    table->entries[position].valueLength = valueLength;
+}
+
+static PROPERTY_TABLE* CreatePropertyTableFromMap(MAP_HANDLE map)
+{
+    PROPERTY_TABLE* result;
+    const char*const* keys;
+    const char*const* values;
+    size_t count;
+    if (Map_GetInternals(map, &keys, &values, &count) != MAP_OK)
+    {
+        LogError("unable to get the properties from the map");
+        result = NULL;
     }
     else
     {
-        result = (IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA_HANDLE)malloc(sizeof(IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA));
-        if (result == NULL)
+        size_t stringsSize = 0;
+        size_t index;
+        for (index = 0; index < count; index++)
         {
-            LogError("malloc failed");
+            stringsSize += strlen(keys[index]) + strlen(values[index]) + 2;
         }
-        else
+
+        if ((result = CreatePropertyTable(count, stringsSize)) != NULL)
         {
-            result->diagnosticCreationTimeUtc = NULL;
-            result->diagnosticId = NULL;
-            if (source->diagnosticCreationTimeUtc != NULL && mallocAndStrcpy_s(&result->diagnosticCreationTimeUtc, source->diagnosticCreationTimeUtc) != 0)
+            for (index = 0; index < count; index++)
             {
-                LogError("mallocAndStrcpy_s for diagnosticCreationTimeUtc failed");
-                free(result);
-                result = NULL;
+                AddPropertyEntry(result, keys[index], strlen(keys[index]), values[index], strlen(values[index]));
             }
-            else if (source->diagnosticId != NULL && mallocAndStrcpy_s(&result->diagnosticId, source->diagnosticId) != 0)
+        }
+    }
+    return result;
+}
+
+/*the caller can change a map handed out by IoTHubMessage_Properties at any time, so a table made from it is checked before being used*/
+static bool PropertyTableMatchesMap(const PROPERTY_TABLE* table, MAP_HANDLE map)
+{
+    bool result;
+    const char*const* keys;
+    const char*const* values;
+    size_t count;
+    if ((Map_GetInternals(map, &keys, &values, &count) != MAP_OK) || (count != table->count))
+    {
+        result = false;
+    }
+    else
+    {
+        size_t index;
+        result = true;
+        for (index = 0; index < count; index++)
+        {
+            if ((strcmp(keys[index], table->entries[index].key) != 0) || (strcmp(values[index], table->entries[index].value) != 0))
             {
-                LogError("mallocAndStrcpy_s for diagnosticId failed");
-                free(result->diagnosticCreationTimeUtc);
-                free(result);
+                result = false;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+static MAP_HANDLE CreateMapFromPropertyTable(const PROPERTY_TABLE* table)
+{
+    MAP_HANDLE result;
+    if ((result = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
+    {
+        LogError("unable to create the properties map");
+    }
+    else
+    {
+        size_t index;
+        for (index = 0; index < table->count; index++)
+        {
+            if (Map_AddOrUpdate(result, table->entries[index].key, table->entries[index].value) != MAP_OK)
+            {
+                LogError("unable to add a property to the map");
+                Map_Destroy(result);
                 result = NULL;
+                break;
             }
         }
     }
     return result;
 }
 
-IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byteArray, size_t size)
+static bool IsInlineString(const IOTHUB_MESSAGE_HANDLE_DATA* handleData, const char* value)
 {
-    IOTHUB_MESSAGE_HANDLE_DATA* result;
-    if ((byteArray == NULL) && (size != 0))
+    return (value >= handleData->inlineStrings) && (value < handleData->inlineStrings + MESSAGE_INLINE_STRINGS_SIZE);
+}
+
+static void FreeMessageString(IOTHUB_MESSAGE_HANDLE_DATA* handleData, char** value)
+{
+    /*the space of an inline string is only reclaimed when a shorter value replaces it*/
+    if ((*value != NULL) && !IsInlineString(handleData, *value))
     {
-        LogError("Invalid argument - byteArray is NULL");
-        result = NULL;
+        free(*value);
+    }
+    *value = NULL;
+}
+
+/*Codes_SRS_IOTHUBMESSAGE_11_009: [ The message id, correlation id, content type, content encoding and diagnostic data shall be copied into the space reserved inside the message while it has room, and into their own allocation otherwise. ]*/
+static int SetMessageString(IOTHUB_MESSAGE_HANDLE_DATA* handleData, char** destination, const char* value)
+{
+    int result;
+    size_t length = strlen(value) + 1;
+    char* copy;
+
+    /*Codes_SRS_IOTHUBMESSAGE_11_010: [ A value replacing one kept inside the message shall reuse its space when it fits in it, a value in its own allocation shall be freed once replaced. ]*/
+    if ((*destination != NULL) && IsInlineString(handleData, *destination) && (strlen(*destination) + 1 >= length))
+    {
+        copy = *destination;
+    }
+    else if (length <= MESSAGE_INLINE_STRINGS_SIZE - handleData->inlineStringsUsed)
+    {
+        copy = handleData->inlineStrings + handleData->inlineStringsUsed;
+        handleData->inlineStringsUsed += length;
+    }
+    else
+    {
+        copy = (char*)malloc(length);
+    }
+
+    if (copy == NULL)
+    {
+        LogError("unable to allocate %lu bytes for a system property", (unsigned long)length);
+        result = __FAILURE__;
     }
     else
     {
-        result = (IOTHUB_MESSAGE_HANDLE_DATA*)malloc(sizeof(IOTHUB_MESSAGE_HANDLE_DATA));
-        if (result == NULL)
+        (void)memmove(copy, value, length);
+        if (copy != *destination)
         {
-            LogError("unable to malloc");
-            /*Codes_SRS_IOTHUBMESSAGE_02_024: [If there are any errors then IoTHubMessage_CreateFromByteArray shall return NULL.] */
-            /*let it go through*/
+            FreeMessageString(handleData, destination);
+            *destination = copy;
+        }
+        result = 0;
+    }
+    return result;
+}
+
+/*gives to the clone the string source->value, either at the same offset of its inline strings or in a new allocation*/
+static int CloneMessageString(IOTHUB_MESSAGE_HANDLE_DATA* result, char** destination, const IOTHUB_MESSAGE_HANDLE_DATA* source, const char* value)
+{
+    int cloneResult;
+    if (value == NULL)
+    {
+        *destination = NULL;
+        cloneResult = 0;
+    }
+    else if (IsInlineString(source, value))
+    {
+        *destination = result->inlineStrings + (value - source->inlineStrings);
+        cloneResult = 0;
+    }
+    else if (mallocAndStrcpy_s(destination, value) != 0)
+    {
+        *destination = NULL;
+        cloneResult = __FAILURE__;
+    }
+    else
+    {
+        cloneResult = 0;
+    }
+    return cloneResult;
+}
+
+static void DestroyDiagnosticPropertyData(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
+{
+    FreeMessageString(handleData, &handleData->diagnosticStorage.diagnosticId);
+    FreeMessageString(handleData, &handleData->diagnosticStorage.diagnosticCreationTimeUtc);
+    handleData->diagnosticData = NULL;
+}
+
+static void ReleaseMessageBlock(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
+{
+    if (MESSAGE_DECREMENT_REFCOUNT(&handleData->refCount) == 0)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_11_018: [ The buffer shall be given to releaseCallback, along with context, once the message and all the clones sharing it are destroyed. ]*/
+        if (handleData->releaseBuffer != NULL)
+        {
+            handleData->releaseBuffer((unsigned char*)handleData->payload, handleData->releaseContext);
+        }
+        free(handleData);
+    }
+}
+
+static void ReleaseProperties(MESSAGE_PROPERTIES* properties)
+{
+    if ((properties != NULL) && (MESSAGE_DECREMENT_REFCOUNT(&properties->refCount) == 0))
+    {
+        if (properties->map != NULL)
+        {
+            Map_Destroy(properties->map);
+        }
+        if (properties->table != NULL)
+        {
+            free(properties->table);
+        }
+        if (properties->block != NULL)
+        {
+            ReleaseMessageBlock(properties->block);
         }
         else
         {
-            const unsigned char* source;
-            unsigned char temp = 0x00;
+            free(properties);
+        }
+    }
+}
+
+static void DestroyMessageData(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
+{
+    ReleaseProperties(handleData->properties);
+    handleData->properties = NULL;
+    FreeMessageString(handleData, &handleData->messageId);
+    FreeMessageString(handleData, &handleData->correlationId);
+    FreeMessageString(handleData, &handleData->userDefinedContentType);
+    FreeMessageString(handleData, &handleData->contentEncoding);
+    DestroyDiagnosticPropertyData(handleData);
+    if (handleData->payloadOwner != handleData)
+    {
+        ReleaseMessageBlock(handleData->payloadOwner);
+    }
+    /*Codes_SRS_IOTHUBMESSAGE_11_014: [ The block of a message shall be freed once the message and all the clones sharing its payload are destroyed. ]*/
+    ReleaseMessageBlock(handleData);
+}
 
-            memset(result, 0, sizeof(*result));
-            /*Codes_SRS_IOTHUBMESSAGE_02_026: [The type of the new message shall be IOTHUBMESSAGE_BYTEARRAY.] */
-            result->contentType = IOTHUBMESSAGE_BYTEARRAY;
+/*creates an empty map, or a copy of the map of source*/
+static MAP_HANDLE CreatePropertiesMap(const MESSAGE_PROPERTIES* source)
+{
+    MAP_HANDLE result;
+    if (source == NULL)
+    {
+        result = Map_Create(ValidateAsciiCharactersFilter);
+    }
+    else if (source->map != NULL)
+    {
+        result = Map_Clone(source->map);
+    }
+    else
+    {
+        result = CreateMapFromPropertyTable(source->table);
+    }
 
-            if (size != 0)
-            {
-                /*Codes_SRS_IOTHUBMESSAGE_06_002: [If size is NOT zero then byteArray MUST NOT be NULL*/
-                if (byteArray == NULL)
-                {
-                    LogError("Attempted to create a Hub Message from a NULL pointer!");
-                    DestroyMessageData(result);
-                    result = NULL;
-                    source = NULL;
-                }
-                else
-                {
-                    source = byteArray;
-                }
-            }
-            else
-            {
-                /*Codes_SRS_IOTHUBMESSAGE_06_001: [If size is zero then byteArray may be NULL.]*/
-                source = &temp;
-            }
-            if (result != NULL)
-            {
-                /*Codes_SRS_IOTHUBMESSAGE_02_022: [IoTHubMessage_CreateFromByteArray shall call BUFFER_create passing byteArray and size as parameters.] */
-                if ((result->value.byteArray = BUFFER_create(source, size)) == NULL)
-                {
-                    LogError("BUFFER_create failed");
-                    /*Codes_SRS_IOTHUBMESSAGE_02_024: [If there are any errors then IoTHubMessage_CreateFromByteArray shall return NULL.] */
-                    DestroyMessageData(result);
-                    result = NULL;
-                }
-                /*Codes_SRS_IOTHUBMESSAGE_02_023: [IoTHubMessage_CreateFromByteArray shall call Map_Create to create the message properties.] */
-                else if ((result->properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
-                {
-                    LogError("Map_Create for properties failed");
-                    /*Codes_SRS_IOTHUBMESSAGE_02_024: [If there are any errors then IoTHubMessage_CreateFromByteArray shall return NULL.] */
-                    DestroyMessageData(result);
-                    result = NULL;
-                }
-                /*Codes_SRS_IOTHUBMESSAGE_02_025: [Otherwise, IoTHubMessage_CreateFromByteArray shall return a non-NULL handle.] */
-            }
+    if (result == NULL)
+    {
+        LogError("unable to create the properties map");
+    }
+    return result;
+}
+
+/*gives to handleData properties holding map and table, which are left to the caller on failure*/
+static MESSAGE_PROPERTIES* CreateProperties(IOTHUB_MESSAGE_HANDLE_DATA* handleData, MAP_HANDLE map, PROPERTY_TABLE* table)
+{
+    MESSAGE_PROPERTIES* result;
+    /*the room inside the block is used only once, since a clone on another thread may still be releasing what it held*/
+    if (!handleData->embeddedPropertiesUsed)
+    {
+        result = &handleData->embeddedProperties;
+        result->block = handleData;
+        handleData->embeddedPropertiesUsed = true;
+        (void)MESSAGE_INCREMENT_REFCOUNT(&handleData->refCount);
+    }
+    else if ((result = (MESSAGE_PROPERTIES*)malloc(sizeof(MESSAGE_PROPERTIES))) == NULL)
+    {
+        LogError("unable to malloc");
+    }
+    else
+    {
+        result->block = NULL;
+    }
+
+    if (result != NULL)
+    {
+        result->refCount = 1;
+        result->map = map;
+        result->table = table;
+    }
+    return result;
+}
+
+/*only properties that are not shared have no table*/
+static int EnsurePropertyTable(MESSAGE_PROPERTIES* properties)
+{
+    int result;
+    PROPERTY_TABLE* table;
+    if ((properties->table != NULL) && ((properties->map == NULL) || PropertyTableMatchesMap(properties->table, properties->map)))
+    {
+        result = 0;
+    }
+    else if ((table = CreatePropertyTableFromMap(properties->map)) == NULL)
+    {
+        LogError("unable to create the property table");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (properties->table != NULL)
+        {
+            free(properties->table);
+        }
+        properties->table = table;
+        result = 0;
+    }
+    return result;
+}
+
+/*allocates in a single block a message and its payload, the properties map is created on first use*/
+static IOTHUB_MESSAGE_HANDLE_DATA* CreateMessageData(IOTHUBMESSAGE_CONTENT_TYPE contentType, const unsigned char* source, size_t size, size_t allocatedSize)
+{
+    IOTHUB_MESSAGE_HANDLE_DATA* result;
+    if (allocatedSize > ((size_t)-1) - sizeof(IOTHUB_MESSAGE_HANDLE_DATA))
+    {
+        LogError("payload of %lu bytes is too big", (unsigned long)size);
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_MESSAGE_HANDLE_DATA*)malloc(sizeof(IOTHUB_MESSAGE_HANDLE_DATA) + allocatedSize)) == NULL)
+    {
+        LogError("unable to malloc");
+    }
+    else
+    {
+        unsigned char* payload = (unsigned char*)(result + 1);
+
+        memset(result, 0, sizeof(*result));
+        result->refCount = 1;
+        result->payloadOwner = result;
+        result->contentType = contentType;
+        if (size != 0)
+        {
+            (void)memcpy(payload, source, size);
+        }
+        if (allocatedSize > size)
+        {
+            payload[size] = '\0';
         }
+        result->payload = payload;
+        result->payloadSize = size;
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byteArray, size_t size)
+{
+    IOTHUB_MESSAGE_HANDLE_DATA* result;
+    /*Codes_SRS_IOTHUBMESSAGE_06_002: [If size is NOT zero then byteArray MUST NOT be NULL*/
+    if ((byteArray == NULL) && (size != 0))
+    {
+        LogError("Invalid argument - byteArray is NULL");
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUBMESSAGE_06_001: [If size is zero then byteArray may be NULL.]*/
+    /*Codes_SRS_IOTHUBMESSAGE_11_001: [ IoTHubMessage_CreateFromByteArray shall allocate the message and a copy of byteArray in a single block. ]*/
+    /*Codes_SRS_IOTHUBMESSAGE_02_026: [The type of the new message shall be IOTHUBMESSAGE_BYTEARRAY.] */
+    else if ((result = CreateMessageData(IOTHUBMESSAGE_BYTEARRAY, byteArray, size, size)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_02_024: [If there are any errors then IoTHubMessage_CreateFromByteArray shall return NULL.] */
+        LogError("unable to create the message");
+    }
+    /*Codes_SRS_IOTHUBMESSAGE_02_025: [Otherwise, IoTHubMessage_CreateFromByteArray shall return a non-NULL handle.] */
+    return result;
+}
+
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromBufferNoCopy(unsigned char* buffer, size_t size, IOTHUB_MESSAGE_BUFFER_RELEASE_CALLBACK releaseCallback, void* context)
+{
+    IOTHUB_MESSAGE_HANDLE_DATA* result;
+    /*Codes_SRS_IOTHUBMESSAGE_11_015: [ If buffer is NULL and size is not zero, IoTHubMessage_CreateFromBufferNoCopy shall fail and return NULL. ]*/
+    if ((buffer == NULL) && (size != 0))
+    {
+        LogError("Invalid argument - buffer is NULL");
+        result = NULL;
+    }
+    else if ((result = CreateMessageData(IOTHUBMESSAGE_BYTEARRAY, NULL, 0, 0)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_11_017: [ If the allocation fails, IoTHubMessage_CreateFromBufferNoCopy shall return NULL without calling releaseCallback. ]*/
+        LogError("unable to create the message");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_11_016: [ IoTHubMessage_CreateFromBufferNoCopy shall allocate a message of type IOTHUBMESSAGE_BYTEARRAY whose payload is buffer itself, without copying it. ]*/
+        result->payload = buffer;
+        result->payloadSize = size;
+        result->releaseBuffer = releaseCallback;
+        result->releaseContext = context;
     }
     return result;
 }
@@ -212,37 +673,16 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char* source)
     }
     else
     {
-        result = (IOTHUB_MESSAGE_HANDLE_DATA*)malloc(sizeof(IOTHUB_MESSAGE_HANDLE_DATA));
-        if (result == NULL)
+        size_t length = strlen(source);
+
+        /*Codes_SRS_IOTHUBMESSAGE_11_002: [ IoTHubMessage_CreateFromString shall allocate the message and a copy of source, including its terminating null character, in a single block. ]*/
+        /*Codes_SRS_IOTHUBMESSAGE_02_032: [The type of the new message shall be IOTHUBMESSAGE_STRING.] */
+        if ((result = CreateMessageData(IOTHUBMESSAGE_STRING, (const unsigned char*)source, length, length + 1)) == NULL)
         {
-            LogError("malloc failed");
             /*Codes_SRS_IOTHUBMESSAGE_02_029: [If there are any encountered in the execution of IoTHubMessage_CreateFromString then IoTHubMessage_CreateFromString shall return NULL.] */
-            /*let it go through*/
-        }
-        else
-        {
-            memset(result, 0, sizeof(*result));
-            /*Codes_SRS_IOTHUBMESSAGE_02_032: [The type of the new message shall be IOTHUBMESSAGE_STRING.] */
-            result->contentType = IOTHUBMESSAGE_STRING;
-            
-            /*Codes_SRS_IOTHUBMESSAGE_02_027: [IoTHubMessage_CreateFromString shall call STRING_construct passing source as parameter.] */
-            if ((result->value.string = STRING_construct(source)) == NULL)
-            {
-                LogError("STRING_construct failed");
-                /*Codes_SRS_IOTHUBMESSAGE_02_029: [If there are any encountered in the execution of IoTHubMessage_CreateFromString then IoTHubMessage_CreateFromString shall return NULL.] */
-                DestroyMessageData(result);
-                result = NULL;
-            }
-            /*Codes_SRS_IOTHUBMESSAGE_02_028: [IoTHubMessage_CreateFromString shall call Map_Create to create the message properties.] */
-            else if ((result->properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
-            {
-                LogError("Map_Create for properties failed");
-                /*Codes_SRS_IOTHUBMESSAGE_02_029: [If there are any encountered in the execution of IoTHubMessage_CreateFromString then IoTHubMessage_CreateFromString shall return NULL.] */
-                DestroyMessageData(result);
-                result = NULL;
-            }
-            /*Codes_SRS_IOTHUBMESSAGE_02_031: [Otherwise, IoTHubMessage_CreateFromString shall return a non-NULL handle.] */
+            LogError("unable to create the message");
         }
+        /*Codes_SRS_IOTHUBMESSAGE_02_031: [Otherwise, IoTHubMessage_CreateFromString shall return a non-NULL handle.] */
     }
     return result;
 }
@@ -251,97 +691,79 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char* source)
 IOTHUB_MESSAGE_HANDLE IoTHubMessage_Clone(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
 {
     IOTHUB_MESSAGE_HANDLE_DATA* result;
-    const IOTHUB_MESSAGE_HANDLE_DATA* source = (const IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle;
+    IOTHUB_MESSAGE_HANDLE_DATA* source = (IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle;
+    PROPERTY_TABLE* ownTable = NULL;
     /* Codes_SRS_IOTHUBMESSAGE_03_005: [IoTHubMessage_Clone shall return NULL if iotHubMessageHandle is NULL.] */
     if (source == NULL)
     {
         result = NULL;
         LogError("iotHubMessageHandle parameter cannot be NULL for IoTHubMessage_Clone");
     }
-    else
+    /*Codes_SRS_IOTHUBMESSAGE_11_019: [ If the map of the source message was handed out by IoTHubMessage_Properties, IoTHubMessage_Clone shall not share the properties, since the caller can still change the map, and shall give the clone its own property table made from the map with Map_GetInternals. ]*/
+    else if ((source->properties != NULL) && (source->properties->map != NULL) && ((ownTable = CreatePropertyTableFromMap(source->properties->map)) == NULL))
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
+        LogError("unable to create the property table of the clone");
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUBMESSAGE_11_005: [ IoTHubMessage_Clone shall copy in a single block the message and the system properties kept inside it; the system properties kept in their own allocation shall be copied with mallocAndStrcpy_s. ]*/
+    else if ((result = (IOTHUB_MESSAGE_HANDLE_DATA*)malloc(sizeof(IOTHUB_MESSAGE_HANDLE_DATA))) == NULL)
     {
-        result = (IOTHUB_MESSAGE_HANDLE_DATA*)malloc(sizeof(IOTHUB_MESSAGE_HANDLE_DATA));
         /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-        if (result == NULL)
+        LogError("unable to malloc");
+        if (ownTable != NULL)
+        {
+            free(ownTable);
+        }
+    }
+    else
+    {
+        (void)memcpy(result, source, sizeof(IOTHUB_MESSAGE_HANDLE_DATA));
+        result->refCount = 1;
+        result->embeddedPropertiesUsed = false;
+        /*the buffer is given back by the message owning the payload*/
+        result->releaseBuffer = NULL;
+        result->releaseContext = NULL;
+        /*Codes_SRS_IOTHUBMESSAGE_11_011: [ IoTHubMessage_Clone shall share the payload of the source message instead of copying it. ]*/
+        (void)MESSAGE_INCREMENT_REFCOUNT(&result->payloadOwner->refCount);
+        if (ownTable != NULL)
+        {
+            /*the room inside the new block is unused, so this does not allocate and cannot fail*/
+            result->properties = CreateProperties(result, NULL, ownTable);
+        }
+        /*Codes_SRS_IOTHUBMESSAGE_11_006: [ Otherwise IoTHubMessage_Clone shall share the properties of the source message, if it has any. ]*/
+        else if (result->properties != NULL)
+        {
+            (void)MESSAGE_INCREMENT_REFCOUNT(&result->properties->refCount);
+        }
+        /*until they are cloned, the pointers of the copy must not reference what source owns*/
+        result->messageId = NULL;
+        result->correlationId = NULL;
+        result->userDefinedContentType = NULL;
+        result->contentEncoding = NULL;
+        result->diagnosticData = NULL;
+        result->diagnosticStorage.diagnosticId = NULL;
+        result->diagnosticStorage.diagnosticCreationTimeUtc = NULL;
+
+        if ((CloneMessageString(result, &result->messageId, source, source->messageId) != 0) ||
+            (CloneMessageString(result, &result->correlationId, source, source->correlationId) != 0) ||
+            (CloneMessageString(result, &result->userDefinedContentType, source, source->userDefinedContentType) != 0) ||
+            (CloneMessageString(result, &result->contentEncoding, source, source->contentEncoding) != 0) ||
+            (CloneMessageString(result, &result->diagnosticStorage.diagnosticId, source, source->diagnosticStorage.diagnosticId) != 0) ||
+            (CloneMessageString(result, &result->diagnosticStorage.diagnosticCreationTimeUtc, source, source->diagnosticStorage.diagnosticCreationTimeUtc) != 0))
         {
             /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-            /*do nothing and return as is*/
-            LogError("unable to malloc");
+            LogError("unable to copy the system properties");
+            DestroyMessageData(result);
+            result = NULL;
         }
         else
         {
-            memset(result, 0, sizeof(*result));
-            result->contentType = source->contentType;
-
-            if (source->messageId != NULL && mallocAndStrcpy_s(&result->messageId, source->messageId) != 0)
+            if (source->diagnosticData != NULL)
             {
-                LogError("unable to Copy messageId");
-                DestroyMessageData(result);
-                result = NULL;
-            }
-            else if (source->correlationId != NULL && mallocAndStrcpy_s(&result->correlationId, source->correlationId) != 0)
-            {
-                LogError("unable to Copy correlationId");
-                DestroyMessageData(result);
-                result = NULL;
-            }
-            else if (source->userDefinedContentType != NULL && mallocAndStrcpy_s(&result->userDefinedContentType, source->userDefinedContentType) != 0)
-            {
-                LogError("unable to copy contentType");
-                DestroyMessageData(result);
-                result = NULL;
-            }
-            else if (source->contentEncoding != NULL && mallocAndStrcpy_s(&result->contentEncoding, source->contentEncoding) != 0)
-            {
-                LogError("unable to copy contentEncoding");
-                DestroyMessageData(result);
-                result = NULL;
-            }
-            else if (source->diagnosticData != NULL && (result->diagnosticData = CloneDiagnosticPropertyData(source->diagnosticData)) == NULL)
-            {
-                LogError("unable to CloneDiagnosticPropertyData");
-                DestroyMessageData(result);
-                result = NULL;
-            }
-            else if (source->contentType == IOTHUBMESSAGE_BYTEARRAY)
-            {
-                /*Codes_SRS_IOTHUBMESSAGE_02_006: [IoTHubMessage_Clone shall clone to content by a call to BUFFER_clone] */
-                if ((result->value.byteArray = BUFFER_clone(source->value.byteArray)) == NULL)
-                {
-                    /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-                    LogError("unable to BUFFER_clone");
-                    DestroyMessageData(result);
-                    result = NULL;
-                }
-                /*Codes_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
-                else if ((result->properties = Map_Clone(source->properties)) == NULL)
-                {
-                    /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-                    LogError("unable to Map_Clone");
-                    DestroyMessageData(result);
-                    result = NULL;
-                }
-                /*Codes_SRS_IOTHUBMESSAGE_03_002: [IoTHubMessage_Clone shall return upon success a non-NULL handle to the newly created IoT hub message.]*/
-            }
-            else /*can only be STRING*/
-            {
-                /*Codes_SRS_IOTHUBMESSAGE_02_006: [IoTHubMessage_Clone shall clone the content by a call to BUFFER_clone or STRING_clone] */
-                if ((result->value.string = STRING_clone(source->value.string)) == NULL)
-                {
-                    /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-                    LogError("failed to STRING_clone");
-                    DestroyMessageData(result);
-                    result = NULL;
-                }
-                /*Codes_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
-                else if ((result->properties = Map_Clone(source->properties)) == NULL)
-                {
-                    /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-                    LogError("unable to Map_Clone");
-                    DestroyMessageData(result);
-                    result = NULL;
-                }
+                result->diagnosticData = &result->diagnosticStorage;
             }
+            /*Codes_SRS_IOTHUBMESSAGE_03_002: [IoTHubMessage_Clone shall return upon success a non-NULL handle to the newly created IoT hub message.]*/
         }
     }
     return result;
@@ -371,10 +793,9 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_GetByteArray(IOTHUB_MESSAGE_HANDLE iotHubMes
         }
         else
         {
-            /*Codes_SRS_IOTHUBMESSAGE_01_011: [The pointer shall be obtained by using BUFFER_u_char and it shall be copied in the buffer argument.]*/
-            *buffer = BUFFER_u_char(handleData->value.byteArray);
-            /*Codes_SRS_IOTHUBMESSAGE_01_012: [The size of the associated data shall be obtained by using BUFFER_length and it shall be copied to the size argument.]*/
-            *size = BUFFER_length(handleData->value.byteArray);
+            /*Codes_SRS_IOTHUBMESSAGE_11_007: [ IoTHubMessage_GetByteArray shall return in buffer and size the payload kept in the message and its size. ]*/
+            *buffer = handleData->payload;
+            *size = handleData->payloadSize;
             result = IOTHUB_MESSAGE_OK;
         }
     }
@@ -400,7 +821,8 @@ const char* IoTHubMessage_GetString(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
         else
         {
             /*Codes_SRS_IOTHUBMESSAGE_02_018: [IoTHubMessage_GetStringData shall return the currently stored null terminated string.] */
-            result = STRING_c_str(handleData->value.string);
+            /*Codes_SRS_IOTHUBMESSAGE_11_008: [ IoTHubMessage_GetString shall return the null terminated string kept in the message. ]*/
+            result = (const char*)handleData->payload;
         }
     }
     return result;
@@ -434,9 +856,209 @@ MAP_HANDLE IoTHubMessage_Properties(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
     }
     else
     {
-        /*Codes_SRS_IOTHUBMESSAGE_02_002: [Otherwise, for any non-NULL iotHubMessageHandle it shall return a non-NULL MAP_HANDLE.]*/
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = (IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle;
-        result = handleData->properties;
+        if (handleData->properties == NULL)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_11_003: [ The properties map shall be created with Map_Create the first time IoTHubMessage_Properties is called. ]*/
+            if ((result = CreatePropertiesMap(NULL)) == NULL)
+            {
+                /*Codes_SRS_IOTHUBMESSAGE_11_004: [ If Map_Create fails, IoTHubMessage_Properties shall return NULL. ]*/
+                LogError("Map_Create for properties failed");
+            }
+            else if ((handleData->properties = CreateProperties(handleData, result, NULL)) == NULL)
+            {
+                LogError("unable to create the properties");
+                Map_Destroy(result);
+                result = NULL;
+            }
+        }
+        /*the caller can change the map, so a message keeps sharing it only as long as nobody asks for it*/
+        else if (handleData->properties->refCount > 1)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_11_012: [ If the properties are shared with other messages, IoTHubMessage_Properties shall first give the message its own copy made with Map_Clone, or made from the property table when the properties were set with IoTHubMessage_SetProperties. ]*/
+            MESSAGE_PROPERTIES* copy;
+            if ((result = CreatePropertiesMap(handleData->properties)) == NULL)
+            {
+                /*Codes_SRS_IOTHUBMESSAGE_11_013: [ If the copy fails, IoTHubMessage_Properties shall return NULL. ]*/
+                LogError("Map_Clone for properties failed");
+            }
+            else if ((copy = CreateProperties(handleData, result, NULL)) == NULL)
+            {
+                /*Codes_SRS_IOTHUBMESSAGE_11_013: [ If the copy fails, IoTHubMessage_Properties shall return NULL. ]*/
+                LogError("unable to create the properties");
+                Map_Destroy(result);
+                result = NULL;
+            }
+            else
+            {
+                ReleaseProperties(handleData->properties);
+                handleData->properties = copy;
+            }
+        }
+        else
+        {
+            MESSAGE_PROPERTIES* properties = handleData->properties;
+            if (properties->map == NULL)
+            {
+                /*Codes_SRS_IOTHUBMESSAGE_11_020: [ If the properties were set with IoTHubMessage_SetProperties, IoTHubMessage_Properties shall create the map from the property table with Map_Create and Map_AddOrUpdate. ]*/
+                if ((properties->map = CreateMapFromPropertyTable(properties->table)) == NULL)
+                {
+                    /*Codes_SRS_IOTHUBMESSAGE_11_021: [ If creating the map fails, IoTHubMessage_Properties shall return NULL and the properties shall be left unchanged. ]*/
+                    LogError("unable to create the properties map");
+                }
+            }
+
+            if (properties->map != NULL)
+            {
+                /*Codes_SRS_IOTHUBMESSAGE_11_022: [ Since the caller can change the map it returns, IoTHubMessage_Properties shall free the property table, to be made again from the map when needed. ]*/
+                if (properties->table != NULL)
+                {
+                    free(properties->table);
+                    properties->table = NULL;
+                }
+            }
+
+            /*Codes_SRS_IOTHUBMESSAGE_02_002: [Otherwise, for any non-NULL iotHubMessageHandle it shall return a non-NULL MAP_HANDLE.]*/
+            result = properties->map;
+        }
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_GetPropertyTable(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const IOTHUB_MESSAGE_PROPERTY** properties, size_t* count)
+{
+    IOTHUB_MESSAGE_RESULT result;
+    /*Codes_SRS_IOTHUBMESSAGE_11_023: [ If iotHubMessageHandle, properties or count is NULL, IoTHubMessage_GetPropertyTable shall return IOTHUB_MESSAGE_INVALID_ARG. ]*/
+    if ((iotHubMessageHandle == NULL) || (properties == NULL) || (count == NULL))
+    {
+        LogError("invalid arg (NULL) passed to IoTHubMessage_GetPropertyTable");
+        result = IOTHUB_MESSAGE_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_MESSAGE_HANDLE_DATA* handleData = (IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle;
+        if (handleData->properties == NULL)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_11_024: [ If the message has no properties, IoTHubMessage_GetPropertyTable shall set properties to NULL and count to 0 and return IOTHUB_MESSAGE_OK. ]*/
+            *properties = NULL;
+            *count = 0;
+            result = IOTHUB_MESSAGE_OK;
+        }
+        /*Codes_SRS_IOTHUBMESSAGE_11_025: [ If the message has no property table, IoTHubMessage_GetPropertyTable shall make one from the properties map with Map_GetInternals. ]*/
+        /*Codes_SRS_IOTHUBMESSAGE_11_036: [ If the map was handed out by IoTHubMessage_Properties, IoTHubMessage_GetPropertyTable shall compare the property table with the map and make it again if the map was changed since. ]*/
+        else if (EnsurePropertyTable(handleData->properties) != 0)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_11_026: [ If making the property table fails, IoTHubMessage_GetPropertyTable shall return IOTHUB_MESSAGE_ERROR. ]*/
+            LogError("unable to create the property table");
+            result = IOTHUB_MESSAGE_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_11_027: [ IoTHubMessage_GetPropertyTable shall return in properties and count the entries of the property table, in the order their keys were first added, and return IOTHUB_MESSAGE_OK. ]*/
+            *properties = (handleData->properties->table->count == 0) ? NULL : handleData->properties->table->entries;
+            *count = handleData->properties->table->count;
+            result = IOTHUB_MESSAGE_OK;
+        }
+    }
+    return result;
+}
+
+const char* IoTHubMessage_GetProperty(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const char* key)
+{
+    const char* result;
+    const IOTHUB_MESSAGE_PROPERTY* properties;
+    size_t count;
+    /*Codes_SRS_IOTHUBMESSAGE_11_028: [ If iotHubMessageHandle or key is NULL, IoTHubMessage_GetProperty shall return NULL. ]*/
+    if ((iotHubMessageHandle == NULL) || (key == NULL))
+    {
+        LogError("invalid arg (NULL) passed to IoTHubMessage_GetProperty");
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUBMESSAGE_11_029: [ IoTHubMessage_GetProperty shall get the property table as IoTHubMessage_GetPropertyTable does, and return NULL if that fails. ]*/
+    else if (IoTHubMessage_GetPropertyTable(iotHubMessageHandle, &properties, &count) != IOTHUB_MESSAGE_OK)
+    {
+        LogError("unable to get the property table");
+        result = NULL;
+    }
+    else if (count == 0)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_11_030: [ IoTHubMessage_GetProperty shall look key up in the index of the property table and return its value, or NULL if the message does not have it. ]*/
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_11_030: [ IoTHubMessage_GetProperty shall look key up in the index of the property table and return its value, or NULL if the message does not have it. ]*/
+        const PROPERTY_TABLE* table = ((IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle)->properties->table;
+        size_t keyLength = strlen(key);
+        size_t slot;
+        size_t position = FindPropertyEntry(table, key, keyLength, HashPropertyKey(key, keyLength), &slot);
+        result = (position == table->count) ? NULL : table->entries[position].value;
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetProperties(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const IOTHUB_MESSAGE_PROPERTY* properties, size_t count)
+{
+    IOTHUB_MESSAGE_RESULT result;
+    /*Codes_SRS_IOTHUBMESSAGE_11_031: [ If iotHubMessageHandle is NULL, or properties is NULL and count is not 0, IoTHubMessage_SetProperties shall return IOTHUB_MESSAGE_INVALID_ARG. ]*/
+    if ((iotHubMessageHandle == NULL) || ((properties == NULL) && (count != 0)))
+    {
+        LogError("invalid arg passed to IoTHubMessage_SetProperties");
+        result = IOTHUB_MESSAGE_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_MESSAGE_HANDLE_DATA* handleData = (IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle;
+        size_t stringsSize = 0;
+        size_t index;
+        result = IOTHUB_MESSAGE_OK;
+        for (index = 0; index < count; index++)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_11_032: [ If a key or a value is NULL or has a character that is not printable US-ASCII, IoTHubMessage_SetProperties shall return IOTHUB_MESSAGE_INVALID_ARG and leave the properties unchanged. ]*/
+            if ((properties[index].key == NULL) || (properties[index].value == NULL) ||
+                !ContainsOnlyUsAsciiWithLength(properties[index].key, properties[index].keyLength) ||
+                !ContainsOnlyUsAsciiWithLength(properties[index].value, properties[index].valueLength))
+            {
+                LogError("invalid property at index %lu", (unsigned long)index);
+                result = IOTHUB_MESSAGE_INVALID_ARG;
+                break;
+            }
+            stringsSize += properties[index].keyLength + properties[index].valueLength + 2;
+        }
+
+        if (result == IOTHUB_MESSAGE_OK)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_11_033: [ IoTHubMessage_SetProperties shall copy the properties in a new property table in a single allocation, a key given more than once getting its last value. ]*/
+            PROPERTY_TABLE* table = CreatePropertyTable(count, stringsSize);
+            MESSAGE_PROPERTIES* replacement;
+            if (table == NULL)
+            {
+                /*Codes_SRS_IOTHUBMESSAGE_11_034: [ If any allocation fails, IoTHubMessage_SetProperties shall return IOTHUB_MESSAGE_ERROR and leave the properties unchanged. ]*/
+                LogError("unable to create the property table");
+                result = IOTHUB_MESSAGE_ERROR;
+            }
+            else
+            {
+                for (index = 0; index < count; index++)
+                {
+                    AddPropertyEntry(table, properties[index].key, properties[index].keyLength, properties[index].value, properties[index].valueLength);
+                }
+
+                if ((replacement = CreateProperties(handleData, NULL, table)) == NULL)
+                {
+                    /*Codes_SRS_IOTHUBMESSAGE_11_034: [ If any allocation fails, IoTHubMessage_SetProperties shall return IOTHUB_MESSAGE_ERROR and leave the properties unchanged. ]*/
+                    LogError("unable to create the properties");
+                    free(table);
+                    result = IOTHUB_MESSAGE_ERROR;
+                }
+                else
+                {
+                    /*Codes_SRS_IOTHUBMESSAGE_11_035: [ IoTHubMessage_SetProperties shall replace all the properties of the message, without changing those of the messages it shares them with, and return IOTHUB_MESSAGE_OK. ]*/
+                    ReleaseProperties(handleData->properties);
+                    handleData->properties = replacement;
+                }
+            }
+        }
     }
     return result;
 }
@@ -472,13 +1094,7 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetCorrelationId(IOTHUB_MESSAGE_HANDLE iotHu
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
         /* Codes_SRS_IOTHUBMESSAGE_07_019: [If the IOTHUB_MESSAGE_HANDLE correlationId is not NULL, then the IOTHUB_MESSAGE_HANDLE correlationId will be deallocated.] */
-        if (handleData->correlationId != NULL)
-        {
-            free(handleData->correlationId);
-            handleData->correlationId = NULL;
-        }
-
-        if (mallocAndStrcpy_s(&handleData->correlationId, correlationId) != 0)
+        if (SetMessageString(handleData, &handleData->correlationId, correlationId) != 0)
         {
             /* Codes_SRS_IOTHUBMESSAGE_07_020: [If the allocation or the copying of the correlationId fails, then IoTHubMessage_SetCorrelationId shall return IOTHUB_MESSAGE_ERROR.] */
             result = IOTHUB_MESSAGE_ERROR;
@@ -505,14 +1121,8 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetMessageId(IOTHUB_MESSAGE_HANDLE iotHubMes
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
         /* Codes_SRS_IOTHUBMESSAGE_07_013: [If the IOTHUB_MESSAGE_HANDLE messageId is not NULL, then the IOTHUB_MESSAGE_HANDLE messageId will be freed] */
-        if (handleData->messageId != NULL)
-        {
-            free(handleData->messageId);
-            handleData->messageId = NULL;
-        }
-
         /* Codes_SRS_IOTHUBMESSAGE_07_014: [If the allocation or the copying of the messageId fails, then IoTHubMessage_SetMessageId shall return IOTHUB_MESSAGE_ERROR.] */
-        if (mallocAndStrcpy_s(&handleData->messageId, messageId) != 0)
+        if (SetMessageString(handleData, &handleData->messageId, messageId) != 0)
         {
             result = IOTHUB_MESSAGE_ERROR;
         }
@@ -557,13 +1167,7 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentTypeSystemProperty(IOTHUB_MESSAGE_
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = (IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle;
 
         // Codes_SRS_IOTHUBMESSAGE_09_002: [If the IOTHUB_MESSAGE_HANDLE `contentType` is not NULL it shall be deallocated.] 
-        if (handleData->userDefinedContentType != NULL)
-        {
-            free(handleData->userDefinedContentType);
-            handleData->userDefinedContentType = NULL;
-        }
-
-        if (mallocAndStrcpy_s(&handleData->userDefinedContentType, contentType) != 0)
+        if (SetMessageString(handleData, &handleData->userDefinedContentType, contentType) != 0)
         {
             LogError("Failed saving a copy of contentType");
             // Codes_SRS_IOTHUBMESSAGE_09_003: [If the allocation or the copying of `contentType` fails, then IoTHubMessage_SetContentTypeSystemProperty shall return IOTHUB_MESSAGE_ERROR.] 
@@ -615,13 +1219,7 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentEncodingSystemProperty(IOTHUB_MESS
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = (IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle;
 
         // Codes_SRS_IOTHUBMESSAGE_09_007: [If the IOTHUB_MESSAGE_HANDLE `contentEncoding` is not NULL it shall be deallocated.] 
-        if (handleData->contentEncoding != NULL)
-        {
-            free(handleData->contentEncoding);
-            handleData->contentEncoding = NULL;
-        }
-
-        if (mallocAndStrcpy_s(&handleData->contentEncoding, contentEncoding) != 0)
+        if (SetMessageString(handleData, &handleData->contentEncoding, contentEncoding) != 0)
         {
             LogError("Failed saving a copy of contentEncoding");
             // Codes_SRS_IOTHUBMESSAGE_09_008: [If the allocation or the copying of `contentEncoding` fails, then IoTHubMessage_SetContentEncodingSystemProperty shall return IOTHUB_MESSAGE_ERROR.]
@@ -692,21 +1290,20 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetDiagnosticPropertyData(IOTHUB_MESSAGE_HAN
     }
     else
     {
-        // Codes_SRS_IOTHUBMESSAGE_10_004: [If the IOTHUB_MESSAGE_HANDLE `diagnosticData` is not NULL it shall be deallocated.] 
-        if (iotHubMessageHandle->diagnosticData != NULL)
-        {
-            DestroyDiagnosticPropertyData(iotHubMessageHandle->diagnosticData);
-            iotHubMessageHandle->diagnosticData = NULL;
-        }
+        IOTHUB_MESSAGE_HANDLE_DATA* handleData = (IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle;
 
+        // Codes_SRS_IOTHUBMESSAGE_10_004: [If the IOTHUB_MESSAGE_HANDLE `diagnosticData` is not NULL it shall be deallocated.] 
         // Codes_SRS_IOTHUBMESSAGE_10_005: [If the allocation or the copying of `diagnosticData` fails, then IoTHubMessage_SetDiagnosticPropertyData shall return IOTHUB_MESSAGE_ERROR.]
-        if ((iotHubMessageHandle->diagnosticData = CloneDiagnosticPropertyData(diagnosticData)) == NULL)
+        if ((SetMessageString(handleData, &handleData->diagnosticStorage.diagnosticId, diagnosticData->diagnosticId) != 0) ||
+            (SetMessageString(handleData, &handleData->diagnosticStorage.diagnosticCreationTimeUtc, diagnosticData->diagnosticCreationTimeUtc) != 0))
         {
             LogError("Failed saving a copy of diagnosticData");
+            DestroyDiagnosticPropertyData(handleData);
             result = IOTHUB_MESSAGE_ERROR;
         }
         else
         {
+            handleData->diagnosticData = &handleData->diagnosticStorage;
             // Codes_SRS_IOTHUBMESSAGE_10_006: [If IoTHubMessage_SetDiagnosticPropertyData finishes successfully it shall return IOTHUB_MESSAGE_OK.]
             result = IOTHUB_MESSAGE_OK;
         }
@@ -11,15 +11,24 @@
 #include "iothub_client_private.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/vector.h"
 
+#define WORKER_THREAD_MIN_IDLE_WAIT_MS      1
+#define WORKER_THREAD_MAX_IDLE_WAIT_LIMIT_MS 1000
+
 typedef struct TRANSPORT_HANDLE_DATA_TAG
 {
     TRANSPORT_LL_HANDLE transportLLHandle;
     THREAD_HANDLE workerThreadHandle;
     LOCK_HANDLE lockHandle;
     sig_atomic_t stopThread;
+    COND_HANDLE workCondition;          /*signaled when one of the clients queues work for the worker thread*/
+    LOCK_HANDLE wakeLockHandle;         /*the worker waits on workCondition with it, it is never held during DoWork so signaling never blocks on I/O*/
+    sig_atomic_t workPending;
+    unsigned int idleWaitMs;
+    unsigned int maxIdleWaitMs;
     TRANSPORT_PROVIDER_FIELDS;
     VECTOR_HANDLE clients;
     LOCK_HANDLE clientsLockHandle;
@@ -116,6 +125,11 @@ TRANSPORT_HANDLE  IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protoc
                         result->stopThread = 1;
                         result->clientDoWork = NULL;
                         result->workerThreadHandle = NULL; /* create thread when work needs to be done */
+                        result->workCondition = NULL; /* created together with the thread */
+                        result->wakeLockHandle = NULL;
+                        result->workPending = 0;
+                        result->idleWaitMs = WORKER_THREAD_MIN_IDLE_WAIT_MS;
+                        result->maxIdleWaitMs = WORKER_THREAD_MIN_IDLE_WAIT_MS;
                         result->IoTHubTransport_GetHostname = transportProtocol->IoTHubTransport_GetHostname;
                         result->IoTHubTransport_SetOption = transportProtocol->IoTHubTransport_SetOption;
                         result->IoTHubTransport_Create = transportProtocol->IoTHubTransport_Create;
@@ -165,6 +179,30 @@ static void multiplexed_client_do_work(TRANSPORT_HANDLE_DATA* transportData)
     }
 }
 
+static void wait_for_work(TRANSPORT_HANDLE_DATA* transportData)
+{
+    if (Lock(transportData->wakeLockHandle) != LOCK_OK)
+    {
+        LogError("failed to lock for wait_for_work");
+        (void)ThreadAPI_Sleep(WORKER_THREAD_MIN_IDLE_WAIT_MS);
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_11_001: [ If work was signaled or the thread was asked to stop since the last call to the lower layer transport DoWork, the thread shall not wait and its idle wait shall be reset to 1 ms. ]*/
+        if (transportData->stopThread || transportData->workPending)
+        {
+            transportData->idleWaitMs = WORKER_THREAD_MIN_IDLE_WAIT_MS;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBTRANSPORT_11_002: [ Otherwise the thread shall wait on its condition for the current idle wait, which doubles each time up to the value set with IoTHubTransport_SetWorkerMaxIdleWait. ]*/
+            (void)Condition_Wait(transportData->workCondition, transportData->wakeLockHandle, (int)transportData->idleWaitMs);
+            transportData->idleWaitMs = (transportData->idleWaitMs >= transportData->maxIdleWaitMs / 2) ? transportData->maxIdleWaitMs : transportData->idleWaitMs * 2;
+        }
+        (void)Unlock(transportData->wakeLockHandle);
+    }
+}
+
 static int transport_worker_thread(void* threadArgument)
 {
     TRANSPORT_HANDLE_DATA* transportData = (TRANSPORT_HANDLE_DATA*)threadArgument;
@@ -183,6 +221,7 @@ static int transport_worker_thread(void* threadArgument)
             }
             else
             {
+                transportData->workPending = 0;
                 (transportData->IoTHubTransport_DoWork)(transportData->transportLLHandle, NULL);
 
                 (void)Unlock(transportData->lockHandle);
@@ -191,8 +230,8 @@ static int transport_worker_thread(void* threadArgument)
 
         multiplexed_client_do_work(transportData);
 
-        /*Codes_SRS_IOTHUBTRANSPORT_17_029: [ The thread shall call lower layer transport DoWork every 1 ms. ]*/
-        ThreadAPI_Sleep(1);
+        /*Codes_SRS_IOTHUBTRANSPORT_17_029: [ The thread shall call lower layer transport DoWork repeatedly, waiting between calls as described by SRS_IOTHUBTRANSPORT_11_001 and SRS_IOTHUBTRANSPORT_11_002. ]*/
+        wait_for_work(transportData);
     }
 
     ThreadAPI_Exit(0);
@@ -214,7 +253,20 @@ static IOTHUB_CLIENT_RESULT start_worker_if_needed(TRANSPORT_HANDLE_DATA * trans
     {
         /*Codes_SRS_IOTHUBTRANSPORT_17_018: [ If the worker thread does not exist, IoTHubTransport_StartWorkerThread shall start the thread using ThreadAPI_Create. ]*/
         transportData->stopThread = 0;
-        if (ThreadAPI_Create(&transportData->workerThreadHandle, transport_worker_thread, transportData) != THREADAPI_OK)
+        transportData->workPending = 0;
+        /*Codes_SRS_IOTHUBTRANSPORT_11_003: [ Before starting the worker thread, IoTHubTransport_StartWorkerThread shall create the condition the thread waits on by calling Condition_Init. ]*/
+        if (transportData->workCondition == NULL &&
+            (transportData->workCondition = Condition_Init()) == NULL)
+        {
+            LogError("Condition_Init failed");
+        }
+        /*Codes_SRS_IOTHUBTRANSPORT_11_009: [ IoTHubTransport_StartWorkerThread shall also create the lock the thread waits with by calling Lock_Init; the thread shall never hold it while it calls the lower layer transport DoWork. ]*/
+        else if (transportData->wakeLockHandle == NULL &&
+            (transportData->wakeLockHandle = Lock_Init()) == NULL)
+        {
+            LogError("Lock_Init failed");
+        }
+        else if (ThreadAPI_Create(&transportData->workerThreadHandle, transport_worker_thread, transportData) != THREADAPI_OK)
         {
             transportData->workerThreadHandle = NULL;
         }
@@ -262,10 +314,32 @@ static IOTHUB_CLIENT_RESULT start_worker_if_needed(TRANSPORT_HANDLE_DATA * trans
     return result;
 }
 
+/*the worker checks workPending and stopThread under wakeLockHandle before waiting, so setting them before posting under it cannot lose the wake up*/
+static void post_work_condition(TRANSPORT_HANDLE_DATA * transportData)
+{
+    if (transportData->workCondition != NULL && transportData->wakeLockHandle != NULL)
+    {
+        if (Lock(transportData->wakeLockHandle) != LOCK_OK)
+        {
+            LogError("failed to lock for post_work_condition, the worker thread will pick the work up after its idle wait");
+        }
+        else
+        {
+            if (Condition_Post(transportData->workCondition) != COND_OK)
+            {
+                LogError("Condition_Post failed, the worker thread will pick the work up after its idle wait");
+            }
+            (void)Unlock(transportData->wakeLockHandle);
+        }
+    }
+}
+
+/*must be called with lockHandle held: the worker checks stopThread under it before calling DoWork*/
 static void stop_worker_thread(TRANSPORT_HANDLE_DATA * transportData)
 {
     /*Codes_SRS_IOTHUBTRANSPORT_17_043: [** IoTHubTransport_SignalEndWorkerThread shall signal the worker thread to end.*/
     transportData->stopThread = 1;
+    post_work_condition(transportData);
 }
 
 static void wait_worker_thread(TRANSPORT_HANDLE_DATA * transportData)
@@ -307,7 +381,17 @@ static bool signal_end_worker_thread(TRANSPORT_HANDLE_DATA * transportData, IOTH
         {
             if (VECTOR_size(transportData->clients) == 0)
             {
-                stop_worker_thread(transportData);
+                /*Codes_SRS_IOTHUBTRANSPORT_11_008: [ IoTHubTransport_SignalEndWorkerThread shall hold the transport lock while it signals the worker thread to end. ]*/
+                if (Lock(transportData->lockHandle) != LOCK_OK)
+                {
+                    LogError("failed to lock for stop_worker_thread, the worker thread may only stop after its idle wait");
+                    stop_worker_thread(transportData);
+                }
+                else
+                {
+                    stop_worker_thread(transportData);
+                    (void)Unlock(transportData->lockHandle);
+                }
                 okToJoin = true;
             }
             else
@@ -351,6 +435,14 @@ void IoTHubTransport_Destroy(TRANSPORT_HANDLE transportHandle)
         (transportData->IoTHubTransport_Destroy)(transportData->transportLLHandle);
         VECTOR_destroy(transportData->clients);
         Lock_Deinit(transportData->clientsLockHandle);
+        if (transportData->workCondition != NULL)
+        {
+            Condition_Deinit(transportData->workCondition);
+        }
+        if (transportData->wakeLockHandle != NULL)
+        {
+            Lock_Deinit(transportData->wakeLockHandle);
+        }
         free(transportHandle);
     }
 }
@@ -449,3 +541,35 @@ void IoTHubTransport_JoinWorkerThread(TRANSPORT_HANDLE transportHandle, IOTHUB_C
         wait_worker_thread(transportData);
     }
 }
+
+void IoTHubTransport_SignalWorkerThread(TRANSPORT_HANDLE transportHandle)
+{
+    /*Codes_SRS_IOTHUBTRANSPORT_11_004: [ If transportHandle is NULL, IoTHubTransport_SignalWorkerThread shall do nothing. ]*/
+    if (transportHandle != NULL)
+    {
+        TRANSPORT_HANDLE_DATA * transportData = (TRANSPORT_HANDLE_DATA*)transportHandle;
+        /*Codes_SRS_IOTHUBTRANSPORT_11_005: [ IoTHubTransport_SignalWorkerThread shall mark work as pending and, if the worker thread was started, call Condition_Post to wake it. ]*/
+        /*Codes_SRS_IOTHUBTRANSPORT_11_010: [ IoTHubTransport_SignalWorkerThread shall not take the transport lock; it shall call Condition_Post while holding the lock the worker thread waits with. ]*/
+        transportData->workPending = 1;
+        post_work_condition(transportData);
+    }
+}
+
+IOTHUB_CLIENT_RESULT IoTHubTransport_SetWorkerMaxIdleWait(TRANSPORT_HANDLE transportHandle, unsigned int maxIdleWaitMs)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBTRANSPORT_11_006: [ If transportHandle is NULL, or maxIdleWaitMs is 0 or greater than 1000, IoTHubTransport_SetWorkerMaxIdleWait shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (transportHandle == NULL || maxIdleWaitMs < WORKER_THREAD_MIN_IDLE_WAIT_MS || maxIdleWaitMs > WORKER_THREAD_MAX_IDLE_WAIT_LIMIT_MS)
+    {
+        LogError("Invalid argument, transportHandle [%p], maxIdleWaitMs [%u].", transportHandle, maxIdleWaitMs);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        TRANSPORT_HANDLE_DATA * transportData = (TRANSPORT_HANDLE_DATA*)transportHandle;
+        /*Codes_SRS_IOTHUBTRANSPORT_11_007: [ IoTHubTransport_SetWorkerMaxIdleWait shall store the maximum idle wait of the worker thread and return IOTHUB_CLIENT_OK. ]*/
+        transportData->maxIdleWaitMs = maxIdleWaitMs;
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
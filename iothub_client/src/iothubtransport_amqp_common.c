@@ -110,6 +110,9 @@ typedef struct AMQP_TRANSPORT_INSTANCE_TAG
     size_t option_sas_token_refresh_time_secs;                          // Device-specific option.
     size_t option_cbs_request_timeout_secs;                             // Device-specific option.
     size_t option_send_event_timeout_secs;                              // Device-specific option.
+    size_t option_batch_linger_ms;                                      // Device-specific option.
+    size_t option_batch_max_bytes;                                      // Device-specific option.
+    size_t option_batch_max_messages;                                   // Device-specific option.
 
                                                                         // Auth module used to generating handle authorization
     IOTHUB_AUTHORIZATION_HANDLE authorization_module;                   // with either SAS Token, x509 Certs, and Device SAS Token
@@ -1190,6 +1193,30 @@ static int replicate_device_options_to(AMQP_TRANSPORT_DEVICE_INSTANCE* dev_insta
         LogError("Failed to apply option DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS to device '%s' (device_set_option failed)", STRING_c_str(dev_instance->device_id));
         result = __FAILURE__;
     }
+    else if (device_set_option(
+        dev_instance->device_handle,
+        DEVICE_OPTION_BATCH_LINGER_MS,
+        &dev_instance->transport_instance->option_batch_linger_ms) != RESULT_OK)
+    {
+        LogError("Failed to apply option DEVICE_OPTION_BATCH_LINGER_MS to device '%s' (device_set_option failed)", STRING_c_str(dev_instance->device_id));
+        result = __FAILURE__;
+    }
+    else if (device_set_option(
+        dev_instance->device_handle,
+        DEVICE_OPTION_BATCH_MAX_BYTES,
+        &dev_instance->transport_instance->option_batch_max_bytes) != RESULT_OK)
+    {
+        LogError("Failed to apply option DEVICE_OPTION_BATCH_MAX_BYTES to device '%s' (device_set_option failed)", STRING_c_str(dev_instance->device_id));
+        result = __FAILURE__;
+    }
+    else if (device_set_option(
+        dev_instance->device_handle,
+        DEVICE_OPTION_BATCH_MAX_MESSAGES,
+        &dev_instance->transport_instance->option_batch_max_messages) != RESULT_OK)
+    {
+        LogError("Failed to apply option DEVICE_OPTION_BATCH_MAX_MESSAGES to device '%s' (device_set_option failed)", STRING_c_str(dev_instance->device_id));
+        result = __FAILURE__;
+    }
     else if (auth_mode == DEVICE_AUTH_MODE_CBS)
     {
         if (device_set_option(
@@ -1251,6 +1278,18 @@ static const char* get_device_option_name_from(const char* iothubclient_option_n
     {
         device_option_name = DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS;
     }
+    else if (strcmp(OPTION_AMQP_BATCH_LINGER_MS, iothubclient_option_name) == 0)
+    {
+        device_option_name = DEVICE_OPTION_BATCH_LINGER_MS;
+    }
+    else if (strcmp(OPTION_AMQP_BATCH_MAX_BYTES, iothubclient_option_name) == 0)
+    {
+        device_option_name = DEVICE_OPTION_BATCH_MAX_BYTES;
+    }
+    else if (strcmp(OPTION_AMQP_BATCH_MAX_MESSAGES, iothubclient_option_name) == 0)
+    {
+        device_option_name = DEVICE_OPTION_BATCH_MAX_MESSAGES;
+    }
     else
     {
         device_option_name = NULL;
@@ -1929,6 +1968,21 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SetOption(TRANSPORT_LL_HANDLE h
             is_device_specific_option = true;
             transport_instance->option_send_event_timeout_secs = *(size_t*)value;
         }
+        else if (strcmp(OPTION_AMQP_BATCH_LINGER_MS, option) == 0)
+        {
+            is_device_specific_option = true;
+            transport_instance->option_batch_linger_ms = *(size_t*)value;
+        }
+        else if (strcmp(OPTION_AMQP_BATCH_MAX_BYTES, option) == 0)
+        {
+            is_device_specific_option = true;
+            transport_instance->option_batch_max_bytes = *(size_t*)value;
+        }
+        else if (strcmp(OPTION_AMQP_BATCH_MAX_MESSAGES, option) == 0)
+        {
+            is_device_specific_option = true;
+            transport_instance->option_batch_max_messages = *(size_t*)value;
+        }
         else
         {
             is_device_specific_option = false;
@@ -616,6 +616,34 @@ static int create_twin_messenger(DEVICE_INSTANCE* instance)
 
 // ---------- Set/Retrieve Options Helpers ----------//
 
+// @brief
+//     Translates the batching option names supported by the device to the ones supported by the telemetry messenger.
+// @returns
+//     The messenger option name, or NULL if `name` is not a batching option.
+static const char* get_messenger_batching_option_name(const char* name)
+{
+    const char* result;
+
+    if (strcmp(DEVICE_OPTION_BATCH_LINGER_MS, name) == 0)
+    {
+        result = MESSENGER_OPTION_BATCH_LINGER_MS;
+    }
+    else if (strcmp(DEVICE_OPTION_BATCH_MAX_BYTES, name) == 0)
+    {
+        result = MESSENGER_OPTION_BATCH_MAX_BYTES;
+    }
+    else if (strcmp(DEVICE_OPTION_BATCH_MAX_MESSAGES, name) == 0)
+    {
+        result = MESSENGER_OPTION_BATCH_MAX_MESSAGES;
+    }
+    else
+    {
+        result = NULL;
+    }
+
+    return result;
+}
+
 static void* device_clone_option(const char* name, const void* value)
 {
     void* result;
@@ -1377,6 +1405,7 @@ int device_set_option(DEVICE_HANDLE handle, const char* name, void* value)
     else
     {
         DEVICE_INSTANCE* instance = (DEVICE_INSTANCE*)handle;
+        const char* messenger_option_name;
 
         if (strcmp(DEVICE_OPTION_CBS_REQUEST_TIMEOUT_SECS, name) == 0 ||
             strcmp(DEVICE_OPTION_SAS_TOKEN_REFRESH_TIME_SECS, name) == 0 ||
@@ -1414,6 +1443,20 @@ int device_set_option(DEVICE_HANDLE handle, const char* name, void* value)
                 result = RESULT_OK;
             }
         }
+        // Codes_SRS_DEVICE_11_001: [If `name` is DEVICE_OPTION_BATCH_LINGER_MS, DEVICE_OPTION_BATCH_MAX_BYTES or DEVICE_OPTION_BATCH_MAX_MESSAGES, `value` shall be passed to telemetry_messenger_set_option as the matching MESSENGER_OPTION_BATCH_* option]
+        else if ((messenger_option_name = get_messenger_batching_option_name(name)) != NULL)
+        {
+            if (telemetry_messenger_set_option(instance->messenger_handle, messenger_option_name, value) != RESULT_OK)
+            {
+                // Codes_SRS_DEVICE_09_087: [If telemetry_messenger_set_option fails, device_set_option shall return a non-zero result]
+                LogError("failed setting option for device '%s' (failed setting messenger option '%s')", instance->config->device_id, name);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = RESULT_OK;
+            }
+        }
         else if (strcmp(DEVICE_OPTION_SAVED_AUTH_OPTIONS, name) == 0)
         {
             // Codes_SRS_DEVICE_09_088: [If `name` is DEVICE_OPTION_SAVED_AUTH_OPTIONS but CBS authentication is not being used, device_set_option shall return a non-zero result]
@@ -7,6 +7,7 @@
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/agenttime.h" 
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/uniqueid.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
@@ -37,6 +38,7 @@
 #define STRING_NULL_TERMINATOR                          '\0'
 
 #define AMQP_BATCHING_FORMAT_CODE 0x80013700
+#define MESSAGE_SECTIONS_CACHE_SIZE 8
  
 typedef struct TELEMETRY_MESSENGER_INSTANCE_TAG
 {
@@ -64,9 +66,22 @@ typedef struct TELEMETRY_MESSENGER_INSTANCE_TAG
     MESSAGE_RECEIVER_STATE message_receiver_current_state;
     MESSAGE_RECEIVER_STATE message_receiver_previous_state;
 
+    uint64_t max_batch_message_size;    // Queried once per sender_link; 0 until then.
+    unsigned char* encode_buffer;       // Each message of a batch is encoded here, then appended to the batch.
+    size_t encode_buffer_size;
+    MESSAGE_SECTIONS_CACHE_HANDLE sections_cache;   // Encoded properties sections of recent messages, reused by the ones that repeat them.
+
     size_t event_send_retry_limit;
     size_t event_send_error_count;
     size_t event_send_timeout_secs;
+
+    size_t batch_linger_ms;                 // 0 sends the waiting events on every do_work.
+    size_t batch_max_bytes;                 // 0 leaves the size of a batch to the link maximum.
+    size_t batch_max_messages;              // 0 for no limit.
+    TICK_COUNTER_HANDLE linger_tick_counter;    // Created the first time batch_linger_ms is set above 0.
+    tickcounter_ms_t linger_start_ms;       // When the events being held were first seen.
+    size_t held_event_count;                // Number of events held on the last do_work; 0 if none were.
+
     time_t last_message_sender_state_change_time;
     time_t last_message_receiver_state_change_time;
 } TELEMETRY_MESSENGER_INSTANCE;
@@ -355,6 +370,16 @@ static void destroy_event_sender(TELEMETRY_MESSENGER_INSTANCE* instance)
         link_destroy(instance->sender_link);
         instance->sender_link = NULL;
     }
+
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_003: [The encode buffer and the maximum message size of the link shall be released along with `instance->sender_link`.]
+    if (instance->encode_buffer != NULL)
+    {
+        free(instance->encode_buffer);
+        instance->encode_buffer = NULL;
+    }
+
+    instance->encode_buffer_size = 0;
+    instance->max_batch_message_size = 0;
 }
 
 static void on_event_sender_state_changed_callback(void* context, MESSAGE_SENDER_STATE new_state, MESSAGE_SENDER_STATE previous_state)
@@ -1088,6 +1113,7 @@ typedef struct SEND_PENDING_EVENTS_STATE_TAG
     MESSENGER_SEND_EVENT_TASK* task;
     MESSAGE_HANDLE message_batch_container;
     uint64_t bytes_pending;
+    size_t messages_pending;
 } SEND_PENDING_EVENTS_STATE;
 
 
@@ -1148,11 +1174,17 @@ static int send_batched_message_and_reset_state(TELEMETRY_MESSENGER_INSTANCE* in
 }
 
 // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_196: [Determine the maximum message size we can send over this link from AMQP, then remove AMQP_BATCHING_RESERVE_SIZE (1024) bytes as reserve buffer.]          
+// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_001: [The maximum message size shall be queried once per `instance->sender_link` and kept until the link is destroyed.]
 static int get_max_message_size_for_batching(TELEMETRY_MESSENGER_INSTANCE* instance, uint64_t* max_messagesize)
 {
     int result;
 
-    if (link_get_peer_max_message_size(instance->sender_link, max_messagesize) != 0)
+    if (instance->max_batch_message_size != 0)
+    {
+        *max_messagesize = instance->max_batch_message_size;
+        result = 0;
+    }
+    else if (link_get_peer_max_message_size(instance->sender_link, max_messagesize) != 0)
     {
         LogError("link_get_peer_max_message_size failed");
         result = __FAILURE__;
@@ -1160,28 +1192,84 @@ static int get_max_message_size_for_batching(TELEMETRY_MESSENGER_INSTANCE* insta
     // Reserve AMQP_BATCHING_RESERVE_SIZE bytes for AMQP overhead of the "main" message itself.
     else if (*max_messagesize <= AMQP_BATCHING_RESERVE_SIZE)
     {
-        LogError("link_get_peer_max_message_size (%d) is less than the reserve size (%d)", max_messagesize, AMQP_BATCHING_RESERVE_SIZE);
+        LogError("link_get_peer_max_message_size (%llu) is less than the reserve size (%d)", (unsigned long long)*max_messagesize, AMQP_BATCHING_RESERVE_SIZE);
         result = __FAILURE__;
     }
     else
     {
         *max_messagesize -= AMQP_BATCHING_RESERVE_SIZE;
+        instance->max_batch_message_size = *max_messagesize;
         result = 0;
     }
 
     return result;
 }
 
+// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_002: [If a message does not fit in the encode buffer, the buffer shall be replaced by one of at least twice its size, up to the maximum message size, and the message encoded again.]
+static int grow_encode_buffer(TELEMETRY_MESSENGER_INSTANCE* instance, size_t needed_size, uint64_t max_messagesize)
+{
+    int result;
+    size_t new_size = instance->encode_buffer_size * 2;
+
+    if (new_size < needed_size)
+    {
+        new_size = needed_size;
+    }
+
+    if (new_size > max_messagesize)
+    {
+        new_size = (size_t)max_messagesize;
+    }
+
+    // The previous contents are not needed, so free before allocating to keep the peak memory down.
+    if (instance->encode_buffer != NULL)
+    {
+        free(instance->encode_buffer);
+    }
+
+    if ((instance->encode_buffer = (unsigned char*)malloc(new_size)) == NULL)
+    {
+        LogError("failed allocating an encode buffer of %lu bytes", (unsigned long)new_size);
+        instance->encode_buffer_size = 0;
+        result = __FAILURE__;
+    }
+    else
+    {
+        instance->encode_buffer_size = new_size;
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_005: [If `instance->batch_max_bytes` is not zero and is below the maximum message size, it shall be used as the maximum size of a batch instead.]
+static uint64_t get_batch_size_limit(TELEMETRY_MESSENGER_INSTANCE* instance, uint64_t max_messagesize)
+{
+    uint64_t result;
+
+    if (instance->batch_max_bytes != 0 && instance->batch_max_bytes < max_messagesize)
+    {
+        result = instance->batch_max_bytes;
+    }
+    else
+    {
+        result = max_messagesize;
+    }
+
+    return result;
+}
+
 static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
 {
     int result = RESULT_OK;
 
     MESSENGER_SEND_EVENT_CALLER_INFORMATION* caller_info;
     BINARY_DATA body_binary_data;
+    size_t encode_capacity;
+    size_t encoded_length;
 
     SEND_PENDING_EVENTS_STATE send_pending_events_state;
     memset(&send_pending_events_state, 0, sizeof(send_pending_events_state));
-    memset(&body_binary_data, 0, sizeof(body_binary_data));
 
     uint64_t max_messagesize = 0;
 
@@ -1190,13 +1278,8 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_199: [Errors specific to a message (e.g. failure to encode) are NOT fatal but we'll keep processing.  More general errors (e.g. out of memory) will stop processing.]
     while ((caller_info = get_next_caller_message_to_send(instance)) != NULL)
     {
-        if (body_binary_data.bytes != NULL)
-        {
-            // Free here as this may have been set during previous run through loop.
-            free((unsigned char*)body_binary_data.bytes);
-        }
-        memset(&body_binary_data, 0, sizeof(body_binary_data));
-    
+        encode_capacity = instance->encode_buffer_size;
+
         if ((0 == max_messagesize) && (get_max_message_size_for_batching(instance, &max_messagesize)) != 0)
         {
             LogError("get_max_message_size_for_batching failed");
@@ -1214,20 +1297,39 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
             break;
         }
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_200: [Retrieve an AMQP encoded representation of this message for later appending to main batched message.  On error, invoke callback but continue send loop; this is NOT a fatal error.]
-        else if (message_create_uamqp_encoding_from_iothub_message(send_pending_events_state.message_batch_container, caller_info->message->messageHandle, &body_binary_data) != RESULT_OK)
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_004: [The message shall be encoded directly into the encode buffer, which is reused for every message sent over the link.]
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_015: [The message shall be encoded using `instance->sections_cache`.]
+        else if (message_encode_uamqp_from_iothub_message(send_pending_events_state.message_batch_container, caller_info->message->messageHandle, instance->sections_cache, instance->encode_buffer, instance->encode_buffer_size, &encoded_length) != RESULT_OK)
         {
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_201: [If message_create_uamqp_encoding_from_iothub_message fails, invoke callback with TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE]
-            LogError("message_create_uamqp_encoding_from_iothub_message() failed.  Will continue to try to process messages, result");
+            LogError("message_encode_uamqp_from_iothub_message() failed.  Will continue to try to process messages, result");
             invoke_callback_on_error(caller_info, TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE);
             free(caller_info);
             continue;
         }
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_197: [If a single message is greater than our maximum AMQP send size, ignore the message.  Invoke the callback but continue send loop; this is NOT a fatal error.]
-        else if (body_binary_data.length > (int)max_messagesize)
+        else if (encoded_length > max_messagesize)
+        {
+            LogError("a single message will encode to be %lu bytes, larger than max we will send the link %llu.  Will continue to try to process messages", (unsigned long)encoded_length, (unsigned long long)max_messagesize);
+            invoke_callback_on_error(caller_info, TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING);
+            free(caller_info);
+            continue;
+        }
+        else if ((encoded_length > encode_capacity) && (grow_encode_buffer(instance, encoded_length, max_messagesize) != RESULT_OK))
         {
-            LogError("a single message will encode to be %d bytes, larger than max we will send the link %lld.  Will continue to try to process messages", body_binary_data.length, max_messagesize);
+            LogError("grow_encode_buffer failed");
             invoke_callback_on_error(caller_info, TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING);
             free(caller_info);
+            result = __FAILURE__;
+            break;
+        }
+        // The message is only encoded a second time when it did not fit in the encode buffer, which stops happening once the buffer has grown.
+        else if ((encoded_length > encode_capacity) &&
+            (message_encode_uamqp_from_iothub_message(send_pending_events_state.message_batch_container, caller_info->message->messageHandle, instance->sections_cache, instance->encode_buffer, instance->encode_buffer_size, &encoded_length) != RESULT_OK))
+        {
+            LogError("message_encode_uamqp_from_iothub_message() failed.  Will continue to try to process messages, result");
+            invoke_callback_on_error(caller_info, TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE);
+            free(caller_info);
             continue;
         }
         else if (singlylinkedlist_add(send_pending_events_state.task->callback_list, (void*)caller_info) == NULL)
@@ -1244,7 +1346,10 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
         // Similarly, responsibility for freeing this memory falls on the 'task' cleanup also.
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_193: [If (length of current user AMQP message) + (length of user messages pending for this batched message) + (1KB reserve buffer) > maximum link send, send pending messages and create new batched message.]
-        if (body_binary_data.length + send_pending_events_state.bytes_pending > max_messagesize)
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_006: [If the batched message already holds `instance->batch_max_messages` messages, and that option is not zero, the pending messages shall be sent and a new batched message created.]
+        if ((send_pending_events_state.messages_pending != 0) &&
+            ((encoded_length + send_pending_events_state.bytes_pending > get_batch_size_limit(instance, max_messagesize)) ||
+             (instance->batch_max_messages != 0 && send_pending_events_state.messages_pending >= instance->batch_max_messages)))
         {
             // If we tried to add the current message, we would overflow.  Send what we've queued immediately.
             if (send_batched_message_and_reset_state(instance, &send_pending_events_state) != RESULT_OK)
@@ -1264,6 +1369,8 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
         }
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_195: [Append the current message's encoded data to the batched message tracked by uAMQP layer.]
+        body_binary_data.bytes = instance->encode_buffer;
+        body_binary_data.length = encoded_length;
         if (message_add_body_amqp_data(send_pending_events_state.message_batch_container, body_binary_data) != 0)
         {
             LogError("message_add_body_amqp_data failed");
@@ -1271,7 +1378,8 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
             break;
         }
 
-        send_pending_events_state.bytes_pending += body_binary_data.length;
+        send_pending_events_state.bytes_pending += encoded_length;
+        send_pending_events_state.messages_pending++;
     }
 
     if ((result == 0) && (send_pending_events_state.bytes_pending != 0))
@@ -1283,11 +1391,6 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
         }
     }
 
-    if (body_binary_data.bytes != NULL)
-    {
-        free((unsigned char*)body_binary_data.bytes);
-    }
-
     // A non-NULL task indicates error, since otherwise send_batched_message_and_reset_state would've sent off messages and reset send_pending_events_state
     if (send_pending_events_state.task != NULL)
     {
@@ -1304,6 +1407,110 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
     return result;
 }
 
+static size_t get_message_payload_size(IOTHUB_MESSAGE_HANDLE message)
+{
+    size_t result;
+    IOTHUBMESSAGE_CONTENT_TYPE content_type = IoTHubMessage_GetContentType(message);
+
+    if (content_type == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        const unsigned char* payload;
+
+        if (IoTHubMessage_GetByteArray(message, &payload, &result) != IOTHUB_MESSAGE_OK)
+        {
+            result = 0;
+        }
+    }
+    else if (content_type == IOTHUBMESSAGE_STRING)
+    {
+        const char* payload = IoTHubMessage_GetString(message);
+        result = (payload == NULL) ? 0 : strlen(payload);
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+// @brief
+//     Counts the events in waiting_to_send and, only if `instance->batch_max_bytes` is set, adds up the size of their payloads.
+static void get_pending_events_size(TELEMETRY_MESSENGER_INSTANCE* instance, size_t* event_count, size_t* payload_bytes)
+{
+    LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(instance->waiting_to_send);
+
+    *event_count = 0;
+    *payload_bytes = 0;
+
+    while (list_item != NULL)
+    {
+        (*event_count)++;
+
+        if (instance->batch_max_bytes != 0)
+        {
+            MESSENGER_SEND_EVENT_CALLER_INFORMATION* caller_info = (MESSENGER_SEND_EVENT_CALLER_INFORMATION*)singlylinkedlist_item_get_value(list_item);
+            *payload_bytes += get_message_payload_size(caller_info->message->messageHandle);
+        }
+
+        list_item = singlylinkedlist_get_next_item(list_item);
+    }
+}
+
+static bool is_batch_full(TELEMETRY_MESSENGER_INSTANCE* instance, size_t event_count, size_t payload_bytes)
+{
+    return (instance->batch_max_messages != 0 && event_count >= instance->batch_max_messages) ||
+        (instance->batch_max_bytes != 0 && payload_bytes >= instance->batch_max_bytes);
+}
+
+// @brief
+//     Decides whether the events waiting to be sent are held for a later do_work, so they go out in a fuller batch.
+// @returns
+//     true if the events shall not be sent yet, false otherwise.
+// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_007: [If `instance->batch_linger_ms` is greater than zero, the events waiting to be sent shall be held while more of them keep arriving, for up to `instance->batch_linger_ms` milliseconds after they were first seen]
+// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_008: [The events shall not be held if no event arrived since the previous telemetry_messenger_do_work(), or if `instance->batch_max_messages` events or `instance->batch_max_bytes` bytes of payload are waiting]
+static bool should_hold_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
+{
+    bool result;
+
+    if (instance->batch_linger_ms == 0 || instance->linger_tick_counter == NULL)
+    {
+        result = false;
+    }
+    else
+    {
+        size_t event_count;
+        size_t payload_bytes;
+        tickcounter_ms_t current_ms;
+
+        get_pending_events_size(instance, &event_count, &payload_bytes);
+
+        if (event_count == 0 || is_batch_full(instance, event_count, payload_bytes))
+        {
+            result = false;
+        }
+        else if (tickcounter_get_current_ms(instance->linger_tick_counter, &current_ms) != 0)
+        {
+            LogError("Failed evaluating the batch linger time (tickcounter_get_current_ms failed); the events will be sent now");
+            result = false;
+        }
+        else if (instance->held_event_count == 0)
+        {
+            instance->linger_start_ms = current_ms;
+            result = true;
+        }
+        else
+        {
+            // With no new event since the last call the client is idle, and waiting longer would not make the batch any fuller.
+            result = (event_count > instance->held_event_count) && ((current_ms - instance->linger_start_ms) < instance->batch_linger_ms);
+        }
+
+        instance->held_event_count = (result ? event_count : 0);
+    }
+
+    return result;
+}
+
 // @brief
 //     Goes through each task in in_progress_list and checks if the events timed out to be sent.
 // @remarks
@@ -1389,6 +1596,9 @@ static void* telemetry_messenger_clone_option(const char* name, const void* valu
     else
     {
         if (strcmp(MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS, name) == 0 ||
+            strcmp(MESSENGER_OPTION_BATCH_LINGER_MS, name) == 0 ||
+            strcmp(MESSENGER_OPTION_BATCH_MAX_BYTES, name) == 0 ||
+            strcmp(MESSENGER_OPTION_BATCH_MAX_MESSAGES, name) == 0 ||
             strcmp(MESSENGER_OPTION_SAVED_OPTIONS, name) == 0)
         {
             result = (void*)value;
@@ -1877,6 +2087,10 @@ void telemetry_messenger_do_work(TELEMETRY_MESSENGER_HANDLE messenger_handle)
             {
                 update_messenger_state(instance, TELEMETRY_MESSENGER_STATE_ERROR);
             }
+            else if (should_hold_pending_events(instance))
+            {
+                // The events are sent by a later call, together with the ones queued in the meantime.
+            }
             else if (send_pending_events(instance) != RESULT_OK && instance->event_send_retry_limit > 0)
             {
                 instance->event_send_error_count++;
@@ -1956,6 +2170,18 @@ void telemetry_messenger_destroy(TELEMETRY_MESSENGER_HANDLE messenger_handle)
 
         STRING_delete(instance->product_info);
 
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_016: [`instance->sections_cache` shall be destroyed using message_sections_cache_destroy()]
+        if (instance->sections_cache != NULL)
+        {
+            message_sections_cache_destroy(instance->sections_cache);
+        }
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_012: [If `instance->linger_tick_counter` was created, it shall be destroyed using tickcounter_destroy()]
+        if (instance->linger_tick_counter != NULL)
+        {
+            tickcounter_destroy(instance->linger_tick_counter);
+        }
+
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_114: [telemetry_messenger_destroy() shall destroy `instance` with free()]
         (void)free(instance);
     }
@@ -2040,6 +2266,13 @@ TELEMETRY_MESSENGER_HANDLE telemetry_messenger_create(const TELEMETRY_MESSENGER_
                 handle = NULL;
                 LogError("telemetry_messenger_create failed (singlylinkedlist_create failed to create in_progress_list)");
             }
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_013: [`instance->sections_cache` shall be set using message_sections_cache_create()]
+            else if ((instance->sections_cache = message_sections_cache_create(MESSAGE_SECTIONS_CACHE_SIZE)) == NULL)
+            {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_014: [If message_sections_cache_create() fails, telemetry_messenger_create() shall fail and return NULL]
+                handle = NULL;
+                LogError("telemetry_messenger_create failed (message_sections_cache_create failed)");
+            }
             else
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_013: [`messenger_config->on_state_changed_callback` shall be saved into `instance->on_state_changed_callback`]
@@ -2083,6 +2316,34 @@ int telemetry_messenger_set_option(TELEMETRY_MESSENGER_HANDLE messenger_handle,
             instance->event_send_timeout_secs = *((size_t*)value);
             result = RESULT_OK;
         }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_009: [If name matches MESSENGER_OPTION_BATCH_LINGER_MS, `value` shall be saved on `instance->batch_linger_ms`, creating `instance->linger_tick_counter` with tickcounter_create() the first time `value` is greater than zero]
+        else if (strcmp(MESSENGER_OPTION_BATCH_LINGER_MS, name) == 0)
+        {
+            if (*((size_t*)value) > 0 &&
+                instance->linger_tick_counter == NULL &&
+                (instance->linger_tick_counter = tickcounter_create()) == NULL)
+            {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_010: [If tickcounter_create() fails, telemetry_messenger_set_option shall fail and return a non-zero value]
+                LogError("telemetry_messenger_set_option failed (tickcounter_create failed)");
+                result = __FAILURE__;
+            }
+            else
+            {
+                instance->batch_linger_ms = *((size_t*)value);
+                result = RESULT_OK;
+            }
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_011: [If name matches MESSENGER_OPTION_BATCH_MAX_BYTES or MESSENGER_OPTION_BATCH_MAX_MESSAGES, `value` shall be saved on `instance->batch_max_bytes` or `instance->batch_max_messages`]
+        else if (strcmp(MESSENGER_OPTION_BATCH_MAX_BYTES, name) == 0)
+        {
+            instance->batch_max_bytes = *((size_t*)value);
+            result = RESULT_OK;
+        }
+        else if (strcmp(MESSENGER_OPTION_BATCH_MAX_MESSAGES, name) == 0)
+        {
+            instance->batch_max_messages = *((size_t*)value);
+            result = RESULT_OK;
+        }
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_169: [If name matches MESSENGER_OPTION_SAVED_OPTIONS, `value` shall be applied using OptionHandler_FeedOptions]
         else if (strcmp(MESSENGER_OPTION_SAVED_OPTIONS, name) == 0)
         {
@@ -2141,6 +2402,21 @@ OPTIONHANDLER_HANDLE telemetry_messenger_retrieve_options(TELEMETRY_MESSENGER_HA
                 LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS);
                 result = NULL;
             }
+            else if (OptionHandler_AddOption(options, MESSENGER_OPTION_BATCH_LINGER_MS, (void*)&instance->batch_linger_ms) != OPTIONHANDLER_OK)
+            {
+                LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", MESSENGER_OPTION_BATCH_LINGER_MS);
+                result = NULL;
+            }
+            else if (OptionHandler_AddOption(options, MESSENGER_OPTION_BATCH_MAX_BYTES, (void*)&instance->batch_max_bytes) != OPTIONHANDLER_OK)
+            {
+                LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", MESSENGER_OPTION_BATCH_MAX_BYTES);
+                result = NULL;
+            }
+            else if (OptionHandler_AddOption(options, MESSENGER_OPTION_BATCH_MAX_MESSAGES, (void*)&instance->batch_max_messages) != OPTIONHANDLER_OK)
+            {
+                LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", MESSENGER_OPTION_BATCH_MAX_MESSAGES);
+                result = NULL;
+            }
             else
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_179: [If no failures occur, telemetry_messenger_retrieve_options shall return the OPTIONHANDLER_HANDLE instance]
@@ -26,6 +26,9 @@
 #include "azure_c_shared_utility/urlencode.h"
 #include "iothub_client_version.h"
 #include "iothub_client_retry_control.h"
+#include "mqtt_inflight_table.h"
+#include "deadline_heap.h"
+#include "mqtt_telemetry_topic.h"
 
 #include "iothubtransport_mqtt_common.h"
 
@@ -59,7 +62,6 @@ static const char* TOPIC_GET_DESIRED_STATE = "$iothub/twin/res/#";
 static const char* TOPIC_NOTIFICATION_STATE = "$iothub/twin/PATCH/properties/desired/#";
 
 static const char* TOPIC_DEVICE_MSG = "devices/%s/messages/devicebound/#";
-static const char* TOPIC_DEVICE_DEVICE = "devices/%s/messages/events/";
 
 static const char* TOPIC_DEVICE_METHOD_SUBSCRIBE = "$iothub/methods/POST/#";
 static const char* TOPIC_DEVICE_METHOD_RESPONSE = "$iothub/methods/res";
@@ -77,10 +79,6 @@ static const char* MESSAGE_ID_PROPERTY = "mid";
 static const char* CORRELATION_ID_PROPERTY = "cid";
 static const char* CONTENT_TYPE_PROPERTY = "ct";
 static const char* CONTENT_ENCODING_PROPERTY = "ce";
-static const char* DIAGNOSTIC_ID_PROPERTY = "diagid";
-static const char* DIAGNOSTIC_CONTEXT_PROPERTY = "diagctx";
-
-static const char* DIAGNOSTIC_CONTEXT_CREATION_TIME_UTC_PROPERTY = "creationtimeutc";
 
 #define UNSUBSCRIBE_FROM_TOPIC                  0x0000
 #define SUBSCRIBE_GET_REPORTED_STATE_TOPIC      0x0001
@@ -136,7 +134,7 @@ typedef enum MQTT_CLIENT_STATUS_TAG
 typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
 {
     // Topic control
-    STRING_HANDLE topic_MqttEvent;
+    MQTT_TELEMETRY_TOPIC_HANDLE telemetry_topic;
     STRING_HANDLE topic_MqttMessage;
     STRING_HANDLE topic_GetState;
     STRING_HANDLE topic_NotifyState;
@@ -191,12 +189,16 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
     // Internal lists for message tracking
     PDLIST_ENTRY waitingToSend;
     DLIST_ENTRY ack_waiting_queue;
+    DEADLINE_HEAP_HANDLE device_twin_timeouts;
+    size_t reported_state_timeout_secs; /*0 leaves reported states waiting for their response until the transport is destroyed*/
 
     // Message tracking
     CONTROL_PACKET_TYPE currPacketState;
 
     // Telemetry specific
     DLIST_ENTRY telemetry_waitingForAck;
+    MQTT_INFLIGHT_TABLE_HANDLE telemetry_inflight;
+    DEADLINE_HEAP_HANDLE telemetry_timeouts;
 
     // Controls frequency of reconnection logic.
     RETRY_CONTROL_HANDLE retry_control_handle;
@@ -221,6 +223,7 @@ typedef struct MQTT_DEVICE_TWIN_ITEM_TAG
     uint32_t iothub_msg_id;
     IOTHUB_DEVICE_TWIN* device_twin_data;
     DEVICE_TWIN_MSG_TYPE device_twin_msg_type;
+    DEADLINE_HEAP_ENTRY_HANDLE timeout_entry;
     DLIST_ENTRY entry;
 } MQTT_DEVICE_TWIN_ITEM;
 
@@ -231,6 +234,7 @@ typedef struct MQTT_MESSAGE_DETAILS_LIST_TAG
     IOTHUB_MESSAGE_LIST* iotHubMessageEntry;
     void* context;
     uint16_t packet_id;
+    DEADLINE_HEAP_ENTRY_HANDLE timeout_entry;
     DLIST_ENTRY entry;
 } MQTT_MESSAGE_DETAILS_LIST, *PMQTT_MESSAGE_DETAILS_LIST;
 
@@ -281,6 +285,21 @@ static void free_transport_handle_data(MQTTTRANSPORT_HANDLE_DATA* transport_data
         retry_control_destroy(transport_data->retry_control_handle);
     }
 
+    if (transport_data->telemetry_inflight != NULL)
+    {
+        mqtt_inflight_table_destroy(transport_data->telemetry_inflight);
+    }
+
+    if (transport_data->telemetry_timeouts != NULL)
+    {
+        deadline_heap_destroy(transport_data->telemetry_timeouts);
+    }
+
+    if (transport_data->device_twin_timeouts != NULL)
+    {
+        deadline_heap_destroy(transport_data->device_twin_timeouts);
+    }
+
     set_saved_tls_options(transport_data, NULL);
 
     tickcounter_destroy(transport_data->msgTickCounter);
@@ -288,7 +307,10 @@ static void free_transport_handle_data(MQTTTRANSPORT_HANDLE_DATA* transport_data
     free_proxy_data(transport_data);
 
     STRING_delete(transport_data->devicesPath);
-    STRING_delete(transport_data->topic_MqttEvent);
+    if (transport_data->telemetry_topic != NULL)
+    {
+        mqtt_telemetry_topic_destroy(transport_data->telemetry_topic);
+    }
     STRING_delete(transport_data->topic_MqttMessage);
     STRING_delete(transport_data->device_id);
     STRING_delete(transport_data->hostAddress);
@@ -579,180 +601,16 @@ static void sendMsgComplete(IOTHUB_MESSAGE_LIST* iothubMsgList, PMQTTTRANSPORT_H
     IoTHubClient_LL_SendComplete(transport_data->llClientHandle, &messageCompleted, confirmResult);
 }
 
-static STRING_HANDLE addPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, const char* eventTopic)
+static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, const unsigned char* payload, size_t len)
 {
-    STRING_HANDLE result = STRING_construct(eventTopic);
-    const char* const* propertyKeys;
-    const char* const* propertyValues;
-    size_t propertyCount;
-    size_t index = 0;
-
-    // Construct Properties
-    MAP_HANDLE properties_map = IoTHubMessage_Properties(iothub_message_handle);
-    if (properties_map != NULL)
-    {
-        if (Map_GetInternals(properties_map, &propertyKeys, &propertyValues, &propertyCount) != MAP_OK)
-        {
-            LogError("Failed to get the internals of the property map.");
-            STRING_delete(result);
-            result = NULL;
-        }
-        else
-        {
-            if (propertyCount != 0)
-            {
-                for (index = 0; index < propertyCount && result != NULL; index++)
-                {
-                    if (STRING_sprintf(result, "%s=%s%s", propertyKeys[index], propertyValues[index], propertyCount - 1 == index ? "" : PROPERTY_SEPARATOR) != 0)
-                    {
-                        LogError("Failed construting property string.");
-                        STRING_delete(result);
-                        result = NULL;
-                    }
-                }
-            }
-        }
-    }
-
+    int result;
     /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_07_052: [ IoTHubTransport_MQTT_Common_DoWork shall check for the CorrelationId property and if found add the value as a system property in the format of $.cid=<id> ] */
-    if (result != NULL)
-    {
-        const char* correlation_id = IoTHubMessage_GetCorrelationId(iothub_message_handle);
-        if (correlation_id != NULL)
-        {
-            if (STRING_sprintf(result, "%s%%24.cid=%s", index == 0 ? "" : PROPERTY_SEPARATOR, correlation_id) != 0)
-            {
-                LogError("Failed setting correlation id.");
-                STRING_delete(result);
-                result = NULL;
-            }
-            index++;
-        }
-    }
-
     /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_07_053: [ IoTHubTransport_MQTT_Common_DoWork shall check for the MessageId property and if found add the value as a system property in the format of $.mid=<id> ] */
-    if (result != NULL)
-    {
-        const char* msg_id = IoTHubMessage_GetMessageId(iothub_message_handle);
-        if (msg_id != NULL)
-        {
-            if (STRING_sprintf(result, "%s%%24.mid=%s", index == 0 ? "" : PROPERTY_SEPARATOR, msg_id) != 0)
-            {
-                LogError("Failed setting message id.");
-                STRING_delete(result);
-                result = NULL;
-            }
-            index++;
-        }
-    }
-
     // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_010: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the ContentType property and if found add the `value` as a system property in the format of `$.ct=<value>` ]
-    if (result != NULL)
-    {
-        const char* content_type = IoTHubMessage_GetContentTypeSystemProperty(iothub_message_handle);
-        if (content_type != NULL)
-        {
-            if (STRING_sprintf(result, "%s%%24.%s=%s", index == 0 ? "" : PROPERTY_SEPARATOR, CONTENT_TYPE_PROPERTY, content_type) != 0)
-            {
-                LogError("Failed setting content type.");
-                STRING_delete(result);
-                result = NULL;
-            }
-            index++;
-        }
-    }
-
     // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_011: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the ContentEncoding property and if found add the `value` as a system property in the format of `$.ce=<value>` ]
-    if (result != NULL)
-    {
-        const char* content_encoding = IoTHubMessage_GetContentEncodingSystemProperty(iothub_message_handle);
-        if (content_encoding != NULL)
-        {
-            if (STRING_sprintf(result, "%s%%24.%s=%s", index == 0 ? "" : PROPERTY_SEPARATOR, CONTENT_ENCODING_PROPERTY, content_encoding) != 0)
-            {
-                LogError("Failed setting content encoding.");
-                STRING_delete(result);
-                result = NULL;
-            }
-            index++;
-        }
-    }
-
     // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_014: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the diagnostic properties including diagid and diagCreationTimeUtc and if found both add them as system property in the format of `$.diagid` and `$.diagctx` respectively]
-    if (result != NULL)
-    {
-        const IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA* diagnosticData = IoTHubMessage_GetDiagnosticPropertyData(iothub_message_handle);
-        if (diagnosticData != NULL)
-        {
-            const char* diag_id = diagnosticData->diagnosticId;
-            const char* creation_time_utc = diagnosticData->diagnosticCreationTimeUtc;
-            //diagid and creationtimeutc must be present/unpresent simultaneously
-            if (diag_id != NULL && creation_time_utc != NULL)
-            {
-                if (STRING_sprintf(result, "%s%%24.%s=%s", index == 0 ? "" : PROPERTY_SEPARATOR, DIAGNOSTIC_ID_PROPERTY, diag_id) != 0)
-                {
-                    LogError("Failed setting diagnostic id");
-                    STRING_delete(result);
-                    result = NULL;
-                }
-                index++;
-
-                if (result != NULL)
-                {
-                    //construct diagnostic context, it should be urlencode(key1=value1,key2=value2)
-                    STRING_HANDLE diagContextHandle = STRING_construct_sprintf("%s=%s", DIAGNOSTIC_CONTEXT_CREATION_TIME_UTC_PROPERTY, creation_time_utc);
-                    if (diagContextHandle == NULL)
-                    {
-                        LogError("Failed constructing diagnostic context");
-                        STRING_delete(result);
-                        result = NULL;
-                    }
-                    else
-                    {
-                        //Add other diagnostic context properties here if have more
-                        STRING_HANDLE encodedContextValueHandle = URL_Encode(diagContextHandle);
-                        const char* encodedContextValueString = NULL;
-                        if (encodedContextValueHandle != NULL &&
-                            (encodedContextValueString = STRING_c_str(encodedContextValueHandle)) != NULL)
-                        {
-                            if (STRING_sprintf(result, "%s%%24.%s=%s", index == 0 ? "" : PROPERTY_SEPARATOR, DIAGNOSTIC_CONTEXT_PROPERTY, encodedContextValueString) != 0)
-                            {
-                                LogError("Failed setting diagnostic context");
-                                STRING_delete(result);
-                                result = NULL;
-                            }
-                            STRING_delete(encodedContextValueHandle);
-                            encodedContextValueHandle = NULL;
-                        }
-                        else
-                        {
-                            LogError("Failed encoding diagnostic context value");
-                            STRING_delete(result);
-                            result = NULL;
-                        }
-                        STRING_delete(diagContextHandle);
-                        diagContextHandle = NULL;
-                        index++;
-                    }
-                }
-            }
-            else if (diag_id != NULL || creation_time_utc != NULL)
-            {
-                // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_015: [ `IoTHubTransport_MQTT_Common_DoWork` shall check whether diagid and diagCreationTimeUtc be present simultaneously, treat as error if not]
-                LogError("diagid and diagcreationtimeutc must be present simultaneously.");
-                STRING_delete(result);
-                result = NULL;
-            }
-        }
-    }
-
-    return result;
-}
-
-static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, const unsigned char* payload, size_t len)
-{
-    int result;
-    STRING_HANDLE msgTopic = addPropertiesTouMqttMessage(mqttMsgEntry->iotHubMessageEntry->messageHandle, STRING_c_str(transport_data->topic_MqttEvent));
+    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_015: [ `IoTHubTransport_MQTT_Common_DoWork` shall check whether diagid and diagCreationTimeUtc be present simultaneously, treat as error if not]
+    const char* msgTopic = mqtt_telemetry_topic_build(transport_data->telemetry_topic, mqttMsgEntry->iotHubMessageEntry->messageHandle, NULL);
     if (msgTopic == NULL)
     {
         LogError("Failed adding properties to mqtt message");
@@ -760,7 +618,7 @@ static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data,
     }
     else
     {
-        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create(mqttMsgEntry->packet_id, STRING_c_str(msgTopic), DELIVER_AT_LEAST_ONCE, payload, len);
+        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create(mqttMsgEntry->packet_id, msgTopic, DELIVER_AT_LEAST_ONCE, payload, len);
         if (mqttMsg == NULL)
         {
             LogError("Failed creating mqtt message");
@@ -773,11 +631,19 @@ static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data,
                 LogError("Failed retrieving tickcounter info");
                 result = __FAILURE__;
             }
+            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_11_003: [ Each time a telemetry message is published it shall be scheduled in the telemetry timeout heap to be checked again RESEND_TIMEOUT_VALUE_MIN after its publish time. ] */
+            else if ((mqttMsgEntry->timeout_entry = deadline_heap_add(transport_data->telemetry_timeouts, mqttMsgEntry->msgPublishTime + (RESEND_TIMEOUT_VALUE_MIN * 1000), mqttMsgEntry)) == NULL)
+            {
+                LogError("Failed scheduling the mqtt message timeout");
+                result = __FAILURE__;
+            }
             else
             {
                 if (mqtt_client_publish(transport_data->mqttClient, mqttMsg) != 0)
                 {
                     LogError("Failed attempting to publish mqtt message");
+                    deadline_heap_remove(transport_data->telemetry_timeouts, mqttMsgEntry->timeout_entry);
+                    mqttMsgEntry->timeout_entry = NULL;
                     result = __FAILURE__;
                 }
                 else
@@ -788,7 +654,6 @@ static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data,
             }
             mqttmessage_destroy(mqttMsg);
         }
-        STRING_delete(msgTopic);
     }
     return result;
 }
@@ -848,6 +713,7 @@ static int publish_device_twin_get_message(MQTTTRANSPORT_HANDLE_DATA* transport_
         mqtt_info->msgPublishTime = 0;
         mqtt_info->iothub_type = IOTHUB_TYPE_DEVICE_TWIN;
         mqtt_info->device_twin_data = NULL;
+        mqtt_info->timeout_entry = NULL;
         STRING_HANDLE msg_topic = STRING_construct_sprintf(GET_PROPERTIES_TOPIC, mqtt_info->packet_id);
         if (msg_topic == NULL)
         {
@@ -912,11 +778,20 @@ static int publish_device_twin_message(MQTTTRANSPORT_HANDLE_DATA* transport_data
                 LogError("Failed retrieving tickcounter info");
                 result = __FAILURE__;
             }
+            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_11_005: [ If "reported_state_timeout_secs" was set to a non-zero value, each reported state message shall be scheduled in the device twin timeout heap to expire that many seconds after its publish time. ] */
+            else if ((transport_data->reported_state_timeout_secs != 0) &&
+                ((mqtt_info->timeout_entry = deadline_heap_add(transport_data->device_twin_timeouts, mqtt_info->msgPublishTime + ((tickcounter_ms_t)transport_data->reported_state_timeout_secs * 1000), mqtt_info)) == NULL))
+            {
+                LogError("Failed scheduling the reported state timeout");
+                result = __FAILURE__;
+            }
             else
             {
                 if (mqtt_client_publish(transport_data->mqttClient, mqtt_rpt_msg) != 0)
                 {
                     LogError("Failed publishing mqtt message");
+                    deadline_heap_remove(transport_data->device_twin_timeouts, mqtt_info->timeout_entry);
+                    mqtt_info->timeout_entry = NULL;
                     result = __FAILURE__;
                 }
                 else
@@ -939,7 +814,7 @@ static bool isSystemProperty(const char* tokenData)
     size_t index = 0;
     for (index = 0; index < propCount; index++)
     {
-        if (memcmp(tokenData, sysPropList[index].propName, sysPropList[index].propLength) == 0)
+        if (strncmp(tokenData, sysPropList[index].propName, sysPropList[index].propLength) == 0)
         {
             result = true;
             break;
@@ -998,140 +873,78 @@ static int setMqttMessagePropertyIfPossible(IOTHUB_MESSAGE_HANDLE IoTHubMessage,
     return result;
 }
 
+/* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_11_010: [ The properties of a received message shall be parsed from a single copy of its topic, split in place on `&` and `=`, and its application properties shall be set at once with IoTHubMessage_SetProperties. ] */
 static int extractMqttProperties(IOTHUB_MESSAGE_HANDLE IoTHubMessage, const char* topic_name)
 {
     int result;
-    STRING_HANDLE mqttTopic = STRING_construct(topic_name);
-    if (mqttTopic == NULL)
+    size_t topicLength = strlen(topic_name);
+    size_t maxProperties = 1;
+    const char* iterator;
+    IOTHUB_MESSAGE_PROPERTY* properties;
+
+    for (iterator = topic_name; *iterator != '\0'; iterator++)
     {
-        LogError("Failure constructing string topic name.");
+        if (*iterator == PROPERTY_SEPARATOR[0])
+        {
+            maxProperties++;
+        }
+    }
+
+    /* the application properties point into the copy of the topic that follows them */
+    if ((properties = (IOTHUB_MESSAGE_PROPERTY*)malloc(maxProperties * sizeof(IOTHUB_MESSAGE_PROPERTY) + topicLength + 1)) == NULL)
+    {
+        LogError("Failure allocating the copy of the topic name.");
         result = __FAILURE__;
     }
     else
     {
-        STRING_TOKENIZER_HANDLE token = STRING_TOKENIZER_create(mqttTopic);
-        if (token != NULL)
+        char* token = (char*)(properties + maxProperties);
+        size_t propertyCount = 0;
+        (void)memcpy(token, topic_name, topicLength + 1);
+        result = 0;
+
+        while (token != NULL && result == 0)
         {
-            MAP_HANDLE propertyMap = IoTHubMessage_Properties(IoTHubMessage);
-            if (propertyMap == NULL)
+            char* nextToken = strchr(token, PROPERTY_SEPARATOR[0]);
+            char* separator;
+            if (nextToken != NULL)
             {
-                LogError("Failure to retrieve IoTHubMessage_properties.");
-                result = __FAILURE__;
+                *nextToken = '\0';
+                nextToken++;
             }
-            else
+
+            /* tokens without a value are ignored */
+            if ((separator = strchr(token, '=')) != NULL)
             {
-                STRING_HANDLE output = STRING_new();
-                if (output == NULL)
+                size_t nameLen = separator - token;
+                *separator = '\0';
+                if (isSystemProperty(token))
                 {
-                    LogError("Failure to allocate STRING_new.");
-                    result = __FAILURE__;
+                    if (setMqttMessagePropertyIfPossible(IoTHubMessage, token, separator + 1, nameLen) != 0)
+                    {
+                        LogError("Unable to set message property");
+                        result = __FAILURE__;
+                    }
                 }
                 else
                 {
-                    result = 0;
-
-                    while (STRING_TOKENIZER_get_next_token(token, output, PROPERTY_SEPARATOR) == 0 && result == 0)
-                    {
-                        const char* tokenData = STRING_c_str(output);
-                        size_t tokenLen = strlen(tokenData);
-                        if (tokenData == NULL || tokenLen == 0)
-                        {
-                            break;
-                        }
-                        else
-                        {
-                            if (isSystemProperty(tokenData))
-                            {
-                                const char* iterator = tokenData;
-                                while (iterator != NULL && *iterator != '\0' && result == 0)
-                                {
-                                    if (*iterator == '=')
-                                    {
-                                        size_t nameLen = iterator - tokenData;
-                                        char* propName = malloc(nameLen + 1);
-
-                                        size_t valLen = tokenLen - (nameLen + 1) + 1;
-                                        char* propValue = malloc(valLen + 1);
-
-                                        if (propName == NULL || propValue == NULL)
-                                        {
-                                            LogError("Failed allocating property name (%p) and/or value (%p)", propName, propValue);
-                                            result = __FAILURE__;
-                                        }
-                                        else
-                                        {
-                                            strncpy(propName, tokenData, nameLen);
-                                            propName[nameLen] = '\0';
-
-                                            strncpy(propValue, iterator + 1, valLen);
-                                            propValue[valLen] = '\0';
-
-                                            if (setMqttMessagePropertyIfPossible(IoTHubMessage, propName, propValue, nameLen) != 0)
-                                            {
-                                                LogError("Unable to set message property");
-                                                result = __FAILURE__;
-                                            }
-                                        }
-                                        free(propName);
-                                        free(propValue);
-
-                                        break;
-                                    }
-                                    iterator++;
-                                }
-                            }
-                            else
-                            {
-                                const char* iterator = tokenData;
-                                while (iterator != NULL && *iterator != '\0' && result == 0)
-                                {
-                                    if (*iterator == '=')
-                                    {
-                                        size_t nameLen = iterator - tokenData;
-                                        char* propName = malloc(nameLen + 1);
-
-                                        size_t valLen = tokenLen - (nameLen + 1) + 1;
-                                        char* propValue = malloc(valLen + 1);
-
-                                        if (propName == NULL || propValue == NULL)
-                                        {
-                                            result = __FAILURE__;
-                                        }
-                                        else
-                                        {
-                                            strncpy(propName, tokenData, nameLen);
-                                            propName[nameLen] = '\0';
-
-                                            strncpy(propValue, iterator + 1, valLen);
-                                            propValue[valLen] = '\0';
-
-                                            if (Map_AddOrUpdate(propertyMap, propName, propValue) != MAP_OK)
-                                            {
-                                                LogError("Map_AddOrUpdate failed.");
-                                                result = __FAILURE__;
-                                            }
-                                        }
-                                        free(propName);
-                                        free(propValue);
-
-                                        break;
-                                    }
-                                    iterator++;
-                                }
-                            }
-                        }
-                    }
-                    STRING_delete(output);
+                    properties[propertyCount].key = token;
+                    properties[propertyCount].keyLength = nameLen;
+                    properties[propertyCount].value = separator + 1;
+                    properties[propertyCount].valueLength = (nextToken == NULL) ? strlen(separator + 1) : (size_t)(nextToken - separator - 2);
+                    propertyCount++;
                 }
             }
-            STRING_TOKENIZER_destroy(token);
+            token = nextToken;
         }
-        else
+
+        if (result == 0 && propertyCount > 0 &&
+            IoTHubMessage_SetProperties(IoTHubMessage, properties, propertyCount) != IOTHUB_MESSAGE_OK)
         {
-            LogError("Unable to create Tokenizer object.");
+            LogError("Failure setting the message properties.");
             result = __FAILURE__;
         }
-        STRING_delete(mqttTopic);
+        free(properties);
     }
     return result;
 }
@@ -1179,6 +992,7 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE msgHandle, void* call
                             if (request_id == msg_entry->packet_id)
                             {
                                 (void)DList_RemoveEntryList(dev_twin_item);
+                                deadline_heap_remove(transportData->device_twin_timeouts, msg_entry->timeout_entry);
                                 if (msg_entry->device_twin_msg_type == RETRIEVE_PROPERTIES)
                                 {
                                     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_054: [ If type is IOTHUB_TYPE_DEVICE_TWIN, then on success if msg_type is RETRIEVE_PROPERTIES then mqtt_notification_callback shall call IoTHubClient_LL_RetrievePropertyComplete... ] */
@@ -1298,20 +1112,14 @@ static void mqtt_operation_complete_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLI
                 const PUBLISH_ACK* puback = (const PUBLISH_ACK*)msgInfo;
                 if (puback != NULL)
                 {
-                    PDLIST_ENTRY currentListEntry = transport_data->telemetry_waitingForAck.Flink;
-                    while (currentListEntry != &transport_data->telemetry_waitingForAck)
+                    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_11_001: [ On PUBACK the telemetry message shall be looked up and removed by packet id from the in-flight table, then removed from the Waiting Acknowledge list and completed with IOTHUB_CLIENT_CONFIRMATION_OK. ] */
+                    MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = (MQTT_MESSAGE_DETAILS_LIST*)mqtt_inflight_table_remove(transport_data->telemetry_inflight, puback->packetId);
+                    if (mqttMsgEntry != NULL)
                     {
-                        MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
-                        DLIST_ENTRY saveListEntry;
-                        saveListEntry.Flink = currentListEntry->Flink;
-
-                        if (puback->packetId == mqttMsgEntry->packet_id)
-                        {
-                            (void)DList_RemoveEntryList(currentListEntry); //First remove the item from Waiting for Ack List.
-                            sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_OK);
-                            free(mqttMsgEntry);
-                        }
-                        currentListEntry = saveListEntry.Flink;
+                        (void)DList_RemoveEntryList(&(mqttMsgEntry->entry)); //First remove the item from Waiting for Ack List.
+                        deadline_heap_remove(transport_data->telemetry_timeouts, mqttMsgEntry->timeout_entry);
+                        sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_OK);
+                        free(mqttMsgEntry);
                     }
                 }
                 else
@@ -1929,6 +1737,24 @@ static PMQTTTRANSPORT_HANDLE_DATA InitializeTransportHandleData(const IOTHUB_CLI
             free_transport_handle_data(state);
             state = NULL;
         }
+        else if ((state->telemetry_inflight = mqtt_inflight_table_create(0)) == NULL)
+        {
+            LogError("Failed creating telemetry in-flight table");
+            free_transport_handle_data(state);
+            state = NULL;
+        }
+        else if ((state->telemetry_timeouts = deadline_heap_create()) == NULL)
+        {
+            LogError("Failed creating telemetry timeout heap");
+            free_transport_handle_data(state);
+            state = NULL;
+        }
+        else if ((state->device_twin_timeouts = deadline_heap_create()) == NULL)
+        {
+            LogError("Failed creating device twin timeout heap");
+            free_transport_handle_data(state);
+            state = NULL;
+        }
         else if ((state->device_id = STRING_construct(upperConfig->deviceId)) == NULL)
         {
             LogError("failure constructing device_id.");
@@ -1943,9 +1769,9 @@ static PMQTTTRANSPORT_HANDLE_DATA InitializeTransportHandleData(const IOTHUB_CLI
         }
         else
         {
-            if ( (state->topic_MqttEvent = STRING_construct_sprintf(TOPIC_DEVICE_DEVICE, upperConfig->deviceId) ) == NULL)
+            if ( (state->telemetry_topic = mqtt_telemetry_topic_create(upperConfig->deviceId) ) == NULL)
             {
-                LogError("Could not create topic_MqttEvent for MQTT");
+                LogError("Could not create telemetry topic for MQTT");
                 free_transport_handle_data(state);
                 state = NULL;
             }
@@ -1999,6 +1825,7 @@ static PMQTTTRANSPORT_HANDLE_DATA InitializeTransportHandleData(const IOTHUB_CLI
                         state->currPacketState = CONNECT_TYPE;
                         state->keepAliveValue = DEFAULT_MQTT_KEEPALIVE;
                         state->connect_timeout_in_sec = DEFAULT_CONNACK_TIMEOUT;
+                        state->reported_state_timeout_secs = 0;
                         state->connectFailCount = 0;
                         state->connectTick = 0;
                         state->topic_MqttMessage = NULL;
@@ -2428,6 +2255,7 @@ IOTHUB_PROCESS_ITEM_RESULT IoTHubTransport_MQTT_Common_ProcessItem(TRANSPORT_LL_
                     mqtt_info->iothub_type = item_type;
                     mqtt_info->iothub_msg_id = iothub_item->device_twin->item_id;
                     mqtt_info->retryCount = 0;
+                    mqtt_info->timeout_entry = NULL;
                     
                     /* Codes_SRS_IOTHUBCLIENT_LL_07_005: [ If successful IoTHubTransport_MQTT_Common_ProcessItem shall add mqtt info structure acknowledgement queue. ] */
                     DList_InsertTailList(&transport_data->ack_waiting_queue, &mqtt_info->entry);
@@ -2505,23 +2333,29 @@ void IoTHubTransport_MQTT_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
             }
             else if (transport_data->currPacketState == PUBLISH_TYPE)
             {
-                PDLIST_ENTRY currentListEntry = transport_data->telemetry_waitingForAck.Flink;
-                while (currentListEntry != &transport_data->telemetry_waitingForAck)
-                {
-                    tickcounter_ms_t current_ms;
-                    MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
-                    DLIST_ENTRY nextListEntry;
-                    nextListEntry.Flink = currentListEntry->Flink;
+                tickcounter_ms_t current_ms;
+                MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry;
+                MQTT_DEVICE_TWIN_ITEM* device_twin_item;
+                PDLIST_ENTRY currentListEntry;
 
-                    (void)tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms);
+                if (tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms) != 0)
+                {
+                    LogError("Failed retrieving tickcounter info");
+                }
+                else
+                {
                     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_033: [IoTHubTransport_MQTT_Common_DoWork shall iterate through the Waiting Acknowledge messages looking for any message that has been waiting longer than 2 min.]*/
-                    if (((current_ms - mqttMsgEntry->msgPublishTime) / 1000) > RESEND_TIMEOUT_VALUE_MIN)
+                    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_11_004: [ IoTHubTransport_MQTT_Common_DoWork shall only visit the Waiting Acknowledge messages whose entry in the telemetry timeout heap has expired. ] */
+                    while ((mqttMsgEntry = (MQTT_MESSAGE_DETAILS_LIST*)deadline_heap_pop_expired(transport_data->telemetry_timeouts, current_ms)) != NULL)
                     {
+                        mqttMsgEntry->timeout_entry = NULL;
+
                         /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_034: [If IoTHubTransport_MQTT_Common_DoWork has resent the message two times then it shall fail the message and reconnect to IoTHub ... ] */
                         if (mqttMsgEntry->retryCount >= MAX_SEND_RECOUNT_LIMIT)
                         {
                             PDLIST_ENTRY current_entry;
-                            (void)DList_RemoveEntryList(currentListEntry);
+                            (void)DList_RemoveEntryList(&mqttMsgEntry->entry);
+                            (void)mqtt_inflight_table_remove(transport_data->telemetry_inflight, mqttMsgEntry->packet_id);
                             sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT);
                             free(mqttMsgEntry);
 
@@ -2551,14 +2385,22 @@ void IoTHubTransport_MQTT_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
                             {
                                 if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, messagePayload, messageLength) != 0)
                                 {
-                                    (void)DList_RemoveEntryList(currentListEntry);
+                                    (void)DList_RemoveEntryList(&mqttMsgEntry->entry);
+                                    (void)mqtt_inflight_table_remove(transport_data->telemetry_inflight, mqttMsgEntry->packet_id);
                                     sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
                                     free(mqttMsgEntry);
                                 }
                             }
                         }
                     }
-                    currentListEntry = nextListEntry.Flink;
+
+                    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_11_006: [ IoTHubTransport_MQTT_Common_DoWork shall remove each reported state message whose entry in the device twin timeout heap has expired from the acknowledgement queue and call IoTHubClient_LL_ReportedStateComplete with a timeout status code. ] */
+                    while ((device_twin_item = (MQTT_DEVICE_TWIN_ITEM*)deadline_heap_pop_expired(transport_data->device_twin_timeouts, current_ms)) != NULL)
+                    {
+                        (void)DList_RemoveEntryList(&device_twin_item->entry);
+                        IoTHubClient_LL_ReportedStateComplete(transport_data->llClientHandle, device_twin_item->iothub_msg_id, STATUS_CODE_TIMEOUT_VALUE);
+                        free(device_twin_item);
+                    }
                 }
 
                 currentListEntry = transport_data->waitingToSend->Flink;
@@ -2587,11 +2429,19 @@ void IoTHubTransport_MQTT_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
                         else
                         {
                             mqttMsgEntry->retryCount = 0;
+                            mqttMsgEntry->timeout_entry = NULL;
                             mqttMsgEntry->iotHubMessageEntry = iothubMsgList;
                             mqttMsgEntry->packet_id = get_next_packet_id(transport_data);
-                            if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, messagePayload, messageLength) != 0)
+                            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_11_002: [ IoTHubTransport_MQTT_Common_DoWork shall index each telemetry message it publishes by packet id in the in-flight table, and leave the message in waitingToSend if that fails. ] */
+                            if (mqtt_inflight_table_add(transport_data->telemetry_inflight, mqttMsgEntry->packet_id, mqttMsgEntry) != 0)
+                            {
+                                LogError("Failure: unable to track packet id %d of the telemetry message.", (int)mqttMsgEntry->packet_id);
+                                free(mqttMsgEntry);
+                            }
+                            else if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, messagePayload, messageLength) != 0)
                             {
                                 (void)(DList_RemoveEntryList(currentListEntry));
+                                (void)mqtt_inflight_table_remove(transport_data->telemetry_inflight, mqttMsgEntry->packet_id);
                                 sendMsgComplete(iothubMsgList, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
                                 free(mqttMsgEntry);
                             }
@@ -2678,6 +2528,12 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_SetOption(TRANSPORT_LL_HANDLE h
             transport_data->option_sas_token_lifetime_secs = *sas_lifetime;
             result = IOTHUB_CLIENT_OK;
         }
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_11_012: [ If the option parameter is set to "reported_state_timeout_secs" then the value shall be a size_t_ptr and the value will determine how long a reported state waits for its response before it is completed with a timeout status code, 0 meaning no limit. ] */
+        else if (strcmp(OPTION_REPORTED_STATE_TIMEOUT_SECS, option) == 0)
+        {
+            transport_data->reported_state_timeout_secs = *((size_t*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
         else if (strcmp(OPTION_CONNECTION_TIMEOUT, option) == 0)
         {
             int* connection_time = (int*)value;
@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <limits.h>
 #include "azure_c_shared_utility/gballoc.h"
 
 #include <time.h>
@@ -10,6 +11,8 @@
 #include "iothub_client_private.h"
 #include "iothub_transport_ll.h"
 #include "iothubtransporthttp.h"
+#include "http_batch_payload.h"
+#include "http_connection_pool.h"
 
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
@@ -17,8 +20,9 @@
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
+#include "azure_c_shared_utility/optionhandler.h"
+#include "azure_c_shared_utility/shared_util_options.h"
 #include "azure_c_shared_utility/strings.h"
-#include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/httpheaders.h"
@@ -40,12 +44,14 @@ static const char* IOTHUB_CONTENT_ENCODING_C2D = "ContentEncoding";
 /*the default is 25 minutes*/
 #define DEFAULT_GETMINIMUMPOLLINGTIME ((unsigned int)25*60) 
 
+/*DEFAULT_GETMAXIMUMPOLLINGTIME is the longest time in seconds the interval between 2 GETs grows to while they return no message*/
+/*the default is 0, the interval never grows beyond DEFAULT_GETMINIMUMPOLLINGTIME*/
+#define DEFAULT_GETMAXIMUMPOLLINGTIME ((unsigned int)0)
+
 #define MAXIMUM_MESSAGE_SIZE (255*1024-1)
 #define MAXIMUM_PAYLOAD_OVERHEAD 384
 #define MAXIMUM_PROPERTY_OVERHEAD 16
 
-/*forward declaration*/
-static int appendMapToJSON(STRING_HANDLE existing, const char* const* keys, const char* const* values, size_t count);
 
 typedef struct HTTPTRANSPORT_HANDLE_DATA_TAG
 {
@@ -53,7 +59,11 @@ typedef struct HTTPTRANSPORT_HANDLE_DATA_TAG
     HTTPAPIEX_HANDLE httpApiExHandle;
     bool doBatchedTransfers;
     unsigned int getMinimumPollingTime;
+    unsigned int getMaximumPollingTime;
     VECTOR_HANDLE perDeviceList;
+    OPTIONHANDLER_HANDLE httpOptions; /*the options passed down to httpApiExHandle, given to the connections of connectionPool when it is created*/
+    HTTP_CONNECTION_POOL_HANDLE connectionPool; /*the connections besides httpApiExHandle, NULL while there is only one*/
+    size_t nextDeviceIndex; /*the device DoWork starts with, so that every device gets to be first in turn*/
 }HTTPTRANSPORT_HANDLE_DATA;
 
 typedef struct HTTPTRANSPORT_PERDEVICE_DATA_TAG
@@ -69,13 +79,20 @@ typedef struct HTTPTRANSPORT_PERDEVICE_DATA_TAG
     HTTP_HEADERS_HANDLE messageHTTPrequestHeaders;
     STRING_HANDLE abandonHTTPrelativePathBegin;
     HTTPAPIEX_SAS_HANDLE sasObject;
+    HTTPAPIEX_HANDLE httpApiExHandle; /*the connection the requests of the device go through, one of connectionPool's while DoWork runs it on a worker thread*/
     bool DoWork_PullMessage;
     time_t lastPollTime;
     bool isFirstPoll;
+    unsigned int pollingTime; /*seconds until the next GET, kept between getMinimumPollingTime and getMaximumPollingTime when used*/
+    bool isMessagePending; /*the last GET returned a message, the next one is likely to return another*/
 
     IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle;
     PDLIST_ENTRY waitingToSend;
     DLIST_ENTRY eventConfirmations; /*holds items for event confirmations*/
+    bool deferCallbacks; /*a worker thread of connectionPool works on the device, the callbacks are made afterwards by the thread calling DoWork*/
+    bool hasDeferredConfirmation; /*eventConfirmations holds items to be confirmed with deferredConfirmationResult*/
+    IOTHUB_CLIENT_CONFIRMATION_RESULT deferredConfirmationResult;
+    MESSAGE_CALLBACK_INFO* deferredMessage; /*the received message waiting for the message callback*/
 } HTTPTRANSPORT_PERDEVICE_DATA;
 
 typedef struct MESSAGE_DISPOSITION_CONTEXT_TAG
@@ -608,8 +625,14 @@ static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE han
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_128: [ IoTHubTransportHttp_Register shall mark this device as unsubscribed. ]*/
                 result->DoWork_PullMessage = false;
                 result->isFirstPoll = true;
+                result->pollingTime = 0;
+                result->isMessagePending = false;
+                result->httpApiExHandle = handleData->httpApiExHandle;
                 result->waitingToSend = waitingToSend;
                 DList_InitializeListHead(&(result->eventConfirmations));
+                result->deferCallbacks = false;
+                result->hasDeferredConfirmation = false;
+                result->deferredMessage = NULL;
                 result->transportHandle = (HTTPTRANSPORT_HANDLE_DATA *) handle;
             }
             else
@@ -849,6 +872,10 @@ static TRANSPORT_LL_HANDLE IoTHubTransportHttp_Create(const IOTHUBTRANSPORT_CONF
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_011: [ Otherwise, IoTHubTransportHttp_Create shall succeed and return a non-NULL value. ]*/
                 result->doBatchedTransfers = false;
                 result->getMinimumPollingTime = DEFAULT_GETMINIMUMPOLLINGTIME;
+                result->getMaximumPollingTime = DEFAULT_GETMAXIMUMPOLLINGTIME;
+                result->httpOptions = NULL;
+                result->connectionPool = NULL;
+                result->nextDeviceIndex = 0;
             }
             else
             {
@@ -882,6 +909,14 @@ static void IoTHubTransportHttp_Destroy(TRANSPORT_LL_HANDLE handle)
             free(perDeviceItem);
         }
 
+        if (handleData->connectionPool != NULL)
+        {
+            http_connection_pool_destroy(handleData->connectionPool);
+        }
+        if (handleData->httpOptions != NULL)
+        {
+            OptionHandler_Destroy(handleData->httpOptions);
+        }
         destroy_hostName((HTTPTRANSPORT_HANDLE_DATA *) handle);
         destroy_httpApiExHandle((HTTPTRANSPORT_HANDLE_DATA *) handle);
         destroy_perDeviceList((HTTPTRANSPORT_HANDLE_DATA *)handle);
@@ -988,365 +1023,156 @@ static int IoTHubTransportHttp_DeviceMethod_Response(IOTHUB_DEVICE_HANDLE handle
     return __FAILURE__;
 }
 
-/*produces a representation of the properties, if they exist*/
-/*if they do not exist, produces ""*/
-static int concat_Properties(STRING_HANDLE existing, MAP_HANDLE map, size_t* propertiesMessageSizeContribution)
+#define MAKE_PAYLOAD_RESULT_VALUES \
+    MAKE_PAYLOAD_OK, /*returned when there is a payload to be later send by HTTP*/ \
+    MAKE_PAYLOAD_NO_ITEMS, /*returned when there are no items to be send*/ \
+    MAKE_PAYLOAD_ERROR, /*returned when there were errors*/ \
+    MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT /*returned when the first item doesn't fit*/
+
+DEFINE_ENUM(MAKE_PAYLOAD_RESULT, MAKE_PAYLOAD_RESULT_VALUES);
+
+static void reversePutListBackIn(PDLIST_ENTRY source, PDLIST_ENTRY destination)
 {
-    int result;
-    const char*const* keys;
-    const char*const* values;
-    size_t count;
-    if (Map_GetInternals(map, &keys, &values, &count) != MAP_OK)
-    {
-        result = __FAILURE__;
-        LogError("error while Map_GetInternals");
-    }
-    else
-    {
+    /*this function takes a list, and inserts it in another list. When done in the context of this file, it reverses the effects of a not-able-to-send situation*/
+    DList_AppendTailList(destination->Flink, source);
+    DList_RemoveEntryList(source);
+    DList_InitializeListHead(source);
+}
 
-        if (count == 0)
-        {
-            /*Codes_SRS_TRANSPORTMULTITHTTP_17_064: [If IoTHubMessage does not have properties, then "properties":{...} shall be missing from the payload*/
-            /*no properties - do nothing with existing*/
-            result = 0;
-            *propertiesMessageSizeContribution = 0;
-        }
-        else
+/*this function assembles several {"body":"base64 encoding of the message content"," base64Encoded": true} into 1 payload*/
+/*the items are measured first, then written in place in a buffer allocated once for all of them*/
+/*Codes_SRS_TRANSPORTMULTITHTTP_17_056: [IoTHubTransportHttp_DoWork shall build the following string:[{"body":"base64 encoding of the message1 content"},{"body":"base64 encoding of the message2 content"}...]]*/
+static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData, BUFFER_HANDLE* payload)
+{
+    MAKE_PAYLOAD_RESULT result;
+    size_t allMessagesSize = 0;
+    size_t payloadSize = 1; /*the "[", the comma after the last item becomes the "]"*/
+    bool isFirst = true;
+    PDLIST_ENTRY actual;
+    bool keepGoing = true; /*keepGoing gets sometimes to false from within the loop*/
+                           /*either all the items enter the list or only some*/
+    result = MAKE_PAYLOAD_OK; /*optimistically initializing it*/
+    *payload = NULL;
+
+    while (keepGoing && ((actual = deviceData->waitingToSend->Flink) != deviceData->waitingToSend))
+    {
+        IOTHUB_MESSAGE_LIST* message = containingRecord(actual, IOTHUB_MESSAGE_LIST, entry);
+        size_t itemSize;
+        size_t messageSize;
+        if (http_batch_payload_measure_item(message->messageHandle, &itemSize, &messageSize) != 0)
         {
-            /*Codes_SRS_TRANSPORTMULTITHTTP_17_058: [If IoTHubMessage has properties, then they shall be serialized at the same level as "body" using the following pattern: "properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2*/
-            if (STRING_concat(existing, ",\"properties\":") != 0)
-            {
-                /*go ahead and return it*/
-                result = __FAILURE__;
-                LogError("failed STRING_concat");
-            }
-            else if (appendMapToJSON(existing, keys, values, count) != 0)
+            if (isFirst)
             {
-                result = __FAILURE__;
-                LogError("unable to append the properties");
+                /*first item failed to create, nothing to send*/
+                /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
+                result = MAKE_PAYLOAD_ERROR;
             }
             else
             {
-                /*all is fine*/
-                size_t i;
-                *propertiesMessageSizeContribution = 0;
-                for (i = 0;i < count;i++)
-                {
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_063: [Every property name shall add to the message size the length of the property name + the length of the property value + 16 bytes.] */
-                    *propertiesMessageSizeContribution += (strlen(keys[i]) + strlen(values[i]) + MAXIMUM_PROPERTY_OVERHEAD);
-                }
-                result = 0;
-            }
-        }
-    }
-    return result;
-}
-
-/*produces a JSON representation of the map : {"a": "value_of_a","b":"value_of_b"}*/
-static int appendMapToJSON(STRING_HANDLE existing, const char* const* keys, const char* const* values, size_t count) /*under consideration: move to MAP module when it has more than 1 user*/
-{
-    int result;
-    if (STRING_concat(existing, "{") != 0)
-    {
-        /*go on and return it*/
-        LogError("STRING_construct failed");
-        result = __FAILURE__;
-    }
-    else
-    {
-        size_t i;
-        for (i = 0; i < count; i++)
-        {
-            if (!(
-                (STRING_concat(existing, (i == 0) ? "\"" IOTHUB_APP_PREFIX : ",\"" IOTHUB_APP_PREFIX) == 0) &&
-                (STRING_concat(existing, keys[i]) == 0) &&
-                (STRING_concat(existing, "\":\"") == 0) &&
-                (STRING_concat(existing, values[i]) == 0) &&
-                (STRING_concat(existing, "\"") == 0)
-                ))
-            {
-                LogError("unable to STRING_concat");
-                break;
+                /*there are multiple payloads encoded, the last one had an internal error, just go with those*/
+                /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
             }
+            keepGoing = false;
         }
-
-        if (i < count)
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_065: [If the oldest message in waitingToSend causes the message size to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClient_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_BATCHSTATE_FAILED.]*/
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_061: [The message size shall be limited to 255KB - 1 byte.]*/
+        else if (isFirst && messageSize > MAXIMUM_MESSAGE_SIZE)
         {
-            result = __FAILURE__;
-            /*error, let it go through*/
+            PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
+            DList_InsertTailList(&(deviceData->eventConfirmations), head);
+            result = MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT;
+            keepGoing = false;
         }
-        else if (STRING_concat(existing, "}") != 0)
+        else if (allMessagesSize + messageSize > MAXIMUM_MESSAGE_SIZE)
         {
-            LogError("unable to STRING_concat");
-            result = __FAILURE__;
+            /*this item doesn't make it to the payload, but the payload is valid so far*/
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
+            keepGoing = false;
         }
         else
         {
-            /*all is fine*/
-            result = 0;
+            /*the item makes it to the payload, let's continue... */
+            PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
+            DList_InsertTailList(&(deviceData->eventConfirmations), head);
+            allMessagesSize += messageSize;
+            payloadSize += itemSize;
+            isFirst = false;
         }
     }
-    return result;
-}
 
-/*makes the following string:{"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]}*/
-/*return NULL if there was a failure, or a non-NULL STRING_HANDLE that contains the intended data*/
-static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeContribution)
-{
-    STRING_HANDLE result; /*temp wants to contain :{"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]}*/
-    IOTHUB_MESSAGE_LIST* message = containingRecord(item, IOTHUB_MESSAGE_LIST, entry);
-    IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(message->messageHandle);
-
-    switch (contentType)
-    {
-    case IOTHUBMESSAGE_BYTEARRAY:
+    if (result == MAKE_PAYLOAD_OK)
     {
-        result = STRING_construct("{\"body\":\"");
-        if (result == NULL)
-        {
-            LogError("unable to STRING_construct");
-        }
-        else
-        {
-            const unsigned char* source;
-            size_t size;
+        unsigned char* destination;
+        PDLIST_ENTRY item;
 
-            if (IoTHubMessage_GetByteArray(message->messageHandle, &source, &size) != IOTHUB_MESSAGE_OK)
-            {
-                LogError("unable to get the data for the message.");
-                STRING_delete(result);
-                result = NULL;
-            }
-            else
-            {
-                STRING_HANDLE encoded = Base64_Encode_Bytes(source, size);
-                if (encoded == NULL)
-                {
-                    LogError("unable to Base64_Encode_Bytes.");
-                    STRING_delete(result);
-                    result = NULL;
-                }
-                else
-                {
-                    size_t propertiesSize;
-                    if (!(
-                        (STRING_concat_with_STRING(result, encoded) == 0) &&
-                        (STRING_concat(result, "\"") == 0) && /*\" because closing value*/
-                        (concat_Properties(result, IoTHubMessage_Properties(message->messageHandle), &propertiesSize) == 0) &&
-                        (STRING_concat(result, "},") == 0) /*the last comma shall be replaced by a ']' by DaCr's suggestion (which is awesome enough to receive credits in the source code)*/
-                        ))
-                    {
-                        STRING_delete(result);
-                        result = NULL;
-                        LogError("unable to STRING_concat_with_STRING.");
-                    }
-                    else
-                    {
-                        /*all is fine... */
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_062: [The message size is computed from the length of the payload + 384.] */
-                        *messageSizeContribution = size + MAXIMUM_PAYLOAD_OVERHEAD + propertiesSize;
-                    }
-                    STRING_delete(encoded);
-                }
-            }
+        if ((*payload = BUFFER_new()) == NULL)
+        {
+            LogError("unable to BUFFER_new");
+            result = MAKE_PAYLOAD_ERROR;
         }
-        break;
-    }
-    /*Codes_SRS_TRANSPORTMULTITHTTP_17_057: [If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false}] */
-    case IOTHUBMESSAGE_STRING:
-    {
-        result = STRING_construct("{\"body\":");
-        if (result == NULL)
+        else if ((BUFFER_pre_build(*payload, payloadSize) != 0) ||
+            ((destination = BUFFER_u_char(*payload)) == NULL))
         {
-            LogError("unable to STRING_construct");
+            LogError("unable to allocate %lu bytes for the payload", (unsigned long)payloadSize);
+            result = MAKE_PAYLOAD_ERROR;
         }
         else
         {
-            const char* source = IoTHubMessage_GetString(message->messageHandle);
-            if (source == NULL)
-            {
-                LogError("unable to IoTHubMessage_GetString");
-                STRING_delete(result);
-                result = NULL;
-            }
-            else
+            size_t position = 1;
+            destination[0] = '[';
+            for (item = deviceData->eventConfirmations.Flink; item != &(deviceData->eventConfirmations); item = item->Flink)
             {
-                STRING_HANDLE asJson = STRING_new_JSON(source);
-                if (asJson == NULL)
-                {
-                    LogError("unable to STRING_new_JSON");
-                    STRING_delete(result);
-                    result = NULL;
-                }
-                else
+                IOTHUB_MESSAGE_LIST* message = containingRecord(item, IOTHUB_MESSAGE_LIST, entry);
+                size_t itemSize;
+                if (http_batch_payload_write_item(message->messageHandle, destination + position, payloadSize - position, &itemSize) != 0)
                 {
-                    size_t propertiesSize;
-                    if (!(
-                        (STRING_concat_with_STRING(result, asJson) == 0) &&
-                        (STRING_concat(result, ",\"base64Encoded\":false") == 0) &&
-                        (concat_Properties(result, IoTHubMessage_Properties(message->messageHandle), &propertiesSize) == 0) &&
-                        (STRING_concat(result, "},") == 0) /*the last comma shall be replaced by a ']' by DaCr's suggestion (which is awesome enough to receive credits in the source code)*/
-                        ))
-                    {
-                        LogError("unable to STRING_concat_with_STRING");
-                        STRING_delete(result);
-                        result = NULL;
-                    }
-                    else
-                    {
-                        /*result has the intended content*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_062: [The message size is computed from the length of the payload + 384.] */
-                        *messageSizeContribution = strlen(source) + MAXIMUM_PAYLOAD_OVERHEAD + propertiesSize;
-                    }
-                    STRING_delete(asJson);
+                    LogError("unable to write an item of the payload");
+                    result = MAKE_PAYLOAD_ERROR;
+                    break;
                 }
+                position += itemSize;
             }
-        }
-        break;
-    }
-    default:
-    {
-        LogError("an unknown message type was encountered (%d)", contentType);
-        result = NULL; /*unknown message type*/
-        break;
-    }
-    }
-    return result;
-}
-
-#define MAKE_PAYLOAD_RESULT_VALUES \
-    MAKE_PAYLOAD_OK, /*returned when there is a payload to be later send by HTTP*/ \
-    MAKE_PAYLOAD_NO_ITEMS, /*returned when there are no items to be send*/ \
-    MAKE_PAYLOAD_ERROR, /*returned when there were errors*/ \
-    MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT /*returned when the first item doesn't fit*/
-
-DEFINE_ENUM(MAKE_PAYLOAD_RESULT, MAKE_PAYLOAD_RESULT_VALUES);
 
-/*this function assembles several {"body":"base64 encoding of the message content"," base64Encoded": true} into 1 payload*/
-/*Codes_SRS_TRANSPORTMULTITHTTP_17_056: [IoTHubTransportHttp_DoWork shall build the following string:[{"body":"base64 encoding of the message1 content"},{"body":"base64 encoding of the message2 content"}...]]*/
-static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData, STRING_HANDLE* payload)
-{
-    MAKE_PAYLOAD_RESULT result;
-    size_t allMessagesSize = 0;
-    *payload = STRING_construct("[");
-    if (*payload == NULL)
-    {
-        LogError("unable to STRING_construct");
-        result = MAKE_PAYLOAD_ERROR;
-    }
-    else
-    {
-        bool isFirst = true;
-        PDLIST_ENTRY actual;
-        bool keepGoing = true; /*keepGoing gets sometimes to false from within the loop*/
-                               /*either all the items enter the list or only some*/
-        result = MAKE_PAYLOAD_OK; /*optimistically initializing it*/
-        while (keepGoing && ((actual = deviceData->waitingToSend->Flink) != deviceData->waitingToSend))
-        {
-            size_t messageSize;
-            STRING_HANDLE temp = make1EventJSONitem(actual, &messageSize);
-            if (isFirst)
+            if (result == MAKE_PAYLOAD_OK && position != payloadSize)
             {
-                isFirst = false;
-                /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                if (temp == NULL) /*first item failed to create, nothing to send*/
-                {
-                    result = MAKE_PAYLOAD_ERROR;
-                    STRING_delete(*payload);
-                    *payload = NULL;
-                    keepGoing = false;
-                }
-                else
-                {
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_065: [If the oldest message in waitingToSend causes the message size to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClient_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_BATCHSTATE_FAILED.]*/
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_061: [The message size shall be limited to 255KB - 1 byte.]*/
-                    if (messageSize > MAXIMUM_MESSAGE_SIZE)
-                    {
-                        PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                        DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                        result = MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT;
-                        STRING_delete(*payload);
-                        *payload = NULL;
-                        keepGoing = false;
-                    }
-                    else
-                    {
-                        if (STRING_concat_with_STRING(*payload, temp) != 0)
-                        {
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                            result = MAKE_PAYLOAD_ERROR;
-                            STRING_delete(*payload);
-                            *payload = NULL;
-                            keepGoing = false;
-                        }
-                        else
-                        {
-                            /*first item was put nicely in the payload*/
-                            PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                            DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                            allMessagesSize += messageSize;
-                        }
-                    }
-                    STRING_delete(temp);
-                }
+                LogError("the payload takes %lu bytes instead of %lu", (unsigned long)position, (unsigned long)payloadSize);
+                result = MAKE_PAYLOAD_ERROR;
             }
-            else
+            else if (result == MAKE_PAYLOAD_OK)
             {
-                /*there is at least 1 item already in the payload*/
-                if (temp == NULL)
-                {
-                    /*there are multiple payloads encoded, the last one had an internal error, just go with those - closing the payload happens "after the loop"*/
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                    result = MAKE_PAYLOAD_OK;
-                    keepGoing = false;
-                }
-                else
-                {
-                    if (allMessagesSize + messageSize > MAXIMUM_MESSAGE_SIZE)
-                    {
-                        /*this item doesn't make it to the payload, but the payload is valid so far*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                        result = MAKE_PAYLOAD_OK;
-                        keepGoing = false;
-                    }
-                    else if (STRING_concat_with_STRING(*payload, temp) != 0)
-                    {
-                        /*should still send what there is so far...*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                        result = MAKE_PAYLOAD_OK;
-                        keepGoing = false;
-                    }
-                    else
-                    {
-                        /*cool, the payload made it there, let's continue... */
-                        PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                        DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                        allMessagesSize += messageSize;
-                    }
-                    STRING_delete(temp);
-                }
+                /*closing the payload: the last comma becomes the "]"*/
+                destination[payloadSize - 1] = ']';
             }
         }
 
-        /*closing the payload*/
-        if (result == MAKE_PAYLOAD_OK)
+        if (result != MAKE_PAYLOAD_OK)
         {
-            ((char*)STRING_c_str(*payload))[STRING_length(*payload) - 1] = ']'; /*TODO - do this in STRING_HANDLE*/
-        }
-        else
-        {
-            /*no need to close anything*/
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
+            if (*payload != NULL)
+            {
+                BUFFER_delete(*payload);
+                *payload = NULL;
+            }
+            reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
         }
     }
+
     return result;
 }
 
-static void reversePutListBackIn(PDLIST_ENTRY source, PDLIST_ENTRY destination)
+static void complete_events(HTTPTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_CONFIRMATION_RESULT confirmationResult)
 {
-    /*this function takes a list, and inserts it in another list. When done in the context of this file, it reverses the effects of a not-able-to-send situation*/
-    DList_AppendTailList(destination->Flink, source);
-    DList_RemoveEntryList(source);
-    DList_InitializeListHead(source);
+    if (deviceData->deferCallbacks)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_11_012: [ While a worker thread of the pool works on a device, IoTHubClient_LL_SendComplete and IoTHubClient_LL_MessageCallback shall not be called; IoTHubTransportHttp_DoWork shall call them for every device once http_connection_pool_run returns. ]*/
+        /*the items stay in eventConfirmations until then*/
+        deviceData->hasDeferredConfirmation = true;
+        deviceData->deferredConfirmationResult = confirmationResult;
+    }
+    else
+    {
+        IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), confirmationResult); /*takes care of emptying the list too*/
+    }
 }
 
 static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
@@ -1370,72 +1196,51 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
             else
             {
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_059: [It shall inspect the "waitingToSend" DLIST passed in config structure.] */
-                STRING_HANDLE payload;
+                BUFFER_HANDLE payload;
                 switch (makePayload(deviceData, &payload))
                 {
                 case MAKE_PAYLOAD_OK:
                 {
                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_068: [Once a final payload has been obtained, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters:] */
-                    BUFFER_HANDLE temp = BUFFER_new();
-                    if (temp == NULL)
+                    unsigned int statusCode;
+                    if (HTTPAPIEX_SAS_ExecuteRequest(
+                        deviceData->sasObject,
+                        deviceData->httpApiExHandle,
+                        HTTPAPI_REQUEST_POST,
+                        STRING_c_str(deviceData->eventHTTPrelativePath),
+                        deviceData->eventHTTPrequestHeaders,
+                        payload,
+                        &statusCode,
+                        NULL,
+                        NULL
+                        ) != HTTPAPIEX_OK)
                     {
-                        LogError("unable to BUFFER_new");
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
+                        LogError("unable to HTTPAPIEX_ExecuteRequest");
+                        //items go back to waitingToSend
+                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
                         reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
                     }
                     else
                     {
-                        if (BUFFER_build(temp, (const unsigned char*)STRING_c_str(payload), STRING_length(payload)) != 0)
+                        if (statusCode < 300)
                         {
-                            LogError("unable to BUFFER_build");
-                            //items go back to waitingToSend
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                            reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_070: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list containing all the items batched, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The batched items shall be removed from waitingToSend.] */
+                            complete_events(deviceData, iotHubClientHandle, IOTHUB_CLIENT_CONFIRMATION_OK);
                         }
                         else
                         {
-                            unsigned int statusCode;
-                            if (HTTPAPIEX_SAS_ExecuteRequest(
-                                deviceData->sasObject,
-                                handleData->httpApiExHandle,
-                                HTTPAPI_REQUEST_POST,
-                                STRING_c_str(deviceData->eventHTTPrelativePath),
-                                deviceData->eventHTTPrequestHeaders,
-                                temp,
-                                &statusCode,
-                                NULL,
-                                NULL
-                                ) != HTTPAPIEX_OK)
-                            {
-                                LogError("unable to HTTPAPIEX_ExecuteRequest");
-                                //items go back to waitingToSend
-                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
-                                reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
-                            }
-                            else
-                            {
-                                if (statusCode < 300)
-                                {
-                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_070: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list containing all the items batched, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The batched items shall be removed from waitingToSend.] */
-                                    IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK);
-                                }
-                                else
-                                {
-                                    //items go back to waitingToSend
-                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
-                                    LogError("unexpected HTTP status code (%u)", statusCode);
-                                    reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
-                                }
-                            }
+                            //items go back to waitingToSend
+                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
+                            LogError("unexpected HTTP status code (%u)", statusCode);
+                            reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
                         }
-                        BUFFER_delete(temp);
                     }
-                    STRING_delete(payload);
+                    BUFFER_delete(payload);
                     break;
                 }
                 case MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT:
                 {
-                    IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_ERROR); /*takes care of emptying the list too*/
+                    complete_events(deviceData, iotHubClientHandle, IOTHUB_CLIENT_CONFIRMATION_ERROR);
                     break;
                 }
                 case MAKE_PAYLOAD_ERROR:
@@ -1489,7 +1294,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                 {
                     PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
                     DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                    IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_ERROR); /*takes care of emptying the list too*/
+                    complete_events(deviceData, iotHubClientHandle, IOTHUB_CLIENT_CONFIRMATION_ERROR);
                 }
                 else
                 {
@@ -1512,14 +1317,12 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                         else
                         {
                             /*Codes_SRS_TRANSPORTMULTITHTTP_17_078: [Every message property "property":"value" shall be added to the HTTP headers as an individual header "iothub-app-property":"value".] */
-                            MAP_HANDLE map = IoTHubMessage_Properties(message->messageHandle);
-                            const char*const* keys;
-                            const char*const* values;
+                            const IOTHUB_MESSAGE_PROPERTY* properties;
                             size_t count;
-                            if (Map_GetInternals(map, &keys, &values, &count) != MAP_OK)
+                            if (IoTHubMessage_GetPropertyTable(message->messageHandle, &properties, &count) != IOTHUB_MESSAGE_OK)
                             {
                                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
-                                LogError("unable to Map_GetInternals");
+                                LogError("unable to IoTHubMessage_GetPropertyTable");
                             }
                             else
                             {
@@ -1533,13 +1336,13 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                 for (i = 0; (i < count) && goOn; i++)
                                 {
                                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_074: [Every property name shall add  to the message size the length of the property name + the length of the property value + 16 bytes.] */
-                                    messageSize += (strlen(values[i]) + strlen(keys[i]) + MAXIMUM_PROPERTY_OVERHEAD);
+                                    messageSize += (properties[i].valueLength + properties[i].keyLength + MAXIMUM_PROPERTY_OVERHEAD);
                                     if (messageSize > MAXIMUM_MESSAGE_SIZE)
                                     {
                                         /*Codes_SRS_TRANSPORTMULTITHTTP_17_072: [The message size shall be limited to 255KB -1 bytes.] */
                                         PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
                                         DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                                        IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_ERROR); /*takes care of emptying the list too*/
+                                        complete_events(deviceData, iotHubClientHandle, IOTHUB_CLIENT_CONFIRMATION_ERROR);
                                         goOn = false;
                                     }
                                     else
@@ -1553,7 +1356,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                         }
                                         else
                                         {
-                                            if (STRING_concat(temp, keys[i]) != 0)
+                                            if (STRING_concat(temp, properties[i].key) != 0)
                                             {
                                                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
                                                 LogError("unable to STRING_concat");
@@ -1561,7 +1364,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                             }
                                             else
                                             {
-                                                if (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, STRING_c_str(temp), values[i]) != HTTP_HEADERS_OK)
+                                                if (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, STRING_c_str(temp), properties[i].value) != HTTP_HEADERS_OK)
                                                 {
                                                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
                                                     LogError("unable to HTTPHeaders_ReplaceHeaderNameValuePair");
@@ -1649,7 +1452,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
 
                                                 /*Codes_SRS_TRANSPORTMULTITHTTP_03_003: [If a deviceSasToken exists, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_ExecuteRequest passing the following parameters] */
                                                 else if ((r = HTTPAPIEX_ExecuteRequest(
-                                                    handleData->httpApiExHandle,
+                                                    deviceData->httpApiExHandle,
                                                     HTTPAPI_REQUEST_POST,
                                                     STRING_c_str(deviceData->eventHTTPrelativePath),
                                                     clonedEventHTTPrequestHeaders,
@@ -1667,7 +1470,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_080: [If a deviceSasToken does not exist, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters] */
                                                 if ((r = HTTPAPIEX_SAS_ExecuteRequest(
                                                     deviceData->sasObject,
-                                                    handleData->httpApiExHandle,
+                                                    deviceData->httpApiExHandle,
                                                     HTTPAPI_REQUEST_POST,
                                                     STRING_c_str(deviceData->eventHTTPrelativePath),
                                                     clonedEventHTTPrequestHeaders,
@@ -1687,7 +1490,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_082: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list the item send, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The item shall be removed from waitingToSend.] */
                                                     PDLIST_ENTRY justSent = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
                                                     DList_InsertTailList(&(deviceData->eventConfirmations), justSent);
-                                                    IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK); /*takes care of emptying the list too*/
+                                                    complete_events(deviceData, iotHubClientHandle, IOTHUB_CLIENT_CONFIRMATION_OK);
                                                 }
                                                 else
                                                 {
@@ -1709,7 +1512,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
     }
 }
 
-static bool abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, const char* ETag, IOTHUBMESSAGE_DISPOSITION_RESULT action)
+static bool abandonOrAcceptMessage(HTTPTRANSPORT_PERDEVICE_DATA* deviceData, const char* ETag, IOTHUBMESSAGE_DISPOSITION_RESULT action)
 {
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_097: [_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest with the following parameters:
     -requestType: POST
@@ -1816,7 +1619,7 @@ static bool abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTR
                                 result = false;
                             }
                             else if ((r = HTTPAPIEX_ExecuteRequest(
-                                handleData->httpApiExHandle,
+                                deviceData->httpApiExHandle,
                                 (action == IOTHUBMESSAGE_ABANDONED) ? HTTPAPI_REQUEST_POST : HTTPAPI_REQUEST_DELETE,                               /*-requestType: POST                                                                                                       */
                                 STRING_c_str(fullAbandonRelativePath),              /*-relativePath: abandon relative path begin (as created by _Create) + value of ETag + "/abandon?api-version=2016-11-14"   */
                                 abandonRequestHttpHeaders,                          /*- requestHttpHeadersHandle: an HTTP headers instance containing the following                                            */
@@ -1835,7 +1638,7 @@ static bool abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTR
                         }
                         else if ((r = HTTPAPIEX_SAS_ExecuteRequest(
                             deviceData->sasObject,
-                            handleData->httpApiExHandle,
+                            deviceData->httpApiExHandle,
                             (action == IOTHUBMESSAGE_ABANDONED) ? HTTPAPI_REQUEST_POST : HTTPAPI_REQUEST_DELETE,                               /*-requestType: POST                                                                                                       */
                             STRING_c_str(fullAbandonRelativePath),              /*-relativePath: abandon relative path begin (as created by _Create) + value of ETag + "/abandon?api-version=2016-11-14"   */
                             abandonRequestHttpHeaders,                          /*- requestHttpHeadersHandle: an HTTP headers instance containing the following                                            */
@@ -1921,7 +1724,7 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SendMessageDisposition(MESSAGE_C
                 }
                 else
                 {
-                    if (abandonOrAcceptMessage(tc->handleData, tc->deviceData, tc->etagValue, disposition))
+                    if (abandonOrAcceptMessage(tc->deviceData, tc->etagValue, disposition))
                     {
                         result = IOTHUB_CLIENT_OK;
                     }
@@ -1993,6 +1796,59 @@ static MESSAGE_CALLBACK_INFO* MESSAGE_CALLBACK_INFO_Create(IOTHUB_MESSAGE_HANDLE
     return result;
 }
 
+static unsigned int get_polling_time(const HTTPTRANSPORT_HANDLE_DATA* handleData, const HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    /*clamped here rather than when stored, so that changing either option applies to the next GET of every device*/
+    unsigned int result = deviceData->pollingTime;
+    if (result > handleData->getMaximumPollingTime)
+    {
+        result = handleData->getMaximumPollingTime;
+    }
+    if (result < handleData->getMinimumPollingTime)
+    {
+        result = handleData->getMinimumPollingTime;
+    }
+    return result;
+}
+
+static void update_polling_time(const HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, bool wasMessageReceived)
+{
+    if (wasMessageReceived)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_11_002: [ A GET that returns a message shall bring the interval between GETs back to GetMinimumPollingTime and, if MaximumPollingTime is above MinimumPollingTime, allow the next GET no matter how much time has passed. ]*/
+        deviceData->pollingTime = 0;
+        /*with the default options the GETs keep to MinimumPollingTime, as they always did*/
+        deviceData->isMessagePending = (handleData->getMaximumPollingTime > handleData->getMinimumPollingTime);
+    }
+    else
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_11_003: [ Any other completed GET shall double the interval between GETs, up to GetMaximumPollingTime. ]*/
+        unsigned int pollingTime = get_polling_time(handleData, deviceData);
+        deviceData->pollingTime = (pollingTime == 0) ? 1 : (pollingTime > UINT_MAX / 2) ? UINT_MAX : 2 * pollingTime;
+        deviceData->isMessagePending = false;
+    }
+}
+
+static void deliver_message(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, MESSAGE_CALLBACK_INFO* messageData)
+{
+    bool abandon;
+    if (IoTHubClient_LL_MessageCallback(iotHubClientHandle, messageData))
+    {
+        abandon = false;
+    }
+    else
+    {
+        LogError("IoTHubClient_LL_MessageCallback failed");
+        abandon = true;
+    }
+
+    /*Codes_SRS_TRANSPORTMULTITHTTP_17_096: [If IoTHubClient_LL_MessageCallback returns false then _DoWork shall "abandon" the message.] */
+    if (abandon)
+    {
+        (void)IoTHubTransportHttp_SendMessageDisposition(messageData, IOTHUBMESSAGE_ABANDONED);
+    }
+}
+
 static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
 {
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_083: [ If device is not subscribed then _DoWork shall advance to the next action. ] */
@@ -2001,10 +1857,14 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_123: [After client creation, the first GET shall be allowed no matter what the value of GetMinimumPollingTime.] */
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_124: [If time is not available then all calls shall be treated as if they are the first one.] */
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_122: [A GET request that happens earlier than GetMinimumPollingTime shall be ignored.] */
+        /*Codes_SRS_TRANSPORTMULTITHTTP_11_001: [ A GET request that happens earlier than the current interval between GETs, which starts at GetMinimumPollingTime, shall be ignored. ]*/
         time_t timeNow = get_time(NULL);
-        bool isPollingAllowed = deviceData->isFirstPoll || (timeNow == (time_t)(-1)) || (get_difftime(timeNow, deviceData->lastPollTime) > handleData->getMinimumPollingTime);
+        bool isPollingAllowed = deviceData->isFirstPoll || deviceData->isMessagePending || (timeNow == (time_t)(-1)) || (get_difftime(timeNow, deviceData->lastPollTime) > get_polling_time(handleData, deviceData));
         if (isPollingAllowed)
         {
+            /*a GET that fails before completing does not count as returning a message, so it is not retried at once*/
+            deviceData->isMessagePending = false;
+
             HTTP_HEADERS_HANDLE responseHTTPHeaders = HTTPHeaders_Alloc();
             if (responseHTTPHeaders == NULL)
             {
@@ -2033,7 +1893,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                             LogError("Unable to replace the old SAS Token.");
                         }
                         else if ((r = HTTPAPIEX_ExecuteRequest(
-                            handleData->httpApiExHandle,
+                            deviceData->httpApiExHandle,
                             HTTPAPI_REQUEST_GET,                                            /*requestType: GET*/
                             STRING_c_str(deviceData->messageHTTPrelativePath),         /*relativePath: the message HTTP relative path*/
                             deviceData->messageHTTPrequestHeaders,                     /*requestHttpHeadersHandle: message HTTP request headers created by _Create*/
@@ -2059,7 +1919,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                     */
                     else if ((r = HTTPAPIEX_SAS_ExecuteRequest(
                         deviceData->sasObject,
-                        handleData->httpApiExHandle,
+                        deviceData->httpApiExHandle,
                         HTTPAPI_REQUEST_GET,                                            /*requestType: GET*/
                         STRING_c_str(deviceData->messageHTTPrelativePath),         /*relativePath: the message HTTP relative path*/
                         deviceData->messageHTTPrequestHeaders,                     /*requestHttpHeadersHandle: message HTTP request headers created by _Create*/
@@ -2084,6 +1944,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                             deviceData->isFirstPoll = false;
                             deviceData->lastPollTime = timeNow;
                         }
+                        update_polling_time(handleData, deviceData, statusCode == 200);
                         if (statusCode == 204)
                         {
                             /*Codes_SRS_TRANSPORTMULTITHTTP_17_086: [If the HTTPAPIEX_SAS_ExecuteRequest executed successfully then status code shall be examined. Any status code different than 200 causes _DoWork to advance to the next action.] */
@@ -2128,7 +1989,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                                     {
                                         /*Codes_SRS_TRANSPORTMULTITHTTP_17_092: [If assembling the message fails in any way, then _DoWork shall "abandon" the message.]*/
                                         LogError("unable to IoTHubMessage_CreateFromByteArray, trying to abandon the message... ");
-                                        if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
+                                        if (!abandonOrAcceptMessage(deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
                                         {
                                             LogError("HTTP Transport layer failed to report ABANDON disposition");
                                         }
@@ -2141,7 +2002,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                                         if (HTTPHeaders_GetHeaderCount(responseHTTPHeaders, &nHeaders) != HTTP_HEADERS_OK)
                                         {
                                             LogError("unable to get the count of HTTP headers");
-                                            if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
+                                            if (!abandonOrAcceptMessage(deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
                                             {
                                                 LogError("HTTP Transport layer failed to report ABANDON disposition");
                                             }
@@ -2237,7 +2098,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
 
                                             if (i < nHeaders)
                                             {
-                                                if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
+                                                if (!abandonOrAcceptMessage(deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
                                                 {
                                                     LogError("HTTP Transport layer failed to report ABANDON disposition");
                                                 }
@@ -2249,29 +2110,19 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                                                 {
                                                     /*Codes_SRS_TRANSPORTMULTITHTTP_10_006: [If assembling the transport context fails, _DoWork shall "abandon" the message.] */
                                                     LogError("failed to assemble callback info");
-                                                    if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
+                                                    if (!abandonOrAcceptMessage(deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
                                                     {
                                                         LogError("HTTP Transport layer failed to report ABANDON disposition");
                                                     }
                                                 }
+                                                else if (deviceData->deferCallbacks)
+                                                {
+                                                    /*Codes_SRS_TRANSPORTMULTITHTTP_11_012: [ While a worker thread of the pool works on a device, IoTHubClient_LL_SendComplete and IoTHubClient_LL_MessageCallback shall not be called; IoTHubTransportHttp_DoWork shall call them for every device once http_connection_pool_run returns. ]*/
+                                                    deviceData->deferredMessage = messageData;
+                                                }
                                                 else
                                                 {
-                                                    bool abandon;
-                                                    if (IoTHubClient_LL_MessageCallback(iotHubClientHandle, messageData))
-                                                    {
-                                                        abandon = false;
-                                                    }
-                                                    else
-                                                    {
-                                                        LogError("IoTHubClient_LL_MessageCallback failed");
-                                                        abandon = true;
-                                                    }
-
-                                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_096: [If IoTHubClient_LL_MessageCallback returns false then _DoWork shall "abandon" the message.] */
-                                                    if (abandon)
-                                                    {
-                                                        (void)IoTHubTransportHttp_SendMessageDisposition(messageData, IOTHUBMESSAGE_ABANDONED);
-                                                    }
+                                                    deliver_message(iotHubClientHandle, messageData);
                                                 }
                                             }
                                         }
@@ -2303,6 +2154,19 @@ static IOTHUB_PROCESS_ITEM_RESULT IoTHubTransportHttp_ProcessItem(TRANSPORT_LL_H
     return IOTHUB_PROCESS_ERROR;
 }
 
+static void DoPooledDeviceWork(void* context, size_t item, HTTPAPIEX_HANDLE connection)
+{
+    HTTPTRANSPORT_HANDLE_DATA* handleData = (HTTPTRANSPORT_HANDLE_DATA*)context;
+    HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)VECTOR_element(handleData->perDeviceList, item);
+
+    perDeviceItem->httpApiExHandle = connection;
+    perDeviceItem->deferCallbacks = true;
+    DoEvent(handleData, perDeviceItem, perDeviceItem->iotHubClientHandle);
+    DoMessages(handleData, perDeviceItem, perDeviceItem->iotHubClientHandle);
+    /*the worker threads are idle between two DoWork, dispositions sent from then on go through httpApiExHandle*/
+    perDeviceItem->httpApiExHandle = handleData->httpApiExHandle;
+}
+
 static void IoTHubTransportHttp_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
 {
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_049: [ If handle is NULL, then IoTHubTransportHttp_DoWork shall do nothing. ]*/
@@ -2314,16 +2178,47 @@ static void IoTHubTransportHttp_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT
         HTTPTRANSPORT_HANDLE_DATA* handleData = (HTTPTRANSPORT_HANDLE_DATA*)handle;
         IOTHUB_DEVICE_HANDLE* listItem;
         size_t deviceListSize = VECTOR_size(handleData->perDeviceList);
-        /*Codes_SRS_TRANSPORTMULTITHTTP_17_052: [ IoTHubTransportHttp_DoWork shall perform a round-robin loop through every deviceHandle in the transport device list, using the iotHubClientHandle field saved in the IOTHUB_DEVICE_HANDLE. ]*/
-        /*Codes_SRS_TRANSPORTMULTITHTTP_17_050: [ IoTHubTransportHttp_DoWork shall call loop through the device list. ] */
-        /*Codes_SRS_TRANSPORTMULTITHTTP_17_051: [ IF the list is empty, then IoTHubTransportHttp_DoWork shall do nothing. ]*/
-        for (size_t i = 0; i < deviceListSize; i++)
+        if (handleData->connectionPool != NULL && deviceListSize > 1)
         {
-            listItem = (IOTHUB_DEVICE_HANDLE *) VECTOR_element(handleData->perDeviceList, i);
-            HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)(listItem);
-            DoEvent(handleData, perDeviceItem, perDeviceItem->iotHubClientHandle);
-            DoMessages(handleData, perDeviceItem, perDeviceItem->iotHubClientHandle);
+            /*Codes_SRS_TRANSPORTMULTITHTTP_11_005: [ If the transport has more than one connection and more than one device, IoTHubTransportHttp_DoWork shall work on the devices in parallel by calling http_connection_pool_run, starting with the device after the one it started with the previous time. ]*/
+            size_t firstDevice = handleData->nextDeviceIndex % deviceListSize;
+            handleData->nextDeviceIndex = firstDevice + 1;
+            if (http_connection_pool_run(handleData->connectionPool, handleData->httpApiExHandle, deviceListSize, firstDevice, DoPooledDeviceWork, handleData) != 0)
+            {
+                LogError("http_connection_pool_run failed");
+            }
+
+            /*Codes_SRS_TRANSPORTMULTITHTTP_11_012: [ While a worker thread of the pool works on a device, IoTHubClient_LL_SendComplete and IoTHubClient_LL_MessageCallback shall not be called; IoTHubTransportHttp_DoWork shall call them for every device once http_connection_pool_run returns. ]*/
+            for (size_t i = 0; i < deviceListSize; i++)
+            {
+                HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)VECTOR_element(handleData->perDeviceList, i);
+                perDeviceItem->deferCallbacks = false;
+                if (perDeviceItem->hasDeferredConfirmation)
+                {
+                    perDeviceItem->hasDeferredConfirmation = false;
+                    IoTHubClient_LL_SendComplete(perDeviceItem->iotHubClientHandle, &(perDeviceItem->eventConfirmations), perDeviceItem->deferredConfirmationResult); /*takes care of emptying the list too*/
+                }
+                if (perDeviceItem->deferredMessage != NULL)
+                {
+                    MESSAGE_CALLBACK_INFO* messageData = perDeviceItem->deferredMessage;
+                    perDeviceItem->deferredMessage = NULL;
+                    deliver_message(perDeviceItem->iotHubClientHandle, messageData);
+                }
+            }
+        }
+        else
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_052: [ IoTHubTransportHttp_DoWork shall perform a round-robin loop through every deviceHandle in the transport device list, using the iotHubClientHandle field saved in the IOTHUB_DEVICE_HANDLE. ]*/
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_050: [ IoTHubTransportHttp_DoWork shall call loop through the device list. ] */
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_051: [ IF the list is empty, then IoTHubTransportHttp_DoWork shall do nothing. ]*/
+            for (size_t i = 0; i < deviceListSize; i++)
+            {
+                listItem = (IOTHUB_DEVICE_HANDLE *) VECTOR_element(handleData->perDeviceList, i);
+                HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)(listItem);
+                DoEvent(handleData, perDeviceItem, perDeviceItem->iotHubClientHandle);
+                DoMessages(handleData, perDeviceItem, perDeviceItem->iotHubClientHandle);
 
+            }
         }
     }
     else
@@ -2377,6 +2272,111 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_GetSendStatus(IOTHUB_DEVICE_HAND
     return result;
 }
 
+static void* clone_http_option(const char* name, const void* value)
+{
+    const void* result;
+    if (HTTPAPI_CloneOption(name, value, &result) != HTTPAPI_OK)
+    {
+        LogError("HTTPAPI_CloneOption failed for option %s", name);
+        result = NULL;
+    }
+    return (void*)result;
+}
+
+static void destroy_http_option(const char* name, const void* value)
+{
+    if (strcmp(name, OPTION_HTTP_PROXY) == 0)
+    {
+        HTTP_PROXY_OPTIONS* proxyOptions = (HTTP_PROXY_OPTIONS*)value;
+        free((void*)proxyOptions->host_address);
+        free((void*)proxyOptions->username);
+        free((void*)proxyOptions->password);
+    }
+    free((void*)value);
+}
+
+static int set_http_option(void* handle, const char* name, const void* value)
+{
+    int result;
+    if (HTTPAPIEX_SetOption((HTTPAPIEX_HANDLE)handle, name, value) != HTTPAPIEX_OK)
+    {
+        LogError("HTTPAPIEX_SetOption failed for option %s", name);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+/*Codes_SRS_TRANSPORTMULTITHTTP_11_010: [ An option passed down to HTTPAPIEX shall be saved by calling OptionHandler_AddOption, so that the connections created later get it too, and set on the connections of the pool by calling http_connection_pool_set_option. ]*/
+static IOTHUB_CLIENT_RESULT share_http_option(HTTPTRANSPORT_HANDLE_DATA* handleData, const char* option, const void* value)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (handleData->httpOptions == NULL &&
+        (handleData->httpOptions = OptionHandler_Create(clone_http_option, destroy_http_option, set_http_option)) == NULL)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LogError("OptionHandler_Create failed");
+    }
+    else if (OptionHandler_AddOption(handleData->httpOptions, option, value) != OPTIONHANDLER_OK)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LogError("OptionHandler_AddOption failed for option %s", option);
+    }
+    else if (handleData->connectionPool != NULL && http_connection_pool_set_option(handleData->connectionPool, option, value) != 0)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LogError("http_connection_pool_set_option failed for option %s", option);
+    }
+    else
+    {
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT set_connection_count(HTTPTRANSPORT_HANDLE_DATA* handleData, unsigned int connectionCount)
+{
+    IOTHUB_CLIENT_RESULT result;
+    HTTP_CONNECTION_POOL_HANDLE connectionPool;
+
+    if (connectionCount == 0)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_11_007: [ If the connection count is 0, IoTHubTransportHttp_SetOption shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("the connection count cannot be 0");
+    }
+    else if (connectionCount == 1)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_11_008: [ If the connection count is 1, IoTHubTransportHttp_SetOption shall destroy the connection pool, if any, and succeed. ]*/
+        if (handleData->connectionPool != NULL)
+        {
+            http_connection_pool_destroy(handleData->connectionPool);
+            handleData->connectionPool = NULL;
+        }
+        result = IOTHUB_CLIENT_OK;
+    }
+    /*Codes_SRS_TRANSPORTMULTITHTTP_11_009: [ Otherwise IoTHubTransportHttp_SetOption shall replace the connection pool by one of connectionCount - 1 connections, given the options passed down so far, by calling http_connection_pool_create. ]*/
+    else if ((connectionPool = http_connection_pool_create(STRING_c_str(handleData->hostName), connectionCount - 1, handleData->httpOptions)) == NULL)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_11_011: [ If http_connection_pool_create fails, IoTHubTransportHttp_SetOption shall keep the connections it had and return IOTHUB_CLIENT_ERROR. ]*/
+        result = IOTHUB_CLIENT_ERROR;
+        LogError("http_connection_pool_create failed");
+    }
+    else
+    {
+        if (handleData->connectionPool != NULL)
+        {
+            http_connection_pool_destroy(handleData->connectionPool);
+        }
+        handleData->connectionPool = connectionPool;
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
 static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SetOption(TRANSPORT_LL_HANDLE handle, const char* option, const void* value)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -2408,6 +2408,17 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SetOption(TRANSPORT_LL_HANDLE ha
             handleData->getMinimumPollingTime = *(unsigned int*)value;
             result = IOTHUB_CLIENT_OK;
         }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_11_004: [ "MaximumPollingTime" ]*/
+        else if (strcmp(OPTION_MAX_POLLING_TIME, option) == 0)
+        {
+            handleData->getMaximumPollingTime = *(unsigned int*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_11_006: [ "HttpConnectionCount" ]*/
+        else if (strcmp(OPTION_HTTP_CONNECTION_COUNT, option) == 0)
+        {
+            result = set_connection_count(handleData, *(const unsigned int*)value);
+        }
         else
         {
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_126: [ "TrustedCerts"] */
@@ -2418,7 +2429,7 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SetOption(TRANSPORT_LL_HANDLE ha
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_119: [The following table translates HTTPAPIEX return codes to IOTHUB_CLIENT_RESULT return codes:] */
             if (HTTPAPIEX_result == HTTPAPIEX_OK)
             {
-                result = IOTHUB_CLIENT_OK;
+                result = share_http_option(handleData, option, value);
             }
             else if (HTTPAPIEX_result == HTTPAPIEX_INVALID_ARG)
             {
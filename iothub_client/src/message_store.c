@@ -0,0 +1,1318 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <dirent.h>
+#endif
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "message_store.h"
+
+#ifdef _WIN32
+#define SYNC_FILE(file) _commit(_fileno(file))
+#else
+#define SYNC_FILE(file) fsync(fileno(file))
+#endif
+
+/*a record is the length and the checksum of its body, both little endian uint32, followed by the body*/
+#define RECORD_HEADER_SIZE          8
+#define RECORD_MAX_BODY_SIZE        (16 * 1024 * 1024)
+#define RECORD_FORMAT_VERSION       1
+#define RECORD_NULL_STRING          0xFFFFFFFF
+
+#define CONTENT_TYPE_BYTEARRAY      0
+#define CONTENT_TYPE_STRING         1
+
+/*the checkpoint file is a magic number, the segment and the offset of the first record not completed, and a checksum*/
+#define CHECKPOINT_MAGIC            0x4B43534D
+#define CHECKPOINT_SIZE             20
+
+#define SEGMENT_FILE_NAME_FORMAT    "%s/%08lx.log"
+#define SEGMENT_FILE_NAME_LENGTH    14
+#define SEGMENT_NUMBER_LENGTH       8
+#define SEGMENT_FILE_EXTENSION      ".log"
+#define CHECKPOINT_FILE_NAME        "/checkpoint"
+#define CHECKPOINT_TEMP_FILE_NAME   "/checkpoint.tmp"
+
+#define INITIAL_OUTSTANDING_CAPACITY    16
+
+typedef enum READ_RECORD_RESULT_TAG
+{
+    READ_RECORD_OK,
+    READ_RECORD_END,        /*end of the segment, or a record torn by a crash*/
+    READ_RECORD_ERROR
+} READ_RECORD_RESULT;
+
+typedef enum DECODE_RESULT_TAG
+{
+    DECODE_OK,
+    DECODE_CORRUPT,         /*the record can never be decoded*/
+    DECODE_ERROR            /*the record could not be decoded now*/
+} DECODE_RESULT;
+
+typedef struct RECORD_POSITION_TAG
+{
+    uint32_t segment;
+    uint64_t offset;
+} RECORD_POSITION;
+
+typedef struct OUTSTANDING_RECORD_TAG
+{
+    RECORD_POSITION position;
+    bool completed;
+} OUTSTANDING_RECORD;
+
+typedef struct MESSAGE_STORE_TAG
+{
+    char* directory;
+    char* segmentPath;
+    char* checkpointPath;
+    char* checkpointTempPath;
+    size_t segmentSize;
+    FILE* writeFile;
+    RECORD_POSITION writePosition;
+    bool writeDirty;                    /*records appended since the last sync*/
+    FILE* readFile;
+    RECORD_POSITION readPosition;
+    RECORD_POSITION checkpoint;
+    bool checkpointDirty;
+    uint32_t firstSegment;              /*the oldest segment file that may still exist*/
+    uint64_t nextReadId;
+    uint64_t nextAppendId;
+    OUTSTANDING_RECORD* outstanding;    /*ring of the records read and not yet behind the checkpoint, the oldest one has id nextReadId - outstandingCount*/
+    size_t outstandingCapacity;
+    size_t outstandingHead;
+    size_t outstandingCount;
+    unsigned char* buffer;              /*encodes and decodes one record at a time*/
+    size_t bufferSize;
+} MESSAGE_STORE;
+
+typedef struct RECORD_READER_TAG
+{
+    const unsigned char* data;
+    size_t size;
+    size_t position;
+} RECORD_READER;
+
+static uint32_t get_checksum(const unsigned char* data, size_t size)
+{
+    /*FNV-1a*/
+    uint32_t result = 2166136261u;
+    size_t index;
+    for (index = 0; index < size; index++)
+    {
+        result ^= data[index];
+        result *= 16777619u;
+    }
+    return result;
+}
+
+static void put_uint32(unsigned char* destination, uint32_t value)
+{
+    destination[0] = (unsigned char)(value & 0xFF);
+    destination[1] = (unsigned char)((value >> 8) & 0xFF);
+    destination[2] = (unsigned char)((value >> 16) & 0xFF);
+    destination[3] = (unsigned char)((value >> 24) & 0xFF);
+}
+
+static uint32_t get_uint32(const unsigned char* source)
+{
+    return (uint32_t)source[0] | ((uint32_t)source[1] << 8) | ((uint32_t)source[2] << 16) | ((uint32_t)source[3] << 24);
+}
+
+static void put_uint64(unsigned char* destination, uint64_t value)
+{
+    put_uint32(destination, (uint32_t)(value & 0xFFFFFFFF));
+    put_uint32(destination + 4, (uint32_t)(value >> 32));
+}
+
+static uint64_t get_uint64(const unsigned char* source)
+{
+    return (uint64_t)get_uint32(source) | ((uint64_t)get_uint32(source + 4) << 32);
+}
+
+static char* make_path(const char* directory, const char* fileName)
+{
+    size_t directoryLength = strlen(directory);
+    size_t fileNameLength = strlen(fileName);
+    char* result = (char*)malloc(directoryLength + fileNameLength + 1);
+    if (result == NULL)
+    {
+        LogError("Failed allocating the path of %s", fileName);
+    }
+    else
+    {
+        (void)memcpy(result, directory, directoryLength);
+        (void)memcpy(result + directoryLength, fileName, fileNameLength + 1);
+    }
+    return result;
+}
+
+static const char* get_segment_path(MESSAGE_STORE* store, uint32_t segment)
+{
+    (void)sprintf(store->segmentPath, SEGMENT_FILE_NAME_FORMAT, store->directory, (unsigned long)segment);
+    return store->segmentPath;
+}
+
+static int reserve_buffer(MESSAGE_STORE* store, size_t size)
+{
+    int result;
+
+    if (size <= store->bufferSize)
+    {
+        result = 0;
+    }
+    else
+    {
+        unsigned char* buffer = (unsigned char*)realloc(store->buffer, size);
+        if (buffer == NULL)
+        {
+            LogError("Failed growing the record buffer to %lu bytes", (unsigned long)size);
+            result = __FAILURE__;
+        }
+        else
+        {
+            store->buffer = buffer;
+            store->bufferSize = size;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static size_t get_encoded_string_size(const char* value)
+{
+    return 4 + ((value == NULL) ? 0 : strlen(value) + 1);
+}
+
+static size_t put_string_of_length(unsigned char* destination, const char* value, size_t length)
+{
+    put_uint32(destination, (uint32_t)length);
+    (void)memcpy(destination + 4, value, length + 1);
+    return 4 + length + 1;
+}
+
+static size_t put_string(unsigned char* destination, const char* value)
+{
+    size_t result;
+
+    if (value == NULL)
+    {
+        put_uint32(destination, RECORD_NULL_STRING);
+        result = 4;
+    }
+    else
+    {
+        result = put_string_of_length(destination, value, strlen(value));
+    }
+
+    return result;
+}
+
+/*encodes the record, header included, at the start of the buffer of the store*/
+static int encode_record(MESSAGE_STORE* store, IOTHUB_MESSAGE_HANDLE message, size_t* recordSize)
+{
+    int result;
+    IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(message);
+    const unsigned char* payload = NULL;
+    size_t payloadSize = 0;
+    const char* stringPayload = NULL;
+    const IOTHUB_MESSAGE_PROPERTY* properties;
+    size_t propertyCount;
+
+    if ((contentType == IOTHUBMESSAGE_BYTEARRAY) && (IoTHubMessage_GetByteArray(message, &payload, &payloadSize) != IOTHUB_MESSAGE_OK))
+    {
+        LogError("Failed getting the payload of the message");
+        result = __FAILURE__;
+    }
+    else if ((contentType == IOTHUBMESSAGE_STRING) && ((stringPayload = IoTHubMessage_GetString(message)) == NULL))
+    {
+        LogError("Failed getting the payload of the message");
+        result = __FAILURE__;
+    }
+    else if ((contentType != IOTHUBMESSAGE_BYTEARRAY) && (contentType != IOTHUBMESSAGE_STRING))
+    {
+        LogError("Unknown content type of the message");
+        result = __FAILURE__;
+    }
+    else if (IoTHubMessage_GetPropertyTable(message, &properties, &propertyCount) != IOTHUB_MESSAGE_OK)
+    {
+        LogError("Failed getting the properties of the message");
+        result = __FAILURE__;
+    }
+    else
+    {
+        const char* messageId = IoTHubMessage_GetMessageId(message);
+        const char* correlationId = IoTHubMessage_GetCorrelationId(message);
+        const char* contentTypeProperty = IoTHubMessage_GetContentTypeSystemProperty(message);
+        const char* contentEncoding = IoTHubMessage_GetContentEncodingSystemProperty(message);
+        size_t bodySize;
+        size_t index;
+
+        bodySize = 2 +
+            ((contentType == IOTHUBMESSAGE_BYTEARRAY) ? (4 + payloadSize) : get_encoded_string_size(stringPayload)) +
+            get_encoded_string_size(messageId) +
+            get_encoded_string_size(correlationId) +
+            get_encoded_string_size(contentTypeProperty) +
+            get_encoded_string_size(contentEncoding) +
+            4;
+        for (index = 0; index < propertyCount; index++)
+        {
+            bodySize += (4 + properties[index].keyLength + 1) + (4 + properties[index].valueLength + 1);
+        }
+
+        if (bodySize > RECORD_MAX_BODY_SIZE)
+        {
+            LogError("Message of %lu bytes is too big to be stored", (unsigned long)bodySize);
+            result = __FAILURE__;
+        }
+        else if (reserve_buffer(store, RECORD_HEADER_SIZE + bodySize) != 0)
+        {
+            LogError("Failed reserving %lu bytes to encode the message", (unsigned long)(RECORD_HEADER_SIZE + bodySize));
+            result = __FAILURE__;
+        }
+        else
+        {
+            unsigned char* body = store->buffer + RECORD_HEADER_SIZE;
+            size_t position = 0;
+
+            body[position++] = RECORD_FORMAT_VERSION;
+            if (contentType == IOTHUBMESSAGE_BYTEARRAY)
+            {
+                body[position++] = CONTENT_TYPE_BYTEARRAY;
+                put_uint32(body + position, (uint32_t)payloadSize);
+                if (payloadSize > 0)
+                {
+                    (void)memcpy(body + position + 4, payload, payloadSize);
+                }
+                position += 4 + payloadSize;
+            }
+            else
+            {
+                body[position++] = CONTENT_TYPE_STRING;
+                position += put_string(body + position, stringPayload);
+            }
+            position += put_string(body + position, messageId);
+            position += put_string(body + position, correlationId);
+            position += put_string(body + position, contentTypeProperty);
+            position += put_string(body + position, contentEncoding);
+            put_uint32(body + position, (uint32_t)propertyCount);
+            position += 4;
+            for (index = 0; index < propertyCount; index++)
+            {
+                position += put_string_of_length(body + position, properties[index].key, properties[index].keyLength);
+                position += put_string_of_length(body + position, properties[index].value, properties[index].valueLength);
+            }
+
+            put_uint32(store->buffer, (uint32_t)bodySize);
+            put_uint32(store->buffer + 4, get_checksum(body, bodySize));
+            *recordSize = RECORD_HEADER_SIZE + bodySize;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static int read_uint32(RECORD_READER* reader, uint32_t* value)
+{
+    int result;
+
+    if (reader->size - reader->position < 4)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        *value = get_uint32(reader->data + reader->position);
+        reader->position += 4;
+        result = 0;
+    }
+
+    return result;
+}
+
+static int read_string_of_length(RECORD_READER* reader, const char** value, size_t* length)
+{
+    int result;
+    uint32_t storedLength;
+
+    if (read_uint32(reader, &storedLength) != 0)
+    {
+        result = __FAILURE__;
+    }
+    else if (storedLength == RECORD_NULL_STRING)
+    {
+        *value = NULL;
+        *length = 0;
+        result = 0;
+    }
+    else if ((reader->size - reader->position <= storedLength) || (reader->data[reader->position + storedLength] != '\0'))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*strings are stored with their terminator, so they are used where they are*/
+        *value = (const char*)(reader->data + reader->position);
+        *length = storedLength;
+        reader->position += (size_t)storedLength + 1;
+        result = 0;
+    }
+
+    return result;
+}
+
+static int read_string(RECORD_READER* reader, const char** value)
+{
+    size_t length;
+    return read_string_of_length(reader, value, &length);
+}
+
+static DECODE_RESULT decode_properties(RECORD_READER* reader, IOTHUB_MESSAGE_HANDLE message)
+{
+    DECODE_RESULT result;
+    const char* messageId;
+    const char* correlationId;
+    const char* contentTypeProperty;
+    const char* contentEncoding;
+    uint32_t propertyCount;
+
+    if ((read_string(reader, &messageId) != 0) ||
+        (read_string(reader, &correlationId) != 0) ||
+        (read_string(reader, &contentTypeProperty) != 0) ||
+        (read_string(reader, &contentEncoding) != 0) ||
+        (read_uint32(reader, &propertyCount) != 0))
+    {
+        result = DECODE_CORRUPT;
+    }
+    else if (((messageId != NULL) && (IoTHubMessage_SetMessageId(message, messageId) != IOTHUB_MESSAGE_OK)) ||
+        ((correlationId != NULL) && (IoTHubMessage_SetCorrelationId(message, correlationId) != IOTHUB_MESSAGE_OK)) ||
+        ((contentTypeProperty != NULL) && (IoTHubMessage_SetContentTypeSystemProperty(message, contentTypeProperty) != IOTHUB_MESSAGE_OK)) ||
+        ((contentEncoding != NULL) && (IoTHubMessage_SetContentEncodingSystemProperty(message, contentEncoding) != IOTHUB_MESSAGE_OK)))
+    {
+        result = DECODE_ERROR;
+    }
+    else if (propertyCount == 0)
+    {
+        result = DECODE_OK;
+    }
+    /*every property takes at least 10 bytes, a count the rest of the record cannot hold is corrupt*/
+    else if ((reader->size - reader->position) / 10 < propertyCount)
+    {
+        result = DECODE_CORRUPT;
+    }
+    else
+    {
+        /*the properties point in the record and are copied at once by IoTHubMessage_SetProperties*/
+        IOTHUB_MESSAGE_PROPERTY* properties = (IOTHUB_MESSAGE_PROPERTY*)malloc(propertyCount * sizeof(IOTHUB_MESSAGE_PROPERTY));
+        if (properties == NULL)
+        {
+            LogError("Failed allocating %lu properties", (unsigned long)propertyCount);
+            result = DECODE_ERROR;
+        }
+        else
+        {
+            uint32_t index;
+
+            result = DECODE_OK;
+            for (index = 0; (index < propertyCount) && (result == DECODE_OK); index++)
+            {
+                if ((read_string_of_length(reader, &properties[index].key, &properties[index].keyLength) != 0) ||
+                    (read_string_of_length(reader, &properties[index].value, &properties[index].valueLength) != 0) ||
+                    (properties[index].key == NULL) ||
+                    (properties[index].value == NULL))
+                {
+                    result = DECODE_CORRUPT;
+                }
+            }
+
+            if ((result == DECODE_OK) && (IoTHubMessage_SetProperties(message, properties, propertyCount) != IOTHUB_MESSAGE_OK))
+            {
+                result = DECODE_ERROR;
+            }
+            free(properties);
+        }
+    }
+
+    return result;
+}
+
+static DECODE_RESULT decode_record(const unsigned char* body, size_t bodySize, IOTHUB_MESSAGE_HANDLE* message)
+{
+    DECODE_RESULT result;
+    RECORD_READER reader;
+
+    reader.data = body;
+    reader.size = bodySize;
+    reader.position = 2;
+
+    if ((bodySize < 2) || (body[0] != RECORD_FORMAT_VERSION))
+    {
+        LogError("Unknown record format");
+        result = DECODE_CORRUPT;
+    }
+    else
+    {
+        *message = NULL;
+        if (body[1] == CONTENT_TYPE_BYTEARRAY)
+        {
+            uint32_t payloadSize;
+            if ((read_uint32(&reader, &payloadSize) != 0) || (reader.size - reader.position < payloadSize))
+            {
+                result = DECODE_CORRUPT;
+            }
+            else if ((*message = IoTHubMessage_CreateFromByteArray(reader.data + reader.position, payloadSize)) == NULL)
+            {
+                result = DECODE_ERROR;
+            }
+            else
+            {
+                reader.position += payloadSize;
+                result = DECODE_OK;
+            }
+        }
+        else if (body[1] == CONTENT_TYPE_STRING)
+        {
+            const char* payload;
+            if ((read_string(&reader, &payload) != 0) || (payload == NULL))
+            {
+                result = DECODE_CORRUPT;
+            }
+            else if ((*message = IoTHubMessage_CreateFromString(payload)) == NULL)
+            {
+                result = DECODE_ERROR;
+            }
+            else
+            {
+                result = DECODE_OK;
+            }
+        }
+        else
+        {
+            result = DECODE_CORRUPT;
+        }
+
+        if ((result == DECODE_OK) && ((result = decode_properties(&reader, *message)) != DECODE_OK))
+        {
+            IoTHubMessage_Destroy(*message);
+            *message = NULL;
+        }
+
+        if (result == DECODE_CORRUPT)
+        {
+            LogError("Corrupted record");
+        }
+        else if (result == DECODE_ERROR)
+        {
+            LogError("Failed rebuilding the message of a record");
+        }
+    }
+
+    return result;
+}
+
+/*reads the record at position into the buffer of the store and moves position past it*/
+static READ_RECORD_RESULT read_record(MESSAGE_STORE* store, FILE* file, RECORD_POSITION* position, size_t* bodySize)
+{
+    READ_RECORD_RESULT result;
+    unsigned char header[RECORD_HEADER_SIZE];
+
+    /*the segment being written may have grown since the end of it was last seen*/
+    clearerr(file);
+
+    if (fread(header, 1, RECORD_HEADER_SIZE, file) != RECORD_HEADER_SIZE)
+    {
+        result = READ_RECORD_END;
+    }
+    else
+    {
+        uint32_t length = get_uint32(header);
+
+        if (length > RECORD_MAX_BODY_SIZE)
+        {
+            LogError("Record of %lu bytes in segment %lu is corrupted", (unsigned long)length, (unsigned long)position->segment);
+            result = READ_RECORD_END;
+        }
+        else if (reserve_buffer(store, length) != 0)
+        {
+            result = READ_RECORD_ERROR;
+        }
+        else if ((fread(store->buffer, 1, length, file) != length) || (get_checksum(store->buffer, length) != get_uint32(header + 4)))
+        {
+            LogError("Record at %lu in segment %lu is torn", (unsigned long)position->offset, (unsigned long)position->segment);
+            result = READ_RECORD_END;
+        }
+        else
+        {
+            position->offset += RECORD_HEADER_SIZE + length;
+            *bodySize = length;
+            result = READ_RECORD_OK;
+        }
+    }
+
+    return result;
+}
+
+static int write_file(const char* path, const unsigned char* data, size_t size)
+{
+    int result;
+    FILE* file = fopen(path, "wb");
+
+    if (file == NULL)
+    {
+        LogError("Failed creating %s", path);
+        result = __FAILURE__;
+    }
+    else
+    {
+        if ((fwrite(data, 1, size, file) != size) || (fflush(file) != 0) || (SYNC_FILE(file) != 0))
+        {
+            LogError("Failed writing %s", path);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+        (void)fclose(file);
+    }
+
+    return result;
+}
+
+static int write_checkpoint(MESSAGE_STORE* store)
+{
+    int result;
+    unsigned char data[CHECKPOINT_SIZE];
+
+    put_uint32(data, CHECKPOINT_MAGIC);
+    put_uint32(data + 4, store->checkpoint.segment);
+    put_uint64(data + 8, store->checkpoint.offset);
+    put_uint32(data + 16, get_checksum(data, 16));
+
+    if (write_file(store->checkpointTempPath, data, CHECKPOINT_SIZE) != 0)
+    {
+        result = __FAILURE__;
+    }
+    /*rename does not replace an existing file on Windows, and removing it first would leave no checkpoint after a crash*/
+#ifdef _WIN32
+    else if (!MoveFileExA(store->checkpointTempPath, store->checkpointPath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+#else
+    else if (rename(store->checkpointTempPath, store->checkpointPath) != 0)
+#endif
+    {
+        LogError("Failed replacing %s", store->checkpointPath);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static bool read_checkpoint(MESSAGE_STORE* store)
+{
+    bool result = false;
+    FILE* file = fopen(store->checkpointPath, "rb");
+
+    store->checkpoint.segment = 0;
+    store->checkpoint.offset = 0;
+
+    if (file != NULL)
+    {
+        unsigned char data[CHECKPOINT_SIZE];
+
+        if ((fread(data, 1, CHECKPOINT_SIZE, file) != CHECKPOINT_SIZE) ||
+            (get_uint32(data) != CHECKPOINT_MAGIC) ||
+            (get_uint32(data + 16) != get_checksum(data, 16)))
+        {
+            LogError("Checkpoint of %s is corrupted, replaying every segment found", store->directory);
+        }
+        else
+        {
+            store->checkpoint.segment = get_uint32(data + 4);
+            store->checkpoint.offset = get_uint64(data + 8);
+            result = true;
+        }
+        (void)fclose(file);
+    }
+
+    return result;
+}
+
+/*returns true if fileName is the name of a segment, along with its number*/
+static bool parse_segment_file_name(const char* fileName, uint32_t* segment)
+{
+    bool result;
+
+    if ((strlen(fileName) != SEGMENT_NUMBER_LENGTH + sizeof(SEGMENT_FILE_EXTENSION) - 1) ||
+        (strcmp(fileName + SEGMENT_NUMBER_LENGTH, SEGMENT_FILE_EXTENSION) != 0))
+    {
+        result = false;
+    }
+    else
+    {
+        size_t index;
+        uint32_t value = 0;
+
+        result = true;
+        for (index = 0; result && (index < SEGMENT_NUMBER_LENGTH); index++)
+        {
+            char c = fileName[index];
+            uint32_t digit;
+
+            if ((c >= '0') && (c <= '9'))
+            {
+                digit = (uint32_t)(c - '0');
+            }
+            else if ((c >= 'a') && (c <= 'f'))
+            {
+                digit = (uint32_t)(c - 'a' + 10);
+            }
+            else
+            {
+                result = false;
+                digit = 0;
+            }
+            value = (value << 4) | digit;
+        }
+
+        if (result)
+        {
+            *segment = value;
+        }
+    }
+
+    return result;
+}
+
+static void add_segment_found(const char* fileName, bool* found, uint32_t* lowest, uint32_t* highest)
+{
+    uint32_t segment;
+
+    if (parse_segment_file_name(fileName, &segment))
+    {
+        if (!*found || (segment < *lowest))
+        {
+            *lowest = segment;
+        }
+        if (!*found || (segment > *highest))
+        {
+            *highest = segment;
+        }
+        *found = true;
+    }
+}
+
+/*lists the directory for the lowest and the highest segment, the ones in between may have gaps*/
+static int find_segments(MESSAGE_STORE* store, bool* found, uint32_t* lowest, uint32_t* highest)
+{
+    int result;
+#ifdef _WIN32
+    char* pattern;
+    HANDLE findHandle;
+    WIN32_FIND_DATAA findData;
+#else
+    DIR* directory;
+#endif
+
+    *found = false;
+    *lowest = 0;
+    *highest = 0;
+
+#ifdef _WIN32
+    if ((pattern = make_path(store->directory, "/*" SEGMENT_FILE_EXTENSION)) == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        if ((findHandle = FindFirstFileA(pattern, &findData)) != INVALID_HANDLE_VALUE)
+        {
+            do
+            {
+                add_segment_found(findData.cFileName, found, lowest, highest);
+            } while (FindNextFileA(findHandle, &findData));
+            (void)FindClose(findHandle);
+            result = 0;
+        }
+        else if (GetLastError() == ERROR_FILE_NOT_FOUND)
+        {
+            result = 0;
+        }
+        else
+        {
+            LogError("Failed listing the segments in %s", store->directory);
+            result = __FAILURE__;
+        }
+        free(pattern);
+    }
+#else
+    if ((directory = opendir(store->directory)) == NULL)
+    {
+        LogError("Failed listing the segments in %s", store->directory);
+        result = __FAILURE__;
+    }
+    else
+    {
+        struct dirent* entry;
+        while ((entry = readdir(directory)) != NULL)
+        {
+            add_segment_found(entry->d_name, found, lowest, highest);
+        }
+        (void)closedir(directory);
+        result = 0;
+    }
+#endif
+
+    return result;
+}
+
+static bool segment_exists(MESSAGE_STORE* store, uint32_t segment)
+{
+    FILE* file = fopen(get_segment_path(store, segment), "rb");
+
+    if (file != NULL)
+    {
+        (void)fclose(file);
+    }
+
+    return (file != NULL);
+}
+
+/*opens the segment of writePosition, moving past any segment already on disk so that no record is ever truncated*/
+static int create_write_segment(MESSAGE_STORE* store)
+{
+    int result;
+
+    while (segment_exists(store, store->writePosition.segment))
+    {
+        LogError("Segment %lu already exists, continuing in the next one", (unsigned long)store->writePosition.segment);
+        store->writePosition.segment++;
+        store->writePosition.offset = 0;
+    }
+
+    if ((store->writeFile = fopen(get_segment_path(store, store->writePosition.segment), "wb")) == NULL)
+    {
+        LogError("Failed creating segment %lu in %s", (unsigned long)store->writePosition.segment, store->directory);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static int sync_write_file(MESSAGE_STORE* store)
+{
+    int result;
+
+    if (!store->writeDirty || (store->writeFile == NULL))
+    {
+        result = 0;
+    }
+    else if ((fflush(store->writeFile) != 0) || (SYNC_FILE(store->writeFile) != 0))
+    {
+        LogError("Failed syncing segment %lu", (unsigned long)store->writePosition.segment);
+        result = __FAILURE__;
+    }
+    else
+    {
+        store->writeDirty = false;
+        result = 0;
+    }
+
+    return result;
+}
+
+/*counts the records left after the checkpoint and picks a new segment for the appends*/
+static int replay_log(MESSAGE_STORE* store)
+{
+    int result;
+    bool found;
+    uint32_t lowest;
+    uint32_t highest;
+
+    if (find_segments(store, &found, &lowest, &highest) != 0)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        RECORD_POSITION position;
+
+        if (read_checkpoint(store))
+        {
+            /*segments the checkpoint moved past before a crash prevented their deletion*/
+            for (; found && (lowest < store->checkpoint.segment); lowest++)
+            {
+                (void)remove(get_segment_path(store, lowest));
+            }
+        }
+        else if (found)
+        {
+            /*Codes_SRS_MESSAGE_STORE_11_026: [ If the checkpoint is missing or corrupted, message_store_open shall replay every record from the oldest segment found in the directory, skipping the segments missing after it. ]*/
+            /*the segments before the lost checkpoint are gone, replaying from the oldest one left sends events twice rather than losing them*/
+            store->checkpoint.segment = lowest;
+        }
+
+        position = store->checkpoint;
+        result = 0;
+        if (found && (highest >= position.segment))
+        {
+            bool done = false;
+
+            while ((result == 0) && !done)
+            {
+                FILE* file = fopen(get_segment_path(store, position.segment), "rb");
+
+                if (file == NULL)
+                {
+                    /*a gap left by a segment that was never written*/
+                    LogError("Segment %lu is missing", (unsigned long)position.segment);
+                }
+                else
+                {
+                    READ_RECORD_RESULT readResult;
+                    size_t bodySize;
+
+                    if ((position.offset != 0) && (fseek(file, (long)position.offset, SEEK_SET) != 0))
+                    {
+                        LogError("Failed seeking to the checkpoint in segment %lu", (unsigned long)position.segment);
+                        readResult = READ_RECORD_ERROR;
+                    }
+                    else
+                    {
+                        while ((readResult = read_record(store, file, &position, &bodySize)) == READ_RECORD_OK)
+                        {
+                            store->nextAppendId++;
+                        }
+                    }
+                    (void)fclose(file);
+
+                    if (readResult == READ_RECORD_ERROR)
+                    {
+                        result = __FAILURE__;
+                    }
+                }
+
+                done = (position.segment == highest);
+                position.segment++;
+                position.offset = 0;
+            }
+        }
+
+        if (result == 0)
+        {
+            /*appends never go after a torn record, they start in the segment following the last one found*/
+            store->firstSegment = store->checkpoint.segment;
+            store->readPosition = store->checkpoint;
+            store->writePosition.segment = position.segment;
+            store->writePosition.offset = 0;
+
+            result = create_write_segment(store);
+        }
+    }
+
+    return result;
+}
+
+static void free_store(MESSAGE_STORE* store)
+{
+    if (store->writeFile != NULL)
+    {
+        (void)fclose(store->writeFile);
+    }
+    if (store->readFile != NULL)
+    {
+        (void)fclose(store->readFile);
+    }
+    free(store->directory);
+    free(store->segmentPath);
+    free(store->checkpointPath);
+    free(store->checkpointTempPath);
+    free(store->outstanding);
+    free(store->buffer);
+    free(store);
+}
+
+MESSAGE_STORE_HANDLE message_store_open(const char* directory, size_t segmentSize)
+{
+    MESSAGE_STORE* result;
+
+    if ((directory == NULL) || (segmentSize == 0))
+    {
+        /*Codes_SRS_MESSAGE_STORE_11_001: [ If `directory` is NULL or `segmentSize` is 0, message_store_open shall fail and return NULL. ]*/
+        LogError("Invalid argument, directory [%p], segmentSize [%lu]", directory, (unsigned long)segmentSize);
+        result = NULL;
+    }
+    else if ((result = (MESSAGE_STORE*)malloc(sizeof(MESSAGE_STORE))) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_STORE_11_002: [ If any allocation or file operation fails, message_store_open shall free what it allocated and return NULL. ]*/
+        LogError("Failed allocating the message store");
+    }
+    else
+    {
+        (void)memset(result, 0, sizeof(MESSAGE_STORE));
+        result->segmentSize = segmentSize;
+
+        if (((result->directory = make_path(directory, "")) == NULL) ||
+            ((result->segmentPath = (char*)malloc(strlen(directory) + SEGMENT_FILE_NAME_LENGTH + 1)) == NULL) ||
+            ((result->checkpointPath = make_path(directory, CHECKPOINT_FILE_NAME)) == NULL) ||
+            ((result->checkpointTempPath = make_path(directory, CHECKPOINT_TEMP_FILE_NAME)) == NULL))
+        {
+            LogError("Failed allocating the paths of the message store");
+            free_store(result);
+            result = NULL;
+        }
+        /*Codes_SRS_MESSAGE_STORE_11_003: [ message_store_open shall read the checkpoint and count the valid records that follow it, stopping in each segment at the first torn record. ]*/
+        /*Codes_SRS_MESSAGE_STORE_11_004: [ message_store_open shall create a new segment, after the last one found, for the records appended afterwards. ]*/
+        else if (replay_log(result) != 0)
+        {
+            LogError("Failed replaying the message store in %s", directory);
+            free_store(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+void message_store_close(MESSAGE_STORE_HANDLE store)
+{
+    /*Codes_SRS_MESSAGE_STORE_11_005: [ If `store` is NULL, message_store_close shall return. ]*/
+    if (store != NULL)
+    {
+        /*Codes_SRS_MESSAGE_STORE_11_006: [ message_store_close shall sync the store, close its files and free it. ]*/
+        (void)message_store_sync(store);
+        free_store(store);
+    }
+}
+
+/*opens the segment the next record goes to, the current one is closed once full or after a failed write*/
+static int prepare_write_segment(MESSAGE_STORE* store, size_t recordSize)
+{
+    int result;
+
+    if ((store->writeFile != NULL) && (store->writePosition.offset != 0) && ((store->writePosition.offset >= store->segmentSize) || (recordSize > store->segmentSize - (size_t)store->writePosition.offset)))
+    {
+        /*Codes_SRS_MESSAGE_STORE_11_009: [ Once the current segment holds at least one record and the new one would take it over `segmentSize`, message_store_append shall sync it, close it and continue in a new segment. ]*/
+        if (sync_write_file(store) != 0)
+        {
+            LogError("Failed syncing the full segment %lu", (unsigned long)store->writePosition.segment);
+        }
+        (void)fclose(store->writeFile);
+        store->writeFile = NULL;
+        store->writeDirty = false;
+        store->writePosition.segment++;
+        store->writePosition.offset = 0;
+    }
+
+    if (store->writeFile != NULL)
+    {
+        result = 0;
+    }
+    else
+    {
+        result = create_write_segment(store);
+    }
+
+    return result;
+}
+
+int message_store_append(MESSAGE_STORE_HANDLE store, IOTHUB_MESSAGE_HANDLE message, uint64_t* recordId)
+{
+    int result;
+    size_t recordSize;
+
+    if ((store == NULL) || (message == NULL) || (recordId == NULL))
+    {
+        /*Codes_SRS_MESSAGE_STORE_11_007: [ If `store`, `message` or `recordId` is NULL, message_store_append shall fail and return a non-zero value. ]*/
+        LogError("Invalid argument, store [%p], message [%p], recordId [%p]", store, message, recordId);
+        result = __FAILURE__;
+    }
+    /*Codes_SRS_MESSAGE_STORE_11_008: [ message_store_append shall encode the payload, message id, correlation id, content type, content encoding and properties of `message` in a record with the length and the checksum of its content. ]*/
+    else if (encode_record(store, message, &recordSize) != 0)
+    {
+        LogError("Failed encoding the message");
+        result = __FAILURE__;
+    }
+    else if (prepare_write_segment(store, recordSize) != 0)
+    {
+        result = __FAILURE__;
+    }
+    else if (fwrite(store->buffer, 1, recordSize, store->writeFile) != recordSize)
+    {
+        /*Codes_SRS_MESSAGE_STORE_11_011: [ If writing the record fails, message_store_append shall fail and continue in a new segment, so no record follows the torn one. ]*/
+        LogError("Failed writing to segment %lu", (unsigned long)store->writePosition.segment);
+        (void)fclose(store->writeFile);
+        store->writeFile = NULL;
+        store->writeDirty = false;
+        store->writePosition.segment++;
+        store->writePosition.offset = 0;
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_STORE_11_010: [ message_store_append shall write the record at the end of the current segment, without syncing it, and return in `recordId` the id message_store_read gives to it. ]*/
+        store->writePosition.offset += recordSize;
+        store->writeDirty = true;
+        *recordId = store->nextAppendId++;
+        result = 0;
+    }
+
+    return result;
+}
+
+static int add_outstanding_record(MESSAGE_STORE* store, const RECORD_POSITION* position)
+{
+    int result;
+
+    if (store->outstandingCount == store->outstandingCapacity)
+    {
+        size_t newCapacity = (store->outstandingCapacity == 0) ? INITIAL_OUTSTANDING_CAPACITY : store->outstandingCapacity * 2;
+        OUTSTANDING_RECORD* outstanding;
+
+        if ((newCapacity < store->outstandingCapacity) || (newCapacity > ((size_t)-1) / sizeof(OUTSTANDING_RECORD)))
+        {
+            LogError("Too many records outstanding");
+            result = __FAILURE__;
+        }
+        else if ((outstanding = (OUTSTANDING_RECORD*)malloc(newCapacity * sizeof(OUTSTANDING_RECORD))) == NULL)
+        {
+            LogError("Failed growing the outstanding records");
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t index;
+            for (index = 0; index < store->outstandingCount; index++)
+            {
+                outstanding[index] = store->outstanding[(store->outstandingHead + index) % store->outstandingCapacity];
+            }
+            free(store->outstanding);
+            store->outstanding = outstanding;
+            store->outstandingCapacity = newCapacity;
+            store->outstandingHead = 0;
+            result = 0;
+        }
+    }
+    else
+    {
+        result = 0;
+    }
+
+    if (result == 0)
+    {
+        OUTSTANDING_RECORD* record = &store->outstanding[(store->outstandingHead + store->outstandingCount) % store->outstandingCapacity];
+        record->position = *position;
+        record->completed = false;
+        store->outstandingCount++;
+    }
+
+    return result;
+}
+
+static void move_checkpoint(MESSAGE_STORE* store)
+{
+    while ((store->outstandingCount > 0) && store->outstanding[store->outstandingHead].completed)
+    {
+        store->outstandingHead = (store->outstandingHead + 1) % store->outstandingCapacity;
+        store->outstandingCount--;
+    }
+
+    store->checkpoint = (store->outstandingCount > 0) ? store->outstanding[store->outstandingHead].position : store->readPosition;
+    store->checkpointDirty = true;
+}
+
+IOTHUB_MESSAGE_HANDLE message_store_read(MESSAGE_STORE_HANDLE store, uint64_t* recordId)
+{
+    IOTHUB_MESSAGE_HANDLE result = NULL;
+
+    if ((store == NULL) || (recordId == NULL))
+    {
+        /*Codes_SRS_MESSAGE_STORE_11_012: [ If `store` or `recordId` is NULL, message_store_read shall fail and return NULL. ]*/
+        LogError("Invalid argument, store [%p], recordId [%p]", store, recordId);
+    }
+    else
+    {
+        bool done = false;
+
+        while (!done)
+        {
+            RECORD_POSITION position = store->readPosition;
+            READ_RECORD_RESULT readResult;
+            size_t bodySize;
+
+            if ((position.segment == store->writePosition.segment) && (position.offset >= store->writePosition.offset))
+            {
+                /*Codes_SRS_MESSAGE_STORE_11_013: [ If every record has been read, message_store_read shall return NULL. ]*/
+                done = true;
+            }
+            else if ((store->readFile == NULL) && ((store->readFile = fopen(get_segment_path(store, position.segment), "rb")) == NULL))
+            {
+                /*the segment only existed in a checkpoint that was not followed by its writes*/
+                LogError("Segment %lu is missing", (unsigned long)position.segment);
+                store->readPosition.segment++;
+                store->readPosition.offset = 0;
+            }
+            else if ((position.offset != 0) && (ftell(store->readFile) != (long)position.offset) && (fseek(store->readFile, (long)position.offset, SEEK_SET) != 0))
+            {
+                LogError("Failed seeking in segment %lu", (unsigned long)position.segment);
+                done = true;
+            }
+            /*Codes_SRS_MESSAGE_STORE_11_014: [ message_store_read shall flush the appends not yet written before reading the segment they go to. ]*/
+            else if ((position.segment == store->writePosition.segment) && (store->writeFile != NULL) && (fflush(store->writeFile) != 0))
+            {
+                LogError("Failed flushing segment %lu", (unsigned long)position.segment);
+                done = true;
+            }
+            else if ((readResult = read_record(store, store->readFile, &position, &bodySize)) == READ_RECORD_ERROR)
+            {
+                done = true;
+            }
+            else if (readResult == READ_RECORD_END)
+            {
+                /*Codes_SRS_MESSAGE_STORE_11_015: [ At the end of a segment, or at a torn record, message_store_read shall continue with the next segment. ]*/
+                (void)fclose(store->readFile);
+                store->readFile = NULL;
+                if ((position.segment == store->writePosition.segment) && (store->writeFile != NULL))
+                {
+                    /*the segment being written was damaged, the next append goes to a new one*/
+                    LogError("Segment %lu is damaged, continuing in a new one", (unsigned long)position.segment);
+                    (void)fclose(store->writeFile);
+                    store->writeFile = NULL;
+                    store->writeDirty = false;
+                    store->writePosition.segment++;
+                    store->writePosition.offset = 0;
+                }
+                store->readPosition.segment++;
+                store->readPosition.offset = 0;
+            }
+            else
+            {
+                /*Codes_SRS_MESSAGE_STORE_11_016: [ message_store_read shall rebuild the message of the next record and return it along with its id, ids being given in the order of the log starting at 0 when the store is opened. ]*/
+                DECODE_RESULT decodeResult = decode_record(store->buffer, bodySize, &result);
+
+                if (decodeResult == DECODE_ERROR)
+                {
+                    /*Codes_SRS_MESSAGE_STORE_11_017: [ If the message cannot be rebuilt for a transient reason, message_store_read shall return NULL and read the same record the next time. ]*/
+                    (void)fseek(store->readFile, (long)store->readPosition.offset, SEEK_SET);
+                    done = true;
+                }
+                else if (add_outstanding_record(store, &store->readPosition) != 0)
+                {
+                    if (result != NULL)
+                    {
+                        IoTHubMessage_Destroy(result);
+                        result = NULL;
+                    }
+                    (void)fseek(store->readFile, (long)store->readPosition.offset, SEEK_SET);
+                    done = true;
+                }
+                else
+                {
+                    store->readPosition = position;
+                    *recordId = store->nextReadId++;
+
+                    if (decodeResult == DECODE_CORRUPT)
+                    {
+                        /*Codes_SRS_MESSAGE_STORE_11_018: [ A record that can never be rebuilt shall be completed and skipped. ]*/
+                        (void)message_store_complete(store, *recordId);
+                    }
+                    else
+                    {
+                        done = true;
+                    }
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+int message_store_complete(MESSAGE_STORE_HANDLE store, uint64_t recordId)
+{
+    int result;
+
+    if (store == NULL)
+    {
+        /*Codes_SRS_MESSAGE_STORE_11_019: [ If `store` is NULL, message_store_complete shall fail and return a non-zero value. ]*/
+        LogError("Invalid argument, store is NULL");
+        result = __FAILURE__;
+    }
+    else if ((recordId >= store->nextReadId) || (recordId < store->nextReadId - store->outstandingCount) ||
+        store->outstanding[(store->outstandingHead + (size_t)(recordId - (store->nextReadId - store->outstandingCount))) % store->outstandingCapacity].completed)
+    {
+        /*Codes_SRS_MESSAGE_STORE_11_020: [ If `recordId` is not the id of a record read and not yet completed, message_store_complete shall fail and return a non-zero value. ]*/
+        LogError("Record %lu is not outstanding", (unsigned long)recordId);
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t index = (size_t)(recordId - (store->nextReadId - store->outstandingCount));
+
+        /*Codes_SRS_MESSAGE_STORE_11_021: [ message_store_complete shall mark the record as completed and move the checkpoint to the first record read and not completed, or after the last record read if all of them are completed. ]*/
+        store->outstanding[(store->outstandingHead + index) % store->outstandingCapacity].completed = true;
+        move_checkpoint(store);
+        result = 0;
+    }
+
+    return result;
+}
+
+int message_store_sync(MESSAGE_STORE_HANDLE store)
+{
+    int result;
+
+    if (store == NULL)
+    {
+        /*Codes_SRS_MESSAGE_STORE_11_022: [ If `store` is NULL, message_store_sync shall fail and return a non-zero value. ]*/
+        LogError("Invalid argument, store is NULL");
+        result = __FAILURE__;
+    }
+    /*Codes_SRS_MESSAGE_STORE_11_023: [ If records were appended since the last sync, message_store_sync shall flush the current segment and sync it to disk. ]*/
+    else if (sync_write_file(store) != 0)
+    {
+        result = __FAILURE__;
+    }
+    else if (!store->checkpointDirty)
+    {
+        result = 0;
+    }
+    /*Codes_SRS_MESSAGE_STORE_11_024: [ If the checkpoint moved, message_store_sync shall write it to a temporary file, sync it and rename it over the checkpoint file. ]*/
+    else if (write_checkpoint(store) != 0)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_STORE_11_025: [ Once the checkpoint is written, message_store_sync shall delete the segments before the one of the checkpoint. ]*/
+        while (store->firstSegment < store->checkpoint.segment)
+        {
+            (void)remove(get_segment_path(store, store->firstSegment));
+            store->firstSegment++;
+        }
+        store->checkpointDirty = false;
+        result = 0;
+    }
+
+    return result;
+}
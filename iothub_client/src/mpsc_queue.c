@@ -0,0 +1,174 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "mpsc_queue.h"
+
+#if defined(_MSC_VER)
+#include <windows.h>
+#define MPSC_QUEUE_COMPARE_AND_SWAP(destination, exchange, comparand) (InterlockedCompareExchangePointer((PVOID volatile*)(destination), (exchange), (comparand)) == (comparand))
+#define MPSC_QUEUE_EXCHANGE(destination, value) ((PDLIST_ENTRY)InterlockedExchangePointer((PVOID volatile*)(destination), (value)))
+#elif defined(__GNUC__)
+#define MPSC_QUEUE_COMPARE_AND_SWAP(destination, exchange, comparand) __sync_bool_compare_and_swap((destination), (comparand), (exchange))
+/*__sync_lock_test_and_set may only store the constant 1 on some targets, __atomic_exchange_n stores any value*/
+#define MPSC_QUEUE_EXCHANGE(destination, value) __atomic_exchange_n((destination), (value), __ATOMIC_ACQ_REL)
+#else
+#define MPSC_QUEUE_USE_LOCK
+#include "azure_c_shared_utility/lock.h"
+#endif
+
+typedef struct MPSC_QUEUE_TAG
+{
+    /*newest item first, linked through Flink*/
+    PDLIST_ENTRY volatile head;
+#ifdef MPSC_QUEUE_USE_LOCK
+    LOCK_HANDLE lock;
+#endif
+} MPSC_QUEUE;
+
+MPSC_QUEUE_HANDLE mpsc_queue_create(void)
+{
+    /*Codes_SRS_MPSC_QUEUE_11_001: [ mpsc_queue_create shall allocate memory for the MPSC_QUEUE data structure and return it empty. ]*/
+    MPSC_QUEUE* result = (MPSC_QUEUE*)malloc(sizeof(MPSC_QUEUE));
+
+    if (result == NULL)
+    {
+        /*Codes_SRS_MPSC_QUEUE_11_002: [ If the allocation fails, mpsc_queue_create shall fail and return NULL. ]*/
+        LogError("Failed allocating the queue");
+    }
+    else
+    {
+        result->head = NULL;
+#ifdef MPSC_QUEUE_USE_LOCK
+        if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("Lock_Init failed");
+            free(result);
+            result = NULL;
+        }
+#endif
+    }
+
+    return result;
+}
+
+void mpsc_queue_destroy(MPSC_QUEUE_HANDLE queue)
+{
+    /*Codes_SRS_MPSC_QUEUE_11_003: [ If `queue` is NULL, mpsc_queue_destroy shall return. ]*/
+    if (queue != NULL)
+    {
+        /*Codes_SRS_MPSC_QUEUE_11_004: [ mpsc_queue_destroy shall free the queue but not the items still in it. ]*/
+#ifdef MPSC_QUEUE_USE_LOCK
+        Lock_Deinit(queue->lock);
+#endif
+        free(queue);
+    }
+}
+
+int mpsc_queue_push(MPSC_QUEUE_HANDLE queue, PDLIST_ENTRY entry, bool* wasEmpty)
+{
+    int result;
+
+    if (queue == NULL || entry == NULL || wasEmpty == NULL)
+    {
+        /*Codes_SRS_MPSC_QUEUE_11_005: [ If `queue`, `entry` or `wasEmpty` is NULL, mpsc_queue_push shall fail and return a non-zero value. ]*/
+        LogError("Invalid argument, queue [%p], entry [%p], wasEmpty [%p]", queue, entry, wasEmpty);
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*the head is kept in a local: once `entry` is published the consumer may pop, relink and free it at any time*/
+        PDLIST_ENTRY previous;
+
+        /*Codes_SRS_MPSC_QUEUE_11_006: [ mpsc_queue_push shall link `entry` in front of the newest item without taking a lock, retrying if another thread pushed at the same time. ]*/
+#ifdef MPSC_QUEUE_USE_LOCK
+        if (Lock(queue->lock) != LOCK_OK)
+        {
+            /*Codes_SRS_MPSC_QUEUE_11_011: [ If the queue falls back to a lock and taking it fails, mpsc_queue_push shall not add `entry` and return a non-zero value. ]*/
+            LogError("failed locking the queue");
+            result = __FAILURE__;
+        }
+        else
+        {
+            previous = queue->head;
+            entry->Flink = previous;
+            queue->head = entry;
+            (void)Unlock(queue->lock);
+
+            /*Codes_SRS_MPSC_QUEUE_11_007: [ mpsc_queue_push shall set `wasEmpty` to true if the queue was empty before `entry` was added and to false otherwise, and return 0. ]*/
+            *wasEmpty = (previous == NULL);
+            result = 0;
+        }
+#else
+        do
+        {
+            previous = queue->head;
+            entry->Flink = previous;
+        } while (!MPSC_QUEUE_COMPARE_AND_SWAP(&queue->head, entry, previous));
+
+        /*Codes_SRS_MPSC_QUEUE_11_007: [ mpsc_queue_push shall set `wasEmpty` to true if the queue was empty before `entry` was added and to false otherwise, and return 0. ]*/
+        *wasEmpty = (previous == NULL);
+        result = 0;
+#endif
+    }
+
+    return result;
+}
+
+size_t mpsc_queue_pop_all(MPSC_QUEUE_HANDLE queue, PDLIST_ENTRY listHead)
+{
+    size_t result = 0;
+
+    if (queue == NULL || listHead == NULL)
+    {
+        /*Codes_SRS_MPSC_QUEUE_11_008: [ If `queue` or `listHead` is NULL, mpsc_queue_pop_all shall return 0. ]*/
+        LogError("Invalid argument, queue [%p], listHead [%p]", queue, listHead);
+    }
+    else
+    {
+        PDLIST_ENTRY newest;
+        PDLIST_ENTRY oldest = NULL;
+
+        /*Codes_SRS_MPSC_QUEUE_11_009: [ mpsc_queue_pop_all shall detach all the items from the queue in a single atomic exchange. ]*/
+#ifdef MPSC_QUEUE_USE_LOCK
+        if (Lock(queue->lock) != LOCK_OK)
+        {
+            /*Codes_SRS_MPSC_QUEUE_11_012: [ If the queue falls back to a lock and taking it fails, mpsc_queue_pop_all shall leave the items in the queue and return 0. ]*/
+            LogError("failed locking the queue");
+            newest = NULL;
+        }
+        else
+        {
+            newest = queue->head;
+            queue->head = NULL;
+            (void)Unlock(queue->lock);
+        }
+#else
+        newest = MPSC_QUEUE_EXCHANGE(&queue->head, NULL);
+#endif
+
+        /*the items were pushed newest first, reverse them to restore the order they were pushed in*/
+        while (newest != NULL)
+        {
+            PDLIST_ENTRY next = newest->Flink;
+            newest->Flink = oldest;
+            oldest = newest;
+            newest = next;
+        }
+
+        /*Codes_SRS_MPSC_QUEUE_11_010: [ mpsc_queue_pop_all shall append the items to `listHead` in the order they were pushed and return how many were appended. ]*/
+        while (oldest != NULL)
+        {
+            PDLIST_ENTRY next = oldest->Flink;
+            DList_InsertTailList(listHead, oldest);
+            oldest = next;
+            result++;
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,288 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "mqtt_inflight_table.h"
+
+#define DEFAULT_INITIAL_CAPACITY    32
+#define MAX_TABLE_CAPACITY          (1 << 17)
+
+// Packet identifier zero is never used by MQTT, so it marks an empty slot.
+#define EMPTY_PACKET_ID             0
+
+typedef struct MQTT_INFLIGHT_TABLE_SLOT_TAG
+{
+    uint16_t packet_id;
+    void* value;
+} MQTT_INFLIGHT_TABLE_SLOT;
+
+typedef struct MQTT_INFLIGHT_TABLE_TAG
+{
+    MQTT_INFLIGHT_TABLE_SLOT* slots;
+    size_t capacity;
+    unsigned int hash_shift;
+    size_t count;
+} MQTT_INFLIGHT_TABLE;
+
+// Packet identifiers are handed out sequentially and would otherwise fill one long run of slots, which makes
+// every removal shift the whole run. Fibonacci hashing scatters consecutive identifiers across the table.
+static size_t get_home_slot(const MQTT_INFLIGHT_TABLE* table, uint16_t packet_id)
+{
+    return (size_t)(((uint32_t)packet_id * 2654435769u) >> table->hash_shift);
+}
+
+static unsigned int get_hash_shift(size_t capacity)
+{
+    unsigned int result = 32;
+
+    while (capacity > 1)
+    {
+        capacity >>= 1;
+        result--;
+    }
+
+    return result;
+}
+
+static MQTT_INFLIGHT_TABLE_SLOT* find_slot(const MQTT_INFLIGHT_TABLE* table, uint16_t packet_id)
+{
+    MQTT_INFLIGHT_TABLE_SLOT* result = NULL;
+    size_t index = get_home_slot(table, packet_id);
+
+    while (table->slots[index].packet_id != EMPTY_PACKET_ID)
+    {
+        if (table->slots[index].packet_id == packet_id)
+        {
+            result = &table->slots[index];
+            break;
+        }
+        index = (index + 1) & (table->capacity - 1);
+    }
+
+    return result;
+}
+
+static void insert_slot(MQTT_INFLIGHT_TABLE* table, uint16_t packet_id, void* value)
+{
+    size_t index = get_home_slot(table, packet_id);
+
+    while (table->slots[index].packet_id != EMPTY_PACKET_ID)
+    {
+        index = (index + 1) & (table->capacity - 1);
+    }
+
+    table->slots[index].packet_id = packet_id;
+    table->slots[index].value = value;
+}
+
+static MQTT_INFLIGHT_TABLE_SLOT* allocate_slots(size_t capacity)
+{
+    MQTT_INFLIGHT_TABLE_SLOT* result = (MQTT_INFLIGHT_TABLE_SLOT*)malloc(capacity * sizeof(MQTT_INFLIGHT_TABLE_SLOT));
+    if (result != NULL)
+    {
+        memset(result, 0, capacity * sizeof(MQTT_INFLIGHT_TABLE_SLOT));
+    }
+    return result;
+}
+
+static int grow_table(MQTT_INFLIGHT_TABLE* table)
+{
+    int result;
+    size_t new_capacity = table->capacity * 2;
+    MQTT_INFLIGHT_TABLE_SLOT* new_slots;
+
+    if (new_capacity > MAX_TABLE_CAPACITY)
+    {
+        LogError("Failure: in-flight table cannot grow beyond %d slots", MAX_TABLE_CAPACITY);
+        result = __FAILURE__;
+    }
+    else if ((new_slots = allocate_slots(new_capacity)) == NULL)
+    {
+        LogError("Failure allocating in-flight table slots");
+        result = __FAILURE__;
+    }
+    else
+    {
+        MQTT_INFLIGHT_TABLE_SLOT* old_slots = table->slots;
+        size_t old_capacity = table->capacity;
+        size_t index;
+
+        table->slots = new_slots;
+        table->capacity = new_capacity;
+        table->hash_shift = get_hash_shift(new_capacity);
+
+        for (index = 0; index < old_capacity; index++)
+        {
+            if (old_slots[index].packet_id != EMPTY_PACKET_ID)
+            {
+                insert_slot(table, old_slots[index].packet_id, old_slots[index].value);
+            }
+        }
+
+        free(old_slots);
+        result = 0;
+    }
+
+    return result;
+}
+
+static size_t round_up_capacity(size_t initial_capacity)
+{
+    size_t result = DEFAULT_INITIAL_CAPACITY;
+
+    // Keep the load factor at or below one half.
+    while (result < initial_capacity * 2 && result < MAX_TABLE_CAPACITY)
+    {
+        result *= 2;
+    }
+
+    return result;
+}
+
+MQTT_INFLIGHT_TABLE_HANDLE mqtt_inflight_table_create(size_t initial_capacity)
+{
+    MQTT_INFLIGHT_TABLE* result;
+
+    // Codes_SRS_MQTT_INFLIGHT_TABLE_11_001: [ Memory shall be allocated for the MQTT_INFLIGHT_TABLE data structure. ]
+    if ((result = (MQTT_INFLIGHT_TABLE*)malloc(sizeof(MQTT_INFLIGHT_TABLE))) == NULL)
+    {
+        // Codes_SRS_MQTT_INFLIGHT_TABLE_11_002: [ If any allocation fails, mqtt_inflight_table_create shall fail and return NULL. ]
+        LogError("Failure allocating MQTT_INFLIGHT_TABLE");
+    }
+    else
+    {
+        // Codes_SRS_MQTT_INFLIGHT_TABLE_11_003: [ mqtt_inflight_table_create shall allocate a power of two number of slots able to hold `initial_capacity` entries at a load factor of one half, or a default number of slots if `initial_capacity` is zero. ]
+        result->capacity = round_up_capacity(initial_capacity);
+        result->hash_shift = get_hash_shift(result->capacity);
+        result->count = 0;
+
+        if ((result->slots = allocate_slots(result->capacity)) == NULL)
+        {
+            // Codes_SRS_MQTT_INFLIGHT_TABLE_11_002: [ If any allocation fails, mqtt_inflight_table_create shall fail and return NULL. ]
+            LogError("Failure allocating in-flight table slots");
+            free(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+void mqtt_inflight_table_destroy(MQTT_INFLIGHT_TABLE_HANDLE table)
+{
+    // Codes_SRS_MQTT_INFLIGHT_TABLE_11_004: [ If `table` is NULL, mqtt_inflight_table_destroy shall return. ]
+    if (table != NULL)
+    {
+        // Codes_SRS_MQTT_INFLIGHT_TABLE_11_005: [ mqtt_inflight_table_destroy shall free the slots and the table, but not the stored values. ]
+        free(table->slots);
+        free(table);
+    }
+}
+
+int mqtt_inflight_table_add(MQTT_INFLIGHT_TABLE_HANDLE table, uint16_t packet_id, void* value)
+{
+    int result;
+
+    // Codes_SRS_MQTT_INFLIGHT_TABLE_11_006: [ If `table` or `value` is NULL, or `packet_id` is zero, mqtt_inflight_table_add shall fail and return a non-zero value. ]
+    if (table == NULL || value == NULL || packet_id == EMPTY_PACKET_ID)
+    {
+        LogError("Invalid argument (table=%p, packet_id=%d, value=%p)", table, (int)packet_id, value);
+        result = __FAILURE__;
+    }
+    // Codes_SRS_MQTT_INFLIGHT_TABLE_11_007: [ If `packet_id` is already in the table, mqtt_inflight_table_add shall fail and return a non-zero value. ]
+    else if (find_slot(table, packet_id) != NULL)
+    {
+        LogError("Failure: packet id %d is already in flight", (int)packet_id);
+        result = __FAILURE__;
+    }
+    // Codes_SRS_MQTT_INFLIGHT_TABLE_11_008: [ If adding the entry would take the load factor above one half, mqtt_inflight_table_add shall double the number of slots and rehash the existing entries. ]
+    else if (((table->count + 1) * 2 > table->capacity) && (grow_table(table) != 0))
+    {
+        // Codes_SRS_MQTT_INFLIGHT_TABLE_11_009: [ If growing the table fails, mqtt_inflight_table_add shall fail and return a non-zero value. ]
+        LogError("Failure growing the in-flight table");
+        result = __FAILURE__;
+    }
+    else
+    {
+        // Codes_SRS_MQTT_INFLIGHT_TABLE_11_010: [ On success mqtt_inflight_table_add shall store `value` for `packet_id` and return 0. ]
+        insert_slot(table, packet_id, value);
+        table->count++;
+        result = 0;
+    }
+
+    return result;
+}
+
+void* mqtt_inflight_table_find(MQTT_INFLIGHT_TABLE_HANDLE table, uint16_t packet_id)
+{
+    void* result;
+
+    // Codes_SRS_MQTT_INFLIGHT_TABLE_11_011: [ If `table` is NULL or `packet_id` is zero, mqtt_inflight_table_find shall return NULL. ]
+    if (table == NULL || packet_id == EMPTY_PACKET_ID)
+    {
+        result = NULL;
+    }
+    else
+    {
+        // Codes_SRS_MQTT_INFLIGHT_TABLE_11_012: [ mqtt_inflight_table_find shall return the value stored for `packet_id`, or NULL if there is none. ]
+        MQTT_INFLIGHT_TABLE_SLOT* slot = find_slot(table, packet_id);
+        result = (slot == NULL) ? NULL : slot->value;
+    }
+
+    return result;
+}
+
+void* mqtt_inflight_table_remove(MQTT_INFLIGHT_TABLE_HANDLE table, uint16_t packet_id)
+{
+    void* result;
+    MQTT_INFLIGHT_TABLE_SLOT* slot;
+
+    // Codes_SRS_MQTT_INFLIGHT_TABLE_11_013: [ If `table` is NULL or `packet_id` is zero, mqtt_inflight_table_remove shall return NULL. ]
+    if (table == NULL || packet_id == EMPTY_PACKET_ID)
+    {
+        result = NULL;
+    }
+    // Codes_SRS_MQTT_INFLIGHT_TABLE_11_014: [ If `packet_id` is not in the table, mqtt_inflight_table_remove shall return NULL. ]
+    else if ((slot = find_slot(table, packet_id)) == NULL)
+    {
+        result = NULL;
+    }
+    else
+    {
+        // Codes_SRS_MQTT_INFLIGHT_TABLE_11_015: [ mqtt_inflight_table_remove shall remove `packet_id` from the table and return the value that was stored for it. ]
+        size_t mask = table->capacity - 1;
+        size_t hole = (size_t)(slot - table->slots);
+        size_t index = (hole + 1) & mask;
+
+        result = slot->value;
+
+        // Shift back the entries that follow so that no probe sequence is broken by the hole.
+        while (table->slots[index].packet_id != EMPTY_PACKET_ID)
+        {
+            size_t home = get_home_slot(table, table->slots[index].packet_id);
+            if (((index - home) & mask) >= ((index - hole) & mask))
+            {
+                table->slots[hole] = table->slots[index];
+                hole = index;
+            }
+            index = (index + 1) & mask;
+        }
+
+        table->slots[hole].packet_id = EMPTY_PACKET_ID;
+        table->slots[hole].value = NULL;
+        table->count--;
+    }
+
+    return result;
+}
+
+size_t mqtt_inflight_table_get_count(MQTT_INFLIGHT_TABLE_HANDLE table)
+{
+    // Codes_SRS_MQTT_INFLIGHT_TABLE_11_016: [ mqtt_inflight_table_get_count shall return the number of entries in the table, or zero if `table` is NULL. ]
+    return (table == NULL) ? 0 : table->count;
+}
@@ -0,0 +1,339 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/urlencode.h"
+
+#include "mqtt_telemetry_topic.h"
+
+#define TOPIC_PREFIX_START                  "devices/"
+#define TOPIC_PREFIX_END                    "/messages/events/"
+#define PROPERTY_SEPARATOR                  "&"
+#define PROPERTY_KEY_VALUE_SEPARATOR        "="
+#define CORRELATION_ID_PROPERTY             "%24.cid="
+#define MESSAGE_ID_PROPERTY                 "%24.mid="
+#define CONTENT_TYPE_PROPERTY               "%24.ct="
+#define CONTENT_ENCODING_PROPERTY           "%24.ce="
+#define DIAGNOSTIC_ID_PROPERTY              "%24.diagid="
+#define DIAGNOSTIC_CONTEXT_PROPERTY         "%24.diagctx="
+#define DIAGNOSTIC_CONTEXT_CREATION_TIME_UTC_PROPERTY "creationtimeutc="
+
+#define CONST_STRLEN(s)                     (sizeof(s) - 1)
+
+#define SYSTEM_PROPERTY_CORRELATION_ID      0
+#define SYSTEM_PROPERTY_MESSAGE_ID          1
+#define SYSTEM_PROPERTY_CONTENT_TYPE        2
+#define SYSTEM_PROPERTY_CONTENT_ENCODING    3
+#define SYSTEM_PROPERTY_DIAGNOSTIC_ID       4
+#define SYSTEM_PROPERTY_COUNT               5
+
+typedef struct MQTT_TELEMETRY_TOPIC_TAG
+{
+    char* prefix;
+    size_t prefix_length;
+    // URL encoded "creationtimeutc=", the constant start of every diagnostic context value.
+    char* diag_context_prefix;
+    size_t diag_context_prefix_length;
+    char* buffer;
+    size_t buffer_size;
+} MQTT_TELEMETRY_TOPIC;
+
+typedef struct SYSTEM_PROPERTY_TAG
+{
+    const char* name;
+    size_t name_length;
+    const char* value;
+    size_t value_length;
+} SYSTEM_PROPERTY;
+
+static char* append(char* destination, const char* source, size_t length)
+{
+    (void)memcpy(destination, source, length);
+    return destination + length;
+}
+
+static void set_system_property(SYSTEM_PROPERTY* property, const char* name, size_t name_length, const char* value)
+{
+    property->name = name;
+    property->name_length = name_length;
+    property->value = value;
+    property->value_length = (value == NULL) ? 0 : strlen(value);
+}
+
+static int ensure_buffer_size(MQTT_TELEMETRY_TOPIC* topic, size_t required_size)
+{
+    int result;
+
+    if (required_size <= topic->buffer_size)
+    {
+        result = 0;
+    }
+    else
+    {
+        char* new_buffer;
+
+        if ((new_buffer = (char*)realloc(topic->buffer, required_size)) == NULL)
+        {
+            LogError("Failure growing the telemetry topic buffer to %lu bytes", (unsigned long)required_size);
+            result = __FAILURE__;
+        }
+        else
+        {
+            topic->buffer = new_buffer;
+            topic->buffer_size = required_size;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+MQTT_TELEMETRY_TOPIC_HANDLE mqtt_telemetry_topic_create(const char* device_id)
+{
+    MQTT_TELEMETRY_TOPIC* result;
+
+    // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_001: [ If `device_id` is NULL, mqtt_telemetry_topic_create shall fail and return NULL. ]
+    if (device_id == NULL)
+    {
+        LogError("Invalid argument (device_id is NULL)");
+        result = NULL;
+    }
+    // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_002: [ mqtt_telemetry_topic_create shall allocate memory for the MQTT_TELEMETRY_TOPIC data structure. ]
+    else if ((result = (MQTT_TELEMETRY_TOPIC*)malloc(sizeof(MQTT_TELEMETRY_TOPIC))) == NULL)
+    {
+        // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_005: [ If any allocation or encoding fails, mqtt_telemetry_topic_create shall fail and return NULL. ]
+        LogError("Failure allocating MQTT_TELEMETRY_TOPIC");
+    }
+    else
+    {
+        size_t device_id_length = strlen(device_id);
+        STRING_HANDLE diag_context_prefix;
+
+        memset(result, 0, sizeof(MQTT_TELEMETRY_TOPIC));
+        result->prefix_length = CONST_STRLEN(TOPIC_PREFIX_START) + device_id_length + CONST_STRLEN(TOPIC_PREFIX_END);
+
+        // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_003: [ mqtt_telemetry_topic_create shall store the topic prefix "devices/<device_id>/messages/events/". ]
+        if ((result->prefix = (char*)malloc(result->prefix_length + 1)) == NULL)
+        {
+            // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_005: [ If any allocation or encoding fails, mqtt_telemetry_topic_create shall fail and return NULL. ]
+            LogError("Failure allocating the telemetry topic prefix");
+            free(result);
+            result = NULL;
+        }
+        // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_004: [ mqtt_telemetry_topic_create shall URL encode the diagnostic context key "creationtimeutc=" once and store it. ]
+        else if ((diag_context_prefix = URL_EncodeString(DIAGNOSTIC_CONTEXT_CREATION_TIME_UTC_PROPERTY)) == NULL)
+        {
+            // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_005: [ If any allocation or encoding fails, mqtt_telemetry_topic_create shall fail and return NULL. ]
+            LogError("Failure encoding the diagnostic context key");
+            free(result->prefix);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            char* position = result->prefix;
+            const char* encoded_key = STRING_c_str(diag_context_prefix);
+
+            position = append(position, TOPIC_PREFIX_START, CONST_STRLEN(TOPIC_PREFIX_START));
+            position = append(position, device_id, device_id_length);
+            position = append(position, TOPIC_PREFIX_END, CONST_STRLEN(TOPIC_PREFIX_END));
+            *position = '\0';
+
+            result->diag_context_prefix_length = strlen(encoded_key);
+            if ((result->diag_context_prefix = (char*)malloc(result->diag_context_prefix_length + 1)) == NULL)
+            {
+                // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_005: [ If any allocation or encoding fails, mqtt_telemetry_topic_create shall fail and return NULL. ]
+                LogError("Failure allocating the diagnostic context key");
+                free(result->prefix);
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                (void)memcpy(result->diag_context_prefix, encoded_key, result->diag_context_prefix_length + 1);
+            }
+
+            STRING_delete(diag_context_prefix);
+        }
+    }
+
+    return result;
+}
+
+void mqtt_telemetry_topic_destroy(MQTT_TELEMETRY_TOPIC_HANDLE handle)
+{
+    // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_006: [ If `handle` is NULL, mqtt_telemetry_topic_destroy shall return. ]
+    if (handle != NULL)
+    {
+        // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_007: [ mqtt_telemetry_topic_destroy shall free the topic buffer, the stored prefixes and the handle itself. ]
+        free(handle->buffer);
+        free(handle->diag_context_prefix);
+        free(handle->prefix);
+        free(handle);
+    }
+}
+
+const char* mqtt_telemetry_topic_build(MQTT_TELEMETRY_TOPIC_HANDLE handle, IOTHUB_MESSAGE_HANDLE message, size_t* topic_length)
+{
+    const char* result;
+    const IOTHUB_MESSAGE_PROPERTY* properties = NULL;
+    size_t property_count = 0;
+    const IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA* diagnostic_data;
+
+    // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_008: [ If `handle` or `message` is NULL, mqtt_telemetry_topic_build shall fail and return NULL. ]
+    if (handle == NULL || message == NULL)
+    {
+        LogError("Invalid argument (handle=%p, message=%p)", handle, message);
+        result = NULL;
+    }
+    // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_009: [ mqtt_telemetry_topic_build shall obtain the application properties of `message` and the lengths of their keys and values using IoTHubMessage_GetPropertyTable. ]
+    else if (IoTHubMessage_GetPropertyTable(message, &properties, &property_count) != IOTHUB_MESSAGE_OK)
+    {
+        // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_010: [ If IoTHubMessage_GetPropertyTable fails, mqtt_telemetry_topic_build shall fail and return NULL. ]
+        LogError("Failed to get the properties of the message.");
+        result = NULL;
+    }
+    else
+    {
+        SYSTEM_PROPERTY system_properties[SYSTEM_PROPERTY_COUNT];
+        STRING_HANDLE encoded_creation_time = NULL;
+        const char* diag_id = NULL;
+        const char* creation_time_utc = NULL;
+        int diagnostic_result = 0;
+
+        // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_011: [ mqtt_telemetry_topic_build shall read the CorrelationId, MessageId, ContentType, ContentEncoding and diagnostic data of `message`. ]
+        set_system_property(&system_properties[SYSTEM_PROPERTY_CORRELATION_ID], CORRELATION_ID_PROPERTY, CONST_STRLEN(CORRELATION_ID_PROPERTY), IoTHubMessage_GetCorrelationId(message));
+        set_system_property(&system_properties[SYSTEM_PROPERTY_MESSAGE_ID], MESSAGE_ID_PROPERTY, CONST_STRLEN(MESSAGE_ID_PROPERTY), IoTHubMessage_GetMessageId(message));
+        set_system_property(&system_properties[SYSTEM_PROPERTY_CONTENT_TYPE], CONTENT_TYPE_PROPERTY, CONST_STRLEN(CONTENT_TYPE_PROPERTY), IoTHubMessage_GetContentTypeSystemProperty(message));
+        set_system_property(&system_properties[SYSTEM_PROPERTY_CONTENT_ENCODING], CONTENT_ENCODING_PROPERTY, CONST_STRLEN(CONTENT_ENCODING_PROPERTY), IoTHubMessage_GetContentEncodingSystemProperty(message));
+
+        if ((diagnostic_data = IoTHubMessage_GetDiagnosticPropertyData(message)) != NULL)
+        {
+            diag_id = diagnostic_data->diagnosticId;
+            creation_time_utc = diagnostic_data->diagnosticCreationTimeUtc;
+        }
+        set_system_property(&system_properties[SYSTEM_PROPERTY_DIAGNOSTIC_ID], DIAGNOSTIC_ID_PROPERTY, CONST_STRLEN(DIAGNOSTIC_ID_PROPERTY), diag_id);
+
+        if ((diag_id == NULL) != (creation_time_utc == NULL))
+        {
+            // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_012: [ If only one of the diagnostic id and the diagnostic creation time is present, mqtt_telemetry_topic_build shall fail and return NULL. ]
+            LogError("diagid and diagcreationtimeutc must be present simultaneously.");
+            diagnostic_result = __FAILURE__;
+        }
+        // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_013: [ If the diagnostic data is present, mqtt_telemetry_topic_build shall URL encode the creation time using URL_EncodeString. ]
+        else if (creation_time_utc != NULL && (encoded_creation_time = URL_EncodeString(creation_time_utc)) == NULL)
+        {
+            // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_014: [ If URL_EncodeString fails, mqtt_telemetry_topic_build shall fail and return NULL. ]
+            LogError("Failed encoding diagnostic context value");
+            diagnostic_result = __FAILURE__;
+        }
+
+        if (diagnostic_result != 0)
+        {
+            result = NULL;
+        }
+        else
+        {
+            const char* encoded_time = (encoded_creation_time == NULL) ? NULL : STRING_c_str(encoded_creation_time);
+            size_t encoded_time_length = (encoded_time == NULL) ? 0 : strlen(encoded_time);
+            size_t required_size = handle->prefix_length + 1;
+            size_t separators = 0;
+            size_t index;
+
+            // First pass: measure the topic so the buffer is grown at most once.
+            for (index = 0; index < property_count; index++)
+            {
+                required_size += properties[index].keyLength + CONST_STRLEN(PROPERTY_KEY_VALUE_SEPARATOR) + properties[index].valueLength;
+                separators++;
+            }
+
+            for (index = 0; index < SYSTEM_PROPERTY_COUNT; index++)
+            {
+                if (system_properties[index].value != NULL)
+                {
+                    required_size += system_properties[index].name_length + system_properties[index].value_length;
+                    separators++;
+                }
+            }
+
+            if (encoded_time != NULL)
+            {
+                required_size += CONST_STRLEN(DIAGNOSTIC_CONTEXT_PROPERTY) + handle->diag_context_prefix_length + encoded_time_length;
+                separators++;
+            }
+
+            if (separators > 0)
+            {
+                required_size += (separators - 1) * CONST_STRLEN(PROPERTY_SEPARATOR);
+            }
+
+            // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_015: [ mqtt_telemetry_topic_build shall grow the buffer owned by `handle` only when the topic does not fit in it. ]
+            if (ensure_buffer_size(handle, required_size) != 0)
+            {
+                // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_016: [ If growing the buffer fails, mqtt_telemetry_topic_build shall fail and return NULL. ]
+                LogError("Failed allocating the telemetry topic");
+                result = NULL;
+            }
+            else
+            {
+                // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_017: [ mqtt_telemetry_topic_build shall write the topic prefix followed by each application property as `key=value`, then `%24.cid`, `%24.mid`, `%24.ct`, `%24.ce`, `%24.diagid` and `%24.diagctx` for each system property present, separated by `&`. ]
+                char* position = append(handle->buffer, handle->prefix, handle->prefix_length);
+                size_t written = 0;
+
+                for (index = 0; index < property_count; index++)
+                {
+                    position = append(position, properties[index].key, properties[index].keyLength);
+                    position = append(position, PROPERTY_KEY_VALUE_SEPARATOR, CONST_STRLEN(PROPERTY_KEY_VALUE_SEPARATOR));
+                    position = append(position, properties[index].value, properties[index].valueLength);
+                    if (++written < separators)
+                    {
+                        position = append(position, PROPERTY_SEPARATOR, CONST_STRLEN(PROPERTY_SEPARATOR));
+                    }
+                }
+
+                for (index = 0; index < SYSTEM_PROPERTY_COUNT; index++)
+                {
+                    if (system_properties[index].value != NULL)
+                    {
+                        position = append(position, system_properties[index].name, system_properties[index].name_length);
+                        position = append(position, system_properties[index].value, system_properties[index].value_length);
+                        if (++written < separators)
+                        {
+                            position = append(position, PROPERTY_SEPARATOR, CONST_STRLEN(PROPERTY_SEPARATOR));
+                        }
+                    }
+                }
+
+                if (encoded_time != NULL)
+                {
+                    position = append(position, DIAGNOSTIC_CONTEXT_PROPERTY, CONST_STRLEN(DIAGNOSTIC_CONTEXT_PROPERTY));
+                    position = append(position, handle->diag_context_prefix, handle->diag_context_prefix_length);
+                    position = append(position, encoded_time, encoded_time_length);
+                }
+
+                *position = '\0';
+
+                // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_019: [ If `topic_length` is not NULL, mqtt_telemetry_topic_build shall store in it the length of the topic measured by the first pass, without its terminating null. ]
+                if (topic_length != NULL)
+                {
+                    *topic_length = required_size - 1;
+                }
+
+                // Codes_SRS_MQTT_TELEMETRY_TOPIC_11_018: [ On success mqtt_telemetry_topic_build shall return the topic stored in the buffer owned by `handle`. ]
+                result = handle->buffer;
+            }
+        }
+
+        if (encoded_creation_time != NULL)
+        {
+            STRING_delete(encoded_creation_time);
+        }
+    }
+
+    return result;
+}
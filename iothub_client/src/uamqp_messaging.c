@@ -28,6 +28,39 @@
 #define AMQP_DIAGNOSTIC_CONTEXT_KEY "Correlation-Context"
 #define AMQP_DIAGNOSTIC_CREATION_TIME_UTC_KEY "creationtimeutc"
 
+/*the descriptor of the data section (0x75) followed by a vbin8 or a vbin32 constructor and its length*/
+#define AMQP_DATA_SECTION_HEADER_MAX_SIZE 8
+
+#define AMQP_FAULT_INJECTION_PROPERTY_KEY "AzIoTHub_FaultOperationType"
+
+/*the application properties of a received message referenced without allocating; C2D messages seldom carry more*/
+#define APPLICATION_PROPERTIES_ON_STACK 8
+
+/*constructors of the AMQP types the properties sections are written with; strings and symbols are followed by their
+  length in 1 or 4 bytes, lists and maps by their length and number of items in 1 or 4 bytes each*/
+#define AMQP_NULL 0x40
+#define AMQP_LIST0 0x45
+#define AMQP_STR8_UTF8 0xA1
+#define AMQP_SYM8 0xA3
+#define AMQP_STR32_UTF8 0xB1
+#define AMQP_SYM32 0xB3
+#define AMQP_LIST8 0xC0
+#define AMQP_MAP8 0xC1
+#define AMQP_LIST32 0xD0
+#define AMQP_MAP32 0xD1
+
+/*the described type constructor and the smallulong descriptor a section starts with*/
+#define AMQP_SECTION_DESCRIPTOR_LENGTH 3
+#define AMQP_PROPERTIES_DESCRIPTOR 0x73
+#define AMQP_APPLICATION_PROPERTIES_DESCRIPTOR 0x74
+
+/*positions in the list of the properties section of the fields an IoT Hub message sets*/
+#define AMQP_PROPERTIES_MESSAGE_ID 0
+#define AMQP_PROPERTIES_CORRELATION_ID 5
+#define AMQP_PROPERTIES_CONTENT_TYPE 6
+#define AMQP_PROPERTIES_CONTENT_ENCODING 7
+#define AMQP_PROPERTIES_FIELD_COUNT 8
+
 static int encode_callback(void* context, const unsigned char* bytes, size_t length)
 {
     BINARY_DATA* message_body_binary = (BINARY_DATA*)context;
@@ -220,7 +253,7 @@ static int create_message_properties_to_encode(IOTHUB_MESSAGE_HANDLE messageHand
 }
 
 // Adds fault injection properties to an AMQP message.
-static int add_fault_injection_properties(MESSAGE_HANDLE message_batch_container, const char* const* property_keys, const char* const* property_values, size_t property_count)
+static int add_fault_injection_properties(MESSAGE_HANDLE message_batch_container, const IOTHUB_MESSAGE_PROPERTY* properties, size_t property_count)
 {
     int result;
     AMQP_VALUE uamqp_map;
@@ -239,12 +272,12 @@ static int add_fault_injection_properties(MESSAGE_HANDLE message_batch_container
             AMQP_VALUE map_key_value = NULL;
             AMQP_VALUE map_value_value = NULL;
 
-            if ((map_key_value = amqpvalue_create_string(property_keys[i])) == NULL)
+            if ((map_key_value = amqpvalue_create_string(properties[i].key)) == NULL)
             {
                 LogError("Failed to create uAMQP property key name.");
                 result = __FAILURE__;
             }
-            else if ((map_value_value = amqpvalue_create_string(property_values[i])) == NULL)
+            else if ((map_value_value = amqpvalue_create_string(properties[i].value)) == NULL)
             {
                 LogError("Failed to create uAMQP property key value.");
                 result = __FAILURE__;
@@ -283,11 +316,11 @@ static int add_fault_injection_properties(MESSAGE_HANDLE message_batch_container
 // To test AMQP fault injection, we currently must have the error properties be specified on the batch_container
 // (not one of the messages sent in this container).  As the SDK layer does not support options for configuring
 // this envelope (this is AMQP/batching specific), we will instead intercept fault messages and apply to the container.
-static int override_fault_injection_properties_if_needed(MESSAGE_HANDLE message_batch_container,  const char* const* property_keys, const char* const* property_values, size_t property_count, bool *override_for_fault_injection)
+static int override_fault_injection_properties_if_needed(MESSAGE_HANDLE message_batch_container, const IOTHUB_MESSAGE_PROPERTY* properties, size_t property_count, bool *override_for_fault_injection)
 {
     int result;
     
-    if ((property_count == 0) || (strcmp(property_keys[0], "AzIoTHub_FaultOperationType") != 0))
+    if ((property_count == 0) || (strcmp(properties[0].key, AMQP_FAULT_INJECTION_PROPERTY_KEY) != 0))
     {
         *override_for_fault_injection = false;
         result = RESULT_OK;
@@ -295,7 +328,7 @@ static int override_fault_injection_properties_if_needed(MESSAGE_HANDLE message_
     else
     {
         *override_for_fault_injection = true;
-        result = add_fault_injection_properties(message_batch_container,  property_keys, property_values, property_count);
+        result = add_fault_injection_properties(message_batch_container, properties, property_count);
     }
 
     return result;
@@ -304,21 +337,14 @@ static int override_fault_injection_properties_if_needed(MESSAGE_HANDLE message_
 // Codes_SRS_UAMQP_MESSAGING_31_117: [Get application message properties associated with the IOTHUB_MESSAGE_HANDLE to encode, returning the properties and their encoded length.]
 static int create_application_properties_to_encode(MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE *application_properties, size_t *application_properties_length)
 {
-    MAP_HANDLE properties_map;
-    const char* const* property_keys;
-    const char* const* property_values;
+    const IOTHUB_MESSAGE_PROPERTY* properties;
     size_t property_count = 0;
     AMQP_VALUE uamqp_properties_map = NULL;
     int result;
 
-    if ((properties_map = IoTHubMessage_Properties(messageHandle)) == NULL)
-    {
-        LogError("Failed to get property map from IoTHub message.");
-        result = __FAILURE__;
-    }
-    else if (Map_GetInternals(properties_map, &property_keys, &property_values, &property_count) != 0)
+    if (IoTHubMessage_GetPropertyTable(messageHandle, &properties, &property_count) != IOTHUB_MESSAGE_OK)
     {
-        LogError("Failed reading the incoming uAMQP message properties");
+        LogError("Failed to get the properties of the IoTHub message.");
         result = __FAILURE__;
     }
     else if (property_count > 0)
@@ -332,7 +358,7 @@ static int create_application_properties_to_encode(MESSAGE_HANDLE message_batch_
         else
         {
             bool override_for_fault_injection = false;
-            result = override_fault_injection_properties_if_needed(message_batch_container, property_keys, property_values, property_count, &override_for_fault_injection);
+            result = override_fault_injection_properties_if_needed(message_batch_container, properties, property_count, &override_for_fault_injection);
 
             if (override_for_fault_injection == false)
             {
@@ -341,14 +367,14 @@ static int create_application_properties_to_encode(MESSAGE_HANDLE message_batch_
                     AMQP_VALUE map_property_key;
                     AMQP_VALUE map_property_value;
 
-                    if ((map_property_key = amqpvalue_create_string(property_keys[i])) == NULL)
+                    if ((map_property_key = amqpvalue_create_string(properties[i].key)) == NULL)
                     {
                         LogError("Failed amqpvalue_create_string for key");
                         result = __FAILURE__;
                         break;
                     }
 
-                    if ((map_property_value = amqpvalue_create_string(property_values[i])) == NULL)
+                    if ((map_property_value = amqpvalue_create_string(properties[i].value)) == NULL)
                     {
                         LogError("Failed amqpvalue_create_string for value");
                         amqpvalue_destroy(map_property_key);
@@ -512,7 +538,7 @@ static int create_message_annotations_to_encode(IOTHUB_MESSAGE_HANDLE messageHan
 }
 
 // Codes_SRS_UAMQP_MESSAGING_31_118: [Gets data associated with IOTHUB_MESSAGE_HANDLE to encode, either from underlying byte array or string format.]
-static int create_data_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE *data_value, size_t *data_length)
+static int create_data_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, unsigned char *data_header, size_t *data_header_length, const unsigned char **data, size_t *data_length)
 {
     int result;
 
@@ -543,23 +569,36 @@ static int create_data_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE
         {
             messageContentSize = strlen(messageContent);
         }
-    
-        data bin_data;
-        bin_data.bytes = (const unsigned char *)messageContent;
-        bin_data.length = (uint32_t)messageContentSize;
 
-        if ((*data_value = amqpvalue_create_data(bin_data)) == NULL)
-        {
-            LogError("amqpvalue_create_data failed");
-            result = __FAILURE__;
-        }
-        else if (amqpvalue_get_encoded_size(*data_value, data_length) != 0)
+        if (messageContentSize > UINT32_MAX)
         {
-            LogError("amqpvalue_get_encoded_size failed");
+            LogError("message of %lu bytes is too big for an AMQP data section", (unsigned long)messageContentSize);
             result = __FAILURE__;
         }
         else
         {
+            // Codes_SRS_UAMQP_MESSAGING_11_001: [The data section header shall be encoded without copying the payload, which shall be appended as is after it.]
+            size_t header_length = 0;
+            data_header[header_length++] = 0x00; /*described type*/
+            data_header[header_length++] = 0x53; /*smallulong*/
+            data_header[header_length++] = 0x75; /*amqp:data:binary*/
+            if (messageContentSize <= 0xFF)
+            {
+                data_header[header_length++] = 0xA0; /*vbin8*/
+                data_header[header_length++] = (unsigned char)messageContentSize;
+            }
+            else
+            {
+                data_header[header_length++] = 0xB0; /*vbin32*/
+                data_header[header_length++] = (unsigned char)((messageContentSize >> 24) & 0xFF);
+                data_header[header_length++] = (unsigned char)((messageContentSize >> 16) & 0xFF);
+                data_header[header_length++] = (unsigned char)((messageContentSize >> 8) & 0xFF);
+                data_header[header_length++] = (unsigned char)(messageContentSize & 0xFF);
+            }
+
+            *data_header_length = header_length;
+            *data = (const unsigned char*)messageContent;
+            *data_length = messageContentSize;
             result = RESULT_OK;
         }
     }
@@ -567,235 +606,1005 @@ static int create_data_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE
     return result;
 }
 
-// Codes_SRS_UAMQP_MESSAGING_31_120: [Create a blob that contains AMQP encoding of IOTHUB_MESSAGE_HANDLE.]
-// Codes_SRS_UAMQP_MESSAGING_31_121: [Any errors during `message_create_uamqp_encoding_from_iothub_message` stop processing on this message.]
-int message_create_uamqp_encoding_from_iothub_message(MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, BINARY_DATA* body_binary_data)
+typedef struct MESSAGE_PROPERTIES_FIELDS_TAG
 {
-    int result;
+    const char* values[AMQP_PROPERTIES_FIELD_COUNT];    /*NULL for the fields the message does not set*/
+    size_t lengths[AMQP_PROPERTIES_FIELD_COUNT];
+    size_t count;                                       /*the fields up to the last one set, the ones not set before it are written as null*/
+    size_t items_length;
+} MESSAGE_PROPERTIES_FIELDS;
 
-    AMQP_VALUE message_properties = NULL;
-    AMQP_VALUE application_properties = NULL;
-    AMQP_VALUE message_annotations = NULL;
-    AMQP_VALUE data_value = NULL;
-    size_t message_properties_length = 0;
-    size_t application_properties_length = 0;
-    size_t message_annotations_length = 0;
-    size_t data_length = 0;
+static unsigned char* write_uint32(unsigned char* destination, size_t value)
+{
+    *destination++ = (unsigned char)((value >> 24) & 0xFF);
+    *destination++ = (unsigned char)((value >> 16) & 0xFF);
+    *destination++ = (unsigned char)((value >> 8) & 0xFF);
+    *destination++ = (unsigned char)(value & 0xFF);
+    return destination;
+}
 
-    body_binary_data->bytes = NULL;
-    body_binary_data->length = 0;
+static unsigned char* write_section_descriptor(unsigned char* destination, unsigned char descriptor)
+{
+    *destination++ = 0x00; /*described type*/
+    *destination++ = 0x53; /*smallulong*/
+    *destination++ = descriptor;
+    return destination;
+}
 
-    if (create_message_properties_to_encode(message_handle, &message_properties, &message_properties_length) != RESULT_OK)
-    {
-        LogError("create_message_properties_to_encode() failed");
-        result = __FAILURE__;
-    }
-    else if (create_application_properties_to_encode(message_batch_container, message_handle, &application_properties, &application_properties_length) != RESULT_OK)
+static size_t get_string_encoded_length(size_t length)
+{
+    return length + ((length <= 0xFF) ? 2 : 5);
+}
+
+static unsigned char* write_string(unsigned char* destination, unsigned char constructor8, unsigned char constructor32, const char* text, size_t length)
+{
+    if (length <= 0xFF)
     {
-        LogError("create_application_properties_to_encode() failed");
-        result = __FAILURE__;
+        *destination++ = constructor8;
+        *destination++ = (unsigned char)length;
     }
-    else if (create_message_annotations_to_encode(message_handle, &message_annotations, &message_annotations_length) != RESULT_OK)
+    else
     {
-        LogError("create_message_annotations_to_encode() failed");
-        result = __FAILURE__;
+        *destination++ = constructor32;
+        destination = write_uint32(destination, length);
     }
-    else if (create_data_to_encode(message_handle, &data_value, &data_length) != RESULT_OK)
+
+    (void)memcpy(destination, text, length);
+    return destination + length;
+}
+
+/*a list or a map starts with its constructor, the length of what follows it and its number of items; both fit in 1 byte
+  when there are less than 256 items taking less than 255 bytes, and take 4 bytes each otherwise*/
+static bool is_compound8(size_t item_count, size_t items_length)
+{
+    return (item_count <= 0xFF) && (items_length < 0xFF);
+}
+
+static size_t get_compound_encoded_length(size_t item_count, size_t items_length)
+{
+    return (is_compound8(item_count, items_length) ? 3 : 9) + items_length;
+}
+
+static unsigned char* write_compound_header(unsigned char* destination, unsigned char constructor8, unsigned char constructor32, size_t item_count, size_t items_length)
+{
+    if (is_compound8(item_count, items_length))
     {
-        LogError("create_data_to_encode() failed");
-        result = __FAILURE__;
+        *destination++ = constructor8;
+        *destination++ = (unsigned char)(items_length + 1);
+        *destination++ = (unsigned char)item_count;
     }
-    else if ((body_binary_data->bytes = malloc(message_properties_length + application_properties_length + data_length + message_annotations_length)) == NULL)
+    else
     {
-        LogError("malloc of %d bytes failed", message_properties_length + application_properties_length + data_length + message_annotations_length);
-        result = __FAILURE__;
+        *destination++ = constructor32;
+        destination = write_uint32(destination, items_length + 4);
+        destination = write_uint32(destination, item_count);
     }
-    // Codes_SRS_UAMQP_MESSAGING_31_119: [Invoke underlying AMQP encode routines on data waiting to be encoded.]
-    else if (amqpvalue_encode(message_properties, &encode_callback, body_binary_data) != RESULT_OK)
+
+    return destination;
+}
+
+// Codes_SRS_UAMQP_MESSAGING_11_015: [The properties section shall be written as the list of the message-id (string), user-id, to, subject, reply-to, correlation-id (string), content-type (symbol) and content-encoding (symbol) fields, up to the last one the message sets, the ones it does not set being written as null.]
+static int get_message_properties_fields(IOTHUB_MESSAGE_HANDLE message_handle, MESSAGE_PROPERTIES_FIELDS* fields, size_t* section_length)
+{
+    int result;
+    size_t items_length = 0;
+    size_t i;
+
+    memset(fields, 0, sizeof(MESSAGE_PROPERTIES_FIELDS));
+    fields->values[AMQP_PROPERTIES_MESSAGE_ID] = IoTHubMessage_GetMessageId(message_handle);
+    fields->values[AMQP_PROPERTIES_CORRELATION_ID] = IoTHubMessage_GetCorrelationId(message_handle);
+    fields->values[AMQP_PROPERTIES_CONTENT_TYPE] = IoTHubMessage_GetContentTypeSystemProperty(message_handle);
+    fields->values[AMQP_PROPERTIES_CONTENT_ENCODING] = IoTHubMessage_GetContentEncodingSystemProperty(message_handle);
+
+    for (i = 0; i < AMQP_PROPERTIES_FIELD_COUNT; i++)
     {
-        LogError("amqpvalue_encode() for message properties failed");
-        result = __FAILURE__;
+        if (fields->values[i] == NULL)
+        {
+            items_length++; /*null*/
+        }
+        else
+        {
+            fields->lengths[i] = strlen(fields->values[i]);
+            items_length += get_string_encoded_length(fields->lengths[i]);
+            fields->count = i + 1;
+            fields->items_length = items_length;
+        }
     }
-    else if ((application_properties_length > 0) && (amqpvalue_encode(application_properties, &encode_callback, body_binary_data)  != RESULT_OK))
+
+    if (fields->items_length > UINT32_MAX - sizeof(uint32_t))
     {
-        LogError("amqpvalue_encode() for application properties failed");
+        LogError("message properties of %lu bytes are too big for an AMQP list", (unsigned long)fields->items_length);
         result = __FAILURE__;
     }
-    else if (message_annotations_length > 0 && amqpvalue_encode(message_annotations, &encode_callback, body_binary_data) != RESULT_OK)
+    else
     {
-        LogError("amqpvalue_encode() for message annotations failed");
-        result = __FAILURE__;
+        // Codes_SRS_UAMQP_MESSAGING_11_017: [Strings, symbols, lists and maps shall be written with a 1 byte length (and count) when it fits, and with a 4 bytes one otherwise; a list with no items shall be written as list0.]
+        *section_length = AMQP_SECTION_DESCRIPTOR_LENGTH + ((fields->count == 0) ? 1 : get_compound_encoded_length(fields->count, fields->items_length));
+        result = RESULT_OK;
     }
-    else if (RESULT_OK != amqpvalue_encode(data_value, &encode_callback, body_binary_data))
+
+    return result;
+}
+
+static void write_message_properties(unsigned char* destination, const MESSAGE_PROPERTIES_FIELDS* fields)
+{
+    size_t i;
+
+    destination = write_section_descriptor(destination, AMQP_PROPERTIES_DESCRIPTOR);
+
+    if (fields->count == 0)
     {
-        LogError("amqpvalue_encode() for data value failed");
-        result = __FAILURE__;
+        *destination = AMQP_LIST0;
     }
     else
     {
-        body_binary_data->length = message_properties_length + application_properties_length + data_length + message_annotations_length;
-        result = RESULT_OK;
+        destination = write_compound_header(destination, AMQP_LIST8, AMQP_LIST32, fields->count, fields->items_length);
+
+        for (i = 0; i < fields->count; i++)
+        {
+            if (fields->values[i] == NULL)
+            {
+                *destination++ = AMQP_NULL;
+            }
+            else if (i == AMQP_PROPERTIES_CONTENT_TYPE || i == AMQP_PROPERTIES_CONTENT_ENCODING)
+            {
+                destination = write_string(destination, AMQP_SYM8, AMQP_SYM32, fields->values[i], fields->lengths[i]);
+            }
+            else
+            {
+                destination = write_string(destination, AMQP_STR8_UTF8, AMQP_STR32_UTF8, fields->values[i], fields->lengths[i]);
+            }
+        }
     }
+}
+
+// Codes_SRS_UAMQP_MESSAGING_11_016: [The application-properties section shall be written as a map of the string keys and values of the message properties, in the order of the property table of the message.]
+static int get_application_properties_items_length(const IOTHUB_MESSAGE_PROPERTY* properties, size_t property_count, size_t* items_length)
+{
+    int result;
+    size_t i;
 
-    if (NULL != data_value)
+    *items_length = 0;
+
+    for (i = 0; i < property_count; i++)
     {
-        amqpvalue_destroy(data_value);
+        *items_length += get_string_encoded_length(properties[i].keyLength) + get_string_encoded_length(properties[i].valueLength);
     }
 
-    if (NULL != application_properties)
+    if (*items_length > UINT32_MAX - sizeof(uint32_t) || property_count > UINT32_MAX / 2)
     {
-        amqpvalue_destroy(application_properties);
+        LogError("application properties of %lu bytes are too big for an AMQP map", (unsigned long)*items_length);
+        result = __FAILURE__;
     }
-
-    if (NULL != message_annotations)
+    else
     {
-        amqpvalue_destroy(message_annotations);
+        result = RESULT_OK;
     }
 
-    if (NULL != message_properties)
+    return result;
+}
+
+static void write_application_properties(unsigned char* destination, const IOTHUB_MESSAGE_PROPERTY* properties, size_t property_count, size_t items_length, size_t* value_offsets)
+{
+    unsigned char* section = destination;
+    size_t i;
+
+    destination = write_section_descriptor(destination, AMQP_APPLICATION_PROPERTIES_DESCRIPTOR);
+    destination = write_compound_header(destination, AMQP_MAP8, AMQP_MAP32, 2 * property_count, items_length);
+
+    for (i = 0; i < property_count; i++)
     {
-        amqpvalue_destroy(message_properties);
+        destination = write_string(destination, AMQP_STR8_UTF8, AMQP_STR32_UTF8, properties[i].key, properties[i].keyLength);
+        destination = write_string(destination, AMQP_STR8_UTF8, AMQP_STR32_UTF8, properties[i].value, properties[i].valueLength);
+
+        if (value_offsets != NULL)
+        {
+            value_offsets[i] = (size_t)(destination - section) - properties[i].valueLength;
+        }
     }
+}
 
-    return result;
+typedef enum CACHED_SECTION_KIND_TAG
+{
+    CACHED_SECTION_KIND_NONE,
+    CACHED_SECTION_KIND_PROPERTIES,
+    CACHED_SECTION_KIND_APPLICATION_PROPERTIES
+} CACHED_SECTION_KIND;
+
+typedef struct CACHED_SECTION_TAG
+{
+    CACHED_SECTION_KIND kind;
+    unsigned char* signature;       /*what the section was written from: the content type and encoding, or the names of the application properties*/
+    size_t signature_length;
+    unsigned char* encoded;
+    size_t encoded_length;
+    size_t* value_offsets;          /*application properties only: where the bytes of each value start in `encoded`*/
+    size_t* value_lengths;
+    size_t value_count;
+    uint64_t last_used;
+} CACHED_SECTION;
+
+typedef struct MESSAGE_SECTIONS_CACHE_TAG
+{
+    CACHED_SECTION* entries;
+    size_t entry_count;
+    uint64_t use_count;
+    unsigned char* signature;       /*the signature of the section being looked up is built here*/
+    size_t signature_size;
+    size_t signature_length;
+} MESSAGE_SECTIONS_CACHE;
+
+static void clear_cached_section(CACHED_SECTION* entry)
+{
+    free(entry->signature);
+    free(entry->encoded);
+    free(entry->value_offsets);
+    memset(entry, 0, sizeof(CACHED_SECTION));
 }
 
-static int readMessageIdFromuAQMPMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, PROPERTIES_HANDLE uamqp_message_properties)
+static int append_to_signature(MESSAGE_SECTIONS_CACHE* cache, const char* text, size_t text_length)
 {
     int result;
-    AMQP_VALUE uamqp_message_property;
+    /*a NULL text and an empty one must not give the same signature, so each text is preceded by a marker and its length*/
+    unsigned char is_present = (text != NULL) ? 1 : 0;
+    size_t needed_size = cache->signature_length + sizeof(is_present) + sizeof(text_length) + text_length;
 
-    // Codes_SRS_UAMQP_MESSAGING_09_010: [The message-id property shall be read from the uAMQP message by calling properties_get_message_id.]
-    if (properties_get_message_id(uamqp_message_properties, &uamqp_message_property) != 0 || uamqp_message_property == NULL)
+    if (needed_size > cache->signature_size)
     {
-        // Codes_SRS_UAMQP_MESSAGING_09_011: [If the uAMQP message does not contain property `message ID`, it shall be skipped as it is optional.]
-        result = RESULT_OK;
+        size_t new_size = cache->signature_size * 2;
+        unsigned char* new_signature;
+
+        if (new_size < needed_size)
+        {
+            new_size = needed_size;
+        }
+
+        if ((new_signature = (unsigned char*)realloc(cache->signature, new_size)) == NULL)
+        {
+            LogError("Failed growing the section signature to %lu bytes", (unsigned long)new_size);
+            result = __FAILURE__;
+        }
+        else
+        {
+            cache->signature = new_signature;
+            cache->signature_size = new_size;
+            result = RESULT_OK;
+        }
     }
     else
     {
-        // Codes_SRS_UAMQP_MESSAGING_09_012: [The type of the message-id property value shall be obtained using amqpvalue_get_type().]
-        AMQP_TYPE value_type = amqpvalue_get_type(uamqp_message_property);
+        result = RESULT_OK;
+    }
 
-        // Codes_SRS_UAMQP_MESSAGING_09_013: [If the type of the message-id property value is AMQP_TYPE_NULL, message_create_IoTHubMessage_from_uamqp_message() shall skip processing the message-id (as it is optional) and continue normally.]
-        if (value_type != AMQP_TYPE_NULL)
+    if (result == RESULT_OK)
+    {
+        cache->signature[cache->signature_length++] = is_present;
+        (void)memcpy(cache->signature + cache->signature_length, &text_length, sizeof(text_length));
+        cache->signature_length += sizeof(text_length);
+
+        if (text_length > 0)
         {
+            (void)memcpy(cache->signature + cache->signature_length, text, text_length);
+            cache->signature_length += text_length;
+        }
+    }
 
-            char* string_value;
-            char string_buffer[MESSAGE_ID_MAX_SIZE];
-            bool free_string_value = false;
-            
-            memset(string_buffer, 0, MESSAGE_ID_MAX_SIZE);
+    return result;
+}
 
-            if (value_type == AMQP_TYPE_STRING)
-            {
-                // Codes_SRS_UAMQP_MESSAGING_09_014: [The message-id value shall be retrieved from the AMQP_VALUE as char sequence] 
-                if (amqpvalue_get_string(uamqp_message_property, (const char**)(&string_value)) != 0)
-                {
-                    // Codes_SRS_UAMQP_MESSAGING_09_015: [If message-id fails to be obtained, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.] 
-                    LogError("Failed to get value of uAMQP message 'message-id' property (string)");
-                    string_value = NULL;
-                }
-            }
-            else if (value_type == AMQP_TYPE_ULONG)
-            {
-                uint64_t ulong_value;
+static CACHED_SECTION* find_cached_section(MESSAGE_SECTIONS_CACHE* cache, CACHED_SECTION_KIND kind)
+{
+    CACHED_SECTION* result = NULL;
+    size_t i;
 
-                // Codes_SRS_UAMQP_MESSAGING_09_014: [The message-id value shall be retrieved from the AMQP_VALUE as char sequence] 
-                if (amqpvalue_get_ulong(uamqp_message_property, &ulong_value) != 0)
-                {
-                    // Codes_SRS_UAMQP_MESSAGING_09_015: [If message-id fails to be obtained, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.] 
-                    LogError("Failed to get value of uAMQP message 'message-id' property (ulong)");
-                    string_value = NULL;
-                }
-                else if (sprintf(string_buffer, "%" PRIu64, ulong_value) < 0)
-                {
-                    LogError("Failed converting 'message-id' (ulong) to string");
-                    string_value = NULL;
-                }
-                else
-                {
-                    string_value = string_buffer;
-                }
-            }
-            else if (value_type == AMQP_TYPE_UUID)
-            {
-                uuid uuid_value;
+    for (i = 0; i < cache->entry_count; i++)
+    {
+        CACHED_SECTION* entry = &cache->entries[i];
 
-                // Codes_SRS_UAMQP_MESSAGING_09_014: [The message-id value shall be retrieved from the AMQP_VALUE as char sequence] 
-                if (amqpvalue_get_uuid(uamqp_message_property, &uuid_value) != 0)
-                {
-                    // Codes_SRS_UAMQP_MESSAGING_09_015: [If message-id fails to be obtained, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.] 
-                    LogError("Failed to get value of uAMQP message 'message-id' property (UUID)");
-                    string_value = NULL;
-                }
-                else if ((string_value = UUID_to_string((UUID*)uuid_value)) == NULL)
-                {
-                    // Codes_SRS_UAMQP_MESSAGING_09_015: [If message-id fails to be obtained, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.] 
-                    LogError("Failed to get the string representation of 'message-id' UUID");
-                    string_value = NULL;
-                }
-                else
-                {
-                    free_string_value = true;
-                }
-            }
-            else
-            {
-                LogError("Unrecognized type for message-id (%d)", value_type);
-                string_value = NULL;
-            }
+        if (entry->kind == kind &&
+            entry->signature_length == cache->signature_length &&
+            memcmp(entry->signature, cache->signature, cache->signature_length) == 0)
+        {
+            entry->last_used = ++cache->use_count;
+            result = entry;
+            break;
+        }
+    }
 
-            if (string_value != NULL)
-            {
-                // Codes_SRS_UAMQP_MESSAGING_09_016: [The message-id property shall be set on the IOTHUB_MESSAGE_HANDLE instance by calling IoTHubMessage_SetMessageId(), passing the value read from the uAMQP message.] 
-                if (IoTHubMessage_SetMessageId(iothub_message_handle, string_value) != IOTHUB_MESSAGE_OK)
-                {
-                    // Codes_SRS_UAMQP_MESSAGING_09_017: [If IoTHubMessage_SetMessageId fails, IoTHubMessage_CreateFromuAMQPMessage() shall fail and return immediately.] 
-                    LogError("Failed to set IOTHUB_MESSAGE_HANDLE 'message-id' property.");
-                    result = __FAILURE__;
-                }
-                else
-                {
-                    result = RESULT_OK;
-                }
+    return result;
+}
 
-                if (free_string_value)
-                {
-                    // Only certain code paths allocate this.
-                    free(string_value);
-                }
-            }
-            else
-            {
-                LogError("Unexpected null string for message-id");
-                result = __FAILURE__;
-            }
+// Codes_SRS_UAMQP_MESSAGING_11_009: [When the cache is full, the section used the least recently shall be replaced.]
+static CACHED_SECTION* get_entry_to_reuse(MESSAGE_SECTIONS_CACHE* cache)
+{
+    CACHED_SECTION* result = &cache->entries[0];
+    size_t i;
+
+    for (i = 0; i < cache->entry_count; i++)
+    {
+        if (cache->entries[i].kind == CACHED_SECTION_KIND_NONE)
+        {
+            result = &cache->entries[i];
+            break;
         }
-        else
+        else if (cache->entries[i].last_used < result->last_used)
         {
-            result = RESULT_OK;
+            result = &cache->entries[i];
         }
     }
 
+    clear_cached_section(result);
+
     return result;
 }
 
-static int readCorrelationIdFromuAQMPMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, PROPERTIES_HANDLE uamqp_message_properties)
+// Makes room in `entry` for a section of `encoded_length` bytes, which the caller writes into `entry->encoded`.
+static int store_section(MESSAGE_SECTIONS_CACHE* cache, CACHED_SECTION* entry, CACHED_SECTION_KIND kind, size_t encoded_length)
 {
     int result;
-    AMQP_VALUE uamqp_message_property;
 
-    // Codes_SRS_UAMQP_MESSAGING_09_018: [The correlation-id property shall be read from the uAMQP message by calling properties_get_correlation_id.]
-    if (properties_get_correlation_id(uamqp_message_properties, &uamqp_message_property) != 0 || uamqp_message_property == NULL)
+    if ((entry->signature = (unsigned char*)malloc(cache->signature_length)) == NULL)
     {
-        // Codes_SRS_UAMQP_MESSAGING_09_019: [If the uAMQP message does not contain property `correlation ID`, it shall be skipped as it is optional.]
-        result = RESULT_OK;
+        LogError("Failed allocating the signature of the cached section");
+        result = __FAILURE__;
+    }
+    else if ((entry->encoded = (unsigned char*)malloc(encoded_length)) == NULL)
+    {
+        LogError("Failed allocating %lu bytes for the cached section", (unsigned long)encoded_length);
+        result = __FAILURE__;
     }
     else
     {
-        // Codes_SRS_UAMQP_MESSAGING_09_020: [The type of the correlation-id property value shall be obtained using amqpvalue_get_type().]
-        AMQP_TYPE value_type = amqpvalue_get_type(uamqp_message_property);
-
+        (void)memcpy(entry->signature, cache->signature, cache->signature_length);
+        entry->signature_length = cache->signature_length;
+        entry->encoded_length = encoded_length;
+        entry->kind = kind;
+        entry->last_used = ++cache->use_count;
+        result = RESULT_OK;
+    }
+
+    if (result != RESULT_OK)
+    {
+        clear_cached_section(entry);
+    }
+
+    return result;
+}
+
+// Codes_SRS_UAMQP_MESSAGING_11_010: [The position of each value shall be recorded when an application-properties section is written into the cache.]
+static int store_application_properties(MESSAGE_SECTIONS_CACHE* cache, CACHED_SECTION* entry, const IOTHUB_MESSAGE_PROPERTY* properties, size_t property_count, size_t items_length, size_t encoded_length)
+{
+    int result;
+    size_t i;
+
+    if (store_section(cache, entry, CACHED_SECTION_KIND_APPLICATION_PROPERTIES, encoded_length) != RESULT_OK)
+    {
+        result = __FAILURE__;
+    }
+    else if ((entry->value_offsets = (size_t*)malloc(2 * property_count * sizeof(size_t))) == NULL)
+    {
+        LogError("Failed allocating the value offsets of the cached section");
+        clear_cached_section(entry);
+        result = __FAILURE__;
+    }
+    else
+    {
+        entry->value_lengths = entry->value_offsets + property_count;
+        entry->value_count = property_count;
+
+        for (i = 0; i < property_count; i++)
+        {
+            entry->value_lengths[i] = properties[i].valueLength;
+        }
+
+        write_application_properties(entry->encoded, properties, property_count, items_length, entry->value_offsets);
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+// Codes_SRS_UAMQP_MESSAGING_11_011: [If every value of the application properties has the length it had in the cached section, the changed values shall be copied over the cached ones and the cached section used; otherwise the section shall be written again.]
+static bool update_cached_application_property_values(CACHED_SECTION* entry, const IOTHUB_MESSAGE_PROPERTY* properties, size_t property_count)
+{
+    bool result = (entry->value_count == property_count);
+    size_t i;
+
+    for (i = 0; result && i < property_count; i++)
+    {
+        result = (properties[i].valueLength == entry->value_lengths[i]);
+    }
+
+    /*a string keeps its constructor and length bytes when its length does not change, and so does the map around it*/
+    for (i = 0; result && i < property_count; i++)
+    {
+        if (memcmp(entry->encoded + entry->value_offsets[i], properties[i].value, properties[i].valueLength) != 0)
+        {
+            (void)memcpy(entry->encoded + entry->value_offsets[i], properties[i].value, properties[i].valueLength);
+        }
+    }
+
+    return result;
+}
+
+typedef struct SECTIONS_TO_ENCODE_TAG
+{
+    AMQP_VALUE message_properties;
+    AMQP_VALUE application_properties;
+    AMQP_VALUE message_annotations;
+    MESSAGE_PROPERTIES_FIELDS message_properties_fields;        /*written directly when there is neither message_properties nor encoded_message_properties*/
+    const IOTHUB_MESSAGE_PROPERTY* application_property_table;  /*written directly when there is neither application_properties nor encoded_application_properties*/
+    size_t application_property_count;
+    size_t application_properties_items_length;
+    const unsigned char* encoded_message_properties;            /*set when the section comes from the cache*/
+    const unsigned char* encoded_application_properties;        /*set when the section comes from the cache*/
+    unsigned char data_header[AMQP_DATA_SECTION_HEADER_MAX_SIZE];
+    const unsigned char* data;
+    size_t message_properties_length;
+    size_t application_properties_length;
+    size_t message_annotations_length;
+    size_t data_header_length;
+    size_t data_length;
+} SECTIONS_TO_ENCODE;
+
+static void destroy_sections_to_encode(SECTIONS_TO_ENCODE* sections)
+{
+    if (NULL != sections->application_properties)
+    {
+        amqpvalue_destroy(sections->application_properties);
+    }
+
+    if (NULL != sections->message_annotations)
+    {
+        amqpvalue_destroy(sections->message_annotations);
+    }
+
+    if (NULL != sections->message_properties)
+    {
+        amqpvalue_destroy(sections->message_properties);
+    }
+}
+
+// Codes_SRS_UAMQP_MESSAGING_11_007: [If `sections_cache` is not NULL and the message has no message-id nor correlation-id, the properties section shall be taken from the cache when one was written before with the same content-type and content-encoding, and added to the cache otherwise.]
+static int get_message_properties_to_write(MESSAGE_SECTIONS_CACHE* cache, IOTHUB_MESSAGE_HANDLE message_handle, SECTIONS_TO_ENCODE* sections)
+{
+    int result;
+    MESSAGE_PROPERTIES_FIELDS* fields = &sections->message_properties_fields;
+    CACHED_SECTION* entry;
+
+    if (get_message_properties_fields(message_handle, fields, &sections->message_properties_length) != RESULT_OK)
+    {
+        result = __FAILURE__;
+    }
+    /*message and correlation ids are seldom repeated, a section holding them is not worth caching*/
+    else if (cache == NULL || fields->values[AMQP_PROPERTIES_MESSAGE_ID] != NULL || fields->values[AMQP_PROPERTIES_CORRELATION_ID] != NULL)
+    {
+        result = RESULT_OK;
+    }
+    else
+    {
+        cache->signature_length = 0;
+
+        /*a section that cannot be cached is written directly*/
+        if (append_to_signature(cache, fields->values[AMQP_PROPERTIES_CONTENT_TYPE], fields->lengths[AMQP_PROPERTIES_CONTENT_TYPE]) != RESULT_OK ||
+            append_to_signature(cache, fields->values[AMQP_PROPERTIES_CONTENT_ENCODING], fields->lengths[AMQP_PROPERTIES_CONTENT_ENCODING]) != RESULT_OK)
+        {
+            LogError("Failed building the signature of the message properties");
+        }
+        else if ((entry = find_cached_section(cache, CACHED_SECTION_KIND_PROPERTIES)) != NULL)
+        {
+            sections->encoded_message_properties = entry->encoded;
+        }
+        else
+        {
+            entry = get_entry_to_reuse(cache);
+
+            if (store_section(cache, entry, CACHED_SECTION_KIND_PROPERTIES, sections->message_properties_length) == RESULT_OK)
+            {
+                write_message_properties(entry->encoded, fields);
+                sections->encoded_message_properties = entry->encoded;
+            }
+        }
+
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+// Codes_SRS_UAMQP_MESSAGING_11_008: [If `sections_cache` is not NULL, the application-properties section shall be taken from the cache when one was written before with the same property names, in the same order, and added to the cache otherwise.]
+static int get_application_properties_to_write(MESSAGE_SECTIONS_CACHE* cache, MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, SECTIONS_TO_ENCODE* sections)
+{
+    int result;
+    const IOTHUB_MESSAGE_PROPERTY* properties;
+    size_t property_count = 0;
+    size_t items_length;
+    bool override_for_fault_injection = false;
+    CACHED_SECTION* entry = NULL;
+    size_t i;
+
+    if (IoTHubMessage_GetPropertyTable(message_handle, &properties, &property_count) != IOTHUB_MESSAGE_OK)
+    {
+        LogError("Failed to get the properties of the IoTHub message.");
+        result = __FAILURE__;
+    }
+    else if (override_fault_injection_properties_if_needed(message_batch_container, properties, property_count, &override_for_fault_injection) != RESULT_OK)
+    {
+        LogError("Failed setting the fault injection properties on the batch container.");
+        result = __FAILURE__;
+    }
+    else if (property_count == 0 || override_for_fault_injection)
+    {
+        result = RESULT_OK;
+    }
+    else if (get_application_properties_items_length(properties, property_count, &items_length) != RESULT_OK)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        sections->application_property_table = properties;
+        sections->application_property_count = property_count;
+        sections->application_properties_items_length = items_length;
+        sections->application_properties_length = AMQP_SECTION_DESCRIPTOR_LENGTH + get_compound_encoded_length(2 * property_count, items_length);
+        result = RESULT_OK;
+
+        if (cache != NULL)
+        {
+            int signature_result = RESULT_OK;
+            cache->signature_length = 0;
+
+            for (i = 0; i < property_count && signature_result == RESULT_OK; i++)
+            {
+                signature_result = append_to_signature(cache, properties[i].key, properties[i].keyLength);
+            }
+
+            /*a section that cannot be cached is written directly*/
+            if (signature_result != RESULT_OK)
+            {
+                LogError("Failed building the signature of the application properties");
+            }
+            else if ((entry = find_cached_section(cache, CACHED_SECTION_KIND_APPLICATION_PROPERTIES)) != NULL &&
+                update_cached_application_property_values(entry, properties, property_count))
+            {
+                sections->encoded_application_properties = entry->encoded;
+            }
+            else
+            {
+                if (entry == NULL)
+                {
+                    entry = get_entry_to_reuse(cache);
+                }
+                else
+                {
+                    clear_cached_section(entry);
+                }
+
+                if (store_application_properties(cache, entry, properties, property_count, items_length, sections->application_properties_length) == RESULT_OK)
+                {
+                    sections->encoded_application_properties = entry->encoded;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+// Codes_SRS_UAMQP_MESSAGING_11_018: [`message_create_uamqp_encoding_from_iothub_message` shall encode the properties sections from AMQP_VALUEs, and `message_encode_uamqp_from_iothub_message` shall write them directly, giving the same bytes.]
+static int create_sections_to_encode(MESSAGE_SECTIONS_CACHE* cache, bool write_directly, MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, SECTIONS_TO_ENCODE* sections)
+{
+    int result;
+
+    memset(sections, 0, sizeof(*sections));
+
+    if (!write_directly && create_message_properties_to_encode(message_handle, &sections->message_properties, &sections->message_properties_length) != RESULT_OK)
+    {
+        LogError("create_message_properties_to_encode() failed");
+        result = __FAILURE__;
+    }
+    else if (write_directly && get_message_properties_to_write(cache, message_handle, sections) != RESULT_OK)
+    {
+        LogError("get_message_properties_to_write() failed");
+        result = __FAILURE__;
+    }
+    else if (!write_directly && create_application_properties_to_encode(message_batch_container, message_handle, &sections->application_properties, &sections->application_properties_length) != RESULT_OK)
+    {
+        LogError("create_application_properties_to_encode() failed");
+        result = __FAILURE__;
+    }
+    else if (write_directly && get_application_properties_to_write(cache, message_batch_container, message_handle, sections) != RESULT_OK)
+    {
+        LogError("get_application_properties_to_write() failed");
+        result = __FAILURE__;
+    }
+    else if (create_message_annotations_to_encode(message_handle, &sections->message_annotations, &sections->message_annotations_length) != RESULT_OK)
+    {
+        LogError("create_message_annotations_to_encode() failed");
+        result = __FAILURE__;
+    }
+    else if (create_data_to_encode(message_handle, sections->data_header, &sections->data_header_length, &sections->data, &sections->data_length) != RESULT_OK)
+    {
+        LogError("create_data_to_encode() failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = RESULT_OK;
+    }
+
+    if (result != RESULT_OK)
+    {
+        destroy_sections_to_encode(sections);
+    }
+
+    return result;
+}
+
+static size_t get_sections_encoded_length(const SECTIONS_TO_ENCODE* sections)
+{
+    return sections->message_properties_length + sections->application_properties_length + sections->message_annotations_length + sections->data_header_length + sections->data_length;
+}
+
+static int encode_message_properties(const SECTIONS_TO_ENCODE* sections, BINARY_DATA* encoded)
+{
+    int result;
+
+    if (sections->message_properties != NULL)
+    {
+        result = amqpvalue_encode(sections->message_properties, &encode_callback, encoded);
+    }
+    else
+    {
+        if (sections->encoded_message_properties != NULL)
+        {
+            (void)memcpy((unsigned char*)encoded->bytes + encoded->length, sections->encoded_message_properties, sections->message_properties_length);
+        }
+        else
+        {
+            write_message_properties((unsigned char*)encoded->bytes + encoded->length, &sections->message_properties_fields);
+        }
+
+        encoded->length += sections->message_properties_length;
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+static int encode_application_properties(const SECTIONS_TO_ENCODE* sections, BINARY_DATA* encoded)
+{
+    int result;
+
+    if (sections->application_properties != NULL)
+    {
+        result = amqpvalue_encode(sections->application_properties, &encode_callback, encoded);
+    }
+    else
+    {
+        if (sections->encoded_application_properties != NULL)
+        {
+            (void)memcpy((unsigned char*)encoded->bytes + encoded->length, sections->encoded_application_properties, sections->application_properties_length);
+        }
+        else
+        {
+            write_application_properties((unsigned char*)encoded->bytes + encoded->length, sections->application_property_table, sections->application_property_count, sections->application_properties_items_length, NULL);
+        }
+
+        encoded->length += sections->application_properties_length;
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+// Codes_SRS_UAMQP_MESSAGING_31_119: [Invoke underlying AMQP encode routines on data waiting to be encoded.]
+static int encode_sections(const SECTIONS_TO_ENCODE* sections, unsigned char* destination)
+{
+    int result;
+    BINARY_DATA encoded;
+
+    encoded.bytes = destination;
+    encoded.length = 0;
+
+    if (encode_message_properties(sections, &encoded) != RESULT_OK)
+    {
+        LogError("amqpvalue_encode() for message properties failed");
+        result = __FAILURE__;
+    }
+    else if ((sections->application_properties_length > 0) && (encode_application_properties(sections, &encoded) != RESULT_OK))
+    {
+        LogError("amqpvalue_encode() for application properties failed");
+        result = __FAILURE__;
+    }
+    else if (sections->message_annotations_length > 0 && amqpvalue_encode(sections->message_annotations, &encode_callback, &encoded) != RESULT_OK)
+    {
+        LogError("amqpvalue_encode() for message annotations failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        (void)encode_callback(&encoded, sections->data_header, sections->data_header_length);
+        if (sections->data_length > 0)
+        {
+            (void)encode_callback(&encoded, sections->data, sections->data_length);
+        }
+
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+// Codes_SRS_UAMQP_MESSAGING_31_120: [Create a blob that contains AMQP encoding of IOTHUB_MESSAGE_HANDLE.]
+// Codes_SRS_UAMQP_MESSAGING_31_121: [Any errors during `message_create_uamqp_encoding_from_iothub_message` stop processing on this message.]
+int message_create_uamqp_encoding_from_iothub_message(MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, BINARY_DATA* body_binary_data)
+{
+    int result;
+    SECTIONS_TO_ENCODE sections;
+
+    body_binary_data->bytes = NULL;
+    body_binary_data->length = 0;
+
+    if (create_sections_to_encode(NULL, false, message_batch_container, message_handle, &sections) != RESULT_OK)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t encoded_length = get_sections_encoded_length(&sections);
+
+        if ((body_binary_data->bytes = malloc(encoded_length)) == NULL)
+        {
+            LogError("malloc of %lu bytes failed", (unsigned long)encoded_length);
+            result = __FAILURE__;
+        }
+        else if (encode_sections(&sections, (unsigned char*)body_binary_data->bytes) != RESULT_OK)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            body_binary_data->length = encoded_length;
+            result = RESULT_OK;
+        }
+
+        destroy_sections_to_encode(&sections);
+    }
+
+    return result;
+}
+
+int message_encode_uamqp_from_iothub_message(MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, MESSAGE_SECTIONS_CACHE_HANDLE sections_cache, unsigned char* destination, size_t capacity, size_t* encoded_length)
+{
+    int result;
+    SECTIONS_TO_ENCODE sections;
+
+    // Codes_SRS_UAMQP_MESSAGING_11_002: [If `encoded_length` is NULL, or `destination` is NULL while `capacity` is not zero, `message_encode_uamqp_from_iothub_message` shall fail and return a non-zero value.]
+    if (encoded_length == NULL || (destination == NULL && capacity != 0))
+    {
+        LogError("Invalid argument (destination=%p, capacity=%lu, encoded_length=%p)", destination, (unsigned long)capacity, encoded_length);
+        result = __FAILURE__;
+    }
+    else if (create_sections_to_encode(sections_cache, true, message_batch_container, message_handle, &sections) != RESULT_OK)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        // Codes_SRS_UAMQP_MESSAGING_11_003: [`message_encode_uamqp_from_iothub_message` shall set `encoded_length` to the number of bytes the AMQP encoding of the message takes.]
+        *encoded_length = get_sections_encoded_length(&sections);
+
+        // Codes_SRS_UAMQP_MESSAGING_11_004: [If the encoding does not fit in `capacity` bytes, `message_encode_uamqp_from_iothub_message` shall write nothing and return 0.]
+        if (*encoded_length > capacity)
+        {
+            result = RESULT_OK;
+        }
+        // Codes_SRS_UAMQP_MESSAGING_11_005: [Otherwise the message shall be encoded directly into `destination`, without any intermediate allocation.]
+        else if (encode_sections(&sections, destination) != RESULT_OK)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = RESULT_OK;
+        }
+
+        destroy_sections_to_encode(&sections);
+    }
+
+    return result;
+}
+
+MESSAGE_SECTIONS_CACHE_HANDLE message_sections_cache_create(size_t max_entries)
+{
+    MESSAGE_SECTIONS_CACHE* result;
+
+    // Codes_SRS_UAMQP_MESSAGING_11_012: [If `max_entries` is less than 2, `message_sections_cache_create` shall fail and return NULL.]
+    if (max_entries < 2)
+    {
+        LogError("Invalid argument (max_entries=%lu)", (unsigned long)max_entries);
+        result = NULL;
+    }
+    // Codes_SRS_UAMQP_MESSAGING_11_013: [`message_sections_cache_create` shall allocate room for `max_entries` sections; if that fails, it shall return NULL.]
+    else if ((result = (MESSAGE_SECTIONS_CACHE*)malloc(sizeof(MESSAGE_SECTIONS_CACHE))) == NULL)
+    {
+        LogError("Failed allocating the message sections cache");
+    }
+    else
+    {
+        memset(result, 0, sizeof(MESSAGE_SECTIONS_CACHE));
+
+        if ((result->entries = (CACHED_SECTION*)malloc(max_entries * sizeof(CACHED_SECTION))) == NULL)
+        {
+            LogError("Failed allocating %lu cached sections", (unsigned long)max_entries);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            memset(result->entries, 0, max_entries * sizeof(CACHED_SECTION));
+            result->entry_count = max_entries;
+        }
+    }
+
+    return result;
+}
+
+void message_sections_cache_destroy(MESSAGE_SECTIONS_CACHE_HANDLE sections_cache)
+{
+    // Codes_SRS_UAMQP_MESSAGING_11_014: [`message_sections_cache_destroy` shall release every cached section and the cache itself; it shall do nothing if `sections_cache` is NULL.]
+    if (sections_cache != NULL)
+    {
+        size_t i;
+
+        for (i = 0; i < sections_cache->entry_count; i++)
+        {
+            clear_cached_section(&sections_cache->entries[i]);
+        }
+
+        free(sections_cache->entries);
+        free(sections_cache->signature);
+        free(sections_cache);
+    }
+}
+
+static int readMessageIdFromuAQMPMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, PROPERTIES_HANDLE uamqp_message_properties)
+{
+    int result;
+    AMQP_VALUE uamqp_message_property;
+
+    // Codes_SRS_UAMQP_MESSAGING_09_010: [The message-id property shall be read from the uAMQP message by calling properties_get_message_id.]
+    if (properties_get_message_id(uamqp_message_properties, &uamqp_message_property) != 0 || uamqp_message_property == NULL)
+    {
+        // Codes_SRS_UAMQP_MESSAGING_09_011: [If the uAMQP message does not contain property `message ID`, it shall be skipped as it is optional.]
+        result = RESULT_OK;
+    }
+    else
+    {
+        // Codes_SRS_UAMQP_MESSAGING_09_012: [The type of the message-id property value shall be obtained using amqpvalue_get_type().]
+        AMQP_TYPE value_type = amqpvalue_get_type(uamqp_message_property);
+
+        // Codes_SRS_UAMQP_MESSAGING_09_013: [If the type of the message-id property value is AMQP_TYPE_NULL, message_create_IoTHubMessage_from_uamqp_message() shall skip processing the message-id (as it is optional) and continue normally.]
+        if (value_type != AMQP_TYPE_NULL)
+        {
+
+            char* string_value;
+            char string_buffer[MESSAGE_ID_MAX_SIZE];
+            bool free_string_value = false;
+            
+            memset(string_buffer, 0, MESSAGE_ID_MAX_SIZE);
+
+            if (value_type == AMQP_TYPE_STRING)
+            {
+                // Codes_SRS_UAMQP_MESSAGING_09_014: [The message-id value shall be retrieved from the AMQP_VALUE as char sequence] 
+                if (amqpvalue_get_string(uamqp_message_property, (const char**)(&string_value)) != 0)
+                {
+                    // Codes_SRS_UAMQP_MESSAGING_09_015: [If message-id fails to be obtained, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.] 
+                    LogError("Failed to get value of uAMQP message 'message-id' property (string)");
+                    string_value = NULL;
+                }
+            }
+            else if (value_type == AMQP_TYPE_ULONG)
+            {
+                uint64_t ulong_value;
+
+                // Codes_SRS_UAMQP_MESSAGING_09_014: [The message-id value shall be retrieved from the AMQP_VALUE as char sequence] 
+                if (amqpvalue_get_ulong(uamqp_message_property, &ulong_value) != 0)
+                {
+                    // Codes_SRS_UAMQP_MESSAGING_09_015: [If message-id fails to be obtained, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.] 
+                    LogError("Failed to get value of uAMQP message 'message-id' property (ulong)");
+                    string_value = NULL;
+                }
+                else if (sprintf(string_buffer, "%" PRIu64, ulong_value) < 0)
+                {
+                    LogError("Failed converting 'message-id' (ulong) to string");
+                    string_value = NULL;
+                }
+                else
+                {
+                    string_value = string_buffer;
+                }
+            }
+            else if (value_type == AMQP_TYPE_UUID)
+            {
+                uuid uuid_value;
+
+                // Codes_SRS_UAMQP_MESSAGING_09_014: [The message-id value shall be retrieved from the AMQP_VALUE as char sequence] 
+                if (amqpvalue_get_uuid(uamqp_message_property, &uuid_value) != 0)
+                {
+                    // Codes_SRS_UAMQP_MESSAGING_09_015: [If message-id fails to be obtained, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.] 
+                    LogError("Failed to get value of uAMQP message 'message-id' property (UUID)");
+                    string_value = NULL;
+                }
+                else if ((string_value = UUID_to_string((UUID*)uuid_value)) == NULL)
+                {
+                    // Codes_SRS_UAMQP_MESSAGING_09_015: [If message-id fails to be obtained, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.] 
+                    LogError("Failed to get the string representation of 'message-id' UUID");
+                    string_value = NULL;
+                }
+                else
+                {
+                    free_string_value = true;
+                }
+            }
+            else
+            {
+                LogError("Unrecognized type for message-id (%d)", value_type);
+                string_value = NULL;
+            }
+
+            if (string_value != NULL)
+            {
+                // Codes_SRS_UAMQP_MESSAGING_09_016: [The message-id property shall be set on the IOTHUB_MESSAGE_HANDLE instance by calling IoTHubMessage_SetMessageId(), passing the value read from the uAMQP message.] 
+                if (IoTHubMessage_SetMessageId(iothub_message_handle, string_value) != IOTHUB_MESSAGE_OK)
+                {
+                    // Codes_SRS_UAMQP_MESSAGING_09_017: [If IoTHubMessage_SetMessageId fails, IoTHubMessage_CreateFromuAMQPMessage() shall fail and return immediately.] 
+                    LogError("Failed to set IOTHUB_MESSAGE_HANDLE 'message-id' property.");
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    result = RESULT_OK;
+                }
+
+                if (free_string_value)
+                {
+                    // Only certain code paths allocate this.
+                    free(string_value);
+                }
+            }
+            else
+            {
+                LogError("Unexpected null string for message-id");
+                result = __FAILURE__;
+            }
+        }
+        else
+        {
+            result = RESULT_OK;
+        }
+    }
+
+    return result;
+}
+
+static int readCorrelationIdFromuAQMPMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, PROPERTIES_HANDLE uamqp_message_properties)
+{
+    int result;
+    AMQP_VALUE uamqp_message_property;
+
+    // Codes_SRS_UAMQP_MESSAGING_09_018: [The correlation-id property shall be read from the uAMQP message by calling properties_get_correlation_id.]
+    if (properties_get_correlation_id(uamqp_message_properties, &uamqp_message_property) != 0 || uamqp_message_property == NULL)
+    {
+        // Codes_SRS_UAMQP_MESSAGING_09_019: [If the uAMQP message does not contain property `correlation ID`, it shall be skipped as it is optional.]
+        result = RESULT_OK;
+    }
+    else
+    {
+        // Codes_SRS_UAMQP_MESSAGING_09_020: [The type of the correlation-id property value shall be obtained using amqpvalue_get_type().]
+        AMQP_TYPE value_type = amqpvalue_get_type(uamqp_message_property);
+
         // Codes_SRS_UAMQP_MESSAGING_09_021: [If the type of the correlation-id property value is AMQP_TYPE_NULL, IoTHubMessage_CreateFromuAMQPMessage() shall skip processing the correlation-id (as it is optional) and continue normally.] 
         if (value_type != AMQP_TYPE_NULL)
         {
@@ -969,23 +1778,118 @@ static int readPropertiesFromuAMQPMessage(IOTHUB_MESSAGE_HANDLE iothub_message_h
     return result;
 }
 
+// Codes_SRS_UAMQP_MESSAGING_11_019: [The application property names and values shall be referenced in place in the uAMQP values, from a property table kept on the stack for up to APPLICATION_PROPERTIES_ON_STACK properties and allocated once otherwise.]
+static int setApplicationPropertiesFromuAMQPMap(IOTHUB_MESSAGE_HANDLE iothub_message_handle, AMQP_VALUE uamqp_app_properties_map, uint32_t property_count)
+{
+    int result;
+    IOTHUB_MESSAGE_PROPERTY properties_on_stack[APPLICATION_PROPERTIES_ON_STACK];
+    AMQP_VALUE pair_values_on_stack[2 * APPLICATION_PROPERTIES_ON_STACK];
+    IOTHUB_MESSAGE_PROPERTY* properties;
+    AMQP_VALUE* pair_values = NULL;
+    size_t entry_size = sizeof(IOTHUB_MESSAGE_PROPERTY) + 2 * sizeof(AMQP_VALUE);
+
+    if (property_count <= APPLICATION_PROPERTIES_ON_STACK)
+    {
+        properties = properties_on_stack;
+        pair_values = pair_values_on_stack;
+        result = RESULT_OK;
+    }
+    else if (property_count > SIZE_MAX / entry_size ||
+        (properties = (IOTHUB_MESSAGE_PROPERTY*)malloc(property_count * entry_size)) == NULL)
+    {
+        // Codes_SRS_UAMQP_MESSAGING_11_020: [If allocating the property table fails, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.]
+        LogError("Failed allocating the table of %lu application properties.", (unsigned long)property_count);
+        result = __FAILURE__;
+    }
+    else
+    {
+        pair_values = (AMQP_VALUE*)(properties + property_count);
+        result = RESULT_OK;
+    }
+
+    if (result == RESULT_OK)
+    {
+        uint32_t pairs_read = 0;
+        uint32_t i;
+
+        // Codes_SRS_UAMQP_MESSAGING_09_036: [message_create_IoTHubMessage_from_uamqp_message() shall iterate through each uAMQP application property and add it to IOTHUB_MESSAGE_HANDLE properties.]
+        for (i = 0; result == RESULT_OK && i < property_count; i++)
+        {
+            AMQP_VALUE* map_key_name = &pair_values[2 * i];
+            AMQP_VALUE* map_key_value = &pair_values[2 * i + 1];
+            const char* key_name;
+            const char* key_value;
+
+            /*the strings stay in the uAMQP values, which are kept until the properties are set*/
+            *map_key_name = NULL;
+            *map_key_value = NULL;
+            pairs_read++;
+
+            // Codes_SRS_UAMQP_MESSAGING_09_037: [The uAMQP application property name and value shall be obtained using amqpvalue_get_map_key_value_pair.]
+            if ((result = amqpvalue_get_map_key_value_pair(uamqp_app_properties_map, i, map_key_name, map_key_value)) != 0)
+            {
+                // Codes_SRS_UAMQP_MESSAGING_09_038: [If amqpvalue_get_map_key_value_pair fails, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.]
+                LogError("Failed reading the key/value pair from the uAMQP property map (return code %d).", result);
+                result = __FAILURE__;
+            }
+            // Codes_SRS_UAMQP_MESSAGING_09_039: [The uAMQP application property name shall be extracted as string using amqpvalue_get_string.]
+            else if ((result = amqpvalue_get_string(*map_key_name, &key_name)) != 0)
+            {
+                // Codes_SRS_UAMQP_MESSAGING_09_040: [If amqpvalue_get_string fails, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.]
+                LogError("Failed parsing the uAMQP property name (return code %d).", result);
+                result = __FAILURE__;
+            }
+            // Codes_SRS_UAMQP_MESSAGING_09_041: [The uAMQP application property value shall be extracted as string using amqpvalue_get_string.]
+            else if ((result = amqpvalue_get_string(*map_key_value, &key_value)) != 0)
+            {
+                // Codes_SRS_UAMQP_MESSAGING_09_042: [If amqpvalue_get_string fails, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.]
+                LogError("Failed parsing the uAMQP property value (return code %d).", result);
+                result = __FAILURE__;
+            }
+            else
+            {
+                properties[i].key = key_name;
+                properties[i].keyLength = strlen(key_name);
+                properties[i].value = key_value;
+                properties[i].valueLength = strlen(key_value);
+            }
+        }
+
+        // Codes_SRS_UAMQP_MESSAGING_11_021: [The application properties shall be set on the IOTHUB_MESSAGE_HANDLE at once using IoTHubMessage_SetProperties.]
+        if (result == RESULT_OK && IoTHubMessage_SetProperties(iothub_message_handle, properties, property_count) != IOTHUB_MESSAGE_OK)
+        {
+            // Codes_SRS_UAMQP_MESSAGING_11_022: [If IoTHubMessage_SetProperties fails, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.]
+            LogError("Failed setting the application properties of the IoTHub message.");
+            result = __FAILURE__;
+        }
+
+        // Codes_SRS_UAMQP_MESSAGING_09_045: [message_create_IoTHubMessage_from_uamqp_message() shall destroy the uAMQP message property name and value (obtained with amqpvalue_get_string) by calling amqpvalue_destroy().]
+        for (i = 0; i < 2 * pairs_read; i++)
+        {
+            if (pair_values[i] != NULL)
+            {
+                amqpvalue_destroy(pair_values[i]);
+            }
+        }
+
+        if (properties != properties_on_stack)
+        {
+            free(properties);
+        }
+    }
+
+    return result;
+}
+
 static int readApplicationPropertiesFromuAMQPMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, MESSAGE_HANDLE uamqp_message)
 {
     int result;
     AMQP_VALUE uamqp_app_properties = NULL;
     AMQP_VALUE uamqp_app_properties_ipdv = NULL;
     uint32_t property_count = 0;
-    MAP_HANDLE iothub_message_properties_map;
 
-    // Codes_SRS_UAMQP_MESSAGING_09_027: [The IOTHUB_MESSAGE_HANDLE properties shall be retrieved using IoTHubMessage_Properties.]
-    if ((iothub_message_properties_map = IoTHubMessage_Properties(iothub_message_handle)) == NULL)
-    {
-        // Codes_SRS_UAMQP_MESSAGING_09_028: [If IoTHubMessage_Properties fails, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.]
-        LogError("Failed to get property map from IoTHub message.");
-        result = __FAILURE__;
-    }
     // Codes_SRS_UAMQP_MESSAGING_09_029: [The uAMQP message application properties shall be retrieved using message_get_application_properties.]
-    else if ((result = message_get_application_properties(uamqp_message, &uamqp_app_properties)) != 0)
+    if ((result = message_get_application_properties(uamqp_message, &uamqp_app_properties)) != 0)
     {
         // Codes_SRS_UAMQP_MESSAGING_09_030: [If message_get_application_properties fails, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.]
         LogError("Failed reading the incoming uAMQP message properties (return code %d).", result);
@@ -1014,58 +1918,9 @@ static int readApplicationPropertiesFromuAMQPMessage(IOTHUB_MESSAGE_HANDLE iothu
                 LogError("Failed reading the number of values in the uAMQP property map (return code %d).", result);
                 result = __FAILURE__;
             }
-            else
+            else if (property_count > 0)
             {
-                // Codes_SRS_UAMQP_MESSAGING_09_036: [message_create_IoTHubMessage_from_uamqp_message() shall iterate through each uAMQP application property and add it to IOTHUB_MESSAGE_HANDLE properties.]
-                uint32_t i;
-                for (i = 0; result == RESULT_OK && i < property_count; i++)
-                {
-                    AMQP_VALUE map_key_name = NULL;
-                    AMQP_VALUE map_key_value = NULL;
-                    const char *key_name;
-                    const char* key_value;
-
-                    // Codes_SRS_UAMQP_MESSAGING_09_037: [The uAMQP application property name and value shall be obtained using amqpvalue_get_map_key_value_pair.]
-                    if ((result = amqpvalue_get_map_key_value_pair(uamqp_app_properties_ipdv, i, &map_key_name, &map_key_value)) != 0)
-                    {
-                        // Codes_SRS_UAMQP_MESSAGING_09_038: [If amqpvalue_get_map_key_value_pair fails, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.]
-                        LogError("Failed reading the key/value pair from the uAMQP property map (return code %d).", result);
-                        result = __FAILURE__;
-                    }
-
-                    // Codes_SRS_UAMQP_MESSAGING_09_039: [The uAMQP application property name shall be extracted as string using amqpvalue_get_string.]
-                    else if ((result = amqpvalue_get_string(map_key_name, &key_name)) != 0)
-                    {
-                        // Codes_SRS_UAMQP_MESSAGING_09_040: [If amqpvalue_get_string fails, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.]
-                        LogError("Failed parsing the uAMQP property name (return code %d).", result);
-                        result = __FAILURE__;
-                    }
-                    // Codes_SRS_UAMQP_MESSAGING_09_041: [The uAMQP application property value shall be extracted as string using amqpvalue_get_string.]
-                    else if ((result = amqpvalue_get_string(map_key_value, &key_value)) != 0)
-                    {
-                        // Codes_SRS_UAMQP_MESSAGING_09_042: [If amqpvalue_get_string fails, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.]
-                        LogError("Failed parsing the uAMQP property value (return code %d).", result);
-                        result = __FAILURE__;
-                    }
-                    // Codes_SRS_UAMQP_MESSAGING_09_043: [The application property name and value shall be added to IOTHUB_MESSAGE_HANDLE properties using Map_AddOrUpdate.]
-                    else if (Map_AddOrUpdate(iothub_message_properties_map, key_name, key_value) != MAP_OK)
-                    {
-                        // Codes_SRS_UAMQP_MESSAGING_09_044: [If Map_AddOrUpdate fails, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.]
-                        LogError("Failed to add/update IoTHub message property map.");
-                        result = __FAILURE__;
-                    }
-
-                    // Codes_SRS_UAMQP_MESSAGING_09_045: [message_create_IoTHubMessage_from_uamqp_message() shall destroy the uAMQP message property name and value (obtained with amqpvalue_get_string) by calling amqpvalue_destroy().]
-                    if (map_key_name != NULL)
-                    {
-                        amqpvalue_destroy(map_key_name);
-                    }
-
-                    if (map_key_value != NULL)
-                    {
-                        amqpvalue_destroy(map_key_value);
-                    }
-                }
+                result = setApplicationPropertiesFromuAMQPMap(iothub_message_handle, uamqp_app_properties_ipdv, property_count);
             }
 
             // Codes_SRS_UAMQP_MESSAGING_09_046: [message_create_IoTHubMessage_from_uamqp_message() shall destroy the uAMQP message property (obtained with message_get_application_properties) by calling amqpvalue_destroy().]
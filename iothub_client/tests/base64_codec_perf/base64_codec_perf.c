@@ -0,0 +1,155 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures how fast buffers of a few sizes are base64 encoded, comparing Base64_Encode_Bytes (one STRING
+// allocated per call) with base64_codec_encode writing into a buffer the caller already has.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/base64.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+#include "base64_codec.h"
+
+#define TOTAL_BYTES_PER_SIZE    (64 * 1024 * 1024)
+#define LARGEST_SOURCE_SIZE     (64 * 1024)
+
+static const size_t SOURCE_SIZES[] = { 6, 48, 256, 2048, LARGEST_SOURCE_SIZE };
+
+static double get_megabytes_per_second(size_t byte_count, tickcounter_ms_t elapsed_ms)
+{
+    return (double)byte_count * 1000.0 / (1024.0 * 1024.0) / (double)(elapsed_ms == 0 ? 1 : elapsed_ms);
+}
+
+static int run_base64_encode_bytes(TICK_COUNTER_HANDLE tick_counter, const unsigned char* source, size_t size, size_t iterations, double* megabytes_per_second)
+{
+    int result = 0;
+    size_t index;
+    tickcounter_ms_t start_ms;
+    tickcounter_ms_t end_ms;
+
+    (void)tickcounter_get_current_ms(tick_counter, &start_ms);
+    for (index = 0; index < iterations && result == 0; index++)
+    {
+        STRING_HANDLE encoded = Base64_Encode_Bytes(source, size);
+        if (encoded == NULL)
+        {
+            (void)printf("Base64_Encode_Bytes failed\r\n");
+            result = __LINE__;
+        }
+        else
+        {
+            STRING_delete(encoded);
+        }
+    }
+    (void)tickcounter_get_current_ms(tick_counter, &end_ms);
+
+    *megabytes_per_second = get_megabytes_per_second(size * iterations, end_ms - start_ms);
+
+    return result;
+}
+
+static int run_base64_codec_encode(TICK_COUNTER_HANDLE tick_counter, const unsigned char* source, size_t size, size_t iterations, char* destination, double* megabytes_per_second)
+{
+    int result = 0;
+    size_t index;
+    tickcounter_ms_t start_ms;
+    tickcounter_ms_t end_ms;
+
+    (void)tickcounter_get_current_ms(tick_counter, &start_ms);
+    for (index = 0; index < iterations && result == 0; index++)
+    {
+        if (base64_codec_encode(source, size, destination, BASE64_CODEC_ENCODED_SIZE(size)) != 0)
+        {
+            (void)printf("base64_codec_encode failed\r\n");
+            result = __LINE__;
+        }
+    }
+    (void)tickcounter_get_current_ms(tick_counter, &end_ms);
+
+    *megabytes_per_second = get_megabytes_per_second(size * iterations, end_ms - start_ms);
+
+    return result;
+}
+
+static int check_same_encoding(const unsigned char* source, size_t size, char* destination)
+{
+    int result;
+    STRING_HANDLE encoded = Base64_Encode_Bytes(source, size);
+
+    if (encoded == NULL ||
+        base64_codec_encode(source, size, destination, BASE64_CODEC_ENCODED_SIZE(size)) != 0 ||
+        STRING_length(encoded) != BASE64_CODEC_ENCODED_SIZE(size) ||
+        memcmp(STRING_c_str(encoded), destination, BASE64_CODEC_ENCODED_SIZE(size)) != 0)
+    {
+        (void)printf("base64_codec_encode differs from Base64_Encode_Bytes for %lu bytes\r\n", (unsigned long)size);
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    STRING_delete(encoded);
+
+    return result;
+}
+
+int main(void)
+{
+    int result = 0;
+    TICK_COUNTER_HANDLE tick_counter;
+    unsigned char* source;
+    char* destination;
+
+    if ((source = (unsigned char*)malloc(LARGEST_SOURCE_SIZE)) == NULL ||
+        (destination = (char*)malloc(BASE64_CODEC_ENCODED_SIZE(LARGEST_SOURCE_SIZE))) == NULL)
+    {
+        (void)printf("Failed allocating the buffers\r\n");
+        free(source);
+        result = __LINE__;
+    }
+    else
+    {
+        size_t index;
+
+        for (index = 0; index < LARGEST_SOURCE_SIZE; index++)
+        {
+            source[index] = (unsigned char)(index * 31 + 7);
+        }
+
+        if ((tick_counter = tickcounter_create()) == NULL)
+        {
+            (void)printf("Failed creating tick counter\r\n");
+            result = __LINE__;
+        }
+        else
+        {
+            (void)printf("%12s %24s %24s\r\n", "source bytes", "Base64_Encode_Bytes MB/s", "base64_codec_encode MB/s");
+
+            for (index = 0; index < sizeof(SOURCE_SIZES) / sizeof(SOURCE_SIZES[0]) && result == 0; index++)
+            {
+                size_t size = SOURCE_SIZES[index];
+                size_t iterations = TOTAL_BYTES_PER_SIZE / size;
+                double strings_megabytes_per_second;
+                double codec_megabytes_per_second;
+
+                if ((result = check_same_encoding(source, size, destination)) == 0 &&
+                    (result = run_base64_encode_bytes(tick_counter, source, size, iterations, &strings_megabytes_per_second)) == 0 &&
+                    (result = run_base64_codec_encode(tick_counter, source, size, iterations, destination, &codec_megabytes_per_second)) == 0)
+                {
+                    (void)printf("%12lu %24.1f %24.1f\r\n", (unsigned long)size, strings_megabytes_per_second, codec_megabytes_per_second);
+                }
+            }
+
+            tickcounter_destroy(tick_counter);
+        }
+
+        free(destination);
+        free(source);
+    }
+
+    return result;
+}
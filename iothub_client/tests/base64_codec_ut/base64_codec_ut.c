@@ -0,0 +1,291 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#include "base64_codec.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define GUARD_CHARACTER             '#'
+#define GUARD_SIZE                  4
+#define LONG_SOURCE_SIZE            300
+
+static const char* const REFERENCE_CHARACTERS = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+
+// Helpers
+
+// Encodes one group of 3 bytes at a time, the way the SIMD blocks of base64_codec_encode must agree with.
+static void reference_encode(const unsigned char* source, size_t size, char* destination)
+{
+    size_t index;
+
+    for (index = 0; index + 3 <= size; index += 3)
+    {
+        *destination++ = REFERENCE_CHARACTERS[source[index] >> 2];
+        *destination++ = REFERENCE_CHARACTERS[((source[index] & 0x03) << 4) | (source[index + 1] >> 4)];
+        *destination++ = REFERENCE_CHARACTERS[((source[index + 1] & 0x0F) << 2) | (source[index + 2] >> 6)];
+        *destination++ = REFERENCE_CHARACTERS[source[index + 2] & 0x3F];
+    }
+
+    if (size - index == 1)
+    {
+        *destination++ = REFERENCE_CHARACTERS[source[index] >> 2];
+        *destination++ = REFERENCE_CHARACTERS[(source[index] & 0x03) << 4];
+        *destination++ = '=';
+        *destination = '=';
+    }
+    else if (size - index == 2)
+    {
+        *destination++ = REFERENCE_CHARACTERS[source[index] >> 2];
+        *destination++ = REFERENCE_CHARACTERS[((source[index] & 0x03) << 4) | (source[index + 1] >> 4)];
+        *destination++ = REFERENCE_CHARACTERS[(source[index + 1] & 0x0F) << 2];
+        *destination = '=';
+    }
+}
+
+static void assert_guard_intact(const char* guard)
+{
+    size_t index;
+    for (index = 0; index < GUARD_SIZE; index++)
+    {
+        ASSERT_ARE_EQUAL(int, GUARD_CHARACTER, guard[index]);
+    }
+}
+
+// Encodes a RFC 4648 test vector and checks nothing is written past the encoded characters.
+static void assert_encodes_to(const char* source, const char* expected)
+{
+    char destination[16 + GUARD_SIZE];
+    size_t size = strlen(source);
+    size_t encoded_size = strlen(expected);
+
+    (void)memset(destination, GUARD_CHARACTER, sizeof(destination));
+
+    int result = base64_codec_encode((const unsigned char*)source, size, destination, encoded_size);
+
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, encoded_size, BASE64_CODEC_ENCODED_SIZE(size));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(expected, destination, encoded_size));
+    assert_guard_intact(destination + encoded_size);
+}
+
+
+BEGIN_TEST_SUITE(base64_codec_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_BASE64_CODEC_11_001: [ If source is NULL while size is not 0, or destination is NULL, base64_codec_encode shall fail and return a non-zero value. ]
+TEST_FUNCTION(encode_NULL_source)
+{
+    // arrange
+    char destination[8];
+
+    // act
+    int result = base64_codec_encode(NULL, 3, destination, sizeof(destination));
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_BASE64_CODEC_11_001: [ If source is NULL while size is not 0, or destination is NULL, base64_codec_encode shall fail and return a non-zero value. ]
+TEST_FUNCTION(encode_NULL_destination)
+{
+    // arrange
+    const unsigned char source[3] = { 1, 2, 3 };
+
+    // act
+    int result = base64_codec_encode(source, sizeof(source), NULL, 8);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_BASE64_CODEC_11_002: [ If capacity is less than BASE64_CODEC_ENCODED_SIZE(size), base64_codec_encode shall fail and return a non-zero value without writing anything. ]
+TEST_FUNCTION(encode_capacity_too_small_fails_without_writing)
+{
+    // arrange
+    unsigned char source[LONG_SOURCE_SIZE];
+    char destination[BASE64_CODEC_ENCODED_SIZE(LONG_SOURCE_SIZE)];
+    size_t index;
+
+    for (index = 0; index < LONG_SOURCE_SIZE; index++)
+    {
+        source[index] = (unsigned char)index;
+    }
+    (void)memset(destination, GUARD_CHARACTER, sizeof(destination));
+
+    // act
+    int result = base64_codec_encode(source, sizeof(source), destination, sizeof(destination) - 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    for (index = 0; index < sizeof(destination); index++)
+    {
+        ASSERT_ARE_EQUAL(int, GUARD_CHARACTER, destination[index]);
+    }
+}
+
+// Tests_SRS_BASE64_CODEC_11_004: [ base64_codec_encode shall write the BASE64_CODEC_ENCODED_SIZE(size) characters of the base64 encoding of source, padded with '=', without a null terminator, and return 0. ]
+TEST_FUNCTION(encode_empty_source_succeeds)
+{
+    // arrange
+    char destination[GUARD_SIZE];
+    (void)memset(destination, GUARD_CHARACTER, sizeof(destination));
+
+    // act
+    int result = base64_codec_encode(NULL, 0, destination, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    assert_guard_intact(destination);
+}
+
+// Tests_SRS_BASE64_CODEC_11_004: [ base64_codec_encode shall write the BASE64_CODEC_ENCODED_SIZE(size) characters of the base64 encoding of source, padded with '=', without a null terminator, and return 0. ]
+TEST_FUNCTION(encode_RFC4648_test_vectors)
+{
+    // arrange
+
+    // act
+    // assert
+    assert_encodes_to("", "");
+    assert_encodes_to("f", "Zg==");
+    assert_encodes_to("fo", "Zm8=");
+    assert_encodes_to("foo", "Zm9v");
+    assert_encodes_to("foob", "Zm9vYg==");
+    assert_encodes_to("fooba", "Zm9vYmE=");
+    assert_encodes_to("foobar", "Zm9vYmFy");
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_BASE64_CODEC_11_003: [ base64_codec_encode shall encode the blocks of source with the widest of AVX2, SSSE3 or NEON the CPU supports, and the rest of it one group of 3 bytes at a time. ]
+// Tests_SRS_BASE64_CODEC_11_004: [ base64_codec_encode shall write the BASE64_CODEC_ENCODED_SIZE(size) characters of the base64 encoding of source, padded with '=', without a null terminator, and return 0. ]
+TEST_FUNCTION(encode_all_sizes_match_reference)
+{
+    // arrange
+    unsigned char source[LONG_SOURCE_SIZE];
+    char expected[BASE64_CODEC_ENCODED_SIZE(LONG_SOURCE_SIZE)];
+    char destination[BASE64_CODEC_ENCODED_SIZE(LONG_SOURCE_SIZE) + GUARD_SIZE];
+    size_t size;
+
+    // every byte value, so that all the characters of the alphabet come out of the vector lookups
+    for (size = 0; size < LONG_SOURCE_SIZE; size++)
+    {
+        source[size] = (unsigned char)(size * 167 + 13);
+    }
+
+    // act
+    // assert
+    for (size = 0; size <= LONG_SOURCE_SIZE; size++)
+    {
+        size_t encoded_size = BASE64_CODEC_ENCODED_SIZE(size);
+
+        reference_encode(source, size, expected);
+        (void)memset(destination, GUARD_CHARACTER, sizeof(destination));
+
+        int result = base64_codec_encode(source, size, destination, encoded_size);
+
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(expected, destination, encoded_size));
+        assert_guard_intact(destination + encoded_size);
+    }
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_BASE64_CODEC_11_003: [ base64_codec_encode shall encode the blocks of source with the widest of AVX2, SSSE3 or NEON the CPU supports, and the rest of it one group of 3 bytes at a time. ]
+TEST_FUNCTION(encode_unaligned_source_matches_reference)
+{
+    // arrange
+    unsigned char source[LONG_SOURCE_SIZE + 1];
+    char expected[BASE64_CODEC_ENCODED_SIZE(LONG_SOURCE_SIZE)];
+    char destination[BASE64_CODEC_ENCODED_SIZE(LONG_SOURCE_SIZE) + 1];
+    size_t index;
+
+    for (index = 0; index < sizeof(source); index++)
+    {
+        source[index] = (unsigned char)(255 - index);
+    }
+    reference_encode(source + 1, LONG_SOURCE_SIZE, expected);
+
+    // act
+    int result = base64_codec_encode(source + 1, LONG_SOURCE_SIZE, destination + 1, BASE64_CODEC_ENCODED_SIZE(LONG_SOURCE_SIZE));
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(expected, destination + 1, sizeof(expected)));
+}
+
+END_TEST_SUITE(base64_codec_ut)
@@ -26,7 +26,7 @@ static void my_gballoc_free(void* s)
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/buffer_.h"
 #include "azure_c_shared_utility/strings.h"
-#include "azure_c_shared_utility/base64.h"
+#include "base64_codec.h"
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/shared_util_options.h"
@@ -98,11 +98,12 @@ static void my_STRING_delete(STRING_HANDLE h)
     my_gballoc_free((void*)h);
 }
 
-static STRING_HANDLE my_Base64_Encode_Bytes(const unsigned char* source, size_t size)
+static int my_base64_codec_encode(const unsigned char* source, size_t size, char* destination, size_t capacity)
 {
     (void)source;
     (void)size;
-    return (STRING_HANDLE)my_gballoc_malloc(1);
+    (void)memset(destination, 'A', capacity);
+    return 0;
 }
 
 TEST_DEFINE_ENUM_TYPE(BLOB_RESULT, BLOB_RESULT_VALUES);
@@ -259,11 +260,10 @@ TEST_SUITE_INITIALIZE(TestSuiteInitialize)
 
     REGISTER_GLOBAL_MOCK_HOOK(STRING_construct, my_STRING_construct);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_construct, NULL);
-    REGISTER_GLOBAL_MOCK_HOOK(Base64_Encode_Bytes, my_Base64_Encode_Bytes);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Base64_Encode_Bytes, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(base64_codec_encode, my_base64_codec_encode);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(base64_codec_encode, __FAILURE__);
 
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_concat, __FAILURE__);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_concat_with_STRING, __FAILURE__);
 
     REGISTER_GLOBAL_MOCK_RETURNS(HTTPAPIEX_SetOption, HTTPAPIEX_OK, HTTPAPIEX_ERROR);
 
@@ -354,13 +354,14 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_succeeds_when_HTTP_status_code
         )); /*this is the content to be uploaded by this call*/
 
         /*here some sprintf happens and that produces a string in the form: 000000...049999*/
-        STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6)) /*this is converting the produced blockID string to a base64 representation*/
-            .IgnoreArgument_source();
+        STRICT_EXPECTED_CALL(base64_codec_encode(IGNORED_PTR_ARG, 6, IGNORED_PTR_ARG, 8)) /*this is converting the produced blockID string to a base64 representation*/
+            .IgnoreArgument_source()
+            .IgnoreArgument_destination();
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>")) /*this is building the XML*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
-            .IgnoreArgument_s1()
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
+            .IgnoreArgument_handle()
             .IgnoreArgument_s2();
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>")) /*this is building the XML*/
             .IgnoreArgument_handle();
@@ -368,8 +369,8 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_succeeds_when_HTTP_status_code
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=block&blockid=")) /*this is building the relativePath*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
-            .IgnoreArgument_s1()
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
+            .IgnoreArgument_handle()
             .IgnoreArgument_s2();
 
         STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */
@@ -384,8 +385,6 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_succeeds_when_HTTP_status_code
 
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the blockID string to a base64 representation*/
-            .IgnoreArgument_handle();
         STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/
             .IgnoreArgument_handle();
     }
@@ -431,13 +430,14 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_fails_when_HTTPAPIEX_ExecuteRe
         )); /*this is the content to be uploaded by this call*/
 
         /*here some sprintf happens and that produces a string in the form: 000000...049999*/
-        STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6)) /*this is converting the produced blockID string to a base64 representation*/
-            .IgnoreArgument_source();
+        STRICT_EXPECTED_CALL(base64_codec_encode(IGNORED_PTR_ARG, 6, IGNORED_PTR_ARG, 8)) /*this is converting the produced blockID string to a base64 representation*/
+            .IgnoreArgument_source()
+            .IgnoreArgument_destination();
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>")) /*this is building the XML*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
-            .IgnoreArgument_s1()
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
+            .IgnoreArgument_handle()
             .IgnoreArgument_s2();
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>")) /*this is building the XML*/
             .IgnoreArgument_handle();
@@ -445,8 +445,8 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_fails_when_HTTPAPIEX_ExecuteRe
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=block&blockid=")) /*this is building the relativePath*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
-            .IgnoreArgument_s1()
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
+            .IgnoreArgument_handle()
             .IgnoreArgument_s2();
 
         STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */
@@ -462,8 +462,6 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_fails_when_HTTPAPIEX_ExecuteRe
 
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the blockID string to a base64 representation*/
-            .IgnoreArgument_handle();
         STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/
             .IgnoreArgument_handle();
     }
@@ -667,13 +665,14 @@ static void Blob_UploadMultipleBlocksFromSasUri_various_sizes_happy_path_Impl(HT
             )); /*this is the content to be uploaded by this call*/
 
             /*here some sprintf happens and that produces a string in the form: 000000...049999*/
-            STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6)) /*this is converting the produced blockID string to a base64 representation*/
-                .IgnoreArgument_source();
+            STRICT_EXPECTED_CALL(base64_codec_encode(IGNORED_PTR_ARG, 6, IGNORED_PTR_ARG, 8)) /*this is converting the produced blockID string to a base64 representation*/
+                .IgnoreArgument_source()
+                .IgnoreArgument_destination();
 
             STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>")) /*this is building the XML*/
                 .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
-                .IgnoreArgument_s1()
+            STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
+                .IgnoreArgument_handle()
                 .IgnoreArgument_s2();
             STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>")) /*this is building the XML*/
                 .IgnoreArgument_handle();
@@ -681,8 +680,8 @@ static void Blob_UploadMultipleBlocksFromSasUri_various_sizes_happy_path_Impl(HT
 
             STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=block&blockid=")) /*this is building the relativePath*/
                 .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
-                .IgnoreArgument_s1()
+            STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
+                .IgnoreArgument_handle()
                 .IgnoreArgument_s2();
 
             STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */
@@ -695,8 +694,6 @@ static void Blob_UploadMultipleBlocksFromSasUri_various_sizes_happy_path_Impl(HT
 
             STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/
                 .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the blockID string to a base64 representation*/
-                .IgnoreArgument_handle();
             STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/
                 .IgnoreArgument_handle();
         }
@@ -849,13 +846,14 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_various_sizes_with_certificate
             )); /*this is the content to be uploaded by this call*/
 
             /*here some sprintf happens and that produces a string in the form: 000000...049999*/
-            STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6)) /*this is converting the produced blockID string to a base64 representation*/
-                .IgnoreArgument_source();
+            STRICT_EXPECTED_CALL(base64_codec_encode(IGNORED_PTR_ARG, 6, IGNORED_PTR_ARG, 8)) /*this is converting the produced blockID string to a base64 representation*/
+                .IgnoreArgument_source()
+                .IgnoreArgument_destination();
 
             STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>")) /*this is building the XML*/
                 .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
-                .IgnoreArgument_s1()
+            STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
+                .IgnoreArgument_handle()
                 .IgnoreArgument_s2();
             STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>")) /*this is building the XML*/
                 .IgnoreArgument_handle();
@@ -863,8 +861,8 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_various_sizes_with_certificate
 
             STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=block&blockid=")) /*this is building the relativePath*/
                 .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
-                .IgnoreArgument_s1()
+            STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
+                .IgnoreArgument_handle()
                 .IgnoreArgument_s2();
 
             STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */
@@ -877,8 +875,6 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_various_sizes_with_certificate
 
             STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/
                 .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the blockID string to a base64 representation*/
-                .IgnoreArgument_handle();
             STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/
                 .IgnoreArgument_handle();
         }
@@ -947,78 +943,62 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_64MB_unhappy_paths)
     size_t calls_that_cannot_fail[] =
     {
         13   ,/*STRING_delete*/
-        26   ,/*STRING_delete*/
-        39   ,/*STRING_delete*/
-        52   ,/*STRING_delete*/
-        65   ,/*STRING_delete*/
-        78   ,/*STRING_delete*/
-        91   ,/*STRING_delete*/
-        104  ,/*STRING_delete*/
-        117  ,/*STRING_delete*/
-        130  ,/*STRING_delete*/
-        143  ,/*STRING_delete*/
-        156  ,/*STRING_delete*/
+        25   ,/*STRING_delete*/
+        37   ,/*STRING_delete*/
+        49   ,/*STRING_delete*/
+        61   ,/*STRING_delete*/
+        73   ,/*STRING_delete*/
+        85   ,/*STRING_delete*/
+        97   ,/*STRING_delete*/
+        109  ,/*STRING_delete*/
+        121  ,/*STRING_delete*/
+        133  ,/*STRING_delete*/
+        145  ,/*STRING_delete*/
+        157  ,/*STRING_delete*/
         169  ,/*STRING_delete*/
-        182  ,/*STRING_delete*/
-        195  ,/*STRING_delete*/
-        208  ,/*STRING_delete*/
+        181  ,/*STRING_delete*/
+        193  ,/*STRING_delete*/
         11   ,/*STRING_c_str*/
-        24   ,/*STRING_c_str*/
-        37   ,/*STRING_c_str*/
-        50   ,/*STRING_c_str*/
-        63   ,/*STRING_c_str*/
-        76   ,/*STRING_c_str*/
-        89   ,/*STRING_c_str*/
-        102  ,/*STRING_c_str*/
-        115  ,/*STRING_c_str*/
-        128  ,/*STRING_c_str*/
-        141  ,/*STRING_c_str*/
-        154  ,/*STRING_c_str*/
+        23   ,/*STRING_c_str*/
+        35   ,/*STRING_c_str*/
+        47   ,/*STRING_c_str*/
+        59   ,/*STRING_c_str*/
+        71   ,/*STRING_c_str*/
+        83   ,/*STRING_c_str*/
+        95   ,/*STRING_c_str*/
+        107  ,/*STRING_c_str*/
+        119  ,/*STRING_c_str*/
+        131  ,/*STRING_c_str*/
+        143  ,/*STRING_c_str*/
+        155  ,/*STRING_c_str*/
         167  ,/*STRING_c_str*/
-        180  ,/*STRING_c_str*/
-        193  ,/*STRING_c_str*/
-        206  ,/*STRING_c_str*/
-        14   ,/*STRING_delete*/
-        27   ,/*STRING_delete*/
-        40   ,/*STRING_delete*/
-        53   ,/*STRING_delete*/
-        66   ,/*STRING_delete*/
-        79   ,/*STRING_delete*/
-        92   ,/*STRING_delete*/
-        105  ,/*STRING_delete*/
-        118  ,/*STRING_delete*/
-        131  ,/*STRING_delete*/
-        144  ,/*STRING_delete*/
-        157  ,/*STRING_delete*/
-        170  ,/*STRING_delete*/
-        183  ,/*STRING_delete*/
-        196  ,/*STRING_delete*/
-        209  ,/*STRING_delete*/
-        15   ,/*BUFFER_delete*/
-        28   ,/*BUFFER_delete*/
-        41   ,/*BUFFER_delete*/
-        54   ,/*BUFFER_delete*/
-        67   ,/*BUFFER_delete*/
-        80   ,/*BUFFER_delete*/
-        93   ,/*BUFFER_delete*/
-        106  ,/*BUFFER_delete*/
-        119  ,/*BUFFER_delete*/
-        132  ,/*BUFFER_delete*/
-        145  ,/*BUFFER_delete*/
+        179  ,/*STRING_c_str*/
+        191  ,/*STRING_c_str*/
+        14   ,/*BUFFER_delete*/
+        26   ,/*BUFFER_delete*/
+        38   ,/*BUFFER_delete*/
+        50   ,/*BUFFER_delete*/
+        62   ,/*BUFFER_delete*/
+        74   ,/*BUFFER_delete*/
+        86   ,/*BUFFER_delete*/
+        98   ,/*BUFFER_delete*/
+        110  ,/*BUFFER_delete*/
+        122  ,/*BUFFER_delete*/
+        134  ,/*BUFFER_delete*/
+        146  ,/*BUFFER_delete*/
         158  ,/*BUFFER_delete*/
-        171  ,/*BUFFER_delete*/
-        184  ,/*BUFFER_delete*/
-        197  ,/*BUFFER_delete*/
-        210  ,/*BUFFER_delete*/
-
-
-        214, /*STRING_c_str*/
-        216, /*STRING_c_str*/
-        218, /*BUFFER_delete*/
-        219, /*STRING_delete*/
-        220, /*STRING_delete*/
-        221, /*HTTPAPIEX_Destroy*/
-        222, /*gballoc_free*/
+        170  ,/*BUFFER_delete*/
+        182  ,/*BUFFER_delete*/
+        194  ,/*BUFFER_delete*/
+
+
+        198, /*STRING_c_str*/
+        200, /*STRING_c_str*/
+        202, /*BUFFER_delete*/
+        203, /*STRING_delete*/
+        204, /*STRING_delete*/
+        205, /*HTTPAPIEX_Destroy*/
+        206, /*gballoc_free*/
     };
 
     (void)umock_c_negative_tests_init();
@@ -1052,13 +1032,14 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_64MB_unhappy_paths)
         )); /*this is the content to be uploaded by this call*/
 
         /*here some sprintf happens and that produces a string in the form: 000000...049999*/
-        STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6)) /*this is converting the produced blockID string to a base64 representation*/ /*3, 16, 29... (16 numbers)*/
-            .IgnoreArgument_source();
+        STRICT_EXPECTED_CALL(base64_codec_encode(IGNORED_PTR_ARG, 6, IGNORED_PTR_ARG, 8)) /*this is converting the produced blockID string to a base64 representation*/ /*4, 16, 28... (16 numbers)*/
+            .IgnoreArgument_source()
+            .IgnoreArgument_destination();
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>")) /*this is building the XML*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
-            .IgnoreArgument_s1()
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
+            .IgnoreArgument_handle()
             .IgnoreArgument_s2();
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>")) /*this is building the XML*/
             .IgnoreArgument_handle();
@@ -1066,11 +1047,11 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_64MB_unhappy_paths)
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=block&blockid=")) /*this is building the relativePath*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
-            .IgnoreArgument_s1()
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
+            .IgnoreArgument_handle()
             .IgnoreArgument_s2();
 
-        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */ /*11, 24, 27...*/
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */ /*11, 23, 35...*/
             .IgnoreArgument_handle();
 
         STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, &httpResponse, NULL, testValidBufferHandle))
@@ -1080,16 +1061,14 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_64MB_unhappy_paths)
             .CopyOutArgumentBuffer_statusCode(&TwoHundred, sizeof(TwoHundred))
             ;
 
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/ /*13, 26, 39...*/
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/ /*13, 25, 37...*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the blockID string to a base64 representation*/ /*14, 27, 40...*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/ /*15, 28, 41...210 (16 numbers)*/
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/ /*14, 26, 38...194 (16 numbers)*/
             .IgnoreArgument_handle();
     }
 
     /*this part is Put Block list*/
-    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</BlockList>")) /*This is closing the XML*/ /*211*/
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</BlockList>")) /*This is closing the XML*/ /*195*/
         .IgnoreArgument_handle();
     STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relative path for the Put BLock list*/
 
@@ -1176,78 +1155,62 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_64MB_with_certificate_unhappy_
     size_t calls_that_cannot_fail[] =
     {
         13  + 1 ,/*STRING_delete*/
-        26  + 1 ,/*STRING_delete*/
-        39  + 1 ,/*STRING_delete*/
-        52  + 1 ,/*STRING_delete*/
-        65  + 1 ,/*STRING_delete*/
-        78  + 1 ,/*STRING_delete*/
-        91  + 1 ,/*STRING_delete*/
-        104 + 1 ,/*STRING_delete*/
-        117 + 1 ,/*STRING_delete*/
-        130 + 1 ,/*STRING_delete*/
-        143 + 1 ,/*STRING_delete*/
-        156 + 1 ,/*STRING_delete*/
+        25  + 1 ,/*STRING_delete*/
+        37  + 1 ,/*STRING_delete*/
+        49  + 1 ,/*STRING_delete*/
+        61  + 1 ,/*STRING_delete*/
+        73  + 1 ,/*STRING_delete*/
+        85  + 1 ,/*STRING_delete*/
+        97  + 1 ,/*STRING_delete*/
+        109 + 1 ,/*STRING_delete*/
+        121 + 1 ,/*STRING_delete*/
+        133 + 1 ,/*STRING_delete*/
+        145 + 1 ,/*STRING_delete*/
+        157 + 1 ,/*STRING_delete*/
         169 + 1 ,/*STRING_delete*/
-        182 + 1 ,/*STRING_delete*/
-        195 + 1 ,/*STRING_delete*/
-        208 + 1 ,/*STRING_delete*/
+        181 + 1 ,/*STRING_delete*/
+        193 + 1 ,/*STRING_delete*/
         11  + 1 ,/*STRING_c_str*/
-        24  + 1 ,/*STRING_c_str*/
-        37  + 1 ,/*STRING_c_str*/
-        50  + 1 ,/*STRING_c_str*/
-        63  + 1 ,/*STRING_c_str*/
-        76  + 1 ,/*STRING_c_str*/
-        89  + 1 ,/*STRING_c_str*/
-        102 + 1 ,/*STRING_c_str*/
-        115 + 1 ,/*STRING_c_str*/
-        128 + 1 ,/*STRING_c_str*/
-        141 + 1 ,/*STRING_c_str*/
-        154 + 1 ,/*STRING_c_str*/
+        23  + 1 ,/*STRING_c_str*/
+        35  + 1 ,/*STRING_c_str*/
+        47  + 1 ,/*STRING_c_str*/
+        59  + 1 ,/*STRING_c_str*/
+        71  + 1 ,/*STRING_c_str*/
+        83  + 1 ,/*STRING_c_str*/
+        95  + 1 ,/*STRING_c_str*/
+        107 + 1 ,/*STRING_c_str*/
+        119 + 1 ,/*STRING_c_str*/
+        131 + 1 ,/*STRING_c_str*/
+        143 + 1 ,/*STRING_c_str*/
+        155 + 1 ,/*STRING_c_str*/
         167 + 1 ,/*STRING_c_str*/
-        180 + 1 ,/*STRING_c_str*/
-        193 + 1 ,/*STRING_c_str*/
-        206 + 1 ,/*STRING_c_str*/
-        14  + 1 ,/*STRING_delete*/
-        27  + 1 ,/*STRING_delete*/
-        40  + 1 ,/*STRING_delete*/
-        53  + 1 ,/*STRING_delete*/
-        66  + 1 ,/*STRING_delete*/
-        79  + 1 ,/*STRING_delete*/
-        92  + 1 ,/*STRING_delete*/
-        105 + 1 ,/*STRING_delete*/
-        118 + 1 ,/*STRING_delete*/
-        131 + 1 ,/*STRING_delete*/
-        144 + 1 ,/*STRING_delete*/
-        157 + 1 ,/*STRING_delete*/
-        170 + 1 ,/*STRING_delete*/
-        183 + 1 ,/*STRING_delete*/
-        196 + 1 ,/*STRING_delete*/
-        209 + 1 ,/*STRING_delete*/
-        15  + 1 ,/*BUFFER_delete*/
-        28  + 1 ,/*BUFFER_delete*/
-        41  + 1 ,/*BUFFER_delete*/
-        54  + 1 ,/*BUFFER_delete*/
-        67  + 1 ,/*BUFFER_delete*/
-        80  + 1 ,/*BUFFER_delete*/
-        93  + 1 ,/*BUFFER_delete*/
-        106 + 1 ,/*BUFFER_delete*/
-        119 + 1 ,/*BUFFER_delete*/
-        132 + 1 ,/*BUFFER_delete*/
-        145 + 1 ,/*BUFFER_delete*/
+        179 + 1 ,/*STRING_c_str*/
+        191 + 1 ,/*STRING_c_str*/
+        14  + 1 ,/*BUFFER_delete*/
+        26  + 1 ,/*BUFFER_delete*/
+        38  + 1 ,/*BUFFER_delete*/
+        50  + 1 ,/*BUFFER_delete*/
+        62  + 1 ,/*BUFFER_delete*/
+        74  + 1 ,/*BUFFER_delete*/
+        86  + 1 ,/*BUFFER_delete*/
+        98  + 1 ,/*BUFFER_delete*/
+        110 + 1 ,/*BUFFER_delete*/
+        122 + 1 ,/*BUFFER_delete*/
+        134 + 1 ,/*BUFFER_delete*/
+        146 + 1 ,/*BUFFER_delete*/
         158 + 1 ,/*BUFFER_delete*/
-        171 + 1 ,/*BUFFER_delete*/
-        184 + 1 ,/*BUFFER_delete*/
-        197 + 1 ,/*BUFFER_delete*/
-        210 + 1 ,/*BUFFER_delete*/
-
-
-        214+1, /*STRING_c_str*/
-        216+1, /*STRING_c_str*/
-        218+1, /*BUFFER_delete*/
-        219+1, /*STRING_delete*/
-        220+1, /*STRING_delete*/
-        221+1, /*HTTPAPIEX_Destroy*/
-        222+1, /*gballoc_free*/
+        170 + 1 ,/*BUFFER_delete*/
+        182 + 1 ,/*BUFFER_delete*/
+        194 + 1 ,/*BUFFER_delete*/
+
+
+        198+1, /*STRING_c_str*/
+        200+1, /*STRING_c_str*/
+        202+1, /*BUFFER_delete*/
+        203+1, /*STRING_delete*/
+        204+1, /*STRING_delete*/
+        205+1, /*HTTPAPIEX_Destroy*/
+        206+1, /*gballoc_free*/
     };
 
     (void)umock_c_negative_tests_init();
@@ -1282,13 +1245,14 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_64MB_with_certificate_unhappy_
         )); /*this is the content to be uploaded by this call*/
 
         /*here some sprintf happens and that produces a string in the form: 000000...049999*/
-        STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6)) /*this is converting the produced blockID string to a base64 representation*/ /*3, 16, 29... (16 numbers)*/
-            .IgnoreArgument_source(); /* 5 */
+        STRICT_EXPECTED_CALL(base64_codec_encode(IGNORED_PTR_ARG, 6, IGNORED_PTR_ARG, 8)) /*this is converting the produced blockID string to a base64 representation*/ /*5, 17, 29... (16 numbers)*/
+            .IgnoreArgument_source()
+            .IgnoreArgument_destination(); /* 5 */
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>")) /*this is building the XML*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
-            .IgnoreArgument_s1()
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
+            .IgnoreArgument_handle()
             .IgnoreArgument_s2();
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>")) /*this is building the XML*/
             .IgnoreArgument_handle();
@@ -1296,11 +1260,11 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_64MB_with_certificate_unhappy_
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=block&blockid=")) /*this is building the relativePath*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
-            .IgnoreArgument_s1()
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
+            .IgnoreArgument_handle()
             .IgnoreArgument_s2();
 
-        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */ /*12, 25, 38...*/
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */ /*12, 24, 36...*/
             .IgnoreArgument_handle();
 
         STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, &httpResponse, NULL, testValidBufferHandle))
@@ -1310,16 +1274,14 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_64MB_with_certificate_unhappy_
             .CopyOutArgumentBuffer_statusCode(&TwoHundred, sizeof(TwoHundred))
             ; /* 13 */
 
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/ /*14, 27, 40...*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the blockID string to a base64 representation*/ /*15, 28, 41... */
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/ /*14, 26, 38...*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/ /*16, 29, 42...211 (16 numbers)*/
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/ /*15, 27, 39...195 (16 numbers)*/
                     .IgnoreArgument_handle();
     }
 
     /*this part is Put Block list*/
-    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</BlockList>")) /*This is closing the XML*/ /*212*/
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</BlockList>")) /*This is closing the XML*/ /*196*/
         .IgnoreArgument_handle();
     STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relative path for the Put BLock list*/
 
@@ -1430,13 +1392,14 @@ TEST_FUNCTION(Blob_UploadFromSasUri_when_http_code_is_404_it_immediately_succeed
         )); /*this is the content to be uploaded by this call*/
 
         /*here some sprintf happens and that produces a string in the form: 000000...049999*/
-        STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6)) /*this is converting the produced blockID string to a base64 representation*/
-            .IgnoreArgument_source();
+        STRICT_EXPECTED_CALL(base64_codec_encode(IGNORED_PTR_ARG, 6, IGNORED_PTR_ARG, 8)) /*this is converting the produced blockID string to a base64 representation*/
+            .IgnoreArgument_source()
+            .IgnoreArgument_destination();
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>")) /*this is building the XML*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
-            .IgnoreArgument_s1()
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
+            .IgnoreArgument_handle()
             .IgnoreArgument_s2();
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>")) /*this is building the XML*/
             .IgnoreArgument_handle();
@@ -1444,8 +1407,8 @@ TEST_FUNCTION(Blob_UploadFromSasUri_when_http_code_is_404_it_immediately_succeed
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=block&blockid=")) /*this is building the relativePath*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
-            .IgnoreArgument_s1()
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
+            .IgnoreArgument_handle()
             .IgnoreArgument_s2();
 
         STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */
@@ -1460,8 +1423,6 @@ TEST_FUNCTION(Blob_UploadFromSasUri_when_http_code_is_404_it_immediately_succeed
 
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the blockID string to a base64 representation*/
-            .IgnoreArgument_handle();
         STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/
         .IgnoreArgument_handle();
     }
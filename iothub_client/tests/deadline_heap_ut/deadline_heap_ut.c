@@ -0,0 +1,662 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void* real_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "deadline_heap.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define INITIAL_HEAP_CAPACITY               16
+#define TEST_ENTRY_COUNT                    100
+
+static int TEST_VALUES[TEST_ENTRY_COUNT];
+
+
+// Helpers
+
+static DEADLINE_HEAP_HANDLE create_heap(void)
+{
+    DEADLINE_HEAP_HANDLE result = deadline_heap_create();
+    ASSERT_IS_NOT_NULL_WITH_MSG(result, "Failed creating the deadline heap");
+    return result;
+}
+
+static DEADLINE_HEAP_ENTRY_HANDLE add_entry(DEADLINE_HEAP_HANDLE heap, tickcounter_ms_t deadline, size_t value_index)
+{
+    DEADLINE_HEAP_ENTRY_HANDLE result = deadline_heap_add(heap, deadline, &TEST_VALUES[value_index]);
+    ASSERT_IS_NOT_NULL_WITH_MSG(result, "Failed adding an entry to the deadline heap");
+    return result;
+}
+
+
+BEGIN_TEST_SUITE(deadline_heap_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(realloc, real_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(free, real_free);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_DEADLINE_HEAP_11_001: [ deadline_heap_create shall allocate memory for the DEADLINE_HEAP data structure and return it empty. ]
+TEST_FUNCTION(create_success)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+
+    // act
+    DEADLINE_HEAP_HANDLE heap = deadline_heap_create();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(heap);
+    ASSERT_ARE_EQUAL(size_t, 0, deadline_heap_get_count(heap));
+
+    // cleanup
+    deadline_heap_destroy(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_002: [ If the allocation fails, deadline_heap_create shall fail and return NULL. ]
+TEST_FUNCTION(create_malloc_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    // act
+    DEADLINE_HEAP_HANDLE heap = deadline_heap_create();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_003: [ If `heap` is NULL, deadline_heap_destroy shall return. ]
+TEST_FUNCTION(destroy_NULL_heap)
+{
+    // arrange
+
+    // act
+    deadline_heap_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_004: [ deadline_heap_destroy shall free all entries still in the heap, the entries kept for reuse and the heap itself, but not the stored values. ]
+TEST_FUNCTION(destroy_success)
+{
+    // arrange
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    (void)add_entry(heap, 10, 0);
+    (void)add_entry(heap, 20, 1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+    // act
+    deadline_heap_destroy(heap);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_004: [ deadline_heap_destroy shall free all entries still in the heap, the entries kept for reuse and the heap itself, but not the stored values. ]
+TEST_FUNCTION(destroy_frees_the_entries_kept_for_reuse)
+{
+    // arrange
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    DEADLINE_HEAP_ENTRY_HANDLE entry = add_entry(heap, 10, 0);
+    (void)add_entry(heap, 20, 1);
+    deadline_heap_remove(heap, entry);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(entry));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+    // act
+    deadline_heap_destroy(heap);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_005: [ If `heap` or `value` is NULL, deadline_heap_add shall fail and return NULL. ]
+TEST_FUNCTION(add_NULL_heap)
+{
+    // arrange
+
+    // act
+    DEADLINE_HEAP_ENTRY_HANDLE result = deadline_heap_add(NULL, 10, &TEST_VALUES[0]);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_005: [ If `heap` or `value` is NULL, deadline_heap_add shall fail and return NULL. ]
+TEST_FUNCTION(add_NULL_value)
+{
+    // arrange
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    umock_c_reset_all_calls();
+
+    // act
+    DEADLINE_HEAP_ENTRY_HANDLE result = deadline_heap_add(heap, 10, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, 0, deadline_heap_get_count(heap));
+
+    // cleanup
+    deadline_heap_destroy(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_006: [ If the heap is full, deadline_heap_add shall double its capacity. ]
+// Tests_SRS_DEADLINE_HEAP_11_008: [ On success deadline_heap_add shall insert `value` ordered by `deadline` and return a handle to the new entry. ]
+TEST_FUNCTION(add_first_entry_success)
+{
+    // arrange
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(realloc(NULL, INITIAL_HEAP_CAPACITY * sizeof(void*)));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+
+    // act
+    DEADLINE_HEAP_ENTRY_HANDLE result = deadline_heap_add(heap, 10, &TEST_VALUES[0]);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, 1, deadline_heap_get_count(heap));
+
+    // cleanup
+    deadline_heap_destroy(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_006: [ If the heap is full, deadline_heap_add shall double its capacity. ]
+TEST_FUNCTION(add_grows_heap)
+{
+    // arrange
+    size_t i;
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    for (i = 0; i < INITIAL_HEAP_CAPACITY; i++)
+    {
+        (void)add_entry(heap, (tickcounter_ms_t)(100 - i), i);
+    }
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(realloc(IGNORED_PTR_ARG, 2 * INITIAL_HEAP_CAPACITY * sizeof(void*)));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+
+    // act
+    DEADLINE_HEAP_ENTRY_HANDLE result = deadline_heap_add(heap, 1, &TEST_VALUES[INITIAL_HEAP_CAPACITY]);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, INITIAL_HEAP_CAPACITY + 1, deadline_heap_get_count(heap));
+    ASSERT_ARE_EQUAL(void_ptr, &TEST_VALUES[INITIAL_HEAP_CAPACITY], deadline_heap_pop_expired(heap, 1));
+
+    // cleanup
+    deadline_heap_destroy(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_007: [ If any allocation fails, deadline_heap_add shall fail and return NULL. ]
+TEST_FUNCTION(add_realloc_fails)
+{
+    // arrange
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(realloc(NULL, IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    // act
+    DEADLINE_HEAP_ENTRY_HANDLE result = deadline_heap_add(heap, 10, &TEST_VALUES[0]);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, 0, deadline_heap_get_count(heap));
+
+    // cleanup
+    deadline_heap_destroy(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_007: [ If any allocation fails, deadline_heap_add shall fail and return NULL. ]
+TEST_FUNCTION(add_malloc_fails)
+{
+    // arrange
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    (void)add_entry(heap, 10, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    // act
+    DEADLINE_HEAP_ENTRY_HANDLE result = deadline_heap_add(heap, 5, &TEST_VALUES[1]);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, 1, deadline_heap_get_count(heap));
+    ASSERT_ARE_EQUAL(void_ptr, &TEST_VALUES[0], deadline_heap_pop_expired(heap, 10));
+
+    // cleanup
+    deadline_heap_destroy(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_017: [ deadline_heap_add shall reuse an entry released by deadline_heap_remove or deadline_heap_pop_expired if there is one, and only allocate a new entry otherwise. ]
+TEST_FUNCTION(add_reuses_a_released_entry)
+{
+    // arrange
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    DEADLINE_HEAP_ENTRY_HANDLE removed_entry = add_entry(heap, 10, 0);
+    DEADLINE_HEAP_ENTRY_HANDLE expired_entry = add_entry(heap, 20, 1);
+    deadline_heap_remove(heap, removed_entry);
+    (void)deadline_heap_pop_expired(heap, 20);
+    umock_c_reset_all_calls();
+
+    // act
+    DEADLINE_HEAP_ENTRY_HANDLE first_result = deadline_heap_add(heap, 30, &TEST_VALUES[2]);
+    DEADLINE_HEAP_ENTRY_HANDLE second_result = deadline_heap_add(heap, 40, &TEST_VALUES[3]);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, expired_entry, first_result);
+    ASSERT_ARE_EQUAL(void_ptr, removed_entry, second_result);
+    ASSERT_ARE_EQUAL(size_t, 2, deadline_heap_get_count(heap));
+    ASSERT_ARE_EQUAL(void_ptr, &TEST_VALUES[2], deadline_heap_pop_expired(heap, 40));
+    ASSERT_ARE_EQUAL(void_ptr, &TEST_VALUES[3], deadline_heap_pop_expired(heap, 40));
+
+    // cleanup
+    deadline_heap_destroy(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_009: [ If `heap` or `entry` is NULL, deadline_heap_remove shall return. ]
+TEST_FUNCTION(remove_NULL_heap)
+{
+    // arrange
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    DEADLINE_HEAP_ENTRY_HANDLE entry = add_entry(heap, 10, 0);
+    umock_c_reset_all_calls();
+
+    // act
+    deadline_heap_remove(NULL, entry);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, deadline_heap_get_count(heap));
+
+    // cleanup
+    deadline_heap_destroy(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_009: [ If `heap` or `entry` is NULL, deadline_heap_remove shall return. ]
+TEST_FUNCTION(remove_NULL_entry)
+{
+    // arrange
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    (void)add_entry(heap, 10, 0);
+    umock_c_reset_all_calls();
+
+    // act
+    deadline_heap_remove(heap, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, deadline_heap_get_count(heap));
+
+    // cleanup
+    deadline_heap_destroy(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_010: [ deadline_heap_remove shall remove `entry` from the heap and keep it for reuse by deadline_heap_add. ]
+TEST_FUNCTION(remove_success)
+{
+    // arrange
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    DEADLINE_HEAP_ENTRY_HANDLE entry = add_entry(heap, 10, 0);
+    (void)add_entry(heap, 20, 1);
+    umock_c_reset_all_calls();
+
+    // act
+    deadline_heap_remove(heap, entry);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, deadline_heap_get_count(heap));
+    ASSERT_ARE_EQUAL(void_ptr, entry, deadline_heap_add(heap, 30, &TEST_VALUES[2]));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(deadline_heap_pop_expired(heap, 19));
+    ASSERT_ARE_EQUAL(void_ptr, &TEST_VALUES[1], deadline_heap_pop_expired(heap, 20));
+    ASSERT_ARE_EQUAL(void_ptr, &TEST_VALUES[2], deadline_heap_pop_expired(heap, 30));
+
+    // cleanup
+    deadline_heap_destroy(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_010: [ deadline_heap_remove shall remove `entry` from the heap and keep it for reuse by deadline_heap_add. ]
+TEST_FUNCTION(remove_from_the_middle_keeps_deadline_order)
+{
+    // arrange
+    size_t i;
+    DEADLINE_HEAP_ENTRY_HANDLE entries[TEST_ENTRY_COUNT];
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    for (i = 0; i < TEST_ENTRY_COUNT; i++)
+    {
+        // Deadlines are added out of order: 0, 37, 74, 11, ...
+        entries[i] = add_entry(heap, (tickcounter_ms_t)((i * 37) % TEST_ENTRY_COUNT), i);
+    }
+
+    // act
+    for (i = 0; i < TEST_ENTRY_COUNT; i += 3)
+    {
+        deadline_heap_remove(heap, entries[i]);
+    }
+
+    // assert
+    tickcounter_ms_t previous_deadline = 0;
+    size_t popped_count = 0;
+    void* value;
+    while ((value = deadline_heap_pop_expired(heap, TEST_ENTRY_COUNT)) != NULL)
+    {
+        size_t index = (size_t)((int*)value - TEST_VALUES);
+        tickcounter_ms_t deadline = (tickcounter_ms_t)((index * 37) % TEST_ENTRY_COUNT);
+        ASSERT_ARE_NOT_EQUAL(size_t, 0, index % 3);
+        ASSERT_IS_TRUE(deadline >= previous_deadline);
+        previous_deadline = deadline;
+        popped_count++;
+    }
+    ASSERT_ARE_EQUAL(size_t, TEST_ENTRY_COUNT - ((TEST_ENTRY_COUNT + 2) / 3), popped_count);
+    ASSERT_ARE_EQUAL(size_t, 0, deadline_heap_get_count(heap));
+
+    // cleanup
+    deadline_heap_destroy(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_011: [ If `heap` is NULL or empty, deadline_heap_pop_expired shall return NULL. ]
+TEST_FUNCTION(pop_expired_NULL_heap)
+{
+    // arrange
+
+    // act
+    void* result = deadline_heap_pop_expired(NULL, 10);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_011: [ If `heap` is NULL or empty, deadline_heap_pop_expired shall return NULL. ]
+TEST_FUNCTION(pop_expired_empty_heap)
+{
+    // arrange
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    umock_c_reset_all_calls();
+
+    // act
+    void* result = deadline_heap_pop_expired(heap, 10);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+
+    // cleanup
+    deadline_heap_destroy(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_012: [ If the earliest deadline in the heap is later than `current_ms`, deadline_heap_pop_expired shall return NULL. ]
+TEST_FUNCTION(pop_expired_nothing_expired)
+{
+    // arrange
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    (void)add_entry(heap, 20, 0);
+    (void)add_entry(heap, 10, 1);
+    umock_c_reset_all_calls();
+
+    // act
+    void* result = deadline_heap_pop_expired(heap, 9);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, 2, deadline_heap_get_count(heap));
+
+    // cleanup
+    deadline_heap_destroy(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_013: [ Otherwise deadline_heap_pop_expired shall remove the entry with the earliest deadline, keep it for reuse by deadline_heap_add and return its value. ]
+TEST_FUNCTION(pop_expired_success)
+{
+    // arrange
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    (void)add_entry(heap, 20, 0);
+    DEADLINE_HEAP_ENTRY_HANDLE earliest_entry = add_entry(heap, 10, 1);
+    (void)add_entry(heap, 30, 2);
+    umock_c_reset_all_calls();
+
+    // act
+    void* result = deadline_heap_pop_expired(heap, 10);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, &TEST_VALUES[1], result);
+    ASSERT_ARE_EQUAL(size_t, 2, deadline_heap_get_count(heap));
+    ASSERT_IS_NULL(deadline_heap_pop_expired(heap, 10));
+    ASSERT_ARE_EQUAL(void_ptr, earliest_entry, deadline_heap_add(heap, 40, &TEST_VALUES[3]));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 3, deadline_heap_get_count(heap));
+
+    // cleanup
+    deadline_heap_destroy(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_013: [ Otherwise deadline_heap_pop_expired shall remove the entry with the earliest deadline, keep it for reuse by deadline_heap_add and return its value. ]
+TEST_FUNCTION(pop_expired_returns_entries_in_deadline_order)
+{
+    // arrange
+    size_t i;
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    for (i = 0; i < TEST_ENTRY_COUNT; i++)
+    {
+        (void)add_entry(heap, (tickcounter_ms_t)(TEST_ENTRY_COUNT - i), i);
+    }
+
+    // act
+    // assert
+    for (i = TEST_ENTRY_COUNT; i > 0; i--)
+    {
+        ASSERT_ARE_EQUAL(void_ptr, &TEST_VALUES[i - 1], deadline_heap_pop_expired(heap, TEST_ENTRY_COUNT));
+    }
+    ASSERT_IS_NULL(deadline_heap_pop_expired(heap, TEST_ENTRY_COUNT));
+
+    // cleanup
+    deadline_heap_destroy(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_015: [ If `heap` or `deadline` is NULL, or the heap is empty, deadline_heap_peek_deadline shall return false. ]
+TEST_FUNCTION(peek_deadline_NULL_heap)
+{
+    // arrange
+    tickcounter_ms_t deadline;
+
+    // act
+    bool result = deadline_heap_peek_deadline(NULL, &deadline);
+
+    // assert
+    ASSERT_IS_FALSE(result);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_015: [ If `heap` or `deadline` is NULL, or the heap is empty, deadline_heap_peek_deadline shall return false. ]
+TEST_FUNCTION(peek_deadline_NULL_deadline)
+{
+    // arrange
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    (void)add_entry(heap, 10, 0);
+    umock_c_reset_all_calls();
+
+    // act
+    bool result = deadline_heap_peek_deadline(heap, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_FALSE(result);
+
+    // cleanup
+    deadline_heap_destroy(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_015: [ If `heap` or `deadline` is NULL, or the heap is empty, deadline_heap_peek_deadline shall return false. ]
+TEST_FUNCTION(peek_deadline_empty_heap)
+{
+    // arrange
+    tickcounter_ms_t deadline;
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    umock_c_reset_all_calls();
+
+    // act
+    bool result = deadline_heap_peek_deadline(heap, &deadline);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_FALSE(result);
+
+    // cleanup
+    deadline_heap_destroy(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_016: [ Otherwise deadline_heap_peek_deadline shall store the earliest deadline of the heap in `deadline`, leave its entry in the heap and return true. ]
+TEST_FUNCTION(peek_deadline_success)
+{
+    // arrange
+    tickcounter_ms_t deadline = 0;
+    DEADLINE_HEAP_HANDLE heap = create_heap();
+    (void)add_entry(heap, 20, 0);
+    (void)add_entry(heap, 10, 1);
+    (void)add_entry(heap, 30, 2);
+    umock_c_reset_all_calls();
+
+    // act
+    bool result = deadline_heap_peek_deadline(heap, &deadline);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(uint64_t, 10, (uint64_t)deadline);
+    ASSERT_ARE_EQUAL(size_t, 3, deadline_heap_get_count(heap));
+
+    // cleanup
+    deadline_heap_destroy(heap);
+}
+
+// Tests_SRS_DEADLINE_HEAP_11_014: [ deadline_heap_get_count shall return the number of entries in the heap, or zero if `heap` is NULL. ]
+TEST_FUNCTION(get_count_NULL_heap)
+{
+    // arrange
+
+    // act
+    size_t result = deadline_heap_get_count(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+}
+
+END_TEST_SUITE(deadline_heap_ut)
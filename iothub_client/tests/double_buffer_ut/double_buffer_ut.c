@@ -0,0 +1,571 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void* real_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "double_buffer.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_INITIAL_CAPACITY               2
+
+typedef struct TEST_ELEMENT_TAG
+{
+    size_t id;
+    int value;
+} TEST_ELEMENT;
+
+static TEST_ELEMENT make_element(size_t id)
+{
+    TEST_ELEMENT result;
+    result.id = id;
+    result.value = (int)(id * 10);
+    return result;
+}
+
+
+// Helpers
+
+static DOUBLE_BUFFER_HANDLE create_double_buffer(void)
+{
+    DOUBLE_BUFFER_HANDLE result = double_buffer_create(sizeof(TEST_ELEMENT), TEST_INITIAL_CAPACITY);
+    ASSERT_IS_NOT_NULL_WITH_MSG(result, "Failed creating the double buffer");
+    return result;
+}
+
+static void push_elements(DOUBLE_BUFFER_HANDLE handle, size_t first_id, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        TEST_ELEMENT element = make_element(first_id + i);
+        ASSERT_ARE_EQUAL(int, 0, double_buffer_push(handle, &element));
+    }
+}
+
+
+BEGIN_TEST_SUITE(double_buffer_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(realloc, real_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(free, real_free);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_DOUBLE_BUFFER_11_001: [ If `elementSize` or `initialCapacity` is 0, or their product overflows, double_buffer_create shall fail and return NULL. ]
+TEST_FUNCTION(create_elementSize_0_fails)
+{
+    // arrange
+
+    // act
+    DOUBLE_BUFFER_HANDLE handle = double_buffer_create(0, TEST_INITIAL_CAPACITY);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(handle);
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_001: [ If `elementSize` or `initialCapacity` is 0, or their product overflows, double_buffer_create shall fail and return NULL. ]
+TEST_FUNCTION(create_initialCapacity_0_fails)
+{
+    // arrange
+
+    // act
+    DOUBLE_BUFFER_HANDLE handle = double_buffer_create(sizeof(TEST_ELEMENT), 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(handle);
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_001: [ If `elementSize` or `initialCapacity` is 0, or their product overflows, double_buffer_create shall fail and return NULL. ]
+TEST_FUNCTION(create_size_overflow_fails)
+{
+    // arrange
+
+    // act
+    DOUBLE_BUFFER_HANDLE handle = double_buffer_create(sizeof(TEST_ELEMENT), ((size_t)-1) / 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(handle);
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_002: [ double_buffer_create shall allocate the DOUBLE_BUFFER data structure and `initialCapacity` elements for each of its two sides. ]
+TEST_FUNCTION(create_success)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(malloc(sizeof(TEST_ELEMENT) * TEST_INITIAL_CAPACITY));
+    STRICT_EXPECTED_CALL(malloc(sizeof(TEST_ELEMENT) * TEST_INITIAL_CAPACITY));
+
+    // act
+    DOUBLE_BUFFER_HANDLE handle = double_buffer_create(sizeof(TEST_ELEMENT), TEST_INITIAL_CAPACITY);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(handle);
+    ASSERT_ARE_EQUAL(size_t, 0, double_buffer_get_count(handle));
+    ASSERT_ARE_EQUAL(size_t, 0, double_buffer_swap(handle));
+
+    // cleanup
+    double_buffer_destroy(handle);
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_003: [ If any allocation fails, double_buffer_create shall free what it allocated and return NULL. ]
+TEST_FUNCTION(create_fails_when_an_allocation_fails)
+{
+    // arrange
+    size_t i;
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    umock_c_negative_tests_snapshot();
+
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        char temp_str[64];
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        DOUBLE_BUFFER_HANDLE handle = double_buffer_create(sizeof(TEST_ELEMENT), TEST_INITIAL_CAPACITY);
+
+        // assert
+        (void)sprintf(temp_str, "On failed call %lu", (unsigned long)i);
+        ASSERT_IS_NULL_WITH_MSG(handle, temp_str);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_004: [ If `handle` is NULL, double_buffer_destroy shall return. ]
+TEST_FUNCTION(destroy_NULL_handle)
+{
+    // arrange
+
+    // act
+    double_buffer_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_005: [ double_buffer_destroy shall free both sides and the double buffer itself. ]
+TEST_FUNCTION(destroy_frees_both_sides)
+{
+    // arrange
+    DOUBLE_BUFFER_HANDLE handle = create_double_buffer();
+    push_elements(handle, 0, 1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+    // act
+    double_buffer_destroy(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_006: [ If `handle` or `element` is NULL, double_buffer_push shall fail and return a non-zero value. ]
+TEST_FUNCTION(push_NULL_handle_fails)
+{
+    // arrange
+    TEST_ELEMENT element = make_element(0);
+
+    // act
+    int result = double_buffer_push(NULL, &element);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_006: [ If `handle` or `element` is NULL, double_buffer_push shall fail and return a non-zero value. ]
+TEST_FUNCTION(push_NULL_element_fails)
+{
+    // arrange
+    DOUBLE_BUFFER_HANDLE handle = create_double_buffer();
+    umock_c_reset_all_calls();
+
+    // act
+    int result = double_buffer_push(handle, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, double_buffer_get_count(handle));
+
+    // cleanup
+    double_buffer_destroy(handle);
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_009: [ double_buffer_push shall copy `element` at the end of the write side and return 0. ]
+TEST_FUNCTION(push_within_capacity_does_not_allocate)
+{
+    // arrange
+    DOUBLE_BUFFER_HANDLE handle = create_double_buffer();
+    TEST_ELEMENT element = make_element(42);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = double_buffer_push(handle, &element);
+    element.value = 0;
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, double_buffer_get_count(handle));
+    ASSERT_ARE_EQUAL(size_t, 1, double_buffer_swap(handle));
+    ASSERT_ARE_EQUAL(size_t, 42, ((TEST_ELEMENT*)double_buffer_get_element(handle, 0))->id);
+    ASSERT_ARE_EQUAL(int, 420, ((TEST_ELEMENT*)double_buffer_get_element(handle, 0))->value);
+
+    // cleanup
+    double_buffer_destroy(handle);
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_007: [ If the write side is full, double_buffer_push shall double its capacity. ]
+// Tests_SRS_DOUBLE_BUFFER_11_009: [ double_buffer_push shall copy `element` at the end of the write side and return 0. ]
+TEST_FUNCTION(push_on_full_side_doubles_its_capacity)
+{
+    // arrange
+    size_t i;
+    DOUBLE_BUFFER_HANDLE handle = create_double_buffer();
+    TEST_ELEMENT element = make_element(TEST_INITIAL_CAPACITY);
+    push_elements(handle, 0, TEST_INITIAL_CAPACITY);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(realloc(IGNORED_PTR_ARG, sizeof(TEST_ELEMENT) * TEST_INITIAL_CAPACITY * 2));
+
+    // act
+    int result = double_buffer_push(handle, &element);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, TEST_INITIAL_CAPACITY + 1, double_buffer_swap(handle));
+    for (i = 0; i < TEST_INITIAL_CAPACITY + 1; i++)
+    {
+        ASSERT_ARE_EQUAL(size_t, i, ((TEST_ELEMENT*)double_buffer_get_element(handle, i))->id);
+    }
+
+    // cleanup
+    double_buffer_destroy(handle);
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_008: [ If growing the write side fails, double_buffer_push shall fail and return a non-zero value, leaving the elements already pushed untouched. ]
+TEST_FUNCTION(push_fails_when_realloc_fails)
+{
+    // arrange
+    size_t i;
+    DOUBLE_BUFFER_HANDLE handle = create_double_buffer();
+    TEST_ELEMENT element = make_element(TEST_INITIAL_CAPACITY);
+    push_elements(handle, 0, TEST_INITIAL_CAPACITY);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    int result = double_buffer_push(handle, &element);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, TEST_INITIAL_CAPACITY, double_buffer_swap(handle));
+    for (i = 0; i < TEST_INITIAL_CAPACITY; i++)
+    {
+        ASSERT_ARE_EQUAL(size_t, i, ((TEST_ELEMENT*)double_buffer_get_element(handle, i))->id);
+    }
+
+    // cleanup
+    double_buffer_destroy(handle);
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_010: [ If `handle` is NULL, double_buffer_get_count shall return 0. ]
+TEST_FUNCTION(get_count_NULL_handle_returns_0)
+{
+    // arrange
+
+    // act
+    size_t result = double_buffer_get_count(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_011: [ double_buffer_get_count shall return the number of elements in the write side. ]
+TEST_FUNCTION(get_count_ignores_the_read_side)
+{
+    // arrange
+    DOUBLE_BUFFER_HANDLE handle = create_double_buffer();
+    push_elements(handle, 0, 2);
+    (void)double_buffer_swap(handle);
+    push_elements(handle, 2, 1);
+    umock_c_reset_all_calls();
+
+    // act
+    size_t result = double_buffer_get_count(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    double_buffer_destroy(handle);
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_012: [ If `handle` is NULL, double_buffer_swap shall return 0. ]
+TEST_FUNCTION(swap_NULL_handle_returns_0)
+{
+    // arrange
+
+    // act
+    size_t result = double_buffer_swap(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_013: [ double_buffer_swap shall empty the read side, keeping its capacity, and make it the write side. ]
+// Tests_SRS_DOUBLE_BUFFER_11_014: [ double_buffer_swap shall make the write side the read side and return its number of elements. ]
+TEST_FUNCTION(swap_makes_the_pushed_elements_readable)
+{
+    // arrange
+    DOUBLE_BUFFER_HANDLE handle = create_double_buffer();
+    push_elements(handle, 0, 2);
+    umock_c_reset_all_calls();
+
+    // act
+    size_t result = double_buffer_swap(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, double_buffer_get_count(handle));
+    ASSERT_ARE_EQUAL(size_t, 0, ((TEST_ELEMENT*)double_buffer_get_element(handle, 0))->id);
+    ASSERT_ARE_EQUAL(size_t, 1, ((TEST_ELEMENT*)double_buffer_get_element(handle, 1))->id);
+
+    // cleanup
+    double_buffer_destroy(handle);
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_013: [ double_buffer_swap shall empty the read side, keeping its capacity, and make it the write side. ]
+TEST_FUNCTION(swap_recycles_both_sides_without_allocating)
+{
+    // arrange
+    size_t round;
+    DOUBLE_BUFFER_HANDLE handle = create_double_buffer();
+    push_elements(handle, 0, TEST_INITIAL_CAPACITY);
+    (void)double_buffer_swap(handle);
+    umock_c_reset_all_calls();
+
+    // act
+    for (round = 1; round <= 4; round++)
+    {
+        push_elements(handle, round * 100, TEST_INITIAL_CAPACITY);
+        ASSERT_ARE_EQUAL(size_t, TEST_INITIAL_CAPACITY, double_buffer_swap(handle));
+        ASSERT_ARE_EQUAL(size_t, round * 100, ((TEST_ELEMENT*)double_buffer_get_element(handle, 0))->id);
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    double_buffer_destroy(handle);
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_014: [ double_buffer_swap shall make the write side the read side and return its number of elements. ]
+TEST_FUNCTION(swap_with_nothing_pushed_returns_0)
+{
+    // arrange
+    DOUBLE_BUFFER_HANDLE handle = create_double_buffer();
+    push_elements(handle, 0, 1);
+    (void)double_buffer_swap(handle);
+    umock_c_reset_all_calls();
+
+    // act
+    size_t result = double_buffer_swap(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+    ASSERT_IS_NULL(double_buffer_get_element(handle, 0));
+
+    // cleanup
+    double_buffer_destroy(handle);
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_015: [ If `handle` is NULL, double_buffer_get_element shall return NULL. ]
+TEST_FUNCTION(get_element_NULL_handle_returns_NULL)
+{
+    // arrange
+
+    // act
+    void* result = double_buffer_get_element(NULL, 0);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_016: [ If `index` is not lower than the number of elements of the read side, double_buffer_get_element shall return NULL. ]
+TEST_FUNCTION(get_element_out_of_range_returns_NULL)
+{
+    // arrange
+    DOUBLE_BUFFER_HANDLE handle = create_double_buffer();
+    push_elements(handle, 0, 1);
+    (void)double_buffer_swap(handle);
+    umock_c_reset_all_calls();
+
+    // act
+    void* result = double_buffer_get_element(handle, 1);
+
+    // assert
+    ASSERT_IS_NULL(result);
+
+    // cleanup
+    double_buffer_destroy(handle);
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_016: [ If `index` is not lower than the number of elements of the read side, double_buffer_get_element shall return NULL. ]
+TEST_FUNCTION(get_element_does_not_read_the_write_side)
+{
+    // arrange
+    DOUBLE_BUFFER_HANDLE handle = create_double_buffer();
+    push_elements(handle, 0, 1);
+    umock_c_reset_all_calls();
+
+    // act
+    void* result = double_buffer_get_element(handle, 0);
+
+    // assert
+    ASSERT_IS_NULL(result);
+
+    // cleanup
+    double_buffer_destroy(handle);
+}
+
+// Tests_SRS_DOUBLE_BUFFER_11_017: [ double_buffer_get_element shall return a pointer to the element at `index` in the read side. ]
+TEST_FUNCTION(get_element_is_not_affected_by_new_pushes)
+{
+    // arrange
+    DOUBLE_BUFFER_HANDLE handle = create_double_buffer();
+    push_elements(handle, 0, 2);
+    (void)double_buffer_swap(handle);
+    push_elements(handle, 10, 3);
+    umock_c_reset_all_calls();
+
+    // act
+    TEST_ELEMENT* first = (TEST_ELEMENT*)double_buffer_get_element(handle, 0);
+    TEST_ELEMENT* second = (TEST_ELEMENT*)double_buffer_get_element(handle, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(first);
+    ASSERT_IS_NOT_NULL(second);
+    ASSERT_ARE_EQUAL(size_t, 0, first->id);
+    ASSERT_ARE_EQUAL(size_t, 1, second->id);
+    ASSERT_IS_NULL(double_buffer_get_element(handle, 2));
+
+    // cleanup
+    double_buffer_destroy(handle);
+}
+
+END_TEST_SUITE(double_buffer_ut)
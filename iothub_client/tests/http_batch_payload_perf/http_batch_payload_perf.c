@@ -0,0 +1,305 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures how long the HTTP transport takes to build the payload of a batch of 100 messages of 2 KB,
+// comparing the STRING concatenations it used to run (one base64 STRING per message, appended to the
+// payload and finally copied in a BUFFER) with measuring every item and writing them in one buffer.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/base64.h"
+#include "azure_c_shared_utility/map.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+#include "iothub_message.h"
+#include "http_batch_payload.h"
+
+#define BATCH_COUNT         1000
+#define MESSAGE_COUNT       100
+#define MESSAGE_SIZE        2048
+#define PROPERTY_COUNT      2
+
+static double get_batches_per_second(size_t batch_count, tickcounter_ms_t elapsed_ms)
+{
+    return (double)batch_count * 1000.0 / (double)(elapsed_ms == 0 ? 1 : elapsed_ms);
+}
+
+// Same item as make1EventJSONitem in iothubtransporthttp.c used to build for a byte array message.
+static STRING_HANDLE make_item_with_strings(IOTHUB_MESSAGE_HANDLE message)
+{
+    STRING_HANDLE result = STRING_construct("{\"body\":\"");
+    const unsigned char* source;
+    size_t size;
+
+    if (result != NULL && IoTHubMessage_GetByteArray(message, &source, &size) != IOTHUB_MESSAGE_OK)
+    {
+        STRING_delete(result);
+        result = NULL;
+    }
+    else if (result != NULL)
+    {
+        STRING_HANDLE encoded = Base64_Encode_Bytes(source, size);
+        const char* const* keys;
+        const char* const* values;
+        size_t count;
+
+        if (encoded == NULL ||
+            STRING_concat_with_STRING(result, encoded) != 0 ||
+            STRING_concat(result, "\"") != 0 ||
+            Map_GetInternals(IoTHubMessage_Properties(message), &keys, &values, &count) != MAP_OK)
+        {
+            STRING_delete(result);
+            result = NULL;
+        }
+        else
+        {
+            size_t index = 0;
+            if (count == 0 || STRING_concat(result, ",\"properties\":{") == 0)
+            {
+                for (index = 0; index < count; index++)
+                {
+                    if (STRING_concat(result, (index == 0) ? "\"iothub-app-" : ",\"iothub-app-") != 0 ||
+                        STRING_concat(result, keys[index]) != 0 ||
+                        STRING_concat(result, "\":\"") != 0 ||
+                        STRING_concat(result, values[index]) != 0 ||
+                        STRING_concat(result, "\"") != 0)
+                    {
+                        break;
+                    }
+                }
+            }
+
+            if (index < count ||
+                (count > 0 && STRING_concat(result, "}") != 0) ||
+                STRING_concat(result, "},") != 0)
+            {
+                STRING_delete(result);
+                result = NULL;
+            }
+        }
+        STRING_delete(encoded);
+    }
+
+    return result;
+}
+
+// Same payload as makePayload and IoTHubTransportHttp_DoWork used to send.
+static BUFFER_HANDLE make_payload_with_strings(IOTHUB_MESSAGE_HANDLE* messages, size_t message_count)
+{
+    BUFFER_HANDLE result = NULL;
+    STRING_HANDLE payload = STRING_construct("[");
+
+    if (payload != NULL)
+    {
+        size_t index;
+        for (index = 0; index < message_count; index++)
+        {
+            STRING_HANDLE item = make_item_with_strings(messages[index]);
+            int concat_result = (item == NULL) ? __LINE__ : STRING_concat_with_STRING(payload, item);
+            STRING_delete(item);
+            if (concat_result != 0)
+            {
+                break;
+            }
+        }
+
+        if (index == message_count)
+        {
+            ((char*)STRING_c_str(payload))[STRING_length(payload) - 1] = ']';
+            if ((result = BUFFER_new()) != NULL &&
+                BUFFER_build(result, (const unsigned char*)STRING_c_str(payload), STRING_length(payload)) != 0)
+            {
+                BUFFER_delete(result);
+                result = NULL;
+            }
+        }
+        STRING_delete(payload);
+    }
+
+    return result;
+}
+
+// Same payload as makePayload builds now.
+static BUFFER_HANDLE make_payload_in_place(IOTHUB_MESSAGE_HANDLE* messages, size_t message_count)
+{
+    BUFFER_HANDLE result = NULL;
+    size_t payload_size = 1;
+    size_t index;
+
+    for (index = 0; index < message_count; index++)
+    {
+        size_t item_size;
+        size_t message_size;
+        if (http_batch_payload_measure_item(messages[index], &item_size, &message_size) != 0)
+        {
+            break;
+        }
+        payload_size += item_size;
+    }
+
+    if (index == message_count && (result = BUFFER_new()) != NULL)
+    {
+        unsigned char* destination;
+        size_t position = 1;
+
+        if (BUFFER_pre_build(result, payload_size) != 0 || (destination = BUFFER_u_char(result)) == NULL)
+        {
+            index = 0;
+        }
+        else
+        {
+            destination[0] = '[';
+            for (index = 0; index < message_count; index++)
+            {
+                size_t item_size;
+                if (http_batch_payload_write_item(messages[index], destination + position, payload_size - position, &item_size) != 0)
+                {
+                    break;
+                }
+                position += item_size;
+            }
+            destination[payload_size - 1] = ']';
+        }
+
+        if (index < message_count || position != payload_size)
+        {
+            BUFFER_delete(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+static IOTHUB_MESSAGE_HANDLE create_message(size_t message_index)
+{
+    IOTHUB_MESSAGE_HANDLE result;
+    unsigned char content[MESSAGE_SIZE];
+    size_t index;
+
+    for (index = 0; index < MESSAGE_SIZE; index++)
+    {
+        content[index] = (unsigned char)(index * 31 + message_index);
+    }
+
+    if ((result = IoTHubMessage_CreateFromByteArray(content, MESSAGE_SIZE)) == NULL)
+    {
+        (void)printf("Failed creating the message\r\n");
+    }
+    else
+    {
+        MAP_HANDLE properties = IoTHubMessage_Properties(result);
+
+        for (index = 0; index < PROPERTY_COUNT; index++)
+        {
+            char key[32];
+            char value[32];
+            (void)sprintf(key, "property%lu", (unsigned long)index);
+            (void)sprintf(value, "value%lu", (unsigned long)(message_index + index));
+            if (Map_AddOrUpdate(properties, key, value) != MAP_OK)
+            {
+                (void)printf("Failed adding a message property\r\n");
+                IoTHubMessage_Destroy(result);
+                result = NULL;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+static int run_builder(TICK_COUNTER_HANDLE tick_counter, BUFFER_HANDLE(*make_payload)(IOTHUB_MESSAGE_HANDLE*, size_t), IOTHUB_MESSAGE_HANDLE* messages, double* batches_per_second, BUFFER_HANDLE* last_payload)
+{
+    int result = 0;
+    size_t index;
+    tickcounter_ms_t start_ms;
+    tickcounter_ms_t end_ms;
+
+    *last_payload = NULL;
+    (void)tickcounter_get_current_ms(tick_counter, &start_ms);
+    for (index = 0; index < BATCH_COUNT && result == 0; index++)
+    {
+        BUFFER_HANDLE payload = make_payload(messages, MESSAGE_COUNT);
+        if (payload == NULL)
+        {
+            result = __LINE__;
+        }
+        else if (index == BATCH_COUNT - 1)
+        {
+            *last_payload = payload;
+        }
+        else
+        {
+            BUFFER_delete(payload);
+        }
+    }
+    (void)tickcounter_get_current_ms(tick_counter, &end_ms);
+
+    *batches_per_second = get_batches_per_second(BATCH_COUNT, end_ms - start_ms);
+
+    return result;
+}
+
+int main(void)
+{
+    int result = 0;
+    TICK_COUNTER_HANDLE tick_counter;
+    IOTHUB_MESSAGE_HANDLE messages[MESSAGE_COUNT];
+    size_t created_count;
+
+    for (created_count = 0; created_count < MESSAGE_COUNT; created_count++)
+    {
+        if ((messages[created_count] = create_message(created_count)) == NULL)
+        {
+            break;
+        }
+    }
+
+    if (created_count < MESSAGE_COUNT)
+    {
+        result = __LINE__;
+    }
+    else if ((tick_counter = tickcounter_create()) == NULL)
+    {
+        (void)printf("Failed creating tick counter\r\n");
+        result = __LINE__;
+    }
+    else
+    {
+        double strings_batches_per_second;
+        double in_place_batches_per_second;
+        BUFFER_HANDLE strings_payload = NULL;
+        BUFFER_HANDLE in_place_payload = NULL;
+
+        if ((result = run_builder(tick_counter, make_payload_with_strings, messages, &strings_batches_per_second, &strings_payload)) == 0 &&
+            (result = run_builder(tick_counter, make_payload_in_place, messages, &in_place_batches_per_second, &in_place_payload)) == 0)
+        {
+            if (BUFFER_length(strings_payload) != BUFFER_length(in_place_payload) ||
+                memcmp(BUFFER_u_char(strings_payload), BUFFER_u_char(in_place_payload), BUFFER_length(in_place_payload)) != 0)
+            {
+                (void)printf("The payload written in place differs from the one built with STRINGs\r\n");
+                result = __LINE__;
+            }
+            else
+            {
+                (void)printf("%10s %14s %22s %22s\r\n", "messages", "payload bytes", "STRING batches/sec", "in place batches/sec");
+                (void)printf("%10lu %14lu %22.0f %22.0f\r\n", (unsigned long)MESSAGE_COUNT, (unsigned long)BUFFER_length(in_place_payload), strings_batches_per_second, in_place_batches_per_second);
+            }
+        }
+
+        BUFFER_delete(strings_payload);
+        BUFFER_delete(in_place_payload);
+        tickcounter_destroy(tick_counter);
+    }
+
+    while (created_count > 0)
+    {
+        IoTHubMessage_Destroy(messages[--created_count]);
+    }
+
+    return result;
+}
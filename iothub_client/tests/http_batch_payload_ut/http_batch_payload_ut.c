@@ -0,0 +1,626 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "iothub_message.h"
+#undef ENABLE_MOCKS
+
+#include "http_batch_payload.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_MESSAGE_HANDLE         (IOTHUB_MESSAGE_HANDLE)0x4441
+#define TEST_GUARD_BYTE             (unsigned char)0xA5
+
+static const char* TEST_STRING_CONTENT = "{\"temperature\":21.5}";
+static const char* TEST_STRING_ITEM = "{\"body\":\"{\\\"temperature\\\":21.5}\",\"base64Encoded\":false},";
+static const char* TEST_CONTROL_STRING_CONTENT = "a/b\\c\r\n";
+static const char* TEST_CONTROL_STRING_ITEM = "{\"body\":\"a\\/b\\\\c\\u000D\\u000A\",\"base64Encoded\":false},";
+static const char* TEST_NON_ASCII_STRING_CONTENT = "temp\xC3\xA9rature";
+
+static const unsigned char TEST_BYTE_ARRAY_CONTENT[] = { 'M', 'a', 'n', 0x00, 0xFF };
+static const char* TEST_BYTE_ARRAY_ITEMS[] = { "{\"body\":\"\"},", "{\"body\":\"TQ==\"},", "{\"body\":\"TWE=\"},", "{\"body\":\"TWFu\"},", "{\"body\":\"TWFuAA==\"},", "{\"body\":\"TWFuAP8=\"}," };
+
+static const char* TEST_PROPERTY_KEYS[] = { "propKey1", "prop\"Key2" };
+static const char* TEST_PROPERTY_VALUES[] = { "propValue1", "prop/Value2" };
+static const char* TEST_PROPERTIES_ITEM = "{\"body\":\"TWFu\",\"properties\":{\"iothub-app-propKey1\":\"propValue1\",\"iothub-app-prop\\\"Key2\":\"prop\\/Value2\"}},";
+
+static IOTHUBMESSAGE_CONTENT_TYPE g_content_type;
+static const unsigned char* g_byte_array;
+static size_t g_byte_array_size;
+static const char* g_string;
+static IOTHUB_MESSAGE_PROPERTY g_properties[2];
+static size_t g_property_count;
+
+
+// Mock hooks
+
+static IOTHUBMESSAGE_CONTENT_TYPE my_IoTHubMessage_GetContentType(IOTHUB_MESSAGE_HANDLE handle)
+{
+    (void)handle;
+    return g_content_type;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_GetByteArray(IOTHUB_MESSAGE_HANDLE handle, const unsigned char** buffer, size_t* size)
+{
+    (void)handle;
+    *buffer = g_byte_array;
+    *size = g_byte_array_size;
+    return IOTHUB_MESSAGE_OK;
+}
+
+static const char* my_IoTHubMessage_GetString(IOTHUB_MESSAGE_HANDLE handle)
+{
+    (void)handle;
+    return g_string;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_GetPropertyTable(IOTHUB_MESSAGE_HANDLE handle, const IOTHUB_MESSAGE_PROPERTY** properties, size_t* count)
+{
+    (void)handle;
+    *properties = (g_property_count == 0) ? NULL : g_properties;
+    *count = g_property_count;
+    return IOTHUB_MESSAGE_OK;
+}
+
+
+// Helpers
+
+static void set_byte_array_message(size_t size)
+{
+    g_content_type = IOTHUBMESSAGE_BYTEARRAY;
+    g_byte_array = TEST_BYTE_ARRAY_CONTENT;
+    g_byte_array_size = size;
+}
+
+static void set_string_message(const char* content)
+{
+    g_content_type = IOTHUBMESSAGE_STRING;
+    g_string = content;
+}
+
+static void set_properties(const char** keys, const char** values, size_t count)
+{
+    size_t index;
+    for (index = 0; index < count; index++)
+    {
+        g_properties[index].key = keys[index];
+        g_properties[index].keyLength = strlen(keys[index]);
+        g_properties[index].value = values[index];
+        g_properties[index].valueLength = strlen(values[index]);
+    }
+    g_property_count = count;
+}
+
+static void set_write_item_expected_calls()
+{
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE));
+    if (g_content_type == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    }
+    else
+    {
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_MESSAGE_HANDLE));
+    }
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPropertyTable(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+}
+
+// Writes the item in a buffer followed by guard bytes, and checks that nothing is written past capacity.
+static int write_item_with_guard(size_t capacity, char* item, size_t* item_size)
+{
+    unsigned char* destination = (unsigned char*)real_malloc(capacity + 16);
+    int result;
+
+    memset(destination, TEST_GUARD_BYTE, capacity + 16);
+    result = http_batch_payload_write_item(TEST_MESSAGE_HANDLE, destination, capacity, item_size);
+    for (size_t index = capacity; index < capacity + 16; index++)
+    {
+        ASSERT_ARE_EQUAL(int, (int)TEST_GUARD_BYTE, (int)destination[index]);
+    }
+    if (result == 0)
+    {
+        memcpy(item, destination, *item_size);
+        item[*item_size] = '\0';
+    }
+    real_free(destination);
+
+    return result;
+}
+
+
+BEGIN_TEST_SUITE(http_batch_payload_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(free, real_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetContentType, my_IoTHubMessage_GetContentType);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetContentType, IOTHUBMESSAGE_UNKNOWN);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetByteArray, my_IoTHubMessage_GetByteArray);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetByteArray, IOTHUB_MESSAGE_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetString, my_IoTHubMessage_GetString);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetString, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetPropertyTable, my_IoTHubMessage_GetPropertyTable);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetPropertyTable, IOTHUB_MESSAGE_ERROR);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    set_byte_array_message(3);
+    set_properties(NULL, NULL, 0);
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_001: [ If message, item_size or message_size is NULL, http_batch_payload_measure_item shall fail and return a non-zero value. ]
+TEST_FUNCTION(measure_item_NULL_message_fails)
+{
+    // arrange
+    size_t item_size;
+    size_t message_size;
+
+    // act
+    int result = http_batch_payload_measure_item(NULL, &item_size, &message_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_001: [ If message, item_size or message_size is NULL, http_batch_payload_measure_item shall fail and return a non-zero value. ]
+TEST_FUNCTION(measure_item_NULL_item_size_fails)
+{
+    // arrange
+    size_t message_size;
+
+    // act
+    int result = http_batch_payload_measure_item(TEST_MESSAGE_HANDLE, NULL, &message_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_001: [ If message, item_size or message_size is NULL, http_batch_payload_measure_item shall fail and return a non-zero value. ]
+TEST_FUNCTION(measure_item_NULL_message_size_fails)
+{
+    // arrange
+    size_t item_size;
+
+    // act
+    int result = http_batch_payload_measure_item(TEST_MESSAGE_HANDLE, &item_size, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_002: [ The body of a byte array message shall be {"body":"<base64 encoding of the payload>". ]
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_006: [ message_size shall be the size of the payload + 384, plus the length of the key + the length of the value + 16 for every property. ]
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_008: [ http_batch_payload_measure_item shall compute the exact size of the item without allocating or writing anything, and return 0. ]
+TEST_FUNCTION(measure_item_byte_array_succeeds)
+{
+    for (size_t size = 0; size <= sizeof(TEST_BYTE_ARRAY_CONTENT); size++)
+    {
+        // arrange
+        size_t item_size;
+        size_t message_size;
+        set_byte_array_message(size);
+        umock_c_reset_all_calls();
+        set_write_item_expected_calls();
+
+        // act
+        int result = http_batch_payload_measure_item(TEST_MESSAGE_HANDLE, &item_size, &message_size);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(size_t, strlen(TEST_BYTE_ARRAY_ITEMS[size]), item_size);
+        ASSERT_ARE_EQUAL(size_t, size + 384, message_size);
+    }
+}
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_003: [ The body of a string message shall be {"body":"<the string escaped for JSON>","base64Encoded":false, and a string with a character that is not US-ASCII shall fail. ]
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_008: [ http_batch_payload_measure_item shall compute the exact size of the item without allocating or writing anything, and return 0. ]
+TEST_FUNCTION(measure_item_string_succeeds)
+{
+    // arrange
+    size_t item_size;
+    size_t message_size;
+    set_string_message(TEST_CONTROL_STRING_CONTENT);
+    set_write_item_expected_calls();
+
+    // act
+    int result = http_batch_payload_measure_item(TEST_MESSAGE_HANDLE, &item_size, &message_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, strlen(TEST_CONTROL_STRING_ITEM), item_size);
+    ASSERT_ARE_EQUAL(size_t, strlen(TEST_CONTROL_STRING_CONTENT) + 384, message_size);
+}
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_003: [ The body of a string message shall be {"body":"<the string escaped for JSON>","base64Encoded":false, and a string with a character that is not US-ASCII shall fail. ]
+TEST_FUNCTION(measure_item_non_ascii_string_fails)
+{
+    // arrange
+    size_t item_size;
+    size_t message_size;
+    set_string_message(TEST_NON_ASCII_STRING_CONTENT);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_MESSAGE_HANDLE));
+
+    // act
+    int result = http_batch_payload_measure_item(TEST_MESSAGE_HANDLE, &item_size, &message_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_004: [ If the message has properties, they shall follow the body as ,"properties":{"iothub-app-<key>":"<value>",...}, their keys and values escaped for JSON, and be missing otherwise. ]
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_006: [ message_size shall be the size of the payload + 384, plus the length of the key + the length of the value + 16 for every property. ]
+TEST_FUNCTION(measure_item_with_properties_succeeds)
+{
+    // arrange
+    size_t item_size;
+    size_t message_size;
+    set_properties(TEST_PROPERTY_KEYS, TEST_PROPERTY_VALUES, 2);
+    set_write_item_expected_calls();
+
+    // act
+    int result = http_batch_payload_measure_item(TEST_MESSAGE_HANDLE, &item_size, &message_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, strlen(TEST_PROPERTIES_ITEM), item_size);
+    ASSERT_ARE_EQUAL(size_t, 3 + 384 + (8 + 10 + 16) + (9 + 11 + 16), message_size);
+}
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_007: [ If the message has an unknown content type or reading it fails, http_batch_payload_measure_item shall fail and return a non-zero value. ]
+TEST_FUNCTION(measure_item_unknown_content_type_fails)
+{
+    // arrange
+    size_t item_size;
+    size_t message_size;
+    g_content_type = IOTHUBMESSAGE_UNKNOWN;
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE));
+
+    // act
+    int result = http_batch_payload_measure_item(TEST_MESSAGE_HANDLE, &item_size, &message_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_007: [ If the message has an unknown content type or reading it fails, http_batch_payload_measure_item shall fail and return a non-zero value. ]
+TEST_FUNCTION(measure_item_byte_array_failure_checks)
+{
+    // arrange
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    set_properties(TEST_PROPERTY_KEYS, TEST_PROPERTY_VALUES, 2);
+    set_write_item_expected_calls();
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        // arrange
+        char error_msg[64];
+        size_t item_size;
+        size_t message_size;
+        sprintf(error_msg, "On failed call %zu", i);
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        int result = http_batch_payload_measure_item(TEST_MESSAGE_HANDLE, &item_size, &message_size);
+
+        // assert
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, result, error_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_007: [ If the message has an unknown content type or reading it fails, http_batch_payload_measure_item shall fail and return a non-zero value. ]
+TEST_FUNCTION(measure_item_string_failure_checks)
+{
+    // arrange
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    set_string_message(TEST_STRING_CONTENT);
+    set_write_item_expected_calls();
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        // arrange
+        char error_msg[64];
+        size_t item_size;
+        size_t message_size;
+        sprintf(error_msg, "On failed call %zu", i);
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        int result = http_batch_payload_measure_item(TEST_MESSAGE_HANDLE, &item_size, &message_size);
+
+        // assert
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, result, error_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_009: [ If message, destination or item_size is NULL, http_batch_payload_write_item shall fail and return a non-zero value. ]
+TEST_FUNCTION(write_item_NULL_message_fails)
+{
+    // arrange
+    unsigned char destination[64];
+    size_t item_size;
+
+    // act
+    int result = http_batch_payload_write_item(NULL, destination, sizeof(destination), &item_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_009: [ If message, destination or item_size is NULL, http_batch_payload_write_item shall fail and return a non-zero value. ]
+TEST_FUNCTION(write_item_NULL_destination_fails)
+{
+    // arrange
+    size_t item_size;
+
+    // act
+    int result = http_batch_payload_write_item(TEST_MESSAGE_HANDLE, NULL, 64, &item_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_009: [ If message, destination or item_size is NULL, http_batch_payload_write_item shall fail and return a non-zero value. ]
+TEST_FUNCTION(write_item_NULL_item_size_fails)
+{
+    // arrange
+    unsigned char destination[64];
+
+    // act
+    int result = http_batch_payload_write_item(TEST_MESSAGE_HANDLE, destination, sizeof(destination), NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_002: [ The body of a byte array message shall be {"body":"<base64 encoding of the payload>". ]
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_005: [ The item shall end with "}," so that items can follow each other, the last comma being replaced by the caller. ]
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_010: [ http_batch_payload_write_item shall write the item at destination, encoding the payload directly into it without allocating, return its size in item_size and return 0. ]
+TEST_FUNCTION(write_item_byte_array_succeeds)
+{
+    for (size_t size = 0; size <= sizeof(TEST_BYTE_ARRAY_CONTENT); size++)
+    {
+        // arrange
+        char item[64];
+        size_t item_size;
+        set_byte_array_message(size);
+        umock_c_reset_all_calls();
+        set_write_item_expected_calls();
+
+        // act
+        int result = write_item_with_guard(strlen(TEST_BYTE_ARRAY_ITEMS[size]), item, &item_size);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, TEST_BYTE_ARRAY_ITEMS[size], item);
+    }
+}
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_003: [ The body of a string message shall be {"body":"<the string escaped for JSON>","base64Encoded":false, and a string with a character that is not US-ASCII shall fail. ]
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_010: [ http_batch_payload_write_item shall write the item at destination, encoding the payload directly into it without allocating, return its size in item_size and return 0. ]
+TEST_FUNCTION(write_item_string_succeeds)
+{
+    // arrange
+    char item[128];
+    size_t item_size;
+    set_string_message(TEST_STRING_CONTENT);
+    set_write_item_expected_calls();
+
+    // act
+    int result = write_item_with_guard(strlen(TEST_STRING_ITEM), item, &item_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_STRING_ITEM, item);
+}
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_003: [ The body of a string message shall be {"body":"<the string escaped for JSON>","base64Encoded":false, and a string with a character that is not US-ASCII shall fail. ]
+TEST_FUNCTION(write_item_string_escapes_control_characters)
+{
+    // arrange
+    char item[128];
+    size_t item_size;
+    set_string_message(TEST_CONTROL_STRING_CONTENT);
+    set_write_item_expected_calls();
+
+    // act
+    int result = write_item_with_guard(strlen(TEST_CONTROL_STRING_ITEM), item, &item_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_CONTROL_STRING_ITEM, item);
+}
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_004: [ If the message has properties, they shall follow the body as ,"properties":{"iothub-app-<key>":"<value>",...}, their keys and values escaped for JSON, and be missing otherwise. ]
+TEST_FUNCTION(write_item_with_properties_succeeds)
+{
+    // arrange
+    char item[256];
+    size_t item_size;
+    set_properties(TEST_PROPERTY_KEYS, TEST_PROPERTY_VALUES, 2);
+    set_write_item_expected_calls();
+
+    // act
+    int result = write_item_with_guard(strlen(TEST_PROPERTIES_ITEM), item, &item_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PROPERTIES_ITEM, item);
+    ASSERT_ARE_EQUAL(size_t, strlen(TEST_PROPERTIES_ITEM), item_size);
+}
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_011: [ If the item does not fit in capacity bytes, http_batch_payload_write_item shall fail and return a non-zero value, without writing past capacity bytes. ]
+TEST_FUNCTION(write_item_capacity_too_small_fails)
+{
+    set_properties(TEST_PROPERTY_KEYS, TEST_PROPERTY_VALUES, 2);
+
+    for (size_t capacity = 0; capacity < strlen(TEST_PROPERTIES_ITEM); capacity++)
+    {
+        // arrange
+        char item[256];
+        size_t item_size;
+        umock_c_reset_all_calls();
+        set_write_item_expected_calls();
+
+        // act
+        int result = write_item_with_guard(capacity, item, &item_size);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    }
+}
+
+// Tests_SRS_HTTP_BATCH_PAYLOAD_11_007: [ If the message has an unknown content type or reading it fails, http_batch_payload_measure_item shall fail and return a non-zero value. ]
+TEST_FUNCTION(write_item_failure_checks)
+{
+    // arrange
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    set_properties(TEST_PROPERTY_KEYS, TEST_PROPERTY_VALUES, 2);
+    set_write_item_expected_calls();
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        // arrange
+        char item[256];
+        size_t item_size;
+        char error_msg[64];
+        sprintf(error_msg, "On failed call %zu", i);
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        int result = write_item_with_guard(sizeof(item) - 1, item, &item_size);
+
+        // assert
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, result, error_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+END_TEST_SUITE(http_batch_payload_ut)
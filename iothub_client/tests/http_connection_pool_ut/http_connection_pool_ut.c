@@ -0,0 +1,541 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/httpapiex.h"
+#include "azure_c_shared_utility/optionhandler.h"
+#undef ENABLE_MOCKS
+
+#include "http_connection_pool.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    extern const size_t http_connection_pool_thread_termination_offset;
+
+#ifdef __cplusplus
+}
+#endif
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_HOST_NAME                      "thisIsIotHubName.thisIsIotHubSuffix"
+#define TEST_OPTION_NAME                    "TrustedCerts"
+#define TEST_OPTION_VALUE                   "thisIsACertificate"
+#define TEST_LOCK_HANDLE                    (LOCK_HANDLE)0x4443
+#define TEST_COND_HANDLE                    (COND_HANDLE)0x4444
+#define TEST_THREAD_HANDLE                  (THREAD_HANDLE)0x4445
+#define TEST_OPTIONHANDLER_HANDLE           (OPTIONHANDLER_HANDLE)0x4446
+#define TEST_CALLER_CONNECTION              (HTTPAPIEX_HANDLE)0x4447
+#define TEST_FIRST_CONNECTION               0x5000
+#define MAX_TEST_THREADS                    4
+#define MAX_TEST_ITEMS                      8
+
+static THREAD_START_FUNC g_thread_funcs[MAX_TEST_THREADS];
+static void* g_thread_args[MAX_TEST_THREADS];
+static size_t g_thread_count;
+static size_t g_connection_count;
+
+static HTTP_CONNECTION_POOL_HANDLE g_stopped_pool;
+static size_t g_wait_count;
+
+static size_t g_done_items[MAX_TEST_ITEMS];
+static HTTPAPIEX_HANDLE g_done_connections[MAX_TEST_ITEMS];
+static size_t g_done_count;
+static size_t g_thread_to_run_on_first_item;
+
+
+// Mock hooks
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    ASSERT_IS_TRUE(g_thread_count < MAX_TEST_THREADS);
+    g_thread_funcs[g_thread_count] = func;
+    g_thread_args[g_thread_count] = arg;
+    g_thread_count++;
+    *threadHandle = TEST_THREAD_HANDLE;
+    return THREADAPI_OK;
+}
+
+static HTTPAPIEX_HANDLE my_HTTPAPIEX_Create(const char* hostName)
+{
+    (void)hostName;
+    return (HTTPAPIEX_HANDLE)(TEST_FIRST_CONNECTION + g_connection_count++);
+}
+
+static COND_RESULT my_Condition_Wait(COND_HANDLE handle, LOCK_HANDLE lock, int timeout_milliseconds)
+{
+    (void)handle;
+    (void)lock;
+    (void)timeout_milliseconds;
+    g_wait_count++;
+    *(bool*)(((char*)g_stopped_pool) + http_connection_pool_thread_termination_offset) = true; /*tell the thread to stop*/
+    return COND_OK;
+}
+
+
+// Helpers
+
+static void test_work(void* context, size_t item, HTTPAPIEX_HANDLE connection)
+{
+    ASSERT_IS_TRUE(g_done_count < MAX_TEST_ITEMS);
+    g_done_items[g_done_count] = item;
+    g_done_connections[g_done_count] = connection;
+    g_done_count++;
+
+    /*the worker thread wakes up while the calling thread does its first item*/
+    if (g_done_count == 1 && g_thread_to_run_on_first_item < g_thread_count)
+    {
+        (void)g_thread_funcs[g_thread_to_run_on_first_item](g_thread_args[g_thread_to_run_on_first_item]);
+    }
+
+    (void)context;
+}
+
+static HTTP_CONNECTION_POOL_HANDLE create_pool(size_t connectionCount)
+{
+    HTTP_CONNECTION_POOL_HANDLE result = http_connection_pool_create(TEST_HOST_NAME, connectionCount, NULL);
+    ASSERT_IS_NOT_NULL_WITH_MSG(result, "Failed creating the pool");
+    g_stopped_pool = result;
+    return result;
+}
+
+static void set_expected_calls_for_create(size_t connectionCount, bool hasOptions)
+{
+    size_t index;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    for (index = 0; index < connectionCount; index++)
+    {
+        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOST_NAME));
+        if (hasOptions)
+        {
+            STRICT_EXPECTED_CALL(OptionHandler_FeedOptions(TEST_OPTIONHANDLER_HANDLE, IGNORED_PTR_ARG));
+        }
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    }
+}
+
+
+BEGIN_TEST_SUITE(http_connection_pool_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_RESULT, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(free, real_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Init, TEST_COND_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Wait, my_Condition_Wait);
+
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Join, THREADAPI_OK);
+
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_Create, my_HTTPAPIEX_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_Create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(HTTPAPIEX_SetOption, HTTPAPIEX_OK);
+
+    REGISTER_GLOBAL_MOCK_RETURN(OptionHandler_FeedOptions, OPTIONHANDLER_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(OptionHandler_FeedOptions, OPTIONHANDLER_ERROR);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    g_thread_count = 0;
+    g_connection_count = 0;
+    g_stopped_pool = NULL;
+    g_wait_count = 0;
+    g_done_count = 0;
+    g_thread_to_run_on_first_item = MAX_TEST_THREADS;
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_HTTP_CONNECTION_POOL_11_001: [ If hostName is NULL or connectionCount is 0, http_connection_pool_create shall fail and return NULL. ]
+TEST_FUNCTION(http_connection_pool_create_NULL_hostName_fails)
+{
+    // arrange
+
+    // act
+    HTTP_CONNECTION_POOL_HANDLE pool = http_connection_pool_create(NULL, 1, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(pool);
+}
+
+// Tests_SRS_HTTP_CONNECTION_POOL_11_001: [ If hostName is NULL or connectionCount is 0, http_connection_pool_create shall fail and return NULL. ]
+TEST_FUNCTION(http_connection_pool_create_zero_connections_fails)
+{
+    // arrange
+
+    // act
+    HTTP_CONNECTION_POOL_HANDLE pool = http_connection_pool_create(TEST_HOST_NAME, 0, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(pool);
+}
+
+// Tests_SRS_HTTP_CONNECTION_POOL_11_002: [ http_connection_pool_create shall allocate memory for the pool. ]
+// Tests_SRS_HTTP_CONNECTION_POOL_11_003: [ http_connection_pool_create shall create the pool lock and the work and done conditions by calling Lock_Init and Condition_Init. ]
+// Tests_SRS_HTTP_CONNECTION_POOL_11_004: [ http_connection_pool_create shall create connectionCount connections by calling HTTPAPIEX_Create with hostName. ]
+// Tests_SRS_HTTP_CONNECTION_POOL_11_005: [ If options is not NULL, http_connection_pool_create shall give them to every connection by calling OptionHandler_FeedOptions. ]
+// Tests_SRS_HTTP_CONNECTION_POOL_11_006: [ http_connection_pool_create shall start a worker thread for every connection by calling ThreadAPI_Create. ]
+TEST_FUNCTION(http_connection_pool_create_success)
+{
+    // arrange
+    set_expected_calls_for_create(2, true);
+
+    // act
+    HTTP_CONNECTION_POOL_HANDLE pool = http_connection_pool_create(TEST_HOST_NAME, 2, TEST_OPTIONHANDLER_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(pool);
+    ASSERT_ARE_EQUAL(size_t, 2, g_thread_count);
+
+    // cleanup
+    http_connection_pool_destroy(pool);
+}
+
+// Tests_SRS_HTTP_CONNECTION_POOL_11_007: [ If any of the above fails, http_connection_pool_create shall stop the threads it started, destroy the connections it created, free all resources and return NULL. ]
+TEST_FUNCTION(http_connection_pool_create_fails)
+{
+    // arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    set_expected_calls_for_create(2, true);
+    umock_c_negative_tests_snapshot();
+
+    // act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+        g_thread_count = 0;
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "http_connection_pool_create failure in test %lu/%lu", (unsigned long)index, (unsigned long)count);
+
+        HTTP_CONNECTION_POOL_HANDLE pool = http_connection_pool_create(TEST_HOST_NAME, 2, TEST_OPTIONHANDLER_HANDLE);
+
+        // assert
+        ASSERT_IS_NULL_WITH_MSG(pool, tmp_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+// Tests_SRS_HTTP_CONNECTION_POOL_11_008: [ If pool is NULL, http_connection_pool_destroy shall do nothing. ]
+TEST_FUNCTION(http_connection_pool_destroy_NULL_pool)
+{
+    // arrange
+
+    // act
+    http_connection_pool_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_HTTP_CONNECTION_POOL_11_009: [ http_connection_pool_destroy shall stop and join the worker threads, destroy the connections and free all resources. ]
+TEST_FUNCTION(http_connection_pool_destroy_success)
+{
+    // arrange
+    HTTP_CONNECTION_POOL_HANDLE pool = create_pool(2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy((HTTPAPIEX_HANDLE)TEST_FIRST_CONNECTION));
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy((HTTPAPIEX_HANDLE)(TEST_FIRST_CONNECTION + 1)));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+    // act
+    http_connection_pool_destroy(pool);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_HTTP_CONNECTION_POOL_11_010: [ If pool or optionName is NULL, http_connection_pool_set_option shall fail and return a non-zero value. ]
+TEST_FUNCTION(http_connection_pool_set_option_NULL_arguments_fail)
+{
+    // arrange
+    HTTP_CONNECTION_POOL_HANDLE pool = create_pool(1);
+    umock_c_reset_all_calls();
+
+    // act
+    int result1 = http_connection_pool_set_option(NULL, TEST_OPTION_NAME, TEST_OPTION_VALUE);
+    int result2 = http_connection_pool_set_option(pool, NULL, TEST_OPTION_VALUE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+
+    // cleanup
+    http_connection_pool_destroy(pool);
+}
+
+// Tests_SRS_HTTP_CONNECTION_POOL_11_011: [ http_connection_pool_set_option shall set the option on every connection by calling HTTPAPIEX_SetOption, and fail if any of them fails. ]
+TEST_FUNCTION(http_connection_pool_set_option_sets_every_connection)
+{
+    // arrange
+    HTTP_CONNECTION_POOL_HANDLE pool = create_pool(2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SetOption((HTTPAPIEX_HANDLE)TEST_FIRST_CONNECTION, TEST_OPTION_NAME, TEST_OPTION_VALUE));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SetOption((HTTPAPIEX_HANDLE)(TEST_FIRST_CONNECTION + 1), TEST_OPTION_NAME, TEST_OPTION_VALUE));
+
+    // act
+    int result = http_connection_pool_set_option(pool, TEST_OPTION_NAME, TEST_OPTION_VALUE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    http_connection_pool_destroy(pool);
+}
+
+// Tests_SRS_HTTP_CONNECTION_POOL_11_011: [ http_connection_pool_set_option shall set the option on every connection by calling HTTPAPIEX_SetOption, and fail if any of them fails. ]
+TEST_FUNCTION(http_connection_pool_set_option_fails_when_a_connection_fails)
+{
+    // arrange
+    HTTP_CONNECTION_POOL_HANDLE pool = create_pool(2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SetOption((HTTPAPIEX_HANDLE)TEST_FIRST_CONNECTION, TEST_OPTION_NAME, TEST_OPTION_VALUE))
+        .SetReturn(HTTPAPIEX_ERROR);
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SetOption((HTTPAPIEX_HANDLE)(TEST_FIRST_CONNECTION + 1), TEST_OPTION_NAME, TEST_OPTION_VALUE));
+
+    // act
+    int result = http_connection_pool_set_option(pool, TEST_OPTION_NAME, TEST_OPTION_VALUE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    http_connection_pool_destroy(pool);
+}
+
+// Tests_SRS_HTTP_CONNECTION_POOL_11_014: [ If pool, callerConnection or work is NULL, http_connection_pool_run shall fail and return a non-zero value. ]
+TEST_FUNCTION(http_connection_pool_run_NULL_arguments_fail)
+{
+    // arrange
+    HTTP_CONNECTION_POOL_HANDLE pool = create_pool(1);
+    umock_c_reset_all_calls();
+
+    // act
+    int result1 = http_connection_pool_run(NULL, TEST_CALLER_CONNECTION, 2, 0, test_work, NULL);
+    int result2 = http_connection_pool_run(pool, NULL, 2, 0, test_work, NULL);
+    int result3 = http_connection_pool_run(pool, TEST_CALLER_CONNECTION, 2, 0, NULL, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result3);
+    ASSERT_ARE_EQUAL(size_t, 0, g_done_count);
+
+    // cleanup
+    http_connection_pool_destroy(pool);
+}
+
+// Tests_SRS_HTTP_CONNECTION_POOL_11_016: [ http_connection_pool_run shall return 0 once every item is done. ]
+TEST_FUNCTION(http_connection_pool_run_without_items_succeeds)
+{
+    // arrange
+    HTTP_CONNECTION_POOL_HANDLE pool = create_pool(1);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = http_connection_pool_run(pool, TEST_CALLER_CONNECTION, 0, 0, test_work, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 0, g_done_count);
+
+    // cleanup
+    http_connection_pool_destroy(pool);
+}
+
+// Tests_SRS_HTTP_CONNECTION_POOL_11_012: [ The items shall be handed out in the order firstItem, firstItem + 1, ... modulo itemCount, each one to the first thread that is free. ]
+// Tests_SRS_HTTP_CONNECTION_POOL_11_013: [ Each item shall be done by calling work with context, the item and the connection of the thread doing it. ]
+// Tests_SRS_HTTP_CONNECTION_POOL_11_015: [ The calling thread shall do items too, with callerConnection. ]
+// Tests_SRS_HTTP_CONNECTION_POOL_11_016: [ http_connection_pool_run shall return 0 once every item is done. ]
+TEST_FUNCTION(http_connection_pool_run_caller_does_the_items_no_worker_thread_took)
+{
+    // arrange
+    HTTP_CONNECTION_POOL_HANDLE pool = create_pool(2);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = http_connection_pool_run(pool, TEST_CALLER_CONNECTION, 3, 2, test_work, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 3, g_done_count);
+    ASSERT_ARE_EQUAL(size_t, 2, g_done_items[0]);
+    ASSERT_ARE_EQUAL(size_t, 0, g_done_items[1]);
+    ASSERT_ARE_EQUAL(size_t, 1, g_done_items[2]);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CALLER_CONNECTION, g_done_connections[0]);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CALLER_CONNECTION, g_done_connections[1]);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CALLER_CONNECTION, g_done_connections[2]);
+
+    // cleanup
+    http_connection_pool_destroy(pool);
+}
+
+// Tests_SRS_HTTP_CONNECTION_POOL_11_012: [ The items shall be handed out in the order firstItem, firstItem + 1, ... modulo itemCount, each one to the first thread that is free. ]
+// Tests_SRS_HTTP_CONNECTION_POOL_11_013: [ Each item shall be done by calling work with context, the item and the connection of the thread doing it. ]
+TEST_FUNCTION(worker_thread_does_the_items_left_with_its_own_connection)
+{
+    // arrange
+    HTTP_CONNECTION_POOL_HANDLE pool = create_pool(2);
+    g_thread_to_run_on_first_item = 1;
+    umock_c_reset_all_calls();
+
+    // act
+    int result = http_connection_pool_run(pool, TEST_CALLER_CONNECTION, 4, 1, test_work, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 4, g_done_count);
+    ASSERT_ARE_EQUAL(size_t, 1, g_done_items[0]);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CALLER_CONNECTION, g_done_connections[0]);
+    ASSERT_ARE_EQUAL(size_t, 2, g_done_items[1]);
+    ASSERT_ARE_EQUAL(void_ptr, (HTTPAPIEX_HANDLE)(TEST_FIRST_CONNECTION + 1), g_done_connections[1]);
+    ASSERT_ARE_EQUAL(size_t, 3, g_done_items[2]);
+    ASSERT_ARE_EQUAL(void_ptr, (HTTPAPIEX_HANDLE)(TEST_FIRST_CONNECTION + 1), g_done_connections[2]);
+    ASSERT_ARE_EQUAL(size_t, 0, g_done_items[3]);
+    ASSERT_ARE_EQUAL(void_ptr, (HTTPAPIEX_HANDLE)(TEST_FIRST_CONNECTION + 1), g_done_connections[3]);
+    ASSERT_ARE_EQUAL(size_t, 1, g_wait_count);
+
+    // cleanup
+    http_connection_pool_destroy(pool);
+}
+
+END_TEST_SUITE(http_connection_pool_ut)
@@ -0,0 +1,986 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <csignal>
+#include <climits>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <signal.h>
+#include <limits.h>
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_pool.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    void real_DList_InitializeListHead(PDLIST_ENTRY listHead);
+    int real_DList_IsListEmpty(const PDLIST_ENTRY listHead);
+    void real_DList_InsertTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_InsertHeadList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_AppendTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY ListToAppend);
+    int real_DList_RemoveEntryList(PDLIST_ENTRY listEntry);
+    PDLIST_ENTRY real_DList_RemoveHeadList(PDLIST_ENTRY listHead);
+
+    extern const size_t IoTHubClientPool_ThreadTerminationOffset;
+
+#ifdef __cplusplus
+}
+#endif
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_LOCK_HANDLE                    (LOCK_HANDLE)0x4443
+#define TEST_COND_HANDLE                    (COND_HANDLE)0x4444
+#define TEST_THREAD_HANDLE                  (THREAD_HANDLE)0x4445
+#define MAX_TEST_THREADS                    4
+#define MAX_CALL_LOG_LENGTH                 64
+
+typedef struct TEST_CLIENT_TAG
+{
+    char name;
+    bool hasCallbacks;
+    unsigned int maxWaitMs;                         /*what doWork lowers the wait of the I/O thread to*/
+    size_t stopAfterDoWorkCount;                    /*0 to let the waits of the thread stop it*/
+    bool removeOnDoWork;
+    bool removeOnDispatch;
+    bool removeFromDispatch;                        /*removes with IoTHubClientPool_RemoveClientFromDispatch*/
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient;
+    size_t doWorkCount;
+    size_t dispatchCount;
+} TEST_CLIENT;
+
+static THREAD_START_FUNC g_thread_funcs[MAX_TEST_THREADS];
+static void* g_thread_args[MAX_TEST_THREADS];
+static size_t g_thread_count;
+
+static IOTHUB_CLIENT_POOL_HANDLE g_stopped_pool;
+static size_t g_waits_before_stop;
+static size_t g_wait_count;
+static int g_last_wait_ms;
+
+static char g_call_log[MAX_CALL_LOG_LENGTH];
+static size_t g_call_log_length;
+
+
+// Mock hooks
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    ASSERT_IS_TRUE(g_thread_count < MAX_TEST_THREADS);
+    g_thread_funcs[g_thread_count] = func;
+    g_thread_args[g_thread_count] = arg;
+    g_thread_count++;
+    *threadHandle = TEST_THREAD_HANDLE;
+    return THREADAPI_OK;
+}
+
+static void stop_threads_of_test_pool(void)
+{
+    *(sig_atomic_t*)(((char*)g_stopped_pool) + IoTHubClientPool_ThreadTerminationOffset) = 1; /*tell the threads to stop*/
+}
+
+static COND_RESULT my_Condition_Wait(COND_HANDLE handle, LOCK_HANDLE lock, int timeout_milliseconds)
+{
+    (void)handle;
+    (void)lock;
+    g_last_wait_ms = timeout_milliseconds;
+    g_wait_count++;
+    if (g_wait_count >= g_waits_before_stop)
+    {
+        stop_threads_of_test_pool();
+    }
+    return COND_TIMEOUT;
+}
+
+static void append_to_call_log(char operation, char name)
+{
+    ASSERT_IS_TRUE(g_call_log_length + 2 < MAX_CALL_LOG_LENGTH);
+    g_call_log[g_call_log_length++] = operation;
+    g_call_log[g_call_log_length++] = name;
+    g_call_log[g_call_log_length] = '\0';
+}
+
+static bool test_do_work(void* client, unsigned int* maxWaitMs)
+{
+    TEST_CLIENT* testClient = (TEST_CLIENT*)client;
+    testClient->doWorkCount++;
+    append_to_call_log('w', testClient->name);
+    if (testClient->maxWaitMs < *maxWaitMs)
+    {
+        *maxWaitMs = testClient->maxWaitMs;
+    }
+    if (testClient->doWorkCount == testClient->stopAfterDoWorkCount)
+    {
+        stop_threads_of_test_pool();
+    }
+    if (testClient->removeOnDoWork)
+    {
+        IoTHubClientPool_RemoveClient(testClient->poolClient);
+        append_to_call_log('r', testClient->name);
+    }
+    return testClient->hasCallbacks;
+}
+
+static void test_dispatch(void* client)
+{
+    TEST_CLIENT* testClient = (TEST_CLIENT*)client;
+    testClient->dispatchCount++;
+    append_to_call_log('d', testClient->name);
+    if (testClient->removeOnDispatch)
+    {
+        IoTHubClientPool_RemoveClient(testClient->poolClient);
+        append_to_call_log('r', testClient->name);
+    }
+    if (testClient->removeFromDispatch)
+    {
+        IoTHubClientPool_RemoveClientFromDispatch(testClient->poolClient);
+        append_to_call_log('r', testClient->name);
+    }
+}
+
+
+// Helpers
+
+static void init_test_client(TEST_CLIENT* testClient, char name, bool hasCallbacks)
+{
+    testClient->name = name;
+    testClient->hasCallbacks = hasCallbacks;
+    testClient->maxWaitMs = UINT_MAX;
+    testClient->stopAfterDoWorkCount = 0;
+    testClient->removeOnDoWork = false;
+    testClient->removeOnDispatch = false;
+    testClient->removeFromDispatch = false;
+    testClient->poolClient = NULL;
+    testClient->doWorkCount = 0;
+    testClient->dispatchCount = 0;
+}
+
+static IOTHUB_CLIENT_POOL_HANDLE create_pool(size_t ioThreadCount, size_t callbackThreadCount)
+{
+    IOTHUB_CLIENT_POOL_HANDLE result = IoTHubClientPool_Create(ioThreadCount, callbackThreadCount);
+    ASSERT_IS_NOT_NULL_WITH_MSG(result, "Failed creating the pool");
+    g_stopped_pool = result;
+    return result;
+}
+
+static IOTHUB_CLIENT_POOL_CLIENT_HANDLE add_client(IOTHUB_CLIENT_POOL_HANDLE pool, TEST_CLIENT* testClient)
+{
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE result = IoTHubClientPool_AddClient(pool, testClient, test_do_work, test_dispatch);
+    ASSERT_IS_NOT_NULL_WITH_MSG(result, "Failed adding a client to the pool");
+    return result;
+}
+
+/*runs one of the threads of the pool on the calling thread until it waited waitCount times*/
+static void run_thread(size_t threadIndex, size_t waitCount)
+{
+    *(sig_atomic_t*)(((char*)g_stopped_pool) + IoTHubClientPool_ThreadTerminationOffset) = 0;
+    g_wait_count = 0;
+    g_waits_before_stop = waitCount;
+    (void)g_thread_funcs[threadIndex](g_thread_args[threadIndex]);
+}
+
+static void set_expected_calls_for_create(size_t ioThreadCount, size_t callbackThreadCount)
+{
+    size_t index;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    for (index = 0; index < ioThreadCount; index++)
+    {
+        STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+    }
+    if (callbackThreadCount > 0)
+    {
+        STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    }
+    for (index = 0; index < ioThreadCount; index++)
+    {
+        STRICT_EXPECTED_CALL(Condition_Init());
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    }
+    for (index = 0; index < callbackThreadCount; index++)
+    {
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    }
+}
+
+
+BEGIN_TEST_SUITE(iothub_client_pool_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(free, real_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Unlock, LOCK_ERROR);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Init, TEST_COND_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Post, COND_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Wait, my_Condition_Wait);
+
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Join, THREADAPI_OK);
+
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, real_DList_InitializeListHead);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_IsListEmpty, real_DList_IsListEmpty);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertTailList, real_DList_InsertTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertHeadList, real_DList_InsertHeadList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_AppendTailList, real_DList_AppendTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, real_DList_RemoveEntryList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    g_thread_count = 0;
+    g_stopped_pool = NULL;
+    g_waits_before_stop = 1;
+    g_wait_count = 0;
+    g_last_wait_ms = -1;
+    g_call_log[0] = '\0';
+    g_call_log_length = 0;
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_001: [ If ioThreadCount is 0, IoTHubClientPool_Create shall fail and return NULL. ]
+TEST_FUNCTION(IoTHubClientPool_Create_zero_io_threads_fails)
+{
+    // arrange
+
+    // act
+    IOTHUB_CLIENT_POOL_HANDLE pool = IoTHubClientPool_Create(0, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_002: [ IoTHubClientPool_Create shall allocate memory for the pool. ]
+// Tests_SRS_IOTHUBCLIENT_POOL_11_003: [ IoTHubClientPool_Create shall create the pool lock by calling Lock_Init. ]
+// Tests_SRS_IOTHUBCLIENT_POOL_11_004: [ IoTHubClientPool_Create shall create the dispatch and release conditions by calling Condition_Init. ]
+// Tests_SRS_IOTHUBCLIENT_POOL_11_005: [ IoTHubClientPool_Create shall allocate the I/O thread and callback thread tables. ]
+// Tests_SRS_IOTHUBCLIENT_POOL_11_006: [ IoTHubClientPool_Create shall create a condition for each I/O thread by calling Condition_Init. ]
+// Tests_SRS_IOTHUBCLIENT_POOL_11_007: [ IoTHubClientPool_Create shall start ioThreadCount I/O threads and callbackThreadCount callback threads by calling ThreadAPI_Create. ]
+TEST_FUNCTION(IoTHubClientPool_Create_success)
+{
+    // arrange
+    set_expected_calls_for_create(2, 1);
+
+    // act
+    IOTHUB_CLIENT_POOL_HANDLE pool = IoTHubClientPool_Create(2, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(pool);
+    ASSERT_ARE_EQUAL(size_t, 3, g_thread_count);
+
+    // cleanup
+    IoTHubClientPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_008: [ If any of the above fails, IoTHubClientPool_Create shall stop the threads it started, free all resources and return NULL. ]
+TEST_FUNCTION(IoTHubClientPool_Create_fails)
+{
+    // arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    set_expected_calls_for_create(1, 1);
+    umock_c_negative_tests_snapshot();
+
+    // DList_InitializeListHead cannot fail
+    size_t calls_cannot_fail[] = { 1, 6 };
+
+    // act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        size_t fail_index;
+        bool can_fail = true;
+
+        for (fail_index = 0; fail_index < sizeof(calls_cannot_fail) / sizeof(calls_cannot_fail[0]); fail_index++)
+        {
+            if (calls_cannot_fail[fail_index] == index)
+            {
+                can_fail = false;
+            }
+        }
+
+        if (can_fail)
+        {
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(index);
+            g_thread_count = 0;
+
+            char tmp_msg[64];
+            sprintf(tmp_msg, "IoTHubClientPool_Create failure in test %lu/%lu", (unsigned long)index, (unsigned long)count);
+
+            IOTHUB_CLIENT_POOL_HANDLE pool = IoTHubClientPool_Create(1, 1);
+
+            // assert
+            ASSERT_IS_NULL_WITH_MSG(pool, tmp_msg);
+        }
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_009: [ If poolHandle is NULL, IoTHubClientPool_Destroy shall do nothing. ]
+TEST_FUNCTION(IoTHubClientPool_Destroy_NULL_handle)
+{
+    // arrange
+
+    // act
+    IoTHubClientPool_Destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_010: [ IoTHubClientPool_Destroy shall signal all the threads of the pool to stop, join them and free all resources. ]
+TEST_FUNCTION(IoTHubClientPool_Destroy_success)
+{
+    // arrange
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(1, 1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClientPool_Destroy(pool);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_011: [ If poolHandle, client, doWork or dispatch is NULL, IoTHubClientPool_AddClient shall fail and return NULL. ]
+TEST_FUNCTION(IoTHubClientPool_AddClient_NULL_arguments_fail)
+{
+    // arrange
+    TEST_CLIENT testClient;
+    init_test_client(&testClient, 'a', false);
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(1, 0);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE result1 = IoTHubClientPool_AddClient(NULL, &testClient, test_do_work, test_dispatch);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE result2 = IoTHubClientPool_AddClient(pool, NULL, test_do_work, test_dispatch);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE result3 = IoTHubClientPool_AddClient(pool, &testClient, NULL, test_dispatch);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE result4 = IoTHubClientPool_AddClient(pool, &testClient, test_do_work, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_IS_NULL(result3);
+    ASSERT_IS_NULL(result4);
+
+    // cleanup
+    IoTHubClientPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_012: [ IoTHubClientPool_AddClient shall add the client to the run queue of the next I/O thread, in round robin order, and wake that thread. ]
+TEST_FUNCTION(IoTHubClientPool_AddClient_success)
+{
+    // arrange
+    TEST_CLIENT testClient;
+    init_test_client(&testClient, 'a', false);
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(1, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient = IoTHubClientPool_AddClient(pool, &testClient, test_do_work, test_dispatch);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(poolClient);
+
+    // cleanup
+    IoTHubClientPool_RemoveClient(poolClient);
+    IoTHubClientPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_013: [ If allocating or locking fails, IoTHubClientPool_AddClient shall fail and return NULL. ]
+TEST_FUNCTION(IoTHubClientPool_AddClient_Lock_fails)
+{
+    // arrange
+    TEST_CLIENT testClient;
+    init_test_client(&testClient, 'a', false);
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(1, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE)).SetReturn(LOCK_ERROR);
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient = IoTHubClientPool_AddClient(pool, &testClient, test_do_work, test_dispatch);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(poolClient);
+
+    // cleanup
+    IoTHubClientPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_014: [ The I/O threads shall exit when IoTHubClientPool_Destroy is called. ]
+// Tests_SRS_IOTHUBCLIENT_POOL_11_015: [ Each round, an I/O thread shall drive every client in its run queue once, in order. ]
+// Tests_SRS_IOTHUBCLIENT_POOL_11_017: [ The I/O thread shall call the doWork function of the client without holding the pool lock. ]
+// Tests_SRS_IOTHUBCLIENT_POOL_11_020: [ After running a client the I/O thread shall put it back at the end of its run queue. ]
+// Tests_SRS_IOTHUBCLIENT_POOL_11_021: [ After a round the I/O thread shall wait on its condition for at most its idle wait, which starts at 1 ms, doubles after each round in which no client reported callbacks and never exceeds 1000 ms, unless one of its clients signaled work or the pool is being destroyed. ]
+TEST_FUNCTION(io_worker_thread_drives_each_client_once_per_round)
+{
+    // arrange
+    TEST_CLIENT testClient1;
+    TEST_CLIENT testClient2;
+    init_test_client(&testClient1, 'a', false);
+    init_test_client(&testClient2, 'b', false);
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(1, 0);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient1 = add_client(pool, &testClient1);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient2 = add_client(pool, &testClient2);
+    umock_c_reset_all_calls();
+
+    // act
+    run_thread(0, 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "wawbwawb", g_call_log);
+    ASSERT_ARE_EQUAL(size_t, 2, g_wait_count);
+    ASSERT_ARE_EQUAL(size_t, 0, testClient1.dispatchCount);
+
+    // cleanup
+    IoTHubClientPool_RemoveClient(poolClient1);
+    IoTHubClientPool_RemoveClient(poolClient2);
+    IoTHubClientPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_021: [ After a round the I/O thread shall wait on its condition for at most its idle wait, which starts at 1 ms, doubles after each round in which no client reported callbacks and never exceeds 1000 ms, unless one of its clients signaled work or the pool is being destroyed. ]
+TEST_FUNCTION(io_worker_thread_idle_wait_doubles_while_idle)
+{
+    // arrange
+    TEST_CLIENT testClient1;
+    init_test_client(&testClient1, 'a', false);
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(1, 0);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient1 = add_client(pool, &testClient1);
+    umock_c_reset_all_calls();
+
+    // act
+    run_thread(0, 3);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 8, g_last_wait_ms);
+
+    // cleanup
+    IoTHubClientPool_RemoveClient(poolClient1);
+    IoTHubClientPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_032: [ The I/O thread shall not wait longer than the smallest wait a client of the round left in the maxWaitMs argument of doWork, and shall not wait at all if that wait is 0. ]
+TEST_FUNCTION(io_worker_thread_waits_no_longer_than_its_clients_ask)
+{
+    // arrange
+    TEST_CLIENT testClient1;
+    TEST_CLIENT testClient2;
+    init_test_client(&testClient1, 'a', false);
+    init_test_client(&testClient2, 'b', false);
+    testClient1.maxWaitMs = 50;
+    testClient2.maxWaitMs = 5;
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(1, 0);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient1 = add_client(pool, &testClient1);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient2 = add_client(pool, &testClient2);
+    umock_c_reset_all_calls();
+
+    // act
+    run_thread(0, 4);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 5, g_last_wait_ms);
+
+    // cleanup
+    IoTHubClientPool_RemoveClient(poolClient1);
+    IoTHubClientPool_RemoveClient(poolClient2);
+    IoTHubClientPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_032: [ The I/O thread shall not wait longer than the smallest wait a client of the round left in the maxWaitMs argument of doWork, and shall not wait at all if that wait is 0. ]
+TEST_FUNCTION(io_worker_thread_does_not_wait_when_a_client_asks_for_0)
+{
+    // arrange
+    TEST_CLIENT testClient1;
+    init_test_client(&testClient1, 'a', false);
+    testClient1.maxWaitMs = 0;
+    testClient1.stopAfterDoWorkCount = 2;
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(1, 0);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient1 = add_client(pool, &testClient1);
+    umock_c_reset_all_calls();
+
+    // act
+    run_thread(0, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, testClient1.doWorkCount);
+    ASSERT_ARE_EQUAL(size_t, 0, g_wait_count);
+
+    // cleanup
+    IoTHubClientPool_RemoveClient(poolClient1);
+    IoTHubClientPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_018: [ If doWork returns true and the pool has no callback threads, the I/O thread shall call the dispatch function of the client before driving another client. ]
+TEST_FUNCTION(io_worker_thread_dispatches_inline_without_callback_threads)
+{
+    // arrange
+    TEST_CLIENT testClient1;
+    TEST_CLIENT testClient2;
+    init_test_client(&testClient1, 'a', true);
+    init_test_client(&testClient2, 'b', false);
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(1, 0);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient1 = add_client(pool, &testClient1);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient2 = add_client(pool, &testClient2);
+    umock_c_reset_all_calls();
+
+    // act
+    run_thread(0, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "wadawb", g_call_log);
+
+    // cleanup
+    IoTHubClientPool_RemoveClient(poolClient1);
+    IoTHubClientPool_RemoveClient(poolClient2);
+    IoTHubClientPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_019: [ If doWork returns true and the pool has callback threads, the client shall be added to the dispatch queue and a callback thread shall be signaled. ]
+// Tests_SRS_IOTHUBCLIENT_POOL_11_022: [ A client shall be in the dispatch queue at most once and shall not be queued while its callbacks are being dispatched. ]
+// Tests_SRS_IOTHUBCLIENT_POOL_11_023: [ The callback threads shall exit when IoTHubClientPool_Destroy is called. ]
+// Tests_SRS_IOTHUBCLIENT_POOL_11_024: [ A callback thread shall take the first client of the dispatch queue and call its dispatch function without holding the pool lock. ]
+TEST_FUNCTION(callback_worker_thread_dispatches_queued_clients)
+{
+    // arrange
+    TEST_CLIENT testClient1;
+    TEST_CLIENT testClient2;
+    init_test_client(&testClient1, 'a', true);
+    init_test_client(&testClient2, 'b', true);
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(1, 1);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient1 = add_client(pool, &testClient1);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient2 = add_client(pool, &testClient2);
+    run_thread(0, 2);
+    ASSERT_ARE_EQUAL(char_ptr, "wawbwawb", g_call_log);
+    g_call_log_length = 0;
+    g_call_log[0] = '\0';
+
+    // act
+    run_thread(1, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "dadb", g_call_log);
+    ASSERT_ARE_EQUAL(size_t, 1, testClient1.dispatchCount);
+    ASSERT_ARE_EQUAL(size_t, 1, testClient2.dispatchCount);
+
+    // cleanup
+    IoTHubClientPool_RemoveClient(poolClient1);
+    IoTHubClientPool_RemoveClient(poolClient2);
+    IoTHubClientPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_016: [ If its run queue is empty, an I/O thread shall steal the last client of the first other I/O thread that has more than one client queued. ]
+TEST_FUNCTION(io_worker_thread_steals_from_busy_thread)
+{
+    // arrange
+    TEST_CLIENT testClient1;
+    TEST_CLIENT testClient2;
+    TEST_CLIENT testClient3;
+    init_test_client(&testClient1, 'a', false);
+    init_test_client(&testClient2, 'b', false);
+    init_test_client(&testClient3, 'c', false);
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(2, 0);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient1 = add_client(pool, &testClient1);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient2 = add_client(pool, &testClient2);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient3 = add_client(pool, &testClient3);
+    IoTHubClientPool_RemoveClient(poolClient2);
+    umock_c_reset_all_calls();
+
+    // act
+    run_thread(1, 1);
+    run_thread(0, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "wcwa", g_call_log);
+
+    // cleanup
+    IoTHubClientPool_RemoveClient(poolClient1);
+    IoTHubClientPool_RemoveClient(poolClient3);
+    IoTHubClientPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_016: [ If its run queue is empty, an I/O thread shall steal the last client of the first other I/O thread that has more than one client queued. ]
+TEST_FUNCTION(io_worker_thread_does_not_steal_the_only_client)
+{
+    // arrange
+    TEST_CLIENT testClient1;
+    init_test_client(&testClient1, 'a', false);
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(2, 0);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient1 = add_client(pool, &testClient1);
+    umock_c_reset_all_calls();
+
+    // act
+    run_thread(1, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "", g_call_log);
+
+    // cleanup
+    IoTHubClientPool_RemoveClient(poolClient1);
+    IoTHubClientPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_026: [ If poolClientHandle is NULL, IoTHubClientPool_SignalClient shall do nothing. ]
+TEST_FUNCTION(IoTHubClientPool_SignalClient_NULL_handle)
+{
+    // arrange
+
+    // act
+    IoTHubClientPool_SignalClient(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_027: [ IoTHubClientPool_SignalClient shall mark work as pending for the I/O thread driving the client and call Condition_Post to wake it. ]
+TEST_FUNCTION(IoTHubClientPool_SignalClient_success)
+{
+    // arrange
+    TEST_CLIENT testClient1;
+    init_test_client(&testClient1, 'a', false);
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(1, 0);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient1 = add_client(pool, &testClient1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    IoTHubClientPool_SignalClient(poolClient1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientPool_RemoveClient(poolClient1);
+    IoTHubClientPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_028: [ If poolClientHandle is NULL, IoTHubClientPool_RemoveClient shall do nothing. ]
+TEST_FUNCTION(IoTHubClientPool_RemoveClient_NULL_handle)
+{
+    // arrange
+
+    // act
+    IoTHubClientPool_RemoveClient(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_029: [ IoTHubClientPool_RemoveClient shall remove the client from its run queue and from the dispatch queue. ]
+// Tests_SRS_IOTHUBCLIENT_POOL_11_031: [ IoTHubClientPool_RemoveClient shall free poolClientHandle. ]
+TEST_FUNCTION(IoTHubClientPool_RemoveClient_queued_client_is_not_driven_anymore)
+{
+    // arrange
+    TEST_CLIENT testClient1;
+    TEST_CLIENT testClient2;
+    init_test_client(&testClient1, 'a', false);
+    init_test_client(&testClient2, 'b', false);
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(1, 0);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient1 = add_client(pool, &testClient1);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient2 = add_client(pool, &testClient2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClientPool_RemoveClient(poolClient1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    run_thread(0, 1);
+    ASSERT_ARE_EQUAL(char_ptr, "wb", g_call_log);
+
+    // cleanup
+    IoTHubClientPool_RemoveClient(poolClient2);
+    IoTHubClientPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_029: [ IoTHubClientPool_RemoveClient shall remove the client from its run queue and from the dispatch queue. ]
+TEST_FUNCTION(IoTHubClientPool_RemoveClient_callbacks_are_not_dispatched_anymore)
+{
+    // arrange
+    TEST_CLIENT testClient1;
+    init_test_client(&testClient1, 'a', true);
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(1, 1);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient1 = add_client(pool, &testClient1);
+    run_thread(0, 1);
+
+    // act
+    IoTHubClientPool_RemoveClient(poolClient1);
+    run_thread(1, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, testClient1.doWorkCount);
+    ASSERT_ARE_EQUAL(size_t, 0, testClient1.dispatchCount);
+
+    // cleanup
+    IoTHubClientPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_033: [ If IoTHubClientPool_RemoveClient is called from doWork or dispatch of the same client, it shall not wait for the calling thread and shall leave freeing poolClientHandle to that thread. ]
+// Tests_SRS_IOTHUBCLIENT_POOL_11_034: [ A thread of the pool that returns from doWork or dispatch of a client removed by that call shall free the client. ]
+TEST_FUNCTION(IoTHubClientPool_RemoveClient_from_do_work_of_the_same_client)
+{
+    // arrange
+    TEST_CLIENT testClient1;
+    TEST_CLIENT testClient2;
+    init_test_client(&testClient1, 'a', false);
+    init_test_client(&testClient2, 'b', false);
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(1, 0);
+    testClient1.poolClient = add_client(pool, &testClient1);
+    IOTHUB_CLIENT_POOL_CLIENT_HANDLE poolClient2 = add_client(pool, &testClient2);
+    testClient1.removeOnDoWork = true;
+    umock_c_reset_all_calls();
+
+    // act
+    run_thread(0, 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "warawbwb", g_call_log);
+    ASSERT_ARE_EQUAL(size_t, 1, testClient1.doWorkCount);
+
+    // cleanup
+    IoTHubClientPool_RemoveClient(poolClient2);
+    IoTHubClientPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_033: [ If IoTHubClientPool_RemoveClient is called from doWork or dispatch of the same client, it shall not wait for the calling thread and shall leave freeing poolClientHandle to that thread. ]
+// Tests_SRS_IOTHUBCLIENT_POOL_11_034: [ A thread of the pool that returns from doWork or dispatch of a client removed by that call shall free the client. ]
+TEST_FUNCTION(IoTHubClientPool_RemoveClient_from_dispatch_of_the_same_client)
+{
+    // arrange
+    TEST_CLIENT testClient1;
+    init_test_client(&testClient1, 'a', true);
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(1, 1);
+    testClient1.poolClient = add_client(pool, &testClient1);
+    run_thread(0, 1);
+    testClient1.removeOnDispatch = true;
+    g_call_log_length = 0;
+    g_call_log[0] = '\0';
+
+    // act
+    run_thread(1, 1);
+    run_thread(0, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "dara", g_call_log);
+    ASSERT_ARE_EQUAL(size_t, 1, testClient1.doWorkCount);
+    ASSERT_ARE_EQUAL(size_t, 1, testClient1.dispatchCount);
+
+    // cleanup
+    IoTHubClientPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_035: [ If poolClientHandle is NULL, IoTHubClientPool_RemoveClientFromDispatch shall do nothing. ]
+TEST_FUNCTION(IoTHubClientPool_RemoveClientFromDispatch_NULL_handle)
+{
+    // arrange
+
+    // act
+    IoTHubClientPool_RemoveClientFromDispatch(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_036: [ IoTHubClientPool_RemoveClientFromDispatch shall remove the client as IoTHubClientPool_RemoveClient does when called from dispatch of the same client, whether or not thread local storage is available. ]
+// Tests_SRS_IOTHUBCLIENT_POOL_11_034: [ A thread of the pool that returns from doWork or dispatch of a client removed by that call shall free the client. ]
+TEST_FUNCTION(IoTHubClientPool_RemoveClientFromDispatch_on_a_callback_thread)
+{
+    // arrange
+    TEST_CLIENT testClient1;
+    init_test_client(&testClient1, 'a', true);
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(1, 1);
+    testClient1.poolClient = add_client(pool, &testClient1);
+    run_thread(0, 1);
+    testClient1.removeFromDispatch = true;
+    g_call_log_length = 0;
+    g_call_log[0] = '\0';
+
+    // act
+    run_thread(1, 1);
+    run_thread(0, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "dara", g_call_log);
+    ASSERT_ARE_EQUAL(size_t, 1, testClient1.doWorkCount);
+    ASSERT_ARE_EQUAL(size_t, 1, testClient1.dispatchCount);
+
+    // cleanup
+    IoTHubClientPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBCLIENT_POOL_11_036: [ IoTHubClientPool_RemoveClientFromDispatch shall remove the client as IoTHubClientPool_RemoveClient does when called from dispatch of the same client, whether or not thread local storage is available. ]
+// Tests_SRS_IOTHUBCLIENT_POOL_11_034: [ A thread of the pool that returns from doWork or dispatch of a client removed by that call shall free the client. ]
+TEST_FUNCTION(IoTHubClientPool_RemoveClientFromDispatch_on_the_io_thread)
+{
+    // arrange
+    TEST_CLIENT testClient1;
+    init_test_client(&testClient1, 'a', true);
+    IOTHUB_CLIENT_POOL_HANDLE pool = create_pool(1, 0);
+    testClient1.poolClient = add_client(pool, &testClient1);
+    testClient1.removeFromDispatch = true;
+    umock_c_reset_all_calls();
+
+    // act
+    run_thread(0, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "wadara", g_call_log);
+    ASSERT_ARE_EQUAL(size_t, 1, testClient1.doWorkCount);
+    ASSERT_ARE_EQUAL(size_t, 1, testClient1.dispatchCount);
+
+    // cleanup
+    IoTHubClientPool_Destroy(pool);
+}
+
+END_TEST_SUITE(iothub_client_pool_ut)
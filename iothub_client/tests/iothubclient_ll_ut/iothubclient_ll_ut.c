@@ -47,6 +47,7 @@ void* my_gballoc_realloc(void* ptr, size_t size)
 #include "iothub_message.h"
 #include "iothub_client_authorization.h"
 #include "iothub_client_diagnostic.h"
+#include "deadline_heap.h"
 
 #undef ENABLE_MOCKS
 
@@ -64,6 +65,10 @@ void* my_gballoc_realloc(void* ptr, size_t size)
 #include "iothub_client_ll_uploadtoblob.h"
 #endif
 
+#ifndef DONT_USE_MESSAGE_STORE
+#include "message_store.h"
+#endif
+
 MOCKABLE_FUNCTION(, void, test_event_confirmation_callback, IOTHUB_CLIENT_CONFIRMATION_RESULT, result, void*, userContextCallback);
 MOCKABLE_FUNCTION(, IOTHUBMESSAGE_DISPOSITION_RESULT, test_message_callback_async, IOTHUB_MESSAGE_HANDLE, message, void*, userContextCallback);
 MOCKABLE_FUNCTION(, void, iothub_reported_state_callback, int, status_code, void*, userContextCallback);
@@ -152,6 +157,7 @@ static const char* TEST_STRING_VALUE = "Test string value";
 
 #define TEST_DEVICEMESSAGE_HANDLE (IOTHUB_MESSAGE_HANDLE)0x52
 #define TEST_DEVICEMESSAGE_HANDLE_2 (IOTHUB_MESSAGE_HANDLE)0x53
+#define TEST_MESSAGE_SIZE 10
 #define TEST_IOTHUB_CLIENT_LL_HANDLE    (IOTHUB_CLIENT_LL_HANDLE)0x4242
 
 #define TEST_STRING_HANDLE (STRING_HANDLE)0x46
@@ -171,6 +177,8 @@ static const char* TEST_STRING_VALUE = "Test string value";
 
 #define TEST_METHOD_ID                      (METHOD_HANDLE)0x61
 #define TEST_IOTHUB_AUTH_HANDLE        (IOTHUB_AUTHORIZATION_HANDLE)0x62
+#define TEST_MESSAGE_STORE_HANDLE           (MESSAGE_STORE_HANDLE)0x63
+#define TEST_MESSAGE_STORE_PATH             "theMessageStorePath"
 
 static const char* TEST_PROV_URI = "global.azure-devices-provisioning.net";
 
@@ -376,15 +384,37 @@ static void my_IoTHubClient_LL_UploadToBlob_Destroy(IOTHUB_CLIENT_LL_UPLOADTOBLO
 }
 #endif
 
+static PDLIST_ENTRY test_waitingToSend;
 static IOTHUB_DEVICE_HANDLE my_FAKE_IoTHubTransport_Register(TRANSPORT_LL_HANDLE handle, const IOTHUB_DEVICE_CONFIG* device, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, PDLIST_ENTRY waitingToSend)
 {
     (void)handle;
     (void)device;
     (void)iotHubClientHandle;
-    (void)waitingToSend;
+    test_waitingToSend = waitingToSend;
     return (IOTHUB_DEVICE_HANDLE)my_gballoc_malloc(1);
 }
 
+static const unsigned char TEST_MESSAGE_PAYLOAD[TEST_MESSAGE_SIZE] = { 0 };
+static size_t test_message_size;
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_GetByteArray(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const unsigned char** buffer, size_t* size)
+{
+    (void)iotHubMessageHandle;
+    *buffer = TEST_MESSAGE_PAYLOAD;
+    *size = test_message_size;
+    return IOTHUB_MESSAGE_OK;
+}
+
+#ifndef DONT_USE_MESSAGE_STORE
+static uint64_t test_next_record_id;
+static int my_message_store_append(MESSAGE_STORE_HANDLE store, IOTHUB_MESSAGE_HANDLE message, uint64_t* recordId)
+{
+    (void)store;
+    (void)message;
+    *recordId = test_next_record_id++;
+    return 0;
+}
+#endif
+
 static void my_FAKE_IoTHubTransport_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
 {
     my_gballoc_free(deviceHandle);
@@ -494,6 +524,13 @@ extern "C"
     int real_DList_RemoveEntryList(PDLIST_ENTRY listEntry);
     PDLIST_ENTRY real_DList_RemoveHeadList(PDLIST_ENTRY listHead);
 
+    DEADLINE_HEAP_HANDLE real_deadline_heap_create(void);
+    void real_deadline_heap_destroy(DEADLINE_HEAP_HANDLE heap);
+    DEADLINE_HEAP_ENTRY_HANDLE real_deadline_heap_add(DEADLINE_HEAP_HANDLE heap, tickcounter_ms_t deadline, void* value);
+    void real_deadline_heap_remove(DEADLINE_HEAP_HANDLE heap, DEADLINE_HEAP_ENTRY_HANDLE entry);
+    void* real_deadline_heap_pop_expired(DEADLINE_HEAP_HANDLE heap, tickcounter_ms_t current_ms);
+    bool real_deadline_heap_peek_deadline(DEADLINE_HEAP_HANDLE heap, tickcounter_ms_t* deadline);
+
 #ifdef __cplusplus
 }
 #endif
@@ -558,6 +595,11 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(METHOD_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_AUTHORIZATION_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(DEADLINE_HEAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(DEADLINE_HEAP_ENTRY_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(tickcounter_ms_t, uint64_t);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
 
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_RESULT, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_DISPOSITION_RESULT, int);
@@ -612,11 +654,26 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClient_LL_UploadToBlob_SetOption, IOTHUB_CLIENT_OK);
 #endif
 
+#ifndef DONT_USE_MESSAGE_STORE
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_STORE_HANDLE, void*);
+    REGISTER_GLOBAL_MOCK_RETURN(message_store_open, TEST_MESSAGE_STORE_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_store_open, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(message_store_append, my_message_store_append);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_store_append, __FAILURE__);
+    REGISTER_GLOBAL_MOCK_RETURN(message_store_read, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(message_store_complete, 0);
+    REGISTER_GLOBAL_MOCK_RETURN(message_store_sync, 0);
+#endif
+
     REGISTER_GLOBAL_MOCK_RETURN(deviceMethodCallback, 200);
 
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_CreateFromString, (IOTHUB_MESSAGE_HANDLE)0x44);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_Clone, (IOTHUB_MESSAGE_HANDLE)0x44);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_Clone, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_GetContentType, IOTHUBMESSAGE_BYTEARRAY);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetContentType, IOTHUBMESSAGE_UNKNOWN);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetByteArray, my_IoTHubMessage_GetByteArray);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetByteArray, IOTHUB_MESSAGE_ERROR);
 
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClient_Diagnostic_AddIfNecessary, 0);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_Diagnostic_AddIfNecessary, 100);
@@ -669,6 +726,15 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, real_DList_RemoveEntryList);
     REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
 
+    REGISTER_GLOBAL_MOCK_HOOK(deadline_heap_create, real_deadline_heap_create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(deadline_heap_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(deadline_heap_destroy, real_deadline_heap_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(deadline_heap_add, real_deadline_heap_add);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(deadline_heap_add, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(deadline_heap_remove, real_deadline_heap_remove);
+    REGISTER_GLOBAL_MOCK_HOOK(deadline_heap_pop_expired, real_deadline_heap_pop_expired);
+    REGISTER_GLOBAL_MOCK_HOOK(deadline_heap_peek_deadline, real_deadline_heap_peek_deadline);
+
     REGISTER_GLOBAL_MOCK_RETURN(test_message_callback_async, IOTHUBMESSAGE_ACCEPTED);
     REGISTER_GLOBAL_MOCK_RETURN(messageCallback, IOTHUBMESSAGE_ACCEPTED);
     REGISTER_GLOBAL_MOCK_RETURN(messageCallbackEx, true);
@@ -695,6 +761,10 @@ TEST_FUNCTION_INITIALIZE(method_init)
     g_fail_string_construct_sprintf = false;
     g_fail_platform_get_platform_info = false;
     g_fail_string_concat_with_string = false;
+    test_message_size = TEST_MESSAGE_SIZE;
+#ifndef DONT_USE_MESSAGE_STORE
+    test_next_record_id = 0;
+#endif
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -1787,6 +1857,9 @@ TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_succeeds)
     STRICT_EXPECTED_CALL(IoTHubMessage_Clone(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
     STRICT_EXPECTED_CALL(IoTHubClient_Diagnostic_AddIfNecessary(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -1869,10 +1942,15 @@ TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_fails)
     STRICT_EXPECTED_CALL(IoTHubMessage_Clone(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
     STRICT_EXPECTED_CALL(IoTHubClient_Diagnostic_AddIfNecessary(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
 
+    STRICT_EXPECTED_CALL(deadline_heap_add(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG));
+
     STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -1880,7 +1958,7 @@ TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_fails)
     umock_c_negative_tests_snapshot();
 
     // act
-    size_t calls_cannot_fail[] = { 4 };
+    size_t calls_cannot_fail[] = { 7 };
     size_t count = umock_c_negative_tests_call_count();
     for (size_t index = 0; index < count; index++)
     {
@@ -1906,7 +1984,118 @@ TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_fails)
     umock_c_negative_tests_deinit();
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_25_111: [IoTHubClient_LL_SetConnectionStatusCallback shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter iotHubClientHandle]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_11_001: [ If iotHubClientHandle, newEntry or the message of newEntry is NULL, IoTHubClient_LL_SendEventEntry shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventEntry_with_NULL_arguments_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_LIST entry;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    entry.messageHandle = NULL;
+    entry.callback = test_event_confirmation_callback;
+    entry.context = (void*)1;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result1 = IoTHubClient_LL_SendEventEntry(NULL, &entry);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubClient_LL_SendEventEntry(handle, NULL);
+    IOTHUB_CLIENT_RESULT result3 = IoTHubClient_LL_SendEventEntry(handle, &entry);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result2);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_002: [ IoTHubClient_LL_SendEventEntry shall compute the timeout of the message the same way IoTHubClient_LL_SendEventAsync does. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_11_003: [ IoTHubClient_LL_SendEventEntry shall add newEntry, without cloning its message, to the DLIST waitingToSend and take ownership of it. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventEntry_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_MESSAGE_LIST* entry = (IOTHUB_MESSAGE_LIST*)my_gballoc_malloc(sizeof(IOTHUB_MESSAGE_LIST));
+    entry->messageHandle = TEST_MESSAGE_HANDLE;
+    entry->callback = test_event_confirmation_callback;
+    entry->context = (void*)1;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_Diagnostic_AddIfNecessary(IGNORED_PTR_ARG, TEST_MESSAGE_HANDLE))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, &entry->entry))
+        .IgnoreArgument(1);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventEntry(handle, entry);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle); /*completes and frees entry*/
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_004: [ If IoTHubClient_LL_SendEventEntry fails, the caller keeps the ownership of newEntry. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventEntry_fails)
+{
+    //arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t thisIsNotZero = 312984751;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &thisIsNotZero);
+    IOTHUB_MESSAGE_LIST entry;
+    entry.messageHandle = TEST_MESSAGE_HANDLE;
+    entry.callback = test_event_confirmation_callback;
+    entry.context = (void*)1;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_Diagnostic_AddIfNecessary(IGNORED_PTR_ARG, TEST_MESSAGE_HANDLE))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(deadline_heap_add(IGNORED_PTR_ARG, IGNORED_NUM_ARG, &entry));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    umock_c_negative_tests_snapshot();
+
+    // act
+    size_t calls_cannot_fail[] = { 5 };
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        if (should_skip_index(index, calls_cannot_fail, sizeof(calls_cannot_fail) / sizeof(calls_cannot_fail[0])) != 0)
+        {
+            continue;
+        }
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubClient_LL_SendEventEntry failure in test %zu/%zu", index, count);
+
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventEntry(handle, &entry);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result, tmp_msg);
+    }
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle); /*entry was never added, nothing to confirm*/
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_25_111:[IoTHubClient_LL_SetConnectionStatusCallback shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter iotHubClientHandle]*/
 TEST_FUNCTION(IoTHubClient_LL_SetConnectionStatusCallback_with_NULL_iotHubClientHandle_fails)
 {
     ///arrange
@@ -2546,9 +2735,6 @@ TEST_FUNCTION(IoTHubClient_LL_DoWork_calls_underlying_succeeds)
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*_DoWork will ask "what's the time"*/
-        .IgnoreAllArguments();
-
     STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, handle))
         .IgnoreArgument(1);
 
@@ -3329,6 +3515,8 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_to_one_after_Create_succe
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(deadline_heap_create());
+
     //act
     tickcounter_ms_t one = 1;
     IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
@@ -3390,6 +3578,7 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_calls_timeout_callback)
         .IgnoreArgument(1)
         .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
 
+    STRICT_EXPECTED_CALL(deadline_heap_pop_expired(IGNORED_PTR_ARG, twelve)); /*the deadline of the message has passed*/
     STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
@@ -3397,6 +3586,7 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_calls_timeout_callback)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(deadline_heap_pop_expired(IGNORED_PTR_ARG, twelve)); /*no other deadline has passed*/
     EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllCalls();
 
@@ -3427,12 +3617,9 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_defaults_to_zero)
     (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
     umock_c_reset_all_calls();
 
-    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+    /*messageTimeout option has never been set, therefore _DoWork does not even ask for the time and no timeout shall be called*/
 
-    tickcounter_ms_t twelve = 12; /*12 > 10 (receive time) + 1 (timeout) => would result in timeout, except the fact that messageTimeout option has never been set, therefore no timeout shall be called*/
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
     EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllCalls();
 
@@ -3470,12 +3657,14 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_only_removes_the_message_
         .IgnoreArgument(1)
         .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
 
+    STRICT_EXPECTED_CALL(deadline_heap_pop_expired(IGNORED_PTR_ARG, twelve)); /*the deadline of the message has passed*/
     STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(deadline_heap_pop_expired(IGNORED_PTR_ARG, twelve)); /*no other deadline has passed*/
 
     /*we don't care what happens in the Transport, so let's ignore all those calls*/
     EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -3491,6 +3680,133 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_only_removes_the_message_
     IoTHubClient_LL_Destroy(handle);
 }
 
+/*Tests_SRS_IOTHUBCLIENT_LL_11_037: [ If iotHubClientHandle or timeToDeadlineMs is NULL, IoTHubClient_LL_GetTimeToNextDeadline shall return false. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetTimeToNextDeadline_with_NULL_handle_fails)
+{
+    //arrange
+    tickcounter_ms_t timeToDeadline;
+
+    //act
+    bool result = IoTHubClient_LL_GetTimeToNextDeadline(NULL, &timeToDeadline);
+
+    ///assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_038: [ If no queued message has a deadline, IoTHubClient_LL_GetTimeToNextDeadline shall return false. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetTimeToNextDeadline_without_messageTimeout_returns_false)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t timeToDeadline;
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(deadline_heap_peek_deadline(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    bool result = IoTHubClient_LL_GetTimeToNextDeadline(handle, &timeToDeadline);
+
+    ///assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_039: [ Otherwise IoTHubClient_LL_GetTimeToNextDeadline shall store in timeToDeadlineMs the time left until the earliest deadline is reached, 0 if it already is, and return true. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetTimeToNextDeadline_returns_the_time_left_until_the_earliest_deadline)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t five = 5;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &five);
+
+    tickcounter_ms_t ten = 10;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    tickcounter_ms_t twelve = 12; /*the message times out once more than 10 + 5 ms have passed, that is at 16*/
+    tickcounter_ms_t timeToDeadline = 0;
+    STRICT_EXPECTED_CALL(deadline_heap_peek_deadline(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+
+    //act
+    bool result = IoTHubClient_LL_GetTimeToNextDeadline(handle, &timeToDeadline);
+
+    ///assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(uint64_t, 4, (uint64_t)timeToDeadline);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_039: [ Otherwise IoTHubClient_LL_GetTimeToNextDeadline shall store in timeToDeadlineMs the time left until the earliest deadline is reached, 0 if it already is, and return true. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetTimeToNextDeadline_after_the_deadline_returns_0)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t five = 5;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &five);
+
+    tickcounter_ms_t ten = 10;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    tickcounter_ms_t twenty = 20;
+    tickcounter_ms_t timeToDeadline = 42;
+    STRICT_EXPECTED_CALL(deadline_heap_peek_deadline(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &twenty, sizeof(twenty));
+
+    //act
+    bool result = IoTHubClient_LL_GetTimeToNextDeadline(handle, &timeToDeadline);
+
+    ///assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(uint64_t, 0, (uint64_t)timeToDeadline);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_040: [ If the current time cannot be read, IoTHubClient_LL_GetTimeToNextDeadline shall report the deadline as reached. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetTimeToNextDeadline_tickcounter_fails_returns_0)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t five = 5;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &five);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    tickcounter_ms_t timeToDeadline = 42;
+    STRICT_EXPECTED_CALL(deadline_heap_peek_deadline(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(__LINE__);
+
+    //act
+    bool result = IoTHubClient_LL_GetTimeToNextDeadline(handle, &timeToDeadline);
+
+    ///assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(uint64_t, 0, (uint64_t)timeToDeadline);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
 /*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
 /*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
 TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_when_exactly_on_the_edge_does_not_call_the_callback) /*because "more"*/
@@ -3514,6 +3830,7 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_when_exactly_on_the_edge_
     STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .CopyOutArgumentBuffer(2, &eleven, sizeof(eleven));
+    STRICT_EXPECTED_CALL(deadline_heap_pop_expired(IGNORED_PTR_ARG, eleven)); /*the deadline has not passed yet*/
 
     /*we don't care what happens in the Transport, so let's ignore all those calls*/
     EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -3561,6 +3878,7 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_with_timeouts_at_11_and_12_ca
         .IgnoreArgument(1)
         .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
 
+    STRICT_EXPECTED_CALL(deadline_heap_pop_expired(IGNORED_PTR_ARG, twelve)); /*the deadline of the first message has passed*/
     STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
@@ -3568,6 +3886,7 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_with_timeouts_at_11_and_12_ca
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(deadline_heap_pop_expired(IGNORED_PTR_ARG, twelve)); /*the deadline of the second message has not*/
 
     /*we don't care what happens in the Transport, so let's ignore all those calls*/
     EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -3621,6 +3940,7 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_with_timeouts_at_11_and_12_ca
         .IgnoreArgument(1)
         .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
 
+    STRICT_EXPECTED_CALL(deadline_heap_pop_expired(IGNORED_PTR_ARG, IGNORED_NUM_ARG)); /*the deadline of the first message has passed*/
     STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
@@ -3628,6 +3948,7 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_with_timeouts_at_11_and_12_ca
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(deadline_heap_pop_expired(IGNORED_PTR_ARG, IGNORED_NUM_ARG)); /*the deadline of the second message has not*/
 
     EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllCalls();
@@ -3637,6 +3958,7 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_with_timeouts_at_11_and_12_ca
         .IgnoreArgument(1)
         .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
 
+    STRICT_EXPECTED_CALL(deadline_heap_pop_expired(IGNORED_PTR_ARG, IGNORED_NUM_ARG)); /*the deadline of the second message has passed*/
     STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)(TEST_DEVICEMESSAGE_HANDLE_2))); /*calling the callback*/
@@ -3644,6 +3966,7 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_with_timeouts_at_11_and_12_ca
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(deadline_heap_pop_expired(IGNORED_PTR_ARG, IGNORED_NUM_ARG)); /*no other deadline has passed*/
 
     EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllCalls();
@@ -3697,6 +4020,7 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_one_with_timeout_one_without_
             .IgnoreArgument(1)
             .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
 
+        STRICT_EXPECTED_CALL(deadline_heap_pop_expired(IGNORED_PTR_ARG, timeIsNow)); /*the deadline of the first message has passed*/
         STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
@@ -3704,6 +4028,7 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_one_with_timeout_one_without_
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
             .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(deadline_heap_pop_expired(IGNORED_PTR_ARG, timeIsNow)); /*the second message has no deadline*/
     }
 
     EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -3714,6 +4039,7 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_one_with_timeout_one_without_
         STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(1)
             .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
+        STRICT_EXPECTED_CALL(deadline_heap_pop_expired(IGNORED_PTR_ARG, timeIsNow)); /*no deadline left*/
     }
     EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllCalls();
@@ -3771,76 +4097,831 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_when_tickcounter_fails_in
     IoTHubClient_LL_Destroy(handle);
 }
 
-#ifndef DONT_USE_UPLOADTOBLOB
-/*Tests_SRS_IOTHUBCLIENT_LL_02_061: [ If iotHubClientHandle is NULL then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
-TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_with_NULL_handle_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_11_005: [ The first time "messageTimeout" is set to a non-zero value, IoTHubClient_LL_SetOption shall create the index of message deadlines by calling deadline_heap_create. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_creates_the_deadline_index_only_once)
 {
     //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    umock_c_reset_all_calls();
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob(NULL, "irrelevantFileName", (const unsigned char*)"a", 1);
+    tickcounter_ms_t two = 2;
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "messageTimeout", &two);
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_062: [ If destinationFileName is NULL then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
-TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_with_NULL_fileName_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_11_006: [ If creating the index fails, IoTHubClient_LL_SetOption shall leave the current timeout unchanged and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_fails_when_deadline_heap_create_fails)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(deadline_heap_create())
+        .SetReturn(NULL);
+
+    /*the timeout was left unchanged, so the message is not stamped*/
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_Diagnostic_AddIfNecessary(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob(h, NULL, (const unsigned char*)"a", 1);
+    tickcounter_ms_t one = 1;
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_063: [ If source is NULL and size is greater than 0 then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
-TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_with_NULL_source_and_size_greater_than_0_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_11_007: [ A message that has a timeout shall be indexed by its deadline before being added to waitingToSend. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_messageTimeout_indexes_the_deadline)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
     umock_c_reset_all_calls();
 
+    tickcounter_ms_t ten = 10;
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_Diagnostic_AddIfNecessary(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(deadline_heap_add(IGNORED_PTR_ARG, 12, IGNORED_PTR_ARG)); /*the message times out once the time is past 10 + 1*/
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob(h, "someFileName.txt", NULL, 1);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_99_005: [** If `iotHubClientHandle` is `NULL` then `IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
-TEST_FUNCTION(IoTHubClient_LL_UploadMultipleBlocksToBlob_with_NULL_handle_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_11_012: [ Once a queued message is confirmed, for any reason, its deadline shall be removed from the index by calling deadline_heap_remove. ]*/
+TEST_FUNCTION(IoTHubClient_LL_confirming_a_message_with_a_timeout_removes_its_deadline)
 {
     //arrange
-    unsigned int context = 1;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
 
-    //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadMultipleBlocksToBlob(NULL, "irrelevantFileName", my_FileUpload_GetData_Callback, &context);
+    tickcounter_ms_t ten = 10;
+    IOTHUB_MESSAGE_LIST* entry = (IOTHUB_MESSAGE_LIST*)my_gballoc_malloc(sizeof(IOTHUB_MESSAGE_LIST));
+    entry->messageHandle = TEST_MESSAGE_HANDLE;
+    entry->callback = test_event_confirmation_callback;
+    entry->context = (void*)1;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventEntry(handle, entry);
 
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    /*the transport takes the message*/
+    (void)real_DList_RemoveEntryList(&entry->entry);
+    umock_c_reset_all_calls();
 
-    ///cleanup
-}
+    STRICT_EXPECTED_CALL(deadline_heap_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
 
-/*Tests_SRS_IOTHUBCLIENT_LL_99_006: [ If `destinationFileName` is `NULL` then `IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
-TEST_FUNCTION(IoTHubClient_LL_UploadMultipleBlocksToBlob_with_NULL_filename_fails)
-{
-    //arrange
+    tickcounter_ms_t timeIsNow = 13; /*the deadline is gone, so nothing expires*/
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
+    STRICT_EXPECTED_CALL(deadline_heap_pop_expired(IGNORED_PTR_ARG, timeIsNow));
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    //act
+    entry->callback(IOTHUB_CLIENT_CONFIRMATION_OK, entry->context);
+    my_gballoc_free(entry);
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_011: [ A message whose deadline expired shall be timed out if it is still in waitingToSend; a message taken by the transport is left to it, out of the index. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_leaves_an_expired_message_taken_by_the_transport_to_it)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    tickcounter_ms_t ten = 10;
+    IOTHUB_MESSAGE_LIST* entry = (IOTHUB_MESSAGE_LIST*)my_gballoc_malloc(sizeof(IOTHUB_MESSAGE_LIST));
+    entry->messageHandle = TEST_MESSAGE_HANDLE;
+    entry->callback = test_event_confirmation_callback;
+    entry->context = (void*)1;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventEntry(handle, entry);
+
+    /*the transport takes the message*/
+    (void)real_DList_RemoveEntryList(&entry->entry);
+    umock_c_reset_all_calls();
+
+    tickcounter_ms_t timeIsNow = 12;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
+    STRICT_EXPECTED_CALL(deadline_heap_pop_expired(IGNORED_PTR_ARG, timeIsNow)); /*the deadline of the message has passed, but it is not waiting anymore*/
+    STRICT_EXPECTED_CALL(deadline_heap_pop_expired(IGNORED_PTR_ARG, timeIsNow)); /*and it is not indexed again*/
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1)); /*the transport confirms it later*/
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+    entry->callback(IOTHUB_CLIENT_CONFIRMATION_OK, entry->context);
+    my_gballoc_free(entry);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_041: [ A message at the head of waitingToSend that has a timeout but is out of the index was put back by the transport after its deadline expired, and shall be timed out. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_times_out_a_message_the_transport_puts_back_after_its_deadline)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    tickcounter_ms_t ten = 10;
+    IOTHUB_MESSAGE_LIST* entry = (IOTHUB_MESSAGE_LIST*)my_gballoc_malloc(sizeof(IOTHUB_MESSAGE_LIST));
+    entry->messageHandle = TEST_MESSAGE_HANDLE;
+    entry->callback = test_event_confirmation_callback;
+    entry->context = (void*)1;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventEntry(handle, entry);
+
+    /*the transport takes the message and still holds it when its deadline passes*/
+    (void)real_DList_RemoveEntryList(&entry->entry);
+    tickcounter_ms_t twelve = 12;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+    IoTHubClient_LL_DoWork(handle);
+
+    /*then it puts it back, as it does when the connection drops*/
+    real_DList_InsertHeadList(test_waitingToSend, &entry->entry);
+    umock_c_reset_all_calls();
+
+    tickcounter_ms_t timeIsNow = 13;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
+    STRICT_EXPECTED_CALL(deadline_heap_pop_expired(IGNORED_PTR_ARG, timeIsNow)); /*its deadline was dropped when it expired*/
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)); /*this is removing the item from the head of waitingToSend*/
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(entry));
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_023: [ If "queue_overflow_policy" is not a IOTHUB_CLIENT_QUEUE_OVERFLOW_POLICY value, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_queue_overflow_policy_with_unknown_value_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_QUEUE_OVERFLOW_POLICY policy = (IOTHUB_CLIENT_QUEUE_OVERFLOW_POLICY)42;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_QUEUE_OVERFLOW_POLICY, &policy);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_014: [ "max_queued_messages" and "max_queued_bytes" shall set the limits, as size_t, of the number and the total size of the messages held until they are confirmed; 0 removes the limit. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_11_018: [ If the message still does not fit within "max_queued_messages" and "max_queued_bytes", the send shall fail with IOTHUB_CLIENT_QUEUE_FULL and no message shall be added to waitingToSend. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_over_max_queued_messages_fails_with_QUEUE_FULL)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t maxMessages = 1;
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MAX_QUEUED_MESSAGES, &maxMessages);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_QUEUE_FULL, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_016: [ A message whose payload alone is bigger than "max_queued_bytes" shall be rejected with IOTHUB_CLIENT_INVALID_SIZE, whatever the overflow policy. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_bigger_than_max_queued_bytes_fails_with_INVALID_SIZE)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t maxBytes = TEST_MESSAGE_SIZE - 1;
+    IOTHUB_CLIENT_QUEUE_OVERFLOW_POLICY policy = IOTHUB_CLIENT_QUEUE_OVERFLOW_DROP_OLDEST;
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MAX_QUEUED_BYTES, &maxBytes);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_QUEUE_OVERFLOW_POLICY, &policy);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_SIZE, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_017: [ With IOTHUB_CLIENT_QUEUE_OVERFLOW_DROP_OLDEST, the oldest messages of waitingToSend shall be removed, completed with IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT and destroyed until the new message fits. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_DROP_OLDEST_times_out_the_oldest_message)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t maxBytes = TEST_MESSAGE_SIZE * 2;
+    IOTHUB_CLIENT_QUEUE_OVERFLOW_POLICY policy = IOTHUB_CLIENT_QUEUE_OVERFLOW_DROP_OLDEST;
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MAX_QUEUED_BYTES, &maxBytes);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_QUEUE_OVERFLOW_POLICY, &policy);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_Diagnostic_AddIfNecessary(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)3);
+    size_t messageCount;
+    size_t byteCount;
+    (void)IoTHubClient_LL_GetSendQueueStatus(handle, &messageCount, &byteCount);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, messageCount);
+    ASSERT_ARE_EQUAL(size_t, TEST_MESSAGE_SIZE * 2, byteCount);
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_021: [ If iotHubClientHandle, messageCount or byteCount is NULL, IoTHubClient_LL_GetSendQueueStatus shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetSendQueueStatus_with_NULL_arguments_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t messageCount;
+    size_t byteCount;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result1 = IoTHubClient_LL_GetSendQueueStatus(NULL, &messageCount, &byteCount);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubClient_LL_GetSendQueueStatus(handle, NULL, &byteCount);
+    IOTHUB_CLIENT_RESULT result3 = IoTHubClient_LL_GetSendQueueStatus(handle, &messageCount, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result2);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_013: [ By default, the send queue shall have no limit and the overflow policy shall be IOTHUB_CLIENT_QUEUE_OVERFLOW_REJECT. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_11_015: [ The size of a message in the send queue shall be the size of its payload, obtained with IoTHubMessage_GetByteArray or IoTHubMessage_GetString depending on IoTHubMessage_GetContentType. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_11_022: [ IoTHubClient_LL_GetSendQueueStatus shall return in messageCount and byteCount the number and the total size of the messages accepted and not yet confirmed, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetSendQueueStatus_counts_string_and_byte_array_messages)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t messageCount;
+    size_t byteCount;
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(IGNORED_PTR_ARG))
+        .SetReturn(IOTHUBMESSAGE_STRING);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetString(IGNORED_PTR_ARG))
+        .SetReturn("abc");
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE_2, test_event_confirmation_callback, (void*)2);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendQueueStatus(handle, &messageCount, &byteCount);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, messageCount);
+    ASSERT_ARE_EQUAL(size_t, TEST_MESSAGE_SIZE + 3, byteCount);
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_019: [ Once a queued message is confirmed, for any reason, it shall stop counting against the limits of the send queue before its event confirmation callback is called. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_11_020: [ The confirmation callback and context of an accepted message shall be kept aside and replaced by the ones of IoTHubClient_LL, so the message is accounted for whoever completes it; a message that is not accepted is left unchanged. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_frees_room_in_the_send_queue)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t maxMessages = 1;
+    size_t messageCount;
+    size_t byteCount;
+    DLIST_ENTRY completed;
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MAX_QUEUED_MESSAGES, &maxMessages);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    /*the transport takes the message and confirms it*/
+    real_DList_InitializeListHead(&completed);
+    real_DList_InsertTailList(&completed, real_DList_RemoveHeadList(test_waitingToSend));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+
+    /*the next message fits again*/
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_Diagnostic_AddIfNecessary(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_LL_SendComplete(handle, &completed, IOTHUB_CLIENT_CONFIRMATION_OK);
+    (void)IoTHubClient_LL_GetSendQueueStatus(handle, &messageCount, &byteCount);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, messageCount);
+    ASSERT_ARE_EQUAL(size_t, 0, byteCount);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+#ifndef DONT_USE_MESSAGE_STORE
+/*Tests_SRS_IOTHUBCLIENT_LL_11_025: [ By default, IoTHubClient_LL shall not use a message store and its segments shall be MESSAGE_STORE_DEFAULT_SEGMENT_SIZE bytes. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_11_028: [ "message_store_path" shall open the message store kept in the directory value with message_store_open and "message_store_segment_size"; if it fails, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_message_store_path_opens_the_store)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(message_store_open(TEST_MESSAGE_STORE_PATH, MESSAGE_STORE_DEFAULT_SEGMENT_SIZE));
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_STORE_PATH, TEST_MESSAGE_STORE_PATH);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_028: [ "message_store_path" shall open the message store kept in the directory value with message_store_open and "message_store_segment_size"; if it fails, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_message_store_path_uses_the_segment_size)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t segmentSize = 4096;
+    IOTHUB_CLIENT_RESULT result1 = IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_STORE_SEGMENT_SIZE, &segmentSize);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(message_store_open(TEST_MESSAGE_STORE_PATH, 4096));
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result2 = IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_STORE_PATH, TEST_MESSAGE_STORE_PATH);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_026: [ If "message_store_segment_size" is 0, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_message_store_segment_size_0_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t segmentSize = 0;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_STORE_SEGMENT_SIZE, &segmentSize);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_027: [ If a message store is already open, setting "message_store_path" shall fail with IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_message_store_path_twice_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_STORE_PATH, TEST_MESSAGE_STORE_PATH);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_STORE_PATH, TEST_MESSAGE_STORE_PATH);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_028: [ "message_store_path" shall open the message store kept in the directory value with message_store_open and "message_store_segment_size"; if it fails, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_message_store_path_fails_when_message_store_open_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(message_store_open(TEST_MESSAGE_STORE_PATH, MESSAGE_STORE_DEFAULT_SEGMENT_SIZE))
+        .SetReturn(NULL);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_STORE_PATH, TEST_MESSAGE_STORE_PATH);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_029: [ With a message store, the event shall be appended to it with message_store_append, without cloning its message, and its callback shall be kept until it is read back. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_a_message_store_appends_the_event)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_STORE_PATH, TEST_MESSAGE_STORE_PATH);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(message_store_append(TEST_MESSAGE_STORE_HANDLE, TEST_DEVICEMESSAGE_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_030: [ If appending the event fails, the send shall fail with IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_fails_when_message_store_append_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_STORE_PATH, TEST_MESSAGE_STORE_PATH);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(message_store_append(TEST_MESSAGE_STORE_HANDLE, TEST_DEVICEMESSAGE_HANDLE, IGNORED_PTR_ARG))
+        .SetReturn(__FAILURE__);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_031: [ IoTHubClient_LL_DoWork shall read events back from the message store into waitingToSend while they fit within "max_queued_messages" and "max_queued_bytes", and always when no event is queued. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_11_032: [ An event read back shall get the callback it was sent with in this run, or no callback if it was sent by a previous run. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_11_035: [ After the underlaying layer's _DoWork, IoTHubClient_LL_DoWork shall call message_store_sync, so the events sent and confirmed since the previous call are made durable together. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_reads_back_the_stored_events_and_syncs_the_store)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t recordId = 0;
+    size_t messageCount;
+    size_t byteCount;
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_STORE_PATH, TEST_MESSAGE_STORE_PATH);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(message_store_read(TEST_MESSAGE_STORE_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_recordId(&recordId, sizeof(recordId))
+        .SetReturn(TEST_DEVICEMESSAGE_HANDLE_2);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_DEVICEMESSAGE_HANDLE_2));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_DEVICEMESSAGE_HANDLE_2, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_Diagnostic_AddIfNecessary(IGNORED_PTR_ARG, TEST_DEVICEMESSAGE_HANDLE_2));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_store_read(TEST_MESSAGE_STORE_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, handle))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(message_store_sync(TEST_MESSAGE_STORE_HANDLE));
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+    (void)IoTHubClient_LL_GetSendQueueStatus(handle, &messageCount, &byteCount);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, messageCount);
+    ASSERT_ARE_EQUAL(size_t, TEST_MESSAGE_SIZE, byteCount);
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_031: [ IoTHubClient_LL_DoWork shall read events back from the message store into waitingToSend while they fit within "max_queued_messages" and "max_queued_bytes", and always when no event is queued. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_keeps_the_stored_event_that_does_not_fit_for_later)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t maxMessages = 1;
+    uint64_t recordId0 = 0;
+    uint64_t recordId1 = 1;
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MAX_QUEUED_MESSAGES, &maxMessages);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_STORE_PATH, TEST_MESSAGE_STORE_PATH);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(message_store_read(TEST_MESSAGE_STORE_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_recordId(&recordId0, sizeof(recordId0))
+        .SetReturn(TEST_DEVICEMESSAGE_HANDLE);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_DEVICEMESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_Diagnostic_AddIfNecessary(IGNORED_PTR_ARG, TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_store_read(TEST_MESSAGE_STORE_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_recordId(&recordId1, sizeof(recordId1))
+        .SetReturn(TEST_DEVICEMESSAGE_HANDLE_2);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_DEVICEMESSAGE_HANDLE_2));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_DEVICEMESSAGE_HANDLE_2, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, handle))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(message_store_sync(TEST_MESSAGE_STORE_HANDLE));
+
+    /*the event kept aside is not read again*/
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_DEVICEMESSAGE_HANDLE_2));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_DEVICEMESSAGE_HANDLE_2, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, handle))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(message_store_sync(TEST_MESSAGE_STORE_HANDLE));
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_034: [ Once an event read back from the message store is confirmed, it shall be completed with message_store_complete, unless the result is IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY: the event is then sent again the next time the store is opened. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_completes_the_stored_event)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t recordId = 0;
+    DLIST_ENTRY completed;
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_STORE_PATH, TEST_MESSAGE_STORE_PATH);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    STRICT_EXPECTED_CALL(message_store_read(TEST_MESSAGE_STORE_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_recordId(&recordId, sizeof(recordId))
+        .SetReturn(TEST_DEVICEMESSAGE_HANDLE_2);
+    IoTHubClient_LL_DoWork(handle);
+
+    /*the transport takes the message and confirms it*/
+    real_DList_InitializeListHead(&completed);
+    real_DList_InsertTailList(&completed, real_DList_RemoveHeadList(test_waitingToSend));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_store_complete(TEST_MESSAGE_STORE_HANDLE, 0));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_DEVICEMESSAGE_HANDLE_2));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_LL_SendComplete(handle, &completed, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_11_036: [ IoTHubClient_LL_Destroy shall complete with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY the events still in the message store, call message_store_close and leave the events on disk. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Destroy_with_stored_events_closes_the_message_store)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_STORE_PATH, TEST_MESSAGE_STORE_PATH);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unregister(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG)); /*because there is one stored event*/
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, (void*)1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_store_close(TEST_MESSAGE_STORE_HANDLE));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_destroy(IGNORED_PTR_ARG));
+
+#ifndef DONT_USE_UPLOADTOBLOB
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadToBlob_Destroy(IGNORED_PTR_ARG));
+#endif
+
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_LL_Destroy(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+#endif // DONT_USE_MESSAGE_STORE
+
+#ifndef DONT_USE_UPLOADTOBLOB
+/*Tests_SRS_IOTHUBCLIENT_LL_02_061: [ If iotHubClientHandle is NULL then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_with_NULL_handle_fails)
+{
+    //arrange
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob(NULL, "irrelevantFileName", (const unsigned char*)"a", 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+
+    ///cleanup
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_062: [ If destinationFileName is NULL then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_with_NULL_fileName_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob(h, NULL, (const unsigned char*)"a", 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_063: [ If source is NULL and size is greater than 0 then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_with_NULL_source_and_size_greater_than_0_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob(h, "someFileName.txt", NULL, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_99_005: [** If `iotHubClientHandle` is `NULL` then `IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleBlocksToBlob_with_NULL_handle_fails)
+{
+    //arrange
+    unsigned int context = 1;
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadMultipleBlocksToBlob(NULL, "irrelevantFileName", my_FileUpload_GetData_Callback, &context);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+
+    ///cleanup
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_99_006: [ If `destinationFileName` is `NULL` then `IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleBlocksToBlob_with_NULL_filename_fails)
+{
+    //arrange
     unsigned int context = 1;
     IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
@@ -4050,9 +5131,6 @@ TEST_FUNCTION(IoTHubClient_LL_DoWork_SendReportedState_succeed)
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*_DoWork will ask "what's the time"*/
-        .IgnoreAllArguments();
-
     STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_ProcessItem(IGNORED_PTR_ARG, IOTHUB_TYPE_DEVICE_TWIN, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument_item_type()
@@ -4087,10 +5165,6 @@ TEST_FUNCTION(IoTHubClient_LL_DoWork_SendReportedState_continue_processing_succe
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*_DoWork will ask "what's the time"*/
-        .IgnoreArgument_tick_counter()
-        .IgnoreArgument_current_ms();
-
     STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_ProcessItem(IGNORED_PTR_ARG, IOTHUB_TYPE_DEVICE_TWIN, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument_item_type()
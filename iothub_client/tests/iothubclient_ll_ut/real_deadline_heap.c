@@ -0,0 +1,14 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#define deadline_heap_create real_deadline_heap_create
+#define deadline_heap_destroy real_deadline_heap_destroy
+#define deadline_heap_add real_deadline_heap_add
+#define deadline_heap_remove real_deadline_heap_remove
+#define deadline_heap_pop_expired real_deadline_heap_pop_expired
+#define deadline_heap_peek_deadline real_deadline_heap_peek_deadline
+#define deadline_heap_get_count real_deadline_heap_get_count
+
+#define GBALLOC_H
+
+#include "../../src/deadline_heap.c"
@@ -0,0 +1,13 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#define double_buffer_create real_double_buffer_create
+#define double_buffer_destroy real_double_buffer_destroy
+#define double_buffer_push real_double_buffer_push
+#define double_buffer_get_count real_double_buffer_get_count
+#define double_buffer_swap real_double_buffer_swap
+#define double_buffer_get_element real_double_buffer_get_element
+
+#define GBALLOC_H
+
+#include "../../src/double_buffer.c"
@@ -0,0 +1,306 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures the allocations and the time taken by the life of a telemetry message: it is created,
+// given its system and user properties, cloned when it is queued and read back by the transport.
+// Then measures the memory taken by a large message sent to many devices, each one cloning it, and
+// the rate at which a gateway can stamp its routing properties on the messages it forwards.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/map.h"
+
+#include "iothub_message.h"
+
+#define MESSAGE_COUNT       100000
+#define LARGE_PAYLOAD_SIZE  (100 * 1024)
+#define FAN_OUT_COUNT       16
+
+#define ROUTED_MESSAGE_COUNT 200000
+
+static const size_t PROPERTY_COUNTS[] = { 0, 1, 5 };
+
+/* the kind of properties a gateway adds to each message it forwards, with their usual sizes */
+static const char* const ROUTING_PROPERTIES[][2] =
+{
+    { "gatewayId", "edge-gateway-building-42" },
+    { "sourceModule", "opcua-publisher" },
+    { "sourceDeviceId", "plc-line3-station07" },
+    { "sourceEndpoint", "opc.tcp://10.12.4.31:4840/freeopcua/server" },
+    { "nodeId", "ns=2;s=Line3.Station07.Spindle.Temperature" },
+    { "messageSchema", "telemetry-v2" },
+    { "schemaVersion", "2.4.1" },
+    { "routeId", "route-hot-path-temperature" },
+    { "enqueuedTimeUtc", "2017-11-20T10:15:27.1234567Z" },
+    { "traceParent", "00-0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331-01" },
+    { "site", "munich-plant-2" },
+    { "tenant", "contoso-manufacturing" },
+    { "priority", "normal" },
+    { "retention", "P30D" },
+    { "batchSequence", "000000000123456" },
+    { "correlationKey", "3f2504e0-4f89-11d3-9a0c-0305e82c3301" }
+};
+
+#define ROUTING_PROPERTY_COUNT (sizeof(ROUTING_PROPERTIES) / sizeof(ROUTING_PROPERTIES[0]))
+
+static int run_message_life(size_t property_count)
+{
+    int result = 0;
+    IOTHUB_MESSAGE_HANDLE message;
+
+    if ((message = IoTHubMessage_CreateFromString("{\"temperature\":21.5}")) == NULL)
+    {
+        (void)printf("Failed creating the message\r\n");
+        result = __LINE__;
+    }
+    else
+    {
+        if ((IoTHubMessage_SetMessageId(message, "3f2504e0-4f89-11d3-9a0c-0305e82c3301") != IOTHUB_MESSAGE_OK) ||
+            (IoTHubMessage_SetCorrelationId(message, "9a0c0305e82c3301") != IOTHUB_MESSAGE_OK) ||
+            (IoTHubMessage_SetContentTypeSystemProperty(message, "application%2Fjson") != IOTHUB_MESSAGE_OK) ||
+            (IoTHubMessage_SetContentEncodingSystemProperty(message, "utf-8") != IOTHUB_MESSAGE_OK))
+        {
+            (void)printf("Failed setting the system properties\r\n");
+            result = __LINE__;
+        }
+        else
+        {
+            size_t index;
+
+            for (index = 0; index < property_count && result == 0; index++)
+            {
+                char key[32];
+                char value[32];
+                (void)sprintf(key, "property%lu", (unsigned long)index);
+                (void)sprintf(value, "value%lu", (unsigned long)index);
+                if (Map_AddOrUpdate(IoTHubMessage_Properties(message), key, value) != MAP_OK)
+                {
+                    (void)printf("Failed adding a message property\r\n");
+                    result = __LINE__;
+                }
+            }
+        }
+
+        if (result == 0)
+        {
+            IOTHUB_MESSAGE_HANDLE queued;
+
+            /* IoTHubClient_LL_SendEventAsync clones the message before queuing it */
+            if ((queued = IoTHubMessage_Clone(message)) == NULL)
+            {
+                (void)printf("Failed cloning the message\r\n");
+                result = __LINE__;
+            }
+            else
+            {
+                const unsigned char* payload;
+                size_t payload_size;
+                const char* const* keys;
+                const char* const* values;
+                size_t count;
+                MAP_HANDLE properties;
+
+                /* the transports read the payload, the system properties and the user properties */
+                if ((IoTHubMessage_GetByteArray(queued, &payload, &payload_size) != IOTHUB_MESSAGE_OK) ||
+                    (IoTHubMessage_GetMessageId(queued) == NULL) ||
+                    (IoTHubMessage_GetCorrelationId(queued) == NULL) ||
+                    ((properties = IoTHubMessage_Properties(queued)) == NULL) ||
+                    (Map_GetInternals(properties, &keys, &values, &count) != MAP_OK) ||
+                    (count != property_count))
+                {
+                    (void)printf("Failed reading the queued message\r\n");
+                    result = __LINE__;
+                }
+                IoTHubMessage_Destroy(queued);
+            }
+        }
+
+        IoTHubMessage_Destroy(message);
+    }
+
+    return result;
+}
+
+static int run_property_count(TICK_COUNTER_HANDLE tick_counter, size_t property_count)
+{
+    int result = 0;
+    size_t index;
+    size_t allocation_count;
+    tickcounter_ms_t start_ms;
+    tickcounter_ms_t end_ms;
+
+    /* the first message counts the allocations, the others are timed */
+    gballoc_resetMetrics();
+    result = run_message_life(property_count);
+    allocation_count = gballoc_getAllocationCount();
+
+    (void)tickcounter_get_current_ms(tick_counter, &start_ms);
+    for (index = 0; index < MESSAGE_COUNT && result == 0; index++)
+    {
+        result = run_message_life(property_count);
+    }
+    (void)tickcounter_get_current_ms(tick_counter, &end_ms);
+
+    if (result == 0)
+    {
+        (void)printf("%12lu %20lu %20.0f\r\n", (unsigned long)property_count, (unsigned long)allocation_count,
+            (double)MESSAGE_COUNT * 1000.0 / (double)((end_ms - start_ms) == 0 ? 1 : (end_ms - start_ms)));
+    }
+
+    return result;
+}
+
+static int run_fan_out(void)
+{
+    int result = 0;
+    unsigned char* payload;
+    IOTHUB_MESSAGE_HANDLE message;
+
+    if ((payload = (unsigned char*)calloc(1, LARGE_PAYLOAD_SIZE)) == NULL)
+    {
+        (void)printf("Failed allocating the payload\r\n");
+        result = __LINE__;
+    }
+    else
+    {
+        gballoc_resetMetrics();
+        if ((message = IoTHubMessage_CreateFromByteArray(payload, LARGE_PAYLOAD_SIZE)) == NULL)
+        {
+            (void)printf("Failed creating the message\r\n");
+            result = __LINE__;
+        }
+        else
+        {
+            IOTHUB_MESSAGE_HANDLE clones[FAN_OUT_COUNT];
+            size_t clone_count;
+
+            (void)Map_AddOrUpdate(IoTHubMessage_Properties(message), "camera", "front");
+            for (clone_count = 0; clone_count < FAN_OUT_COUNT && result == 0; clone_count++)
+            {
+                if ((clones[clone_count] = IoTHubMessage_Clone(message)) == NULL)
+                {
+                    (void)printf("Failed cloning the message\r\n");
+                    result = __LINE__;
+                    break;
+                }
+            }
+
+            if (result == 0)
+            {
+                (void)printf("%lu clones of a %lu bytes message: %lu allocations, %lu bytes at most\r\n",
+                    (unsigned long)FAN_OUT_COUNT, (unsigned long)LARGE_PAYLOAD_SIZE,
+                    (unsigned long)gballoc_getAllocationCount(), (unsigned long)gballoc_getMaximumMemoryUsed());
+            }
+
+            while (clone_count > 0)
+            {
+                IoTHubMessage_Destroy(clones[--clone_count]);
+            }
+            IoTHubMessage_Destroy(message);
+        }
+        free(payload);
+    }
+
+    return result;
+}
+
+static int run_routing_properties(TICK_COUNTER_HANDLE tick_counter)
+{
+    int result = 0;
+    IOTHUB_MESSAGE_PROPERTY properties[ROUTING_PROPERTY_COUNT];
+    size_t property_bytes = 0;
+    size_t index;
+    IOTHUB_MESSAGE_HANDLE message;
+
+    for (index = 0; index < ROUTING_PROPERTY_COUNT; index++)
+    {
+        properties[index].key = ROUTING_PROPERTIES[index][0];
+        properties[index].keyLength = strlen(ROUTING_PROPERTIES[index][0]);
+        properties[index].value = ROUTING_PROPERTIES[index][1];
+        properties[index].valueLength = strlen(ROUTING_PROPERTIES[index][1]);
+        property_bytes += properties[index].keyLength + properties[index].valueLength;
+    }
+
+    if ((message = IoTHubMessage_CreateFromString("{\"temperature\":21.5}")) == NULL)
+    {
+        (void)printf("Failed creating the message\r\n");
+        result = __LINE__;
+    }
+    else
+    {
+        tickcounter_ms_t start_ms;
+        tickcounter_ms_t end_ms;
+
+        /* each call checks that all the keys and values are printable US-ASCII before copying them */
+        (void)tickcounter_get_current_ms(tick_counter, &start_ms);
+        for (index = 0; index < ROUTED_MESSAGE_COUNT && result == 0; index++)
+        {
+            if (IoTHubMessage_SetProperties(message, properties, ROUTING_PROPERTY_COUNT) != IOTHUB_MESSAGE_OK)
+            {
+                (void)printf("Failed setting the routing properties\r\n");
+                result = __LINE__;
+            }
+        }
+        (void)tickcounter_get_current_ms(tick_counter, &end_ms);
+
+        if (result == 0)
+        {
+            double seconds = (double)((end_ms - start_ms) == 0 ? 1 : (end_ms - start_ms)) / 1000.0;
+            (void)printf("%lu routing properties of %lu bytes in all: %.0f messages/sec, %.1f MB/sec of keys and values\r\n",
+                (unsigned long)ROUTING_PROPERTY_COUNT, (unsigned long)property_bytes,
+                (double)ROUTED_MESSAGE_COUNT / seconds, (double)ROUTED_MESSAGE_COUNT * (double)property_bytes / seconds / (1024.0 * 1024.0));
+        }
+
+        IoTHubMessage_Destroy(message);
+    }
+
+    return result;
+}
+
+int main(void)
+{
+    int result = 0;
+    TICK_COUNTER_HANDLE tick_counter;
+
+    if (gballoc_init() != 0)
+    {
+        (void)printf("Failed initializing gballoc\r\n");
+        result = __LINE__;
+    }
+    else
+    {
+        if ((tick_counter = tickcounter_create()) == NULL)
+        {
+            (void)printf("Failed creating tick counter\r\n");
+            result = __LINE__;
+        }
+        else
+        {
+            size_t index;
+
+            (void)printf("%lu messages created, cloned and read back\r\n", (unsigned long)MESSAGE_COUNT);
+            (void)printf("%12s %20s %20s\r\n", "properties", "allocations/message", "messages/sec");
+            for (index = 0; index < sizeof(PROPERTY_COUNTS) / sizeof(PROPERTY_COUNTS[0]) && result == 0; index++)
+            {
+                result = run_property_count(tick_counter, PROPERTY_COUNTS[index]);
+            }
+            if (result == 0)
+            {
+                result = run_fan_out();
+            }
+            if (result == 0)
+            {
+                result = run_routing_properties(tick_counter);
+            }
+
+            tickcounter_destroy(tick_counter);
+        }
+
+        gballoc_deinit();
+    }
+
+    return result;
+}
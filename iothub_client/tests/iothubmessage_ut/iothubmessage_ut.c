@@ -5,10 +5,12 @@
 #include <cstdlib>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #else
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #endif
 
 #include "testrunnerswitcher.h"
@@ -30,32 +32,13 @@ static void my_gballoc_free(void* ptr)
 #define ENABLE_MOCKS
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/optimize_size.h"
-#include "azure_c_shared_utility/buffer_.h"
-#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/lock.h"
 #include "azure_c_shared_utility/map.h"
 
 #undef ENABLE_MOCKS
 
 #include "iothub_message.h"
-#include "real_strings.h"
-
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-    extern BUFFER_HANDLE real_BUFFER_new(void);
-    extern void real_BUFFER_delete(BUFFER_HANDLE handle);
-    extern unsigned char* real_BUFFER_u_char(BUFFER_HANDLE handle);
-    extern size_t real_BUFFER_length(BUFFER_HANDLE handle);
-    extern int real_BUFFER_build(BUFFER_HANDLE handle, const unsigned char* source, size_t size);
-    extern int real_BUFFER_append_build(BUFFER_HANDLE handle, const unsigned char* source, size_t size);
-    extern BUFFER_HANDLE real_BUFFER_clone(BUFFER_HANDLE handle);
-    extern BUFFER_HANDLE real_BUFFER_create(const unsigned char* source, size_t size);
-
-#ifdef __cplusplus
-}
-#endif
 
 #define NUMBER_OF_CHAR      8
 
@@ -71,9 +54,15 @@ static const char* TEST_INVALID_MAP_KEY = "Inval\nd_key";
 static const char* TEST_INVALID_MAP_VALUE = "Inval\nd_value";
 static const char* TEST_CONTENT_TYPE = "text/plain";
 static const char* TEST_CONTENT_ENCODING = "utf8";
+/*too long to be kept inside the message*/
+#define TEST_LONG_LITERAL "0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF-long"
+static const char* TEST_LONG_VALUE = TEST_LONG_LITERAL;
+
+static const IOTHUB_MESSAGE_PROPERTY TEST_PROPERTIES[] = { { "key1", 4, "value1", 6 }, { "k2", 2, "v2", 2 } };
 
 static IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA TEST_DIAGNOSTIC_DATA = { "12345678",  "1506054179"};
 static IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA TEST_DIAGNOSTIC_DATA2 = { "87654321", "1506054179.100" };
+static IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA TEST_LONG_DIAGNOSTIC_DATA = { TEST_LONG_LITERAL, TEST_LONG_LITERAL };
 
 TEST_DEFINE_ENUM_TYPE(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_RESULT_VALUES);
 IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_RESULT_VALUES);
@@ -107,6 +96,19 @@ static void my_Map_Destroy(MAP_HANDLE handle)
     my_gballoc_free(handle);
 }
 
+static const char* g_mapKeys[] = { "key1", "k2" };
+static const char* g_mapValues[] = { "value1", "v2" };
+static size_t g_mapCount;
+
+static MAP_RESULT my_Map_GetInternals(MAP_HANDLE handle, const char*const** keys, const char*const** values, size_t* count)
+{
+    (void)handle;
+    *keys = g_mapKeys;
+    *values = g_mapValues;
+    *count = g_mapCount;
+    return MAP_OK;
+}
+
 static int my_mallocAndStrcpy_s(char** destination, const char* source)
 {
     *destination = (char*)my_gballoc_malloc(strlen(source)+1);
@@ -114,6 +116,17 @@ static int my_mallocAndStrcpy_s(char** destination, const char* source)
     return 0;
 }
 
+static unsigned char* g_releasedBuffer;
+static void* g_releasedContext;
+static size_t g_releaseCount;
+
+static void test_release_buffer(unsigned char* buffer, void* context)
+{
+    g_releasedBuffer = buffer;
+    g_releasedContext = context;
+    g_releaseCount++;
+}
+
 static TEST_MUTEX_HANDLE g_testByTest;
 static TEST_MUTEX_HANDLE g_dllByDll;
 
@@ -135,28 +148,13 @@ TEST_SUITE_INITIALIZE(suite_init)
     //ASSERT_ARE_EQUAL(int, 0, result);
 
     REGISTER_UMOCK_ALIAS_TYPE(MAP_FILTER_CALLBACK, void*);
-    REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
-    REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
 
-    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_new, real_BUFFER_new);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_new, NULL);
-    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_create, real_BUFFER_create);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_create, NULL);
-    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_delete, real_BUFFER_delete);
-    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_build, real_BUFFER_build);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_build, __LINE__);
-    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, real_BUFFER_u_char);
-    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_length, real_BUFFER_length);
-    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_clone, real_BUFFER_clone);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_clone, NULL);
-
-    REGISTER_STRING_GLOBAL_MOCK_HOOK;
-
     REGISTER_GLOBAL_MOCK_HOOK(Map_Create, my_Map_Create);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(Map_Create, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(Map_Clone, my_Map_Clone);
@@ -164,6 +162,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(Map_Destroy, my_Map_Destroy);
     REGISTER_GLOBAL_MOCK_RETURN(Map_AddOrUpdate, MAP_OK);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(Map_AddOrUpdate, MAP_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(Map_GetInternals, my_Map_GetInternals);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Map_GetInternals, MAP_ERROR);
 
     REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __FAILURE__);
@@ -186,6 +186,10 @@ TEST_FUNCTION_INITIALIZE(method_init)
     umock_c_reset_all_calls();
 
     g_mapFilterFunc = NULL;
+    g_mapCount = 0;
+    g_releasedBuffer = NULL;
+    g_releasedContext = NULL;
+    g_releaseCount = 0;
 }
 
 TEST_FUNCTION_CLEANUP(method_cleanup)
@@ -207,8 +211,7 @@ static int should_skip_index(size_t current_index, const size_t skip_array[], si
     return result;
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_02_022: [IoTHubMessage_CreateFromByteArray shall call BUFFER_create passing byteArray and size as parameters.]*/
-/*Tests_SRS_IOTHUBMESSAGE_02_023: [IoTHubMessage_CreateFromByteArray shall call Map_Create to create the message properties.]*/
+/*Tests_SRS_IOTHUBMESSAGE_11_001: [ IoTHubMessage_CreateFromByteArray shall allocate the message and a copy of byteArray in a single block. ]*/
 /*Tests_SRS_IOTHUBMESSAGE_02_025: [Otherwise, IoTHubMessage_CreateFromByteArray shall return a non-NULL handle.] */
 /*Tests_SRS_IOTHUBMESSAGE_02_026: [The type of the new message shall be IOTHUBMESSAGE_BYTEARRAY.] */
 /*Tests_SRS_IOTHUBMESSAGE_02_009: [Otherwise IoTHubMessage_GetContentType shall return the type of the message.] */
@@ -216,8 +219,6 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_happy_path)
 {
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_create(c, 1));
-    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     //act
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
@@ -251,8 +252,6 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_succeeds_when_size_0_and_buffer_
 {
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     //act
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(NULL, 0);
@@ -270,8 +269,6 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_succeeds_when_size_0_and_buffer_
 {
     //arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     //act
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 0);
@@ -292,8 +289,6 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_fails)
 
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_create(c, 1));
-    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     umock_c_negative_tests_snapshot();
 
@@ -317,8 +312,123 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_fails)
     umock_c_negative_tests_deinit();
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_02_027: [IoTHubMessage_CreateFromString shall call STRING_construct passing source as parameter.] */
-/*Tests_SRS_IOTHUBMESSAGE_02_028: [IoTHubMessage_CreateFromString shall call Map_Create to create the message properties.] */
+/*Tests_SRS_IOTHUBMESSAGE_11_016: [ IoTHubMessage_CreateFromBufferNoCopy shall allocate a message of type IOTHUBMESSAGE_BYTEARRAY whose payload is buffer itself, without copying it. ]*/
+TEST_FUNCTION(IoTHubMessage_CreateFromBufferNoCopy_happy_path)
+{
+    // arrange
+    unsigned char buffer[] = { 1, 2, 3 };
+    const unsigned char* byteArray;
+    size_t size;
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBufferNoCopy(buffer, sizeof(buffer), test_release_buffer, (void*)0x4242);
+
+    //assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_BYTEARRAY, IoTHubMessage_GetContentType(h));
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_GetByteArray(h, &byteArray, &size));
+    ASSERT_ARE_EQUAL(void_ptr, buffer, byteArray);
+    ASSERT_ARE_EQUAL(size_t, sizeof(buffer), size);
+    ASSERT_ARE_EQUAL(size_t, 0, g_releaseCount);
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_015: [ If buffer is NULL and size is not zero, IoTHubMessage_CreateFromBufferNoCopy shall fail and return NULL. ]*/
+TEST_FUNCTION(IoTHubMessage_CreateFromBufferNoCopy_fails_when_size_non_zero_buffer_NULL)
+{
+    //arrange
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBufferNoCopy(NULL, 1, test_release_buffer, NULL);
+
+    //assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_releaseCount);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_017: [ If the allocation fails, IoTHubMessage_CreateFromBufferNoCopy shall return NULL without calling releaseCallback. ]*/
+TEST_FUNCTION(IoTHubMessage_CreateFromBufferNoCopy_fails)
+{
+    // arrange
+    unsigned char buffer[] = { 1, 2, 3 };
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBufferNoCopy(buffer, sizeof(buffer), test_release_buffer, NULL);
+
+    //assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_releaseCount);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_018: [ The buffer shall be given to releaseCallback, along with context, once the message and all the clones sharing it are destroyed. ]*/
+TEST_FUNCTION(IoTHubMessage_Destroy_releases_the_buffer_of_a_message_created_without_copy)
+{
+    // arrange
+    unsigned char buffer[] = { 1, 2, 3 };
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBufferNoCopy(buffer, sizeof(buffer), test_release_buffer, (void*)0x4242);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(h));
+
+    //act
+    IoTHubMessage_Destroy(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, g_releaseCount);
+    ASSERT_ARE_EQUAL(void_ptr, buffer, g_releasedBuffer);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x4242, g_releasedContext);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_018: [ The buffer shall be given to releaseCallback, along with context, once the message and all the clones sharing it are destroyed. ]*/
+TEST_FUNCTION(IoTHubMessage_Destroy_releases_the_buffer_once_the_last_clone_is_destroyed)
+{
+    // arrange
+    unsigned char buffer[] = { 1, 2, 3 };
+    const unsigned char* byteArray;
+    size_t size;
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBufferNoCopy(buffer, sizeof(buffer), test_release_buffer, NULL);
+    IOTHUB_MESSAGE_HANDLE clone = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    //act
+    IoTHubMessage_Destroy(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 0, g_releaseCount);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_GetByteArray(clone, &byteArray, &size));
+    ASSERT_ARE_EQUAL(void_ptr, buffer, byteArray);
+
+    IoTHubMessage_Destroy(clone);
+    ASSERT_ARE_EQUAL(size_t, 1, g_releaseCount);
+    ASSERT_ARE_EQUAL(void_ptr, buffer, g_releasedBuffer);
+}
+
+TEST_FUNCTION(IoTHubMessage_Destroy_of_a_message_borrowing_a_buffer_without_release_callback_succeeds)
+{
+    // arrange
+    unsigned char buffer[] = { 1, 2, 3 };
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBufferNoCopy(buffer, sizeof(buffer), NULL, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(h));
+
+    //act
+    IoTHubMessage_Destroy(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_002: [ IoTHubMessage_CreateFromString shall allocate the message and a copy of source, including its terminating null character, in a single block. ]*/
 /*Tests_SRS_IOTHUBMESSAGE_02_031: [Otherwise, IoTHubMessage_CreateFromString shall return a non-NULL handle.] */
 /*Tests_SRS_IOTHUBMESSAGE_02_032: [The type of the new message shall be IOTHUBMESSAGE_STRING.] */
 /*Tests_SRS_IOTHUBMESSAGE_02_009: [Otherwise IoTHubMessage_GetContentType shall return the type of the message.] */
@@ -326,8 +436,6 @@ TEST_FUNCTION(IoTHubMessage_CreateFromString_happy_path)
 {
     //arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(STRING_construct("a"));
-    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     //act
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString("a");
@@ -364,8 +472,6 @@ TEST_FUNCTION(IoTHubMessage_CreateFromString_fails)
 
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(STRING_construct("a"));
-    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     umock_c_negative_tests_snapshot();
 
@@ -393,6 +499,7 @@ TEST_FUNCTION(IoTHubMessage_Map_Filter_validate_Ascii_char_SUCCEED)
 {
     //arrange
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_Properties(h);
     umock_c_reset_all_calls();
 
     //act
@@ -410,6 +517,7 @@ TEST_FUNCTION(IoTHubMessage_Map_Filter_invalidate_Ascii_key_fail)
 {
     //arrange
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_Properties(h);
     umock_c_reset_all_calls();
 
     //act
@@ -427,6 +535,7 @@ TEST_FUNCTION(IoTHubMessage_Map_Filter_invalidate_Ascii_value_fail)
 {
     //arrange
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_Properties(h);
     umock_c_reset_all_calls();
 
     //act
@@ -459,15 +568,9 @@ TEST_FUNCTION(IoTHubMessage_Destroy_destroys_a_BYTEARRAY_IoTHubMEssage)
 {
     // arrange
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(h));
 
     //act
@@ -484,14 +587,29 @@ TEST_FUNCTION(IoTHubMessage_Destroy_destroys_a_STRING_IoTHubMessage)
 {
     // arrange
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_Properties(h);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(h));
+
+    //act
+    IoTHubMessage_Destroy(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_01_003: [IoTHubMessage_Destroy shall free all resources associated with iotHubMessageHandle.]  */
+TEST_FUNCTION(IoTHubMessage_Destroy_frees_the_system_properties_not_kept_inside_the_message)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_SetMessageId(h, TEST_LONG_VALUE);
+    umock_c_reset_all_calls();
+
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(h));
 
@@ -504,8 +622,49 @@ TEST_FUNCTION(IoTHubMessage_Destroy_destroys_a_STRING_IoTHubMessage)
     //cleanup
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_01_011: [The pointer shall be obtained by using BUFFER_u_char and it shall be copied in the buffer argument.]*/
-/*Tests_SRS_IOTHUBMESSAGE_01_012: [The size of the associated data shall be obtained by using BUFFER_length and it shall be copied to the size argument.]*/
+/*Tests_SRS_IOTHUBMESSAGE_11_014: [ The block of a message shall be freed once the message and all the clones sharing its payload are destroyed. ]*/
+TEST_FUNCTION(IoTHubMessage_Destroy_keeps_the_payload_shared_with_a_clone)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    IOTHUB_MESSAGE_HANDLE clone = IoTHubMessage_Clone(h);
+    const unsigned char* byteArray;
+    size_t size;
+    umock_c_reset_all_calls();
+
+    //act
+    IoTHubMessage_Destroy(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_GetByteArray(clone, &byteArray, &size));
+    ASSERT_ARE_EQUAL(size_t, 1, size);
+    ASSERT_ARE_EQUAL(uint8_t, c[0], byteArray[0]);
+
+    //cleanup
+    IoTHubMessage_Destroy(clone);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_014: [ The block of a message shall be freed once the message and all the clones sharing its payload are destroyed. ]*/
+TEST_FUNCTION(IoTHubMessage_Destroy_of_the_last_clone_frees_the_shared_payload)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    IOTHUB_MESSAGE_HANDLE clone = IoTHubMessage_Clone(h);
+    IoTHubMessage_Destroy(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(h));
+    STRICT_EXPECTED_CALL(gballoc_free(clone));
+
+    //act
+    IoTHubMessage_Destroy(clone);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_007: [ IoTHubMessage_GetByteArray shall return in buffer and size the payload kept in the message and its size. ]*/
 /*Tests_SRS_IOTHUBMESSAGE_02_033: [IoTHubMessage_GetByteArray shall return IOTHUBMESSAGE_OK when all oeprations complete succesfully.] */
 TEST_FUNCTION(IoTHubMessage_GetByteArray_happy_path)
 {
@@ -515,9 +674,6 @@ TEST_FUNCTION(IoTHubMessage_GetByteArray_happy_path)
     size_t size;
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
-
     //act
     IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(h, &byteArray, &size);
 
@@ -527,183 +683,1025 @@ TEST_FUNCTION(IoTHubMessage_GetByteArray_happy_path)
     ASSERT_ARE_EQUAL(size_t, 1, size);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    ///cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_01_014: [If any of the arguments passed to IoTHubMessage_GetByteArray  is NULL IoTHubMessage_GetByteArray shall return IOTHUBMESSAGE_INVALID_ARG.] */
+TEST_FUNCTION(IoTHubMessage_GetByteArray_with_NULL_handle_fails)
+{
+    //arrange
+    const unsigned char* byteArray;
+    size_t size;
+
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(NULL, &byteArray, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_01_014: [If any of the arguments passed to IoTHubMessage_GetByteArray  is NULL IoTHubMessage_GetByteArray shall return IOTHUBMESSAGE_INVALID_ARG.] */
+TEST_FUNCTION(IoTHubMessage_GetByteArray_with_NULL_byteArray_fails)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    size_t size;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(h, NULL, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_02_021: [If iotHubMessageHandle is not a iothubmessage containing BYTEARRAY data, then IoTHubMessage_GetByteArray  shall return IOTHUBMESSAGE_INVALID_ARG.]*/
+TEST_FUNCTION(IoTHubMessage_GetByteArray_with_STRING_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    const unsigned char* byteArray;
+    size_t size;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(h, &byteArray, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_03_001: [IoTHubMessage_Clone shall create a new IoT hub message with data content identical to that of the iotHubMessageHandle parameter.]*/
+/*Tests_SRS_IOTHUBMESSAGE_11_005: [ IoTHubMessage_Clone shall copy in a single block the message and the system properties kept inside it; the system properties kept in their own allocation shall be copied with mallocAndStrcpy_s. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_11_011: [ IoTHubMessage_Clone shall share the payload of the source message instead of copying it. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_03_002: [IoTHubMessage_Clone shall return upon success a non-NULL handle to the newly created IoT hub message.]*/
+TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_happy_path)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    const unsigned char* byteArray;
+    size_t size;
+    const unsigned char* sourceByteArray;
+    size_t sourceSize;
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_GetByteArray(r, &byteArray, &size));
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_GetByteArray(h, &sourceByteArray, &sourceSize));
+    ASSERT_ARE_EQUAL(size_t, 1, size);
+    ASSERT_ARE_EQUAL(uint8_t, c[0], byteArray[0]);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)sourceByteArray, (void*)byteArray);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID, IoTHubMessage_GetMessageId(r));
+    ASSERT_ARE_NOT_EQUAL(void_ptr, (void*)IoTHubMessage_GetMessageId(h), (void*)IoTHubMessage_GetMessageId(r));
+
+    ///cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubMessage_Clone_handle_NULL_fail)
+{
+    //arrange
+
+
+    //act
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(NULL);
+
+    //assert
+    ASSERT_IS_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
+TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessage_Clone failure in test %zu/%zu", index, count);
+
+        IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+        //assert
+        ASSERT_IS_NULL_WITH_MSG(r, tmp_msg);
+    }
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_03_001: [IoTHubMessage_Clone shall create a new IoT hub message with data content identical to that of the iotHubMessageHandle parameter.]*/
+/*Tests_SRS_IOTHUBMESSAGE_11_005: [ IoTHubMessage_Clone shall copy in a single block the message and the system properties kept inside it; the system properties kept in their own allocation shall be copied with mallocAndStrcpy_s. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_11_011: [ IoTHubMessage_Clone shall share the payload of the source message instead of copying it. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_11_019: [ If the map of the source message was handed out by IoTHubMessage_Properties, IoTHubMessage_Clone shall not share the properties, since the caller can still change the map, and shall give the clone its own property table made from the map with Map_GetInternals. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_03_002: [IoTHubMessage_Clone shall return upon success a non-NULL handle to the newly created IoT hub message.]*/
+TEST_FUNCTION(IoTHubMessage_Clone_with_STRING_happy_path)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_Properties(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    ///act
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_STRING_VALUE, IoTHubMessage_GetString(r));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)IoTHubMessage_GetString(h), (void*)IoTHubMessage_GetString(r));
+
+    ///cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
+TEST_FUNCTION(IoTHubMessage_Clone_with_STRING_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_Properties(h);
+    umock_c_reset_all_calls();
+
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessage_Clone_w_string failure in test %zu/%zu", index, count);
+
+        IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+        //assert
+        ASSERT_IS_NULL_WITH_MSG(r, tmp_msg);
+    }
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_005: [ IoTHubMessage_Clone shall copy in a single block the message and the system properties kept inside it; the system properties kept in their own allocation shall be copied with mallocAndStrcpy_s. ]*/
+TEST_FUNCTION(IoTHubMessage_Clone_copies_the_system_properties_not_kept_inside_the_message)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_SetMessageId(h, TEST_LONG_VALUE);
+    (void)IoTHubMessage_SetCorrelationId(h, TEST_MESSAGE_ID2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_LONG_VALUE));
+
+    ///act
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_LONG_VALUE, IoTHubMessage_GetMessageId(r));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID2, IoTHubMessage_GetCorrelationId(r));
+
+    ///cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
+TEST_FUNCTION(IoTHubMessage_Clone_with_system_properties_not_kept_inside_the_message_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_SetMessageId(h, TEST_LONG_VALUE);
+    umock_c_reset_all_calls();
+
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_LONG_VALUE));
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessage_Clone failure in test %zu/%zu", index, count);
+
+        IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+        //assert
+        ASSERT_IS_NULL_WITH_MSG(r, tmp_msg);
+    }
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_02_002: [Otherwise, for any non-NULL iotHubMessageHandle it shall return a non-NULL MAP_HANDLE.] */
+/*Tests_SRS_IOTHUBMESSAGE_11_003: [ The properties map shall be created with Map_Create the first time IoTHubMessage_Properties is called. ]*/
+TEST_FUNCTION(IoTHubMessage_Properties_happy_path)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+
+    //act
+    MAP_HANDLE r = IoTHubMessage_Properties(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_003: [ The properties map shall be created with Map_Create the first time IoTHubMessage_Properties is called. ]*/
+TEST_FUNCTION(IoTHubMessage_Properties_returns_the_same_map_afterwards)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    MAP_HANDLE first = IoTHubMessage_Properties(h);
+    umock_c_reset_all_calls();
+
+    //act
+    MAP_HANDLE r = IoTHubMessage_Properties(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(void_ptr, first, r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_004: [ If Map_Create fails, IoTHubMessage_Properties shall return NULL. ]*/
+TEST_FUNCTION(IoTHubMessage_Properties_Map_Create_fails)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+        .SetReturn(NULL);
+
+    //act
+    MAP_HANDLE r = IoTHubMessage_Properties(h);
+
+    //assert
+    ASSERT_IS_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_019: [ If the map of the source message was handed out by IoTHubMessage_Properties, IoTHubMessage_Clone shall not share the properties, since the caller can still change the map, and shall give the clone its own property table made from the map with Map_GetInternals. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_11_020: [ If the properties were set with IoTHubMessage_SetProperties, IoTHubMessage_Properties shall create the map from the property table with Map_Create and Map_AddOrUpdate. ]*/
+TEST_FUNCTION(IoTHubMessage_Properties_of_a_clone_of_a_message_whose_map_was_handed_out_creates_the_map)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    MAP_HANDLE sourceProperties = IoTHubMessage_Properties(h);
+    g_mapCount = 2;
+    IOTHUB_MESSAGE_HANDLE clone = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "key1", "value1"));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "k2", "v2"));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    MAP_HANDLE r = IoTHubMessage_Properties(clone);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, sourceProperties, r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, sourceProperties, IoTHubMessage_Properties(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(clone);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_019: [ If the map of the source message was handed out by IoTHubMessage_Properties, IoTHubMessage_Clone shall not share the properties, since the caller can still change the map, and shall give the clone its own property table made from the map with Map_GetInternals. ]*/
+TEST_FUNCTION(IoTHubMessage_Properties_of_a_message_cloned_after_handing_out_its_map_returns_the_same_map)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    MAP_HANDLE sourceProperties = IoTHubMessage_Properties(h);
+    IOTHUB_MESSAGE_HANDLE clone = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    //act
+    MAP_HANDLE r = IoTHubMessage_Properties(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(void_ptr, sourceProperties, r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(clone);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_019: [ If the map of the source message was handed out by IoTHubMessage_Properties, IoTHubMessage_Clone shall not share the properties, since the caller can still change the map, and shall give the clone its own property table made from the map with Map_GetInternals. ]*/
+TEST_FUNCTION(IoTHubMessage_sent_twice_with_its_held_map_changed_in_between_sends_the_changes_only_the_second_time)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_Properties(h);
+    g_mapCount = 2;
+    IOTHUB_MESSAGE_HANDLE firstSend = IoTHubMessage_Clone(h);
+    g_mapValues[1] = "v3";
+
+    //act
+    IOTHUB_MESSAGE_HANDLE secondSend = IoTHubMessage_Clone(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(firstSend);
+    ASSERT_IS_NOT_NULL(secondSend);
+    ASSERT_ARE_EQUAL(char_ptr, "v2", IoTHubMessage_GetProperty(firstSend, "k2"));
+    ASSERT_ARE_EQUAL(char_ptr, "v3", IoTHubMessage_GetProperty(secondSend, "k2"));
+    ASSERT_ARE_EQUAL(char_ptr, "v3", IoTHubMessage_GetProperty(h, "k2"));
+
+    //cleanup
+    g_mapValues[1] = "v2";
+    IoTHubMessage_Destroy(secondSend);
+    IoTHubMessage_Destroy(firstSend);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_012: [ If the properties are shared with other messages, IoTHubMessage_Properties shall first give the message its own copy made with Map_Clone, or made from the property table when the properties were set with IoTHubMessage_SetProperties. ]*/
+TEST_FUNCTION(IoTHubMessage_Properties_of_a_source_whose_properties_are_shared_allocates_the_copy)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_SetProperties(h, TEST_PROPERTIES, 2);
+    IOTHUB_MESSAGE_HANDLE clone = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "key1", "value1"));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "k2", "v2"));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    //act
+    MAP_HANDLE r = IoTHubMessage_Properties(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "v2", IoTHubMessage_GetProperty(clone, "k2"));
+
+    //cleanup
+    IoTHubMessage_Destroy(clone);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_013: [ If the copy fails, IoTHubMessage_Properties shall return NULL. ]*/
+TEST_FUNCTION(IoTHubMessage_Properties_of_a_source_whose_properties_are_shared_fails)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_SetProperties(h, TEST_PROPERTIES, 2);
+    IOTHUB_MESSAGE_HANDLE clone = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "key1", "value1"));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "k2", "v2"));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessage_Properties failure in test %zu/%zu", index, count);
+
+        MAP_HANDLE r = IoTHubMessage_Properties(h);
+
+        //assert
+        ASSERT_IS_NULL_WITH_MSG(r, tmp_msg);
+    }
+
+    //cleanup
+    umock_c_negative_tests_deinit();
+    ASSERT_ARE_EQUAL(char_ptr, "v2", IoTHubMessage_GetProperty(h, "k2"));
+    IoTHubMessage_Destroy(clone);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_02_001: [If iotHubMessageHandle is NULL then IoTHubMessage_Properties shall return NULL.] */
+TEST_FUNCTION(IoTHubMessage_Properties_with_NULL_handle_retuns_NULL)
+{
+    //arrange
+
+    //act
+    MAP_HANDLE r = IoTHubMessage_Properties(NULL);
+
+    //assert
+    ASSERT_IS_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_020: [ If the properties were set with IoTHubMessage_SetProperties, IoTHubMessage_Properties shall create the map from the property table with Map_Create and Map_AddOrUpdate. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_11_022: [ Since the caller can change the map it returns, IoTHubMessage_Properties shall free the property table, to be made again from the map when needed. ]*/
+TEST_FUNCTION(IoTHubMessage_Properties_after_SetProperties_creates_the_map)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_SetProperties(h, TEST_PROPERTIES, 2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "key1", "value1"));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "k2", "v2"));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    MAP_HANDLE r = IoTHubMessage_Properties(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_021: [ If creating the map fails, IoTHubMessage_Properties shall return NULL and the properties shall be left unchanged. ]*/
+TEST_FUNCTION(IoTHubMessage_Properties_after_SetProperties_fails)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_SetProperties(h, TEST_PROPERTIES, 2);
+    umock_c_reset_all_calls();
+
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "key1", "value1"));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "k2", "v2"));
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessage_Properties failure in test %zu/%zu", index, count);
+
+        MAP_HANDLE r = IoTHubMessage_Properties(h);
+
+        //assert
+        ASSERT_IS_NULL_WITH_MSG(r, tmp_msg);
+        ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, "v2", IoTHubMessage_GetProperty(h, "k2"), tmp_msg);
+    }
+
+    //cleanup
+    umock_c_negative_tests_deinit();
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_012: [ If the properties are shared with other messages, IoTHubMessage_Properties shall first give the message its own copy made with Map_Clone, or made from the property table when the properties were set with IoTHubMessage_SetProperties. ]*/
+TEST_FUNCTION(IoTHubMessage_Properties_of_a_clone_sharing_a_property_table_creates_the_map)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_SetProperties(h, TEST_PROPERTIES, 2);
+    IOTHUB_MESSAGE_HANDLE clone = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "key1", "value1"));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "k2", "v2"));
+
+    //act
+    MAP_HANDLE r = IoTHubMessage_Properties(clone);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "value1", IoTHubMessage_GetProperty(h, "key1"));
+
+    //cleanup
+    IoTHubMessage_Destroy(clone);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_023: [ If iotHubMessageHandle, properties or count is NULL, IoTHubMessage_GetPropertyTable shall return IOTHUB_MESSAGE_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubMessage_GetPropertyTable_with_NULL_arguments_fails)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    const IOTHUB_MESSAGE_PROPERTY* properties;
+    size_t count;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT r1 = IoTHubMessage_GetPropertyTable(NULL, &properties, &count);
+    IOTHUB_MESSAGE_RESULT r2 = IoTHubMessage_GetPropertyTable(h, NULL, &count);
+    IOTHUB_MESSAGE_RESULT r3 = IoTHubMessage_GetPropertyTable(h, &properties, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r1);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r2);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_024: [ If the message has no properties, IoTHubMessage_GetPropertyTable shall set properties to NULL and count to 0 and return IOTHUB_MESSAGE_OK. ]*/
+TEST_FUNCTION(IoTHubMessage_GetPropertyTable_without_properties_succeeds)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    const IOTHUB_MESSAGE_PROPERTY* properties = TEST_PROPERTIES;
+    size_t count = 1;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetPropertyTable(h, &properties, &count);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, r);
+    ASSERT_IS_NULL(properties);
+    ASSERT_ARE_EQUAL(size_t, 0, count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_025: [ If the message has no property table, IoTHubMessage_GetPropertyTable shall make one from the properties map with Map_GetInternals. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_11_027: [ IoTHubMessage_GetPropertyTable shall return in properties and count the entries of the property table, in the order their keys were first added, and return IOTHUB_MESSAGE_OK. ]*/
+TEST_FUNCTION(IoTHubMessage_GetPropertyTable_makes_the_table_from_the_map)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    MAP_HANDLE map = IoTHubMessage_Properties(h);
+    const IOTHUB_MESSAGE_PROPERTY* properties;
+    size_t count;
+    g_mapCount = 2;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_GetInternals(map, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetPropertyTable(h, &properties, &count);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, count);
+    ASSERT_ARE_EQUAL(char_ptr, "key1", properties[0].key);
+    ASSERT_ARE_EQUAL(size_t, 4, properties[0].keyLength);
+    ASSERT_ARE_EQUAL(char_ptr, "value1", properties[0].value);
+    ASSERT_ARE_EQUAL(size_t, 6, properties[0].valueLength);
+    ASSERT_ARE_EQUAL(char_ptr, "k2", properties[1].key);
+    ASSERT_ARE_EQUAL(size_t, 2, properties[1].keyLength);
+    ASSERT_ARE_EQUAL(char_ptr, "v2", properties[1].value);
+    ASSERT_ARE_EQUAL(size_t, 2, properties[1].valueLength);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, (void*)g_mapKeys[0], (void*)properties[0].key);
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_036: [ If the map was handed out by IoTHubMessage_Properties, IoTHubMessage_GetPropertyTable shall compare the property table with the map and make it again if the map was changed since. ]*/
+TEST_FUNCTION(IoTHubMessage_GetPropertyTable_keeps_the_table_while_the_map_is_unchanged)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    const IOTHUB_MESSAGE_PROPERTY* first;
+    const IOTHUB_MESSAGE_PROPERTY* properties;
+    size_t count;
+    MAP_HANDLE map = IoTHubMessage_Properties(h);
+    g_mapCount = 2;
+    (void)IoTHubMessage_GetPropertyTable(h, &first, &count);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_GetInternals(map, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetPropertyTable(h, &properties, &count);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, r);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)first, (void*)properties);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_036: [ If the map was handed out by IoTHubMessage_Properties, IoTHubMessage_GetPropertyTable shall compare the property table with the map and make it again if the map was changed since. ]*/
+TEST_FUNCTION(IoTHubMessage_GetPropertyTable_makes_the_table_again_after_the_map_changed)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    const IOTHUB_MESSAGE_PROPERTY* properties;
+    size_t count;
+    MAP_HANDLE map = IoTHubMessage_Properties(h);
+    g_mapCount = 2;
+    (void)IoTHubMessage_GetPropertyTable(h, &properties, &count);
+    g_mapValues[0] = "value3";
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_GetInternals(map, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_GetInternals(map, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetPropertyTable(h, &properties, &count);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, count);
+    ASSERT_ARE_EQUAL(char_ptr, "value3", properties[0].value);
+    ASSERT_ARE_EQUAL(size_t, 6, properties[0].valueLength);
+
+    //cleanup
+    g_mapValues[0] = "value1";
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_026: [ If making the property table fails, IoTHubMessage_GetPropertyTable shall return IOTHUB_MESSAGE_ERROR. ]*/
+TEST_FUNCTION(IoTHubMessage_GetPropertyTable_fails)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    MAP_HANDLE map = IoTHubMessage_Properties(h);
+    const IOTHUB_MESSAGE_PROPERTY* properties;
+    size_t count;
+    g_mapCount = 2;
+    umock_c_reset_all_calls();
+
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(Map_GetInternals(map, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t test_count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < test_count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessage_GetPropertyTable failure in test %zu/%zu", index, test_count);
+
+        IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetPropertyTable(h, &properties, &count);
+
+        //assert
+        ASSERT_ARE_EQUAL_WITH_MSG(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, r, tmp_msg);
+    }
+
+    //cleanup
+    umock_c_negative_tests_deinit();
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_028: [ If iotHubMessageHandle or key is NULL, IoTHubMessage_GetProperty shall return NULL. ]*/
+TEST_FUNCTION(IoTHubMessage_GetProperty_with_NULL_arguments_returns_NULL)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_SetProperties(h, TEST_PROPERTIES, 2);
+    umock_c_reset_all_calls();
+
+    //act
+    const char* r1 = IoTHubMessage_GetProperty(NULL, "key1");
+    const char* r2 = IoTHubMessage_GetProperty(h, NULL);
+
+    //assert
+    ASSERT_IS_NULL(r1);
+    ASSERT_IS_NULL(r2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_030: [ IoTHubMessage_GetProperty shall look key up in the index of the property table and return its value, or NULL if the message does not have it. ]*/
+TEST_FUNCTION(IoTHubMessage_GetProperty_succeeds)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_SetProperties(h, TEST_PROPERTIES, 2);
+    umock_c_reset_all_calls();
+
+    //act
+    const char* r1 = IoTHubMessage_GetProperty(h, "k2");
+    const char* r2 = IoTHubMessage_GetProperty(h, "key");
+    const char* r3 = IoTHubMessage_GetProperty(h, "key1");
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, "v2", r1);
+    ASSERT_IS_NULL(r2);
+    ASSERT_ARE_EQUAL(char_ptr, "value1", r3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
     IoTHubMessage_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_01_014: [If any of the arguments passed to IoTHubMessage_GetByteArray  is NULL IoTHubMessage_GetByteArray shall return IOTHUBMESSAGE_INVALID_ARG.] */
-TEST_FUNCTION(IoTHubMessage_GetByteArray_with_NULL_handle_fails)
+/*Tests_SRS_IOTHUBMESSAGE_11_029: [ IoTHubMessage_GetProperty shall get the property table as IoTHubMessage_GetPropertyTable does, and return NULL if that fails. ]*/
+TEST_FUNCTION(IoTHubMessage_GetProperty_Map_GetInternals_fails)
 {
-    //arrange
-    const unsigned char* byteArray;
-    size_t size;
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_Properties(h);
+    g_mapCount = 2;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(MAP_ERROR);
 
     //act
-    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(NULL, &byteArray, &size);
+    const char* r = IoTHubMessage_GetProperty(h, "key1");
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r);
+    ASSERT_IS_NULL(r);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
+    IoTHubMessage_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_01_014: [If any of the arguments passed to IoTHubMessage_GetByteArray  is NULL IoTHubMessage_GetByteArray shall return IOTHUBMESSAGE_INVALID_ARG.] */
-TEST_FUNCTION(IoTHubMessage_GetByteArray_with_NULL_byteArray_fails)
+/*Tests_SRS_IOTHUBMESSAGE_11_031: [ If iotHubMessageHandle is NULL, or properties is NULL and count is not 0, IoTHubMessage_SetProperties shall return IOTHUB_MESSAGE_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubMessage_SetProperties_with_NULL_arguments_fails)
 {
     ///arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
-    size_t size;
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
     umock_c_reset_all_calls();
 
     //act
-    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(h, NULL, &size);
+    IOTHUB_MESSAGE_RESULT r1 = IoTHubMessage_SetProperties(NULL, TEST_PROPERTIES, 2);
+    IOTHUB_MESSAGE_RESULT r2 = IoTHubMessage_SetProperties(h, NULL, 2);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r1);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r2);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
     IoTHubMessage_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_02_021: [If iotHubMessageHandle is not a iothubmessage containing BYTEARRAY data, then IoTHubMessage_GetByteArray  shall return IOTHUBMESSAGE_INVALID_ARG.]*/
-TEST_FUNCTION(IoTHubMessage_GetByteArray_with_STRING_fails)
+/*Tests_SRS_IOTHUBMESSAGE_11_032: [ If a key or a value is NULL or has a character that is not printable US-ASCII, IoTHubMessage_SetProperties shall return IOTHUB_MESSAGE_INVALID_ARG and leave the properties unchanged. ]*/
+TEST_FUNCTION(IoTHubMessage_SetProperties_with_non_ascii_characters_fails)
 {
-    //arrange
+    ///arrange
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
-    const unsigned char* byteArray;
-    size_t size;
+    IOTHUB_MESSAGE_PROPERTY invalidKey[2] = { { "key1", 4, "value1", 6 }, { "Inval\nd_key", 11, "v", 1 } };
+    IOTHUB_MESSAGE_PROPERTY invalidValue[1] = { { "key1", 4, "Inval\nd_value", 13 } };
+    IOTHUB_MESSAGE_PROPERTY nullValue[1] = { { "key1", 4, NULL, 0 } };
+    (void)IoTHubMessage_SetProperties(h, TEST_PROPERTIES, 2);
     umock_c_reset_all_calls();
 
     //act
-    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(h, &byteArray, &size);
+    IOTHUB_MESSAGE_RESULT r1 = IoTHubMessage_SetProperties(h, invalidKey, 2);
+    IOTHUB_MESSAGE_RESULT r2 = IoTHubMessage_SetProperties(h, invalidValue, 1);
+    IOTHUB_MESSAGE_RESULT r3 = IoTHubMessage_SetProperties(h, nullValue, 1);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r1);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r2);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r3);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "value1", IoTHubMessage_GetProperty(h, "key1"));
 
-    ///cleanup
+    //cleanup
     IoTHubMessage_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_03_001: [IoTHubMessage_Clone shall create a new IoT hub message with data content identical to that of the iotHubMessageHandle parameter.]*/
-/*Tests_SRS_IOTHUBMESSAGE_02_006: [IoTHubMessage_Clone shall clone the content by a call to BUFFER_clone or STRING_clone] */
-/*Tests_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
-/*Tests_SRS_IOTHUBMESSAGE_03_002: [IoTHubMessage_Clone shall return upon success a non-NULL handle to the newly created IoT hub message.]*/
-TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_happy_path)
+/*Tests_SRS_IOTHUBMESSAGE_11_032: [ If a key or a value is NULL or has a character that is not printable US-ASCII, IoTHubMessage_SetProperties shall return IOTHUB_MESSAGE_INVALID_ARG and leave the properties unchanged. ]*/
+TEST_FUNCTION(IoTHubMessage_SetProperties_with_a_non_ascii_character_anywhere_in_a_long_value_fails)
 {
-    //arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    ///arrange
+    /*the values are long enough to be checked a block of bytes at a time, followed by the bytes left*/
+    static const char invalidCharacters[] = { 0x00, 0x1F, 0x7F, (char)0x80, (char)0xFF };
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    char value[71];
+    IOTHUB_MESSAGE_PROPERTY property = { "key1", 4, value, sizeof(value) };
+    size_t position;
+    size_t character;
+    (void)memset(value, '~', sizeof(value));
+    value[0] = ' ';
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_clone(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
 
     //act
-    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    for (position = 0; position < sizeof(value); position++)
+    {
+        char saved = value[position];
+        for (character = 0; character < sizeof(invalidCharacters); character++)
+        {
+            value[position] = invalidCharacters[character];
+            ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, IoTHubMessage_SetProperties(h, &property, 1));
+        }
+        value[position] = saved;
+    }
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_SetProperties(h, &property, 1);
 
     //assert
-    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, r);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
-    IoTHubMessage_Destroy(r);
+    //cleanup
     IoTHubMessage_Destroy(h);
 }
 
-TEST_FUNCTION(IoTHubMessage_Clone_handle_NULL_fail)
+/*Tests_SRS_IOTHUBMESSAGE_11_033: [ IoTHubMessage_SetProperties shall copy the properties in a new property table in a single allocation, a key given more than once getting its last value. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_11_035: [ IoTHubMessage_SetProperties shall replace all the properties of the message, without changing those of the messages it shares them with, and return IOTHUB_MESSAGE_OK. ]*/
+TEST_FUNCTION(IoTHubMessage_SetProperties_succeeds)
 {
-    //arrange
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    /*the lengths exclude the end of the buffers*/
+    IOTHUB_MESSAGE_PROPERTY input[3] = { { "key1", 4, "value1", 6 }, { "k2xx", 2, "v2xx", 2 }, { "key1", 4, "last", 4 } };
+    const IOTHUB_MESSAGE_PROPERTY* properties;
+    size_t count;
+    umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
 
     //act
-    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(NULL);
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_SetProperties(h, input, 3);
 
     //assert
-    ASSERT_IS_NULL(r);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, r);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_GetPropertyTable(h, &properties, &count));
+    ASSERT_ARE_EQUAL(size_t, 2, count);
+    ASSERT_ARE_EQUAL(char_ptr, "key1", properties[0].key);
+    ASSERT_ARE_EQUAL(char_ptr, "last", properties[0].value);
+    ASSERT_ARE_EQUAL(size_t, 4, properties[0].valueLength);
+    ASSERT_ARE_EQUAL(char_ptr, "k2", properties[1].key);
+    ASSERT_ARE_EQUAL(char_ptr, "v2", properties[1].value);
 
     //cleanup
+    IoTHubMessage_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_fails)
+/*Tests_SRS_IOTHUBMESSAGE_11_035: [ IoTHubMessage_SetProperties shall replace all the properties of the message, without changing those of the messages it shares them with, and return IOTHUB_MESSAGE_OK. ]*/
+TEST_FUNCTION(IoTHubMessage_SetProperties_replaces_the_map)
 {
-    //arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    MAP_HANDLE map = IoTHubMessage_Properties(h);
     umock_c_reset_all_calls();
 
-    int negativeTestsInitResult = umock_c_negative_tests_init();
-    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
-
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_clone(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
-
-    umock_c_negative_tests_snapshot();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Destroy(map));
 
     //act
-    size_t count = umock_c_negative_tests_call_count();
-    for (size_t index = 0; index < count; index++)
-    {
-        umock_c_negative_tests_reset();
-        umock_c_negative_tests_fail_call(index);
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_SetProperties(h, TEST_PROPERTIES, 2);
 
-        char tmp_msg[64];
-        sprintf(tmp_msg, "IoTHubMessage_Clone failure in test %zu/%zu", index, count);
-
-        IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
-
-        //assert
-        ASSERT_IS_NULL_WITH_MSG(r, tmp_msg);
-    }
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "v2", IoTHubMessage_GetProperty(h, "k2"));
 
     //cleanup
     IoTHubMessage_Destroy(h);
-    umock_c_negative_tests_deinit();
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_03_001: [IoTHubMessage_Clone shall create a new IoT hub message with data content identical to that of the iotHubMessageHandle parameter.]*/
-/*Tests_SRS_IOTHUBMESSAGE_02_006: [IoTHubMessage_Clone shall clone the content by a call to BUFFER_clone or STRING_clone] */
-/*Tests_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
-/*Tests_SRS_IOTHUBMESSAGE_03_002: [IoTHubMessage_Clone shall return upon success a non-NULL handle to the newly created IoT hub message.]*/
-TEST_FUNCTION(IoTHubMessage_Clone_with_STRING_happy_path)
+/*Tests_SRS_IOTHUBMESSAGE_11_035: [ IoTHubMessage_SetProperties shall replace all the properties of the message, without changing those of the messages it shares them with, and return IOTHUB_MESSAGE_OK. ]*/
+TEST_FUNCTION(IoTHubMessage_SetProperties_on_a_clone_keeps_the_properties_of_the_source)
 {
-    //arrange
+    ///arrange
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    IOTHUB_MESSAGE_HANDLE clone;
+    IOTHUB_MESSAGE_PROPERTY input[1] = { { "k2", 2, "other", 5 } };
+    (void)IoTHubMessage_SetProperties(h, TEST_PROPERTIES, 2);
+    clone = IoTHubMessage_Clone(h);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(STRING_clone(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
-
-    ///act
-    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_SetProperties(clone, input, 1);
 
-    ///assert
-    ASSERT_IS_NOT_NULL(r);
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, r);
+    ASSERT_ARE_EQUAL(char_ptr, "other", IoTHubMessage_GetProperty(clone, "k2"));
+    ASSERT_IS_NULL(IoTHubMessage_GetProperty(clone, "key1"));
+    ASSERT_ARE_EQUAL(char_ptr, "v2", IoTHubMessage_GetProperty(h, "k2"));
 
-    ///cleanup
-    IoTHubMessage_Destroy(r);
+    //cleanup
+    IoTHubMessage_Destroy(clone);
     IoTHubMessage_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-TEST_FUNCTION(IoTHubMessage_Clone_with_STRING_fails)
+/*Tests_SRS_IOTHUBMESSAGE_11_034: [ If any allocation fails, IoTHubMessage_SetProperties shall return IOTHUB_MESSAGE_ERROR and leave the properties unchanged. ]*/
+TEST_FUNCTION(IoTHubMessage_SetProperties_fails)
 {
-    //arrange
+    ///arrange
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    IOTHUB_MESSAGE_PROPERTY input[1] = { { "k2", 2, "other", 5 } };
+    (void)IoTHubMessage_SetProperties(h, TEST_PROPERTIES, 2);
     umock_c_reset_all_calls();
 
     int negativeTestsInitResult = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
 
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(STRING_clone(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
 
     umock_c_negative_tests_snapshot();
 
@@ -715,52 +1713,20 @@ TEST_FUNCTION(IoTHubMessage_Clone_with_STRING_fails)
         umock_c_negative_tests_fail_call(index);
 
         char tmp_msg[64];
-        sprintf(tmp_msg, "IoTHubMessage_Clone_w_string failure in test %zu/%zu", index, count);
+        sprintf(tmp_msg, "IoTHubMessage_SetProperties failure in test %zu/%zu", index, count);
 
-        IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+        IOTHUB_MESSAGE_RESULT r = IoTHubMessage_SetProperties(h, input, 1);
 
         //assert
-        ASSERT_IS_NULL_WITH_MSG(r, tmp_msg);
+        ASSERT_ARE_EQUAL_WITH_MSG(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, r, tmp_msg);
+        ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, "v2", IoTHubMessage_GetProperty(h, "k2"), tmp_msg);
     }
 
     //cleanup
-    IoTHubMessage_Destroy(h);
     umock_c_negative_tests_deinit();
-}
-
-/*Tests_SRS_IOTHUBMESSAGE_02_002: [Otherwise, for any non-NULL iotHubMessageHandle it shall return a non-NULL MAP_HANDLE.] */
-TEST_FUNCTION(IoTHubMessage_Properties_happy_path)
-{
-    ///arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
-    umock_c_reset_all_calls();
-
-    //act
-    MAP_HANDLE r = IoTHubMessage_Properties(h);
-
-    //assert
-    ASSERT_IS_NOT_NULL(r);
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    //cleanup
     IoTHubMessage_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_02_001: [If iotHubMessageHandle is NULL then IoTHubMessage_Properties shall return NULL.] */
-TEST_FUNCTION(IoTHubMessage_Properties_with_NULL_handle_retuns_NULL)
-{
-    //arrange
-
-    //act
-    MAP_HANDLE r = IoTHubMessage_Properties(NULL);
-
-    //assert
-    ASSERT_IS_NULL(r);
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    //cleanup
-}
-
 /*Tests_SRS_IOTHUBMESSAGE_02_008: [If any parameter is NULL then IoTHubMessage_GetContentType shall return IOTHUBMESSAGE_UNKNOWN.] */
 TEST_FUNCTION(IoTHubMessage_GetContentType_with_NULL_handle_fails)
 {
@@ -798,8 +1764,6 @@ TEST_FUNCTION(IoTHubMessage_GetString_happy_path)
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-
     //act
     const char* r = IoTHubMessage_GetString(h);
 
@@ -870,8 +1834,6 @@ TEST_FUNCTION(IoTHubMessage_SetMessageId_SUCCEED)
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MESSAGE_ID));
-
     //act
     IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID);
 
@@ -891,9 +1853,6 @@ TEST_FUNCTION(IoTHubMessage_SetMessageId_MessageId_Not_NULL_SUCCEED)
     IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MESSAGE_ID2));
-
     //act
     result = IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID2);
 
@@ -1035,8 +1994,6 @@ TEST_FUNCTION(IoTHubMessage_SetCorrelationId_SUCCEED)
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MESSAGE_ID));
-
     //act
     IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetCorrelationId(h, TEST_MESSAGE_ID);
 
@@ -1056,9 +2013,6 @@ TEST_FUNCTION(IoTHubMessage_SetCorrelationId_CorrelationId_Not_NULL_SUCCEED)
     (void)IoTHubMessage_SetCorrelationId(h, TEST_MESSAGE_ID);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MESSAGE_ID2));
-
     //act
     IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetCorrelationId(h, TEST_MESSAGE_ID2);
 
@@ -1077,8 +2031,6 @@ TEST_FUNCTION(IoTHubMessage_SetContentTypeSystemProperty_SUCCEED)
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_CONTENT_TYPE));
-
     //act
     IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentTypeSystemProperty(h, TEST_CONTENT_TYPE);
 
@@ -1095,11 +2047,10 @@ TEST_FUNCTION(IoTHubMessage_SetContentTypeSystemProperty_Not_NULL_SUCCEED)
 {
     //arrange
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
-    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentTypeSystemProperty(h, TEST_CONTENT_TYPE);
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentTypeSystemProperty(h, TEST_LONG_VALUE);
 
     umock_c_reset_all_calls();
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_CONTENT_TYPE));
 
     //act
     result = IoTHubMessage_SetContentTypeSystemProperty(h, TEST_CONTENT_TYPE);
@@ -1156,7 +2107,7 @@ TEST_FUNCTION(IoTHubMessage_SetContentTypeSystemProperty_Fails)
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
 
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_CONTENT_TYPE));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     umock_c_negative_tests_snapshot();
 
     //act
@@ -1170,7 +2121,7 @@ TEST_FUNCTION(IoTHubMessage_SetContentTypeSystemProperty_Fails)
         sprintf(tmp_msg, "Failed in test %zu/%zu", index, count);
 
         //act
-        IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentTypeSystemProperty(h, TEST_CONTENT_TYPE);
+        IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentTypeSystemProperty(h, TEST_LONG_VALUE);
 
         //assert
         ASSERT_ARE_EQUAL_WITH_MSG(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, result, tmp_msg);
@@ -1188,8 +2139,6 @@ TEST_FUNCTION(IoTHubMessage_SetContentEncodingSystemProperty_SUCCEED)
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_CONTENT_ENCODING));
-
     //act
     IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentEncodingSystemProperty(h, TEST_CONTENT_ENCODING);
 
@@ -1206,11 +2155,10 @@ TEST_FUNCTION(IoTHubMessage_SetContentEncodingSystemProperty_Not_NULL_SUCCEED)
 {
     //arrange
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
-    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentEncodingSystemProperty(h, TEST_CONTENT_ENCODING);
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentEncodingSystemProperty(h, TEST_LONG_VALUE);
 
     umock_c_reset_all_calls();
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_CONTENT_ENCODING));
 
     //act
     result = IoTHubMessage_SetContentEncodingSystemProperty(h, TEST_CONTENT_ENCODING);
@@ -1267,7 +2215,7 @@ TEST_FUNCTION(IoTHubMessage_SetContentEncodingSystemProperty_Fails)
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
 
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_CONTENT_ENCODING));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     umock_c_negative_tests_snapshot();
 
     //act
@@ -1281,7 +2229,7 @@ TEST_FUNCTION(IoTHubMessage_SetContentEncodingSystemProperty_Fails)
         sprintf(tmp_msg, "Failed in test %zu/%zu", index, count);
 
         //act
-        IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentEncodingSystemProperty(h, TEST_CONTENT_ENCODING);
+        IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentEncodingSystemProperty(h, TEST_LONG_VALUE);
 
         //assert
         ASSERT_ARE_EQUAL_WITH_MSG(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, result, tmp_msg);
@@ -1508,19 +2456,14 @@ TEST_FUNCTION(IoTHubMessage_SetDiagnosticPropertyData_DiagnosticData_Not_NULL_SU
     (void)IoTHubMessage_SetDiagnosticPropertyData(h, &TEST_DIAGNOSTIC_DATA);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-
     //act
     IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetDiagnosticPropertyData(h, &TEST_DIAGNOSTIC_DATA2);
 
     //assert
     ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_DIAGNOSTIC_DATA2.diagnosticId, IoTHubMessage_GetDiagnosticPropertyData(h)->diagnosticId);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_DIAGNOSTIC_DATA2.diagnosticCreationTimeUtc, IoTHubMessage_GetDiagnosticPropertyData(h)->diagnosticCreationTimeUtc);
 
     //cleanup
     IoTHubMessage_Destroy(h);
@@ -1536,8 +2479,7 @@ TEST_FUNCTION(IoTHubMessage_SetDiagnosticPropertyData_Fails)
 
     umock_c_reset_all_calls();
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     umock_c_negative_tests_snapshot();
 
     //act
@@ -1551,10 +2493,11 @@ TEST_FUNCTION(IoTHubMessage_SetDiagnosticPropertyData_Fails)
         sprintf(tmp_msg, "Failed in test %zu/%zu", index, count);
 
         //act
-        IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetDiagnosticPropertyData(h, &TEST_DIAGNOSTIC_DATA);
+        IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetDiagnosticPropertyData(h, &TEST_LONG_DIAGNOSTIC_DATA);
 
         //assert
         ASSERT_ARE_EQUAL_WITH_MSG(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, result, tmp_msg);
+        ASSERT_IS_NULL_WITH_MSG(IoTHubMessage_GetDiagnosticPropertyData(h), tmp_msg);
     }
 
     //cleanup
@@ -1569,20 +2512,134 @@ TEST_FUNCTION(IoTHubMessage_SetDiagnosticPropertyData_SUCCEED)
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
     umock_c_reset_all_calls();
 
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetDiagnosticPropertyData(h, &TEST_DIAGNOSTIC_DATA);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_009: [ The message id, correlation id, content type, content encoding and diagnostic data shall be copied into the space reserved inside the message while it has room, and into their own allocation otherwise. ]*/
+TEST_FUNCTION(IoTHubMessage_SetMessageId_long_value_SUCCEED)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     //act
-    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetDiagnosticPropertyData(h, &TEST_DIAGNOSTIC_DATA);
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetMessageId(h, TEST_LONG_VALUE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_LONG_VALUE, IoTHubMessage_GetMessageId(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/* Tests_SRS_IOTHUBMESSAGE_07_014: [If the allocation or the copying of the messageId fails, then IoTHubMessage_SetMessageId shall return IOTHUB_MESSAGE_ERROR.] */
+TEST_FUNCTION(IoTHubMessage_SetMessageId_long_value_Fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetMessageId(h, TEST_LONG_VALUE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID, IoTHubMessage_GetMessageId(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_009: [ The message id, correlation id, content type, content encoding and diagnostic data shall be copied into the space reserved inside the message while it has room, and into their own allocation otherwise. ]*/
+TEST_FUNCTION(IoTHubMessage_system_properties_go_to_their_own_allocation_once_the_message_is_full)
+{
+    //arrange
+    const char* contentType = "application/vnd.microsoft.iothub.telemetry+json; charset=utf-8";
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID);
+    (void)IoTHubMessage_SetCorrelationId(h, TEST_MESSAGE_ID2);
+    (void)IoTHubMessage_SetContentEncodingSystemProperty(h, TEST_CONTENT_ENCODING);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentTypeSystemProperty(h, contentType);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID, IoTHubMessage_GetMessageId(h));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID2, IoTHubMessage_GetCorrelationId(h));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_CONTENT_ENCODING, IoTHubMessage_GetContentEncodingSystemProperty(h));
+    ASSERT_ARE_EQUAL(char_ptr, contentType, IoTHubMessage_GetContentTypeSystemProperty(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_11_010: [ A value replacing one kept inside the message shall reuse its space when it fits in it, a value in its own allocation shall be freed once replaced. ]*/
+TEST_FUNCTION(IoTHubMessage_SetMessageId_frees_the_replaced_long_value)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetMessageId(h, TEST_LONG_VALUE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID);
 
     //assert
     ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID, IoTHubMessage_GetMessageId(h));
 
     //cleanup
     IoTHubMessage_Destroy(h);
 }
 
+/*Tests_SRS_IOTHUBMESSAGE_11_010: [ A value replacing one kept inside the message shall reuse its space when it fits in it, a value in its own allocation shall be freed once replaced. ]*/
+TEST_FUNCTION(IoTHubMessage_SetMessageId_reuses_the_space_of_the_replaced_value)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    size_t index;
+    (void)IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID);
+    const char* firstMessageId = IoTHubMessage_GetMessageId(h);
+    umock_c_reset_all_calls();
+
+    //act
+    for (index = 0; index < 100; index++)
+    {
+        ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_SetMessageId(h, (index % 2 == 0) ? TEST_MESSAGE_ID2 : TEST_MESSAGE_ID));
+    }
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, (void*)firstMessageId, (void*)IoTHubMessage_GetMessageId(h));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID, IoTHubMessage_GetMessageId(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
 
 END_TEST_SUITE(iothubmessage_ut)
@@ -144,6 +144,8 @@ static SINGLYLINKEDLIST_HANDLE TEST_IN_PROGRESS_LIST;
 #define TEST_IN_PROGRESS_LIST2                            (SINGLYLINKEDLIST_HANDLE)0x4484
 #define TEST_OPTIONHANDLER_HANDLE                         (OPTIONHANDLER_HANDLE)0x4485
 #define TEST_CALLBACK_LIST1                               (SINGLYLINKEDLIST_HANDLE)0x4486
+#define TEST_TICK_COUNTER_HANDLE                          (TICK_COUNTER_HANDLE)0x4487
+#define TEST_SECTIONS_CACHE_HANDLE                        (MESSAGE_SECTIONS_CACHE_HANDLE)0x4488
 #define INDEFINITE_TIME                                   ((time_t)-1)
 
 static delivery_number TEST_DELIVERY_NUMBER;
@@ -447,14 +449,21 @@ static MESSENGER_DO_WORK_EXP_CALL_PROFILE* get_msgr_do_work_exp_call_profile(TEL
     return &g_do_work_profile;
 }
 
-static int TEST_message_create_uamqp_encoding_from_iothub_message(MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, BINARY_DATA* body_binary_data)
+static int TEST_message_encode_uamqp_from_iothub_message(MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, MESSAGE_SECTIONS_CACHE_HANDLE sections_cache, unsigned char* destination, size_t capacity, size_t* encoded_length)
 {
     (void)message_batch_container;
     (void)message_handle;
-    (void)body_binary_data;
+    (void)sections_cache;
+    (void)destination;
+    (void)capacity;
+    (void)encoded_length;
     return 0;
 }
 
+// Mirrors the encode buffer and the maximum message size the messenger keeps for its sender link.
+static size_t TEST_encode_buffer_size;
+static bool TEST_max_message_size_queried;
+
 
 static MESSAGE_HANDLE saved_message_create_IoTHubMessage_from_uamqp_message_uamqp_message;
 static int TEST_message_create_IoTHubMessage_from_uamqp_message_return;
@@ -767,6 +776,7 @@ static void set_expected_calls_for_telemetry_messenger_create(TELEMETRY_MESSENGE
     STRICT_EXPECTED_CALL(STRING_construct(config->iothub_host_fqdn)).SetReturn(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE);
     STRICT_EXPECTED_CALL(singlylinkedlist_create()).SetReturn(TEST_WAIT_TO_SEND_LIST);
     STRICT_EXPECTED_CALL(singlylinkedlist_create()).SetReturn(TEST_IN_PROGRESS_LIST);
+    STRICT_EXPECTED_CALL(message_sections_cache_create(IGNORED_NUM_ARG)).SetReturn(TEST_SECTIONS_CACHE_HANDLE);
 }
 
 static void set_expected_calls_for_attach_device_client_type_to_link(LINK_HANDLE link_handle, int amqpvalue_set_map_value_result, int link_set_attach_properties_result)
@@ -975,6 +985,14 @@ static void set_expected_calls_for_message_sender_destroy()
 {
     STRICT_EXPECTED_CALL(messagesender_destroy(TEST_MESSAGE_SENDER_HANDLE));
     STRICT_EXPECTED_CALL(link_destroy(TEST_EVENT_SENDER_LINK_HANDLE));
+
+    if (TEST_encode_buffer_size > 0)
+    {
+        STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    }
+
+    TEST_encode_buffer_size = 0;
+    TEST_max_message_size_queried = false;
 }
 
 static void set_expected_calls_for_copy_events_from_in_progress_to_waiting_list(int in_progress_list_length)
@@ -1110,7 +1128,36 @@ static void set_expected_calls_for_send_batched_message_and_reset_state(time_t c
     STRICT_EXPECTED_CALL(message_destroy(IGNORED_PTR_ARG));
 }
 
-BINARY_DATA TEST_amqp_data = { NULL, 100 };
+static void set_expected_calls_for_message_encode_uamqp_from_iothub_message(size_t encoded_length, int result)
+{
+    STRICT_EXPECTED_CALL(message_encode_uamqp_from_iothub_message(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_SECTIONS_CACHE_HANDLE, IGNORED_PTR_ARG, TEST_encode_buffer_size, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_encoded_length(&encoded_length, sizeof(encoded_length))
+        .SetReturn(result);
+}
+
+static void set_expected_calls_for_grow_encode_buffer(size_t needed_size, size_t max_message_size)
+{
+    size_t new_size = TEST_encode_buffer_size * 2;
+
+    if (new_size < needed_size)
+    {
+        new_size = needed_size;
+    }
+
+    if (new_size > max_message_size)
+    {
+        new_size = max_message_size;
+    }
+
+    if (TEST_encode_buffer_size > 0)
+    {
+        STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    }
+
+    STRICT_EXPECTED_CALL(malloc(new_size));
+
+    TEST_encode_buffer_size = new_size;
+}
 
 
 // 
@@ -1194,6 +1241,43 @@ static SEND_PENDING_EVENTS_TEST_CONFIG test_send_rollover_one_message_after_conf
     0
 };
 
+//
+//  Tests where the batch is limited by MESSENGER_OPTION_BATCH_MAX_MESSAGES (2) or MESSENGER_OPTION_BATCH_MAX_BYTES (25)
+//  well before the link maximum is reached
+//
+static SEND_PENDING_TEST_EVENTS test_send_batch_limit_rollover_events[] = {
+    { 10,  SEND_PENDING_EXPECT_ADD  },
+    { 10,  SEND_PENDING_EXPECT_ADD },
+    { 10,  SEND_PENDING_EXPECT_ROLLOVER },
+};
+
+static SEND_PENDING_EVENTS_TEST_CONFIG test_send_batch_limit_rollover_config = {
+    100,
+    test_send_batch_limit_rollover_events,
+    COUNT_OF(test_send_batch_limit_rollover_events),
+    true,
+    NULL,
+    0
+};
+
+//
+//  Tests where three messages go out in one batch, after being held by MESSENGER_OPTION_BATCH_LINGER_MS
+//
+static SEND_PENDING_TEST_EVENTS test_send_three_messages_events[] = {
+    { 10,  SEND_PENDING_EXPECT_ADD },
+    { 10,  SEND_PENDING_EXPECT_ADD },
+    { 10,  SEND_PENDING_EXPECT_ADD },
+};
+
+static SEND_PENDING_EVENTS_TEST_CONFIG test_send_three_messages_config = {
+    100,
+    test_send_three_messages_events,
+    COUNT_OF(test_send_three_messages_events),
+    true,
+    NULL,
+    0
+};
+
 //
 //  Tests where there is roll over and multiple messages after
 //
@@ -1319,6 +1403,25 @@ static SEND_PENDING_EVENTS_TEST_CONFIG test_create_message_failure_config = {
     0
 };
 
+//
+//  Messages of growing sizes, which make the encode buffer grow, while smaller ones reuse it
+//
+static SEND_PENDING_TEST_EVENTS test_send_growing_messages_events[] = {
+    { 10,  SEND_PENDING_EXPECT_ADD  },
+    { 30,  SEND_PENDING_EXPECT_ADD  },
+    { 20,  SEND_PENDING_EXPECT_ADD  },
+    { 50,  SEND_PENDING_EXPECT_ADD  },
+};
+
+static SEND_PENDING_EVENTS_TEST_CONFIG test_send_growing_messages_config = {
+    200,
+    test_send_growing_messages_events,
+    COUNT_OF(test_send_growing_messages_events),
+    true,
+    NULL,
+    0
+};
+
 
 
 // Note: This does NOT handle roll-over test paths.  These are handled with different test path.
@@ -1340,7 +1443,8 @@ static void set_expected_calls_for_message_do_work_send_pending_events(SEND_PEND
     for (i = 0; i < test_config->number_test_events; i++)
     {
         const SEND_PENDING_EXPECTED_ACTION expected_action = test_config->test_events[i].expected_action;
-        const int message_create_uamqp_encoding_from_iothub_message_return = (expected_action == SEND_PENDING_EXPECT_CREATE_MESSAGE_FAILURE) ? 1 : 0;
+        const int message_encode_uamqp_from_iothub_message_return = (expected_action == SEND_PENDING_EXPECT_CREATE_MESSAGE_FAILURE) ? 1 : 0;
+        const size_t number_bytes_encoded = test_config->test_events[i].number_bytes_encoded;
 
         STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
         STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
@@ -1348,18 +1452,20 @@ static void set_expected_calls_for_message_do_work_send_pending_events(SEND_PEND
     
         if (i == 0)
         {
-            // Product code factors in AMQP_BATCHING_RESERVE_SIZE bytes and won't go beneath this.  
-            // Account for this in test here.
-            uint64_t peer_max_message_size = test_config->peer_max_message_size + AMQP_BATCHING_RESERVE_SIZE;
-            STRICT_EXPECTED_CALL(link_get_peer_max_message_size(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-                .CopyOutArgumentBuffer(2, &peer_max_message_size, sizeof(peer_max_message_size));
+            // The maximum message size is only queried the first time messages are sent over a link.
+            if (!TEST_max_message_size_queried)
+            {
+                // Product code factors in AMQP_BATCHING_RESERVE_SIZE bytes and won't go beneath this.  
+                // Account for this in test here.
+                uint64_t peer_max_message_size = test_config->peer_max_message_size + AMQP_BATCHING_RESERVE_SIZE;
+                STRICT_EXPECTED_CALL(link_get_peer_max_message_size(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+                    .CopyOutArgumentBuffer(2, &peer_max_message_size, sizeof(peer_max_message_size));
+                TEST_max_message_size_queried = true;
+            }
             set_expected_calls_for_create_send_pending_events_state();
         }
 
-        TEST_amqp_data.length = test_config->test_events[i].number_bytes_encoded;
-
-        STRICT_EXPECTED_CALL(message_create_uamqp_encoding_from_iothub_message(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .CopyOutArgumentBuffer(3, &TEST_amqp_data, sizeof(TEST_amqp_data)).SetReturn(message_create_uamqp_encoding_from_iothub_message_return);
+        set_expected_calls_for_message_encode_uamqp_from_iothub_message(number_bytes_encoded, message_encode_uamqp_from_iothub_message_return);
 
         if ((SEND_PENDING_EXPECT_ERROR_TOO_LARGE == expected_action) || (SEND_PENDING_EXPECT_CREATE_MESSAGE_FAILURE == expected_action))
         {
@@ -1367,6 +1473,12 @@ static void set_expected_calls_for_message_do_work_send_pending_events(SEND_PEND
             continue;
         }
 
+        if (number_bytes_encoded > TEST_encode_buffer_size)
+        {
+            set_expected_calls_for_grow_encode_buffer(number_bytes_encoded, (size_t)test_config->peer_max_message_size);
+            set_expected_calls_for_message_encode_uamqp_from_iothub_message(number_bytes_encoded, 0);
+        }
+
         callback_cleanup_needed = true;
         
         STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
@@ -1504,6 +1616,7 @@ static void set_expected_calls_for_telemetry_messenger_destroy(TELEMETRY_MESSENG
     STRICT_EXPECTED_CALL(STRING_delete(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
     STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICE_ID_STRING_HANDLE));
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_sections_cache_destroy(TEST_SECTIONS_CACHE_HANDLE));
     STRICT_EXPECTED_CALL(free(messenger_handle));
 }
 
@@ -1686,6 +1799,8 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO, void*);
     REGISTER_UMOCK_ALIAS_TYPE(BINARY_DATA, void*);
     REGISTER_UMOCK_ALIAS_TYPE(LIST_ACTION_FUNCTION, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_SECTIONS_CACHE_HANDLE, void*);
     type_size = sizeof(time_t);
     if (type_size == sizeof(uint64_t))
     {
@@ -1706,7 +1821,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_HOOK(messagesender_send_async, TEST_messagesender_send_async);
     REGISTER_GLOBAL_MOCK_HOOK(messagereceiver_create, TEST_messagereceiver_create);
     REGISTER_GLOBAL_MOCK_HOOK(messagereceiver_open, TEST_messagereceiver_open);
-    REGISTER_GLOBAL_MOCK_HOOK(message_create_uamqp_encoding_from_iothub_message, TEST_message_create_uamqp_encoding_from_iothub_message);
+    REGISTER_GLOBAL_MOCK_HOOK(message_encode_uamqp_from_iothub_message, TEST_message_encode_uamqp_from_iothub_message);
     REGISTER_GLOBAL_MOCK_HOOK(message_create_IoTHubMessage_from_uamqp_message, TEST_message_create_IoTHubMessage_from_uamqp_message);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_add, TEST_singlylinkedlist_add);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_head_item, TEST_singlylinkedlist_get_head_item);
@@ -1840,6 +1955,9 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 
     saved_malloc_returns_count = 0;
 
+    TEST_encode_buffer_size = 0;
+    TEST_max_message_size_queried = false;
+
     TEST_WAIT_TO_SEND_LIST = TEST_WAIT_TO_SEND_LIST1;
     TEST_IN_PROGRESS_LIST = TEST_IN_PROGRESS_LIST1;
 
@@ -1951,6 +2069,7 @@ TEST_FUNCTION(telemetry_messenger_create_config_NULL_iothub_host_fqdn)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_010: [telemetry_messenger_create() shall save a copy of `messenger_config->iothub_host_fqdn` into `instance->iothub_host_fqdn`]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_165: [`instance->wait_to_send_list` shall be set using singlylinkedlist_create()]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_132: [`instance->in_progress_list` shall be set using singlylinkedlist_create()]   
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_013: [`instance->sections_cache` shall be set using message_sections_cache_create()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_013: [`messenger_config->on_state_changed_callback` shall be saved into `instance->on_state_changed_callback`]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_014: [`messenger_config->on_state_changed_context` shall be saved into `instance->on_state_changed_context`]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_015: [If no failures occurr, telemetry_messenger_create() shall return a handle to `instance`]
@@ -1978,6 +2097,7 @@ TEST_FUNCTION(telemetry_messenger_create_success)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_011: [If STRING_construct() fails, telemetry_messenger_create() shall fail and return NULL] 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_166: [If singlylinkedlist_create() fails, telemetry_messenger_create() shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_133: [If singlylinkedlist_create() fails, telemetry_messenger_create() shall fail and return NULL]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_014: [If message_sections_cache_create() fails, telemetry_messenger_create() shall fail and return NULL]
 TEST_FUNCTION(telemetry_messenger_create_failure_checks)
 {
     // arrange
@@ -2237,6 +2357,7 @@ TEST_FUNCTION(telemetry_messenger_destroy_NULL_handle)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_150: [`instance->in_progress_list` and `instance->wait_to_send_list` shall be destroyed using singlylinkedlist_destroy()]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_112: [`instance->iothub_host_fqdn` shall be destroyed using STRING_delete()]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_113: [`instance->device_id` shall be destroyed using STRING_delete()]  
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_016: [`instance->sections_cache` shall be destroyed using message_sections_cache_destroy()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_114: [telemetry_messenger_destroy() shall destroy `instance` with free()] 
 TEST_FUNCTION(telemetry_messenger_destroy_succeeds)
 {
@@ -2373,6 +2494,139 @@ void test_send_events(SEND_PENDING_EVENTS_TEST_CONFIG *test_config)
     telemetry_messenger_destroy(handle);
 }
 
+static void test_send_events_with_batch_option(SEND_PENDING_EVENTS_TEST_CONFIG *test_config, const char* option_name, size_t option_value)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    ASSERT_ARE_EQUAL(int, 0, telemetry_messenger_set_option(handle, option_name, &option_value));
+    ASSERT_ARE_EQUAL(int, test_config->number_test_events, send_events(handle, test_config->number_test_events));
+
+    time_t current_time = time(NULL);
+    MESSENGER_DO_WORK_EXP_CALL_PROFILE *do_work_profile = get_msgr_do_work_exp_call_profile(TELEMETRY_MESSENGER_STATE_STARTED, false, false, 1, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
+    do_work_profile->send_pending_events_test_config = test_config;
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_telemetry_messenger_do_work(do_work_profile);
+
+    // act
+    telemetry_messenger_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_006: [If the batched message already holds `instance->batch_max_messages` messages, and that option is not zero, the pending messages shall be sent and a new batched message created.]
+TEST_FUNCTION(telemetry_messenger_do_work_send_events_batch_max_messages_rollover)
+{
+    test_send_events_with_batch_option(&test_send_batch_limit_rollover_config, MESSENGER_OPTION_BATCH_MAX_MESSAGES, 2);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_005: [If `instance->batch_max_bytes` is not zero and is below the maximum message size, it shall be used as the maximum size of a batch instead.]
+TEST_FUNCTION(telemetry_messenger_do_work_send_events_batch_max_bytes_rollover)
+{
+    test_send_events_with_batch_option(&test_send_batch_limit_rollover_config, MESSENGER_OPTION_BATCH_MAX_BYTES, 25);
+}
+
+static void set_expected_calls_for_holding_pending_events(int wait_to_send_list_length, tickcounter_ms_t* current_ms)
+{
+    int i;
+
+    set_expected_calls_for_process_event_send_timeouts(0, DEFAULT_EVENT_SEND_TIMEOUT_SECS, time(NULL));
+
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
+    for (i = 0; i < wait_to_send_list_length; i++)
+    {
+        STRICT_EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    }
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, current_ms, sizeof(tickcounter_ms_t));
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_007: [If `instance->batch_linger_ms` is greater than zero, the events waiting to be sent shall be held while more of them keep arriving, for up to `instance->batch_linger_ms` milliseconds after they were first seen]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_008: [The events shall not be held if no event arrived since the previous telemetry_messenger_do_work(), or if `instance->batch_max_messages` events or `instance->batch_max_bytes` bytes of payload are waiting]
+TEST_FUNCTION(telemetry_messenger_do_work_batch_linger_holds_events_until_idle)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t linger_ms = 1000;
+    tickcounter_ms_t first_ms = 100;
+    tickcounter_ms_t second_ms = 200;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(tickcounter_create()).SetReturn(TEST_TICK_COUNTER_HANDLE);
+    ASSERT_ARE_EQUAL(int, 0, telemetry_messenger_set_option(handle, MESSENGER_OPTION_BATCH_LINGER_MS, &linger_ms));
+    ASSERT_ARE_EQUAL(int, test_send_three_messages_config.number_test_events, send_events(handle, test_send_three_messages_config.number_test_events));
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_holding_pending_events(test_send_three_messages_config.number_test_events, &first_ms);
+
+    // act
+    telemetry_messenger_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // arrange
+    time_t current_time = time(NULL);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_holding_pending_events(test_send_three_messages_config.number_test_events, &second_ms);
+    set_expected_calls_for_message_do_work_send_pending_events(&test_send_three_messages_config, current_time);
+
+    // act
+    telemetry_messenger_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_008: [The events shall not be held if no event arrived since the previous telemetry_messenger_do_work(), or if `instance->batch_max_messages` events or `instance->batch_max_bytes` bytes of payload are waiting]
+TEST_FUNCTION(telemetry_messenger_do_work_batch_linger_full_batch_sent_immediately)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t linger_ms = 1000;
+    size_t max_messages = 3;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(tickcounter_create()).SetReturn(TEST_TICK_COUNTER_HANDLE);
+    ASSERT_ARE_EQUAL(int, 0, telemetry_messenger_set_option(handle, MESSENGER_OPTION_BATCH_LINGER_MS, &linger_ms));
+    ASSERT_ARE_EQUAL(int, 0, telemetry_messenger_set_option(handle, MESSENGER_OPTION_BATCH_MAX_MESSAGES, &max_messages));
+    ASSERT_ARE_EQUAL(int, test_send_three_messages_config.number_test_events, send_events(handle, test_send_three_messages_config.number_test_events));
+
+    time_t current_time = time(NULL);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_process_event_send_timeouts(0, DEFAULT_EVENT_SEND_TIMEOUT_SECS, current_time);
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    set_expected_calls_for_message_do_work_send_pending_events(&test_send_three_messages_config, current_time);
+
+    // act
+    telemetry_messenger_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
 TEST_FUNCTION(telemetry_messenger_do_work_send_events_one_message_success)
 {
     test_send_events(&test_send_one_message_config);
@@ -2423,6 +2677,86 @@ TEST_FUNCTION(telemetry_messenger_do_work_send_middle_message_too_big_and_rollov
     test_send_events(&test_send_middle_message_too_big_and_rollover_config);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_002: [If a message does not fit in the encode buffer, the buffer shall be replaced by one of at least twice its size, up to the maximum message size, and the message encoded again.]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_004: [The message shall be encoded directly into the encode buffer, which is reused for every message sent over the link.]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_015: [The message shall be encoded using `instance->sections_cache`.]
+TEST_FUNCTION(telemetry_messenger_do_work_send_events_grows_and_reuses_the_encode_buffer)
+{
+    test_send_events(&test_send_growing_messages_config);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_001: [The maximum message size shall be queried once per `instance->sender_link` and kept until the link is destroyed.]
+TEST_FUNCTION(telemetry_messenger_do_work_send_events_queries_the_max_message_size_once_per_link)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+    time_t current_time = time(NULL);
+
+    ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
+    MESSENGER_DO_WORK_EXP_CALL_PROFILE *do_work_profile = get_msgr_do_work_exp_call_profile(TELEMETRY_MESSENGER_STATE_STARTED, false, false, 1, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
+    crank_telemetry_messenger_do_work(handle, do_work_profile);
+
+    ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
+    do_work_profile = get_msgr_do_work_exp_call_profile(TELEMETRY_MESSENGER_STATE_STARTED, false, false, 1, 1, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_telemetry_messenger_do_work(do_work_profile);
+
+    // act
+    telemetry_messenger_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(TEST_max_message_size_queried);
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_199: [Errors specific to a message (e.g. failure to encode) are NOT fatal but we'll keep processing.  More general errors (e.g. out of memory) will stop processing.]
+TEST_FUNCTION(telemetry_messenger_do_work_send_events_encode_buffer_malloc_fails)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+    uint64_t peer_max_message_size = 100 + AMQP_BATCHING_RESERVE_SIZE;
+
+    ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
+
+    umock_c_reset_all_calls();
+
+    // timeout checks
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST)).SetReturn(NULL);
+
+    // send events
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_WAIT_TO_SEND_LIST, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(link_get_peer_max_message_size(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &peer_max_message_size, sizeof(peer_max_message_size));
+    set_expected_calls_for_create_send_pending_events_state();
+    set_expected_calls_for_message_encode_uamqp_from_iothub_message(10, 0);
+    STRICT_EXPECTED_CALL(malloc(10)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_foreach(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    set_expected_calls_free_task(0);
+    STRICT_EXPECTED_CALL(message_destroy(IGNORED_PTR_ARG));
+
+    // act
+    telemetry_messenger_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING, TEST_on_send_complete_data[0].result);
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_067: [If `instance->receive_messages` is true and `instance->message_receiver` is NULL, a message_receiver shall be created]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_068: [A variable, named `devices_path`, shall be created concatenating `instance->iothub_host_fqdn`, "/devices/" and `instance->device_id`]  
@@ -3234,6 +3568,76 @@ TEST_FUNCTION(telemetry_messenger_set_option_EVENT_SEND_TIMEOUT_SECS)
     telemetry_messenger_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_009: [If name matches MESSENGER_OPTION_BATCH_LINGER_MS, `value` shall be saved on `instance->batch_linger_ms`, creating `instance->linger_tick_counter` with tickcounter_create() the first time `value` is greater than zero]
+TEST_FUNCTION(telemetry_messenger_set_option_BATCH_LINGER_MS)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t value = 50;
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(tickcounter_create()).SetReturn(TEST_TICK_COUNTER_HANDLE);
+
+    // act
+    int result1 = telemetry_messenger_set_option(handle, MESSENGER_OPTION_BATCH_LINGER_MS, &value);
+    int result2 = telemetry_messenger_set_option(handle, MESSENGER_OPTION_BATCH_LINGER_MS, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_010: [If tickcounter_create() fails, telemetry_messenger_set_option shall fail and return a non-zero value]
+TEST_FUNCTION(telemetry_messenger_set_option_BATCH_LINGER_MS_tickcounter_create_fails)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t value = 50;
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(tickcounter_create()).SetReturn(NULL);
+
+    // act
+    int result = telemetry_messenger_set_option(handle, MESSENGER_OPTION_BATCH_LINGER_MS, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_11_011: [If name matches MESSENGER_OPTION_BATCH_MAX_BYTES or MESSENGER_OPTION_BATCH_MAX_MESSAGES, `value` shall be saved on `instance->batch_max_bytes` or `instance->batch_max_messages`]
+TEST_FUNCTION(telemetry_messenger_set_option_BATCH_MAX_BYTES_and_BATCH_MAX_MESSAGES)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t max_bytes = 4096;
+    size_t max_messages = 10;
+    umock_c_reset_all_calls();
+
+    // act
+    int result1 = telemetry_messenger_set_option(handle, MESSENGER_OPTION_BATCH_MAX_BYTES, &max_bytes);
+    int result2 = telemetry_messenger_set_option(handle, MESSENGER_OPTION_BATCH_MAX_MESSAGES, &max_messages);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_169: [If name matches MESSENGER_OPTION_SAVED_OPTIONS, `value` shall be applied using OptionHandler_FeedOptions]
 TEST_FUNCTION(telemetry_messenger_set_option_SAVED_OPTIONS)
 {
@@ -3483,6 +3887,12 @@ static void set_expected_calls_for_telemetry_messenger_retrieve_options()
 
     STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS, IGNORED_PTR_ARG))
         .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, MESSENGER_OPTION_BATCH_LINGER_MS, IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, MESSENGER_OPTION_BATCH_MAX_BYTES, IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, MESSENGER_OPTION_BATCH_MAX_MESSAGES, IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
 }
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_173: [If `messenger_handle` is NULL, telemetry_messenger_retrieve_options shall fail and return NULL]
@@ -646,6 +646,18 @@ static void set_expected_calls_for_device_set_option(DEVICE_HANDLE handle, DEVIC
     {
         STRICT_EXPECTED_CALL(telemetry_messenger_set_option(TEST_TELEMETRY_MESSENGER_HANDLE, MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS, option_value));
     }
+    else if (strcmp(DEVICE_OPTION_BATCH_LINGER_MS, option_name) == 0)
+    {
+        STRICT_EXPECTED_CALL(telemetry_messenger_set_option(TEST_TELEMETRY_MESSENGER_HANDLE, MESSENGER_OPTION_BATCH_LINGER_MS, option_value));
+    }
+    else if (strcmp(DEVICE_OPTION_BATCH_MAX_BYTES, option_name) == 0)
+    {
+        STRICT_EXPECTED_CALL(telemetry_messenger_set_option(TEST_TELEMETRY_MESSENGER_HANDLE, MESSENGER_OPTION_BATCH_MAX_BYTES, option_value));
+    }
+    else if (strcmp(DEVICE_OPTION_BATCH_MAX_MESSAGES, option_name) == 0)
+    {
+        STRICT_EXPECTED_CALL(telemetry_messenger_set_option(TEST_TELEMETRY_MESSENGER_HANDLE, MESSENGER_OPTION_BATCH_MAX_MESSAGES, option_value));
+    }
     else if (strcmp(DEVICE_OPTION_SAVED_MESSENGER_OPTIONS, option_name) == 0)
     {
         STRICT_EXPECTED_CALL(OptionHandler_FeedOptions((OPTIONHANDLER_HANDLE)option_value, TEST_TELEMETRY_MESSENGER_HANDLE));
@@ -1790,6 +1802,40 @@ TEST_FUNCTION(device_set_option_MSGR_succeeds)
     device_destroy(handle);
 }
 
+// Tests_SRS_DEVICE_11_001: [If `name` is DEVICE_OPTION_BATCH_LINGER_MS, DEVICE_OPTION_BATCH_MAX_BYTES or DEVICE_OPTION_BATCH_MAX_MESSAGES, `value` shall be passed to telemetry_messenger_set_option as the matching MESSENGER_OPTION_BATCH_* option]
+// Tests_SRS_DEVICE_09_092: [If no failures occur, device_set_option shall return 0]
+TEST_FUNCTION(device_set_option_MSGR_batching_succeeds)
+{
+    // arrange
+    ASSERT_IS_TRUE_WITH_MSG(INDEFINITE_TIME != TEST_current_time, "Failed setting TEST_current_time");
+
+    DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_CBS);
+    DEVICE_HANDLE handle = create_and_start_device(config, TEST_current_time);
+
+    size_t linger_ms = 20;
+    size_t max_bytes = 65536;
+    size_t max_messages = 50;
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_device_set_option(handle, config, DEVICE_OPTION_BATCH_LINGER_MS, &linger_ms);
+    set_expected_calls_for_device_set_option(handle, config, DEVICE_OPTION_BATCH_MAX_BYTES, &max_bytes);
+    set_expected_calls_for_device_set_option(handle, config, DEVICE_OPTION_BATCH_MAX_MESSAGES, &max_messages);
+
+    // act
+    int result1 = device_set_option(handle, DEVICE_OPTION_BATCH_LINGER_MS, &linger_ms);
+    int result2 = device_set_option(handle, DEVICE_OPTION_BATCH_MAX_BYTES, &max_bytes);
+    int result3 = device_set_option(handle, DEVICE_OPTION_BATCH_MAX_MESSAGES, &max_messages);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(int, 0, result3);
+
+    // cleanup
+    device_destroy(handle);
+}
+
 // Tests_SRS_DEVICE_09_088: [If `name` is DEVICE_OPTION_SAVED_AUTH_OPTIONS but CBS authentication is not being used, device_set_option shall return a non-zero result]
 TEST_FUNCTION(device_set_option_X509_saved_auth_options)
 {
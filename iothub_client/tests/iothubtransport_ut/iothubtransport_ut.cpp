@@ -11,6 +11,7 @@
 #include "iothubtransport.h"
 
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/vector.h"
 
@@ -72,6 +73,8 @@ static void* threadFuncArg;
 #define TEST_LOCK_HANDLE (LOCK_HANDLE)0x4443
 #define TEST_CLIENTS_LOCK_HANDLE (LOCK_HANDLE)0x4445
 #define TEST_THREAD_HANDLE (THREAD_HANDLE)0x4442
+#define TEST_COND_HANDLE (COND_HANDLE)0x4446
+#define TEST_WAKE_LOCK_HANDLE (LOCK_HANDLE)0x4447
 
 
 
@@ -382,6 +385,20 @@ public:
     MOCK_STATIC_METHOD_1(, LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, handle);
     MOCK_METHOD_END(LOCK_RESULT, LOCK_OK);
 
+    /* Condition mocks */
+    MOCK_STATIC_METHOD_0(, COND_HANDLE, Condition_Init);
+    MOCK_METHOD_END(COND_HANDLE, TEST_COND_HANDLE);
+    MOCK_STATIC_METHOD_1(, COND_RESULT, Condition_Post, COND_HANDLE, handle);
+    MOCK_METHOD_END(COND_RESULT, COND_OK);
+    MOCK_STATIC_METHOD_3(, COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds)
+        if ((howManyDoWorkCalls > 0) && (howManyDoWorkCalls == doWorkCallCount))
+        {
+            * (sig_atomic_t*)(((char*)threadFuncArg) + IoTHubTransport_ThreadTerminationOffset) = 1; /*tell the thread to stop*/
+        }
+    MOCK_METHOD_END(COND_RESULT, COND_TIMEOUT);
+    MOCK_STATIC_METHOD_1(, void, Condition_Deinit, COND_HANDLE, handle);
+    MOCK_VOID_METHOD_END();
+
 };
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , void, DList_InitializeListHead, PDLIST_ENTRY, listHead);
@@ -454,6 +471,11 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , LOCK_RESULT, Lock, LOCK_HA
 DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , LOCK_RESULT, Unlock, LOCK_HANDLE, handle);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, handle);
 
+DECLARE_GLOBAL_MOCK_METHOD_0(CIotHubTransportMocks, , COND_HANDLE, Condition_Init);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , COND_RESULT, Condition_Post, COND_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_3(CIotHubTransportMocks, , COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , void, Condition_Deinit, COND_HANDLE, handle);
+
 static TRANSPORT_PROVIDER FAKE_transport_provider =
 {
     FAKE_IoTHubTransport_SendMessageDisposition,
@@ -747,6 +769,11 @@ TEST_FUNCTION(IoTHubTransport_Destroy_success_thread_join_fails)
 
     STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -758,6 +785,9 @@ TEST_FUNCTION(IoTHubTransport_Destroy_success_thread_join_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(TEST_COND_HANDLE));
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
@@ -897,6 +927,8 @@ TEST_FUNCTION(IoTHubTransport_GetLLTransport_fail)
 //Tests_SRS_IOTHUBTRANSPORT_17_018: [ If the worker thread does not exist, IoTHubTransport_StartWorkerThread shall start the thread using ThreadAPI_Create. ]
 //Tests_SRS_IOTHUBTRANSPORT_17_021: [ If handle is not found, then clientHandle shall be added to the list. ]
 //Tests_SRS_IOTHUBTRANSPORT_17_022: [ Upon success, IoTHubTransport_StartWorkerThread shall return IOTHUB_CLIENT_OK.]
+//Tests_SRS_IOTHUBTRANSPORT_11_003: [ Before starting the worker thread, IoTHubTransport_StartWorkerThread shall create the condition the thread waits on by calling Condition_Init. ]
+//Tests_SRS_IOTHUBTRANSPORT_11_009: [ IoTHubTransport_StartWorkerThread shall also create the lock the thread waits with by calling Lock_Init; the thread shall never hold it while it calls the lower layer transport DoWork. ]
 TEST_FUNCTION(IoTHubTransport_StartWorkerThread_success)
 {
     CIotHubTransportMocks mocks;
@@ -905,6 +937,8 @@ TEST_FUNCTION(IoTHubTransport_StartWorkerThread_success)
     auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
     mocks.ResetAllCalls();
 
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, transportHandle))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -1045,6 +1079,8 @@ TEST_FUNCTION(IoTHubTransport_StartWorkerThread_thread_create_fails_returns_erro
     auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
     mocks.ResetAllCalls();
 
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, transportHandle))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
@@ -1061,6 +1097,53 @@ TEST_FUNCTION(IoTHubTransport_StartWorkerThread_thread_create_fails_returns_erro
     IoTHubTransport_Destroy(transportHandle);
 }
 
+//Tests_SRS_IOTHUBTRANSPORT_17_019: [ If thread creation fails, IoTHubTransport_StartWorkerThread shall return IOTHUB_CLIENT_ERROR. ]
+TEST_FUNCTION(IoTHubTransport_StartWorkerThread_condition_init_fails_returns_error)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Condition_Init())
+        .SetFailReturn((COND_HANDLE)NULL);
+    ///act
+
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)result, (int)IOTHUB_CLIENT_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_11_009: [ IoTHubTransport_StartWorkerThread shall also create the lock the thread waits with by calling Lock_Init; the thread shall never hold it while it calls the lower layer transport DoWork. ]
+TEST_FUNCTION(IoTHubTransport_StartWorkerThread_wake_lock_init_fails_returns_error)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init())
+        .SetFailReturn((LOCK_HANDLE)NULL);
+    ///act
+
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)result, (int)IOTHUB_CLIENT_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
 //Tests_SRS_IOTHUBTRANSPORT_17_042: [ If Adding to the client list fails, IoTHubTransport_StartWorkerThread shall return IOTHUB_CLIENT_ERROR. ]
 TEST_FUNCTION(IoTHubTransport_StartWorkerThread_Vector_push_back_returns_error)
 {
@@ -1072,6 +1155,8 @@ TEST_FUNCTION(IoTHubTransport_StartWorkerThread_Vector_push_back_returns_error)
 
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, transportHandle))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -1100,6 +1185,7 @@ TEST_FUNCTION(IoTHubTransport_StartWorkerThread_Vector_push_back_returns_error)
 //Tests_SRS_IOTHUBTRANSPORT_17_026: [ IoTHubTransport_SignalEndWorkerThread shall remove clientHandlehandle from handle list. ]
 //Tests_SRS_IOTHUBTRANSPORT_17_028: [ The thread shall exit when IoTHubTransport_SignalEndWorkerThread has been called for each clientHandle which invoked IoTHubTransport_StartWorkerThread. ]
 //Tests_SRS_IOTHUBTRANSPORT_17_043: [ IoTHubTransport_SignalEndWorkerThread shall signal the worker thread to end. ]
+//Tests_SRS_IOTHUBTRANSPORT_11_008: [ IoTHubTransport_SignalEndWorkerThread shall hold the transport lock while it signals the worker thread to end. ]
 TEST_FUNCTION(IoTHubTransport_SignalEndWorkerThread_success)
 {
     CIotHubTransportMocks mocks;
@@ -1119,6 +1205,15 @@ TEST_FUNCTION(IoTHubTransport_SignalEndWorkerThread_success)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreAllArguments();
 
@@ -1326,7 +1421,7 @@ TEST_FUNCTION(IoTHubTransport_JoinWorkerThread_join_fails)
     IoTHubTransport_Destroy(transportHandle);
 }
 
-//Tests_SRS_IOTHUBTRANSPORT_17_029: [ The thread shall call lower layer transport DoWork every 1 ms. ]
+//Tests_SRS_IOTHUBTRANSPORT_17_029: [ The thread shall call lower layer transport DoWork repeatedly, waiting between calls as described by SRS_IOTHUBTRANSPORT_11_001 and SRS_IOTHUBTRANSPORT_11_002. ]
 //Tests_SRS_IOTHUBTRANSPORT_17_030: [ All calls to lower layer transport DoWork shall be protected by the lock created in IoTHubTransport_Create. ]
 TEST_FUNCTION(IoTHubTransport_worker_thread_runs_every_1_ms)
 {
@@ -1334,6 +1429,8 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_every_1_ms)
     ///arrange
 
     auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init())
+        .SetReturn(TEST_WAKE_LOCK_HANDLE);
     (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
     mocks.ResetAllCalls();
 
@@ -1349,7 +1446,9 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_every_1_ms)
     EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_WAKE_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(TEST_COND_HANDLE, TEST_WAKE_LOCK_HANDLE, 1));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_WAKE_LOCK_HANDLE));
 
     STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
     STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
@@ -1360,7 +1459,9 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_every_1_ms)
     EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_WAKE_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(TEST_COND_HANDLE, TEST_WAKE_LOCK_HANDLE, 1));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_WAKE_LOCK_HANDLE));
 
     STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
     STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
@@ -1380,7 +1481,7 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_every_1_ms)
     IoTHubTransport_Destroy(transportHandle);
 }
 
-//Tests_SRS_IOTHUBTRANSPORT_17_029: [ The thread shall call lower layer transport DoWork every 1 ms. ]
+//Tests_SRS_IOTHUBTRANSPORT_17_029: [ The thread shall call lower layer transport DoWork repeatedly, waiting between calls as described by SRS_IOTHUBTRANSPORT_11_001 and SRS_IOTHUBTRANSPORT_11_002. ]
 //Tests_SRS_IOTHUBTRANSPORT_17_030: [ All calls to lower layer transport DoWork shall be protected by the lock created in IoTHubTransport_Create. 
 TEST_FUNCTION(IoTHubTransport_worker_thread_runs_two_devices_once)
 {
@@ -1388,6 +1489,8 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_two_devices_once)
     ///arrange
 
     auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init())
+        .SetReturn(TEST_WAKE_LOCK_HANDLE);
     (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
     (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2, clientDoWork);
     mocks.ResetAllCalls();
@@ -1405,7 +1508,9 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_two_devices_once)
     EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_WAKE_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(TEST_COND_HANDLE, TEST_WAKE_LOCK_HANDLE, 1));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_WAKE_LOCK_HANDLE));
 
     STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
     STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
@@ -1432,6 +1537,8 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_lock_fails)
     ///arrange
 
     auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init())
+        .SetReturn(TEST_WAKE_LOCK_HANDLE);
     (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
     (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2, clientDoWork);
     mocks.ResetAllCalls();
@@ -1439,7 +1546,9 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_lock_fails)
     howManyDoWorkCalls = 1;
     STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
         .SetFailReturn(LOCK_ERROR);
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_WAKE_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(TEST_COND_HANDLE, TEST_WAKE_LOCK_HANDLE, 1));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_WAKE_LOCK_HANDLE));
 
     /* DoWork needs to run at least once, so, the number of calls to DoWork increments. */
     STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
@@ -1452,7 +1561,9 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_lock_fails)
     EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_WAKE_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(TEST_COND_HANDLE, TEST_WAKE_LOCK_HANDLE, 1));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_WAKE_LOCK_HANDLE));
 
     STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
     STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
@@ -1478,5 +1589,170 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_lock_fails)
     IoTHubTransport_Destroy(transportHandle);
 }
 
+//Tests_SRS_IOTHUBTRANSPORT_11_002: [ Otherwise the thread shall wait on its condition for the current idle wait, which doubles each time up to the value set with IoTHubTransport_SetWorkerMaxIdleWait. ]
+TEST_FUNCTION(IoTHubTransport_worker_thread_idle_wait_doubles_up_to_max)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init())
+        .SetReturn(TEST_WAKE_LOCK_HANDLE);
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
+    (void)IoTHubTransport_SetWorkerMaxIdleWait(transportHandle, 4);
+    mocks.ResetAllCalls();
+
+    howManyDoWorkCalls = 4;
+    clientDoWork_calls = 0;
+    for (size_t i = 0; i < howManyDoWorkCalls; i++)
+    {
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
+        STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+        EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_WAKE_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_WAKE_LOCK_HANDLE));
+    }
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(TEST_COND_HANDLE, TEST_WAKE_LOCK_HANDLE, 1));
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(TEST_COND_HANDLE, TEST_WAKE_LOCK_HANDLE, 2));
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(TEST_COND_HANDLE, TEST_WAKE_LOCK_HANDLE, 4));
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(TEST_COND_HANDLE, TEST_WAKE_LOCK_HANDLE, 4));
+
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Exit(0));
+
+    ///act
+    threadFunc(threadFuncArg);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_11_004: [ If transportHandle is NULL, IoTHubTransport_SignalWorkerThread shall do nothing. ]
+TEST_FUNCTION(IoTHubTransport_SignalWorkerThread_null_transport_does_nothing)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    ///act
+    IoTHubTransport_SignalWorkerThread(NULL);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_11_005: [ IoTHubTransport_SignalWorkerThread shall mark work as pending and, if the worker thread was started, call Condition_Post to wake it. ]
+//Tests_SRS_IOTHUBTRANSPORT_11_010: [ IoTHubTransport_SignalWorkerThread shall not take the transport lock; it shall call Condition_Post while holding the lock the worker thread waits with. ]
+TEST_FUNCTION(IoTHubTransport_SignalWorkerThread_posts_the_condition)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init())
+        .SetReturn(TEST_WAKE_LOCK_HANDLE);
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_WAKE_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_WAKE_LOCK_HANDLE));
+
+    ///act
+    IoTHubTransport_SignalWorkerThread(transportHandle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_11_005: [ IoTHubTransport_SignalWorkerThread shall mark work as pending and, if the worker thread was started, call Condition_Post to wake it. ]
+TEST_FUNCTION(IoTHubTransport_SignalWorkerThread_before_thread_start_does_not_post)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    mocks.ResetAllCalls();
+
+    ///act
+    IoTHubTransport_SignalWorkerThread(transportHandle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_11_006: [ If transportHandle is NULL, or maxIdleWaitMs is 0 or greater than 1000, IoTHubTransport_SetWorkerMaxIdleWait shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransport_SetWorkerMaxIdleWait_null_transport_returns_bad_arg)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_SetWorkerMaxIdleWait(NULL, 10);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)result, (int)IOTHUB_CLIENT_INVALID_ARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_11_006: [ If transportHandle is NULL, or maxIdleWaitMs is 0 or greater than 1000, IoTHubTransport_SetWorkerMaxIdleWait shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransport_SetWorkerMaxIdleWait_out_of_range_returns_bad_arg)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    mocks.ResetAllCalls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result1 = IoTHubTransport_SetWorkerMaxIdleWait(transportHandle, 0);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubTransport_SetWorkerMaxIdleWait(transportHandle, 1001);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)result1, (int)IOTHUB_CLIENT_INVALID_ARG);
+    ASSERT_ARE_EQUAL(int, (int)result2, (int)IOTHUB_CLIENT_INVALID_ARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_11_007: [ IoTHubTransport_SetWorkerMaxIdleWait shall store the maximum idle wait of the worker thread and return IOTHUB_CLIENT_OK. ]
+TEST_FUNCTION(IoTHubTransport_SetWorkerMaxIdleWait_succeeds)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    mocks.ResetAllCalls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_SetWorkerMaxIdleWait(transportHandle, 1000);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)result, (int)IOTHUB_CLIENT_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
 END_TEST_SUITE(iothubtransport_ut)
 
@@ -48,6 +48,8 @@ static void my_gballoc_free(void* ptr)
 #include "iothub_client_options.h"
 #include "iothub_client_version.h"
 #include "iothub_client_private.h"
+#include "http_batch_payload.h"
+#include "http_connection_pool.h"
 #undef ENABLE_MOCKS
 
 #include "iothubtransporthttp.h"
@@ -63,6 +65,7 @@ extern "C" {
     extern unsigned char* real_BUFFER_u_char(BUFFER_HANDLE handle);
     extern size_t real_BUFFER_length(BUFFER_HANDLE handle);
     extern int real_BUFFER_build(BUFFER_HANDLE handle, const unsigned char* source, size_t size);
+    extern int real_BUFFER_pre_build(BUFFER_HANDLE handle, size_t size);
     extern int real_BUFFER_append_build(BUFFER_HANDLE handle, const unsigned char* source, size_t size);
     extern BUFFER_HANDLE real_BUFFER_clone(BUFFER_HANDLE handle);
     extern BUFFER_HANDLE real_BUFFER_create(const unsigned char* source, size_t size);
@@ -132,6 +135,7 @@ IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUB_CLIENT_CONFIRMATION_RESULT, IOTHUB_CLIENT_CON
 #define TEST_PROPERTY_A_VALUE "value_of_a"
 
 #define TEST_HTTPAPIEX_HANDLE (HTTPAPIEX_HANDLE)0x343
+#define TEST_HTTP_CONNECTION_POOL_HANDLE (HTTP_CONNECTION_POOL_HANDLE)0x344
 
 //static const bool thisIsTrue = true;
 //static const bool thisIsFalse = false;
@@ -538,6 +542,32 @@ static bool my_IoTHubClient_LL_MessageCallback(IOTHUB_CLIENT_LL_HANDLE handle, M
     return my_IoTHubClient_LL_MessageCallback_return_value;
 }
 
+static size_t my_IoTHubClient_LL_SendComplete_calls;
+static void my_IoTHubClient_LL_SendComplete(IOTHUB_CLIENT_LL_HANDLE handle, PDLIST_ENTRY completed, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
+{
+    (void)handle;
+    (void)completed;
+    (void)result;
+    my_IoTHubClient_LL_SendComplete_calls++;
+}
+
+static bool my_http_connection_pool_run_does_the_work;
+static size_t my_http_connection_pool_run_callbacks_during_run;
+static int my_http_connection_pool_run(HTTP_CONNECTION_POOL_HANDLE pool, HTTPAPIEX_HANDLE callerConnection, size_t itemCount, size_t firstItem, HTTP_CONNECTION_POOL_WORK work, void* context)
+{
+    (void)pool;
+    if (my_http_connection_pool_run_does_the_work)
+    {
+        size_t i;
+        for (i = 0; i < itemCount; i++)
+        {
+            work(context, (firstItem + i) % itemCount, callerConnection);
+        }
+        my_http_connection_pool_run_callbacks_during_run = my_IoTHubClient_LL_SendComplete_calls + ((my_IoTHubClient_LL_MessageCallback_messageData != NULL) ? 1 : 0);
+    }
+    return 0;
+}
+
 static HTTP_HEADERS_HANDLE my_HTTPHeaders_Alloc(void)
 {
     return (HTTP_HEADERS_HANDLE)my_gballoc_malloc(1);
@@ -839,6 +869,48 @@ static MAP_RESULT my_Map_GetInternals(MAP_HANDLE handle, const char*const** keys
     return MAP_OK;
 }
 
+static IOTHUB_MESSAGE_PROPERTY test_property_table[2];
+
+/*the property table of a message holds the same properties as its map*/
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_GetPropertyTable(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const IOTHUB_MESSAGE_PROPERTY** properties, size_t* count)
+{
+    const char*const* keys;
+    const char*const* values;
+    size_t i;
+
+    (void)my_Map_GetInternals(my_IoTHubMessage_Properties(iotHubMessageHandle), &keys, &values, count);
+    ASSERT_IS_TRUE(*count <= sizeof(test_property_table) / sizeof(test_property_table[0]));
+    for (i = 0; i < *count; i++)
+    {
+        test_property_table[i].key = keys[i];
+        test_property_table[i].keyLength = strlen(keys[i]);
+        test_property_table[i].value = values[i];
+        test_property_table[i].valueLength = strlen(values[i]);
+    }
+    *properties = (*count == 0) ? NULL : test_property_table;
+    return IOTHUB_MESSAGE_OK;
+}
+
+/*every message of a batch is written as this item, the comma after the last one becomes the "]"*/
+#define TEST_BATCH_ITEM "{\"body\":\"\"},"
+
+static int my_http_batch_payload_measure_item(IOTHUB_MESSAGE_HANDLE message, size_t* item_size, size_t* message_size)
+{
+    (void)message;
+    *item_size = sizeof(TEST_BATCH_ITEM) - 1;
+    *message_size = 0;
+    return 0;
+}
+
+static int my_http_batch_payload_write_item(IOTHUB_MESSAGE_HANDLE message, unsigned char* destination, size_t capacity, size_t* item_size)
+{
+    (void)message;
+    ASSERT_IS_TRUE(capacity >= sizeof(TEST_BATCH_ITEM) - 1);
+    (void)memcpy(destination, TEST_BATCH_ITEM, sizeof(TEST_BATCH_ITEM) - 1);
+    *item_size = sizeof(TEST_BATCH_ITEM) - 1;
+    return 0;
+}
+
 static void setupCreateHappyPathAlloc(bool deallocateCreated)
 {
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
@@ -1136,6 +1208,9 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_SAS_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPI_REQUEST_TYPE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_CONNECTION_POOL_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_CONNECTION_POOL_WORK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_HANDLE, void*);
 
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CONFIRMATION_RESULT, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
@@ -1154,6 +1229,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_delete, real_BUFFER_delete);
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_build, real_BUFFER_build);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_build, __LINE__);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_pre_build, real_BUFFER_pre_build);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_pre_build, __LINE__);
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, real_BUFFER_u_char);
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_length, real_BUFFER_length);
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_clone, real_BUFFER_clone);
@@ -1177,6 +1254,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_Create, my_HTTPAPIEX_Create);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_Create, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_Destroy, my_HTTPAPIEX_Destroy);
+    REGISTER_GLOBAL_MOCK_RETURN(http_connection_pool_create, TEST_HTTP_CONNECTION_POOL_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(http_connection_pool_create, NULL);
 
     REGISTER_GLOBAL_MOCK_HOOK(VECTOR_create, real_VECTOR_create);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(VECTOR_create, NULL);
@@ -1212,6 +1291,13 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_Destroy, my_IoTHubMessage_Destroy);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_Properties, my_IoTHubMessage_Properties);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_Properties, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetPropertyTable, my_IoTHubMessage_GetPropertyTable);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetPropertyTable, IOTHUB_MESSAGE_ERROR);
+
+    REGISTER_GLOBAL_MOCK_HOOK(http_batch_payload_measure_item, my_http_batch_payload_measure_item);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(http_batch_payload_measure_item, __LINE__);
+    REGISTER_GLOBAL_MOCK_HOOK(http_batch_payload_write_item, my_http_batch_payload_write_item);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(http_batch_payload_write_item, __LINE__);
 
     REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_Alloc, my_HTTPHeaders_Alloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_Alloc, NULL);
@@ -1225,6 +1311,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_LL_GetOption, IOTHUB_CLIENT_ERROR);
 
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_MessageCallback, my_IoTHubClient_LL_MessageCallback);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_SendComplete, my_IoTHubClient_LL_SendComplete);
+    REGISTER_GLOBAL_MOCK_HOOK(http_connection_pool_run, my_http_connection_pool_run);
 
     REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_SAS_Create, my_HTTPAPIEX_SAS_Create);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_SAS_Create, NULL);
@@ -1313,6 +1401,9 @@ TEST_FUNCTION_INITIALIZE(method_init)
 
     my_IoTHubClient_LL_MessageCallback_messageData = NULL;
     my_IoTHubClient_LL_MessageCallback_return_value = true;
+    my_IoTHubClient_LL_SendComplete_calls = 0;
+    my_http_connection_pool_run_does_the_work = false;
+    my_http_connection_pool_run_callbacks_during_run = 0;
 }
 
 TEST_FUNCTION_CLEANUP(method_cleanup)
@@ -13999,8 +14090,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_GetMessageId_succeeds)
         .IgnoreArgument(1);
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPropertyTable(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     /*this is making http headers*/
     STRICT_EXPECTED_CALL(STRING_construct("iothub-app-"));
     STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, TEST_RED_KEY));
@@ -14067,8 +14157,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_GetCorrelationId_succeeds)
     STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"));
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPropertyTable(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     /*this is making http headers*/
     STRICT_EXPECTED_CALL(STRING_construct("iothub-app-"));
@@ -14144,8 +14233,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_GetCustomContentType_succeeds)
     STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"));
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPropertyTable(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     /*this is making http headers*/
     STRICT_EXPECTED_CALL(STRING_construct("iothub-app-"));
@@ -14221,8 +14309,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_GetContentEncoding_succeeds)
     STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"));
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPropertyTable(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     /*this is making http headers*/
     STRICT_EXPECTED_CALL(STRING_construct("iothub-app-"));
@@ -14279,6 +14366,383 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_GetContentEncoding_succeeds)
     IoTHubTransportHttp_Destroy(handle);
 }
 
+//Tests_SRS_TRANSPORTMULTITHTTP_17_053: [ If option SetBatching is true then _DoWork shall send batched event message as specced below. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_054: [ Request HTTP headers shall have the value of "Content-Type" created or updated to "application/vnd.microsoft.iothub.json" by a call to HTTPHeaders_ReplaceHeaderNameValuePair. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_056: [ IoTHubTransportHttp_DoWork shall build the following string:[{"body":"base64 encoding of the message1 content"},{"body":"base64 encoding of the message2 content"}...] ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_068: [ Once a final payload has been obtained, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters: ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_070: [ If HTTPAPIEX_SAS_ExecuteRequest2 does not fail and http status code < 300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list containing all the items batched, and parameter IOTHUB_BATCHSTATE result shall be set to IOTHUB_BATCHSTATE_OK. The batched items shall be removed from waitingToSend. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_batched_events_measures_then_writes_the_items_succeeds)
+{
+    //arrange
+    const char expectedPayload[] = "[" TEST_BATCH_ITEM TEST_BATCH_ITEM;
+    const size_t expectedPayloadSize = sizeof(expectedPayload) - 1;
+    bool batching = true;
+
+    DList_InsertTailList(&(waitingToSend), &(message1.entry));
+    DList_InsertTailList(&(waitingToSend), &(message2.entry));
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING, &batching);
+
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"));
+
+    /*first pass: the items are only measured*/
+    STRICT_EXPECTED_CALL(http_batch_payload_measure_item(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, &(message1.entry)));
+    STRICT_EXPECTED_CALL(http_batch_payload_measure_item(message2.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, &(message2.entry)));
+
+    /*second pass: the payload is allocated once and the items are written in it*/
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(BUFFER_pre_build(IGNORED_PTR_ARG, expectedPayloadSize));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(http_batch_payload_write_item(message1.messageHandle, IGNORED_PTR_ARG, expectedPayloadSize - 1, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(http_batch_payload_write_item(message2.messageHandle, IGNORED_PTR_ARG, expectedPayloadSize - 1 - (sizeof(TEST_BATCH_ITEM) - 1), IGNORED_PTR_ARG));
+
+    /*executing HTTP goodies*/
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(
+        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+        IGNORED_PTR_ARG,
+        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
+        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
+        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
+        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
+        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
+        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
+        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
+    ))
+        .IgnoreArgument_requestType()
+        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
+    ASSERT_ARE_EQUAL(size_t, expectedPayloadSize, real_BUFFER_length(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(real_BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), "[" "{\"body\":\"\"}," "{\"body\":\"\"}]", expectedPayloadSize));
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_11_004: [ "MaximumPollingTime" ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_MaximumPollingTime_succeeds)
+{
+    //arrange
+    unsigned int thisIs10Minutes = 600;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SetOption(handle, OPTION_MAX_POLLING_TIME, &thisIs10Minutes);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_11_007: [ If the connection count is 0, IoTHubTransportHttp_SetOption shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_HttpConnectionCount_0_fails)
+{
+    //arrange
+    unsigned int connectionCount = 0;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_CONNECTION_COUNT, &connectionCount);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_11_006: [ "HttpConnectionCount" ]
+//Tests_SRS_TRANSPORTMULTITHTTP_11_009: [ Otherwise IoTHubTransportHttp_SetOption shall replace the connection pool by one of connectionCount - 1 connections, given the options passed down so far, by calling http_connection_pool_create. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_HttpConnectionCount_creates_the_connection_pool)
+{
+    //arrange
+    unsigned int connectionCount = 4;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(http_connection_pool_create(IGNORED_PTR_ARG, 3, NULL))
+        .IgnoreArgument_hostName();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_CONNECTION_COUNT, &connectionCount);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_11_011: [ If http_connection_pool_create fails, IoTHubTransportHttp_SetOption shall keep the connections it had and return IOTHUB_CLIENT_ERROR. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_HttpConnectionCount_fails_when_http_connection_pool_create_fails)
+{
+    //arrange
+    unsigned int connectionCount = 4;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(http_connection_pool_create(IGNORED_PTR_ARG, 3, NULL))
+        .IgnoreArgument_hostName()
+        .SetReturn(NULL);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_CONNECTION_COUNT, &connectionCount);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_11_008: [ If the connection count is 1, IoTHubTransportHttp_SetOption shall destroy the connection pool, if any, and succeed. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_HttpConnectionCount_1_destroys_the_connection_pool)
+{
+    //arrange
+    unsigned int connectionCount = 4;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_CONNECTION_COUNT, &connectionCount);
+    umock_c_reset_all_calls();
+
+    connectionCount = 1;
+    STRICT_EXPECTED_CALL(http_connection_pool_destroy(TEST_HTTP_CONNECTION_POOL_HANDLE));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_CONNECTION_COUNT, &connectionCount);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_11_005: [ If the transport has more than one connection and more than one device, IoTHubTransportHttp_DoWork shall work on the devices in parallel by calling http_connection_pool_run, starting with the device after the one it started with the previous time. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_connection_pool_runs_the_devices_in_parallel_starting_with_the_next_device_each_time)
+{
+    //arrange
+    unsigned int connectionCount = 2;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_2, TEST_IOTHUB_CLIENT_LL_HANDLE2, TEST_CONFIG2.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_CONNECTION_COUNT, &connectionCount);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(http_connection_pool_run(TEST_HTTP_CONNECTION_POOL_HANDLE, IGNORED_PTR_ARG, 2, 0, IGNORED_PTR_ARG, handle))
+        .IgnoreArgument_callerConnection()
+        .IgnoreArgument_work();
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(http_connection_pool_run(TEST_HTTP_CONNECTION_POOL_HANDLE, IGNORED_PTR_ARG, 2, 1, IGNORED_PTR_ARG, handle))
+        .IgnoreArgument_callerConnection()
+        .IgnoreArgument_work();
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(http_connection_pool_run(TEST_HTTP_CONNECTION_POOL_HANDLE, IGNORED_PTR_ARG, 2, 0, IGNORED_PTR_ARG, handle))
+        .IgnoreArgument_callerConnection()
+        .IgnoreArgument_work();
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 1));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_11_012: [ While a worker thread of the pool works on a device, IoTHubClient_LL_SendComplete and IoTHubClient_LL_MessageCallback shall not be called; IoTHubTransportHttp_DoWork shall call them for every device once http_connection_pool_run returns. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_connection_pool_confirms_the_events_after_http_connection_pool_run_returns)
+{
+    //arrange
+    unsigned int connectionCount = 2;
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_2, TEST_IOTHUB_CLIENT_LL_HANDLE2, TEST_CONFIG2.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_CONNECTION_COUNT, &connectionCount);
+    my_http_connection_pool_run_does_the_work = true;
+    umock_c_reset_all_calls();
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 0, my_http_connection_pool_run_callbacks_during_run);
+    ASSERT_ARE_EQUAL(size_t, 1, my_IoTHubClient_LL_SendComplete_calls);
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_11_001: [ A GET request that happens earlier than the current interval between GETs, which starts at GetMinimumPollingTime, shall be ignored. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_11_002: [ A GET that returns a message shall bring the interval between GETs back to GetMinimumPollingTime and, if MaximumPollingTime is above MinimumPollingTime, allow the next GET no matter how much time has passed. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_after_a_message_was_received_polls_again_immediately)
+{
+    //arrange
+    unsigned int statusCode200 = 200;
+    char* real_ETAG = (char*)malloc(sizeof(TEST_ETAG_VALUE) + 1);
+    (void)sprintf(real_ETAG, "%s", TEST_ETAG_VALUE);
+
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+
+    unsigned int maxPollingTime = 2 * TEST_DEFAULT_GETMINIMUMPOLLINGTIME;
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MAX_POLLING_TIME, &maxPollingTime);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    umock_c_reset_all_calls();
+
+    /*the first GET returns a message*/
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_requestType()
+        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+    STRICT_EXPECTED_CALL(HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
+        .SetReturn(real_ETAG);
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .SetReturn(TEST_IOTHUB_MESSAGE_HANDLE_8);
+    STRICT_EXPECTED_CALL(HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(IGNORED_PTR_ARG)).SetReturn(TEST_IOTHUB_MESSAGE_HANDLE_8);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_NUM_ARG, IGNORED_NUM_ARG))
+        .CopyOutArgumentBuffer_destination(&real_ETAG, sizeof(&real_ETAG));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_MessageCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    umock_c_reset_all_calls();
+
+    /*the second GET happens right away, no time is compared*/
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc())
+        .SetReturn(NULL);
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_SendMessageDisposition(my_IoTHubClient_LL_MessageCallback_messageData, IOTHUBMESSAGE_ACCEPTED);
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_11_001: [ A GET request that happens earlier than the current interval between GETs, which starts at GetMinimumPollingTime, shall be ignored. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_11_002: [ A GET that returns a message shall bring the interval between GETs back to GetMinimumPollingTime and, if MaximumPollingTime is above MinimumPollingTime, allow the next GET no matter how much time has passed. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_after_a_message_was_received_with_default_options_waits_for_MinimumPollingTime)
+{
+    //arrange
+    unsigned int statusCode200 = 200;
+    char* real_ETAG = (char*)malloc(sizeof(TEST_ETAG_VALUE) + 1);
+    (void)sprintf(real_ETAG, "%s", TEST_ETAG_VALUE);
+
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    umock_c_reset_all_calls();
+
+    /*the first GET returns a message*/
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE);
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_requestType()
+        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+    STRICT_EXPECTED_CALL(HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
+        .SetReturn(real_ETAG);
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .SetReturn(TEST_IOTHUB_MESSAGE_HANDLE_8);
+    STRICT_EXPECTED_CALL(HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(IGNORED_PTR_ARG)).SetReturn(TEST_IOTHUB_MESSAGE_HANDLE_8);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_NUM_ARG, IGNORED_NUM_ARG))
+        .CopyOutArgumentBuffer_destination(&real_ETAG, sizeof(&real_ETAG));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_MessageCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    umock_c_reset_all_calls();
+
+    /*without MaximumPollingTime the second GET still waits for MinimumPollingTime*/
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE);
+    STRICT_EXPECTED_CALL(get_difftime(TEST_GET_TIME_VALUE, TEST_GET_TIME_VALUE));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_SendMessageDisposition(my_IoTHubClient_LL_MessageCallback_messageData, IOTHUBMESSAGE_ACCEPTED);
+    IoTHubTransportHttp_Destroy(handle);
+}
+
 /*Tests_SRS_TRANSPORTMULTITHTTP_02_001: [ If handle is NULL then IoTHubTransportHttp_GetHostname shall fail and return NULL. ]*/
 TEST_FUNCTION(IoTHubTransportHttp_GetHostname_with_NULL_handle_fails)
 {
@@ -0,0 +1,217 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures the sustained rate at which telemetry can be appended to the message store on local disk
+// and then drained from it, syncing after every message and with group commits of several messages.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef WIN32
+#include <direct.h>
+#define make_directory(path) _mkdir(path)
+#define remove_directory(path) _rmdir(path)
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#define make_directory(path) mkdir(path, 0700)
+#define remove_directory(path) rmdir(path)
+#endif
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/map.h"
+
+#include "iothub_message.h"
+#include "message_store.h"
+
+#define STORE_DIRECTORY     "message_store_perf_dir"
+#define MESSAGE_COUNT       2000
+#define PAYLOAD_SIZE        256
+#define MAX_SEGMENTS        64
+
+static const size_t SYNC_EVERY[] = { 1, 10, 100, 1000 };
+
+static double get_messages_per_second(size_t message_count, tickcounter_ms_t elapsed_ms)
+{
+    return (double)message_count * 1000.0 / (double)(elapsed_ms == 0 ? 1 : elapsed_ms);
+}
+
+static void clean_store_directory(void)
+{
+    char path[64];
+    unsigned long segment;
+
+    for (segment = 0; segment < MAX_SEGMENTS; segment++)
+    {
+        (void)sprintf(path, "%s/%08lx.log", STORE_DIRECTORY, segment);
+        (void)remove(path);
+    }
+    (void)remove(STORE_DIRECTORY "/checkpoint");
+    (void)remove(STORE_DIRECTORY "/checkpoint.tmp");
+}
+
+static IOTHUB_MESSAGE_HANDLE create_message(void)
+{
+    unsigned char payload[PAYLOAD_SIZE];
+    IOTHUB_MESSAGE_HANDLE result;
+
+    (void)memset(payload, 'x', sizeof(payload));
+    if ((result = IoTHubMessage_CreateFromByteArray(payload, sizeof(payload))) == NULL)
+    {
+        (void)printf("Failed creating the message\r\n");
+    }
+    else if ((IoTHubMessage_SetMessageId(result, "message_store_perf") != IOTHUB_MESSAGE_OK) ||
+        (Map_AddOrUpdate(IoTHubMessage_Properties(result), "temperature", "21.5") != MAP_OK))
+    {
+        (void)printf("Failed setting the properties of the message\r\n");
+        IoTHubMessage_Destroy(result);
+        result = NULL;
+    }
+    return result;
+}
+
+static int run_appends(TICK_COUNTER_HANDLE tick_counter, MESSAGE_STORE_HANDLE store, IOTHUB_MESSAGE_HANDLE message, size_t sync_every, double* messages_per_second)
+{
+    int result = 0;
+    size_t index;
+    tickcounter_ms_t start_ms;
+    tickcounter_ms_t end_ms;
+
+    (void)tickcounter_get_current_ms(tick_counter, &start_ms);
+    for (index = 0; index < MESSAGE_COUNT && result == 0; index++)
+    {
+        uint64_t record_id;
+
+        if (message_store_append(store, message, &record_id) != 0)
+        {
+            (void)printf("Failed appending a message\r\n");
+            result = __LINE__;
+        }
+        else if (((index + 1) % sync_every == 0) && (message_store_sync(store) != 0))
+        {
+            (void)printf("Failed syncing the store\r\n");
+            result = __LINE__;
+        }
+    }
+    if (result == 0 && message_store_sync(store) != 0)
+    {
+        result = __LINE__;
+    }
+    (void)tickcounter_get_current_ms(tick_counter, &end_ms);
+
+    *messages_per_second = get_messages_per_second(MESSAGE_COUNT, end_ms - start_ms);
+    return result;
+}
+
+static int run_drain(TICK_COUNTER_HANDLE tick_counter, MESSAGE_STORE_HANDLE store, size_t sync_every, double* messages_per_second)
+{
+    int result = 0;
+    size_t index;
+    tickcounter_ms_t start_ms;
+    tickcounter_ms_t end_ms;
+
+    (void)tickcounter_get_current_ms(tick_counter, &start_ms);
+    for (index = 0; index < MESSAGE_COUNT && result == 0; index++)
+    {
+        uint64_t record_id;
+        IOTHUB_MESSAGE_HANDLE message;
+
+        if ((message = message_store_read(store, &record_id)) == NULL)
+        {
+            (void)printf("Lost a message\r\n");
+            result = __LINE__;
+        }
+        else
+        {
+            IoTHubMessage_Destroy(message);
+            if (message_store_complete(store, record_id) != 0)
+            {
+                (void)printf("Failed completing a message\r\n");
+                result = __LINE__;
+            }
+            else if (((index + 1) % sync_every == 0) && (message_store_sync(store) != 0))
+            {
+                (void)printf("Failed syncing the store\r\n");
+                result = __LINE__;
+            }
+        }
+    }
+    if (result == 0 && message_store_sync(store) != 0)
+    {
+        result = __LINE__;
+    }
+    (void)tickcounter_get_current_ms(tick_counter, &end_ms);
+
+    *messages_per_second = get_messages_per_second(MESSAGE_COUNT, end_ms - start_ms);
+    return result;
+}
+
+static int run_sync_every(TICK_COUNTER_HANDLE tick_counter, IOTHUB_MESSAGE_HANDLE message, size_t sync_every)
+{
+    int result;
+    MESSAGE_STORE_HANDLE store;
+
+    clean_store_directory();
+    if ((store = message_store_open(STORE_DIRECTORY, MESSAGE_STORE_DEFAULT_SEGMENT_SIZE)) == NULL)
+    {
+        (void)printf("Failed opening the message store\r\n");
+        result = __LINE__;
+    }
+    else
+    {
+        double append_per_second;
+        double drain_per_second;
+
+        if ((result = run_appends(tick_counter, store, message, sync_every, &append_per_second)) == 0 &&
+            (result = run_drain(tick_counter, store, sync_every, &drain_per_second)) == 0)
+        {
+            (void)printf("%12lu %20.0f %20.0f\r\n", (unsigned long)sync_every, append_per_second, drain_per_second);
+        }
+
+        message_store_close(store);
+    }
+
+    return result;
+}
+
+int main(void)
+{
+    int result = 0;
+    TICK_COUNTER_HANDLE tick_counter;
+    IOTHUB_MESSAGE_HANDLE message;
+
+    (void)make_directory(STORE_DIRECTORY);
+
+    if ((tick_counter = tickcounter_create()) == NULL)
+    {
+        (void)printf("Failed creating tick counter\r\n");
+        result = __LINE__;
+    }
+    else
+    {
+        if ((message = create_message()) == NULL)
+        {
+            result = __LINE__;
+        }
+        else
+        {
+            size_t index;
+
+            (void)printf("%lu messages of %lu bytes\r\n", (unsigned long)MESSAGE_COUNT, (unsigned long)PAYLOAD_SIZE);
+            (void)printf("%12s %20s %20s\r\n", "sync every", "appends/sec", "drained/sec");
+            for (index = 0; index < sizeof(SYNC_EVERY) / sizeof(SYNC_EVERY[0]) && result == 0; index++)
+            {
+                result = run_sync_every(tick_counter, message, SYNC_EVERY[index]);
+            }
+
+            IoTHubMessage_Destroy(message);
+        }
+
+        tickcounter_destroy(tick_counter);
+    }
+
+    clean_store_directory();
+    (void)remove_directory(STORE_DIRECTORY);
+
+    return result;
+}
@@ -0,0 +1,986 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+
+#ifdef WIN32
+#include <direct.h>
+#define make_directory(path) _mkdir(path)
+#define remove_directory(path) _rmdir(path)
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#define make_directory(path) mkdir(path, 0700)
+#define remove_directory(path) rmdir(path)
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void* real_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "iothub_message.h"
+#undef ENABLE_MOCKS
+
+#include "message_store.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_STORE_DIRECTORY        "message_store_ut_dir"
+#define TEST_SEGMENT_SIZE           4096
+#define TEST_SMALL_SEGMENT_SIZE     64
+#define TEST_MAX_SEGMENTS           32
+#define TEST_MAX_PROPERTIES         4
+
+static const char* TEST_MESSAGE_ID = "msg_id";
+static const char* TEST_CORRELATION_ID = "core_id";
+static const char* TEST_CONTENT_TYPE = "application/json";
+static const char* TEST_CONTENT_ENCODING = "utf8";
+static const char* TEST_PROPERTY_KEY = "propKey1";
+static const char* TEST_PROPERTY_VALUE = "propValue1";
+
+// The messages handed out by this test are TEST_MESSAGEs, their properties map is the message itself.
+typedef struct TEST_MESSAGE_TAG
+{
+    IOTHUBMESSAGE_CONTENT_TYPE contentType;
+    unsigned char* payload;
+    size_t payloadSize;
+    char* messageId;
+    char* correlationId;
+    char* contentTypeProperty;
+    char* contentEncoding;
+    char* keys[TEST_MAX_PROPERTIES];
+    char* values[TEST_MAX_PROPERTIES];
+    size_t propertyCount;
+    IOTHUB_MESSAGE_PROPERTY propertyTable[TEST_MAX_PROPERTIES];
+} TEST_MESSAGE;
+
+
+// Mock hooks
+
+static char* copy_string_of_length(const char* value, size_t length)
+{
+    char* result = (char*)real_malloc(length + 1);
+    (void)memcpy(result, value, length);
+    result[length] = '\0';
+    return result;
+}
+
+static char* copy_string(const char* value)
+{
+    return (value == NULL) ? NULL : copy_string_of_length(value, strlen(value));
+}
+
+static void free_properties(TEST_MESSAGE* message)
+{
+    size_t index;
+    for (index = 0; index < message->propertyCount; index++)
+    {
+        real_free(message->keys[index]);
+        real_free(message->values[index]);
+    }
+    message->propertyCount = 0;
+}
+
+static IOTHUB_MESSAGE_HANDLE my_IoTHubMessage_CreateFromByteArray(const unsigned char* byteArray, size_t size)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)real_malloc(sizeof(TEST_MESSAGE));
+    (void)memset(message, 0, sizeof(TEST_MESSAGE));
+    message->contentType = IOTHUBMESSAGE_BYTEARRAY;
+    message->payload = (unsigned char*)real_malloc(size + 1);
+    (void)memcpy(message->payload, byteArray, size);
+    message->payload[size] = '\0';
+    message->payloadSize = size;
+    return (IOTHUB_MESSAGE_HANDLE)message;
+}
+
+static IOTHUB_MESSAGE_HANDLE my_IoTHubMessage_CreateFromString(const char* source)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)my_IoTHubMessage_CreateFromByteArray((const unsigned char*)source, strlen(source));
+    message->contentType = IOTHUBMESSAGE_STRING;
+    return (IOTHUB_MESSAGE_HANDLE)message;
+}
+
+static void my_IoTHubMessage_Destroy(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)iotHubMessageHandle;
+    free_properties(message);
+    real_free(message->payload);
+    real_free(message->messageId);
+    real_free(message->correlationId);
+    real_free(message->contentTypeProperty);
+    real_free(message->contentEncoding);
+    real_free(message);
+}
+
+static IOTHUBMESSAGE_CONTENT_TYPE my_IoTHubMessage_GetContentType(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return ((TEST_MESSAGE*)iotHubMessageHandle)->contentType;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_GetByteArray(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const unsigned char** buffer, size_t* size)
+{
+    *buffer = ((TEST_MESSAGE*)iotHubMessageHandle)->payload;
+    *size = ((TEST_MESSAGE*)iotHubMessageHandle)->payloadSize;
+    return IOTHUB_MESSAGE_OK;
+}
+
+static const char* my_IoTHubMessage_GetString(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return (const char*)((TEST_MESSAGE*)iotHubMessageHandle)->payload;
+}
+
+static const char* my_IoTHubMessage_GetMessageId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return ((TEST_MESSAGE*)iotHubMessageHandle)->messageId;
+}
+
+static const char* my_IoTHubMessage_GetCorrelationId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return ((TEST_MESSAGE*)iotHubMessageHandle)->correlationId;
+}
+
+static const char* my_IoTHubMessage_GetContentTypeSystemProperty(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return ((TEST_MESSAGE*)iotHubMessageHandle)->contentTypeProperty;
+}
+
+static const char* my_IoTHubMessage_GetContentEncodingSystemProperty(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return ((TEST_MESSAGE*)iotHubMessageHandle)->contentEncoding;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_SetMessageId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const char* messageId)
+{
+    ((TEST_MESSAGE*)iotHubMessageHandle)->messageId = copy_string(messageId);
+    return IOTHUB_MESSAGE_OK;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_SetCorrelationId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const char* correlationId)
+{
+    ((TEST_MESSAGE*)iotHubMessageHandle)->correlationId = copy_string(correlationId);
+    return IOTHUB_MESSAGE_OK;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_SetContentTypeSystemProperty(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const char* contentType)
+{
+    ((TEST_MESSAGE*)iotHubMessageHandle)->contentTypeProperty = copy_string(contentType);
+    return IOTHUB_MESSAGE_OK;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_SetContentEncodingSystemProperty(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const char* contentEncoding)
+{
+    ((TEST_MESSAGE*)iotHubMessageHandle)->contentEncoding = copy_string(contentEncoding);
+    return IOTHUB_MESSAGE_OK;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_GetPropertyTable(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const IOTHUB_MESSAGE_PROPERTY** properties, size_t* count)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)iotHubMessageHandle;
+    size_t index;
+    for (index = 0; index < message->propertyCount; index++)
+    {
+        message->propertyTable[index].key = message->keys[index];
+        message->propertyTable[index].keyLength = strlen(message->keys[index]);
+        message->propertyTable[index].value = message->values[index];
+        message->propertyTable[index].valueLength = strlen(message->values[index]);
+    }
+    *properties = (message->propertyCount == 0) ? NULL : message->propertyTable;
+    *count = message->propertyCount;
+    return IOTHUB_MESSAGE_OK;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_SetProperties(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const IOTHUB_MESSAGE_PROPERTY* properties, size_t count)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)iotHubMessageHandle;
+    size_t index;
+    ASSERT_IS_TRUE(count <= TEST_MAX_PROPERTIES);
+    free_properties(message);
+    for (index = 0; index < count; index++)
+    {
+        message->keys[index] = copy_string_of_length(properties[index].key, properties[index].keyLength);
+        message->values[index] = copy_string_of_length(properties[index].value, properties[index].valueLength);
+    }
+    message->propertyCount = count;
+    return IOTHUB_MESSAGE_OK;
+}
+
+
+// Helpers
+
+static void clean_store_directory(void)
+{
+    char path[64];
+    unsigned long segment;
+
+    for (segment = 0; segment < TEST_MAX_SEGMENTS; segment++)
+    {
+        (void)sprintf(path, "%s/%08lx.log", TEST_STORE_DIRECTORY, segment);
+        (void)remove(path);
+    }
+    (void)remove(TEST_STORE_DIRECTORY "/checkpoint");
+    (void)remove(TEST_STORE_DIRECTORY "/checkpoint.tmp");
+}
+
+static bool segment_exists(unsigned long segment)
+{
+    char path[64];
+    FILE* file;
+
+    (void)sprintf(path, "%s/%08lx.log", TEST_STORE_DIRECTORY, segment);
+    file = fopen(path, "rb");
+    if (file != NULL)
+    {
+        (void)fclose(file);
+    }
+    return (file != NULL);
+}
+
+static void append_to_segment(unsigned long segment, const char* data)
+{
+    char path[64];
+    FILE* file;
+
+    (void)sprintf(path, "%s/%08lx.log", TEST_STORE_DIRECTORY, segment);
+    file = fopen(path, "ab");
+    ASSERT_IS_NOT_NULL_WITH_MSG(file, "Failed opening the segment");
+    (void)fwrite(data, 1, strlen(data), file);
+    (void)fclose(file);
+}
+
+static MESSAGE_STORE_HANDLE open_store(size_t segmentSize)
+{
+    MESSAGE_STORE_HANDLE result = message_store_open(TEST_STORE_DIRECTORY, segmentSize);
+    ASSERT_IS_NOT_NULL_WITH_MSG(result, "Failed opening the message store");
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static uint64_t append_message(MESSAGE_STORE_HANDLE store, const char* payload)
+{
+    IOTHUB_MESSAGE_HANDLE message = my_IoTHubMessage_CreateFromByteArray((const unsigned char*)payload, strlen(payload));
+    uint64_t recordId = 0;
+    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, message_store_append(store, message, &recordId), "Failed appending a message");
+    my_IoTHubMessage_Destroy(message);
+    return recordId;
+}
+
+static uint64_t read_message(MESSAGE_STORE_HANDLE store, const char* expectedPayload)
+{
+    uint64_t recordId = 0;
+    IOTHUB_MESSAGE_HANDLE message = message_store_read(store, &recordId);
+    ASSERT_IS_NOT_NULL_WITH_MSG(message, "Failed reading a message");
+    ASSERT_ARE_EQUAL(char_ptr, expectedPayload, (const char*)((TEST_MESSAGE*)message)->payload);
+    my_IoTHubMessage_Destroy(message);
+    return recordId;
+}
+
+static void assert_no_message(MESSAGE_STORE_HANDLE store)
+{
+    uint64_t recordId;
+    IOTHUB_MESSAGE_HANDLE message = message_store_read(store, &recordId);
+    ASSERT_IS_NULL_WITH_MSG(message, "Read a message that should not be there");
+}
+
+/*leaves "second", "third" and "fourth" in segments 1 to 3, the checkpoint at the end of segment 1 and segment 0 deleted*/
+static void create_store_with_first_segment_deleted(void)
+{
+    MESSAGE_STORE_HANDLE store = open_store(TEST_SMALL_SEGMENT_SIZE);
+    (void)append_message(store, "first message of the segment");
+    (void)append_message(store, "second message of the segment");
+    (void)append_message(store, "third message of the segment");
+    (void)append_message(store, "fourth message of the segment");
+    ASSERT_ARE_EQUAL(int, 0, message_store_complete(store, read_message(store, "first message of the segment")));
+    ASSERT_ARE_EQUAL(int, 0, message_store_complete(store, read_message(store, "second message of the segment")));
+    ASSERT_ARE_EQUAL(int, 0, message_store_sync(store));
+    message_store_close(store);
+    ASSERT_IS_FALSE(segment_exists(0));
+    ASSERT_IS_TRUE(segment_exists(1));
+}
+
+
+BEGIN_TEST_SUITE(message_store_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(realloc, real_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(free, real_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_CreateFromByteArray, my_IoTHubMessage_CreateFromByteArray);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_CreateFromByteArray, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_CreateFromString, my_IoTHubMessage_CreateFromString);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_CreateFromString, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_Destroy, my_IoTHubMessage_Destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetContentType, my_IoTHubMessage_GetContentType);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetByteArray, my_IoTHubMessage_GetByteArray);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetString, my_IoTHubMessage_GetString);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetMessageId, my_IoTHubMessage_GetMessageId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetCorrelationId, my_IoTHubMessage_GetCorrelationId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetContentTypeSystemProperty, my_IoTHubMessage_GetContentTypeSystemProperty);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetContentEncodingSystemProperty, my_IoTHubMessage_GetContentEncodingSystemProperty);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetMessageId, my_IoTHubMessage_SetMessageId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetCorrelationId, my_IoTHubMessage_SetCorrelationId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetContentTypeSystemProperty, my_IoTHubMessage_SetContentTypeSystemProperty);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetContentEncodingSystemProperty, my_IoTHubMessage_SetContentEncodingSystemProperty);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetPropertyTable, my_IoTHubMessage_GetPropertyTable);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetPropertyTable, IOTHUB_MESSAGE_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetProperties, my_IoTHubMessage_SetProperties);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_SetProperties, IOTHUB_MESSAGE_ERROR);
+
+    (void)make_directory(TEST_STORE_DIRECTORY);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    clean_store_directory();
+    (void)remove_directory(TEST_STORE_DIRECTORY);
+
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    clean_store_directory();
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_MESSAGE_STORE_11_001: [ If `directory` is NULL or `segmentSize` is 0, message_store_open shall fail and return NULL. ]
+TEST_FUNCTION(open_NULL_directory_fails)
+{
+    // arrange
+
+    // act
+    MESSAGE_STORE_HANDLE store = message_store_open(NULL, TEST_SEGMENT_SIZE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_001: [ If `directory` is NULL or `segmentSize` is 0, message_store_open shall fail and return NULL. ]
+TEST_FUNCTION(open_segmentSize_0_fails)
+{
+    // arrange
+
+    // act
+    MESSAGE_STORE_HANDLE store = message_store_open(TEST_STORE_DIRECTORY, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_002: [ If any allocation or file operation fails, message_store_open shall free what it allocated and return NULL. ]
+TEST_FUNCTION(open_malloc_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    // act
+    MESSAGE_STORE_HANDLE store = message_store_open(TEST_STORE_DIRECTORY, TEST_SEGMENT_SIZE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_002: [ If any allocation or file operation fails, message_store_open shall free what it allocated and return NULL. ]
+TEST_FUNCTION(open_missing_directory_fails)
+{
+    // arrange
+
+    // act
+    MESSAGE_STORE_HANDLE store = message_store_open(TEST_STORE_DIRECTORY "/missing", TEST_SEGMENT_SIZE);
+
+    // assert
+    ASSERT_IS_NULL(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_004: [ message_store_open shall create a new segment, after the last one found, for the records appended afterwards. ]
+// Tests_SRS_MESSAGE_STORE_11_013: [ If every record has been read, message_store_read shall return NULL. ]
+TEST_FUNCTION(open_empty_directory_succeeds)
+{
+    // arrange
+
+    // act
+    MESSAGE_STORE_HANDLE store = message_store_open(TEST_STORE_DIRECTORY, TEST_SEGMENT_SIZE);
+
+    // assert
+    ASSERT_IS_NOT_NULL(store);
+    ASSERT_IS_TRUE(segment_exists(0));
+    assert_no_message(store);
+
+    // cleanup
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_005: [ If `store` is NULL, message_store_close shall return. ]
+TEST_FUNCTION(close_NULL_returns)
+{
+    // arrange
+
+    // act
+    message_store_close(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_MESSAGE_STORE_11_007: [ If `store`, `message` or `recordId` is NULL, message_store_append shall fail and return a non-zero value. ]
+TEST_FUNCTION(append_NULL_arguments_fail)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE store = open_store(TEST_SEGMENT_SIZE);
+    IOTHUB_MESSAGE_HANDLE message = my_IoTHubMessage_CreateFromString("hello");
+    uint64_t recordId;
+
+    // act
+    int result1 = message_store_append(NULL, message, &recordId);
+    int result2 = message_store_append(store, NULL, &recordId);
+    int result3 = message_store_append(store, message, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result3);
+
+    // cleanup
+    my_IoTHubMessage_Destroy(message);
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_008: [ message_store_append shall encode the payload, message id, correlation id, content type, content encoding and properties of `message` in a record with the length and the checksum of its content. ]
+// Tests_SRS_MESSAGE_STORE_11_016: [ message_store_read shall rebuild the message of the next record and return it along with its id, ids being given in the order of the log starting at 0 when the store is opened. ]
+TEST_FUNCTION(append_read_keeps_the_message)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE store = open_store(TEST_SEGMENT_SIZE);
+    IOTHUB_MESSAGE_HANDLE message = my_IoTHubMessage_CreateFromByteArray((const unsigned char*)"\0\1\2", 3);
+    IOTHUB_MESSAGE_HANDLE readMessage;
+    uint64_t appendedId = 42;
+    uint64_t readId = 42;
+    TEST_MESSAGE* result;
+    IOTHUB_MESSAGE_PROPERTY property;
+    property.key = TEST_PROPERTY_KEY;
+    property.keyLength = strlen(TEST_PROPERTY_KEY);
+    property.value = TEST_PROPERTY_VALUE;
+    property.valueLength = strlen(TEST_PROPERTY_VALUE);
+    (void)my_IoTHubMessage_SetMessageId(message, TEST_MESSAGE_ID);
+    (void)my_IoTHubMessage_SetCorrelationId(message, TEST_CORRELATION_ID);
+    (void)my_IoTHubMessage_SetContentTypeSystemProperty(message, TEST_CONTENT_TYPE);
+    (void)my_IoTHubMessage_SetContentEncodingSystemProperty(message, TEST_CONTENT_ENCODING);
+    (void)my_IoTHubMessage_SetProperties(message, &property, 1);
+
+    // act
+    int appendResult = message_store_append(store, message, &appendedId);
+    readMessage = message_store_read(store, &readId);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, appendResult);
+    ASSERT_IS_NOT_NULL(readMessage);
+    ASSERT_ARE_EQUAL(uint64_t, 0, appendedId);
+    ASSERT_ARE_EQUAL(uint64_t, 0, readId);
+    result = (TEST_MESSAGE*)readMessage;
+    ASSERT_ARE_EQUAL(int, IOTHUBMESSAGE_BYTEARRAY, result->contentType);
+    ASSERT_ARE_EQUAL(size_t, 3, result->payloadSize);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(result->payload, "\0\1\2", 3));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID, result->messageId);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_CORRELATION_ID, result->correlationId);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_CONTENT_TYPE, result->contentTypeProperty);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_CONTENT_ENCODING, result->contentEncoding);
+    ASSERT_ARE_EQUAL(size_t, 1, result->propertyCount);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PROPERTY_KEY, result->keys[0]);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PROPERTY_VALUE, result->values[0]);
+    assert_no_message(store);
+
+    // cleanup
+    my_IoTHubMessage_Destroy(readMessage);
+    my_IoTHubMessage_Destroy(message);
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_016: [ message_store_read shall rebuild the message of the next record and return it along with its id, ids being given in the order of the log starting at 0 when the store is opened. ]
+TEST_FUNCTION(append_read_string_message)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE store = open_store(TEST_SEGMENT_SIZE);
+    IOTHUB_MESSAGE_HANDLE message = my_IoTHubMessage_CreateFromString("hello");
+    IOTHUB_MESSAGE_HANDLE readMessage;
+    uint64_t recordId;
+    (void)message_store_append(store, message, &recordId);
+
+    // act
+    readMessage = message_store_read(store, &recordId);
+
+    // assert
+    ASSERT_IS_NOT_NULL(readMessage);
+    ASSERT_ARE_EQUAL(int, IOTHUBMESSAGE_STRING, ((TEST_MESSAGE*)readMessage)->contentType);
+    ASSERT_ARE_EQUAL(char_ptr, "hello", (const char*)((TEST_MESSAGE*)readMessage)->payload);
+    ASSERT_IS_NULL(((TEST_MESSAGE*)readMessage)->messageId);
+    ASSERT_ARE_EQUAL(size_t, 0, ((TEST_MESSAGE*)readMessage)->propertyCount);
+
+    // cleanup
+    my_IoTHubMessage_Destroy(readMessage);
+    my_IoTHubMessage_Destroy(message);
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_010: [ message_store_append shall write the record at the end of the current segment, without syncing it, and return in `recordId` the id message_store_read gives to it. ]
+// Tests_SRS_MESSAGE_STORE_11_014: [ message_store_read shall flush the appends not yet written before reading the segment they go to. ]
+TEST_FUNCTION(read_follows_the_order_of_the_appends)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE store = open_store(TEST_SEGMENT_SIZE);
+    uint64_t id1 = append_message(store, "one");
+    uint64_t id2 = append_message(store, "two");
+
+    // act
+    uint64_t readId1 = read_message(store, "one");
+    uint64_t id3 = append_message(store, "three");
+    uint64_t readId2 = read_message(store, "two");
+    uint64_t readId3 = read_message(store, "three");
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, id1, readId1);
+    ASSERT_ARE_EQUAL(uint64_t, id2, readId2);
+    ASSERT_ARE_EQUAL(uint64_t, id3, readId3);
+    ASSERT_ARE_EQUAL(uint64_t, 2, id3);
+    assert_no_message(store);
+
+    // cleanup
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_009: [ Once the current segment holds at least one record and the new one would take it over `segmentSize`, message_store_append shall sync it, close it and continue in a new segment. ]
+// Tests_SRS_MESSAGE_STORE_11_015: [ At the end of a segment, or at a torn record, message_store_read shall continue with the next segment. ]
+TEST_FUNCTION(append_continues_in_a_new_segment)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE store = open_store(TEST_SMALL_SEGMENT_SIZE);
+
+    // act
+    (void)append_message(store, "first message of the segment");
+    (void)append_message(store, "second message of the segment");
+    (void)append_message(store, "third message of the segment");
+
+    // assert
+    ASSERT_IS_TRUE(segment_exists(1));
+    ASSERT_IS_TRUE(segment_exists(2));
+    (void)read_message(store, "first message of the segment");
+    (void)read_message(store, "second message of the segment");
+    (void)read_message(store, "third message of the segment");
+    assert_no_message(store);
+
+    // cleanup
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_017: [ If the message cannot be rebuilt for a transient reason, message_store_read shall return NULL and read the same record the next time. ]
+TEST_FUNCTION(read_retries_a_record_that_could_not_be_rebuilt)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE store = open_store(TEST_SEGMENT_SIZE);
+    IOTHUB_MESSAGE_HANDLE message;
+    uint64_t recordId;
+    (void)append_message(store, "one");
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    // act
+    message = message_store_read(store, &recordId);
+
+    // assert
+    ASSERT_IS_NULL(message);
+    ASSERT_ARE_EQUAL(uint64_t, 0, read_message(store, "one"));
+
+    // cleanup
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_012: [ If `store` or `recordId` is NULL, message_store_read shall fail and return NULL. ]
+TEST_FUNCTION(read_NULL_arguments_fail)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE store = open_store(TEST_SEGMENT_SIZE);
+    uint64_t recordId;
+
+    // act
+    IOTHUB_MESSAGE_HANDLE message1 = message_store_read(NULL, &recordId);
+    IOTHUB_MESSAGE_HANDLE message2 = message_store_read(store, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(message1);
+    ASSERT_IS_NULL(message2);
+
+    // cleanup
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_019: [ If `store` is NULL, message_store_complete shall fail and return a non-zero value. ]
+TEST_FUNCTION(complete_NULL_store_fails)
+{
+    // arrange
+
+    // act
+    int result = message_store_complete(NULL, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_020: [ If `recordId` is not the id of a record read and not yet completed, message_store_complete shall fail and return a non-zero value. ]
+TEST_FUNCTION(complete_record_not_read_fails)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE store = open_store(TEST_SEGMENT_SIZE);
+    uint64_t recordId = append_message(store, "one");
+
+    // act
+    int result = message_store_complete(store, recordId);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_020: [ If `recordId` is not the id of a record read and not yet completed, message_store_complete shall fail and return a non-zero value. ]
+TEST_FUNCTION(complete_twice_fails)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE store = open_store(TEST_SEGMENT_SIZE);
+    uint64_t recordId;
+    (void)append_message(store, "one");
+    recordId = read_message(store, "one");
+    ASSERT_ARE_EQUAL(int, 0, message_store_complete(store, recordId));
+
+    // act
+    int result = message_store_complete(store, recordId);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_003: [ message_store_open shall read the checkpoint and count the valid records that follow it, stopping in each segment at the first torn record. ]
+// Tests_SRS_MESSAGE_STORE_11_023: [ If records were appended since the last sync, message_store_sync shall flush the current segment and sync it to disk. ]
+TEST_FUNCTION(open_replays_the_records_not_completed)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE store = open_store(TEST_SEGMENT_SIZE);
+    (void)append_message(store, "one");
+    (void)append_message(store, "two");
+    ASSERT_ARE_EQUAL(int, 0, message_store_sync(store));
+    message_store_close(store);
+
+    // act
+    store = open_store(TEST_SEGMENT_SIZE);
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, 0, read_message(store, "one"));
+    ASSERT_ARE_EQUAL(uint64_t, 1, read_message(store, "two"));
+    ASSERT_ARE_EQUAL(uint64_t, 2, append_message(store, "three"));
+    ASSERT_ARE_EQUAL(uint64_t, 2, read_message(store, "three"));
+
+    // cleanup
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_021: [ message_store_complete shall mark the record as completed and move the checkpoint to the first record read and not completed, or after the last record read if all of them are completed. ]
+// Tests_SRS_MESSAGE_STORE_11_024: [ If the checkpoint moved, message_store_sync shall write it to a temporary file, sync it and rename it over the checkpoint file. ]
+TEST_FUNCTION(open_does_not_replay_the_records_completed)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE store = open_store(TEST_SEGMENT_SIZE);
+    uint64_t recordId;
+    (void)append_message(store, "one");
+    (void)append_message(store, "two");
+    recordId = read_message(store, "one");
+    ASSERT_ARE_EQUAL(int, 0, message_store_complete(store, recordId));
+    ASSERT_ARE_EQUAL(int, 0, message_store_sync(store));
+    message_store_close(store);
+
+    // act
+    store = open_store(TEST_SEGMENT_SIZE);
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, 0, read_message(store, "two"));
+    assert_no_message(store);
+
+    // cleanup
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_021: [ message_store_complete shall mark the record as completed and move the checkpoint to the first record read and not completed, or after the last record read if all of them are completed. ]
+TEST_FUNCTION(complete_out_of_order_keeps_the_checkpoint)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE store = open_store(TEST_SEGMENT_SIZE);
+    uint64_t recordId1;
+    uint64_t recordId2;
+    (void)append_message(store, "one");
+    (void)append_message(store, "two");
+    (void)append_message(store, "three");
+    recordId1 = read_message(store, "one");
+    recordId2 = read_message(store, "two");
+
+    // act
+    ASSERT_ARE_EQUAL(int, 0, message_store_complete(store, recordId2));
+    ASSERT_ARE_EQUAL(int, 0, message_store_sync(store));
+    message_store_close(store);
+    store = open_store(TEST_SEGMENT_SIZE);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(uint64_t, recordId1, recordId2);
+    (void)read_message(store, "one");
+    (void)read_message(store, "two");
+    (void)read_message(store, "three");
+    assert_no_message(store);
+
+    // cleanup
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_006: [ message_store_close shall sync the store, close its files and free it. ]
+TEST_FUNCTION(close_syncs_the_checkpoint)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE store = open_store(TEST_SEGMENT_SIZE);
+    (void)append_message(store, "one");
+    ASSERT_ARE_EQUAL(int, 0, message_store_complete(store, read_message(store, "one")));
+
+    // act
+    message_store_close(store);
+
+    // assert
+    store = open_store(TEST_SEGMENT_SIZE);
+    assert_no_message(store);
+
+    // cleanup
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_025: [ Once the checkpoint is written, message_store_sync shall delete the segments before the one of the checkpoint. ]
+TEST_FUNCTION(sync_deletes_the_segments_completed)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE store = open_store(TEST_SMALL_SEGMENT_SIZE);
+    (void)append_message(store, "first message of the segment");
+    (void)append_message(store, "second message of the segment");
+    ASSERT_ARE_EQUAL(int, 0, message_store_complete(store, read_message(store, "first message of the segment")));
+    ASSERT_ARE_EQUAL(int, 0, message_store_complete(store, read_message(store, "second message of the segment")));
+
+    // act
+    int result = message_store_sync(store);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_FALSE(segment_exists(0));
+    ASSERT_IS_TRUE(segment_exists(1));
+
+    // cleanup
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_003: [ message_store_open shall read the checkpoint and count the valid records that follow it, stopping in each segment at the first torn record. ]
+TEST_FUNCTION(open_ignores_a_torn_record)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE store = open_store(TEST_SEGMENT_SIZE);
+    (void)append_message(store, "one");
+    message_store_close(store);
+    append_to_segment(0, "torn by a crash");
+
+    // act
+    store = open_store(TEST_SEGMENT_SIZE);
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, 0, read_message(store, "one"));
+    ASSERT_ARE_EQUAL(uint64_t, 1, append_message(store, "two"));
+    ASSERT_ARE_EQUAL(uint64_t, 1, read_message(store, "two"));
+    assert_no_message(store);
+
+    // cleanup
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_026: [ If the checkpoint is missing or corrupted, message_store_open shall replay every record from the oldest segment found in the directory, skipping the segments missing after it. ]
+// Tests_SRS_MESSAGE_STORE_11_004: [ message_store_open shall create a new segment, after the last one found, for the records appended afterwards. ]
+TEST_FUNCTION(open_with_a_corrupted_checkpoint_replays_the_segments_left)
+{
+    // arrange
+    FILE* checkpoint;
+    MESSAGE_STORE_HANDLE store;
+    create_store_with_first_segment_deleted();
+    checkpoint = fopen(TEST_STORE_DIRECTORY "/checkpoint", "wb");
+    ASSERT_IS_NOT_NULL(checkpoint);
+    (void)fputs("corrupted", checkpoint);
+    (void)fclose(checkpoint);
+
+    // act
+    store = open_store(TEST_SMALL_SEGMENT_SIZE);
+    (void)append_message(store, "fifth message of the segment");
+
+    // assert
+    (void)read_message(store, "second message of the segment");
+    (void)read_message(store, "third message of the segment");
+    (void)read_message(store, "fourth message of the segment");
+    (void)read_message(store, "fifth message of the segment");
+    assert_no_message(store);
+    message_store_close(store);
+
+    store = open_store(TEST_SMALL_SEGMENT_SIZE);
+    (void)read_message(store, "second message of the segment");
+    (void)read_message(store, "third message of the segment");
+    (void)read_message(store, "fourth message of the segment");
+    (void)read_message(store, "fifth message of the segment");
+    assert_no_message(store);
+
+    // cleanup
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_026: [ If the checkpoint is missing or corrupted, message_store_open shall replay every record from the oldest segment found in the directory, skipping the segments missing after it. ]
+TEST_FUNCTION(open_without_a_checkpoint_replays_the_segments_left)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE store;
+    create_store_with_first_segment_deleted();
+    ASSERT_ARE_EQUAL(int, 0, remove(TEST_STORE_DIRECTORY "/checkpoint"));
+
+    // act
+    store = open_store(TEST_SMALL_SEGMENT_SIZE);
+
+    // assert
+    ASSERT_IS_FALSE(segment_exists(0));
+    (void)read_message(store, "second message of the segment");
+    (void)read_message(store, "third message of the segment");
+    (void)read_message(store, "fourth message of the segment");
+    assert_no_message(store);
+
+    // cleanup
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_026: [ If the checkpoint is missing or corrupted, message_store_open shall replay every record from the oldest segment found in the directory, skipping the segments missing after it. ]
+TEST_FUNCTION(open_skips_a_missing_segment)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE store;
+    create_store_with_first_segment_deleted();
+    ASSERT_ARE_EQUAL(int, 0, remove(TEST_STORE_DIRECTORY "/checkpoint"));
+    ASSERT_ARE_EQUAL(int, 0, remove(TEST_STORE_DIRECTORY "/00000002.log"));
+
+    // act
+    store = open_store(TEST_SMALL_SEGMENT_SIZE);
+
+    // assert
+    (void)read_message(store, "second message of the segment");
+    (void)read_message(store, "fourth message of the segment");
+    assert_no_message(store);
+
+    // cleanup
+    message_store_close(store);
+}
+
+// Tests_SRS_MESSAGE_STORE_11_022: [ If `store` is NULL, message_store_sync shall fail and return a non-zero value. ]
+TEST_FUNCTION(sync_NULL_store_fails)
+{
+    // arrange
+
+    // act
+    int result = message_store_sync(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+END_TEST_SUITE(message_store_ut)
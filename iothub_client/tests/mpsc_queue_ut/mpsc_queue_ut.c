@@ -0,0 +1,437 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#undef ENABLE_MOCKS
+
+#include "mpsc_queue.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    void real_DList_InitializeListHead(PDLIST_ENTRY listHead);
+    int real_DList_IsListEmpty(const PDLIST_ENTRY listHead);
+    void real_DList_InsertTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_InsertHeadList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_AppendTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY ListToAppend);
+    int real_DList_RemoveEntryList(PDLIST_ENTRY listEntry);
+    PDLIST_ENTRY real_DList_RemoveHeadList(PDLIST_ENTRY listHead);
+
+#ifdef __cplusplus
+}
+#endif
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_ITEM_COUNT                     10
+
+typedef struct TEST_ITEM_TAG
+{
+    size_t id;
+    DLIST_ENTRY entry;
+} TEST_ITEM;
+
+static TEST_ITEM TEST_ITEMS[TEST_ITEM_COUNT];
+static bool g_was_empty;
+
+
+// Helpers
+
+static MPSC_QUEUE_HANDLE create_queue(void)
+{
+    MPSC_QUEUE_HANDLE result = mpsc_queue_create();
+    ASSERT_IS_NOT_NULL_WITH_MSG(result, "Failed creating the queue");
+    return result;
+}
+
+
+BEGIN_TEST_SUITE(mpsc_queue_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(free, real_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, real_DList_InitializeListHead);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_IsListEmpty, real_DList_IsListEmpty);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertTailList, real_DList_InsertTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertHeadList, real_DList_InsertHeadList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_AppendTailList, real_DList_AppendTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, real_DList_RemoveEntryList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    size_t i;
+
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    for (i = 0; i < TEST_ITEM_COUNT; i++)
+    {
+        TEST_ITEMS[i].id = i;
+        TEST_ITEMS[i].entry.Flink = NULL;
+        TEST_ITEMS[i].entry.Blink = NULL;
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_MPSC_QUEUE_11_001: [ mpsc_queue_create shall allocate memory for the MPSC_QUEUE data structure and return it empty. ]
+TEST_FUNCTION(create_success)
+{
+    // arrange
+    DLIST_ENTRY list;
+    real_DList_InitializeListHead(&list);
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+
+    // act
+    MPSC_QUEUE_HANDLE queue = mpsc_queue_create();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(queue);
+    ASSERT_ARE_EQUAL(size_t, 0, mpsc_queue_pop_all(queue, &list));
+
+    // cleanup
+    mpsc_queue_destroy(queue);
+}
+
+// Tests_SRS_MPSC_QUEUE_11_002: [ If the allocation fails, mpsc_queue_create shall fail and return NULL. ]
+TEST_FUNCTION(create_malloc_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    // act
+    MPSC_QUEUE_HANDLE queue = mpsc_queue_create();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(queue);
+}
+
+// Tests_SRS_MPSC_QUEUE_11_003: [ If `queue` is NULL, mpsc_queue_destroy shall return. ]
+TEST_FUNCTION(destroy_NULL_queue)
+{
+    // arrange
+
+    // act
+    mpsc_queue_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_MPSC_QUEUE_11_004: [ mpsc_queue_destroy shall free the queue but not the items still in it. ]
+TEST_FUNCTION(destroy_with_items_frees_only_the_queue)
+{
+    // arrange
+    MPSC_QUEUE_HANDLE queue = create_queue();
+    (void)mpsc_queue_push(queue, &TEST_ITEMS[0].entry, &g_was_empty);
+    (void)mpsc_queue_push(queue, &TEST_ITEMS[1].entry, &g_was_empty);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+    // act
+    mpsc_queue_destroy(queue);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_MPSC_QUEUE_11_005: [ If `queue`, `entry` or `wasEmpty` is NULL, mpsc_queue_push shall fail and return a non-zero value. ]
+TEST_FUNCTION(push_NULL_queue_fails)
+{
+    // arrange
+    bool was_empty;
+
+    // act
+    int result = mpsc_queue_push(NULL, &TEST_ITEMS[0].entry, &was_empty);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_MPSC_QUEUE_11_005: [ If `queue`, `entry` or `wasEmpty` is NULL, mpsc_queue_push shall fail and return a non-zero value. ]
+TEST_FUNCTION(push_NULL_entry_fails)
+{
+    // arrange
+    bool was_empty;
+    DLIST_ENTRY list;
+    MPSC_QUEUE_HANDLE queue = create_queue();
+    real_DList_InitializeListHead(&list);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = mpsc_queue_push(queue, NULL, &was_empty);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, mpsc_queue_pop_all(queue, &list));
+
+    // cleanup
+    mpsc_queue_destroy(queue);
+}
+
+// Tests_SRS_MPSC_QUEUE_11_005: [ If `queue`, `entry` or `wasEmpty` is NULL, mpsc_queue_push shall fail and return a non-zero value. ]
+TEST_FUNCTION(push_NULL_wasEmpty_fails)
+{
+    // arrange
+    DLIST_ENTRY list;
+    MPSC_QUEUE_HANDLE queue = create_queue();
+    real_DList_InitializeListHead(&list);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = mpsc_queue_push(queue, &TEST_ITEMS[0].entry, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, mpsc_queue_pop_all(queue, &list));
+
+    // cleanup
+    mpsc_queue_destroy(queue);
+}
+
+// Tests_SRS_MPSC_QUEUE_11_006: [ mpsc_queue_push shall link `entry` in front of the newest item without taking a lock, retrying if another thread pushed at the same time. ]
+// Tests_SRS_MPSC_QUEUE_11_007: [ mpsc_queue_push shall set `wasEmpty` to true if the queue was empty before `entry` was added and to false otherwise, and return 0. ]
+TEST_FUNCTION(push_reports_empty_only_for_the_first_item)
+{
+    // arrange
+    bool first;
+    bool second;
+    bool third;
+    MPSC_QUEUE_HANDLE queue = create_queue();
+    umock_c_reset_all_calls();
+
+    // act
+    int first_result = mpsc_queue_push(queue, &TEST_ITEMS[0].entry, &first);
+    int second_result = mpsc_queue_push(queue, &TEST_ITEMS[1].entry, &second);
+    int third_result = mpsc_queue_push(queue, &TEST_ITEMS[2].entry, &third);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, first_result);
+    ASSERT_ARE_EQUAL(int, 0, second_result);
+    ASSERT_ARE_EQUAL(int, 0, third_result);
+    ASSERT_IS_TRUE(first);
+    ASSERT_IS_FALSE(second);
+    ASSERT_IS_FALSE(third);
+
+    // cleanup
+    mpsc_queue_destroy(queue);
+}
+
+// Tests_SRS_MPSC_QUEUE_11_007: [ mpsc_queue_push shall set `wasEmpty` to true if the queue was empty before `entry` was added and to false otherwise, and return 0. ]
+TEST_FUNCTION(push_after_pop_all_reports_empty)
+{
+    // arrange
+    bool was_empty = false;
+    DLIST_ENTRY list;
+    MPSC_QUEUE_HANDLE queue = create_queue();
+    real_DList_InitializeListHead(&list);
+    (void)mpsc_queue_push(queue, &TEST_ITEMS[0].entry, &g_was_empty);
+    (void)mpsc_queue_pop_all(queue, &list);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = mpsc_queue_push(queue, &TEST_ITEMS[1].entry, &was_empty);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_TRUE(was_empty);
+
+    // cleanup
+    mpsc_queue_destroy(queue);
+}
+
+// Tests_SRS_MPSC_QUEUE_11_008: [ If `queue` or `listHead` is NULL, mpsc_queue_pop_all shall return 0. ]
+TEST_FUNCTION(pop_all_NULL_queue)
+{
+    // arrange
+    DLIST_ENTRY list;
+    real_DList_InitializeListHead(&list);
+
+    // act
+    size_t result = mpsc_queue_pop_all(NULL, &list);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_MPSC_QUEUE_11_008: [ If `queue` or `listHead` is NULL, mpsc_queue_pop_all shall return 0. ]
+TEST_FUNCTION(pop_all_NULL_list_keeps_the_items)
+{
+    // arrange
+    DLIST_ENTRY list;
+    MPSC_QUEUE_HANDLE queue = create_queue();
+    real_DList_InitializeListHead(&list);
+    (void)mpsc_queue_push(queue, &TEST_ITEMS[0].entry, &g_was_empty);
+    umock_c_reset_all_calls();
+
+    // act
+    size_t result = mpsc_queue_pop_all(queue, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, mpsc_queue_pop_all(queue, &list));
+
+    // cleanup
+    mpsc_queue_destroy(queue);
+}
+
+// Tests_SRS_MPSC_QUEUE_11_009: [ mpsc_queue_pop_all shall detach all the items from the queue in a single atomic exchange. ]
+// Tests_SRS_MPSC_QUEUE_11_010: [ mpsc_queue_pop_all shall append the items to `listHead` in the order they were pushed and return how many were appended. ]
+TEST_FUNCTION(pop_all_returns_the_items_in_push_order)
+{
+    // arrange
+    size_t i;
+    DLIST_ENTRY list;
+    MPSC_QUEUE_HANDLE queue = create_queue();
+    real_DList_InitializeListHead(&list);
+    for (i = 0; i < TEST_ITEM_COUNT; i++)
+    {
+        (void)mpsc_queue_push(queue, &TEST_ITEMS[i].entry, &g_was_empty);
+    }
+    umock_c_reset_all_calls();
+
+    for (i = 0; i < TEST_ITEM_COUNT; i++)
+    {
+        STRICT_EXPECTED_CALL(DList_InsertTailList(&list, &TEST_ITEMS[i].entry));
+    }
+
+    // act
+    size_t result = mpsc_queue_pop_all(queue, &list);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, TEST_ITEM_COUNT, result);
+    for (i = 0; i < TEST_ITEM_COUNT; i++)
+    {
+        PDLIST_ENTRY entry = real_DList_RemoveHeadList(&list);
+        ASSERT_ARE_EQUAL(size_t, i, containingRecord(entry, TEST_ITEM, entry)->id);
+    }
+    ASSERT_ARE_NOT_EQUAL(int, 0, real_DList_IsListEmpty(&list));
+    ASSERT_ARE_EQUAL(size_t, 0, mpsc_queue_pop_all(queue, &list));
+
+    // cleanup
+    mpsc_queue_destroy(queue);
+}
+
+// Tests_SRS_MPSC_QUEUE_11_010: [ mpsc_queue_pop_all shall append the items to `listHead` in the order they were pushed and return how many were appended. ]
+TEST_FUNCTION(pop_all_appends_after_the_items_already_in_the_list)
+{
+    // arrange
+    DLIST_ENTRY list;
+    MPSC_QUEUE_HANDLE queue = create_queue();
+    real_DList_InitializeListHead(&list);
+    real_DList_InsertTailList(&list, &TEST_ITEMS[0].entry);
+    (void)mpsc_queue_push(queue, &TEST_ITEMS[1].entry, &g_was_empty);
+    (void)mpsc_queue_push(queue, &TEST_ITEMS[2].entry, &g_was_empty);
+    umock_c_reset_all_calls();
+
+    // act
+    size_t result = mpsc_queue_pop_all(queue, &list);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, result);
+    ASSERT_ARE_EQUAL(size_t, 0, containingRecord(real_DList_RemoveHeadList(&list), TEST_ITEM, entry)->id);
+    ASSERT_ARE_EQUAL(size_t, 1, containingRecord(real_DList_RemoveHeadList(&list), TEST_ITEM, entry)->id);
+    ASSERT_ARE_EQUAL(size_t, 2, containingRecord(real_DList_RemoveHeadList(&list), TEST_ITEM, entry)->id);
+
+    // cleanup
+    mpsc_queue_destroy(queue);
+}
+
+END_TEST_SUITE(mpsc_queue_ut)
@@ -0,0 +1,227 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures how many PUBACKs per second the MQTT transport can match against its outstanding
+// telemetry messages, comparing the list walk it used to do with the packet id indexed table.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+#include "mqtt_inflight_table.h"
+
+#define LIST_SCAN_STEPS     20000000
+#define TABLE_ACK_COUNT     2000000
+
+typedef struct PERF_MESSAGE_TAG
+{
+    uint16_t packet_id;
+    DLIST_ENTRY entry;
+} PERF_MESSAGE;
+
+static const size_t OUTSTANDING_COUNTS[] = { 100, 1000, 10000 };
+
+static uint16_t g_packet_id;
+
+// Same sequence as get_next_packet_id in iothubtransport_mqtt_common.c
+static uint16_t get_next_packet_id(void)
+{
+    if (g_packet_id + 1 >= USHRT_MAX)
+    {
+        g_packet_id = 1;
+    }
+    else
+    {
+        g_packet_id++;
+    }
+    return g_packet_id;
+}
+
+static double get_acks_per_second(size_t ack_count, tickcounter_ms_t elapsed_ms)
+{
+    return (double)ack_count * 1000.0 / (double)(elapsed_ms == 0 ? 1 : elapsed_ms);
+}
+
+static PERF_MESSAGE* create_messages(size_t outstanding)
+{
+    PERF_MESSAGE* result = (PERF_MESSAGE*)malloc(outstanding * sizeof(PERF_MESSAGE));
+    if (result == NULL)
+    {
+        (void)printf("Failed allocating %lu messages\r\n", (unsigned long)outstanding);
+    }
+    return result;
+}
+
+static int run_list_scan(TICK_COUNTER_HANDLE tick_counter, size_t outstanding, double* acks_per_second)
+{
+    int result;
+    PERF_MESSAGE* messages = create_messages(outstanding);
+
+    if (messages == NULL)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        DLIST_ENTRY waiting_for_ack;
+        size_t ack_count = LIST_SCAN_STEPS / outstanding;
+        size_t index;
+        tickcounter_ms_t start_ms;
+        tickcounter_ms_t end_ms;
+
+        g_packet_id = 0;
+        DList_InitializeListHead(&waiting_for_ack);
+        for (index = 0; index < outstanding; index++)
+        {
+            messages[index].packet_id = get_next_packet_id();
+            DList_InsertTailList(&waiting_for_ack, &messages[index].entry);
+        }
+
+        (void)tickcounter_get_current_ms(tick_counter, &start_ms);
+        for (index = 0; index < ack_count; index++)
+        {
+            uint16_t acked_packet_id = messages[index % outstanding].packet_id;
+            PERF_MESSAGE* acked_message = NULL;
+            PDLIST_ENTRY current_entry = waiting_for_ack.Flink;
+
+            // This is the walk the PUBACK handler used to do for every acknowledgement.
+            while (current_entry != &waiting_for_ack)
+            {
+                PERF_MESSAGE* message = containingRecord(current_entry, PERF_MESSAGE, entry);
+                PDLIST_ENTRY next_entry = current_entry->Flink;
+
+                if (message->packet_id == acked_packet_id)
+                {
+                    (void)DList_RemoveEntryList(current_entry);
+                    acked_message = message;
+                }
+                current_entry = next_entry;
+            }
+
+            if (acked_message == NULL)
+            {
+                (void)printf("List scan lost track of a packet id\r\n");
+                break;
+            }
+
+            acked_message->packet_id = get_next_packet_id();
+            DList_InsertTailList(&waiting_for_ack, &acked_message->entry);
+        }
+        (void)tickcounter_get_current_ms(tick_counter, &end_ms);
+
+        *acks_per_second = get_acks_per_second(ack_count, end_ms - start_ms);
+        free(messages);
+        result = 0;
+    }
+
+    return result;
+}
+
+static int run_inflight_table(TICK_COUNTER_HANDLE tick_counter, size_t outstanding, double* acks_per_second)
+{
+    int result;
+    PERF_MESSAGE* messages = create_messages(outstanding);
+    MQTT_INFLIGHT_TABLE_HANDLE table;
+
+    if (messages == NULL)
+    {
+        result = __LINE__;
+    }
+    else if ((table = mqtt_inflight_table_create(0)) == NULL)
+    {
+        (void)printf("Failed creating the in-flight table\r\n");
+        free(messages);
+        result = __LINE__;
+    }
+    else
+    {
+        DLIST_ENTRY waiting_for_ack;
+        size_t index;
+        tickcounter_ms_t start_ms;
+        tickcounter_ms_t end_ms;
+
+        result = 0;
+        g_packet_id = 0;
+        DList_InitializeListHead(&waiting_for_ack);
+        for (index = 0; index < outstanding && result == 0; index++)
+        {
+            messages[index].packet_id = get_next_packet_id();
+            DList_InsertTailList(&waiting_for_ack, &messages[index].entry);
+            if (mqtt_inflight_table_add(table, messages[index].packet_id, &messages[index]) != 0)
+            {
+                result = __LINE__;
+            }
+        }
+
+        (void)tickcounter_get_current_ms(tick_counter, &start_ms);
+        for (index = 0; index < TABLE_ACK_COUNT && result == 0; index++)
+        {
+            PERF_MESSAGE* message = (PERF_MESSAGE*)mqtt_inflight_table_remove(table, messages[index % outstanding].packet_id);
+            if (message == NULL)
+            {
+                result = __LINE__;
+            }
+            else
+            {
+                (void)DList_RemoveEntryList(&message->entry);
+                message->packet_id = get_next_packet_id();
+                DList_InsertTailList(&waiting_for_ack, &message->entry);
+                if (mqtt_inflight_table_add(table, message->packet_id, message) != 0)
+                {
+                    result = __LINE__;
+                }
+            }
+        }
+        (void)tickcounter_get_current_ms(tick_counter, &end_ms);
+
+        if (result != 0)
+        {
+            (void)printf("In-flight table lost track of a packet id\r\n");
+        }
+        else
+        {
+            *acks_per_second = get_acks_per_second(TABLE_ACK_COUNT, end_ms - start_ms);
+        }
+
+        mqtt_inflight_table_destroy(table);
+        free(messages);
+    }
+
+    return result;
+}
+
+int main(void)
+{
+    int result = 0;
+    TICK_COUNTER_HANDLE tick_counter;
+
+    if ((tick_counter = tickcounter_create()) == NULL)
+    {
+        (void)printf("Failed creating tick counter\r\n");
+        result = __LINE__;
+    }
+    else
+    {
+        size_t index;
+
+        (void)printf("%12s %20s %20s\r\n", "outstanding", "list scan acks/sec", "table acks/sec");
+        for (index = 0; index < sizeof(OUTSTANDING_COUNTS) / sizeof(OUTSTANDING_COUNTS[0]) && result == 0; index++)
+        {
+            double list_acks_per_second;
+            double table_acks_per_second;
+
+            if ((result = run_list_scan(tick_counter, OUTSTANDING_COUNTS[index], &list_acks_per_second)) == 0 &&
+                (result = run_inflight_table(tick_counter, OUTSTANDING_COUNTS[index], &table_acks_per_second)) == 0)
+            {
+                (void)printf("%12lu %20.0f %20.0f\r\n", (unsigned long)OUTSTANDING_COUNTS[index], list_acks_per_second, table_acks_per_second);
+            }
+        }
+
+        tickcounter_destroy(tick_counter);
+    }
+
+    return result;
+}
@@ -0,0 +1,514 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+#include <limits.h>
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "mqtt_inflight_table.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define DEFAULT_INITIAL_CAPACITY            32
+#define TEST_PACKET_COUNT                   1000
+
+static int TEST_VALUES[TEST_PACKET_COUNT + 1];
+
+
+// Helpers
+
+static void set_mqtt_inflight_table_create_expected_calls()
+{
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+}
+
+static MQTT_INFLIGHT_TABLE_HANDLE create_table(size_t initial_capacity)
+{
+    MQTT_INFLIGHT_TABLE_HANDLE result = mqtt_inflight_table_create(initial_capacity);
+    ASSERT_IS_NOT_NULL_WITH_MSG(result, "Failed creating the in-flight table");
+    return result;
+}
+
+static void add_packets(MQTT_INFLIGHT_TABLE_HANDLE table, uint16_t first_packet_id, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        uint16_t packet_id = (uint16_t)(first_packet_id + i);
+        ASSERT_ARE_EQUAL(int, 0, mqtt_inflight_table_add(table, packet_id, &TEST_VALUES[packet_id % (TEST_PACKET_COUNT + 1)]));
+    }
+}
+
+
+BEGIN_TEST_SUITE(mqtt_inflight_table_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(free, real_free);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_001: [ Memory shall be allocated for the MQTT_INFLIGHT_TABLE data structure. ]
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_003: [ mqtt_inflight_table_create shall allocate a power of two number of slots able to hold `initial_capacity` entries at a load factor of one half, or a default number of slots if `initial_capacity` is zero. ]
+TEST_FUNCTION(create_success)
+{
+    // arrange
+    set_mqtt_inflight_table_create_expected_calls();
+
+    // act
+    MQTT_INFLIGHT_TABLE_HANDLE table = mqtt_inflight_table_create(0);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(table);
+    ASSERT_ARE_EQUAL(size_t, 0, mqtt_inflight_table_get_count(table));
+
+    // cleanup
+    mqtt_inflight_table_destroy(table);
+}
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_002: [ If any allocation fails, mqtt_inflight_table_create shall fail and return NULL. ]
+TEST_FUNCTION(create_failure_checks)
+{
+    // arrange
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    set_mqtt_inflight_table_create_expected_calls();
+    umock_c_negative_tests_snapshot();
+
+    size_t i;
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        // arrange
+        char error_msg[64];
+        sprintf(error_msg, "On failed call %zu", i);
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        MQTT_INFLIGHT_TABLE_HANDLE table = mqtt_inflight_table_create(0);
+
+        // assert
+        ASSERT_IS_NULL_WITH_MSG(table, error_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_004: [ If `table` is NULL, mqtt_inflight_table_destroy shall return. ]
+TEST_FUNCTION(destroy_NULL_table)
+{
+    // arrange
+
+    // act
+    mqtt_inflight_table_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_005: [ mqtt_inflight_table_destroy shall free the slots and the table, but not the stored values. ]
+TEST_FUNCTION(destroy_success)
+{
+    // arrange
+    MQTT_INFLIGHT_TABLE_HANDLE table = create_table(0);
+    add_packets(table, 1, 3);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+    // act
+    mqtt_inflight_table_destroy(table);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_006: [ If `table` or `value` is NULL, or `packet_id` is zero, mqtt_inflight_table_add shall fail and return a non-zero value. ]
+TEST_FUNCTION(add_NULL_table)
+{
+    // arrange
+
+    // act
+    int result = mqtt_inflight_table_add(NULL, 1, &TEST_VALUES[1]);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_006: [ If `table` or `value` is NULL, or `packet_id` is zero, mqtt_inflight_table_add shall fail and return a non-zero value. ]
+TEST_FUNCTION(add_NULL_value)
+{
+    // arrange
+    MQTT_INFLIGHT_TABLE_HANDLE table = create_table(0);
+
+    // act
+    int result = mqtt_inflight_table_add(table, 1, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 0, mqtt_inflight_table_get_count(table));
+
+    // cleanup
+    mqtt_inflight_table_destroy(table);
+}
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_006: [ If `table` or `value` is NULL, or `packet_id` is zero, mqtt_inflight_table_add shall fail and return a non-zero value. ]
+TEST_FUNCTION(add_zero_packet_id)
+{
+    // arrange
+    MQTT_INFLIGHT_TABLE_HANDLE table = create_table(0);
+
+    // act
+    int result = mqtt_inflight_table_add(table, 0, &TEST_VALUES[0]);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 0, mqtt_inflight_table_get_count(table));
+
+    // cleanup
+    mqtt_inflight_table_destroy(table);
+}
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_007: [ If `packet_id` is already in the table, mqtt_inflight_table_add shall fail and return a non-zero value. ]
+TEST_FUNCTION(add_duplicate_packet_id)
+{
+    // arrange
+    MQTT_INFLIGHT_TABLE_HANDLE table = create_table(0);
+    add_packets(table, 7, 1);
+
+    // act
+    int result = mqtt_inflight_table_add(table, 7, &TEST_VALUES[8]);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, mqtt_inflight_table_get_count(table));
+    ASSERT_ARE_EQUAL(void_ptr, &TEST_VALUES[7], mqtt_inflight_table_find(table, 7));
+
+    // cleanup
+    mqtt_inflight_table_destroy(table);
+}
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_010: [ On success mqtt_inflight_table_add shall store `value` for `packet_id` and return 0. ]
+TEST_FUNCTION(add_success)
+{
+    // arrange
+    MQTT_INFLIGHT_TABLE_HANDLE table = create_table(0);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = mqtt_inflight_table_add(table, 42, &TEST_VALUES[42]);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, mqtt_inflight_table_get_count(table));
+    ASSERT_ARE_EQUAL(void_ptr, &TEST_VALUES[42], mqtt_inflight_table_find(table, 42));
+
+    // cleanup
+    mqtt_inflight_table_destroy(table);
+}
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_008: [ If adding the entry would take the load factor above one half, mqtt_inflight_table_add shall double the number of slots and rehash the existing entries. ]
+TEST_FUNCTION(add_grows_table)
+{
+    // arrange
+    MQTT_INFLIGHT_TABLE_HANDLE table = create_table(0);
+    add_packets(table, 1, DEFAULT_INITIAL_CAPACITY / 2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+    // act
+    int result = mqtt_inflight_table_add(table, DEFAULT_INITIAL_CAPACITY / 2 + 1, &TEST_VALUES[DEFAULT_INITIAL_CAPACITY / 2 + 1]);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, DEFAULT_INITIAL_CAPACITY / 2 + 1, mqtt_inflight_table_get_count(table));
+
+    for (uint16_t packet_id = 1; packet_id <= DEFAULT_INITIAL_CAPACITY / 2 + 1; packet_id++)
+    {
+        ASSERT_ARE_EQUAL(void_ptr, &TEST_VALUES[packet_id], mqtt_inflight_table_find(table, packet_id));
+    }
+
+    // cleanup
+    mqtt_inflight_table_destroy(table);
+}
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_009: [ If growing the table fails, mqtt_inflight_table_add shall fail and return a non-zero value. ]
+TEST_FUNCTION(add_grow_fails)
+{
+    // arrange
+    MQTT_INFLIGHT_TABLE_HANDLE table = create_table(0);
+    add_packets(table, 1, DEFAULT_INITIAL_CAPACITY / 2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    // act
+    int result = mqtt_inflight_table_add(table, DEFAULT_INITIAL_CAPACITY / 2 + 1, &TEST_VALUES[DEFAULT_INITIAL_CAPACITY / 2 + 1]);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, DEFAULT_INITIAL_CAPACITY / 2, mqtt_inflight_table_get_count(table));
+    ASSERT_ARE_EQUAL(void_ptr, &TEST_VALUES[1], mqtt_inflight_table_find(table, 1));
+
+    // cleanup
+    mqtt_inflight_table_destroy(table);
+}
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_011: [ If `table` is NULL or `packet_id` is zero, mqtt_inflight_table_find shall return NULL. ]
+TEST_FUNCTION(find_NULL_table)
+{
+    // arrange
+
+    // act
+    void* result = mqtt_inflight_table_find(NULL, 1);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_012: [ mqtt_inflight_table_find shall return the value stored for `packet_id`, or NULL if there is none. ]
+TEST_FUNCTION(find_not_in_table)
+{
+    // arrange
+    MQTT_INFLIGHT_TABLE_HANDLE table = create_table(0);
+    add_packets(table, 1, 3);
+
+    // act
+    void* result = mqtt_inflight_table_find(table, 1 + DEFAULT_INITIAL_CAPACITY);
+
+    // assert
+    ASSERT_IS_NULL(result);
+
+    // cleanup
+    mqtt_inflight_table_destroy(table);
+}
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_013: [ If `table` is NULL or `packet_id` is zero, mqtt_inflight_table_remove shall return NULL. ]
+TEST_FUNCTION(remove_NULL_table)
+{
+    // arrange
+
+    // act
+    void* result = mqtt_inflight_table_remove(NULL, 1);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_014: [ If `packet_id` is not in the table, mqtt_inflight_table_remove shall return NULL. ]
+TEST_FUNCTION(remove_not_in_table)
+{
+    // arrange
+    MQTT_INFLIGHT_TABLE_HANDLE table = create_table(0);
+    add_packets(table, 1, 3);
+
+    // act
+    void* result = mqtt_inflight_table_remove(table, 4);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, 3, mqtt_inflight_table_get_count(table));
+
+    // cleanup
+    mqtt_inflight_table_destroy(table);
+}
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_015: [ mqtt_inflight_table_remove shall remove `packet_id` from the table and return the value that was stored for it. ]
+TEST_FUNCTION(remove_success)
+{
+    // arrange
+    MQTT_INFLIGHT_TABLE_HANDLE table = create_table(0);
+    add_packets(table, 1, 3);
+    umock_c_reset_all_calls();
+
+    // act
+    void* result = mqtt_inflight_table_remove(table, 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, &TEST_VALUES[2], result);
+    ASSERT_ARE_EQUAL(size_t, 2, mqtt_inflight_table_get_count(table));
+    ASSERT_IS_NULL(mqtt_inflight_table_find(table, 2));
+    ASSERT_ARE_EQUAL(void_ptr, &TEST_VALUES[1], mqtt_inflight_table_find(table, 1));
+    ASSERT_ARE_EQUAL(void_ptr, &TEST_VALUES[3], mqtt_inflight_table_find(table, 3));
+
+    // cleanup
+    mqtt_inflight_table_destroy(table);
+}
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_015: [ mqtt_inflight_table_remove shall remove `packet_id` from the table and return the value that was stored for it. ]
+TEST_FUNCTION(remove_keeps_remaining_entries_reachable)
+{
+    // arrange
+    uint16_t packet_id;
+    uint16_t removed_packet_id;
+    MQTT_INFLIGHT_TABLE_HANDLE table = create_table(0);
+
+    // Fill the default table up to its load factor so that probe sequences overlap.
+    for (packet_id = 1; packet_id <= DEFAULT_INITIAL_CAPACITY / 2; packet_id++)
+    {
+        ASSERT_ARE_EQUAL(int, 0, mqtt_inflight_table_add(table, packet_id, &TEST_VALUES[packet_id]));
+    }
+
+    // act
+    for (removed_packet_id = 1; removed_packet_id <= DEFAULT_INITIAL_CAPACITY / 2; removed_packet_id += 2)
+    {
+        ASSERT_ARE_EQUAL(void_ptr, &TEST_VALUES[removed_packet_id], mqtt_inflight_table_remove(table, removed_packet_id));
+    }
+
+    // assert
+    for (packet_id = 1; packet_id <= DEFAULT_INITIAL_CAPACITY / 2; packet_id++)
+    {
+        void* expected_value = (packet_id % 2 == 0) ? &TEST_VALUES[packet_id] : NULL;
+        ASSERT_ARE_EQUAL(void_ptr, expected_value, mqtt_inflight_table_find(table, packet_id));
+    }
+    ASSERT_ARE_EQUAL(size_t, DEFAULT_INITIAL_CAPACITY / 4, mqtt_inflight_table_get_count(table));
+
+    // cleanup
+    mqtt_inflight_table_destroy(table);
+}
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_016: [ mqtt_inflight_table_get_count shall return the number of entries in the table, or zero if `table` is NULL. ]
+TEST_FUNCTION(get_count_NULL_table)
+{
+    // arrange
+
+    // act
+    size_t result = mqtt_inflight_table_get_count(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+}
+
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_010: [ On success mqtt_inflight_table_add shall store `value` for `packet_id` and return 0. ]
+// Tests_SRS_MQTT_INFLIGHT_TABLE_11_015: [ mqtt_inflight_table_remove shall remove `packet_id` from the table and return the value that was stored for it. ]
+TEST_FUNCTION(add_and_remove_many_packets_across_wrap)
+{
+    // arrange
+    MQTT_INFLIGHT_TABLE_HANDLE table = create_table(0);
+    uint16_t first_packet_id = (uint16_t)(USHRT_MAX - TEST_PACKET_COUNT / 2);
+    size_t i;
+
+    for (i = 0; i < TEST_PACKET_COUNT; i++)
+    {
+        uint16_t packet_id = (uint16_t)(first_packet_id + i);
+        if (packet_id == 0)
+        {
+            continue;
+        }
+        ASSERT_ARE_EQUAL(int, 0, mqtt_inflight_table_add(table, packet_id, &TEST_VALUES[i]));
+    }
+
+    // act
+    for (i = 0; i < TEST_PACKET_COUNT; i++)
+    {
+        uint16_t packet_id = (uint16_t)(first_packet_id + i);
+        if (packet_id == 0)
+        {
+            continue;
+        }
+        ASSERT_ARE_EQUAL(void_ptr, &TEST_VALUES[i], mqtt_inflight_table_remove(table, packet_id));
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, mqtt_inflight_table_get_count(table));
+
+    // cleanup
+    mqtt_inflight_table_destroy(table);
+}
+
+END_TEST_SUITE(mqtt_inflight_table_ut)
@@ -0,0 +1,239 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures how many telemetry topics per second the MQTT transport can build for messages with
+// 0, 5 and 20 application properties, comparing the STRING_sprintf chain it used to run for every
+// publish with the single pass topic builder.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/map.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+#include "iothub_message.h"
+#include "mqtt_telemetry_topic.h"
+
+#define TOPIC_COUNT         200000
+#define DEVICE_ID           "perfDevice"
+
+static const size_t PROPERTY_COUNTS[] = { 0, 5, 20 };
+
+static double get_topics_per_second(size_t topic_count, tickcounter_ms_t elapsed_ms)
+{
+    return (double)topic_count * 1000.0 / (double)(elapsed_ms == 0 ? 1 : elapsed_ms);
+}
+
+// Same topic as addPropertiesTouMqttMessage in iothubtransport_mqtt_common.c used to build (without diagnostics).
+static STRING_HANDLE build_topic_with_sprintf(IOTHUB_MESSAGE_HANDLE message, const char* event_topic)
+{
+    STRING_HANDLE result = STRING_construct(event_topic);
+    const char* const* keys;
+    const char* const* values;
+    size_t count;
+    size_t index = 0;
+    MAP_HANDLE properties = IoTHubMessage_Properties(message);
+    const char* correlation_id;
+    const char* message_id;
+    const char* content_type;
+    const char* content_encoding;
+
+    if (result != NULL && properties != NULL && Map_GetInternals(properties, &keys, &values, &count) == MAP_OK)
+    {
+        for (index = 0; index < count && result != NULL; index++)
+        {
+            if (STRING_sprintf(result, "%s=%s%s", keys[index], values[index], count - 1 == index ? "" : "&") != 0)
+            {
+                STRING_delete(result);
+                result = NULL;
+            }
+        }
+    }
+    if (result != NULL && (correlation_id = IoTHubMessage_GetCorrelationId(message)) != NULL)
+    {
+        (void)STRING_sprintf(result, "%s%%24.cid=%s", index++ == 0 ? "" : "&", correlation_id);
+    }
+    if (result != NULL && (message_id = IoTHubMessage_GetMessageId(message)) != NULL)
+    {
+        (void)STRING_sprintf(result, "%s%%24.mid=%s", index++ == 0 ? "" : "&", message_id);
+    }
+    if (result != NULL && (content_type = IoTHubMessage_GetContentTypeSystemProperty(message)) != NULL)
+    {
+        (void)STRING_sprintf(result, "%s%%24.%s=%s", index++ == 0 ? "" : "&", "ct", content_type);
+    }
+    if (result != NULL && (content_encoding = IoTHubMessage_GetContentEncodingSystemProperty(message)) != NULL)
+    {
+        (void)STRING_sprintf(result, "%s%%24.%s=%s", index++ == 0 ? "" : "&", "ce", content_encoding);
+    }
+
+    return result;
+}
+
+static IOTHUB_MESSAGE_HANDLE create_message(size_t property_count)
+{
+    IOTHUB_MESSAGE_HANDLE result;
+
+    if ((result = IoTHubMessage_CreateFromString("{\"temperature\":21.5}")) == NULL)
+    {
+        (void)printf("Failed creating the message\r\n");
+    }
+    else
+    {
+        MAP_HANDLE properties = IoTHubMessage_Properties(result);
+        size_t index;
+
+        (void)IoTHubMessage_SetMessageId(result, "3f2504e0-4f89-11d3-9a0c-0305e82c3301");
+        (void)IoTHubMessage_SetCorrelationId(result, "9a0c0305e82c3301");
+        (void)IoTHubMessage_SetContentTypeSystemProperty(result, "application%2Fjson");
+        (void)IoTHubMessage_SetContentEncodingSystemProperty(result, "utf-8");
+
+        for (index = 0; index < property_count; index++)
+        {
+            char key[32];
+            char value[32];
+            (void)sprintf(key, "property%lu", (unsigned long)index);
+            (void)sprintf(value, "value%lu", (unsigned long)index);
+            if (Map_AddOrUpdate(properties, key, value) != MAP_OK)
+            {
+                (void)printf("Failed adding a message property\r\n");
+                IoTHubMessage_Destroy(result);
+                result = NULL;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+static int run_sprintf_chain(TICK_COUNTER_HANDLE tick_counter, IOTHUB_MESSAGE_HANDLE message, double* topics_per_second, size_t* topic_length)
+{
+    int result = 0;
+    STRING_HANDLE event_topic = STRING_construct("devices/" DEVICE_ID "/messages/events/");
+
+    if (event_topic == NULL)
+    {
+        (void)printf("Failed creating the event topic\r\n");
+        result = __LINE__;
+    }
+    else
+    {
+        size_t index;
+        tickcounter_ms_t start_ms;
+        tickcounter_ms_t end_ms;
+
+        (void)tickcounter_get_current_ms(tick_counter, &start_ms);
+        for (index = 0; index < TOPIC_COUNT && result == 0; index++)
+        {
+            STRING_HANDLE topic = build_topic_with_sprintf(message, STRING_c_str(event_topic));
+            if (topic == NULL)
+            {
+                result = __LINE__;
+            }
+            else
+            {
+                *topic_length = STRING_length(topic);
+                STRING_delete(topic);
+            }
+        }
+        (void)tickcounter_get_current_ms(tick_counter, &end_ms);
+
+        *topics_per_second = get_topics_per_second(TOPIC_COUNT, end_ms - start_ms);
+        STRING_delete(event_topic);
+    }
+
+    return result;
+}
+
+static int run_topic_builder(TICK_COUNTER_HANDLE tick_counter, IOTHUB_MESSAGE_HANDLE message, double* topics_per_second, size_t* topic_length)
+{
+    int result = 0;
+    MQTT_TELEMETRY_TOPIC_HANDLE telemetry_topic = mqtt_telemetry_topic_create(DEVICE_ID);
+
+    if (telemetry_topic == NULL)
+    {
+        (void)printf("Failed creating the telemetry topic\r\n");
+        result = __LINE__;
+    }
+    else
+    {
+        size_t index;
+        tickcounter_ms_t start_ms;
+        tickcounter_ms_t end_ms;
+
+        (void)tickcounter_get_current_ms(tick_counter, &start_ms);
+        for (index = 0; index < TOPIC_COUNT && result == 0; index++)
+        {
+            const char* topic = mqtt_telemetry_topic_build(telemetry_topic, message, NULL);
+            if (topic == NULL)
+            {
+                result = __LINE__;
+            }
+            else
+            {
+                *topic_length = strlen(topic);
+            }
+        }
+        (void)tickcounter_get_current_ms(tick_counter, &end_ms);
+
+        *topics_per_second = get_topics_per_second(TOPIC_COUNT, end_ms - start_ms);
+        mqtt_telemetry_topic_destroy(telemetry_topic);
+    }
+
+    return result;
+}
+
+int main(void)
+{
+    int result = 0;
+    TICK_COUNTER_HANDLE tick_counter;
+
+    if ((tick_counter = tickcounter_create()) == NULL)
+    {
+        (void)printf("Failed creating tick counter\r\n");
+        result = __LINE__;
+    }
+    else
+    {
+        size_t index;
+
+        (void)printf("%12s %12s %22s %22s\r\n", "properties", "topic bytes", "sprintf topics/sec", "builder topics/sec");
+        for (index = 0; index < sizeof(PROPERTY_COUNTS) / sizeof(PROPERTY_COUNTS[0]) && result == 0; index++)
+        {
+            IOTHUB_MESSAGE_HANDLE message = create_message(PROPERTY_COUNTS[index]);
+
+            if (message == NULL)
+            {
+                result = __LINE__;
+            }
+            else
+            {
+                double sprintf_topics_per_second;
+                double builder_topics_per_second;
+                size_t sprintf_topic_length = 0;
+                size_t builder_topic_length = 0;
+
+                if ((result = run_sprintf_chain(tick_counter, message, &sprintf_topics_per_second, &sprintf_topic_length)) == 0 &&
+                    (result = run_topic_builder(tick_counter, message, &builder_topics_per_second, &builder_topic_length)) == 0)
+                {
+                    if (sprintf_topic_length != builder_topic_length)
+                    {
+                        (void)printf("Topic builder produced %lu bytes instead of %lu\r\n", (unsigned long)builder_topic_length, (unsigned long)sprintf_topic_length);
+                        result = __LINE__;
+                    }
+                    else
+                    {
+                        (void)printf("%12lu %12lu %22.0f %22.0f\r\n", (unsigned long)PROPERTY_COUNTS[index], (unsigned long)builder_topic_length, sprintf_topics_per_second, builder_topics_per_second);
+                    }
+                }
+
+                IoTHubMessage_Destroy(message);
+            }
+        }
+
+        tickcounter_destroy(tick_counter);
+    }
+
+    return result;
+}
@@ -0,0 +1,665 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void* real_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/urlencode.h"
+#include "iothub_message.h"
+#undef ENABLE_MOCKS
+
+#include "mqtt_telemetry_topic.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_MESSAGE_HANDLE         (IOTHUB_MESSAGE_HANDLE)0x4441
+
+static const char* TEST_DEVICE_ID = "thisIsDeviceID";
+static const char* TEST_EVENT_TOPIC = "devices/thisIsDeviceID/messages/events/";
+static const char* TEST_DIAG_CONTEXT_KEY = "creationtimeutc=";
+static const char* TEST_CORRELATION_ID = "core_id";
+static const char* TEST_MESSAGE_ID = "msg_id";
+static const char* TEST_CONTENT_TYPE = "application/json";
+static const char* TEST_CONTENT_ENCODING = "utf8";
+static const char* TEST_DIAG_ID = "1234abcd";
+static const char* TEST_DIAG_CREATION_TIME_UTC = "1506054516.100";
+
+static const char* TEST_PROPERTY_KEYS[] = { "propKey1", "propKey2" };
+static const char* TEST_PROPERTY_VALUES[] = { "propValue1", "propValue2" };
+
+static IOTHUB_MESSAGE_PROPERTY g_properties[2];
+static size_t g_property_count;
+static IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA g_diag_data;
+
+
+// Mock hooks
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_GetPropertyTable(IOTHUB_MESSAGE_HANDLE handle, const IOTHUB_MESSAGE_PROPERTY** properties, size_t* count)
+{
+    (void)handle;
+    *properties = (g_property_count == 0) ? NULL : g_properties;
+    *count = g_property_count;
+    return IOTHUB_MESSAGE_OK;
+}
+
+// The STRING_HANDLEs handed out by this test are plain null terminated strings.
+static STRING_HANDLE my_URL_EncodeString(const char* textEncode)
+{
+    char* result = (char*)real_malloc(strlen(textEncode) * 3 + 1);
+    char* position = result;
+
+    for (; *textEncode != '\0'; textEncode++)
+    {
+        if (isalnum((unsigned char)*textEncode) || *textEncode == '-' || *textEncode == '_' || *textEncode == '.' || *textEncode == '~')
+        {
+            *position++ = *textEncode;
+        }
+        else
+        {
+            position += sprintf(position, "%%%02x", (unsigned char)*textEncode);
+        }
+    }
+    *position = '\0';
+
+    return (STRING_HANDLE)result;
+}
+
+static const char* my_STRING_c_str(STRING_HANDLE handle)
+{
+    return (const char*)handle;
+}
+
+static void my_STRING_delete(STRING_HANDLE handle)
+{
+    real_free(handle);
+}
+
+
+// Helpers
+
+static void set_properties(const char** keys, const char** values, size_t count)
+{
+    size_t index;
+    for (index = 0; index < count; index++)
+    {
+        g_properties[index].key = keys[index];
+        g_properties[index].keyLength = strlen(keys[index]);
+        g_properties[index].value = values[index];
+        g_properties[index].valueLength = strlen(values[index]);
+    }
+    g_property_count = count;
+}
+
+static void set_mqtt_telemetry_topic_create_expected_calls()
+{
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(URL_EncodeString(TEST_DIAG_CONTEXT_KEY));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+}
+
+static void set_mqtt_telemetry_topic_build_expected_calls(const char* correlation_id, const char* message_id, const char* content_type, const char* content_encoding, bool has_diag, bool grows_buffer)
+{
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPropertyTable(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetCorrelationId(TEST_MESSAGE_HANDLE)).SetReturn(correlation_id);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(TEST_MESSAGE_HANDLE)).SetReturn(message_id);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentTypeSystemProperty(TEST_MESSAGE_HANDLE)).SetReturn(content_type);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentEncodingSystemProperty(TEST_MESSAGE_HANDLE)).SetReturn(content_encoding);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetDiagnosticPropertyData(TEST_MESSAGE_HANDLE)).SetReturn(has_diag ? &g_diag_data : NULL);
+    if (has_diag)
+    {
+        STRICT_EXPECTED_CALL(URL_EncodeString(g_diag_data.diagnosticCreationTimeUtc));
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    }
+    if (grows_buffer)
+    {
+        STRICT_EXPECTED_CALL(realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    }
+    if (has_diag)
+    {
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    }
+}
+
+static MQTT_TELEMETRY_TOPIC_HANDLE create_topic()
+{
+    MQTT_TELEMETRY_TOPIC_HANDLE result = mqtt_telemetry_topic_create(TEST_DEVICE_ID);
+    ASSERT_IS_NOT_NULL_WITH_MSG(result, "Failed creating the telemetry topic");
+    umock_c_reset_all_calls();
+    return result;
+}
+
+
+BEGIN_TEST_SUITE(mqtt_telemetry_topic_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(realloc, real_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(free, real_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(URL_EncodeString, my_URL_EncodeString);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(URL_EncodeString, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_c_str, my_STRING_c_str);
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_delete, my_STRING_delete);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetPropertyTable, my_IoTHubMessage_GetPropertyTable);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetPropertyTable, IOTHUB_MESSAGE_ERROR);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    set_properties(NULL, NULL, 0);
+    g_diag_data.diagnosticId = (char*)TEST_DIAG_ID;
+    g_diag_data.diagnosticCreationTimeUtc = (char*)TEST_DIAG_CREATION_TIME_UTC;
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_001: [ If `device_id` is NULL, mqtt_telemetry_topic_create shall fail and return NULL. ]
+TEST_FUNCTION(create_NULL_device_id)
+{
+    // arrange
+
+    // act
+    MQTT_TELEMETRY_TOPIC_HANDLE topic = mqtt_telemetry_topic_create(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(topic);
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_002: [ mqtt_telemetry_topic_create shall allocate memory for the MQTT_TELEMETRY_TOPIC data structure. ]
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_003: [ mqtt_telemetry_topic_create shall store the topic prefix "devices/<device_id>/messages/events/". ]
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_004: [ mqtt_telemetry_topic_create shall URL encode the diagnostic context key "creationtimeutc=" once and store it. ]
+TEST_FUNCTION(create_success)
+{
+    // arrange
+    set_mqtt_telemetry_topic_create_expected_calls();
+
+    // act
+    MQTT_TELEMETRY_TOPIC_HANDLE topic = mqtt_telemetry_topic_create(TEST_DEVICE_ID);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(topic);
+
+    // cleanup
+    mqtt_telemetry_topic_destroy(topic);
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_005: [ If any allocation or encoding fails, mqtt_telemetry_topic_create shall fail and return NULL. ]
+TEST_FUNCTION(create_failure_checks)
+{
+    // arrange
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    set_mqtt_telemetry_topic_create_expected_calls();
+    umock_c_negative_tests_snapshot();
+
+    size_t i;
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        // STRING_c_str and STRING_delete cannot fail.
+        if (i == 3 || i == 5)
+        {
+            continue;
+        }
+
+        // arrange
+        char error_msg[64];
+        sprintf(error_msg, "On failed call %zu", i);
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        MQTT_TELEMETRY_TOPIC_HANDLE topic = mqtt_telemetry_topic_create(TEST_DEVICE_ID);
+
+        // assert
+        ASSERT_IS_NULL_WITH_MSG(topic, error_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_006: [ If `handle` is NULL, mqtt_telemetry_topic_destroy shall return. ]
+TEST_FUNCTION(destroy_NULL_handle)
+{
+    // arrange
+
+    // act
+    mqtt_telemetry_topic_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_007: [ mqtt_telemetry_topic_destroy shall free the topic buffer, the stored prefixes and the handle itself. ]
+TEST_FUNCTION(destroy_success)
+{
+    // arrange
+    MQTT_TELEMETRY_TOPIC_HANDLE topic = create_topic();
+    (void)mqtt_telemetry_topic_build(topic, TEST_MESSAGE_HANDLE, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+    // act
+    mqtt_telemetry_topic_destroy(topic);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_008: [ If `handle` or `message` is NULL, mqtt_telemetry_topic_build shall fail and return NULL. ]
+TEST_FUNCTION(build_NULL_handle)
+{
+    // arrange
+
+    // act
+    const char* result = mqtt_telemetry_topic_build(NULL, TEST_MESSAGE_HANDLE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_008: [ If `handle` or `message` is NULL, mqtt_telemetry_topic_build shall fail and return NULL. ]
+TEST_FUNCTION(build_NULL_message)
+{
+    // arrange
+    MQTT_TELEMETRY_TOPIC_HANDLE topic = create_topic();
+
+    // act
+    const char* result = mqtt_telemetry_topic_build(topic, NULL, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+
+    // cleanup
+    mqtt_telemetry_topic_destroy(topic);
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_009: [ mqtt_telemetry_topic_build shall obtain the application properties of `message` and the lengths of their keys and values using IoTHubMessage_GetPropertyTable. ]
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_011: [ mqtt_telemetry_topic_build shall read the CorrelationId, MessageId, ContentType, ContentEncoding and diagnostic data of `message`. ]
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_018: [ On success mqtt_telemetry_topic_build shall return the topic stored in the buffer owned by `handle`. ]
+TEST_FUNCTION(build_no_properties_success)
+{
+    // arrange
+    MQTT_TELEMETRY_TOPIC_HANDLE topic = create_topic();
+    set_mqtt_telemetry_topic_build_expected_calls(NULL, NULL, NULL, NULL, false, true);
+
+    // act
+    const char* result = mqtt_telemetry_topic_build(topic, TEST_MESSAGE_HANDLE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_EVENT_TOPIC, result);
+
+    // cleanup
+    mqtt_telemetry_topic_destroy(topic);
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_010: [ If IoTHubMessage_GetPropertyTable fails, mqtt_telemetry_topic_build shall fail and return NULL. ]
+TEST_FUNCTION(build_IoTHubMessage_GetPropertyTable_fails)
+{
+    // arrange
+    MQTT_TELEMETRY_TOPIC_HANDLE topic = create_topic();
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPropertyTable(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(IOTHUB_MESSAGE_ERROR);
+
+    // act
+    const char* result = mqtt_telemetry_topic_build(topic, TEST_MESSAGE_HANDLE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+
+    // cleanup
+    mqtt_telemetry_topic_destroy(topic);
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_017: [ mqtt_telemetry_topic_build shall write the topic prefix followed by each application property as `key=value`, then `%24.cid`, `%24.mid`, `%24.ct`, `%24.ce`, `%24.diagid` and `%24.diagctx` for each system property present, separated by `&`. ]
+TEST_FUNCTION(build_1_property_success)
+{
+    // arrange
+    MQTT_TELEMETRY_TOPIC_HANDLE topic = create_topic();
+    set_properties(TEST_PROPERTY_KEYS, TEST_PROPERTY_VALUES, 1);
+    set_mqtt_telemetry_topic_build_expected_calls(NULL, NULL, NULL, NULL, false, true);
+
+    // act
+    const char* result = mqtt_telemetry_topic_build(topic, TEST_MESSAGE_HANDLE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "devices/thisIsDeviceID/messages/events/propKey1=propValue1", result);
+
+    // cleanup
+    mqtt_telemetry_topic_destroy(topic);
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_019: [ If `topic_length` is not NULL, mqtt_telemetry_topic_build shall store in it the length of the topic measured by the first pass, without its terminating null. ]
+TEST_FUNCTION(build_returns_the_topic_length_success)
+{
+    // arrange
+    MQTT_TELEMETRY_TOPIC_HANDLE topic = create_topic();
+    size_t topic_length = 0;
+    set_properties(TEST_PROPERTY_KEYS, TEST_PROPERTY_VALUES, 1);
+    set_mqtt_telemetry_topic_build_expected_calls(NULL, NULL, NULL, NULL, false, true);
+
+    // act
+    const char* result = mqtt_telemetry_topic_build(topic, TEST_MESSAGE_HANDLE, &topic_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "devices/thisIsDeviceID/messages/events/propKey1=propValue1", result);
+    ASSERT_ARE_EQUAL(size_t, strlen(result), topic_length);
+
+    // cleanup
+    mqtt_telemetry_topic_destroy(topic);
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_017: [ mqtt_telemetry_topic_build shall write the topic prefix followed by each application property as `key=value`, then `%24.cid`, `%24.mid`, `%24.ct`, `%24.ce`, `%24.diagid` and `%24.diagctx` for each system property present, separated by `&`. ]
+TEST_FUNCTION(build_2_properties_success)
+{
+    // arrange
+    MQTT_TELEMETRY_TOPIC_HANDLE topic = create_topic();
+    set_properties(TEST_PROPERTY_KEYS, TEST_PROPERTY_VALUES, 2);
+    set_mqtt_telemetry_topic_build_expected_calls(NULL, NULL, NULL, NULL, false, true);
+
+    // act
+    const char* result = mqtt_telemetry_topic_build(topic, TEST_MESSAGE_HANDLE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "devices/thisIsDeviceID/messages/events/propKey1=propValue1&propKey2=propValue2", result);
+
+    // cleanup
+    mqtt_telemetry_topic_destroy(topic);
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_013: [ If the diagnostic data is present, mqtt_telemetry_topic_build shall URL encode the creation time using URL_EncodeString. ]
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_017: [ mqtt_telemetry_topic_build shall write the topic prefix followed by each application property as `key=value`, then `%24.cid`, `%24.mid`, `%24.ct`, `%24.ce`, `%24.diagid` and `%24.diagctx` for each system property present, separated by `&`. ]
+TEST_FUNCTION(build_system_properties_success)
+{
+    // arrange
+    MQTT_TELEMETRY_TOPIC_HANDLE topic = create_topic();
+    set_mqtt_telemetry_topic_build_expected_calls(TEST_CORRELATION_ID, TEST_MESSAGE_ID, TEST_CONTENT_TYPE, TEST_CONTENT_ENCODING, true, true);
+
+    // act
+    const char* result = mqtt_telemetry_topic_build(topic, TEST_MESSAGE_HANDLE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "devices/thisIsDeviceID/messages/events/%24.cid=core_id&%24.mid=msg_id&%24.ct=application/json&%24.ce=utf8&%24.diagid=1234abcd&%24.diagctx=creationtimeutc%3d1506054516.100", result);
+
+    // cleanup
+    mqtt_telemetry_topic_destroy(topic);
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_017: [ mqtt_telemetry_topic_build shall write the topic prefix followed by each application property as `key=value`, then `%24.cid`, `%24.mid`, `%24.ct`, `%24.ce`, `%24.diagid` and `%24.diagctx` for each system property present, separated by `&`. ]
+TEST_FUNCTION(build_properties_and_system_properties_success)
+{
+    // arrange
+    MQTT_TELEMETRY_TOPIC_HANDLE topic = create_topic();
+    set_properties(TEST_PROPERTY_KEYS, TEST_PROPERTY_VALUES, 2);
+    set_mqtt_telemetry_topic_build_expected_calls(NULL, TEST_MESSAGE_ID, NULL, TEST_CONTENT_ENCODING, false, true);
+
+    // act
+    const char* result = mqtt_telemetry_topic_build(topic, TEST_MESSAGE_HANDLE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "devices/thisIsDeviceID/messages/events/propKey1=propValue1&propKey2=propValue2&%24.mid=msg_id&%24.ce=utf8", result);
+
+    // cleanup
+    mqtt_telemetry_topic_destroy(topic);
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_012: [ If only one of the diagnostic id and the diagnostic creation time is present, mqtt_telemetry_topic_build shall fail and return NULL. ]
+TEST_FUNCTION(build_diagnostic_id_without_creation_time_fails)
+{
+    // arrange
+    MQTT_TELEMETRY_TOPIC_HANDLE topic = create_topic();
+    g_diag_data.diagnosticCreationTimeUtc = NULL;
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPropertyTable(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetCorrelationId(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentTypeSystemProperty(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentEncodingSystemProperty(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetDiagnosticPropertyData(TEST_MESSAGE_HANDLE)).SetReturn(&g_diag_data);
+
+    // act
+    const char* result = mqtt_telemetry_topic_build(topic, TEST_MESSAGE_HANDLE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+
+    // cleanup
+    mqtt_telemetry_topic_destroy(topic);
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_012: [ If only one of the diagnostic id and the diagnostic creation time is present, mqtt_telemetry_topic_build shall fail and return NULL. ]
+TEST_FUNCTION(build_creation_time_without_diagnostic_id_fails)
+{
+    // arrange
+    MQTT_TELEMETRY_TOPIC_HANDLE topic = create_topic();
+    g_diag_data.diagnosticId = NULL;
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPropertyTable(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetCorrelationId(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentTypeSystemProperty(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentEncodingSystemProperty(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetDiagnosticPropertyData(TEST_MESSAGE_HANDLE)).SetReturn(&g_diag_data);
+
+    // act
+    const char* result = mqtt_telemetry_topic_build(topic, TEST_MESSAGE_HANDLE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+
+    // cleanup
+    mqtt_telemetry_topic_destroy(topic);
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_014: [ If URL_EncodeString fails, mqtt_telemetry_topic_build shall fail and return NULL. ]
+TEST_FUNCTION(build_URL_EncodeString_fails)
+{
+    // arrange
+    MQTT_TELEMETRY_TOPIC_HANDLE topic = create_topic();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPropertyTable(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetCorrelationId(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentTypeSystemProperty(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentEncodingSystemProperty(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetDiagnosticPropertyData(TEST_MESSAGE_HANDLE)).SetReturn(&g_diag_data);
+    STRICT_EXPECTED_CALL(URL_EncodeString(TEST_DIAG_CREATION_TIME_UTC)).SetReturn(NULL);
+
+    // act
+    const char* result = mqtt_telemetry_topic_build(topic, TEST_MESSAGE_HANDLE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+
+    // cleanup
+    mqtt_telemetry_topic_destroy(topic);
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_015: [ mqtt_telemetry_topic_build shall grow the buffer owned by `handle` only when the topic does not fit in it. ]
+TEST_FUNCTION(build_reuses_buffer)
+{
+    // arrange
+    MQTT_TELEMETRY_TOPIC_HANDLE topic = create_topic();
+    set_properties(TEST_PROPERTY_KEYS, TEST_PROPERTY_VALUES, 2);
+    (void)mqtt_telemetry_topic_build(topic, TEST_MESSAGE_HANDLE, NULL);
+    set_properties(TEST_PROPERTY_KEYS, TEST_PROPERTY_VALUES, 1);
+    umock_c_reset_all_calls();
+
+    set_mqtt_telemetry_topic_build_expected_calls(NULL, NULL, NULL, NULL, false, false);
+
+    // act
+    const char* result = mqtt_telemetry_topic_build(topic, TEST_MESSAGE_HANDLE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "devices/thisIsDeviceID/messages/events/propKey1=propValue1", result);
+
+    // cleanup
+    mqtt_telemetry_topic_destroy(topic);
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_015: [ mqtt_telemetry_topic_build shall grow the buffer owned by `handle` only when the topic does not fit in it. ]
+TEST_FUNCTION(build_grows_buffer)
+{
+    // arrange
+    MQTT_TELEMETRY_TOPIC_HANDLE topic = create_topic();
+    set_properties(TEST_PROPERTY_KEYS, TEST_PROPERTY_VALUES, 1);
+    (void)mqtt_telemetry_topic_build(topic, TEST_MESSAGE_HANDLE, NULL);
+    set_properties(TEST_PROPERTY_KEYS, TEST_PROPERTY_VALUES, 2);
+    umock_c_reset_all_calls();
+
+    set_mqtt_telemetry_topic_build_expected_calls(NULL, NULL, NULL, NULL, false, true);
+
+    // act
+    const char* result = mqtt_telemetry_topic_build(topic, TEST_MESSAGE_HANDLE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "devices/thisIsDeviceID/messages/events/propKey1=propValue1&propKey2=propValue2", result);
+
+    // cleanup
+    mqtt_telemetry_topic_destroy(topic);
+}
+
+// Tests_SRS_MQTT_TELEMETRY_TOPIC_11_016: [ If growing the buffer fails, mqtt_telemetry_topic_build shall fail and return NULL. ]
+TEST_FUNCTION(build_realloc_fails)
+{
+    // arrange
+    MQTT_TELEMETRY_TOPIC_HANDLE topic = create_topic();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPropertyTable(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetCorrelationId(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentTypeSystemProperty(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentEncodingSystemProperty(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetDiagnosticPropertyData(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    // act
+    const char* result = mqtt_telemetry_topic_build(topic, TEST_MESSAGE_HANDLE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+
+    // cleanup
+    mqtt_telemetry_topic_destroy(topic);
+}
+
+END_TEST_SUITE(mqtt_telemetry_topic_ut)
@@ -0,0 +1,349 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// message_encode_uamqp_from_iothub_message writes the properties sections of a message itself, without uAMQP;
+// these tests check it against message_create_uamqp_encoding_from_iothub_message, byte for byte, with the real
+// uAMQP encoder and nothing mocked.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "azure_c_shared_utility/map.h"
+#include "azure_uamqp_c/message.h"
+
+#include "iothub_message.h"
+#include "uamqp_messaging.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+
+// Data definitions
+
+#define SECTIONS_CACHE_SIZE         4
+#define MAX_VALUE_LENGTH            300
+/* 128 properties make a map of 256 items, one more than a map8 can count */
+#define MAX_COUNT_PROPERTIES        128
+
+static const unsigned char TEST_PAYLOAD[] = { 0x01, 0x02, 0x03 };
+static char TEST_VALUE[MAX_VALUE_LENGTH + 1];
+
+static MESSAGE_SECTIONS_CACHE_HANDLE g_sections_cache;
+
+
+// Helpers
+
+static const char* get_value(char character, size_t length)
+{
+    ASSERT_IS_TRUE_WITH_MSG(length <= MAX_VALUE_LENGTH, "value too long for the test buffer");
+
+    (void)memset(TEST_VALUE, character, length);
+    TEST_VALUE[length] = '\0';
+
+    return TEST_VALUE;
+}
+
+static IOTHUB_MESSAGE_HANDLE create_message(void)
+{
+    IOTHUB_MESSAGE_HANDLE message = IoTHubMessage_CreateFromByteArray(TEST_PAYLOAD, sizeof(TEST_PAYLOAD));
+    ASSERT_IS_NOT_NULL_WITH_MSG(message, "IoTHubMessage_CreateFromByteArray failed");
+
+    return message;
+}
+
+static void add_property(IOTHUB_MESSAGE_HANDLE message, const char* name, const char* value)
+{
+    ASSERT_ARE_EQUAL(int, (int)MAP_OK, (int)Map_AddOrUpdate(IoTHubMessage_Properties(message), name, value));
+}
+
+static void assert_same_encoding(IOTHUB_MESSAGE_HANDLE message, MESSAGE_SECTIONS_CACHE_HANDLE sections_cache)
+{
+    BINARY_DATA body_binary_data;
+    unsigned char* destination;
+    size_t encoded_length = 0;
+    int result;
+
+    ASSERT_ARE_EQUAL(int, 0, message_create_uamqp_encoding_from_iothub_message(NULL, message, &body_binary_data));
+    destination = (unsigned char*)malloc(body_binary_data.length);
+    ASSERT_IS_NOT_NULL(destination);
+
+    result = message_encode_uamqp_from_iothub_message(NULL, message, sections_cache, destination, body_binary_data.length, &encoded_length);
+
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, body_binary_data.length, encoded_length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(destination, body_binary_data.bytes, encoded_length));
+
+    free(destination);
+    free((unsigned char*)body_binary_data.bytes);
+}
+
+/* the first encoding with the cache fills it and the second one takes the sections from it */
+static void assert_same_encodings(IOTHUB_MESSAGE_HANDLE message)
+{
+    assert_same_encoding(message, NULL);
+    assert_same_encoding(message, g_sections_cache);
+    assert_same_encoding(message, g_sections_cache);
+}
+
+static void assert_same_encodings_with_property_value_length(const char* name, size_t length)
+{
+    IOTHUB_MESSAGE_HANDLE message = create_message();
+    add_property(message, name, get_value('v', length));
+
+    assert_same_encodings(message);
+
+    IoTHubMessage_Destroy(message);
+}
+
+static void assert_same_encodings_with_content_type_length(size_t length)
+{
+    IOTHUB_MESSAGE_HANDLE message = create_message();
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_MESSAGE_OK, (int)IoTHubMessage_SetContentTypeSystemProperty(message, get_value('t', length)));
+
+    assert_same_encodings(message);
+
+    IoTHubMessage_Destroy(message);
+}
+
+static void assert_same_encodings_with_message_id_length(size_t length)
+{
+    IOTHUB_MESSAGE_HANDLE message = create_message();
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_MESSAGE_OK, (int)IoTHubMessage_SetMessageId(message, get_value('m', length)));
+
+    assert_same_encodings(message);
+
+    IoTHubMessage_Destroy(message);
+}
+
+BEGIN_TEST_SUITE(uamqp_messaging_encoding_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+
+    g_sections_cache = message_sections_cache_create(SECTIONS_CACHE_SIZE);
+    ASSERT_IS_NOT_NULL(g_sections_cache);
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    message_sections_cache_destroy(g_sections_cache);
+    g_sections_cache = NULL;
+
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_018: [`message_create_uamqp_encoding_from_iothub_message` shall encode the properties sections from AMQP_VALUEs, and `message_encode_uamqp_from_iothub_message` shall write them directly, giving the same bytes.]
+// Tests_SRS_UAMQP_MESSAGING_11_017: [Strings, symbols, lists and maps shall be written with a 1 byte length (and count) when it fits, and with a 4 bytes one otherwise; a list with no items shall be written as list0.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_no_properties_same_encoding)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE message = create_message();
+
+    // act, assert
+    assert_same_encodings(message);
+
+    // cleanup
+    IoTHubMessage_Destroy(message);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_018: [`message_create_uamqp_encoding_from_iothub_message` shall encode the properties sections from AMQP_VALUEs, and `message_encode_uamqp_from_iothub_message` shall write them directly, giving the same bytes.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_single_property_same_encoding)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE message = create_message();
+    add_property(message, "sourceDeviceId", "plc-line3-station07");
+
+    // act, assert
+    assert_same_encodings(message);
+
+    // cleanup
+    IoTHubMessage_Destroy(message);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_016: [The application-properties section shall be written as a map of the string keys and values of the message properties, in the order of the property table of the message.]
+// Tests_SRS_UAMQP_MESSAGING_11_017: [Strings, symbols, lists and maps shall be written with a 1 byte length (and count) when it fits, and with a 4 bytes one otherwise; a list with no items shall be written as list0.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_max_count_properties_same_encoding)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE message = create_message();
+    size_t index;
+
+    for (index = 0; index < MAX_COUNT_PROPERTIES; index++)
+    {
+        char name[16];
+        (void)sprintf(name, "p%03lu", (unsigned long)index);
+        add_property(message, name, "v");
+    }
+
+    // act, assert
+    assert_same_encodings(message);
+
+    // cleanup
+    IoTHubMessage_Destroy(message);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_015: [The properties section shall be written as the list of the message-id (string), user-id, to, subject, reply-to, correlation-id (string), content-type (symbol) and content-encoding (symbol) fields, up to the last one the message sets, the ones it does not set being written as null.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_all_system_properties_same_encoding)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE message = create_message();
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_MESSAGE_OK, (int)IoTHubMessage_SetMessageId(message, "message-1"));
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_MESSAGE_OK, (int)IoTHubMessage_SetCorrelationId(message, "correlation-1"));
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_MESSAGE_OK, (int)IoTHubMessage_SetContentTypeSystemProperty(message, "application%2Fjson"));
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_MESSAGE_OK, (int)IoTHubMessage_SetContentEncodingSystemProperty(message, "utf-8"));
+    add_property(message, "k", "v");
+
+    // act, assert
+    assert_same_encodings(message);
+
+    // cleanup
+    IoTHubMessage_Destroy(message);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_015: [The properties section shall be written as the list of the message-id (string), user-id, to, subject, reply-to, correlation-id (string), content-type (symbol) and content-encoding (symbol) fields, up to the last one the message sets, the ones it does not set being written as null.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_content_encoding_only_same_encoding)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE message = create_message();
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_MESSAGE_OK, (int)IoTHubMessage_SetContentEncodingSystemProperty(message, "utf-8"));
+
+    // act, assert
+    assert_same_encodings(message);
+
+    // cleanup
+    IoTHubMessage_Destroy(message);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_017: [Strings, symbols, lists and maps shall be written with a 1 byte length (and count) when it fits, and with a 4 bytes one otherwise; a list with no items shall be written as list0.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_str8_str32_property_value_same_encoding)
+{
+    // act, assert
+    assert_same_encodings_with_property_value_length("sourceDeviceId", 255);
+    assert_same_encodings_with_property_value_length("sourceDeviceId", 256);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_017: [Strings, symbols, lists and maps shall be written with a 1 byte length (and count) when it fits, and with a 4 bytes one otherwise; a list with no items shall be written as list0.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_map8_map32_same_encoding)
+{
+    // act, assert
+    /* a map holding "k" and a 249 bytes value takes 254 bytes, one more makes it a map32 */
+    assert_same_encodings_with_property_value_length("k", 249);
+    assert_same_encodings_with_property_value_length("k", 250);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_017: [Strings, symbols, lists and maps shall be written with a 1 byte length (and count) when it fits, and with a 4 bytes one otherwise; a list with no items shall be written as list0.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_sym8_sym32_content_type_same_encoding)
+{
+    // act, assert
+    assert_same_encodings_with_content_type_length(255);
+    assert_same_encodings_with_content_type_length(256);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_017: [Strings, symbols, lists and maps shall be written with a 1 byte length (and count) when it fits, and with a 4 bytes one otherwise; a list with no items shall be written as list0.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_list8_list32_properties_same_encoding)
+{
+    // act, assert
+    /* a list holding a 252 bytes message-id takes 254 bytes, one more makes it a list32 */
+    assert_same_encodings_with_message_id_length(252);
+    assert_same_encodings_with_message_id_length(253);
+    assert_same_encodings_with_message_id_length(256);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_007: [If `sections_cache` is not NULL and the message has no message-id nor correlation-id, the properties section shall be taken from the cache when one was written before with the same content-type and content-encoding, and added to the cache otherwise.]
+// Tests_SRS_UAMQP_MESSAGING_11_008: [If `sections_cache` is not NULL, the application-properties section shall be taken from the cache when one was written before with the same property names, in the same order, and added to the cache otherwise.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_sections_cache_hit_same_encoding)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE first_message = create_message();
+    IOTHUB_MESSAGE_HANDLE second_message = create_message();
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_MESSAGE_OK, (int)IoTHubMessage_SetContentTypeSystemProperty(first_message, "application%2Fjson"));
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_MESSAGE_OK, (int)IoTHubMessage_SetContentTypeSystemProperty(second_message, "application%2Fjson"));
+    add_property(first_message, "sourceDeviceId", "plc-line3-station07");
+    add_property(first_message, "messageSchema", "telemetry-v2");
+    add_property(second_message, "sourceDeviceId", "plc-line3-station07");
+    add_property(second_message, "messageSchema", "telemetry-v2");
+
+    // act, assert
+    assert_same_encoding(first_message, g_sections_cache);
+    assert_same_encoding(second_message, g_sections_cache);
+
+    // cleanup
+    IoTHubMessage_Destroy(first_message);
+    IoTHubMessage_Destroy(second_message);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_011: [If every value of the application properties has the length it had in the cached section, the changed values shall be copied over the cached ones and the cached section used; otherwise the section shall be written again.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_patched_in_place_same_encoding)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE first_message = create_message();
+    IOTHUB_MESSAGE_HANDLE second_message = create_message();
+    add_property(first_message, "sourceDeviceId", "plc-line3-station07");
+    add_property(first_message, "sequenceNumber", "00000001");
+    add_property(second_message, "sourceDeviceId", "plc-line3-station07");
+    add_property(second_message, "sequenceNumber", "00000002");
+
+    // act, assert
+    assert_same_encoding(first_message, g_sections_cache);
+    assert_same_encoding(second_message, g_sections_cache);
+    /* the values patched for the second message are patched back */
+    assert_same_encoding(first_message, g_sections_cache);
+
+    // cleanup
+    IoTHubMessage_Destroy(first_message);
+    IoTHubMessage_Destroy(second_message);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_011: [If every value of the application properties has the length it had in the cached section, the changed values shall be copied over the cached ones and the cached section used; otherwise the section shall be written again.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_value_length_changed_same_encoding)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE first_message = create_message();
+    IOTHUB_MESSAGE_HANDLE second_message = create_message();
+    IOTHUB_MESSAGE_HANDLE third_message = create_message();
+    add_property(first_message, "sequenceNumber", "9");
+    add_property(second_message, "sequenceNumber", "10");
+    /* crosses the str8/str32 boundary from the cached section */
+    add_property(third_message, "sequenceNumber", get_value('1', 256));
+
+    // act, assert
+    assert_same_encoding(first_message, g_sections_cache);
+    assert_same_encoding(second_message, g_sections_cache);
+    assert_same_encoding(third_message, g_sections_cache);
+    assert_same_encoding(first_message, g_sections_cache);
+
+    // cleanup
+    IoTHubMessage_Destroy(first_message);
+    IoTHubMessage_Destroy(second_message);
+    IoTHubMessage_Destroy(third_message);
+}
+
+END_TEST_SUITE(uamqp_messaging_encoding_ut)
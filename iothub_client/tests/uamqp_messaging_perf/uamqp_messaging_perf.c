@@ -0,0 +1,379 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures how fast telemetry messages of 1 KB and 32 KB are encoded into AMQP batches the way the
+// telemetry messenger builds them, comparing message_create_uamqp_encoding_from_iothub_message (one
+// buffer allocated and freed per message) with message_encode_uamqp_from_iothub_message writing into
+// one encode buffer reused for every message, without and with a sections cache. The messages carry
+// the same content type and property names, and the value of one property changes with every message.
+// Before measuring, the encodings of both functions are checked to be the same, byte for byte, for the
+// messages measured; uamqp_messaging_encoding_ut checks them for the other shapes of messages.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/map.h"
+#include "azure_uamqp_c/message.h"
+
+#include "iothub_message.h"
+#include "uamqp_messaging.h"
+
+#define TOTAL_BYTES_PER_SIZE        (256 * 1024 * 1024)
+#define MESSAGE_COUNT               64
+#define SECTIONS_CACHE_SIZE         8
+#define AMQP_BATCHING_FORMAT_CODE   0x80013700
+/* what IoT Hub accepts on the link, less the 1 KB the messenger keeps for the batch itself */
+#define MAX_BATCH_SIZE              (255 * 1024)
+
+static const size_t PAYLOAD_SIZES[] = { 1024, 32 * 1024 };
+
+static double get_megabytes_per_second(size_t byte_count, tickcounter_ms_t elapsed_ms)
+{
+    return (double)byte_count * 1000.0 / (1024.0 * 1024.0) / (double)(elapsed_ms == 0 ? 1 : elapsed_ms);
+}
+
+static IOTHUB_MESSAGE_HANDLE create_message(const unsigned char* payload, size_t payload_size, size_t sequence_number)
+{
+    IOTHUB_MESSAGE_HANDLE message;
+    char sequence_number_text[16];
+
+    (void)sprintf(sequence_number_text, "%08lu", (unsigned long)sequence_number);
+
+    if ((message = IoTHubMessage_CreateFromByteArray(payload, payload_size)) == NULL)
+    {
+        (void)printf("Failed creating the message\r\n");
+    }
+    else if ((IoTHubMessage_SetContentTypeSystemProperty(message, "application%2Fjson") != IOTHUB_MESSAGE_OK) ||
+        (Map_AddOrUpdate(IoTHubMessage_Properties(message), "sourceDeviceId", "plc-line3-station07") != MAP_OK) ||
+        (Map_AddOrUpdate(IoTHubMessage_Properties(message), "messageSchema", "telemetry-v2") != MAP_OK) ||
+        (Map_AddOrUpdate(IoTHubMessage_Properties(message), "sequenceNumber", sequence_number_text) != MAP_OK))
+    {
+        (void)printf("Failed setting the message properties\r\n");
+        IoTHubMessage_Destroy(message);
+        message = NULL;
+    }
+
+    return message;
+}
+
+static MESSAGE_HANDLE create_batch(void)
+{
+    MESSAGE_HANDLE batch;
+
+    if ((batch = message_create()) == NULL)
+    {
+        (void)printf("message_create failed\r\n");
+    }
+    else if (message_set_message_format(batch, AMQP_BATCHING_FORMAT_CODE) != 0)
+    {
+        (void)printf("message_set_message_format failed\r\n");
+        message_destroy(batch);
+        batch = NULL;
+    }
+
+    return batch;
+}
+
+/* starts a new batch when the message would not fit in the current one, as if the current one was sent */
+static int make_room_in_batch(MESSAGE_HANDLE* batch, size_t* batch_size, size_t encoded_length)
+{
+    int result;
+
+    if (*batch != NULL && *batch_size + encoded_length <= MAX_BATCH_SIZE)
+    {
+        result = 0;
+    }
+    else
+    {
+        if (*batch != NULL)
+        {
+            message_destroy(*batch);
+        }
+
+        *batch_size = 0;
+        result = ((*batch = create_batch()) == NULL) ? __LINE__ : 0;
+    }
+
+    return result;
+}
+
+static int run_encoding_per_message(TICK_COUNTER_HANDLE tick_counter, IOTHUB_MESSAGE_HANDLE* messages, size_t iterations, size_t* encoded_bytes, double* megabytes_per_second)
+{
+    int result = 0;
+    MESSAGE_HANDLE batch = NULL;
+    size_t batch_size = 0;
+    size_t index;
+    tickcounter_ms_t start_ms;
+    tickcounter_ms_t end_ms;
+
+    *encoded_bytes = 0;
+
+    (void)tickcounter_get_current_ms(tick_counter, &start_ms);
+    for (index = 0; index < iterations && result == 0; index++)
+    {
+        BINARY_DATA body_binary_data;
+
+        if (message_create_uamqp_encoding_from_iothub_message(batch, messages[index % MESSAGE_COUNT], &body_binary_data) != 0)
+        {
+            (void)printf("message_create_uamqp_encoding_from_iothub_message failed\r\n");
+            result = __LINE__;
+        }
+        else
+        {
+            if ((result = make_room_in_batch(&batch, &batch_size, body_binary_data.length)) == 0)
+            {
+                if (message_add_body_amqp_data(batch, body_binary_data) != 0)
+                {
+                    (void)printf("message_add_body_amqp_data failed\r\n");
+                    result = __LINE__;
+                }
+                else
+                {
+                    batch_size += body_binary_data.length;
+                    *encoded_bytes += body_binary_data.length;
+                }
+            }
+
+            free((unsigned char*)body_binary_data.bytes);
+        }
+    }
+    (void)tickcounter_get_current_ms(tick_counter, &end_ms);
+
+    if (batch != NULL)
+    {
+        message_destroy(batch);
+    }
+
+    *megabytes_per_second = get_megabytes_per_second(*encoded_bytes, end_ms - start_ms);
+
+    return result;
+}
+
+/* encodes again into a larger buffer when the message does not fit, as the telemetry messenger does */
+static int encode_into_buffer(MESSAGE_HANDLE batch, IOTHUB_MESSAGE_HANDLE message, MESSAGE_SECTIONS_CACHE_HANDLE sections_cache, unsigned char** encode_buffer, size_t* encode_buffer_size, size_t* encoded_length)
+{
+    int result;
+
+    if (message_encode_uamqp_from_iothub_message(batch, message, sections_cache, *encode_buffer, *encode_buffer_size, encoded_length) != 0)
+    {
+        result = __LINE__;
+    }
+    else if (*encoded_length <= *encode_buffer_size)
+    {
+        result = 0;
+    }
+    else
+    {
+        free(*encode_buffer);
+        *encode_buffer_size = 0;
+
+        if ((*encode_buffer = (unsigned char*)malloc(*encoded_length)) == NULL)
+        {
+            result = __LINE__;
+        }
+        else
+        {
+            *encode_buffer_size = *encoded_length;
+            result = (message_encode_uamqp_from_iothub_message(batch, message, sections_cache, *encode_buffer, *encode_buffer_size, encoded_length) != 0) ? __LINE__ : 0;
+        }
+    }
+
+    return result;
+}
+
+static int run_encoding_into_reused_buffer(TICK_COUNTER_HANDLE tick_counter, MESSAGE_SECTIONS_CACHE_HANDLE sections_cache, IOTHUB_MESSAGE_HANDLE* messages, size_t iterations, size_t* encoded_bytes, double* megabytes_per_second)
+{
+    int result = 0;
+    MESSAGE_HANDLE batch = NULL;
+    size_t batch_size = 0;
+    unsigned char* encode_buffer = NULL;
+    size_t encode_buffer_size = 0;
+    size_t index;
+    tickcounter_ms_t start_ms;
+    tickcounter_ms_t end_ms;
+
+    *encoded_bytes = 0;
+
+    (void)tickcounter_get_current_ms(tick_counter, &start_ms);
+    for (index = 0; index < iterations && result == 0; index++)
+    {
+        IOTHUB_MESSAGE_HANDLE message = messages[index % MESSAGE_COUNT];
+        size_t encoded_length;
+
+        if ((result = encode_into_buffer(batch, message, sections_cache, &encode_buffer, &encode_buffer_size, &encoded_length)) != 0)
+        {
+            (void)printf("Failed encoding the message\r\n");
+        }
+        else if ((result = make_room_in_batch(&batch, &batch_size, encoded_length)) == 0)
+        {
+            BINARY_DATA body_binary_data;
+            body_binary_data.bytes = encode_buffer;
+            body_binary_data.length = encoded_length;
+
+            if (message_add_body_amqp_data(batch, body_binary_data) != 0)
+            {
+                (void)printf("message_add_body_amqp_data failed\r\n");
+                result = __LINE__;
+            }
+            else
+            {
+                batch_size += encoded_length;
+                *encoded_bytes += encoded_length;
+            }
+        }
+    }
+    (void)tickcounter_get_current_ms(tick_counter, &end_ms);
+
+    if (batch != NULL)
+    {
+        message_destroy(batch);
+    }
+
+    free(encode_buffer);
+
+    *megabytes_per_second = get_megabytes_per_second(*encoded_bytes, end_ms - start_ms);
+
+    return result;
+}
+
+static int check_same_encoding(IOTHUB_MESSAGE_HANDLE message, MESSAGE_SECTIONS_CACHE_HANDLE sections_cache)
+{
+    int result;
+    BINARY_DATA body_binary_data;
+    unsigned char* destination = NULL;
+    size_t encoded_length = 0;
+
+    if (message_create_uamqp_encoding_from_iothub_message(NULL, message, &body_binary_data) != 0 ||
+        (destination = (unsigned char*)malloc(body_binary_data.length)) == NULL ||
+        message_encode_uamqp_from_iothub_message(NULL, message, sections_cache, destination, body_binary_data.length, &encoded_length) != 0 ||
+        encoded_length != body_binary_data.length ||
+        memcmp(destination, body_binary_data.bytes, encoded_length) != 0)
+    {
+        (void)printf("message_encode_uamqp_from_iothub_message differs from message_create_uamqp_encoding_from_iothub_message\r\n");
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    free(destination);
+    free((unsigned char*)body_binary_data.bytes);
+
+    return result;
+}
+
+/* the first messages fill the cache and the next ones are encoded from it, both must match the encoding without cache */
+static int check_same_encodings(IOTHUB_MESSAGE_HANDLE* messages, MESSAGE_SECTIONS_CACHE_HANDLE sections_cache)
+{
+    int result = 0;
+    size_t index;
+
+    for (index = 0; index < MESSAGE_COUNT && result == 0; index++)
+    {
+        if ((result = check_same_encoding(messages[index], NULL)) == 0)
+        {
+            result = check_same_encoding(messages[index], sections_cache);
+        }
+    }
+
+    return result;
+}
+
+static int run_payload_size(TICK_COUNTER_HANDLE tick_counter, size_t payload_size)
+{
+    int result = 0;
+    unsigned char* payload;
+    IOTHUB_MESSAGE_HANDLE messages[MESSAGE_COUNT];
+    size_t created = 0;
+    MESSAGE_SECTIONS_CACHE_HANDLE sections_cache;
+
+    if ((payload = (unsigned char*)malloc(payload_size)) == NULL)
+    {
+        (void)printf("Failed allocating the payload\r\n");
+        result = __LINE__;
+    }
+    else if ((sections_cache = message_sections_cache_create(SECTIONS_CACHE_SIZE)) == NULL)
+    {
+        (void)printf("Failed creating the sections cache\r\n");
+        free(payload);
+        result = __LINE__;
+    }
+    else
+    {
+        size_t index;
+
+        for (index = 0; index < payload_size; index++)
+        {
+            payload[index] = (unsigned char)(index * 31 + 7);
+        }
+
+        while (created < MESSAGE_COUNT && result == 0)
+        {
+            if ((messages[created] = create_message(payload, payload_size, created)) == NULL)
+            {
+                result = __LINE__;
+            }
+            else
+            {
+                created++;
+            }
+        }
+
+        if (result == 0 && (result = check_same_encodings(messages, sections_cache)) == 0)
+        {
+            size_t iterations = TOTAL_BYTES_PER_SIZE / payload_size;
+            size_t per_message_bytes;
+            size_t reused_buffer_bytes;
+            size_t sections_cache_bytes;
+            double per_message_megabytes_per_second;
+            double reused_buffer_megabytes_per_second;
+            double sections_cache_megabytes_per_second;
+
+            if ((result = run_encoding_per_message(tick_counter, messages, iterations, &per_message_bytes, &per_message_megabytes_per_second)) == 0 &&
+                (result = run_encoding_into_reused_buffer(tick_counter, NULL, messages, iterations, &reused_buffer_bytes, &reused_buffer_megabytes_per_second)) == 0 &&
+                (result = run_encoding_into_reused_buffer(tick_counter, sections_cache, messages, iterations, &sections_cache_bytes, &sections_cache_megabytes_per_second)) == 0)
+            {
+                (void)printf("%13lu %28.1f %28.1f %28.1f\r\n", (unsigned long)payload_size, per_message_megabytes_per_second, reused_buffer_megabytes_per_second, sections_cache_megabytes_per_second);
+            }
+        }
+
+        for (index = 0; index < created; index++)
+        {
+            IoTHubMessage_Destroy(messages[index]);
+        }
+
+        message_sections_cache_destroy(sections_cache);
+        free(payload);
+    }
+
+    return result;
+}
+
+int main(void)
+{
+    int result = 0;
+    TICK_COUNTER_HANDLE tick_counter;
+
+    if ((tick_counter = tickcounter_create()) == NULL)
+    {
+        (void)printf("Failed creating tick counter\r\n");
+        result = __LINE__;
+    }
+    else
+    {
+        size_t index;
+
+        (void)printf("%13s %28s %28s %28s\r\n", "payload bytes", "encoding per message MB/s", "reused encode buffer MB/s", "with sections cache MB/s");
+
+        for (index = 0; index < sizeof(PAYLOAD_SIZES) / sizeof(PAYLOAD_SIZES[0]) && result == 0; index++)
+        {
+            result = run_payload_size(tick_counter, PAYLOAD_SIZES[index]);
+        }
+
+        tickcounter_destroy(tick_counter);
+    }
+
+    return result;
+}
@@ -15,6 +15,11 @@ void* real_malloc(size_t size)
     return malloc(size);
 }
 
+void* real_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
 void real_free(void* ptr)
 {
     free(ptr);
@@ -39,6 +44,23 @@ static void* TEST_malloc(size_t size)
     return saved_malloc_returns[saved_malloc_returns_count++];
 }
 
+static void* TEST_realloc(void* ptr, size_t size)
+{
+    void* result = real_realloc(ptr, size);
+    int i;
+
+    for (i = 0; i < saved_malloc_returns_count && saved_malloc_returns[i] != ptr; i++);
+
+    if (i == saved_malloc_returns_count)
+    {
+        saved_malloc_returns_count++;
+    }
+
+    saved_malloc_returns[i] = result;
+
+    return result;
+}
+
 static void TEST_free(void* ptr)
 {
     int i, j;
@@ -90,8 +112,21 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define TEST_CORRELATION_ID "Test Correlation Id"
 
 #define TEST_AMQP_ENCODING_SIZE 5
+#define TEST_SECTIONS_CACHE_SIZE 2
+#define TEST_APPLICATION_PROPERTIES_ON_STACK 8
+#define TEST_MAP_KEY_COUNT 5
 
-static char g_encoding_buffer[TEST_AMQP_ENCODING_SIZE * 3];
+#define TEST_LARGE_PAYLOAD_SIZE 300
+
+static char g_encoding_buffer[TEST_AMQP_ENCODING_SIZE * 3 + 8 + TEST_LARGE_PAYLOAD_SIZE];
+
+static const unsigned char* g_test_payload;
+static size_t g_test_payload_size;
+
+static const unsigned char TEST_SMALL_PAYLOAD[] = { 0x01, 0x02, 0x03 };
+
+// A message with no properties and TEST_SMALL_PAYLOAD as body: an empty properties list and the data section.
+static const unsigned char TEST_EMPTY_MESSAGE_ENCODING[] = { 0x00, 0x53, 0x73, 0x45, 0x00, 0x53, 0x75, 0xA0, 0x03, 0x01, 0x02, 0x03 };
 
 #define UUID_N_OF_OCTECTS 16
 #define UUID_STRING_SIZE 37
@@ -102,6 +137,8 @@ static uuid TEST_UUID_BYTES = { 222,193,74,152,197,252,67,14,180,227,51,193,196,
 
 static char** TEST_MAP_KEYS;
 static char** TEST_MAP_VALUES;
+static IOTHUB_MESSAGE_PROPERTY TEST_PROPERTY_TABLE[5];
+static const IOTHUB_MESSAGE_PROPERTY* TEST_PROPERTY_TABLE_PTR = TEST_PROPERTY_TABLE;
 static AMQP_VALUE TEST_AMQP_VALUE2 = TEST_AMQP_VALUE;
 static PROPERTIES_HANDLE TEST_PROPERTIES_HANDLE_PTR = TEST_PROPERTIES_HANDLE;
 
@@ -122,6 +159,31 @@ static const char* TEST_CONTENT_ENCODING = "utf8";
 static IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA TEST_DIAGNOSTIC_DATA = { "12345678",  "1506054179" };
 
 
+static IOTHUB_MESSAGE_RESULT saved_IoTHubMessage_SetProperties_return;
+static size_t saved_IoTHubMessage_SetProperties_count;
+static bool saved_IoTHubMessage_SetProperties_matches;
+
+static IOTHUB_MESSAGE_RESULT TEST_IoTHubMessage_SetProperties(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const IOTHUB_MESSAGE_PROPERTY* properties, size_t count)
+{
+    size_t i;
+    (void)iotHubMessageHandle;
+
+    saved_IoTHubMessage_SetProperties_count = count;
+    saved_IoTHubMessage_SetProperties_matches = true;
+
+    // The properties only live during the call, as they reference the strings of the uAMQP values.
+    for (i = 0; i < count; i++)
+    {
+        if (properties[i].key != TEST_MAP_KEYS[i % TEST_MAP_KEY_COUNT] || properties[i].keyLength != strlen(TEST_MAP_KEYS[i % TEST_MAP_KEY_COUNT]) ||
+            properties[i].value != TEST_MAP_VALUES[i % TEST_MAP_KEY_COUNT] || properties[i].valueLength != strlen(TEST_MAP_VALUES[i % TEST_MAP_KEY_COUNT]))
+        {
+            saved_IoTHubMessage_SetProperties_matches = false;
+        }
+    }
+
+    return saved_IoTHubMessage_SetProperties_return;
+}
+
 static int test_properties_get_message_id(PROPERTIES_HANDLE properties, AMQP_VALUE* message_id_value)
 {
     saved_properties_get_message_id_properties = properties;
@@ -256,11 +318,9 @@ static void set_exp_calls_for_create_encoded_application_properties(size_t numbe
 {
     size_t encoding_size = TEST_AMQP_ENCODING_SIZE;
 
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE)); //16
-    STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .CopyOutArgumentBuffer(2, &TEST_MAP_KEYS, sizeof(TEST_MAP_KEYS))
-        .CopyOutArgumentBuffer(3, &TEST_MAP_VALUES, sizeof(TEST_MAP_VALUES))
-        .CopyOutArgumentBuffer(4, &number_of_app_properties, sizeof(number_of_app_properties));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPropertyTable(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) //16
+        .CopyOutArgumentBuffer(2, &TEST_PROPERTY_TABLE_PTR, sizeof(TEST_PROPERTY_TABLE_PTR))
+        .CopyOutArgumentBuffer(3, &number_of_app_properties, sizeof(number_of_app_properties));
 
     if (number_of_app_properties > 0)
     {
@@ -284,24 +344,18 @@ static void set_exp_calls_for_create_encoded_application_properties(size_t numbe
 
 static void set_exp_calls_for_create_encoded_data(IOTHUBMESSAGE_CONTENT_TYPE msg_content_type)
 {
-    size_t encoding_size = TEST_AMQP_ENCODING_SIZE;
-
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(msg_content_type);
 
     if (msg_content_type == IOTHUBMESSAGE_BYTEARRAY)
     {
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(2, &g_test_payload, sizeof(g_test_payload))
+            .CopyOutArgumentBuffer(3, &g_test_payload_size, sizeof(g_test_payload_size));
     }
     else if (msg_content_type == IOTHUBMESSAGE_STRING)
     {
         STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_IOTHUB_MESSAGE_HANDLE));
     }
-
-    data d;
-    memset(&d, 0, sizeof(d));
-    STRICT_EXPECTED_CALL(amqpvalue_create_data(d)).IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .CopyOutArgumentBuffer(2, &encoding_size, sizeof(encoding_size));
 }
 
 static void set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message(size_t number_of_app_properties, IOTHUBMESSAGE_CONTENT_TYPE msg_content_type, bool has_message_id, bool has_correlation_id, bool has_diag_properties, const char* content_type, const char* content_encoding)
@@ -325,9 +379,6 @@ static void set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message(
         STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     }
 
-    STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-
-    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
     if (number_of_app_properties > 0)
     {
         STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
@@ -339,6 +390,47 @@ static void set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message(
     STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
 }
 
+static void set_exp_calls_for_get_message_properties_fields(const char* message_id, const char* correlation_id, const char* content_type, const char* content_encoding)
+{
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(message_id);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetCorrelationId(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(correlation_id);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentTypeSystemProperty(TEST_IOTHUB_MESSAGE_HANDLE))
+        .SetReturn(content_type);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentEncodingSystemProperty(TEST_IOTHUB_MESSAGE_HANDLE))
+        .SetReturn(content_encoding);
+}
+
+static void set_exp_calls_for_get_property_table(const IOTHUB_MESSAGE_PROPERTY* property_table, size_t property_count)
+{
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPropertyTable(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &property_table, sizeof(property_table))
+        .CopyOutArgumentBuffer(3, &property_count, sizeof(property_count));
+}
+
+static void set_exp_calls_for_message_encode_uamqp_from_iothub_message(const char* message_id, const char* correlation_id, const char* content_type, const char* content_encoding, const IOTHUB_MESSAGE_PROPERTY* property_table, size_t property_count)
+{
+    set_exp_calls_for_get_message_properties_fields(message_id, correlation_id, content_type, content_encoding);
+    set_exp_calls_for_get_property_table(property_table, property_count);
+    set_exp_calls_for_create_encoded_annotations_properties(false);
+    set_exp_calls_for_create_encoded_data(IOTHUBMESSAGE_BYTEARRAY);
+}
+
+static void set_exp_calls_for_storing_section(size_t encoded_length, bool has_value_offsets)
+{
+    // Clearing the entry of the cache the section goes to.
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(encoded_length));
+
+    if (has_value_offsets)
+    {
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    }
+}
+
 static void set_exp_calls_for_message_create_IoTHubMessage_from_uamqp_message(
     size_t number_of_properties, 
     bool has_message_id, 
@@ -451,8 +543,6 @@ static void set_exp_calls_for_message_create_IoTHubMessage_from_uamqp_message(
     STRICT_EXPECTED_CALL(properties_destroy(TEST_PROPERTIES_HANDLE));
 
     // readApplicationPropertiesFromuAMQPMessage
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(TEST_MAP_HANDLE);
-
     if (has_properties)
     {
         STRICT_EXPECTED_CALL(message_get_application_properties(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG))
@@ -463,6 +553,11 @@ static void set_exp_calls_for_message_create_IoTHubMessage_from_uamqp_message(
             .IgnoreArgument(2)
             .CopyOutArgumentBuffer_pair_count((uint32_t *)&number_of_properties, sizeof(uint32_t));
 
+        if (number_of_properties > TEST_APPLICATION_PROPERTIES_ON_STACK)
+        {
+            STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        }
+
         size_t i;
         for (i = 0; i < number_of_properties; i++)
         {
@@ -471,12 +566,25 @@ static void set_exp_calls_for_message_create_IoTHubMessage_from_uamqp_message(
                 .CopyOutArgumentBuffer_key(&TEST_AMQP_VALUE2, sizeof(AMQP_VALUE))
                 .CopyOutArgumentBuffer_value(&TEST_AMQP_VALUE2, sizeof(AMQP_VALUE));
             STRICT_EXPECTED_CALL(amqpvalue_get_string(TEST_AMQP_VALUE, IGNORED_PTR_ARG))
-                .IgnoreArgument_string_value().CopyOutArgumentBuffer_string_value(&TEST_MAP_KEYS[i], sizeof(char*));
+                .IgnoreArgument_string_value().CopyOutArgumentBuffer_string_value(&TEST_MAP_KEYS[i % TEST_MAP_KEY_COUNT], sizeof(char*));
             STRICT_EXPECTED_CALL(amqpvalue_get_string(TEST_AMQP_VALUE, IGNORED_PTR_ARG))
-                .IgnoreArgument_string_value().CopyOutArgumentBuffer_string_value(&TEST_MAP_VALUES[i], sizeof(char*));
-            STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, TEST_MAP_KEYS[i], TEST_MAP_VALUES[i]));
-            STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
-            STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+                .IgnoreArgument_string_value().CopyOutArgumentBuffer_string_value(&TEST_MAP_VALUES[i % TEST_MAP_KEY_COUNT], sizeof(char*));
+        }
+
+        if (number_of_properties > 0)
+        {
+            STRICT_EXPECTED_CALL(IoTHubMessage_SetProperties(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG, number_of_properties));
+
+            for (i = 0; i < number_of_properties; i++)
+            {
+                STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+                STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+            }
+
+            if (number_of_properties > TEST_APPLICATION_PROPERTIES_ON_STACK)
+            {
+                STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+            }
         }
 
         STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
@@ -496,6 +604,13 @@ static void initialize_variables()
     saved_amqpvalue_get_uuid_value = NULL;
     test_amqpvalue_get_uuid_uuid_value = &TEST_UUID_BYTES;
     test_amqpvalue_get_uuid_return = 0;
+
+    g_test_payload = NULL;
+    g_test_payload_size = 0;
+
+    saved_IoTHubMessage_SetProperties_return = IOTHUB_MESSAGE_OK;
+    saved_IoTHubMessage_SetProperties_count = 0;
+    saved_IoTHubMessage_SetProperties_matches = false;
 }
 
 
@@ -527,10 +642,14 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(AMQPVALUE_ENCODER_OUTPUT, void*);
     REGISTER_UMOCK_ALIAS_TYPE(data, void*);
     REGISTER_UMOCK_ALIAS_TYPE(message_annotations, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_SECTIONS_CACHE_HANDLE, void*);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, TEST_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
 
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, TEST_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, TEST_free);
 
     REGISTER_GLOBAL_MOCK_HOOK(properties_get_message_id, test_properties_get_message_id);
@@ -567,7 +686,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_encode, 0);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_encode, 1);
 
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Map_GetInternals, MAP_ERROR);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetPropertyTable, IOTHUB_MESSAGE_ERROR);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_set_map_value, 1);
 
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_GetString, TEST_STRING);
@@ -601,6 +720,9 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     
     REGISTER_GLOBAL_MOCK_RETURN(Map_AddOrUpdate, MAP_OK);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(Map_AddOrUpdate, MAP_ERROR);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetProperties, TEST_IoTHubMessage_SetProperties);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_SetProperties, IOTHUB_MESSAGE_ERROR);
     
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_CreateFromByteArray, TEST_IOTHUB_MESSAGE_HANDLE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_CreateFromByteArray, NULL);
@@ -620,8 +742,6 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_encoded_size, 0);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_get_encoded_size, 1);
 
-    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_data, TEST_AMQP_VALUE);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_create_data, 0);
 
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_application_properties, TEST_AMQP_VALUE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_create_application_properties, 0);
@@ -678,6 +798,14 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     TEST_MAP_VALUES[2] = "@#$$$ @_=-09!!^;:";
     TEST_MAP_VALUES[3] = "     \t\r\n      ";
     TEST_MAP_VALUES[4] = "-------------";
+
+    for (size_t i = 0; i < 5; i++)
+    {
+        TEST_PROPERTY_TABLE[i].key = TEST_MAP_KEYS[i];
+        TEST_PROPERTY_TABLE[i].keyLength = strlen(TEST_MAP_KEYS[i]);
+        TEST_PROPERTY_TABLE[i].value = TEST_MAP_VALUES[i];
+        TEST_PROPERTY_TABLE[i].valueLength = strlen(TEST_MAP_VALUES[i]);
+    }
 }
 
 TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -736,6 +864,524 @@ TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_bytearray_succes
     // cleanup
 }
 
+// Tests_SRS_UAMQP_MESSAGING_11_001: [The data section header shall be encoded without copying the payload, which shall be appended as is after it.]
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_encodes_a_small_payload_as_vbin8)
+{
+    // arrange
+    static const unsigned char payload[] = { 0x01, 0x02, 0x03 };
+    static const unsigned char expected[] = { 0x00, 0x53, 0x75, 0xA0, 0x03, 0x01, 0x02, 0x03 };
+    g_test_payload = payload;
+    g_test_payload_size = sizeof(payload);
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message(0, IOTHUBMESSAGE_BYTEARRAY, false, false, false, NULL, NULL);
+
+    BINARY_DATA binary_data;
+    memset(&binary_data, 0, sizeof(binary_data));
+
+    // act
+    int result = message_create_uamqp_encoding_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, &binary_data);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_ARE_EQUAL(size_t, TEST_AMQP_ENCODING_SIZE + sizeof(expected), binary_data.length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(binary_data.bytes, expected, sizeof(expected)));
+
+    // cleanup
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_001: [The data section header shall be encoded without copying the payload, which shall be appended as is after it.]
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_encodes_a_large_payload_as_vbin32)
+{
+    // arrange
+    static unsigned char payload[TEST_LARGE_PAYLOAD_SIZE];
+    static const unsigned char expected_header[] = { 0x00, 0x53, 0x75, 0xB0, 0x00, 0x00, 0x01, 0x2C };
+    memset(payload, 0x5A, sizeof(payload));
+    g_test_payload = payload;
+    g_test_payload_size = sizeof(payload);
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message(0, IOTHUBMESSAGE_BYTEARRAY, false, false, false, NULL, NULL);
+
+    BINARY_DATA binary_data;
+    memset(&binary_data, 0, sizeof(binary_data));
+
+    // act
+    int result = message_create_uamqp_encoding_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, &binary_data);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_ARE_EQUAL(size_t, TEST_AMQP_ENCODING_SIZE + sizeof(expected_header) + sizeof(payload), binary_data.length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(binary_data.bytes, expected_header, sizeof(expected_header)));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(binary_data.bytes + sizeof(expected_header), payload, sizeof(payload)));
+
+    // cleanup
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_002: [If `encoded_length` is NULL, or `destination` is NULL while `capacity` is not zero, `message_encode_uamqp_from_iothub_message` shall fail and return a non-zero value.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_NULL_encoded_length_fails)
+{
+    // arrange
+    unsigned char destination[64];
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_encode_uamqp_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, NULL, destination, sizeof(destination), NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_002: [If `encoded_length` is NULL, or `destination` is NULL while `capacity` is not zero, `message_encode_uamqp_from_iothub_message` shall fail and return a non-zero value.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_NULL_destination_with_capacity_fails)
+{
+    // arrange
+    size_t encoded_length = 0;
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_encode_uamqp_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, NULL, NULL, 64, &encoded_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_003: [`message_encode_uamqp_from_iothub_message` shall set `encoded_length` to the number of bytes the AMQP encoding of the message takes.]
+// Tests_SRS_UAMQP_MESSAGING_11_004: [If the encoding does not fit in `capacity` bytes, `message_encode_uamqp_from_iothub_message` shall write nothing and return 0.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_measures_without_writing_when_it_does_not_fit)
+{
+    // arrange
+    unsigned char destination[sizeof(TEST_EMPTY_MESSAGE_ENCODING) - 1];
+    size_t encoded_length = 0;
+    g_test_payload = TEST_SMALL_PAYLOAD;
+    g_test_payload_size = sizeof(TEST_SMALL_PAYLOAD);
+    memset(destination, 0xEE, sizeof(destination));
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_encode_uamqp_from_iothub_message(NULL, NULL, NULL, NULL, NULL, 0);
+
+    // act
+    int result = message_encode_uamqp_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, NULL, destination, sizeof(destination), &encoded_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, sizeof(TEST_EMPTY_MESSAGE_ENCODING), encoded_length);
+    ASSERT_ARE_EQUAL(int, 0xEE, destination[0]);
+
+    // cleanup
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_003: [`message_encode_uamqp_from_iothub_message` shall set `encoded_length` to the number of bytes the AMQP encoding of the message takes.]
+// Tests_SRS_UAMQP_MESSAGING_11_004: [If the encoding does not fit in `capacity` bytes, `message_encode_uamqp_from_iothub_message` shall write nothing and return 0.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_measures_with_no_destination)
+{
+    // arrange
+    size_t encoded_length = 0;
+    g_test_payload = TEST_SMALL_PAYLOAD;
+    g_test_payload_size = sizeof(TEST_SMALL_PAYLOAD);
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_encode_uamqp_from_iothub_message(NULL, NULL, NULL, NULL, NULL, 0);
+
+    // act
+    int result = message_encode_uamqp_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, NULL, NULL, 0, &encoded_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, sizeof(TEST_EMPTY_MESSAGE_ENCODING), encoded_length);
+
+    // cleanup
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_005: [Otherwise the message shall be encoded directly into `destination`, without any intermediate allocation.]
+// Tests_SRS_UAMQP_MESSAGING_11_017: [Strings, symbols, lists and maps shall be written with a 1 byte length (and count) when it fits, and with a 4 bytes one otherwise; a list with no items shall be written as list0.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_encodes_into_destination)
+{
+    // arrange
+    unsigned char destination[sizeof(TEST_EMPTY_MESSAGE_ENCODING)];
+    size_t encoded_length = 0;
+    g_test_payload = TEST_SMALL_PAYLOAD;
+    g_test_payload_size = sizeof(TEST_SMALL_PAYLOAD);
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_encode_uamqp_from_iothub_message(NULL, NULL, NULL, NULL, NULL, 0);
+
+    // act
+    int result = message_encode_uamqp_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, NULL, destination, sizeof(destination), &encoded_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, sizeof(TEST_EMPTY_MESSAGE_ENCODING), encoded_length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(destination, TEST_EMPTY_MESSAGE_ENCODING, sizeof(TEST_EMPTY_MESSAGE_ENCODING)));
+
+    // cleanup
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_015: [The properties section shall be written as the list of the message-id (string), user-id, to, subject, reply-to, correlation-id (string), content-type (symbol) and content-encoding (symbol) fields, up to the last one the message sets, the ones it does not set being written as null.]
+// Tests_SRS_UAMQP_MESSAGING_11_018: [`message_create_uamqp_encoding_from_iothub_message` shall encode the properties sections from AMQP_VALUEs, and `message_encode_uamqp_from_iothub_message` shall write them directly, giving the same bytes.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_writes_the_message_properties)
+{
+    // arrange
+    static const unsigned char expected[] =
+    {
+        0x00, 0x53, 0x73, 0xC0, 0x15, 0x08,
+        0xA1, 0x02, 'm', '1',
+        0x40, 0x40, 0x40, 0x40,
+        0xA1, 0x02, 'c', '1',
+        0xA3, 0x02, 'c', 't',
+        0xA3, 0x02, 'c', 'e',
+        0x00, 0x53, 0x75, 0xA0, 0x03, 0x01, 0x02, 0x03
+    };
+    unsigned char destination[sizeof(expected)];
+    size_t encoded_length = 0;
+    g_test_payload = TEST_SMALL_PAYLOAD;
+    g_test_payload_size = sizeof(TEST_SMALL_PAYLOAD);
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_encode_uamqp_from_iothub_message("m1", "c1", "ct", "ce", NULL, 0);
+
+    // act
+    int result = message_encode_uamqp_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, NULL, destination, sizeof(destination), &encoded_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, sizeof(expected), encoded_length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(destination, expected, sizeof(expected)));
+
+    // cleanup
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_015: [The properties section shall be written as the list of the message-id (string), user-id, to, subject, reply-to, correlation-id (string), content-type (symbol) and content-encoding (symbol) fields, up to the last one the message sets, the ones it does not set being written as null.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_writes_the_fields_up_to_the_last_one_set)
+{
+    // arrange
+    static const unsigned char expected[] =
+    {
+        0x00, 0x53, 0x73, 0xC0, 0x0B, 0x07,
+        0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+        0xA3, 0x02, 'c', 't',
+        0x00, 0x53, 0x75, 0xA0, 0x03, 0x01, 0x02, 0x03
+    };
+    unsigned char destination[sizeof(expected)];
+    size_t encoded_length = 0;
+    g_test_payload = TEST_SMALL_PAYLOAD;
+    g_test_payload_size = sizeof(TEST_SMALL_PAYLOAD);
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_encode_uamqp_from_iothub_message(NULL, NULL, "ct", NULL, NULL, 0);
+
+    // act
+    int result = message_encode_uamqp_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, NULL, destination, sizeof(destination), &encoded_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, sizeof(expected), encoded_length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(destination, expected, sizeof(expected)));
+
+    // cleanup
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_016: [The application-properties section shall be written as a map of the string keys and values of the message properties, in the order of the property table of the message.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_writes_the_application_properties)
+{
+    // arrange
+    static const unsigned char expected[] =
+    {
+        0x00, 0x53, 0x73, 0x45,
+        0x00, 0x53, 0x74, 0xC1, 0x17, 0x04,
+        0xA1, 0x02, 'k', '1',
+        0xA1, 0x02, 'v', '1',
+        0xA1, 0x04, 'k', 'e', 'y', '2',
+        0xA1, 0x06, 'v', 'a', 'l', 'u', 'e', '2',
+        0x00, 0x53, 0x75, 0xA0, 0x03, 0x01, 0x02, 0x03
+    };
+    IOTHUB_MESSAGE_PROPERTY property_table[] = { { "k1", 2, "v1", 2 }, { "key2", 4, "value2", 6 } };
+    unsigned char destination[sizeof(expected)];
+    size_t encoded_length = 0;
+    g_test_payload = TEST_SMALL_PAYLOAD;
+    g_test_payload_size = sizeof(TEST_SMALL_PAYLOAD);
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_encode_uamqp_from_iothub_message(NULL, NULL, NULL, NULL, property_table, 2);
+
+    // act
+    int result = message_encode_uamqp_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, NULL, destination, sizeof(destination), &encoded_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, sizeof(expected), encoded_length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(destination, expected, sizeof(expected)));
+
+    // cleanup
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_017: [Strings, symbols, lists and maps shall be written with a 1 byte length (and count) when it fits, and with a 4 bytes one otherwise; a list with no items shall be written as list0.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_writes_a_long_value_as_str32_in_a_map32)
+{
+    // arrange
+    static const unsigned char expected_header[] =
+    {
+        0x00, 0x53, 0x73, 0x45,
+        0x00, 0x53, 0x74, 0xD1, 0x00, 0x00, 0x01, 0x38, 0x00, 0x00, 0x00, 0x02,
+        0xA1, 0x01, 'k',
+        0xB1, 0x00, 0x00, 0x01, 0x2C
+    };
+    char value[301];
+    memset(value, 'x', 300);
+    value[300] = '\0';
+    IOTHUB_MESSAGE_PROPERTY property_table[] = { { "k", 1, value, 300 } };
+    unsigned char destination[sizeof(expected_header) + 300 + 8];
+    size_t encoded_length = 0;
+    g_test_payload = TEST_SMALL_PAYLOAD;
+    g_test_payload_size = sizeof(TEST_SMALL_PAYLOAD);
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_encode_uamqp_from_iothub_message(NULL, NULL, NULL, NULL, property_table, 1);
+
+    // act
+    int result = message_encode_uamqp_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, NULL, destination, sizeof(destination), &encoded_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, sizeof(destination), encoded_length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(destination, expected_header, sizeof(expected_header)));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(destination + sizeof(expected_header), value, 300));
+
+    // cleanup
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_012: [If `max_entries` is less than 2, `message_sections_cache_create` shall fail and return NULL.]
+TEST_FUNCTION(message_sections_cache_create_with_less_than_2_entries_fails)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    MESSAGE_SECTIONS_CACHE_HANDLE sections_cache = message_sections_cache_create(1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(sections_cache);
+
+    // cleanup
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_013: [`message_sections_cache_create` shall allocate room for `max_entries` sections; if that fails, it shall return NULL.]
+TEST_FUNCTION(message_sections_cache_create_malloc_fails)
+{
+    // arrange
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    umock_c_negative_tests_snapshot();
+
+    // act
+    size_t i;
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        // arrange
+        char error_msg[64];
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        MESSAGE_SECTIONS_CACHE_HANDLE sections_cache = message_sections_cache_create(TEST_SECTIONS_CACHE_SIZE);
+
+        // assert
+        sprintf(error_msg, "On failed call %zu", i);
+        ASSERT_IS_NULL_WITH_MSG(sections_cache, error_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_013: [`message_sections_cache_create` shall allocate room for `max_entries` sections; if that fails, it shall return NULL.]
+// Tests_SRS_UAMQP_MESSAGING_11_014: [`message_sections_cache_destroy` shall release every cached section and the cache itself; it shall do nothing if `sections_cache` is NULL.]
+TEST_FUNCTION(message_sections_cache_create_and_destroy_success)
+{
+    // arrange
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    for (size_t i = 0; i < TEST_SECTIONS_CACHE_SIZE; i++)
+    {
+        // The signature, encoding and value offsets of each (empty) entry.
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    }
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    MESSAGE_SECTIONS_CACHE_HANDLE sections_cache = message_sections_cache_create(TEST_SECTIONS_CACHE_SIZE);
+    message_sections_cache_destroy(sections_cache);
+    message_sections_cache_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(sections_cache);
+
+    // cleanup
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_007: [If `sections_cache` is not NULL and the message has no message-id nor correlation-id, the properties section shall be taken from the cache when one was written before with the same content-type and content-encoding, and added to the cache otherwise.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_takes_message_properties_from_the_cache)
+{
+    // arrange
+    static const unsigned char expected[] =
+    {
+        0x00, 0x53, 0x73, 0xC0, 0x19, 0x08,
+        0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+        0xA3, 0x0A, 't', 'e', 'x', 't', '/', 'p', 'l', 'a', 'i', 'n',
+        0xA3, 0x04, 'u', 't', 'f', '8',
+        0x00, 0x53, 0x75, 0xA0, 0x03, 0x01, 0x02, 0x03
+    };
+    unsigned char first_destination[sizeof(expected)];
+    unsigned char second_destination[sizeof(expected)];
+    size_t first_encoded_length = 0;
+    size_t second_encoded_length = 0;
+    g_test_payload = TEST_SMALL_PAYLOAD;
+    g_test_payload_size = sizeof(TEST_SMALL_PAYLOAD);
+
+    MESSAGE_SECTIONS_CACHE_HANDLE sections_cache = message_sections_cache_create(TEST_SECTIONS_CACHE_SIZE);
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_get_message_properties_fields(NULL, NULL, TEST_CONTENT_TYPE, TEST_CONTENT_ENCODING);
+    // The signature of the section grows for the content type, then for the content encoding.
+    STRICT_EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    set_exp_calls_for_storing_section(sizeof(expected) - 8, false);
+    set_exp_calls_for_get_property_table(NULL, 0);
+    set_exp_calls_for_create_encoded_annotations_properties(false);
+    set_exp_calls_for_create_encoded_data(IOTHUBMESSAGE_BYTEARRAY);
+
+    int first_result = message_encode_uamqp_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, sections_cache, first_destination, sizeof(first_destination), &first_encoded_length);
+
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_encode_uamqp_from_iothub_message(NULL, NULL, TEST_CONTENT_TYPE, TEST_CONTENT_ENCODING, NULL, 0);
+
+    // act
+    int second_result = message_encode_uamqp_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, sections_cache, second_destination, sizeof(second_destination), &second_encoded_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, first_result);
+    ASSERT_ARE_EQUAL(int, 0, second_result);
+    ASSERT_ARE_EQUAL(size_t, sizeof(expected), first_encoded_length);
+    ASSERT_ARE_EQUAL(size_t, sizeof(expected), second_encoded_length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(first_destination, expected, sizeof(expected)));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(second_destination, expected, sizeof(expected)));
+
+    // cleanup
+    message_sections_cache_destroy(sections_cache);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_007: [If `sections_cache` is not NULL and the message has no message-id nor correlation-id, the properties section shall be taken from the cache when one was written before with the same content-type and content-encoding, and added to the cache otherwise.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_does_not_cache_message_properties_with_a_message_id)
+{
+    // arrange
+    unsigned char destination[64];
+    size_t encoded_length = 0;
+    g_test_payload = TEST_SMALL_PAYLOAD;
+    g_test_payload_size = sizeof(TEST_SMALL_PAYLOAD);
+
+    MESSAGE_SECTIONS_CACHE_HANDLE sections_cache = message_sections_cache_create(TEST_SECTIONS_CACHE_SIZE);
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_encode_uamqp_from_iothub_message("m1", NULL, NULL, NULL, NULL, 0);
+
+    // act
+    int result = message_encode_uamqp_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, sections_cache, destination, sizeof(destination), &encoded_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    message_sections_cache_destroy(sections_cache);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_008: [If `sections_cache` is not NULL, the application-properties section shall be taken from the cache when one was written before with the same property names, in the same order, and added to the cache otherwise.]
+// Tests_SRS_UAMQP_MESSAGING_11_010: [The position of each value shall be recorded when an application-properties section is written into the cache.]
+// Tests_SRS_UAMQP_MESSAGING_11_011: [If every value of the application properties has the length it had in the cached section, the changed values shall be copied over the cached ones and the cached section used; otherwise the section shall be written again.]
+TEST_FUNCTION(message_encode_uamqp_from_iothub_message_copies_changed_values_over_the_cached_application_properties)
+{
+    // arrange
+    static const unsigned char expected[] =
+    {
+        0x00, 0x53, 0x73, 0x45,
+        0x00, 0x53, 0x74, 0xC1, 0x17, 0x04,
+        0xA1, 0x02, 'k', '1',
+        0xA1, 0x02, 'v', '9',
+        0xA1, 0x04, 'k', 'e', 'y', '2',
+        0xA1, 0x06, 'v', 'a', 'l', 'u', 'e', '7',
+        0x00, 0x53, 0x75, 0xA0, 0x03, 0x01, 0x02, 0x03
+    };
+    IOTHUB_MESSAGE_PROPERTY first_property_table[] = { { "k1", 2, "v1", 2 }, { "key2", 4, "value2", 6 } };
+    IOTHUB_MESSAGE_PROPERTY second_property_table[] = { { "k1", 2, "v9", 2 }, { "key2", 4, "value7", 6 } };
+    unsigned char destination[sizeof(expected)];
+    size_t encoded_length = 0;
+    g_test_payload = TEST_SMALL_PAYLOAD;
+    g_test_payload_size = sizeof(TEST_SMALL_PAYLOAD);
+
+    MESSAGE_SECTIONS_CACHE_HANDLE sections_cache = message_sections_cache_create(TEST_SECTIONS_CACHE_SIZE);
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_get_message_properties_fields(NULL, NULL, NULL, NULL);
+    STRICT_EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    set_exp_calls_for_storing_section(4, false);
+    set_exp_calls_for_get_property_table(first_property_table, 2);
+    STRICT_EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    set_exp_calls_for_storing_section(sizeof(expected) - 4 - 8, true);
+    set_exp_calls_for_create_encoded_annotations_properties(false);
+    set_exp_calls_for_create_encoded_data(IOTHUBMESSAGE_BYTEARRAY);
+
+    int first_result = message_encode_uamqp_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, sections_cache, destination, sizeof(destination), &encoded_length);
+
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_encode_uamqp_from_iothub_message(NULL, NULL, NULL, NULL, second_property_table, 2);
+
+    // act
+    int second_result = message_encode_uamqp_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, sections_cache, destination, sizeof(destination), &encoded_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, first_result);
+    ASSERT_ARE_EQUAL(int, 0, second_result);
+    ASSERT_ARE_EQUAL(size_t, sizeof(expected), encoded_length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(destination, expected, sizeof(expected)));
+
+    // cleanup
+    message_sections_cache_destroy(sections_cache);
+}
+
 // Tests_SRS_UAMQP_MESSAGING_31_117: [Get application message properties associated with the IOTHUB_MESSAGE_HANDLE to encode, returning the properties and their encoded length.  Errors stop processing on this message.]
 TEST_FUNCTION(message_create_from_iothub_message_zero_app_properties_success)
 {
@@ -905,20 +1551,19 @@ TEST_FUNCTION(message_create_from_iothub_message_BYTEARRAY_return_errors_fails)
             (i == 4) || // amqpvalue_destroy
             (i == 8) || // amqpvalue_destroy
             (i == 15) || // properties_destroy
+            (i == 21) || // amqpvalue_destroy
             (i == 22) || // amqpvalue_destroy
-            (i == 23) || // amqpvalue_destroy
-            (i == 26) || // amqpvalue_destroy
-            (i == 27) || //IoTHubMessage_GetDiagnosticPropertyData is optional
+            (i == 25) || // amqpvalue_destroy
+            (i == 26) || //IoTHubMessage_GetDiagnosticPropertyData is optional
+            (i == 31) || // amqpvalue_destroy
             (i == 32) || // amqpvalue_destroy
-            (i == 33) || // amqpvalue_destroy
+            (i == 37) || // amqpvalue_destroy
             (i == 38) || // amqpvalue_destroy
-            (i == 39) || // amqpvalue_destroy
-            (i == 42) || // free
-            (i == 43) || // amqpvalue_destroy
-            (i == 53) || // amqpvalue_destroy
-            (i == 54) || // amqpvalue_destroy
-            (i == 55) || // amqpvalue_destroy
-            (i == 56) // amqpvalue_destroy
+            (i == 41) || // free
+            (i == 42) || // amqpvalue_destroy
+            (i == 49) || // amqpvalue_destroy
+            (i == 50) || // amqpvalue_destroy
+            (i == 51) // amqpvalue_destroy
             )
         {
             continue; // these lines have functions that do not return anything (void).
@@ -968,20 +1613,19 @@ TEST_FUNCTION(message_create_from_iothub_message_STRING_return_errors_fails)
             (i == 4) || // amqpvalue_destroy
             (i == 8) || // amqpvalue_destroy
             (i == 15) || // properties_destroy
+            (i == 21) || // amqpvalue_destroy
             (i == 22) || // amqpvalue_destroy
-            (i == 23) || // amqpvalue_destroy
-            (i == 26) || // amqpvalue_destroy
-            (i == 27) || //IoTHubMessage_GetDiagnosticPropertyData is optional
+            (i == 25) || // amqpvalue_destroy
+            (i == 26) || //IoTHubMessage_GetDiagnosticPropertyData is optional
+            (i == 31) || // amqpvalue_destroy
             (i == 32) || // amqpvalue_destroy
-            (i == 33) || // amqpvalue_destroy
+            (i == 37) || // amqpvalue_destroy
             (i == 38) || // amqpvalue_destroy
-            (i == 39) || // amqpvalue_destroy
-            (i == 42) || // free
-            (i == 43) || // amqpvalue_destroy
-            (i == 53) || // amqpvalue_destroy
-            (i == 54) || // amqpvalue_destroy
-            (i == 55) || // amqpvalue_destroy
-            (i == 56) // amqpvalue_destroy
+            (i == 41) || // free
+            (i == 42) || // amqpvalue_destroy
+            (i == 49) || // amqpvalue_destroy
+            (i == 50) || // amqpvalue_destroy
+            (i == 51) // amqpvalue_destroy
            )
         {
             continue; // these lines have functions that do not return anything (void).
@@ -1017,7 +1661,6 @@ TEST_FUNCTION(message_create_from_iothub_message_STRING_return_errors_fails)
 // Tests_SRS_UAMQP_MESSAGING_09_022: [The correlation-id value shall be retrieved from the AMQP_VALUE as char* by calling amqpvalue_get_string.]
 // Tests_SRS_UAMQP_MESSAGING_09_024: [The correlation-id property shall be set on the IOTHUB_MESSAGE_HANDLE by calling IoTHubMessage_SetCorrelationId, passing the value read from the uAMQP message.]
 // Tests_SRS_UAMQP_MESSAGING_09_026: [message_create_IoTHubMessage_from_uamqp_message() shall destroy the uAMQP message properties (obtained with message_get_properties()) by calling properties_destroy().]
-// Tests_SRS_UAMQP_MESSAGING_09_027: [The IOTHUB_MESSAGE_HANDLE properties shall be retrieved using IoTHubMessage_Properties.]
 // Tests_SRS_UAMQP_MESSAGING_09_029: [The uAMQP message application properties shall be retrieved using message_get_application_properties.]
 // Tests_SRS_UAMQP_MESSAGING_09_032: [The actual uAMQP message application properties should be extracted from the result of message_get_application_properties using amqpvalue_get_inplace_described_value.]
 // Tests_SRS_UAMQP_MESSAGING_09_034: [The number of items in the uAMQP message application properties shall be obtained using amqpvalue_get_map_pair_count.]
@@ -1025,7 +1668,7 @@ TEST_FUNCTION(message_create_from_iothub_message_STRING_return_errors_fails)
 // Tests_SRS_UAMQP_MESSAGING_09_037: [The uAMQP application property name and value shall be obtained using amqpvalue_get_map_key_value_pair.]
 // Tests_SRS_UAMQP_MESSAGING_09_039: [The uAMQP application property name shall be extracted as string using amqpvalue_get_string.]
 // Tests_SRS_UAMQP_MESSAGING_09_041: [The uAMQP application property value shall be extracted as string using amqpvalue_get_string.]
-// Tests_SRS_UAMQP_MESSAGING_09_043: [The application property name and value shall be added to IOTHUB_MESSAGE_HANDLE properties using Map_AddOrUpdate.]
+// Tests_SRS_UAMQP_MESSAGING_11_021: [The application properties shall be set on the IOTHUB_MESSAGE_HANDLE at once using IoTHubMessage_SetProperties.]
 // Tests_SRS_UAMQP_MESSAGING_09_045: [message_create_IoTHubMessage_from_uamqp_message() shall destroy the uAMQP message property name and value (obtained with amqpvalue_get_string) by calling amqpvalue_destroy().]
 // Tests_SRS_UAMQP_MESSAGING_09_046: [message_create_IoTHubMessage_from_uamqp_message() shall destroy the uAMQP message property (obtained with message_get_application_properties) by calling amqpvalue_destroy().]
 // Tests_SRS_UAMQP_MESSAGING_09_100: [If the uamqp message contains property `content-type`, it shall be set on IOTHUB_MESSAGE_HANDLE]
@@ -1183,5 +1826,68 @@ TEST_FUNCTION(message_create_IoTHubMessage_from_uamqp_message_no_content_encodin
     // cleanup
 }
 
+// Tests_SRS_UAMQP_MESSAGING_11_019: [The application property names and values shall be referenced in place in the uAMQP values, from a property table kept on the stack for up to APPLICATION_PROPERTIES_ON_STACK properties and allocated once otherwise.]
+// Tests_SRS_UAMQP_MESSAGING_11_021: [The application properties shall be set on the IOTHUB_MESSAGE_HANDLE at once using IoTHubMessage_SetProperties.]
+TEST_FUNCTION(message_create_IoTHubMessage_from_uamqp_message_references_the_application_properties_in_place)
+{
+    // arrange
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_create_IoTHubMessage_from_uamqp_message(TEST_MAP_KEY_COUNT, true, AMQP_TYPE_STRING, true, AMQP_TYPE_STRING, true, TEST_CONTENT_TYPE, TEST_CONTENT_ENCODING);
+
+    // act
+    IOTHUB_MESSAGE_HANDLE iothub_client_message = NULL;
+    int result = message_create_IoTHubMessage_from_uamqp_message(TEST_MESSAGE_HANDLE, &iothub_client_message);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, TEST_MAP_KEY_COUNT, saved_IoTHubMessage_SetProperties_count);
+    ASSERT_IS_TRUE(saved_IoTHubMessage_SetProperties_matches);
+
+    // cleanup
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_019: [The application property names and values shall be referenced in place in the uAMQP values, from a property table kept on the stack for up to APPLICATION_PROPERTIES_ON_STACK properties and allocated once otherwise.]
+TEST_FUNCTION(message_create_IoTHubMessage_from_uamqp_message_allocates_the_table_of_many_application_properties)
+{
+    // arrange
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_create_IoTHubMessage_from_uamqp_message(TEST_APPLICATION_PROPERTIES_ON_STACK + 1, true, AMQP_TYPE_STRING, true, AMQP_TYPE_STRING, true, TEST_CONTENT_TYPE, TEST_CONTENT_ENCODING);
+
+    // act
+    IOTHUB_MESSAGE_HANDLE iothub_client_message = NULL;
+    int result = message_create_IoTHubMessage_from_uamqp_message(TEST_MESSAGE_HANDLE, &iothub_client_message);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, TEST_APPLICATION_PROPERTIES_ON_STACK + 1, saved_IoTHubMessage_SetProperties_count);
+    ASSERT_IS_TRUE(saved_IoTHubMessage_SetProperties_matches);
+
+    // cleanup
+}
+
+// Tests_SRS_UAMQP_MESSAGING_11_022: [If IoTHubMessage_SetProperties fails, message_create_IoTHubMessage_from_uamqp_message() shall fail and return immediately.]
+TEST_FUNCTION(message_create_IoTHubMessage_from_uamqp_message_SetProperties_fails)
+{
+    // arrange
+    saved_IoTHubMessage_SetProperties_return = IOTHUB_MESSAGE_ERROR;
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_create_IoTHubMessage_from_uamqp_message(1, true, AMQP_TYPE_STRING, true, AMQP_TYPE_STRING, true, TEST_CONTENT_TYPE, TEST_CONTENT_ENCODING);
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_IOTHUB_MESSAGE_HANDLE));
+
+    // act
+    IOTHUB_MESSAGE_HANDLE iothub_client_message = NULL;
+    int result = message_create_IoTHubMessage_from_uamqp_message(TEST_MESSAGE_HANDLE, &iothub_client_message);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_NULL(iothub_client_message);
+
+    // cleanup
+}
+
 END_TEST_SUITE(uamqp_messaging_ut)
 